@@ -6,10 +6,40 @@
  */
 
 #include "stm32f407xx.h"
+#include "stm32f407xx_sched.h"
 
-void delay(void)
+#define LED_TOGGLE_PERIOD_MS	250
+
+#define LED_SIG_TOGGLE			SCHED_SIG_USER
+
+// 168 MHz from the 8 MHz crystal, the PLL setting is computed by the compiler
+static const RCC_ClockConfig_t ClockConfig =
+{
+	.Source = RCC_SYSCLK_PLL,
+	.PLLSource = RCC_PLLSRC_HSE,
+	.SysclkHz = RCC_SYSCLK_MAX,
+	.AHBDiv = 1,
+	.PLL = RCC_PLL_INIT(HSE_VALUE, RCC_SYSCLK_MAX),
+};
+
+static void LedHandler(SCHED_Task_t *pTask, const SCHED_Event_t *pEvent)
+{
+	(void)pTask;
+
+	if(pEvent->Signal == LED_SIG_TOGGLE)
+	{
+		GPIO_ToggleOutputPin(GPIOD, GPIO_PIN_NO_12); //  Toggle the output pin
+	}
+}
+
+SCHED_TASK_DEFINE(LedTask, LedHandler, NULL, 4);
+static SCHED_Periodic_t LedTick;
+
+// Runs from the reset handler before .data and .bss are set up, so the copies run at 168 MHz
+void BOOT_EarlyInit(void)
 {
-	for(uint32_t i = 0; i < 500000; i++); // Delay using for-loop
+	FLASH_EnableART(); // Prefetch and caches, hides most of the 5 flash wait states at 168 MHz
+	RCC_ClockConfig(&ClockConfig); // Stays on the 16 MHz HSI if the crystal does not start
 }
 
 int main(void)
@@ -22,18 +52,22 @@ int main(void)
 	GpioLed.pGPIOx = GPIOD;
 	GpioLed.GPIO_PinConfig.GPIO_PinNumber = GPIO_PIN_NO_12;
 	GpioLed.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_OUT;
-	GpioLed.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_FAST;
-	GpioLed.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_OD;
+	GpioLed.GPIO_PinConfig.GPIO_PinSpeed = GPIO_MODE_FAST;
+	GpioLed.GPIO_PinConfig.GPIO_PinOPType = GPIO_MODE_OD;
 	GpioLed.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_PIN_PU;
 
 	GPIO_PeriClockControl(GPIOD, ENABLE); // The clock is enabled for port D.
-	GPIO_Init(&GpioLed); // Initialization of the register.
+	GPIO_init(&GpioLed); // Initialization of the register.
 
-	while(1)
-	{
-		GPIO_ToggleOutputPin(GPIOD, GPIO_PIN_NO_12); //  Toggle the output pin
-		delay();
-	}
+	TIMEBASE_Init(RCC_GetHCLKFreq()); // SysTick timebase at the core clock that is running
+
+	SCHED_Init(0); // Deferred work runs before all other tasks
+	SCHED_TaskStart(&LedTask, 1);
+	SCHED_PeriodicStart(&LedTick, &LedTask, LED_SIG_TOGGLE, LED_TOGGLE_PERIOD_MS);
+
+	BOOT_Milestone(BOOT_MILESTONE_READY); // Reset to ready, see BOOT_GetCycles
+
+	SCHED_Run(); // Sleeps between the events instead of spinning in a delay
 
 	return 0;
 }
@@ -6,16 +6,81 @@
  */
 
 #include <stdint.h>
+#include <stddef.h>
 
 #ifndef INC_STM32F407XX_H_
 #define INC_STM32F407XX_H_
 
 #define __vo volatile
 
+// ****************************************************************
+// *                    Register access                           *
+// ****************************************************************
+
+// All driver code reads and writes peripheral registers through these macros.
+// On the target they are plain volatile accesses and compile to the same code as
+// "REG |= MASK". When STM32F407XX_SIM is defined the drivers are built for the host
+// register simulator (see stm32f407xx_sim.h), which counts every access and models
+// the hardware side effects of the registers.
+#ifndef STM32F407XX_SIM
+#define REG_READ(REG)						(REG)
+#define REG_WRITE(REG, VAL)					((REG) = (VAL))
+#else
+uint32_t SIM_Read(__vo uint32_t *pReg);
+void SIM_Write(__vo uint32_t *pReg, uint32_t Value);
+#define REG_READ(REG)						SIM_Read(&(REG))
+#define REG_WRITE(REG, VAL)					SIM_Write(&(REG), (uint32_t)(VAL))
+#endif
+#define REG_SET_BITS(REG, MASK)				REG_WRITE((REG), REG_READ(REG) | (MASK))
+#define REG_CLR_BITS(REG, MASK)				REG_WRITE((REG), REG_READ(REG) & ~(MASK))
+#define REG_MODIFY(REG, CLRMASK, SETMASK)	REG_WRITE((REG), (REG_READ(REG) & ~(CLRMASK)) | (SETMASK))
+
+// Bit-band (Cortex-M4, PM0214 ch. 2.2.5). Every bit of the first 1 MB of SRAM and of the
+// peripherals has its own word in an alias region. A store of 0 or 1 to the alias word clears or
+// sets only that bit and a load returns it, so a bit is changed with a single store that an
+// interrupt can not split (no read-modify-write of the whole register):
+//		alias = alias base + (byte offset from the region base) * 32 + bit * 4
+// With a constant register address the alias address is computed by the compiler. BIT may be
+// 0 - 31 of a word, bit 8 of a byte has the same alias as bit 0 of the next byte.
+#define BITBAND_SRAM_BASE				0x20000000U		// SRAM1 and SRAM2, not the CCM RAM
+#define BITBAND_SRAM_ALIAS				0x22000000U
+#define BITBAND_PERIPH_BASE				0x40000000U
+#define BITBAND_PERIPH_ALIAS			0x42000000U
+
+#define BITBAND_ALIAS(ALIASBASE, BASE, ADDR, BIT)	( (ALIASBASE) + (((uint32_t)(ADDR) - (BASE)) << 5) + ((uint32_t)(BIT) << 2) )
+#define BITBAND_SRAM_ADDR(ADDR, BIT)				BITBAND_ALIAS(BITBAND_SRAM_ALIAS, BITBAND_SRAM_BASE, (ADDR), (BIT))
+#define BITBAND_PERIPH_ADDR(ADDR, BIT)				BITBAND_ALIAS(BITBAND_PERIPH_ALIAS, BITBAND_PERIPH_BASE, (ADDR), (BIT))
+
+// Examples of PM0214 ch. 2.2.5
+_Static_assert(BITBAND_SRAM_ADDR(0x20000000U, 7) == 0x2200001CU, "Bit-band alias of SRAM");
+_Static_assert(BITBAND_SRAM_ADDR(0x200FFFFFU, 0) == 0x23FFFFE0U, "Bit-band alias of SRAM");
+_Static_assert(BITBAND_PERIPH_ADDR(0x40023830U, 3) == 0x4247060CU, "Bit-band alias of RCC AHB1ENR");
+
+// One bit of a peripheral register (REG_BB_*) or of a 32 bit variable in SRAM1/SRAM2 (SRAM_BB_*),
+// e.g. flags shared with interrupts. Variables in the CCM RAM (__CCMRAM, __CCMBSS) have no
+// alias. On the host simulator there is no alias region: the register macros fall back to a
+// read-modify-write, so every access is still counted by the simulator, the SRAM macros to an
+// atomic OR/AND, so flags can be shared between host threads.
+#ifndef STM32F407XX_SIM
+#define REG_BB_WRITE(REG, BIT, VAL)			( *(__vo uint32_t*)(uintptr_t)BITBAND_PERIPH_ADDR((uintptr_t)&(REG), (BIT)) = (uint32_t)(VAL) )
+#define REG_BB_READ(REG, BIT)				( *(__vo uint32_t*)(uintptr_t)BITBAND_PERIPH_ADDR((uintptr_t)&(REG), (BIT)) )
+#define SRAM_BB_WRITE(VAR, BIT, VAL)		( *(__vo uint32_t*)(uintptr_t)BITBAND_SRAM_ADDR((uintptr_t)&(VAR), (BIT)) = (uint32_t)(VAL) )
+#define SRAM_BB_READ(VAR, BIT)				( *(__vo uint32_t*)(uintptr_t)BITBAND_SRAM_ADDR((uintptr_t)&(VAR), (BIT)) )
+#else
+#define REG_BB_WRITE(REG, BIT, VAL)			REG_MODIFY((REG), (1U << (BIT)), ((uint32_t)(VAL) & 1U) << (BIT))
+#define REG_BB_READ(REG, BIT)				( (REG_READ(REG) >> (BIT)) & 1U )
+#define SRAM_BB_WRITE(VAR, BIT, VAL)		( (VAL) ? (void)__atomic_fetch_or(&(VAR), 1U << (BIT), __ATOMIC_SEQ_CST)		\
+												: (void)__atomic_fetch_and(&(VAR), ~(1U << (BIT)), __ATOMIC_SEQ_CST) )
+#define SRAM_BB_READ(VAR, BIT)				( ((VAR) >> (BIT)) & 1U )
+#endif
+#define REG_BB_SET(REG, BIT)				REG_BB_WRITE((REG), (BIT), 1)
+#define REG_BB_CLR(REG, BIT)				REG_BB_WRITE((REG), (BIT), 0)
+#define SRAM_BB_SET(VAR, BIT)				SRAM_BB_WRITE((VAR), (BIT), 1)
+#define SRAM_BB_CLR(VAR, BIT)				SRAM_BB_WRITE((VAR), (BIT), 0)
+
 // Base addresses of Flash and SRAM memories
 
-#define FLASH_STM32 0x4002 3C00 //- 0x4002 3FFF
-#define SRAM_STM32
+// The flash interface registers (0x4002 3C00 - 0x4002 3FFF) are at FLASH_INTF_BASEADDR on AHB1
 
 // By default, these numbers are considered as signed numbers (signed integers)
 // but addresses can't be signed. We have to cast them to unsigned.
@@ -26,8 +91,15 @@
 #define SRAM1_BASEADDR 					0x20000000U 	// p. 71 - Main internal SRAM1 (112 KB)
 #define SRAM2_BASEADDR 					0x2001C000U		// p. 71 - Auxiliary internal SRAM2 (16 KB)
 #define ROM_BASEADDR					0x1FFF0000U		// p. 71 - System Memory (30 kbytes)
+#define CCMRAM_BASEADDR					0x10000000U		// p. 71 - Core coupled memory (64 KB), D-bus only
 #define SRAM 							SRAM1_BASEADDR	// SRAM1 is SRAM (base SRAM)
 
+// Clock sources (ch. 6.2)
+#define HSI_VALUE						16000000U		// Internal RC oscillator, system clock after reset
+#ifndef HSE_VALUE
+#define HSE_VALUE						8000000U		// External crystal, 8 MHz on the STM32F4DISCOVERY board
+#endif
+
 // Calculate base address C macros for MCU
 // SRAM2 base address - SRAM1 is 112 KB, so after 112 KB the SRAM2 appears.
 // Convert from KB to Bytes: 112 * 1024 = 114688 bytes -> convert to HEX:
@@ -41,11 +113,145 @@
 
 
 // AHBx and APBx BUS Peripheral base addresses
+#ifndef STM32F407XX_SIM
 #define PERIPH_BASEADDR					0x40000000U 	// Peripheral Base - TIM2 starts at this address, p.67 Table 1
 #define APB1PERIPH_BASEADDR				PERIPH_BASEADDR // TIM2 is connected to APB1 peripheral BUS
 #define APB2PERIPH_BASEADDR				0x40010000U		// TIM1 is connected to APB2 peripheral BUS
 #define AHB1PERIPH_BASEADDR				0x40020000U		// GPIOA register
 #define AHB2PERIPH_BASEADDR				0x50000000U		// USB OTG FS connected to AHB2 BUS
+#define PPB_BASEADDR					0xE0000000U		// Cortex-M4 private peripheral bus (NVIC, SysTick, SCB, DWT)
+#else
+// Host simulator: every bus is a block of host memory with the same layout as the real
+// bus, so all the peripheral offsets below stay valid (see stm32f407xx_sim.h)
+#define SIM_APB1_SIZE					0x8000U
+#define SIM_APB2_SIZE					0x8000U
+#define SIM_AHB1_SIZE					0x8000U
+#define SIM_AHB2_SIZE					0x1000U
+#define SIM_PPB_SIZE					0x10000U
+extern uint32_t SIM_APB1Mem[SIM_APB1_SIZE / 4];
+extern uint32_t SIM_APB2Mem[SIM_APB2_SIZE / 4];
+extern uint32_t SIM_AHB1Mem[SIM_AHB1_SIZE / 4];
+extern uint32_t SIM_AHB2Mem[SIM_AHB2_SIZE / 4];
+extern uint32_t SIM_PPBMem[SIM_PPB_SIZE / 4];
+
+#define PERIPH_BASEADDR					((uintptr_t)SIM_APB1Mem)
+#define APB1PERIPH_BASEADDR				PERIPH_BASEADDR
+#define APB2PERIPH_BASEADDR				((uintptr_t)SIM_APB2Mem)
+#define AHB1PERIPH_BASEADDR				((uintptr_t)SIM_AHB1Mem)
+#define AHB2PERIPH_BASEADDR				((uintptr_t)SIM_AHB2Mem)
+#define PPB_BASEADDR					((uintptr_t)SIM_PPBMem)
+#endif
+
+// ****************************************************************
+// *            Processor specific details (Cortex-M4)            *
+// ****************************************************************
+
+// NVIC register addresses (Cortex-M4 generic user guide, ch. 4.2)
+#define NVIC_ISER_BASEADDR				(PPB_BASEADDR + 0xE100)	// Interrupt Set-enable Registers 0-7
+#define NVIC_ICER_BASEADDR				(PPB_BASEADDR + 0xE180)	// Interrupt Clear-enable Registers 0-7
+#define NVIC_IPR_BASEADDR				(PPB_BASEADDR + 0xE400)	// Interrupt Priority Registers 0-59
+
+#define NVIC_ISER						((__vo uint32_t*)NVIC_ISER_BASEADDR)
+#define NVIC_ICER						((__vo uint32_t*)NVIC_ICER_BASEADDR)
+#define NVIC_IPR						((__vo uint32_t*)NVIC_IPR_BASEADDR)
+
+// SysTick register address (Cortex-M4 generic user guide, ch. 4.4)
+#define SYSTICK_BASEADDR				(PPB_BASEADDR + 0xE010)
+
+// Debug registers used for cycle counting (ARMv7-M architecture reference manual, C1.6 and C1.8)
+#define DWT_BASEADDR					(PPB_BASEADDR + 0x1000)	// Data Watchpoint and Trace unit
+#define DEMCR_ADDR						(PPB_BASEADDR + 0xEDFC)	// Debug Exception and Monitor Control Register
+#define DEMCR							(*(__vo uint32_t*)DEMCR_ADDR)
+#define DEMCR_TRCENA					(1U << 24)				// Enables the DWT
+
+// System Control Register, selects Sleep or deep sleep (Stop) for WFI (generic user guide, ch. 4.3.7)
+#define SCB_SCR_ADDR					(PPB_BASEADDR + 0xED10)
+#define SCB_SCR							(*(__vo uint32_t*)SCB_SCR_ADDR)
+#define SCB_SCR_SLEEPDEEP				(1U << 2)
+
+// Coprocessor Access Control Register, the FPU is off after reset (generic user guide, ch. 4.6.1)
+#define SCB_CPACR_ADDR					(PPB_BASEADDR + 0xED88)
+#define SCB_CPACR						(*(__vo uint32_t*)SCB_CPACR_ADDR)
+#define SCB_CPACR_FPU_FULL				(0xFU << 20)			// CP10 and CP11 full access
+
+// The STM32F4 only implements the upper 4 bits of each 8 bit priority field
+#define NO_PR_BITS_IMPLEMENTED			4
+
+// Count leading zeros, a single CLZ instruction on the Cortex-M4. The result for 0 is undefined,
+// so check for 0 before using it. "31 - __CLZ(x)" is the position of the highest set bit of x.
+#define __CLZ(x)						((uint8_t)__builtin_clz(x))
+
+// DSP instructions of the Cortex-M4 on two signed 16 bit halves of a word (PM0214 ch. 3.6 and 3.7).
+//	__SMLAD(x, y, acc)	acc + x.lo * y.lo + x.hi * y.hi, two multiply-accumulates in one cycle.
+//						The sum wraps at 32 bits (the Q flag is not used here).
+//	__QADD16(x, y)		x.lo + y.lo and x.hi + y.hi, each saturated to -32768 - 32767
+// The host simulator has C versions with the same results, bit for bit.
+#ifndef STM32F407XX_SIM
+static inline uint32_t __SMLAD(uint32_t x, uint32_t y, uint32_t acc)	{ uint32_t r; __asm ("smlad %0, %1, %2, %3" : "=r" (r) : "r" (x), "r" (y), "r" (acc)); return r; }
+static inline uint32_t __QADD16(uint32_t x, uint32_t y)					{ uint32_t r; __asm ("qadd16 %0, %1, %2" : "=r" (r) : "r" (x), "r" (y)); return r; }
+#else
+static inline uint32_t __SMLAD(uint32_t x, uint32_t y, uint32_t acc)
+{
+	int32_t lo = (int32_t)(int16_t)x * (int16_t)y;
+	int32_t hi = (int32_t)(int16_t)(x >> 16) * (int16_t)(y >> 16);
+
+	return acc + (uint32_t)lo + (uint32_t)hi;
+}
+
+static inline uint32_t __QADD16(uint32_t x, uint32_t y)
+{
+	int32_t lo = (int32_t)(int16_t)x + (int16_t)y;
+	int32_t hi = (int32_t)(int16_t)(x >> 16) + (int16_t)(y >> 16);
+
+	lo = (lo > 32767) ? 32767 : (lo < -32768) ? -32768 : lo;
+	hi = (hi > 32767) ? 32767 : (hi < -32768) ? -32768 : hi;
+
+	return ((uint32_t)hi << 16) | ((uint32_t)lo & 0xFFFFU);
+}
+#endif
+
+// Functions that the application may replace by defining its own version (e.g. IRQ handlers)
+#define __weak							__attribute__((weak))
+
+// Memory placement, the sections are set up by MEM_InitSections (stm32f407xx_mem.h) before main.
+//	__RAMFUNC	function runs from SRAM, no flash wait states (the CCM RAM can not hold code)
+//	__CCMRAM	initialized data in the CCM RAM, no bus contention with DMA
+//	__CCMBSS	zeroed data in the CCM RAM
+// The DMA can not reach the CCM RAM, so DMA buffers must not be placed there.
+// On the host simulator the attributes are empty.
+#ifndef STM32F407XX_SIM
+#define __RAMFUNC						__attribute__((section(".RamFunc"), noinline, long_call))
+#define __CCMRAM						__attribute__((section(".ccmram")))
+#define __CCMBSS						__attribute__((section(".ccmbss")))
+#else
+#define __RAMFUNC
+#define __CCMRAM
+#define __CCMBSS
+#endif
+
+// Interrupt masking through PRIMASK. Used for short critical sections:
+//		uint32_t primask = __get_PRIMASK(); __disable_irq(); ... __set_PRIMASK(primask);
+// The host simulator has no interrupts, so there they do nothing.
+#ifndef STM32F407XX_SIM
+static inline void __disable_irq(void)				{ __asm volatile ("cpsid i" : : : "memory"); }
+static inline void __enable_irq(void)				{ __asm volatile ("cpsie i" : : : "memory"); }
+static inline uint32_t __get_PRIMASK(void)			{ uint32_t r; __asm volatile ("mrs %0, primask" : "=r" (r)); return r; }
+static inline void __set_PRIMASK(uint32_t PriMask)	{ __asm volatile ("msr primask, %0" : : "r" (PriMask) : "memory"); }
+#else
+static inline void __disable_irq(void)				{ }
+static inline void __enable_irq(void)				{ }
+static inline uint32_t __get_PRIMASK(void)			{ return 0; }
+static inline void __set_PRIMASK(uint32_t PriMask)	{ (void)PriMask; }
+#endif
+
+// Wait for interrupt, the core sleeps until an interrupt is pending. It also wakes up when the
+// interrupt is masked by PRIMASK, which closes the gap between "nothing to do" and the sleep.
+// On the host simulator it returns at once.
+#ifndef STM32F407XX_SIM
+static inline void __WFI(void)						{ __asm volatile ("wfi" : : : "memory"); }
+#else
+static inline void __WFI(void)						{ }
+#endif
 
 // Base addresses of peripherals which are hanging on AHB1 bus
 
@@ -63,9 +269,20 @@
 #define GPIOI_BASEADDR 					(AHB1PERIPH_BASEADDR + 0x2000)	//
 
 #define RCC_BASEADDR					(AHB1PERIPH_BASEADDR + 0x3800) // RCC is connected to AHB1 bus. 0x4002 3800 - 0x4002 3BFF
+#define FLASH_INTF_BASEADDR				(AHB1PERIPH_BASEADDR + 0x3C00) // Flash interface registers. 0x4002 3C00 - 0x4002 3FFF
+
+#define DMA1_BASEADDR					(AHB1PERIPH_BASEADDR + 0x6000)
+#define DMA2_BASEADDR					(AHB1PERIPH_BASEADDR + 0x6400)
 
 // Base addresses of peripherals which are hanging on APB1 bus
 									  //(APB1PERIPH_BASEADDR + OFFSET)
+#define TIM2_BASEADDR					(APB1PERIPH_BASEADDR + 0x0000)
+#define TIM3_BASEADDR					(APB1PERIPH_BASEADDR + 0x0400)
+#define TIM4_BASEADDR					(APB1PERIPH_BASEADDR + 0x0800)
+#define TIM5_BASEADDR					(APB1PERIPH_BASEADDR + 0x0C00)
+#define TIM6_BASEADDR					(APB1PERIPH_BASEADDR + 0x1000)
+#define TIM7_BASEADDR					(APB1PERIPH_BASEADDR + 0x1400)
+
 #define I2C1_BASEADDR					(APB1PERIPH_BASEADDR + 0x5400)
 #define I2C2_BASEADDR					(APB1PERIPH_BASEADDR + 0x5800)
 #define I2C3_BASEADDR					(APB1PERIPH_BASEADDR + 0x5C00)
@@ -79,13 +296,21 @@
 #define UART4_BASEADDR					(APB1PERIPH_BASEADDR + 0x4C00)
 #define UART5_BASEADDR					(APB1PERIPH_BASEADDR + 0x5000)
 
+#define PWR_BASEADDR					(APB1PERIPH_BASEADDR + 0x7000)	// Power controller (ch. 5)
+
 // Base addresses of peripherals which are hanging on APB2 bus
 
+#define TIM1_BASEADDR					(APB2PERIPH_BASEADDR + 0x0000)
+#define TIM8_BASEADDR					(APB2PERIPH_BASEADDR + 0x0400)
 #define EXTI_BASE						(APB2PERIPH_BASEADDR + 0x3C00)
 #define SPI1_BASE						(APB2PERIPH_BASEADDR + 0x3000)
 #define SYSCFG_BASE						(APB2PERIPH_BASEADDR + 0x3800)
 #define USART1_BASE						(APB2PERIPH_BASEADDR + 0x1000)
 #define USART6_BASE						(APB2PERIPH_BASEADDR + 0x1400)
+#define ADC1_BASEADDR					(APB2PERIPH_BASEADDR + 0x2000)
+#define ADC2_BASEADDR					(APB2PERIPH_BASEADDR + 0x2100)
+#define ADC3_BASEADDR					(APB2PERIPH_BASEADDR + 0x2200)
+#define ADC_COMMON_BASEADDR				(APB2PERIPH_BASEADDR + 0x2300)	// Registers shared by the 3 ADCs
 
 // Address offsets for registers of SPI1
 // Control Register 1: 0x00 - ch. 28.5.1
@@ -111,6 +336,79 @@ typedef struct {
 					 	  //AFR[1]:AFRH, GPIO alternate function high register - Address Offset: 0x24
 }GPIO_RegDef_t;
 
+typedef struct {
+	__vo uint32_t CR1;		// SPI control register 1						- Address Offset: 0x00
+	__vo uint32_t CR2;		// SPI control register 2						- Address Offset: 0x04
+	__vo uint32_t SR;		// SPI status register							- Address Offset: 0x08
+	__vo uint32_t DR;		// SPI data register							- Address Offset: 0x0C
+	__vo uint32_t CRCPR;	// SPI CRC polynomial register					- Address Offset: 0x10
+	__vo uint32_t RXCRCR;	// SPI RX CRC register							- Address Offset: 0x14
+	__vo uint32_t TXCRCR;	// SPI TX CRC register							- Address Offset: 0x18
+	__vo uint32_t I2SCFGR;	// SPI_I2S configuration register				- Address Offset: 0x1C
+	__vo uint32_t I2SPR;	// SPI_I2S prescaler register					- Address Offset: 0x20
+}SPI_RegDef_t;
+
+typedef struct {
+	__vo uint32_t SR;		// USART status register						- Address Offset: 0x00
+	__vo uint32_t DR;		// USART data register							- Address Offset: 0x04
+	__vo uint32_t BRR;		// USART baud rate register						- Address Offset: 0x08
+	__vo uint32_t CR1;		// USART control register 1						- Address Offset: 0x0C
+	__vo uint32_t CR2;		// USART control register 2						- Address Offset: 0x10
+	__vo uint32_t CR3;		// USART control register 3						- Address Offset: 0x14
+	__vo uint32_t GTPR;		// USART guard time and prescaler register		- Address Offset: 0x18
+}USART_RegDef_t;
+
+typedef struct {
+	__vo uint32_t CR1;		// I2C control register 1						- Address Offset: 0x00
+	__vo uint32_t CR2;		// I2C control register 2						- Address Offset: 0x04
+	__vo uint32_t OAR1;		// I2C own address register 1					- Address Offset: 0x08
+	__vo uint32_t OAR2;		// I2C own address register 2					- Address Offset: 0x0C
+	__vo uint32_t DR;		// I2C data register							- Address Offset: 0x10
+	__vo uint32_t SR1;		// I2C status register 1						- Address Offset: 0x14
+	__vo uint32_t SR2;		// I2C status register 2						- Address Offset: 0x18
+	__vo uint32_t CCR;		// I2C clock control register					- Address Offset: 0x1C
+	__vo uint32_t TRISE;	// I2C TRISE register							- Address Offset: 0x20
+	__vo uint32_t FLTR;		// I2C FLTR register							- Address Offset: 0x24
+}I2C_RegDef_t;
+
+typedef struct {
+	__vo uint32_t CR;		// DMA stream x configuration register			- Address Offset: 0x10 + 0x18 * x
+	__vo uint32_t NDTR;		// DMA stream x number of data register			- Address Offset: 0x14 + 0x18 * x
+	__vo uint32_t PAR;		// DMA stream x peripheral address register		- Address Offset: 0x18 + 0x18 * x
+	__vo uint32_t M0AR;		// DMA stream x memory 0 address register		- Address Offset: 0x1C + 0x18 * x
+	__vo uint32_t M1AR;		// DMA stream x memory 1 address register		- Address Offset: 0x20 + 0x18 * x
+	__vo uint32_t FCR;		// DMA stream x FIFO control register			- Address Offset: 0x24 + 0x18 * x
+}DMA_Stream_RegDef_t;
+
+typedef struct {
+	__vo uint32_t LISR;		// DMA low interrupt status register (streams 0-3)		- Address Offset: 0x00
+	__vo uint32_t HISR;		// DMA high interrupt status register (streams 4-7)		- Address Offset: 0x04
+	__vo uint32_t LIFCR;	// DMA low interrupt flag clear register				- Address Offset: 0x08
+	__vo uint32_t HIFCR;	// DMA high interrupt flag clear register				- Address Offset: 0x0C
+	DMA_Stream_RegDef_t S[8];	// Streams 0-7 (ch. 10.5.5 - 10.5.10)				- Address Offset: 0x10
+}DMA_RegDef_t;
+
+typedef struct {
+	__vo uint32_t CR1;		// TIMx control register 1					- Address Offset: 0x00
+	__vo uint32_t CR2;		// TIMx control register 2					- Address Offset: 0x04
+	__vo uint32_t SMCR;		// TIMx slave mode control register			- Address Offset: 0x08
+	__vo uint32_t DIER;		// TIMx DMA/interrupt enable register		- Address Offset: 0x0C
+	__vo uint32_t SR;		// TIMx status register						- Address Offset: 0x10
+	__vo uint32_t EGR;		// TIMx event generation register			- Address Offset: 0x14
+	__vo uint32_t CCMR1;	// TIMx capture/compare mode register 1		- Address Offset: 0x18
+	__vo uint32_t CCMR2;	// TIMx capture/compare mode register 2		- Address Offset: 0x1C
+	__vo uint32_t CCER;		// TIMx capture/compare enable register		- Address Offset: 0x20
+	__vo uint32_t CNT;		// TIMx counter								- Address Offset: 0x24
+	__vo uint32_t PSC;		// TIMx prescaler							- Address Offset: 0x28
+	__vo uint32_t ARR;		// TIMx auto-reload register				- Address Offset: 0x2C
+	__vo uint32_t RCR;		// TIMx repetition counter register (TIM1/8)	- Address Offset: 0x30
+	__vo uint32_t CCR[4];	// TIMx capture/compare registers 1-4		- Address Offset: 0x34 - 0x40
+	__vo uint32_t BDTR;		// TIMx break and dead-time register (TIM1/8)	- Address Offset: 0x44
+	__vo uint32_t DCR;		// TIMx DMA control register				- Address Offset: 0x48
+	__vo uint32_t DMAR;		// TIMx DMA address for full transfer		- Address Offset: 0x4C
+	__vo uint32_t OR;		// TIM2/TIM5 option register				- Address Offset: 0x50
+}TIM_RegDef_t;
+
 typedef struct {
 	__vo uint32_t CR;			// RCC clock control register 		- Address Offset: 0x00
 	__vo uint32_t PLLCFGR;		// RCC PLL configuration register 	- Address Offset: 0x04
@@ -148,6 +446,101 @@ typedef struct {
 	__vo uint32_t DCKCFGR2;		// to do - Address Offset: 0x94
 }RCC_RegDef_t;
 
+typedef struct {
+	__vo uint32_t ACR;			// Flash access control register 	- Address Offset: 0x00
+	__vo uint32_t KEYR;			// Flash key register 				- Address Offset: 0x04
+	__vo uint32_t OPTKEYR;		// Flash option key register 		- Address Offset: 0x08
+	__vo uint32_t SR;			// Flash status register 			- Address Offset: 0x0C
+	__vo uint32_t CR;			// Flash control register 			- Address Offset: 0x10
+	__vo uint32_t OPTCR;		// Flash option control register 	- Address Offset: 0x14
+}FLASH_RegDef_t;
+
+// Flash ACR bits (ch. 3.9.1)
+#define FLASH_ACR_LATENCY_MASK		(0x7U << 0)	// Wait states
+#define FLASH_ACR_PRFTEN			(1U << 8)	// Prefetch enable
+#define FLASH_ACR_ICEN				(1U << 9)	// Instruction cache enable
+#define FLASH_ACR_DCEN				(1U << 10)	// Data cache enable
+#define FLASH_ACR_ICRST				(1U << 11)	// Instruction cache reset
+#define FLASH_ACR_DCRST				(1U << 12)	// Data cache reset
+
+typedef struct {
+	__vo uint32_t CTRL;		// SysTick control and status register	- Address Offset: 0x00
+	__vo uint32_t LOAD;		// SysTick reload value register		- Address Offset: 0x04
+	__vo uint32_t VAL;		// SysTick current value register		- Address Offset: 0x08
+	__vo uint32_t CALIB;	// SysTick calibration value register	- Address Offset: 0x0C
+}SysTick_RegDef_t;
+
+typedef struct {
+	__vo uint32_t CTRL;		// DWT control register					- Address Offset: 0x00
+	__vo uint32_t CYCCNT;	// Cycle count register					- Address Offset: 0x04
+	__vo uint32_t CPICNT;	// CPI count register					- Address Offset: 0x08
+	__vo uint32_t EXCCNT;	// Exception overhead count register	- Address Offset: 0x0C
+	__vo uint32_t SLEEPCNT;	// Sleep count register					- Address Offset: 0x10
+	__vo uint32_t LSUCNT;	// LSU count register					- Address Offset: 0x14
+	__vo uint32_t FOLDCNT;	// Folded-instruction count register	- Address Offset: 0x18
+	__vo uint32_t PCSR;		// Program counter sample register		- Address Offset: 0x1C
+}DWT_RegDef_t;
+
+typedef struct {
+	__vo uint32_t SR;		// ADC status register						- Address Offset: 0x00
+	__vo uint32_t CR1;		// ADC control register 1					- Address Offset: 0x04
+	__vo uint32_t CR2;		// ADC control register 2					- Address Offset: 0x08
+	__vo uint32_t SMPR1;	// ADC sample time register 1 (ch. 10-18)	- Address Offset: 0x0C
+	__vo uint32_t SMPR2;	// ADC sample time register 2 (ch. 0-9)		- Address Offset: 0x10
+	__vo uint32_t JOFR[4];	// ADC injected channel data offset 1-4		- Address Offset: 0x14 - 0x20
+	__vo uint32_t HTR;		// ADC watchdog higher threshold register	- Address Offset: 0x24
+	__vo uint32_t LTR;		// ADC watchdog lower threshold register	- Address Offset: 0x28
+	__vo uint32_t SQR1;		// ADC regular sequence register 1			- Address Offset: 0x2C
+	__vo uint32_t SQR2;		// ADC regular sequence register 2			- Address Offset: 0x30
+	__vo uint32_t SQR3;		// ADC regular sequence register 3			- Address Offset: 0x34
+	__vo uint32_t JSQR;		// ADC injected sequence register			- Address Offset: 0x38
+	__vo uint32_t JDR[4];	// ADC injected data register 1-4			- Address Offset: 0x3C - 0x48
+	__vo uint32_t DR;		// ADC regular data register				- Address Offset: 0x4C
+}ADC_RegDef_t;
+
+typedef struct {
+	__vo uint32_t CSR;		// ADC common status register				- Address Offset: 0x00
+	__vo uint32_t CCR;		// ADC common control register				- Address Offset: 0x04
+	__vo uint32_t CDR;		// ADC common regular data register (dual/triple mode)	- Address Offset: 0x08
+}ADC_Common_RegDef_t;
+
+typedef struct {
+	__vo uint32_t CR;		// PWR power control register				- Address Offset: 0x00
+	__vo uint32_t CSR;		// PWR power control/status register		- Address Offset: 0x04
+}PWR_RegDef_t;
+
+// PWR CR bits (ch. 5.4.1)
+#define PWR_CR_LPDS					(1U << 0)	// Regulator in low-power mode during Stop
+#define PWR_CR_PDDS					(1U << 1)	// Standby instead of Stop on deep sleep
+#define PWR_CR_CWUF					(1U << 2)	// Clears the wakeup flag
+#define PWR_CR_FPDS					(1U << 9)	// Flash in power-down during Stop
+
+#define DWT_CTRL_CYCCNTENA			(1U << 0)	// Enables CYCCNT
+
+// SysTick CTRL bits
+#define SYSTICK_CTRL_ENABLE			(1U << 0)	// Counter enable
+#define SYSTICK_CTRL_TICKINT		(1U << 1)	// Exception request when the counter reaches 0
+#define SYSTICK_CTRL_CLKSOURCE		(1U << 2)	// 1: processor clock, 0: processor clock / 8
+#define SYSTICK_CTRL_COUNTFLAG		(1U << 16)	// Counter reached 0 since last read
+#define SYSTICK_LOAD_MAX			0x00FFFFFFU	// 24 bit counter
+
+typedef struct {
+	__vo uint32_t IMR;		// Interrupt mask register				- Address Offset: 0x00
+	__vo uint32_t EMR;		// Event mask register					- Address Offset: 0x04
+	__vo uint32_t RTSR;		// Rising trigger selection register	- Address Offset: 0x08
+	__vo uint32_t FTSR;		// Falling trigger selection register	- Address Offset: 0x0C
+	__vo uint32_t SWIER;	// Software interrupt event register	- Address Offset: 0x10
+	__vo uint32_t PR;		// Pending register (write 1 to clear)	- Address Offset: 0x14
+}EXTI_RegDef_t;
+
+typedef struct {
+	__vo uint32_t MEMRMP;		// SYSCFG memory remap register 						- Address Offset: 0x00
+	__vo uint32_t PMC;			// SYSCFG peripheral mode configuration register 		- Address Offset: 0x04
+	__vo uint32_t EXTICR[4];	// SYSCFG external interrupt configuration registers 1-4 - Address Offset: 0x08 - 0x14
+	uint32_t RESERVED1[2];		// RESERVED - Address Offset: 0x18 and 0x1C
+	__vo uint32_t CMPCR;		// Compensation cell control register 					- Address Offset: 0x20
+}SYSCFG_RegDef_t;
+
 // Peripheral definition (Peripheral base addresses typecasted to xxx_RegDef_t)
 #define GPIOA 		((GPIO_RegDef_t*) GPIOA_BASEADDR)
 #define GPIOB 		((GPIO_RegDef_t*) GPIOB_BASEADDR)
@@ -160,37 +553,161 @@ typedef struct {
 #define GPIOI 		((GPIO_RegDef_t*) GPIOI_BASEADDR)
 
 #define RCC			((RCC_RegDef_t*)RCC_BASEADDR)
+#define FLASH		((FLASH_RegDef_t*)FLASH_INTF_BASEADDR)
+#define EXTI		((EXTI_RegDef_t*)EXTI_BASE)
+#define SYSTICK		((SysTick_RegDef_t*)SYSTICK_BASEADDR)
+#define DWT			((DWT_RegDef_t*)DWT_BASEADDR)
+#define PWR			((PWR_RegDef_t*)PWR_BASEADDR)
+#define SYSCFG		((SYSCFG_RegDef_t*)SYSCFG_BASE)
+
+#define SPI1		((SPI_RegDef_t*)SPI1_BASE)
+#define SPI2		((SPI_RegDef_t*)SPI2_BASEADDR)
+#define SPI3		((SPI_RegDef_t*)SPI3_BASEADDR)
+
+#define I2C1		((I2C_RegDef_t*)I2C1_BASEADDR)
+#define I2C2		((I2C_RegDef_t*)I2C2_BASEADDR)
+#define I2C3		((I2C_RegDef_t*)I2C3_BASEADDR)
+
+#define USART1		((USART_RegDef_t*)USART1_BASE)
+#define USART2		((USART_RegDef_t*)USART2_BASEADDR)
+#define USART3		((USART_RegDef_t*)USART3_BASEADDR)
+#define UART4		((USART_RegDef_t*)UART4_BASEADDR)
+#define UART5		((USART_RegDef_t*)UART5_BASEADDR)
+#define USART6		((USART_RegDef_t*)USART6_BASE)
+
+#define DMA1		((DMA_RegDef_t*)DMA1_BASEADDR)
+#define DMA2		((DMA_RegDef_t*)DMA2_BASEADDR)
+
+#define TIM1		((TIM_RegDef_t*)TIM1_BASEADDR)
+#define TIM2		((TIM_RegDef_t*)TIM2_BASEADDR)
+#define TIM3		((TIM_RegDef_t*)TIM3_BASEADDR)
+#define TIM4		((TIM_RegDef_t*)TIM4_BASEADDR)
+#define TIM5		((TIM_RegDef_t*)TIM5_BASEADDR)
+#define TIM6		((TIM_RegDef_t*)TIM6_BASEADDR)
+#define TIM7		((TIM_RegDef_t*)TIM7_BASEADDR)
+#define TIM8		((TIM_RegDef_t*)TIM8_BASEADDR)
+
+#define ADC1		((ADC_RegDef_t*)ADC1_BASEADDR)
+#define ADC2		((ADC_RegDef_t*)ADC2_BASEADDR)
+#define ADC3		((ADC_RegDef_t*)ADC3_BASEADDR)
+#define ADC_COMMON	((ADC_Common_RegDef_t*)ADC_COMMON_BASEADDR)
+
+// Port code of a GPIO port, A = 0 ... I = 8. The ports are 1 KB (0x400) apart on the AHB1 bus,
+// so the code is the offset from the bus base shifted right by 10. The code is also the bit
+// position of the port in RCC AHB1ENR, AHB1RSTR and AHB1LPENR (ch. 7.3.10), so no lookup is needed.
+#define GPIO_BASEADDR_TO_CODE(x)	( (uint32_t)( ((uintptr_t)(x) - AHB1PERIPH_BASEADDR) >> 10 ) )
+#define GPIO_PORT_COUNT				9	// GPIOA ... GPIOI
 
 // Clock Enable Macros for GPIOx peripherals
-# define GPIOA_PCLK_EN()		( RCC->AHB1ENR |= ( 1 << 0) ) // Peripheral Clock Enabled
-# define GPIOB_PCLK_EN()		( RCC->AHB1ENR |= ( 1 << 1) ) // Peripheral Clock Enabled (see ch. 7.3.10)
-# define GPIOC_PCLK_EN()		( RCC->AHB1ENR |= ( 1 << 1) )
-# define GPIOD_PCLK_EN()		( RCC->AHB1ENR |= ( 1 << 1) )
-# define GPIOE_PCLK_EN()		( RCC->AHB1ENR |= ( 1 << 1) )
-# define GPIOF_PCLK_EN()		( RCC->AHB1ENR |= ( 1 << 1) )
-# define GPIOG_PCLK_EN()		( RCC->AHB1ENR |= ( 1 << 1) )
-# define GPIOH_PCLK_EN()		( RCC->AHB1ENR |= ( 1 << 1) )
-# define GPIOI_PCLK_EN()		( RCC->AHB1ENR |= ( 1 << 1) )
+# define GPIOA_PCLK_EN()		REG_BB_SET(RCC->AHB1ENR, 0) // Peripheral Clock Enabled
+# define GPIOB_PCLK_EN()		REG_BB_SET(RCC->AHB1ENR, 1) // Peripheral Clock Enabled (see ch. 7.3.10)
+# define GPIOC_PCLK_EN()		REG_BB_SET(RCC->AHB1ENR, 2)
+# define GPIOD_PCLK_EN()		REG_BB_SET(RCC->AHB1ENR, 3)
+# define GPIOE_PCLK_EN()		REG_BB_SET(RCC->AHB1ENR, 4)
+# define GPIOF_PCLK_EN()		REG_BB_SET(RCC->AHB1ENR, 5)
+# define GPIOG_PCLK_EN()		REG_BB_SET(RCC->AHB1ENR, 6)
+# define GPIOH_PCLK_EN()		REG_BB_SET(RCC->AHB1ENR, 7)
+# define GPIOI_PCLK_EN()		REG_BB_SET(RCC->AHB1ENR, 8)
 // Clock Enable Macros for I2Cx peripherals
-# define I2C1_PCLK_EN()			( RCC->APB1ENR |= ( 1 << 21) ) //I2C1 Enable is bit 21 (see ch. 7.3.13)
+# define I2C1_PCLK_EN()			REG_BB_SET(RCC->APB1ENR, 21) //I2C1 Enable is bit 21 (see ch. 7.3.13)
+# define I2C2_PCLK_EN()			REG_BB_SET(RCC->APB1ENR, 22)
+# define I2C3_PCLK_EN()			REG_BB_SET(RCC->APB1ENR, 23)
 // Clock Enable Macros for SPIx peripherals
-# define SPI1_PCLK_EN()			( RCC->APB2ENR |= ( 1 << 12) )
+# define SPI1_PCLK_EN()			REG_BB_SET(RCC->APB2ENR, 12)
+# define SPI2_PCLK_EN()			REG_BB_SET(RCC->APB1ENR, 14)
+# define SPI3_PCLK_EN()			REG_BB_SET(RCC->APB1ENR, 15)
 // Clock Enable Macros for USARTx peripherals
-# define USART1_PCLK_EN()			( RCC->APB2ENR |= ( 1 << 4) )
+# define USART1_PCLK_EN()			REG_BB_SET(RCC->APB2ENR, 4)
+# define USART2_PCLK_EN()			REG_BB_SET(RCC->APB1ENR, 17)
+# define USART3_PCLK_EN()			REG_BB_SET(RCC->APB1ENR, 18)
+# define UART4_PCLK_EN()			REG_BB_SET(RCC->APB1ENR, 19)
+# define UART5_PCLK_EN()			REG_BB_SET(RCC->APB1ENR, 20)
+# define USART6_PCLK_EN()			REG_BB_SET(RCC->APB2ENR, 5)
 // Clock Enable Macros for SYSCFG peripherals
-# define SYSCFG_PCLK_EN()			( RCC->APB2ENR |= ( 1 << 14) )
+# define SYSCFG_PCLK_EN()			REG_BB_SET(RCC->APB2ENR, 14)
+// Clock Enable Macros for DMAx peripherals (see ch. 7.3.10)
+# define DMA1_PCLK_EN()				REG_BB_SET(RCC->AHB1ENR, 21)
+# define DMA2_PCLK_EN()				REG_BB_SET(RCC->AHB1ENR, 22)
 
 // Clock Disable Macros for GPIOx peripherals
 // Remember we use bitwise or to set a bit. We use bitwise and to reset a bit.
 // Use negation symbol, ~ (NOT). Now we have a way to clear a bit.
-# define GPIOA_PCLK_DI()			( RCC->AHB1ENR &= ~( 1 << 0) )
+# define GPIOA_PCLK_DI()			REG_BB_CLR(RCC->AHB1ENR, 0)
+# define GPIOB_PCLK_DI()			REG_BB_CLR(RCC->AHB1ENR, 1)
+# define GPIOC_PCLK_DI()			REG_BB_CLR(RCC->AHB1ENR, 2)
+# define GPIOD_PCLK_DI()			REG_BB_CLR(RCC->AHB1ENR, 3)
+# define GPIOE_PCLK_DI()			REG_BB_CLR(RCC->AHB1ENR, 4)
+# define GPIOF_PCLK_DI()			REG_BB_CLR(RCC->AHB1ENR, 5)
+# define GPIOG_PCLK_DI()			REG_BB_CLR(RCC->AHB1ENR, 6)
+# define GPIOH_PCLK_DI()			REG_BB_CLR(RCC->AHB1ENR, 7)
+# define GPIOI_PCLK_DI()			REG_BB_CLR(RCC->AHB1ENR, 8)
+// Clock Disable Macros for I2Cx peripherals
+# define I2C1_PCLK_DI()			REG_BB_CLR(RCC->APB1ENR, 21)
+# define I2C2_PCLK_DI()			REG_BB_CLR(RCC->APB1ENR, 22)
+# define I2C3_PCLK_DI()			REG_BB_CLR(RCC->APB1ENR, 23)
+// Clock Disable Macros for SPIx peripherals
+# define SPI1_PCLK_DI()			REG_BB_CLR(RCC->APB2ENR, 12)
+# define SPI2_PCLK_DI()			REG_BB_CLR(RCC->APB1ENR, 14)
+# define SPI3_PCLK_DI()			REG_BB_CLR(RCC->APB1ENR, 15)
+// Clock Disable Macros for USARTx peripherals
+# define USART1_PCLK_DI()			REG_BB_CLR(RCC->APB2ENR, 4)
+# define USART2_PCLK_DI()			REG_BB_CLR(RCC->APB1ENR, 17)
+# define USART3_PCLK_DI()			REG_BB_CLR(RCC->APB1ENR, 18)
+# define UART4_PCLK_DI()			REG_BB_CLR(RCC->APB1ENR, 19)
+# define UART5_PCLK_DI()			REG_BB_CLR(RCC->APB1ENR, 20)
+# define USART6_PCLK_DI()			REG_BB_CLR(RCC->APB2ENR, 5)
+// Clock Disable Macros for SYSCFG peripherals
+# define SYSCFG_PCLK_DI()			REG_BB_CLR(RCC->APB2ENR, 14)
+// Clock Disable Macros for DMAx peripherals
+# define DMA1_PCLK_DI()				REG_BB_CLR(RCC->AHB1ENR, 21)
+# define DMA2_PCLK_DI()				REG_BB_CLR(RCC->AHB1ENR, 22)
 
 // Macros to reset GPIOx peripherals
 // How to include two statements in 1 single macro? The trick is to use do-while loop
 // This is a technique in C to execute multiple C statements using single C macro
-#define GPIOA_REG_RESET()			do{ ( RCC->AHB1RSTR |= ( 1 << 0) );  (RCC->AHB1RSTR &= ~(1 << 0)); }while(0) //no need for semicolon here, it will be done later
-#define GPIOB_REG_RESET()			do{ ( RCC->AHB1RSTR |= ( 1 << 1) );  (RCC->AHB1RSTR &= ~(1 << 1)); }while(0)
-#define GPIOC_REG_RESET()			do{ ( RCC->AHB1RSTR |= ( 1 << 2) );  (RCC->AHB1RSTR &= ~(1 << 2)); }while(0)
+#define GPIOA_REG_RESET()			do{ REG_BB_SET(RCC->AHB1RSTR, 0);  REG_BB_CLR(RCC->AHB1RSTR, 0); }while(0) //no need for semicolon here, it will be done later
+#define GPIOB_REG_RESET()			do{ REG_BB_SET(RCC->AHB1RSTR, 1);  REG_BB_CLR(RCC->AHB1RSTR, 1); }while(0)
+#define GPIOC_REG_RESET()			do{ REG_BB_SET(RCC->AHB1RSTR, 2);  REG_BB_CLR(RCC->AHB1RSTR, 2); }while(0)
+#define GPIOD_REG_RESET()			do{ REG_BB_SET(RCC->AHB1RSTR, 3);  REG_BB_CLR(RCC->AHB1RSTR, 3); }while(0)
+#define GPIOE_REG_RESET()			do{ REG_BB_SET(RCC->AHB1RSTR, 4);  REG_BB_CLR(RCC->AHB1RSTR, 4); }while(0)
+#define GPIOF_REG_RESET()			do{ REG_BB_SET(RCC->AHB1RSTR, 5);  REG_BB_CLR(RCC->AHB1RSTR, 5); }while(0)
+#define GPIOG_REG_RESET()			do{ REG_BB_SET(RCC->AHB1RSTR, 6);  REG_BB_CLR(RCC->AHB1RSTR, 6); }while(0)
+#define GPIOH_REG_RESET()			do{ REG_BB_SET(RCC->AHB1RSTR, 7);  REG_BB_CLR(RCC->AHB1RSTR, 7); }while(0)
+#define GPIOI_REG_RESET()			do{ REG_BB_SET(RCC->AHB1RSTR, 8);  REG_BB_CLR(RCC->AHB1RSTR, 8); }while(0)
+
+// IRQ (Interrupt Request) numbers of the STM32F407x MCU (vector table, ch. 12.2)
+#define IRQ_NO_EXTI0				6
+#define IRQ_NO_EXTI1				7
+#define IRQ_NO_EXTI2				8
+#define IRQ_NO_EXTI3				9
+#define IRQ_NO_EXTI4				10
+#define IRQ_NO_EXTI9_5				23
+#define IRQ_NO_EXTI15_10			40
+#define IRQ_NO_DMA1_STREAM0			11	// DMA1 streams 0-6 are 11-17
+#define IRQ_NO_DMA1_STREAM7			47
+#define IRQ_NO_DMA2_STREAM0			56	// DMA2 streams 0-4 are 56-60
+#define IRQ_NO_DMA2_STREAM5			68	// DMA2 streams 5-7 are 68-70
+#define IRQ_NO_SPI1					35
+#define IRQ_NO_SPI2					36
+#define IRQ_NO_SPI3					51
+#define IRQ_NO_I2C1_EV				31
+#define IRQ_NO_I2C1_ER				32
+#define IRQ_NO_I2C2_EV				33
+#define IRQ_NO_I2C2_ER				34
+#define IRQ_NO_I2C3_EV				72
+#define IRQ_NO_I2C3_ER				73
+#define IRQ_NO_TIM2					28	// TIM2 - TIM4 are 28 - 30
+#define IRQ_NO_TIM5					50
+#define IRQ_NO_USART1				37
+#define IRQ_NO_USART2				38
+#define IRQ_NO_USART3				39
+#define IRQ_NO_UART4				52
+#define IRQ_NO_UART5				53
+#define IRQ_NO_USART6				71
+
+// NVIC priority levels, 0 is the highest
+#define NVIC_IRQ_PRI0				0
+#define NVIC_IRQ_PRI15				15
 
 // Some generic macros
 
@@ -201,5 +718,30 @@ typedef struct {
 #define GPIO_PIN_SET	SET
 #define GPIO_PIN_RESET	RESET
 
+#ifdef STM32F407XX_SIM
+#include "stm32f407xx_sim.h"
+#endif
+
+// Drivers
+#include "stm32f407xx_gpio_driver.h"
+#include "stm32f407xx_rcc_driver.h"
+#include "stm32f407xx_flash_driver.h"
+#include "stm32f407xx_mem.h"
+#include "stm32f407xx_startup.h"
+#include "stm32f407xx_timebase.h"
+#include "stm32f407xx_profiler.h"
+#include "stm32f407xx_ring.h"
+#include "stm32f407xx_dma_driver.h"
+#include "stm32f407xx_tim_driver.h"
+#include "stm32f407xx_patgen.h"
+#include "stm32f407xx_capture.h"
+#include "stm32f407xx_debounce.h"
+#include "stm32f407xx_encoder.h"
+#include "stm32f407xx_softpwm.h"
+#include "stm32f407xx_pbus.h"
+#include "stm32f407xx_adc_driver.h"
+#include "stm32f407xx_spi_driver.h"
+#include "stm32f407xx_usart_driver.h"
+#include "stm32f407xx_i2c_driver.h"
 
 #endif /* INC_STM32F407XX_H_ */
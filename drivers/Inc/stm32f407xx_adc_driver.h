@@ -0,0 +1,172 @@
+/*
+ * stm32f407xx_adc_driver.h
+ *
+ *  Created on: Mar 12, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_ADC_DRIVER_H_
+#define INC_STM32F407XX_ADC_DRIVER_H_
+
+#include "stm32f407xx.h"
+
+// Continuous multi-channel ADC scan with per-channel filters.
+//
+// TIM2, TIM3 or TIM8 starts a scan of all the channels at ScanRateHz (its update event on
+// TRGO), the DMA stores the 12 bit results in a double buffer: a frame of FrameScans scans
+// in memory 0 while memory 1 is processed, and the other way round. Samples in a frame are
+// interleaved, scan 0 channel 0, scan 0 channel 1, ...
+//
+// At the end of each frame the DMA interrupt runs ADC_ProcessFrame on the frame just done:
+//	1. de-interleave: one block of int16_t samples per channel, Offset[] added with saturation
+//	   (e.g. -2048 gives a signed sample around mid scale)
+//	2. the filter of each channel on its block (moving average, FIR or biquad)
+//	3. the callback with one pointer per channel to the FrameScans filtered samples
+// The filter state is carried from one frame to the next, so the output is a continuous
+// stream. The callback runs in the DMA interrupt and has to be done before the next frame
+// ends; the buffers it gets are overwritten by the next frame.
+//
+// Processing has two paths with the same results, bit for bit:
+//	- ADC_PATH_SIMD (default) uses the DSP instructions of the Cortex-M4: QADD16 adds the
+//	  offsets of two channels with one instruction, SMLAD does two multiply-accumulates of
+//	  the FIR and the biquad per cycle.
+//	- ADC_PATH_SCALAR does one sample and one product at a time in plain C, as a reference
+//	  and for comparing the speed (ADC_GetCyclesPerKSample).
+// The accumulators of both wrap at 32 bits, keep the sum of the absolute FIR taps below 2.0
+// (65536) and the biquad gains reasonable to stay clear of it.
+//
+// Channel pins are set to analog mode by ADC_Init. Channels 16 (temperature), 17 (VREFINT)
+// and 18 (VBAT) are internal and on ADC1 only.
+
+#define ADC_MAX_CHANNELS			8
+#define ADC_MAX_FRAME_SCANS			128
+#define ADC_FIR_MAX_TAPS			32
+#define ADC_MOVAVG_MAX_SHIFT		5		// Window of up to 32 samples
+#define ADC_CLOCK_MAX_HZ			36000000U	// Highest ADCCLK, VDDA 2.4 - 3.6 V
+
+// Status codes
+#define ADC_OK						0
+#define ADC_ERR_CONFIG				1	// Bad ADC, channel, timer, buffer or filter, DMA stream in use
+#define ADC_ERR_RATE				2	// Timer can not make the scan rate or the ADC is too slow for it
+
+// @ADC_SAMPLE_TIME, in ADC clock cycles. A conversion is the sample time + 12 cycles.
+#define ADC_SMP_3					0
+#define ADC_SMP_15					1
+#define ADC_SMP_28					2
+#define ADC_SMP_56					3
+#define ADC_SMP_84					4
+#define ADC_SMP_112					5
+#define ADC_SMP_144					6
+#define ADC_SMP_480					7
+
+// @ADC_FILTER
+#define ADC_FILTER_NONE				0
+#define ADC_FILTER_MOVAVG			1	// Mean of the last 2^Length samples
+#define ADC_FILTER_FIR				2	// Length Q15 taps
+#define ADC_FILTER_BIQUAD			3	// Direct form I, Q14 coefficients
+
+// @ADC_PATH
+#define ADC_PATH_SIMD				0
+#define ADC_PATH_SCALAR				1
+
+// ADC control register 1 and 2 bits (ch. 13.13.2 and 13.13.3)
+#define ADC_CR1_SCAN				(1U << 8)
+#define ADC_CR2_ADON				(1U << 0)
+#define ADC_CR2_DMA					(1U << 8)
+#define ADC_CR2_DDS					(1U << 9)	// DMA requests go on after the last transfer (circular DMA)
+#define ADC_CR2_EXTSEL_POS			24
+#define ADC_CR2_EXTEN_RISING		(1U << 28)
+#define ADC_SR_OVR					(1U << 5)
+
+// External trigger of the regular channels, EXTSEL values
+#define ADC_EXTSEL_TIM2_TRGO		6
+#define ADC_EXTSEL_TIM3_TRGO		8
+#define ADC_EXTSEL_TIM8_TRGO		14
+
+// ADC common control register (ch. 13.13.16)
+#define ADC_CCR_ADCPRE_POS			16	// PCLK2 divided by 2, 4, 6 or 8
+#define ADC_CCR_VBATE				(1U << 22)
+#define ADC_CCR_TSVREFE				(1U << 23)
+
+// Filtered samples of a frame, ppChannels[c] points to Count samples of channel c
+typedef void (*ADC_Callback_t)(void *pArg, const int16_t * const *ppChannels, uint32_t Count);
+
+// Filter of one channel. Type, Length and Coeffs are set by the caller before ADC_Init,
+// the rest belongs to the driver.
+typedef struct
+{
+	uint8_t Type;							// @ADC_FILTER
+	uint8_t Length;							// FIR: taps 1 - ADC_FIR_MAX_TAPS, moving average: 0 - ADC_MOVAVG_MAX_SHIFT
+	int16_t Coeffs[ADC_FIR_MAX_TAPS];		// FIR: h[0] (newest sample) first. Biquad: b0, b1, b2, a1, a2 (a1 not -2.0)
+
+	uint8_t Delay;							// Inputs of one frame the next one needs
+	uint8_t Pairs;							// FIR: words in Packed
+	uint32_t Packed[ADC_FIR_MAX_TAPS / 2];	// FIR: taps oldest first, two per word, a 0 in front of an odd count
+	int16_t History[ADC_FIR_MAX_TAPS];		// Last Delay inputs of the previous frame
+	int32_t Sum;							// Moving average: sum of the window
+	int16_t State[4];						// Biquad: x[n-1], x[n-2], y[n-1], y[n-2]
+}ADC_Filter_t;
+
+typedef struct
+{
+	ADC_RegDef_t *pADCx;					// ADC1, ADC2 or ADC3
+	const uint8_t *pChannels;				// Scan order, channels 0 - 18
+	uint8_t ChannelCount;					// 1 - ADC_MAX_CHANNELS
+	uint8_t SampleTime;						// @ADC_SAMPLE_TIME, for all the channels
+	uint8_t Path;							// @ADC_PATH
+	uint8_t IRQPriority;					// Of the DMA stream
+	int16_t Offset[ADC_MAX_CHANNELS];		// Added to the samples of each channel
+
+	TIM_RegDef_t *pTIMx;					// TIM2, TIM3 or TIM8
+	uint32_t TimerClockHz;					// Input clock of the timer
+	uint32_t ScanRateHz;					// Samples per second of each channel
+
+	uint16_t *pBuffer;						// DMA buffer of 2 x FrameScans x ChannelCount half-words
+	uint16_t FrameScans;					// 1 - ADC_MAX_FRAME_SCANS
+
+	ADC_Callback_t pCallback;				// May be NULL
+	void *pArg;
+}ADC_Config_t;
+
+typedef struct
+{
+	ADC_Config_t Config;
+	ADC_Filter_t Filter[ADC_MAX_CHANNELS];
+
+	// Set by ADC_Init
+	int16_t Work[ADC_MAX_CHANNELS][ADC_FIR_MAX_TAPS + ADC_MAX_FRAME_SCANS];	// Filter history, then the frame
+	const int16_t *pOut[ADC_MAX_CHANNELS];	// Filtered samples of each channel in Work
+	uint32_t ScanRateHz;					// Actual rate of the timer
+	uint8_t Stream;							// DMA2 stream of the ADC
+	uint8_t DMAChannel;
+	uint8_t Running;
+	uint8_t LastBuffer;						// Memory (0 or 1) of the last frame processed
+
+	// Statistics
+	uint32_t Frames;
+	uint32_t Overruns;						// Frames lost or overwritten while processed
+	uint64_t ProcessedSamples;
+	uint64_t ProcessCycles;					// DWT cycles in ADC_ProcessFrame, without the callback
+}ADC_Handle_t;
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+// Init and control
+uint8_t ADC_Init(ADC_Handle_t *pHandle);
+void ADC_DeInit(ADC_Handle_t *pHandle);
+void ADC_Start(ADC_Handle_t *pHandle);
+void ADC_Stop(ADC_Handle_t *pHandle);
+void ADC_ResetFilters(ADC_Handle_t *pHandle);				// Clears the filter history, not while running
+
+// Processing, also usable on its own (e.g. on recorded frames)
+void ADC_ProcessFrame(ADC_Handle_t *pHandle, const uint16_t *pFrame);
+
+// Statistics
+uint32_t ADC_GetSampleRate(const ADC_Handle_t *pHandle);		// Samples per second of each channel
+uint32_t ADC_GetCyclesPerKSample(const ADC_Handle_t *pHandle);	// Processing cycles per 1000 samples, 0 before a frame
+void ADC_ResetStats(ADC_Handle_t *pHandle);
+
+#endif /* INC_STM32F407XX_ADC_DRIVER_H_ */
@@ -0,0 +1,99 @@
+/*
+ * stm32f407xx_capture.h
+ *
+ *  Created on: Dec 4, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_CAPTURE_H_
+#define INC_STM32F407XX_CAPTURE_H_
+
+#include "stm32f407xx.h"
+
+// Logic analyzer capture, samples the IDR of a port at a fixed rate and run-length compresses it.
+//
+// The update event of TIM1 or TIM8 requests a DMA2 transfer of one half-word from the IDR of
+// the port into the sample buffer (2 x HalfLength samples, circular). The half transfer and
+// transfer complete interrupts only count the filled halves. CAPTURE_Process, called from the
+// main loop, compresses every filled half into (value, run length) records and puts them in
+// the record ring, from where CAPTURE_ReadRecords streams them out.
+//
+// A mostly idle bus gives few records, e.g. 20000 records (80 KB) of SRAM1 can hold a capture
+// of millions of samples. A half that is not compressed before the DMA writes it again is
+// lost and counted in Overruns.
+//
+// Trigger: samples are dropped until (sample & TriggerMask) == TriggerPattern, the first record
+// starts with the matching sample. TriggerMask 0 starts right away.
+//
+// The patgen module can use the other timer at the same time (TIM1: DMA2 stream 5, TIM8: stream 1).
+
+// Status codes
+#define CAPTURE_OK				0
+#define CAPTURE_ERR_CONFIG		1	// Timer is not TIM1/TIM8, no buffer, a length out of range or DMA stream in use
+#define CAPTURE_ERR_RATE		2	// Sample rate can not be made with the timer clock
+
+// Longest run of one record, longer runs are split
+#define CAPTURE_RUN_MAX			0xFFFFU
+
+// One compressed record, the port had level Value for Run samples (Run >= 1)
+typedef struct
+{
+	uint16_t Value;
+	uint16_t Run;
+}CAPTURE_Record_t;
+
+typedef struct
+{
+	GPIO_RegDef_t *pGPIOx;				// Port sampled, the pins must be configured as inputs
+	TIM_RegDef_t *pTIMx;				// TIM1 or TIM8
+	uint32_t TimerClockHz;				// Input clock of the timer
+	uint32_t SampleRateHz;
+	uint16_t *pSamples;					// Sample buffer of 2 x HalfLength half-words
+	uint16_t HalfLength;				// 1 - 32767
+	CAPTURE_Record_t *pRecords;			// Record ring
+	uint32_t RecordCount;				// Records in the ring
+	uint16_t TriggerMask;
+	uint16_t TriggerPattern;
+	uint8_t IRQPriority;				// Priority of the DMA interrupt
+}CAPTURE_Config_t;
+
+typedef struct
+{
+	CAPTURE_Config_t Config;
+	uint8_t Stream;						// DMA2 stream of the timer
+	uint8_t Channel;
+	uint8_t Running;
+	uint8_t Triggered;
+	__vo uint32_t FilledHalves;			// Counted by the DMA interrupt
+	uint32_t ProcessedHalves;
+	uint16_t RunValue;					// Run that is not written to a record yet
+	uint32_t RunLength;
+	uint32_t SampleCount;				// Samples compressed or dropped before the trigger
+	uint32_t TriggerSample;				// Sample number of the trigger
+	uint32_t Head;						// Records written, the ring index is Head % RecordCount
+	uint32_t Tail;						// Records read
+	uint32_t Overruns;					// Halves lost because they were not processed in time
+	uint32_t RecordsDropped;			// Records lost because the ring was full
+}CAPTURE_Handle_t;
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+// Init and control
+uint8_t CAPTURE_Init(CAPTURE_Handle_t *pHandle);
+void CAPTURE_DeInit(CAPTURE_Handle_t *pHandle);
+void CAPTURE_Start(CAPTURE_Handle_t *pHandle);
+void CAPTURE_Stop(CAPTURE_Handle_t *pHandle);		// Compresses the last samples and the open run
+
+// Background stage and export
+void CAPTURE_Process(CAPTURE_Handle_t *pHandle);
+uint32_t CAPTURE_ReadRecords(CAPTURE_Handle_t *pHandle, CAPTURE_Record_t *pOut, uint32_t MaxRecords);
+
+// Compressor, also usable on its own (e.g. on a recorded trace)
+void CAPTURE_Reset(CAPTURE_Handle_t *pHandle);		// Clears trigger, run and record ring
+void CAPTURE_Compress(CAPTURE_Handle_t *pHandle, const uint16_t *pSamples, uint32_t Count);
+void CAPTURE_Flush(CAPTURE_Handle_t *pHandle);		// Writes the open run as a record
+
+#endif /* INC_STM32F407XX_CAPTURE_H_ */
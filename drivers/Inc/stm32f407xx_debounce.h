@@ -0,0 +1,62 @@
+/*
+ * stm32f407xx_debounce.h
+ *
+ *  Created on: Dec 11, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_DEBOUNCE_H_
+#define INC_STM32F407XX_DEBOUNCE_H_
+
+#include "stm32f407xx.h"
+
+// Debounce of all 16 pins of a port at once with vertical counters.
+//
+// Every pin has a small counter, but the counters are stored "vertically": Count[0] holds
+// bit 0 of the counters of all 16 pins, Count[1] bit 1 and so on. A tick then updates all
+// counters with a few AND/XOR operations per counter bit, no matter how many pins are used.
+//
+// A pin that reads different from its debounced state for StableCount ticks in a row takes
+// the new state, a single sample equal to the debounced state restarts its count.
+//
+// Call DEBOUNCE_Tick periodically (e.g. every 1 - 5 ms from a TIMEBASE timer) for each port.
+
+// Counter bits per pin, StableCount can be 1 - (2^bits - 1)
+#define DEBOUNCE_COUNTER_BITS		4
+#define DEBOUNCE_STABLE_MAX			((1U << DEBOUNCE_COUNTER_BITS) - 1)
+
+// Status codes
+#define DEBOUNCE_OK					0
+#define DEBOUNCE_ERR_CONFIG			1	// StableCount out of range
+
+typedef struct
+{
+	GPIO_RegDef_t *pGPIOx;			// Port, the pins must be configured as inputs
+	uint16_t PinMask;				// Pins debounced, @GPIO_PIN_MASKS
+	uint16_t ActiveLow;				// Pins that are pressed when low (button to ground)
+	uint8_t StableCount;			// Ticks a new level must be stable, 1 - DEBOUNCE_STABLE_MAX
+}DEBOUNCE_Config_t;
+
+typedef struct
+{
+	DEBOUNCE_Config_t Config;
+	uint16_t State;							// Debounced state, 1 = pressed
+	uint16_t Count[DEBOUNCE_COUNTER_BITS];	// Vertical counters, bit plane i of all pins
+	uint8_t Bits;							// Counter bits needed for StableCount
+	uint16_t Pressed;						// Pins pressed in the last tick
+	uint16_t Released;						// Pins released in the last tick
+	uint16_t Changed;						// Pressed | Released
+}DEBOUNCE_Handle_t;
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+uint8_t DEBOUNCE_Init(DEBOUNCE_Handle_t *pHandle);
+uint16_t DEBOUNCE_Tick(DEBOUNCE_Handle_t *pHandle);						// Reads the port, returns Changed
+uint16_t DEBOUNCE_Update(DEBOUNCE_Handle_t *pHandle, uint16_t Sample);	// Same with a given port sample
+
+#define DEBOUNCE_GetState(pHandle)		((pHandle)->State)
+
+#endif /* INC_STM32F407XX_DEBOUNCE_H_ */
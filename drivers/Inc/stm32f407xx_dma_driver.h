@@ -0,0 +1,128 @@
+/*
+ * stm32f407xx_dma_driver.h
+ *
+ *  Created on: Nov 27, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_DMA_DRIVER_H_
+#define INC_STM32F407XX_DMA_DRIVER_H_
+
+#include "stm32f407xx.h"
+
+// Note: only DMA2 can reach the AHB1 peripherals (GPIO) and do memory-to-memory transfers,
+// the peripheral port of DMA1 is connected to APB1 only (ch. 10.3.2).
+//
+// A stream is used by one driver at a time. DMA_RegisterCallback refuses a stream that has the
+// callback of another driver, so two drivers whose requests share a stream (ch. 10.3.3, tables
+// 42 and 43) fail at init instead of taking each other's interrupts.
+
+typedef struct
+{
+	uint8_t Channel;		// Request channel 0 - 7 of the stream (ch. 10.3.3, tables 42 and 43)
+	uint8_t Direction;		// Possible values from @DMA_DIRECTION
+	uint8_t PeriphSize;		// Possible values from @DMA_SIZE
+	uint8_t MemSize;		// Possible values from @DMA_SIZE
+	uint8_t PeriphInc;		// ENABLE or DISABLE
+	uint8_t MemInc;			// ENABLE or DISABLE
+	uint8_t Circular;		// ENABLE or DISABLE
+	uint8_t DoubleBuffer;	// ENABLE or DISABLE, switches between memory 0 and 1 (implies circular)
+	uint8_t Priority;		// Possible values from @DMA_PRIORITY
+	uint8_t Interrupts;		// Possible values from @DMA_FLAGS, combined with bitwise or
+}DMA_StreamConfig_t;
+
+// Callback from the stream interrupt, Flags are the @DMA_FLAGS that were set (already cleared)
+typedef void (*DMA_Callback_t)(void *pArg, uint8_t Flags);
+
+// @DMA_DIRECTION
+#define DMA_DIR_P2M				0	// Peripheral to memory
+#define DMA_DIR_M2P				1	// Memory to peripheral
+#define DMA_DIR_M2M				2	// Memory to memory (DMA2 only)
+
+// @DMA_SIZE
+#define DMA_SIZE_BYTE			0
+#define DMA_SIZE_HALFWORD		1
+#define DMA_SIZE_WORD			2
+
+// @DMA_PRIORITY
+#define DMA_PRIORITY_LOW		0
+#define DMA_PRIORITY_MEDIUM		1
+#define DMA_PRIORITY_HIGH		2
+#define DMA_PRIORITY_VERY_HIGH	3
+
+// Stream interrupt flags, in the same order as in LISR/HISR for stream 0
+// @DMA_FLAGS
+#define DMA_FLAG_FE				(1U << 0)	// FIFO error
+#define DMA_FLAG_DME			(1U << 2)	// Direct mode error
+#define DMA_FLAG_TE				(1U << 3)	// Transfer error
+#define DMA_FLAG_HT				(1U << 4)	// Half transfer
+#define DMA_FLAG_TC				(1U << 5)	// Transfer complete
+#define DMA_FLAG_ALL			(DMA_FLAG_FE | DMA_FLAG_DME | DMA_FLAG_TE | DMA_FLAG_HT | DMA_FLAG_TC)
+
+// DMA stream configuration register bits (ch. 10.5.5)
+#define DMA_SxCR_EN				(1U << 0)
+#define DMA_SxCR_DMEIE			(1U << 1)
+#define DMA_SxCR_TEIE			(1U << 2)
+#define DMA_SxCR_HTIE			(1U << 3)
+#define DMA_SxCR_TCIE			(1U << 4)
+#define DMA_SxCR_DIR_POS		6
+#define DMA_SxCR_CIRC			(1U << 8)
+#define DMA_SxCR_PINC			(1U << 9)
+#define DMA_SxCR_MINC			(1U << 10)
+#define DMA_SxCR_PSIZE_POS		11
+#define DMA_SxCR_MSIZE_POS		13
+#define DMA_SxCR_PL_POS			16
+#define DMA_SxCR_DBM			(1U << 18)
+#define DMA_SxCR_CT				(1U << 19)	// Current target, 0: memory 0, 1: memory 1
+#define DMA_SxCR_CHSEL_POS		25
+
+// Status codes
+#define DMA_OK					0
+#define DMA_ERR_BUSY			1	// The stream has a callback of another driver
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+// Peripheral clock setup
+void DMA_PeriClockControl(DMA_RegDef_t *pDMAx, uint8_t EnorDi);
+void DMA_SleepClockControl(DMA_RegDef_t *pDMAx, uint8_t EnorDi);		// While a stream runs
+
+// Stream setup and control
+void DMA_StreamInit(DMA_RegDef_t *pDMAx, uint8_t Stream, const DMA_StreamConfig_t *pConfig);
+void DMA_StreamSetAddress(DMA_RegDef_t *pDMAx, uint8_t Stream, __vo void *pPeriph, void *pMem0, void *pMem1, uint16_t Count);
+void DMA_StreamEnable(DMA_RegDef_t *pDMAx, uint8_t Stream);
+void DMA_StreamDisable(DMA_RegDef_t *pDMAx, uint8_t Stream);	// Waits until the stream has stopped
+uint16_t DMA_GetRemaining(DMA_RegDef_t *pDMAx, uint8_t Stream);	// NDTR, items left in the current buffer
+uint8_t DMA_GetCurrentTarget(DMA_RegDef_t *pDMAx, uint8_t Stream);	// Double buffer mode: memory 0 or 1
+
+// Flags
+uint8_t DMA_GetFlags(DMA_RegDef_t *pDMAx, uint8_t Stream);
+void DMA_ClearFlags(DMA_RegDef_t *pDMAx, uint8_t Stream, uint8_t Flags);
+
+// IRQ configuration and ISR handling
+uint8_t DMA_GetIRQNumber(DMA_RegDef_t *pDMAx, uint8_t Stream);
+uint8_t DMA_RegisterCallback(DMA_RegDef_t *pDMAx, uint8_t Stream, DMA_Callback_t pCallback, void *pArg);
+DMA_Callback_t DMA_GetCallback(DMA_RegDef_t *pDMAx, uint8_t Stream);
+void DMA_IRQHandling(DMA_RegDef_t *pDMAx, uint8_t Stream);
+
+// Stream interrupt handlers (weak, call DMA_IRQHandling)
+void DMA1_Stream0_IRQHandler(void);
+void DMA1_Stream1_IRQHandler(void);
+void DMA1_Stream2_IRQHandler(void);
+void DMA1_Stream3_IRQHandler(void);
+void DMA1_Stream4_IRQHandler(void);
+void DMA1_Stream5_IRQHandler(void);
+void DMA1_Stream6_IRQHandler(void);
+void DMA1_Stream7_IRQHandler(void);
+void DMA2_Stream0_IRQHandler(void);
+void DMA2_Stream1_IRQHandler(void);
+void DMA2_Stream2_IRQHandler(void);
+void DMA2_Stream3_IRQHandler(void);
+void DMA2_Stream4_IRQHandler(void);
+void DMA2_Stream5_IRQHandler(void);
+void DMA2_Stream6_IRQHandler(void);
+void DMA2_Stream7_IRQHandler(void);
+
+#endif /* INC_STM32F407XX_DMA_DRIVER_H_ */
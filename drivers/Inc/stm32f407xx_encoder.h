@@ -0,0 +1,102 @@
+/*
+ * stm32f407xx_encoder.h
+ *
+ *  Created on: Feb 12, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_ENCODER_H_
+#define INC_STM32F407XX_ENCODER_H_
+
+#include "stm32f407xx.h"
+
+// Quadrature encoder decoder on GPIO pins, several encoders (channels) on one port.
+//
+// Both channels of an encoder are taken from one read of the IDR. The old and the new A/B
+// levels make a 4 bit index into a 16 entry table that gives the step (-1, 0 or +1), so the
+// decoder has no branches. A change of both A and B at once can not happen with a working
+// encoder, it means a missed state (sampled too slowly) or noise; it does not move the
+// position and is counted in Errors.
+//
+// Two modes:
+//	- ENCODER_MODE_EXTI: every edge of A or B fires its EXTI line, the callback reads the
+//	  port once and steps the encoder of that pin. No latency, the CPU only works at the
+//	  edges, but each edge costs an interrupt. The pins must be configured with
+//	  GPIO_MODE_IT_RFT, and an EXTI line is only available to one port.
+//	- ENCODER_MODE_POLL: TIM1 or TIM8 samples the IDR by DMA into a circular buffer at
+//	  SampleRateHz, the half transfer and transfer complete interrupts decode a whole half in
+//	  one batch (a few cycles per sample and channel). The CPU load does not depend on the
+//	  edge rate, which can go up to SampleRateHz (each of the 4 states must be seen once).
+//	  The position lags by up to HalfLength samples. The pins are plain inputs.
+//	  The timer and its DMA2 stream can not be used by patgen or capture at the same time.
+
+#define ENCODER_MAX_CHANNELS		8		// Two pins per encoder, 16 pins per port
+
+// Status codes
+#define ENCODER_OK					0
+#define ENCODER_ERR_CONFIG			1	// Bad channel count or pins, EXTI line or DMA stream in use, bad timer or buffer
+#define ENCODER_ERR_RATE			2	// Sample rate can not be made with the timer clock
+
+// @ENCODER_MODE
+#define ENCODER_MODE_EXTI			0
+#define ENCODER_MODE_POLL			1
+
+// One encoder. PinA and PinB are set by the caller before ENCODER_Init, the rest belongs to
+// the driver. Position and Errors may be read at any time.
+typedef struct
+{
+	uint8_t PinA;						// Counting up when A leads B
+	uint8_t PinB;
+	uint8_t State;						// Last levels, A in bit 1 and B in bit 0
+	__vo int32_t Position;				// Counts, 4 per cycle of A
+	__vo uint32_t Errors;				// Illegal transitions (A and B changed together)
+}ENCODER_Channel_t;
+
+typedef struct
+{
+	GPIO_RegDef_t *pGPIOx;				// Port of all the encoders
+	uint8_t Mode;						// @ENCODER_MODE
+	uint8_t ChannelCount;				// 1 - ENCODER_MAX_CHANNELS
+	uint8_t IRQPriority;				// Of the EXTI lines or the DMA stream
+
+	// ENCODER_MODE_POLL only
+	TIM_RegDef_t *pTIMx;				// TIM1 or TIM8
+	uint32_t TimerClockHz;				// Input clock of the timer
+	uint32_t SampleRateHz;
+	uint16_t *pSamples;					// Sample buffer of 2 x HalfLength half-words
+	uint16_t HalfLength;				// 1 - 32767
+}ENCODER_Config_t;
+
+typedef struct
+{
+	ENCODER_Config_t Config;
+	ENCODER_Channel_t Channel[ENCODER_MAX_CHANNELS];
+	uint16_t PinMask;					// All A and B pins, set by ENCODER_Init
+	uint8_t Stream;						// DMA2 stream of the timer
+	uint8_t DMAChannel;
+	uint8_t Running;
+	uint16_t NextSample;				// Poll mode: first sample of the buffer not decoded yet
+	uint32_t Overruns;					// Poll mode: halves the DMA refilled before they were decoded
+}ENCODER_Handle_t;
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+// Init and control
+uint8_t ENCODER_Init(ENCODER_Handle_t *pHandle);
+void ENCODER_DeInit(ENCODER_Handle_t *pHandle);
+void ENCODER_Start(ENCODER_Handle_t *pHandle);
+void ENCODER_Stop(ENCODER_Handle_t *pHandle);
+void ENCODER_SetPosition(ENCODER_Handle_t *pHandle, uint8_t Channel, int32_t Position);
+
+// Decoder, also usable on its own (e.g. from a timer interrupt or on a recorded trace)
+void ENCODER_Poll(ENCODER_Handle_t *pHandle);				// Reads the port once, steps all channels
+void ENCODER_Update(ENCODER_Handle_t *pHandle, uint16_t Sample);
+void ENCODER_UpdateBatch(ENCODER_Handle_t *pHandle, const uint16_t *pSamples, uint32_t Count);
+
+#define ENCODER_GetPosition(pHandle, Ch)	((pHandle)->Channel[(Ch)].Position)
+#define ENCODER_GetErrors(pHandle, Ch)		((pHandle)->Channel[(Ch)].Errors)
+
+#endif /* INC_STM32F407XX_ENCODER_H_ */
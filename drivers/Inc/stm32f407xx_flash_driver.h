@@ -0,0 +1,39 @@
+/*
+ * stm32f407xx_flash_driver.h
+ *
+ *  Created on: Dec 18, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_FLASH_DRIVER_H_
+#define INC_STM32F407XX_FLASH_DRIVER_H_
+
+#include "stm32f407xx.h"
+
+// Flash interface: wait states and the ART accelerator (ch. 3.4 - 3.5).
+//
+// At 168 MHz a flash read takes 6 CPU cycles (5 wait states). The ART accelerator hides them:
+//	- prefetch buffer: reads the next 128-bit line while the current one executes
+//	- instruction cache: 64 lines of 128 bits, mainly for the targets of branches
+//	- data cache: 8 lines of 128 bits for constants read from flash (literal pools, tables)
+// The caches can only be reset while they are disabled, FLASH_ICacheControl and
+// FLASH_DCacheControl do this before enabling them.
+
+#define FLASH_LATENCY_MAX			7
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+// Wait states
+void FLASH_SetLatency(uint8_t WaitStates);
+uint8_t FLASH_GetLatency(void);
+
+// ART accelerator
+void FLASH_PrefetchControl(uint8_t EnorDi);
+void FLASH_ICacheControl(uint8_t EnorDi);
+void FLASH_DCacheControl(uint8_t EnorDi);
+void FLASH_EnableART(void);					// Prefetch, I-cache and D-cache on
+
+#endif /* INC_STM32F407XX_FLASH_DRIVER_H_ */
@@ -29,6 +29,43 @@ typedef struct
 
 }GPIO_Handle_t;
 
+// Merged configuration of a whole port, one clear mask and one value per register.
+// Built by GPIO_BuildPortConfig and written by GPIO_ApplyPortConfig, so a board can
+// build it once and apply it as often as needed (each register is accessed only once).
+typedef struct
+{
+	uint32_t MODERMask,   MODERValue;
+	uint32_t OTYPERMask,  OTYPERValue;
+	uint32_t OSPEEDRMask, OSPEEDRValue;
+	uint32_t PUPDRMask,   PUPDRValue;
+	uint32_t AFRMask[2],  AFRValue[2];
+	uint16_t Pins;			// Pins in the configuration
+	uint16_t EXTILines;		// Pins in one of the interrupt modes, routed to their EXTI line
+	uint16_t EXTIRising;	// Lines with rising edge trigger
+	uint16_t EXTIFalling;	// Lines with falling edge trigger
+}GPIO_PortConfig_t;
+
+// Configuration registers of a whole port, see GPIO_SaveState / GPIO_RestoreState.
+//
+// The driver keeps one of these per port as a shadow of the registers. All configuration
+// changes are made on the shadow and the result is stored to the port, so no configuration
+// register is ever read back. The shadow update and the store are one critical section
+// (interrupts masked for a few cycles), so main code and an ISR that reconfigure different
+// pins of the same port can not lose each other's changes. The shadow of a port is loaded
+// from the registers on its first use. Registers written outside the driver (debugger,
+// bootloader, direct register access) need GPIO_ResyncState.
+typedef struct
+{
+	uint32_t MODER;
+	uint32_t OTYPER;
+	uint32_t OSPEEDR;
+	uint32_t PUPDR;
+	uint32_t AFR[2];
+}GPIO_PortState_t;
+
+// EXTI callback, called from the EXTI interrupt with the number of the pin (= EXTI line) that fired
+typedef void (*GPIO_EXTICallback_t)(uint8_t PinNumber);
+
 // GPIO pin numbers
 // @GPIO_PIN_NUMBERS
 #define GPIO_PIN_NO_0		0
@@ -48,6 +85,37 @@ typedef struct
 #define GPIO_PIN_NO_14		14
 #define GPIO_PIN_NO_15		15
 
+// GPIO pin masks, used by the multi-pin APIs (GPIO_SetPins, GPIO_ResetPins, GPIO_WriteMasked)
+// Several pins can be combined with bitwise or, e.g. (GPIO_PIN_12 | GPIO_PIN_13)
+// @GPIO_PIN_MASKS
+#define GPIO_PIN_MASK(PinNumber)	((uint16_t)(1U << (PinNumber)))
+#define GPIO_PIN_0			GPIO_PIN_MASK(GPIO_PIN_NO_0)
+#define GPIO_PIN_1			GPIO_PIN_MASK(GPIO_PIN_NO_1)
+#define GPIO_PIN_2			GPIO_PIN_MASK(GPIO_PIN_NO_2)
+#define GPIO_PIN_3			GPIO_PIN_MASK(GPIO_PIN_NO_3)
+#define GPIO_PIN_4			GPIO_PIN_MASK(GPIO_PIN_NO_4)
+#define GPIO_PIN_5			GPIO_PIN_MASK(GPIO_PIN_NO_5)
+#define GPIO_PIN_6			GPIO_PIN_MASK(GPIO_PIN_NO_6)
+#define GPIO_PIN_7			GPIO_PIN_MASK(GPIO_PIN_NO_7)
+#define GPIO_PIN_8			GPIO_PIN_MASK(GPIO_PIN_NO_8)
+#define GPIO_PIN_9			GPIO_PIN_MASK(GPIO_PIN_NO_9)
+#define GPIO_PIN_10			GPIO_PIN_MASK(GPIO_PIN_NO_10)
+#define GPIO_PIN_11			GPIO_PIN_MASK(GPIO_PIN_NO_11)
+#define GPIO_PIN_12			GPIO_PIN_MASK(GPIO_PIN_NO_12)
+#define GPIO_PIN_13			GPIO_PIN_MASK(GPIO_PIN_NO_13)
+#define GPIO_PIN_14			GPIO_PIN_MASK(GPIO_PIN_NO_14)
+#define GPIO_PIN_15			GPIO_PIN_MASK(GPIO_PIN_NO_15)
+#define GPIO_PIN_ALL		((uint16_t)0xFFFF)
+
+// GPIO port bit set/reset register (ch. 8.4.7)
+// The lower 16 bits (BSx) set the corresponding ODR bit, the upper 16 bits (BRx) reset it.
+// Writing 0 has no effect, so only the selected pins are changed and no read of ODR is needed.
+// If both BSx and BRx are set, BSx has priority.
+#define GPIO_BSRR_SET(Mask)				((uint32_t)(uint16_t)(Mask))
+#define GPIO_BSRR_RESET(Mask)			((uint32_t)(uint16_t)(Mask) << 16)
+// BSRR word that drives the pins in "Mask" to the levels given in "Value" (one bit per pin)
+#define GPIO_BSRR_WORD(Mask, Value)		( GPIO_BSRR_SET((Mask) & (Value)) | GPIO_BSRR_RESET((Mask) & ~(Value)) )
+
 // *******************************
 // *   Possible GPIO pin modes   *
 // *******************************
@@ -79,7 +147,15 @@ typedef struct
 #define GPIO_PIN_PU			1	// Pull-up
 #define GPIO_PIN_PD			2	// Pull-down
 
-//
+// Highest alternate function number (AF0 - AF15, ch. 8.4.9)
+#define GPIO_ALTFN_MAX		15
+
+// Return values of the GPIO APIs that can fail
+// @GPIO_STATUS
+#define GPIO_OK					0
+#define GPIO_ERR_INVALID_PIN	1	// Pin number is not 0 - 15
+#define GPIO_ERR_PIN_OVERLAP	2	// The same pin appears more than once in the config array
+#define GPIO_ERR_INVALID_CONFIG	3	// Mode, speed, pull-up/pull-down, output type or alt. function out of range
 
 
 // **********************************************************************
@@ -90,10 +166,26 @@ typedef struct
 // Peripheral clock setup
 void GPIO_PeriClockControl(GPIO_RegDef_t *pGPIOx, uint8_t EnorDi);
 
+// Variants of GPIO_PeriClockControl without the range check. They count the users of the clock
+// in the out of line RCC_PeriphClockEnable/Disable, so a port another driver uses stays on.
+// The single store form for a constant port is GPIOx_PCLK_EN()/GPIOx_PCLK_DI() (stm32f407xx.h,
+// a REG_BB_SET/REG_BB_CLR of the enable bit), it does not count users.
+#define GPIO_PeriClockEnable(pGPIOx)	RCC_PeriphClockEnable(RCC_CLK_GPIO(pGPIOx), RCC_CLK_RUN_ONLY)
+#define GPIO_PeriClockDisable(pGPIOx)	RCC_PeriphClockDisable(RCC_CLK_GPIO(pGPIOx), RCC_CLK_RUN_ONLY)
+
 // Init and De-init
 void GPIO_init(GPIO_Handle_t *pGPIOHandle);
+uint8_t GPIO_InitPort(GPIO_RegDef_t *pGPIOx, const GPIO_PinConfig_t *pPinConfigs, uint8_t Len); // Returns @GPIO_STATUS
+uint8_t GPIO_BuildPortConfig(const GPIO_PinConfig_t *pPinConfigs, uint8_t Len, GPIO_PortConfig_t *pPortConfig);
+void GPIO_ApplyPortConfig(GPIO_RegDef_t *pGPIOx, const GPIO_PortConfig_t *pPortConfig);
 void GPIO_DeInit(GPIO_RegDef_t *pGPIOx); // Put reset bit to 1 will reset the whole port that is inputted
 
+// Reconfiguration from any context, through the shadow registers (see GPIO_PortState_t)
+uint8_t GPIO_SetPinModes(GPIO_RegDef_t *pGPIOx, uint16_t PinMask, uint8_t Mode);	// Mode GPIO_MODE_IN - GPIO_MODE_ANALOG, returns @GPIO_STATUS
+void GPIO_SaveState(GPIO_RegDef_t *pGPIOx, GPIO_PortState_t *pState);
+void GPIO_RestoreState(GPIO_RegDef_t *pGPIOx, const GPIO_PortState_t *pState);		// Six stores, EXTI routing is not changed
+void GPIO_ResyncState(GPIO_RegDef_t *pGPIOx);		// Shadow is reloaded from the port on its next use
+
 // Data read and write
 uint8_t GPIO_ReadFromInputPin(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber);
 uint16_t GPIO_ReadFromInputPort(GPIO_RegDef_t *pGPIOx); // 16 pins, so we need uint16
@@ -101,9 +193,27 @@ void GPIO_WriteToOutputPin(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber, uint8_t Val
 void GPIO_WriteToOutputPort(GPIO_RegDef_t *pGPIOx, uint16_t Value);
 void GPIO_ToggleOutputPin(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber);
 
+// Atomic multi-pin write, each call is a single store to BSRR (see @GPIO_PIN_MASKS)
+void GPIO_SetPins(GPIO_RegDef_t *pGPIOx, uint16_t PinMask);
+void GPIO_ResetPins(GPIO_RegDef_t *pGPIOx, uint16_t PinMask);
+void GPIO_WriteMasked(GPIO_RegDef_t *pGPIOx, uint16_t PinMask, uint16_t Value); // Only pins in PinMask are changed
+void GPIO_TogglePins(GPIO_RegDef_t *pGPIOx, uint16_t PinMask);
+
 // IRQ Configuration and ISR handling
 void GPIO_IRQConfig(uint8_t IRQNumber, uint8_t IRQPriority, uint8_t EnorDi);	//Used to configure the IRQ number of the GPIO pin, like enable, set priority and more...
 void GPIO_IRQHandling(uint8_t PinNumber);
+uint8_t GPIO_PinToIRQNumber(uint8_t PinNumber);		// IRQ_NO_EXTIx that serves the EXTI line of the pin
+void GPIO_RegisterEXTICallback(uint8_t PinNumber, GPIO_EXTICallback_t pCallback);	// NULL removes the callback
+void GPIO_EXTIDispatch(uint32_t LineMask);			// Clears and serves all pending lines in LineMask
+
+// EXTI interrupt handlers, defined weak in the driver so the application can replace them
+void EXTI0_IRQHandler(void);
+void EXTI1_IRQHandler(void);
+void EXTI2_IRQHandler(void);
+void EXTI3_IRQHandler(void);
+void EXTI4_IRQHandler(void);
+void EXTI9_5_IRQHandler(void);
+void EXTI15_10_IRQHandler(void);
 
 
 
@@ -0,0 +1,161 @@
+/*
+ * stm32f407xx_i2c_driver.h
+ *
+ *  Created on: Jan 22, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_I2C_DRIVER_H_
+#define INC_STM32F407XX_I2C_DRIVER_H_
+
+#include "stm32f407xx.h"
+
+// I2C master driver (ch. 27), 7 bit addresses, Standard mode (100 kHz) and Fast mode (400 kHz).
+//
+// I2C_Submit queues caller owned I2C_Transaction_t. The queue is run by a state machine in the
+// event and error interrupts, the CPU only works at the bus events (start, address, a byte).
+// A transaction is
+//	- a write:				TxLen > 0, RxLen = 0
+//	- a read:				TxLen = 0, RxLen > 0
+//	- a write then read:	TxLen > 0, RxLen > 0, with a repeated start in between (register reads)
+// Reads of DMAMinLen bytes or more are done by DMA, the CPU then only sees the address and the end.
+// The next transaction starts from the interrupt of the last one, so several sensors are read
+// back to back without the main loop.
+
+struct I2C_Transaction;
+
+// Transaction done callback, runs in interrupt context
+typedef void (*I2C_TxnCallback_t)(struct I2C_Transaction *pTxn, void *pArg);
+
+// Configuration structure for I2Cx peripheral
+typedef struct
+{
+	uint32_t I2C_SCLSpeed;			// Possible values from @I2C_SCL_SPEED
+	uint8_t I2C_FMDutyCycle;		// Possible values from @I2C_FM_DUTY, Fast mode only
+}I2C_Config_t;
+
+// One transaction of the queue. Owned by the caller and must stay valid until its Status is
+// I2C_TXN_DONE or an error.
+typedef struct I2C_Transaction
+{
+	struct I2C_Transaction *pNext;	// Private to the driver
+	uint8_t Address;				// 7 bit slave address
+	__vo uint8_t Status;			// Possible values from @I2C_TXN_STATUS
+	const uint8_t *pTxBuffer;
+	uint16_t TxLen;
+	uint8_t *pRxBuffer;
+	uint16_t RxLen;
+	I2C_TxnCallback_t pCallback;	// Optional
+	void *pArg;
+}I2C_Transaction_t;
+
+// Handle structure for I2Cx peripheral
+typedef struct
+{
+	I2C_RegDef_t *pI2Cx;			// Base address of I2Cx(x:1,2,3) peripheral
+	I2C_Config_t I2CConfig;
+	uint8_t IRQPriority;			// Priority of the event, error and DMA interrupts
+	uint16_t DMAMinLen;				// Reads this long or longer use DMA, 0 never uses DMA
+
+	// Set by I2C_Init
+	DMA_RegDef_t *pDMAx;			// NULL without DMA reads, or stream used by another driver
+	uint8_t RxStream;
+	uint8_t DMAChannel;
+
+	// Transaction in progress
+	I2C_Transaction_t *pHead;
+	I2C_Transaction_t *pTail;
+	const uint8_t *pTxBuffer;
+	uint8_t *pRxBuffer;
+	uint16_t TxLen;					// Bytes left to send
+	uint16_t RxLen;					// Bytes left to receive
+	uint8_t Phase;					// Possible values from @I2C_PHASE
+}I2C_Handle_t;
+
+// @I2C_SCL_SPEED
+#define I2C_SCL_SPEED_SM			100000U
+#define I2C_SCL_SPEED_FM			400000U
+
+// @I2C_FM_DUTY, low/high ratio of SCL in Fast mode
+#define I2C_FM_DUTY_2				0
+#define I2C_FM_DUTY_16_9			1
+
+// @I2C_TXN_STATUS
+#define I2C_TXN_IDLE				0
+#define I2C_TXN_QUEUED				1
+#define I2C_TXN_ACTIVE				2
+#define I2C_TXN_DONE				3
+#define I2C_TXN_ERROR_NACK			4	// Address or data not acknowledged by the slave
+#define I2C_TXN_ERROR_BUS			5	// Bus error, arbitration lost or overrun
+
+// @I2C_PHASE
+#define I2C_PHASE_WRITE				0
+#define I2C_PHASE_READ				1
+
+// Status codes
+#define I2C_OK						0
+#define I2C_ERR_PARAM				1
+#define I2C_ERR_BUSY				2	// DMA stream used by another driver (I2C_Init)
+
+// Bit position definitions of I2C peripheral (ch. 27.6)
+#define I2C_CR1_PE					0
+#define I2C_CR1_START				8
+#define I2C_CR1_STOP				9
+#define I2C_CR1_ACK					10
+#define I2C_CR1_POS					11
+#define I2C_CR1_SWRST				15
+
+#define I2C_CR2_FREQ				0
+#define I2C_CR2_ITERREN				8
+#define I2C_CR2_ITEVTEN				9
+#define I2C_CR2_ITBUFEN				10
+#define I2C_CR2_DMAEN				11
+#define I2C_CR2_LAST				12
+
+#define I2C_SR1_SB					0
+#define I2C_SR1_ADDR				1
+#define I2C_SR1_BTF					2
+#define I2C_SR1_STOPF				4
+#define I2C_SR1_RXNE				6
+#define I2C_SR1_TXE					7
+#define I2C_SR1_BERR				8
+#define I2C_SR1_ARLO				9
+#define I2C_SR1_AF					10
+#define I2C_SR1_OVR					11
+#define I2C_SR1_TIMEOUT				14
+
+#define I2C_SR2_MSL					0
+#define I2C_SR2_BUSY				1
+#define I2C_SR2_TRA					2
+
+#define I2C_CCR_CCR					0
+#define I2C_CCR_DUTY				14
+#define I2C_CCR_FS					15
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+// Peripheral clock setup
+void I2C_PeriClockControl(I2C_RegDef_t *pI2Cx, uint8_t EnorDi);
+
+// Init and De-init
+uint8_t I2C_Init(I2C_Handle_t *pI2CHandle);
+void I2C_DeInit(I2C_RegDef_t *pI2Cx);
+
+// Transaction queue
+uint8_t I2C_Submit(I2C_Handle_t *pI2CHandle, I2C_Transaction_t *pTxn);
+uint8_t I2C_IsIdle(I2C_Handle_t *pI2CHandle);
+
+// IRQ configuration and ISR handling
+void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle);
+void I2C_ER_IRQHandling(I2C_Handle_t *pI2CHandle);
+void I2C1_EV_IRQHandler(void);
+void I2C1_ER_IRQHandler(void);
+void I2C2_EV_IRQHandler(void);
+void I2C2_ER_IRQHandler(void);
+void I2C3_EV_IRQHandler(void);
+void I2C3_ER_IRQHandler(void);
+
+#endif /* INC_STM32F407XX_I2C_DRIVER_H_ */
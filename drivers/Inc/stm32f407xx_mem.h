@@ -0,0 +1,43 @@
+/*
+ * stm32f407xx_mem.h
+ *
+ *  Created on: Dec 18, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_MEM_H_
+#define INC_STM32F407XX_MEM_H_
+
+#include "stm32f407xx.h"
+
+// Memory sections set up at startup, before main.
+//
+// The linker script must place the sections and define these symbols (word aligned):
+//	.data (with *(.RamFunc)) in SRAM, loaded from flash:	_sidata, _sdata, _edata
+//	.bss in SRAM:											_sbss, _ebss
+//	.ccmram in CCM RAM, loaded from flash:					_siccmram, _sccmram, _eccmram
+//	.ccmbss in CCM RAM:										_sccmbss, _eccmbss
+// Functions marked __RAMFUNC are in .RamFunc and are copied to SRAM with .data.
+//
+// The CCM RAM clock (AHB1ENR bit 20) is on after reset.
+//
+// A large .data is copied by DMA2 (stream 0) while the CPU sets up the other sections. Below
+// MEM_DMA_MIN_WORDS the setup of the DMA costs more than it saves, 0 turns it off.
+
+#ifndef MEM_DMA_MIN_WORDS
+#define MEM_DMA_MIN_WORDS			256
+#endif
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+void MEM_CopyWords(uint32_t *pDst, const uint32_t *pSrc, uint32_t Words);
+void MEM_ZeroWords(uint32_t *pDst, uint32_t Words);
+
+#ifndef STM32F407XX_SIM
+void MEM_InitSections(void);		// Called from the reset handler, before main
+#endif
+
+#endif /* INC_STM32F407XX_MEM_H_ */
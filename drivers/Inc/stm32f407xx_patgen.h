@@ -0,0 +1,86 @@
+/*
+ * stm32f407xx_patgen.h
+ *
+ *  Created on: Nov 27, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_PATGEN_H_
+#define INC_STM32F407XX_PATGEN_H_
+
+#include "stm32f407xx.h"
+
+// Pattern generator, streams 32-bit BSRR words to a GPIO port without the CPU.
+//
+// The update event of TIM1 or TIM8 requests a DMA2 transfer of one word from the pattern
+// buffer into the BSRR of the port, so every sample changes only the pins set in its word
+// (see PATGEN_Encode) and the timing comes from the timer, not from the code or interrupts.
+// DMA1 can not be used, its peripheral port does not reach AHB1 where the GPIO ports are.
+//
+//	TIM1_UP -> DMA2 stream 5 channel 6
+//	TIM8_UP -> DMA2 stream 1 channel 7
+//
+// Modes:
+//	- circular: pBuffer[0] is played over and over, no interrupts
+//	- double buffer: pBuffer[0] and pBuffer[1] are played in turn (DMA double buffer mode).
+//	  When one buffer is done the DMA goes on with the other one and the transfer complete
+//	  interrupt hands the finished buffer back to the application for refilling. A buffer
+//	  that was not refilled in time is played again and counted as an underrun.
+
+// @PATGEN_MODES
+#define PATGEN_MODE_CIRCULAR	0
+#define PATGEN_MODE_DOUBLE		1
+
+// Status codes
+#define PATGEN_OK				0
+#define PATGEN_ERR_CONFIG		1	// Timer is not TIM1/TIM8, no buffer, length 0 or DMA stream in use
+#define PATGEN_ERR_RATE			2	// Sample rate can not be made with the timer clock
+
+// Refill callback, called from the DMA interrupt with the buffer that has just been played.
+// The buffer counts as refilled when the callback returns.
+typedef void (*PATGEN_RefillCallback_t)(uint32_t *pBuffer, uint16_t Length, void *pArg);
+
+typedef struct
+{
+	GPIO_RegDef_t *pGPIOx;				// Output port, the pins must be configured as outputs
+	TIM_RegDef_t *pTIMx;				// TIM1 or TIM8
+	uint32_t TimerClockHz;				// Input clock of the timer
+	uint32_t SampleRateHz;				// Words per second written to BSRR
+	uint32_t *pBuffer[2];				// BSRR words, pBuffer[1] is only used in double buffer mode
+	uint16_t Length;					// Words in each buffer
+	uint8_t Mode;						// Possible values from @PATGEN_MODES
+	uint8_t IRQPriority;				// Priority of the DMA interrupt (double buffer mode)
+	PATGEN_RefillCallback_t pRefill;	// Optional, else use PATGEN_GetFreeBuffer/PATGEN_SubmitBuffer
+	void *pArg;							// Argument given to pRefill
+}PATGEN_Config_t;
+
+typedef struct
+{
+	PATGEN_Config_t Config;
+	uint8_t Stream;						// DMA2 stream of the timer
+	uint8_t Channel;
+	uint8_t Running;
+	__vo uint8_t Ready[2];				// Buffer holds new data that has not been played
+	__vo uint32_t Played;				// Buffers played since PATGEN_Start
+	__vo uint32_t Underruns;			// Buffers that were played again, because not refilled in time
+}PATGEN_Handle_t;
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+// Init and control
+uint8_t PATGEN_Init(PATGEN_Handle_t *pHandle);
+void PATGEN_DeInit(PATGEN_Handle_t *pHandle);
+void PATGEN_Start(PATGEN_Handle_t *pHandle);
+void PATGEN_Stop(PATGEN_Handle_t *pHandle);
+
+// Double buffer mode, refilling from the main loop
+uint32_t *PATGEN_GetFreeBuffer(PATGEN_Handle_t *pHandle);		// NULL if both buffers are waiting to be played
+void PATGEN_SubmitBuffer(PATGEN_Handle_t *pHandle, uint32_t *pBuffer);
+
+// Pattern helper, converts port levels to BSRR words
+void PATGEN_Encode(uint32_t *pOut, const uint16_t *pLevels, uint16_t Length, uint16_t PinMask);
+
+#endif /* INC_STM32F407XX_PATGEN_H_ */
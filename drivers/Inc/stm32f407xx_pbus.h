@@ -0,0 +1,120 @@
+/*
+ * stm32f407xx_pbus.h
+ *
+ *  Created on: Feb 26, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_PBUS_H_
+#define INC_STM32F407XX_PBUS_H_
+
+#include "stm32f407xx.h"
+
+// Parallel 8 or 16 bit bus on GPIO pins (TFT panels, latches), 8080 or 6800 style.
+//
+// The data lines can be any pins of one or two ports. PBUS_Init builds, for each port and
+// each byte of the word, a 256 entry table of BSRR words that set and reset the data pins of
+// that port for every byte value. A word is then one table load and one BSRR store per
+// port, the other pins of the ports are never touched. When the write strobe is on the first
+// data port its active level is in the table too, so a word on one port is two stores: data
+// with the strobe active, then the strobe inactive (the data is latched on that edge).
+//
+//	- 8080: CS, DC (RS), WR and RD are active low, data is latched on the rising edge of WR
+//	  and read while RD is low.
+//	- 6800: CS and DC as above, the WR pin is R/W (low = write) and the RD pin is E, data is
+//	  latched on the falling edge of E and read while E is high.
+//
+// The strobe pulses are at least WritePulseNs / ReadPulseNs long, made by repeating the strobe
+// store (see PBUS_CYCLES_PER_STORE). CS is driven by PBUS_Select / PBUS_Deselect, so several
+// transfers can be one chip select. All pins are configured as outputs by the caller
+// (GPIO_InitPort), PBUS_Read switches the data pins to inputs and back with GPIO_SetPinModes.
+
+#define PBUS_MAX_PORTS				2
+#define PBUS_CYCLES_PER_STORE		2		// Core cycles of a back-to-back store to an AHB1 port
+
+// Status codes
+#define PBUS_OK						0
+#define PBUS_ERR_CONFIG				1	// Bad width, mode or pin, data on more than two ports, no WR pin
+
+// @PBUS_MODE
+#define PBUS_MODE_8080				0
+#define PBUS_MODE_6800				1
+
+// A pin of the bus, pGPIOx NULL when an optional pin (CS, DC, RD) is not used
+typedef struct
+{
+	GPIO_RegDef_t *pGPIOx;
+	uint8_t Pin;
+}PBUS_Pin_t;
+
+typedef struct
+{
+	uint8_t Mode;						// @PBUS_MODE
+	uint8_t Width;						// 8 or 16 data lines
+	PBUS_Pin_t Data[16];				// Data[i] is bit i of the word
+	PBUS_Pin_t WR;						// 8080: WR, 6800: R/W
+	PBUS_Pin_t RD;						// 8080: RD, 6800: E (needed for writes too)
+	PBUS_Pin_t CS;
+	PBUS_Pin_t DC;						// Low for commands
+	uint32_t CoreClockHz;
+	uint16_t WritePulseNs;				// Shortest strobe low/high time of a write
+	uint16_t ReadPulseNs;				// Strobe active to data valid of a read
+}PBUS_Config_t;
+
+// A control line, the BSRR words of its two levels
+typedef struct
+{
+	GPIO_RegDef_t *pGPIOx;
+	uint32_t On;						// Active level (strobe active, CS selected, DC command)
+	uint32_t Off;
+}PBUS_Signal_t;
+
+typedef struct
+{
+	PBUS_Config_t Config;
+
+	// Set by PBUS_Init
+	uint32_t Lut[PBUS_MAX_PORTS][2][256];	// BSRR word of each port for byte 0 and byte 1 of the word
+	GPIO_RegDef_t *pPorts[PBUS_MAX_PORTS];
+	uint8_t PortCount;
+	uint16_t PortPins[PBUS_MAX_PORTS];		// Data pins of each port
+	uint8_t ReadShift;						// Data is IDR >> ReadShift of the first port, 0xFF if not
+	PBUS_Signal_t Write;					// Write strobe (8080 WR, 6800 E)
+	PBUS_Signal_t Read;						// Read strobe (8080 RD, 6800 E)
+	PBUS_Signal_t RW;						// 6800 R/W, On is read
+	PBUS_Signal_t CS;
+	PBUS_Signal_t DC;
+	uint8_t StrobeInLut;					// Active write strobe is in the tables of the first port
+	uint8_t WriteHold;						// Extra strobe stores of each write phase
+	uint8_t ReadHold;						// Extra strobe stores before the read
+
+	// Throughput of the burst functions, in DWT cycles
+	uint32_t BurstWords;
+	uint64_t BurstCycles;
+}PBUS_Handle_t;
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+// Init
+uint8_t PBUS_Init(PBUS_Handle_t *pHandle);
+
+// Chip select
+void PBUS_Select(PBUS_Handle_t *pHandle);
+void PBUS_Deselect(PBUS_Handle_t *pHandle);
+
+// Transfers, Count is in words (bytes of an 8 bit bus, half-words of a 16 bit bus)
+void PBUS_WriteCommand(PBUS_Handle_t *pHandle, uint16_t Command);
+void PBUS_Write(PBUS_Handle_t *pHandle, uint16_t Value);
+void PBUS_WriteBuffer(PBUS_Handle_t *pHandle, const void *pData, uint32_t Count);
+void PBUS_Fill(PBUS_Handle_t *pHandle, uint16_t Value, uint32_t Count);
+uint16_t PBUS_Read(PBUS_Handle_t *pHandle);
+void PBUS_ReadBuffer(PBUS_Handle_t *pHandle, void *pData, uint32_t Count);
+
+// Statistics
+uint32_t PBUS_GetBytesPerSecond(const PBUS_Handle_t *pHandle);	// Of the bursts since the last reset
+void PBUS_ResetStats(PBUS_Handle_t *pHandle);
+
+#endif /* INC_STM32F407XX_PBUS_H_ */
@@ -0,0 +1,74 @@
+/*
+ * stm32f407xx_profiler.h
+ *
+ *  Created on: Nov 20, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_PROFILER_H_
+#define INC_STM32F407XX_PROFILER_H_
+
+#include "stm32f407xx.h"
+
+// Cycle profiler on the DWT cycle counter (CYCCNT) of the Cortex-M4.
+//
+// Code regions are measured with PROFILER_BEGIN(Id) / PROFILER_END(Id) in the same block.
+// Each region collects count, min, max, total and a log2 histogram of its cycle counts in a
+// static table. Compile with -DPROFILER_ENABLE to turn the markers on, without it they are
+// empty and cost nothing.
+//
+// Histogram bin 0 counts 0 cycles, bin k (1 - 31) counts [2^(k-1), 2^k) cycles, bin 31 also
+// counts everything above.
+//
+// In the host simulator CYCCNT is a simulated register that advances with SIM_AdvanceCycles.
+
+#define PROFILER_MAX_REGIONS		16
+#define PROFILER_HIST_BINS			32
+
+// Region ids of the driver entry points, the application uses PROFILER_ID_USER and up
+// @PROFILER_IDS
+#define PROFILER_ID_GPIO_INIT		0	// GPIO_InitPort (and GPIO_init)
+#define PROFILER_ID_GPIO_WRITE		1	// GPIO_WriteToOutputPin
+#define PROFILER_ID_GPIO_TOGGLE		2	// GPIO_TogglePins (and GPIO_ToggleOutputPin)
+#define PROFILER_ID_EXTI_DISPATCH	3	// GPIO_EXTIDispatch, the EXTI interrupt handlers
+#define PROFILER_ID_USER			4
+
+typedef struct
+{
+	uint32_t Count;
+	uint32_t Min;
+	uint32_t Max;
+	uint64_t Total;							// Mean is Total / Count
+	uint32_t Hist[PROFILER_HIST_BINS];
+}PROFILER_Stats_t;
+
+// Current value of the cycle counter
+static inline uint32_t PROFILER_Now(void)
+{
+	return REG_READ(DWT->CYCCNT);
+}
+
+// Region markers
+#ifdef PROFILER_ENABLE
+#define PROFILER_BEGIN(Id)		uint32_t profStart_##Id = PROFILER_Now()
+#define PROFILER_END(Id)		PROFILER_Record((Id), PROFILER_Now() - profStart_##Id)
+#else
+#define PROFILER_BEGIN(Id)		((void)0)
+#define PROFILER_END(Id)		((void)0)
+#endif
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+void PROFILER_Init(void);
+void PROFILER_Reset(void);
+void PROFILER_Record(uint8_t Id, uint32_t Cycles);
+const PROFILER_Stats_t *PROFILER_GetStats(uint8_t Id);
+
+// Export of all regions with Count > 0, both return the number of bytes written
+uint32_t PROFILER_ExportCSV(char *pBuffer, uint32_t Len);
+uint32_t PROFILER_ExportBinary(uint8_t *pBuffer, uint32_t Len);
+
+#endif /* INC_STM32F407XX_PROFILER_H_ */
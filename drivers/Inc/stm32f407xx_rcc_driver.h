@@ -0,0 +1,192 @@
+/*
+ * stm32f407xx_rcc_driver.h
+ *
+ *  Created on: Dec 18, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_RCC_DRIVER_H_
+#define INC_STM32F407XX_RCC_DRIVER_H_
+
+#include "stm32f407xx.h"
+
+// Clock tree configuration (ch. 6 and 7).
+//
+//	SYSCLK = PLL input / M * N / P, USB/SDIO clock = PLL input / M * N / Q
+//
+// Limits (2.7 - 3.6 V, regulator scale 1 which is the reset value of PWR_CR VOS):
+//	PLL input / M: 1 - 2 MHz (2 MHz gives the least jitter), M = 2 - 63
+//	VCO (PLL input / M * N): 100 - 432 MHz, N = 50 - 432
+//	P = 2, 4, 6 or 8, Q = 2 - 15, the USB clock must be 48 MHz for USB OTG FS
+//	SYSCLK and HCLK <= 168 MHz, PCLK1 (APB1) <= 42 MHz, PCLK2 (APB2) <= 84 MHz
+//	Flash wait states: (HCLK - 1) / 30 MHz
+//
+// RCC_ClockConfig picks the APB prescalers (smallest that keeps each bus in its limit) and the
+// flash wait states itself. The timers run at 2 x PCLKx when the APBx prescaler is not 1.
+//
+// Peripheral clocks (ch. 7.3.10 - 7.3.22) are counted per peripheral: every driver that uses a
+// peripheral calls RCC_PeriphClockEnable, the clock goes off at the last RCC_PeriphClockDisable,
+// so a driver that shuts down does not stop a port another one still uses. Each user also says
+// if the peripheral has to run while the core sleeps (interrupt or DMA sources):
+//	- RCC_CLK_RUN_ONLY	the clock is gated in Sleep mode through the xxxLPENR register
+//	- RCC_CLK_IN_SLEEP	the clock keeps running in Sleep mode
+// A peripheral keeps its clock in Sleep mode as long as one user asked for it. A driver whose
+// peripheral only has to run in Sleep mode while a transfer is going on enables its clock with
+// RCC_CLK_RUN_ONLY and adds a Sleep mode user with RCC_PeriphSleepControl for the transfer.
+// Stop mode turns all clocks off, RCC_StopAllowed tells if no user needs a clock while asleep.
+
+#define RCC_SYSCLK_MAX				168000000U
+#define RCC_HCLK_MAX				168000000U
+#define RCC_PCLK1_MAX				42000000U
+#define RCC_PCLK2_MAX				84000000U
+#define RCC_FLASH_WS_HZ				30000000U	// HCLK per flash wait state at 2.7 - 3.6 V
+#define RCC_USB_HZ					48000000U
+
+#define RCC_PLL_VCO_MIN				100000000U
+#define RCC_PLL_VCO_MAX				432000000U
+#define RCC_PLL_IN_MIN				1000000U
+#define RCC_PLL_IN_MAX				2000000U
+
+// @RCC_SYSCLK_SOURCE
+#define RCC_SYSCLK_HSI				0
+#define RCC_SYSCLK_HSE				1
+#define RCC_SYSCLK_PLL				2
+
+// @RCC_PLL_SOURCE
+#define RCC_PLLSRC_HSI				0
+#define RCC_PLLSRC_HSE				1
+
+// Bus of a peripheral clock, in the order of the xxxENR registers
+// @RCC_BUS
+#define RCC_BUS_AHB1				0
+#define RCC_BUS_AHB2				1
+#define RCC_BUS_AHB3				2
+#define RCC_BUS_APB1				3
+#define RCC_BUS_APB2				4
+#define RCC_BUS_COUNT				5
+
+// Peripheral clock id: bus and bit of the peripheral in xxxENR, xxxLPENR and xxxRSTR
+#define RCC_CLK_ID(Bus, Bit)		( (uint8_t)(((Bus) << 5) | (Bit)) )
+#define RCC_CLK_BUS(ClkId)			( (uint8_t)((ClkId) >> 5) )
+#define RCC_CLK_BIT(ClkId)			( (uint8_t)((ClkId) & 0x1FU) )
+#define RCC_CLK_COUNT				(RCC_BUS_COUNT * 32)
+
+// @RCC_CLK_IDS
+#define RCC_CLK_GPIO(pGPIOx)		RCC_CLK_ID(RCC_BUS_AHB1, GPIO_BASEADDR_TO_CODE(pGPIOx))
+#define RCC_CLK_GPIOA				RCC_CLK_ID(RCC_BUS_AHB1, 0)	// GPIOB ... GPIOI are bits 1 - 8
+#define RCC_CLK_DMA1				RCC_CLK_ID(RCC_BUS_AHB1, 21)
+#define RCC_CLK_DMA2				RCC_CLK_ID(RCC_BUS_AHB1, 22)
+#define RCC_CLK_TIM2				RCC_CLK_ID(RCC_BUS_APB1, 0)	// TIM3 ... TIM7 are bits 1 - 5
+#define RCC_CLK_SPI2				RCC_CLK_ID(RCC_BUS_APB1, 14)
+#define RCC_CLK_SPI3				RCC_CLK_ID(RCC_BUS_APB1, 15)
+#define RCC_CLK_USART2				RCC_CLK_ID(RCC_BUS_APB1, 17)
+#define RCC_CLK_USART3				RCC_CLK_ID(RCC_BUS_APB1, 18)
+#define RCC_CLK_UART4				RCC_CLK_ID(RCC_BUS_APB1, 19)
+#define RCC_CLK_UART5				RCC_CLK_ID(RCC_BUS_APB1, 20)
+#define RCC_CLK_I2C1				RCC_CLK_ID(RCC_BUS_APB1, 21)
+#define RCC_CLK_I2C2				RCC_CLK_ID(RCC_BUS_APB1, 22)
+#define RCC_CLK_I2C3				RCC_CLK_ID(RCC_BUS_APB1, 23)
+#define RCC_CLK_PWR					RCC_CLK_ID(RCC_BUS_APB1, 28)
+#define RCC_CLK_TIM1				RCC_CLK_ID(RCC_BUS_APB2, 0)
+#define RCC_CLK_TIM8				RCC_CLK_ID(RCC_BUS_APB2, 1)
+#define RCC_CLK_USART1				RCC_CLK_ID(RCC_BUS_APB2, 4)
+#define RCC_CLK_USART6				RCC_CLK_ID(RCC_BUS_APB2, 5)
+#define RCC_CLK_ADC1				RCC_CLK_ID(RCC_BUS_APB2, 8)	// ADC2 and ADC3 are bits 9 and 10
+#define RCC_CLK_SPI1				RCC_CLK_ID(RCC_BUS_APB2, 12)
+#define RCC_CLK_SYSCFG				RCC_CLK_ID(RCC_BUS_APB2, 14)
+
+// @RCC_CLK_SLEEP
+#define RCC_CLK_RUN_ONLY			0
+#define RCC_CLK_IN_SLEEP			1
+
+// Status codes
+#define RCC_OK						0
+#define RCC_ERR_CONFIG				1	// No PLL setting for the SYSCLK asked for, or a prescaler out of range
+#define RCC_ERR_HSE_TIMEOUT			2	// The crystal did not start
+#define RCC_ERR_PLL_TIMEOUT			3
+
+// RCC register bits (ch. 7.3.1 - 7.3.3)
+#define RCC_CR_HSION				(1U << 0)
+#define RCC_CR_HSIRDY				(1U << 1)
+#define RCC_CR_HSEON				(1U << 16)
+#define RCC_CR_HSERDY				(1U << 17)
+#define RCC_CR_HSEBYP				(1U << 18)
+#define RCC_CR_PLLON				(1U << 24)
+#define RCC_CR_PLLRDY				(1U << 25)
+
+#define RCC_PLLCFGR_M_POS			0
+#define RCC_PLLCFGR_N_POS			6
+#define RCC_PLLCFGR_P_POS			16			// 00: P = 2, 01: 4, 10: 6, 11: 8
+#define RCC_PLLCFGR_SRC_HSE			(1U << 22)
+#define RCC_PLLCFGR_Q_POS			24
+
+#define RCC_CFGR_SW_MASK			(0x3U << 0)
+#define RCC_CFGR_SWS_POS			2
+#define RCC_CFGR_SWS_MASK			(0x3U << RCC_CFGR_SWS_POS)
+#define RCC_CFGR_HPRE_POS			4
+#define RCC_CFGR_PPRE1_POS			10
+#define RCC_CFGR_PPRE2_POS			13
+
+typedef struct
+{
+	uint8_t M;
+	uint16_t N;
+	uint8_t P;
+	uint8_t Q;
+}RCC_PLLConfig_t;
+
+typedef struct
+{
+	uint8_t Source;					// Possible values from @RCC_SYSCLK_SOURCE
+	uint8_t PLLSource;				// Possible values from @RCC_PLL_SOURCE
+	uint8_t HSEBypass;				// ENABLE for an external clock signal on OSC_IN instead of a crystal
+	uint32_t SysclkHz;				// PLL only, e.g. 168000000
+	uint16_t AHBDiv;				// HCLK = SYSCLK / AHBDiv, 1, 2, 4, 8, 16, 64, 128, 256 or 512
+	RCC_PLLConfig_t PLL;			// PLL only, M = 0 lets RCC_ClockConfig solve it at run time
+}RCC_ClockConfig_t;
+
+// PLL solver for constant values, so the PLL setting can be made by the compiler, e.g.
+//	static const RCC_ClockConfig_t clk = { ..., .PLL = RCC_PLL_INIT(HSE_VALUE, 168000000U) };
+// The PLL input runs at 2 MHz (1 MHz if InHz is not a multiple of 2 MHz), P is the smallest
+// that brings the VCO up to 100 MHz and Q the smallest that keeps the USB clock <= 48 MHz.
+// Exact for SysclkHz that are multiples of 1 MHz (2 MHz / P at the 2 MHz PLL input).
+#define RCC_PLL_IN_HZ(InHz)			( (((InHz) % 2000000U) == 0) ? 2000000U : 1000000U )
+#define RCC_PLL_M(InHz)				( (InHz) / RCC_PLL_IN_HZ(InHz) )
+#define RCC_PLL_P(SysHz)			( ((SysHz) * 2U >= RCC_PLL_VCO_MIN) ? 2U : \
+									  ((SysHz) * 4U >= RCC_PLL_VCO_MIN) ? 4U : \
+									  ((SysHz) * 6U >= RCC_PLL_VCO_MIN) ? 6U : 8U )
+#define RCC_PLL_VCO(SysHz)			( (SysHz) * RCC_PLL_P(SysHz) )
+#define RCC_PLL_N(InHz, SysHz)		( RCC_PLL_VCO(SysHz) / RCC_PLL_IN_HZ(InHz) )
+#define RCC_PLL_Q(SysHz)			( (RCC_PLL_VCO(SysHz) + RCC_USB_HZ - 1) / RCC_USB_HZ )
+#define RCC_PLL_INIT(InHz, SysHz)	{ RCC_PLL_M(InHz), RCC_PLL_N(InHz, SysHz), RCC_PLL_P(SysHz), RCC_PLL_Q(SysHz) }
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+// Configuration
+uint8_t RCC_ClockConfig(const RCC_ClockConfig_t *pConfig);
+uint8_t RCC_PLLSolve(uint32_t InHz, uint32_t SysclkHz, RCC_PLLConfig_t *pPLL);
+uint8_t RCC_PLLCheck(uint32_t InHz, const RCC_PLLConfig_t *pPLL);		// RCC_OK if all limits are kept
+
+// Bus frequencies, read back from the registers
+uint32_t RCC_GetSysclkFreq(void);
+uint32_t RCC_GetHCLKFreq(void);
+uint32_t RCC_GetPCLK1Freq(void);
+uint32_t RCC_GetPCLK2Freq(void);
+uint32_t RCC_GetTimerClockFreq(TIM_RegDef_t *pTIMx);
+
+// Peripheral clocks, counted per user. Not from interrupts.
+void RCC_PeriphClockEnable(uint8_t ClkId, uint8_t Sleep);		// Sleep: @RCC_CLK_SLEEP
+void RCC_PeriphClockDisable(uint8_t ClkId, uint8_t Sleep);	// Same Sleep as the enable
+void RCC_PeriphSleepControl(uint8_t ClkId, uint8_t EnorDi);	// Sleep mode user only, also from interrupts
+uint8_t RCC_PeriphClockUsers(uint8_t ClkId);
+uint8_t RCC_PeriphSleepUsers(uint8_t ClkId);
+
+// Low power idle, the core wakes up at the next interrupt (Stop: EXTI line)
+uint8_t RCC_StopAllowed(void);									// 1 if no peripheral needs its clock while asleep
+void RCC_Sleep(void);
+uint8_t RCC_Stop(const RCC_ClockConfig_t *pConfig);				// Restores pConfig after the wakeup
+
+#endif /* INC_STM32F407XX_RCC_DRIVER_H_ */
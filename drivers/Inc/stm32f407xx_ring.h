@@ -0,0 +1,314 @@
+/*
+ * stm32f407xx_ring.h
+ *
+ *  Created on: Jan 29, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_RING_H_
+#define INC_STM32F407XX_RING_H_
+
+#include <string.h>
+#include "stm32f407xx.h"
+
+// Lock-free ring buffers for passing data from interrupts to the main loop (or back) without
+// masking interrupts. Header only, the storage is sized at compile time.
+//
+//	RING_SPSC_t		one producer, one consumer. Only ordered loads and stores of the two indexes.
+//	RING_MPSC_t		several producers (ISRs at different priorities and the main loop), one
+//					consumer. Producers claim slots with LDREX/STREX, each slot carries a sequence
+//					number that tells the consumer when its data has been written (D. Vyukov's
+//					bounded queue). A producer preempted between claim and publish only delays
+//					the consumer, it never loses or reorders data.
+//
+// Both have single element Push/Pop (copies) and span functions for zero-copy use:
+//	WriteSpan/Reserve	pointer to free slots that are next to each other in memory, fill them in place
+//	Commit/Publish		hand them to the consumer
+//	ReadSpan			pointer to filled slots that are next to each other in memory, use them in place
+//	Release				give them back to the producers
+// A span ends at the end of the storage, the rest comes with the next call.
+//
+// Indexes run freely (they wrap at 2^32), the slot of index i is i & (Count - 1), so Count must be
+// a power of two. On the host simulator the index accesses are C11 atomics, so the rings can be
+// used (and tested) between threads.
+//
+// Example:
+//		RING_SPSC_DEFINE(RxQueue, uint16_t, 64);		// static RING_SPSC_t RxQueue with 64 slots
+//		ISR:		RING_SPSC_Push(&RxQueue, &sample);
+//		main loop:	while(RING_SPSC_Pop(&RxQueue, &sample)) { ... }
+
+// Index access primitives
+#ifdef STM32F407XX_SIM
+#include <stdatomic.h>
+
+typedef _Atomic uint32_t RING_Index_t;
+
+#define RING_LOAD(p)				atomic_load_explicit((p), memory_order_relaxed)
+#define RING_LOAD_ACQUIRE(p)		atomic_load_explicit((p), memory_order_acquire)
+#define RING_STORE_RELEASE(p, v)	atomic_store_explicit((p), (v), memory_order_release)
+#define RING_INDEX_INIT(v)			(v)
+
+// Sets *p to Desired if it is *pExpected. Otherwise *pExpected gets the value found. 1 on success.
+static inline uint8_t RING_CompareExchange(RING_Index_t *p, uint32_t *pExpected, uint32_t Desired)
+{
+	return atomic_compare_exchange_weak_explicit(p, pExpected, Desired, memory_order_acq_rel, memory_order_relaxed);
+}
+#else
+typedef __vo uint32_t RING_Index_t;
+
+// The Cortex-M4 does not reorder memory accesses to normal memory, the DMB keeps the compiler
+// from moving the data accesses across the index accesses and orders them for the DMA.
+#define RING_DMB()					__asm volatile ("dmb" : : : "memory")
+
+static inline uint32_t RING_LOAD(RING_Index_t *p)					{ return *p; }
+static inline uint32_t RING_LOAD_ACQUIRE(RING_Index_t *p)			{ uint32_t v = *p; RING_DMB(); return v; }
+static inline void RING_STORE_RELEASE(RING_Index_t *p, uint32_t v)	{ RING_DMB(); *p = v; }
+#define RING_INDEX_INIT(v)			(v)
+
+// LDREX/STREX. An interrupt between the two clears the exclusive monitor, STREX then fails and
+// the caller tries again with the new value.
+static inline uint8_t RING_CompareExchange(RING_Index_t *p, uint32_t *pExpected, uint32_t Desired)
+{
+	uint32_t current, failed;
+
+	__asm volatile ("ldrex %0, [%1]" : "=r" (current) : "r" (p) : "memory");
+	if(current != *pExpected)
+	{
+		__asm volatile ("clrex" : : : "memory");
+		*pExpected = current;
+		return 0;
+	}
+	__asm volatile ("strex %0, %2, [%1]" : "=&r" (failed) : "r" (p), "r" (Desired) : "memory");
+	if(failed)
+	{
+		return 0;
+	}
+	RING_DMB();
+	return 1;
+}
+#endif
+
+// **********************************************************************
+// *               Single producer, single consumer                     *
+// **********************************************************************
+
+typedef struct
+{
+	RING_Index_t Head;			// Next slot to write, written by the producer only
+	RING_Index_t Tail;			// Next slot to read, written by the consumer only
+	uint32_t Count;				// Number of slots, a power of two
+	uint32_t ElemSize;			// In bytes
+	uint8_t *pBuffer;
+}RING_SPSC_t;
+
+// Defines a static, empty ring "Name" with storage for "Count" elements of "Type"
+#define RING_SPSC_DEFINE(Name, Type, Count)													\
+	_Static_assert( ((Count) & ((Count) - 1)) == 0, "Ring size must be a power of two");	\
+	static Type Name##_Storage[(Count)];													\
+	static RING_SPSC_t Name = { RING_INDEX_INIT(0), RING_INDEX_INIT(0), (Count), sizeof(Type), (uint8_t*)Name##_Storage }
+
+// Number of free slots that are next to each other, *ppSpan points to the first one
+static inline uint32_t RING_SPSC_WriteSpan(RING_SPSC_t *pRing, void **ppSpan)
+{
+	uint32_t head = RING_LOAD(&pRing->Head);
+	uint32_t free = pRing->Count - (head - RING_LOAD_ACQUIRE(&pRing->Tail));
+	uint32_t toEnd = pRing->Count - (head & (pRing->Count - 1));
+
+	*ppSpan = &pRing->pBuffer[(head & (pRing->Count - 1)) * pRing->ElemSize];
+	return (free < toEnd) ? free : toEnd;
+}
+
+// Hands the first "Len" slots of the write span to the consumer
+static inline void RING_SPSC_Commit(RING_SPSC_t *pRing, uint32_t Len)
+{
+	RING_STORE_RELEASE(&pRing->Head, RING_LOAD(&pRing->Head) + Len);
+}
+
+// Number of filled slots that are next to each other, *ppSpan points to the first one
+static inline uint32_t RING_SPSC_ReadSpan(RING_SPSC_t *pRing, void **ppSpan)
+{
+	uint32_t tail = RING_LOAD(&pRing->Tail);
+	uint32_t used = RING_LOAD_ACQUIRE(&pRing->Head) - tail;
+	uint32_t toEnd = pRing->Count - (tail & (pRing->Count - 1));
+
+	*ppSpan = &pRing->pBuffer[(tail & (pRing->Count - 1)) * pRing->ElemSize];
+	return (used < toEnd) ? used : toEnd;
+}
+
+// Gives the first "Len" slots of the read span back to the producer
+static inline void RING_SPSC_Release(RING_SPSC_t *pRing, uint32_t Len)
+{
+	RING_STORE_RELEASE(&pRing->Tail, RING_LOAD(&pRing->Tail) + Len);
+}
+
+// Copies one element in, returns 0 if the ring is full
+static inline uint8_t RING_SPSC_Push(RING_SPSC_t *pRing, const void *pElem)
+{
+	void *pSlot;
+
+	if(RING_SPSC_WriteSpan(pRing, &pSlot) == 0)
+	{
+		return 0;
+	}
+	memcpy(pSlot, pElem, pRing->ElemSize);
+	RING_SPSC_Commit(pRing, 1);
+	return 1;
+}
+
+// Copies one element out, returns 0 if the ring is empty
+static inline uint8_t RING_SPSC_Pop(RING_SPSC_t *pRing, void *pElem)
+{
+	void *pSlot;
+
+	if(RING_SPSC_ReadSpan(pRing, &pSlot) == 0)
+	{
+		return 0;
+	}
+	memcpy(pElem, pSlot, pRing->ElemSize);
+	RING_SPSC_Release(pRing, 1);
+	return 1;
+}
+
+static inline uint32_t RING_SPSC_Used(RING_SPSC_t *pRing)
+{
+	return RING_LOAD_ACQUIRE(&pRing->Head) - RING_LOAD_ACQUIRE(&pRing->Tail);
+}
+
+// **********************************************************************
+// *               Multiple producers, single consumer                  *
+// **********************************************************************
+
+typedef struct
+{
+	RING_Index_t Head;			// Next slot to claim, shared by the producers
+	uint32_t Tail;				// Next slot to read, consumer only
+	uint32_t Count;				// Number of slots, a power of two
+	uint32_t ElemSize;			// In bytes
+	uint8_t *pBuffer;
+	RING_Index_t *pSeq;			// Per slot: index i + 1 when written, i + Count when free for index i + Count
+}RING_MPSC_t;
+
+// Defines a static, empty ring "Name" with storage for "Count" elements of "Type".
+// RING_MPSC_Init must be called once before the ring is used.
+#define RING_MPSC_DEFINE(Name, Type, Count)													\
+	_Static_assert( ((Count) & ((Count) - 1)) == 0, "Ring size must be a power of two");	\
+	static Type Name##_Storage[(Count)];													\
+	static RING_Index_t Name##_Seq[(Count)];												\
+	static RING_MPSC_t Name = { RING_INDEX_INIT(0), 0, (Count), sizeof(Type), (uint8_t*)Name##_Storage, Name##_Seq }
+
+// Slot i is free for index i
+static inline void RING_MPSC_Init(RING_MPSC_t *pRing)
+{
+	for(uint32_t i = 0; i < pRing->Count; i++)
+	{
+		RING_STORE_RELEASE(&pRing->pSeq[i], i);
+	}
+	pRing->Tail = 0;
+	RING_STORE_RELEASE(&pRing->Head, 0);
+}
+
+// Claims "Len" free slots that are next to each other. Returns a pointer to the first one and
+// its index in *pIndex (for RING_MPSC_Publish), or NULL if there is not enough free space
+// before the end of the storage.
+static inline void *RING_MPSC_Reserve(RING_MPSC_t *pRing, uint32_t Len, uint32_t *pIndex)
+{
+	uint32_t mask = pRing->Count - 1;
+	uint32_t head = RING_LOAD(&pRing->Head);
+
+	do
+	{
+		uint32_t last = head + Len - 1;
+
+		if( (Len == 0) || ((head & mask) + Len > pRing->Count) )
+		{
+			return NULL;
+		}
+		// Slots are freed in order, so when the last one is free all of them are
+		if(RING_LOAD_ACQUIRE(&pRing->pSeq[last & mask]) != last)
+		{
+			return NULL;
+		}
+	}while(!RING_CompareExchange(&pRing->Head, &head, head + Len));
+
+	*pIndex = head;
+	return &pRing->pBuffer[(head & mask) * pRing->ElemSize];
+}
+
+// Hands reserved slots to the consumer
+static inline void RING_MPSC_Publish(RING_MPSC_t *pRing, uint32_t Index, uint32_t Len)
+{
+	for(uint32_t i = Index; i != Index + Len; i++)
+	{
+		RING_STORE_RELEASE(&pRing->pSeq[i & (pRing->Count - 1)], i + 1);
+	}
+}
+
+// Number of published slots that are next to each other, *ppSpan points to the first one.
+// Stops at the first slot that is claimed but not yet published.
+static inline uint32_t RING_MPSC_ReadSpan(RING_MPSC_t *pRing, void **ppSpan)
+{
+	uint32_t mask = pRing->Count - 1;
+	uint32_t tail = pRing->Tail;
+	uint32_t toEnd = pRing->Count - (tail & mask);
+	uint32_t n = 0;
+
+	while( (n < toEnd) && (RING_LOAD_ACQUIRE(&pRing->pSeq[(tail + n) & mask]) == tail + n + 1) )
+	{
+		n++;
+	}
+
+	*ppSpan = &pRing->pBuffer[(tail & mask) * pRing->ElemSize];
+	return n;
+}
+
+// Gives the first "Len" slots of the read span back to the producers
+static inline void RING_MPSC_Release(RING_MPSC_t *pRing, uint32_t Len)
+{
+	uint32_t tail = pRing->Tail;
+
+	for(uint32_t i = tail; i != tail + Len; i++)
+	{
+		RING_STORE_RELEASE(&pRing->pSeq[i & (pRing->Count - 1)], i + pRing->Count);
+	}
+	pRing->Tail = tail + Len;
+}
+
+// 1 if the next slot is not published yet. O(1), RING_MPSC_ReadSpan counts the whole span.
+static inline uint8_t RING_MPSC_Empty(RING_MPSC_t *pRing)
+{
+	uint32_t tail = pRing->Tail;
+
+	return (RING_LOAD_ACQUIRE(&pRing->pSeq[tail & (pRing->Count - 1)]) != tail + 1);
+}
+
+// Copies one element in, returns 0 if the ring is full
+static inline uint8_t RING_MPSC_Push(RING_MPSC_t *pRing, const void *pElem)
+{
+	uint32_t index;
+	void *pSlot = RING_MPSC_Reserve(pRing, 1, &index);
+
+	if(pSlot == NULL)
+	{
+		return 0;
+	}
+	memcpy(pSlot, pElem, pRing->ElemSize);
+	RING_MPSC_Publish(pRing, index, 1);
+	return 1;
+}
+
+// Copies one element out, returns 0 if the ring is empty
+static inline uint8_t RING_MPSC_Pop(RING_MPSC_t *pRing, void *pElem)
+{
+	uint32_t mask = pRing->Count - 1;
+	uint32_t tail = pRing->Tail;
+
+	if(RING_LOAD_ACQUIRE(&pRing->pSeq[tail & mask]) != tail + 1)
+	{
+		return 0;
+	}
+	memcpy(pElem, &pRing->pBuffer[(tail & mask) * pRing->ElemSize], pRing->ElemSize);
+	RING_MPSC_Release(pRing, 1);
+	return 1;
+}
+
+#endif /* INC_STM32F407XX_RING_H_ */
@@ -0,0 +1,135 @@
+/*
+ * stm32f407xx_sched.h
+ *
+ *  Created on: Feb 5, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_SCHED_H_
+#define INC_STM32F407XX_SCHED_H_
+
+#include "stm32f407xx.h"
+
+// Run-to-completion event scheduler for the main loop.
+//
+// Each task has a priority (0 is the highest, one task per priority) and its own event queue.
+// SCHED_Post puts an event in the queue and marks the priority ready; it may be called from any
+// interrupt and from the tasks. SCHED_Run takes one event at a time from the highest ready
+// priority and calls the task handler with it. Handlers run to completion, they are never
+// preempted by another task (only by interrupts), so tasks need no locks between them.
+//
+//	- Post and dispatch are O(1). The ready priorities are bits of one word, the highest one is
+//	  found with a single CLZ, the queues are RING_MPSC_t (no interrupt masking to post). A
+//	  ready bit is set and cleared with one store to its bit-band alias.
+//	- Deferred work: SCHED_Defer hands a function to the work task, for the part of an
+//	  interrupt that does not have to run in the interrupt.
+//	- Periodic tasks: SCHED_PeriodicStart posts an event to a task every PeriodMs from a
+//	  TIMEBASE timer.
+//	- When nothing is ready the core sleeps with WFI until the next interrupt (SCHED_IdleHook,
+//	  Sleep mode, with the peripheral clocks the RCC driver gates in Sleep mode turned off).
+//	- All storage is static (SCHED_TASK_DEFINE), nothing is allocated.
+//	- Each task counts its runs, run time in core cycles (DWT CYCCNT), the longest run, the
+//	  most events that waited in its queue and the posts refused because the queue was full.
+//
+// Example:
+//		SCHED_TASK_DEFINE(LedTask, LedHandler, NULL, 4);		// Queue of 4 events
+//		SCHED_Init(0);											// Work task at priority 0
+//		SCHED_TaskStart(&LedTask, 1);
+//		SCHED_PeriodicStart(&LedTick, &LedTask, LED_SIG_TOGGLE, 250);
+//		SCHED_Run();											// Never returns
+//
+// The scheduler sits on top of the drivers (it uses the timebase timers), so it is not included
+// by stm32f407xx.h, include this header where it is used.
+
+#define SCHED_MAX_PRIO				32		// Bits of the ready word
+#define SCHED_WORK_QUEUE_LEN		16		// Deferred work items that can wait at once, a power of two
+
+// Status codes
+#define SCHED_OK					0
+#define SCHED_ERR_PARAM				1		// Priority out of range or already used
+#define SCHED_ERR_FULL				2		// Queue full, the event is dropped
+
+// Signals from 0 to SCHED_SIG_USER - 1 are used by the scheduler
+// @SCHED_SIGNALS
+#define SCHED_SIG_WORK				0		// Param: SCHED_Work_t pointer
+#define SCHED_SIG_USER				16
+
+struct SCHED_Task;
+
+// An event, copied into the queue of the task
+typedef struct
+{
+	uint32_t Signal;					// What happened, @SCHED_SIGNALS and up
+	uintptr_t Param;					// A value or a pointer, up to the signal
+}SCHED_Event_t;
+
+// Task handler, called once per event
+typedef void (*SCHED_Handler_t)(struct SCHED_Task *pTask, const SCHED_Event_t *pEvent);
+
+// A task. Defined with SCHED_TASK_DEFINE, the fields are private to the scheduler except
+// pArg and the statistics, which may be read at any time.
+typedef struct SCHED_Task
+{
+	SCHED_Handler_t pHandler;
+	void *pArg;							// For the handler
+	RING_MPSC_t *pQueue;
+	uint8_t ReadyBit;					// Bit of the priority in the ready word, 31 - Priority
+	uint8_t Priority;
+
+	// Statistics, cleared by SCHED_ResetStats
+	uint32_t RunCount;					// Events handled
+	uint64_t RunCycles;					// Core cycles spent in the handler
+	uint32_t MaxCycles;					// Longest single run
+	uint32_t QueueHighWater;			// Most events waiting at once
+	RING_Index_t Dropped;				// Posts refused because the queue was full
+}SCHED_Task_t;
+
+// Deferred work item. Owned by the caller (usually static), must stay valid until it has run.
+typedef struct
+{
+	void (*pFunc)(void *pArg);
+	void *pArg;
+}SCHED_Work_t;
+
+// Periodic event. Owned by the caller (usually static).
+typedef struct
+{
+	TIMEBASE_Timer_t Timer;
+	SCHED_Task_t *pTask;
+	uint32_t Signal;					// Posted with the time in ms as Param
+}SCHED_Periodic_t;
+
+// Defines a static task "Name" with a queue of "QueueLen" events (a power of two).
+// SCHED_TaskStart gives it its priority.
+#define SCHED_TASK_DEFINE(Name, Handler, Arg, QueueLen)										\
+	RING_MPSC_DEFINE(Name##_Queue, SCHED_Event_t, QueueLen);								\
+	static SCHED_Task_t Name = { .pHandler = (Handler), .pArg = (Arg), .pQueue = &Name##_Queue }
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+// Init
+void SCHED_Init(uint8_t WorkPriority);
+uint8_t SCHED_TaskStart(SCHED_Task_t *pTask, uint8_t Priority);
+
+// Events, from interrupts or tasks
+uint8_t SCHED_Post(SCHED_Task_t *pTask, uint32_t Signal, uintptr_t Param);
+uint8_t SCHED_Defer(SCHED_Work_t *pWork);
+
+// Periodic events, from the main loop only (they are TIMEBASE timers)
+void SCHED_PeriodicStart(SCHED_Periodic_t *pPeriodic, SCHED_Task_t *pTask, uint32_t Signal, uint32_t PeriodMs);
+void SCHED_PeriodicStop(SCHED_Periodic_t *pPeriodic);
+
+// Main loop
+uint8_t SCHED_RunOnce(void);		// Handles one event, 0 if nothing was ready
+void SCHED_Run(void);				// Never returns
+void SCHED_IdleHook(void);			// Weak, RCC_Sleep
+
+// Statistics
+void SCHED_ResetStats(SCHED_Task_t *pTask);
+uint32_t SCHED_GetIdleCount(void);	// Times the core went to sleep
+SCHED_Task_t *SCHED_GetWorkTask(void);
+
+#endif /* INC_STM32F407XX_SCHED_H_ */
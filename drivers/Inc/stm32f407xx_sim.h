@@ -0,0 +1,101 @@
+/*
+ * stm32f407xx_sim.h
+ *
+ *  Created on: Nov 6, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_SIM_H_
+#define INC_STM32F407XX_SIM_H_
+
+// Host register simulator
+//
+// Build the drivers with -DSTM32F407XX_SIM (and stm32f407xx_sim.c) to run them on a PC.
+// The peripheral buses are then blocks of host memory (SIM_APB1Mem, SIM_AHB1Mem ...), so
+// GPIOA ... GPIOI and RCC point into host memory with the same register layout as the chip.
+// Every REG_READ/REG_WRITE of the drivers goes through SIM_Read/SIM_Write, which
+//	- counts the reads and writes of each register
+//	- models the side effects of the hardware:
+//		* BSRR writes set/reset ODR bits, BSRR and IDR read back as on the chip
+//		* IDR shows the ODR level on output pins and the SIM_SetInputPort level on the others
+//		* setting a bit in RCC AHB1RSTR resets the registers of that GPIO port
+//		* RCC CR ready flags follow HSION/HSEON/PLLON and CFGR SWS follows SW right away
+//		* writes to a GPIO port with its clock disabled in RCC AHB1ENR are ignored
+//		* IDR edges set EXTI_PR for lines routed to the port (SYSCFG_EXTICR) that are unmasked
+//		  and have the edge enabled, EXTI_PR is write-1-to-clear and SWIER sets pending bits
+//		* NVIC ISER/ICER set and clear the enable bits and both read back the enable state
+//		* SysTick counts down from LOAD when enabled, every read of VAL advances it by a few
+//		  cycles (so busy-waits end), COUNTFLAG is cleared by reading CTRL
+//		* DMA LIFCR/HIFCR clear the flags in LISR/HISR, the transfers themselves are not done,
+//		  SIM_DMAComplete plays the end of a buffer (flags and double buffer target switch).
+//		  Clearing EN of an enabled stream sets its TCIF, as on the chip.
+//		* TIM SR flags are rc_w0 (a write clears the flags written as 0), the counters do not run
+//		* SPI MOSI is looped back to MISO: a DR write of an enabled SPI sets RXNE (and OVR if
+//		  RXNE was set), reading DR clears RXNE and the SR read after it clears OVR
+//		* I2C START and STOP in CR1 take effect at once (SB, SR2 MSL/BUSY), a DR write clears
+//		  SB and BTF, an SR2 read clears ADDR and a DR read takes the next received byte (see
+//		  SIM_I2CReceive). The slave (ADDR, AF, TXE, ACK decisions) is played by the test code.
+//		* DWT CYCCNT counts simulated core cycles when enabled in DEMCR and DWT CTRL
+//		* the simulated cycles are added up per peripheral clock that runs (RCC xxxENR, and
+//		  xxxLPENR too for the cycles the core sleeps), so the clock gating can be measured
+//
+// An IRQ is not entered by itself, the test code calls the handler (e.g. EXTI0_IRQHandler,
+// SysTick_Handler) when the interrupt it wants to serve is pending.
+//
+// Threads: each simulated register access (SIM_Read/SIM_Write) and each SIM_xxx call is atomic,
+// with its side effects and its counters, so test code may stand in for interrupts with
+// threads that use the drivers at the same time. Only that access is atomic: the PRIMASK
+// critical sections of the drivers are empty on the host, so a sequence of accesses is only
+// safe where the driver has a host lock of its own (the GPIO shadow registers) or is lock
+// free (stm32f407xx_ring.h).
+//
+// The host tests and benchmarks are in tests/, "make -C tests" builds and runs them.
+
+#include "stm32f407xx.h"
+
+#ifdef STM32F407XX_SIM
+
+// Register access, SIM_Read and SIM_Write are declared next to the REG_xxx macros in stm32f407xx.h
+
+// Simulator control
+void SIM_Reset(void);				// All registers to their reset values and all counters to zero
+void SIM_ResetCounters(void);		// Counters to zero, registers are not changed
+
+// Bus access accounting
+uint32_t SIM_GetReadCount(__vo uint32_t *pReg);		// Reads of one register since the last counter reset
+uint32_t SIM_GetWriteCount(__vo uint32_t *pReg);	// Writes of one register since the last counter reset
+uint32_t SIM_GetTotalReads(void);					// Reads of all simulated registers
+uint32_t SIM_GetTotalWrites(void);					// Writes of all simulated registers
+#define SIM_GetAccessCount(pReg)	(SIM_GetReadCount(pReg) + SIM_GetWriteCount(pReg))
+#define SIM_GetTotalAccesses()		(SIM_GetTotalReads() + SIM_GetTotalWrites())
+
+// External world
+void SIM_SetInputPort(GPIO_RegDef_t *pGPIOx, uint16_t Value);	// Level driven on the pins of a port
+
+// End of the current buffer of an enabled DMA stream: sets TCIF, switches CT in double buffer
+// mode, reloads NDTR in circular and double buffer mode and disables the stream in normal
+// mode. The DMA interrupt handler is not called.
+void SIM_DMAComplete(DMA_RegDef_t *pDMAx, uint8_t Stream);
+// Items transfers of an enabled stream: NDTR counts down, HTIF is set at the half of the
+// buffer and the end is played as by SIM_DMAComplete. The data is not moved, the test code
+// writes or reads the memory buffer itself.
+void SIM_DMAAdvance(DMA_RegDef_t *pDMAx, uint8_t Stream, uint32_t Items);
+
+// A byte received by an I2C master: goes to DR (RXNE), or to the shift register (BTF) when DR
+// is full. Returns 0 when both are full, the slave then has to wait (clock stretching).
+uint8_t SIM_I2CReceive(I2C_RegDef_t *pI2Cx, uint8_t Value);
+
+// Simulated time, advances the DWT cycle counter and SysTick by a number of core cycles.
+// Returns the number of SysTick interrupts that are due.
+uint32_t SIM_AdvanceCycles(uint32_t Cycles);
+
+// The same with the core asleep (WFI in Sleep mode), the peripheral clocks gated in xxxLPENR
+// do not run.
+uint32_t SIM_SleepCycles(uint32_t Cycles);
+
+// Core cycles a peripheral clock ran since the last counter reset, ClkId from @RCC_CLK_IDS
+uint64_t SIM_GetClockOnCycles(uint8_t ClkId);
+
+#endif /* STM32F407XX_SIM */
+
+#endif /* INC_STM32F407XX_SIM_H_ */
@@ -0,0 +1,112 @@
+/*
+ * stm32f407xx_softpwm.h
+ *
+ *  Created on: Feb 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_SOFTPWM_H_
+#define INC_STM32F407XX_SOFTPWM_H_
+
+#include "stm32f407xx.h"
+
+// Software PWM on plain GPIO output pins, up to SOFTPWM_MAX_CHANNELS on up to SOFTPWM_MAX_PORTS
+// ports, driven by one general purpose timer (TIM2 - TIM5).
+//
+// The duties are turned into an event list sorted by time. The first event (time 0) sets all
+// pins with a duty above 0 and resets the others, every following event resets the pins whose
+// duty ends at its time. All pins of a port that change at the same time are one BSRR word, so
+// an event is one store per port. The update interrupt starts the period with the first event,
+// the compare 1 interrupt is moved from event to event. An event that is already due when the
+// compare is set is done in the same interrupt. The interrupts per period are 1 + the number
+// of distinct duties, not the number of channels.
+//
+// SOFTPWM_SetDuty only stores the duty. SOFTPWM_Commit builds the new list in the second buffer
+// and the update interrupt switches to it at the start of the next period, so a period is never
+// made from two lists and no pulse is cut or doubled.
+//
+// Duty is in timer ticks, 0 (always low) - PeriodTicks (always high).
+
+#define SOFTPWM_MAX_CHANNELS		32
+#define SOFTPWM_MAX_PORTS			4
+#define SOFTPWM_MAX_EVENTS			(SOFTPWM_MAX_CHANNELS + 1)	// Period start and one per distinct duty
+
+// Status codes
+#define SOFTPWM_OK					0
+#define SOFTPWM_ERR_CONFIG			1	// Bad channel count, pin, timer or too many ports
+#define SOFTPWM_ERR_RATE			2	// Tick rate or period can not be made with the timer clock
+
+// One output, the pin must be configured as output by the caller (GPIO_InitPort)
+typedef struct
+{
+	GPIO_RegDef_t *pGPIOx;
+	uint8_t Pin;
+}SOFTPWM_Pin_t;
+
+typedef struct
+{
+	const SOFTPWM_Pin_t *pPins;			// Channel i is pPins[i]
+	uint8_t ChannelCount;				// 1 - SOFTPWM_MAX_CHANNELS
+	TIM_RegDef_t *pTIMx;				// TIM2 - TIM5
+	uint32_t TimerClockHz;				// Input clock of the timer
+	uint32_t TickHz;					// Duty resolution, TimerClockHz / TickHz must be whole
+	uint16_t PeriodTicks;				// 2 - 0xFFFF, PWM frequency is TickHz / PeriodTicks
+	uint8_t IRQPriority;
+}SOFTPWM_Config_t;
+
+// One event: the BSRR word of each port at Time ticks into the period
+typedef struct
+{
+	uint32_t Time;
+	uint32_t BSRR[SOFTPWM_MAX_PORTS];
+}SOFTPWM_Event_t;
+
+typedef struct
+{
+	SOFTPWM_Event_t Event[SOFTPWM_MAX_EVENTS];
+	uint8_t Count;
+}SOFTPWM_List_t;
+
+typedef struct
+{
+	SOFTPWM_Config_t Config;
+	uint16_t Duty[SOFTPWM_MAX_CHANNELS];
+
+	// Set by SOFTPWM_Init
+	GPIO_RegDef_t *pPorts[SOFTPWM_MAX_PORTS];
+	uint8_t PortCount;
+	uint8_t PortOf[SOFTPWM_MAX_CHANNELS];	// Index in pPorts of each channel
+	uint16_t PortPins[SOFTPWM_MAX_PORTS];	// All channel pins of each port
+
+	// Event lists, the interrupt plays List[Active]
+	SOFTPWM_List_t List[2];
+	__vo uint8_t Active;
+	RING_Index_t Pending;				// 1: the other list is new, switch at the next period
+	uint8_t Next;						// Next event of the active list
+	uint8_t Running;
+
+	// Statistics
+	uint32_t Periods;
+	uint32_t Interrupts;
+	uint32_t Overruns;					// Periods that started with events of the last one not done
+}SOFTPWM_Handle_t;
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+// Init and control
+uint8_t SOFTPWM_Init(SOFTPWM_Handle_t *pHandle);
+void SOFTPWM_DeInit(SOFTPWM_Handle_t *pHandle);
+void SOFTPWM_Start(SOFTPWM_Handle_t *pHandle);
+void SOFTPWM_Stop(SOFTPWM_Handle_t *pHandle);		// All outputs low
+
+// Duty
+void SOFTPWM_SetDuty(SOFTPWM_Handle_t *pHandle, uint8_t Channel, uint16_t Duty);
+void SOFTPWM_Commit(SOFTPWM_Handle_t *pHandle);		// New duties from the next period on
+
+// Event list, also usable on its own (host tests)
+void SOFTPWM_BuildList(const SOFTPWM_Handle_t *pHandle, SOFTPWM_List_t *pList);
+
+#endif /* INC_STM32F407XX_SOFTPWM_H_ */
@@ -0,0 +1,219 @@
+/*
+ * stm32f407xx_spi_driver.h
+ *
+ *  Created on: Jan 8, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_SPI_DRIVER_H_
+#define INC_STM32F407XX_SPI_DRIVER_H_
+
+#include "stm32f407xx.h"
+
+// SPI driver (ch. 28), master or slave, 8 or 16 bit frames.
+//
+// Transfers:
+//	- blocking: SPI_TransferBlocking (and SPI_SendData/SPI_ReceiveData)
+//	- transaction queue: SPI_Submit queues caller owned SPI_Transaction_t, each one is run in
+//	  interrupt or DMA mode (SPI_Handle_t XferMode) straight from and into the caller's buffers.
+//	  The chip select pin of a transaction is driven low around it through the GPIO driver,
+//	  SPI_TXN_CS_HOLD keeps it low for the next transaction (command + data chains).
+//	- streaming: SPI_StreamStart plays or fills two buffers in turn with DMA double buffer mode,
+//	  the callback gets the buffer that is done while the other one is transferred.
+//
+// Buffers used with DMA must be in SRAM1/SRAM2, the DMA can not reach the CCM RAM.
+// SPI1 (APB2, up to 42 Mbit/s) uses DMA2, SPI2 and SPI3 (APB1, up to 21 Mbit/s) use DMA1.
+
+// Configuration structure for SPIx peripheral
+typedef struct
+{
+	uint8_t SPI_DeviceMode;		// Possible values from @SPI_DEVICE_MODE
+	uint8_t SPI_BusConfig;		// Possible values from @SPI_BUS_CONFIG
+	uint8_t SPI_SclkSpeed;		// Possible values from @SPI_SCLK_SPEED
+	uint8_t SPI_DFF;			// Possible values from @SPI_DFF
+	uint8_t SPI_CPOL;			// Possible values from @SPI_CPOL
+	uint8_t SPI_CPHA;			// Possible values from @SPI_CPHA
+	uint8_t SPI_SSM;			// Possible values from @SPI_SSM
+}SPI_Config_t;
+
+struct SPI_Transaction;
+
+// Transaction done callback, runs in interrupt context
+typedef void (*SPI_TxnCallback_t)(struct SPI_Transaction *pTxn, void *pArg);
+
+// Stream callback, pBuffer has been sent (or filled) and can be refilled (or read). Runs in
+// interrupt context.
+typedef void (*SPI_StreamCallback_t)(void *pBuffer, void *pArg);
+
+// One transfer of the queue. Owned by the caller and must stay valid until its Status is
+// SPI_TXN_DONE or SPI_TXN_ERROR, the driver never copies the data.
+typedef struct SPI_Transaction
+{
+	struct SPI_Transaction *pNext;	// Private to the driver
+	GPIO_RegDef_t *pCSPort;			// Chip select port, NULL for none
+	uint16_t CSPin;					// Chip select pin mask, @GPIO_PIN_MASKS, active low
+	uint8_t Flags;					// Possible values from @SPI_TXN_FLAGS
+	__vo uint8_t Status;			// Possible values from @SPI_TXN_STATUS
+	const void *pTxBuffer;			// NULL sends 0xFF
+	void *pRxBuffer;				// NULL drops the received data
+	uint16_t Len;					// Length in bytes (even for 16 bit frames)
+	SPI_TxnCallback_t pCallback;	// Optional
+	void *pArg;
+}SPI_Transaction_t;
+
+// Handle structure for SPIx peripheral
+typedef struct
+{
+	SPI_RegDef_t *pSPIx;			// Base address of SPIx(x:1,2,3) peripheral
+	SPI_Config_t SPIConfig;
+	uint8_t XferMode;				// Possible values from @SPI_XFER_MODE, used by the queue
+	uint8_t IRQPriority;			// Priority of the SPI and DMA interrupts
+
+	// Set by SPI_Init
+	DMA_RegDef_t *pDMAx;			// NULL when the DMA streams are used by another driver
+	uint8_t RxStream;
+	uint8_t TxStream;
+	uint8_t DMAChannel;
+
+	// Transfer in progress
+	const uint8_t *pTxBuffer;
+	uint8_t *pRxBuffer;
+	uint16_t TxLen;					// Bytes left to send
+	uint16_t RxLen;					// Bytes left to receive
+	__vo uint8_t State;				// Possible values from @SPI_STATE
+
+	// Transaction queue
+	SPI_Transaction_t *pHead;		// Transaction in progress
+	SPI_Transaction_t *pTail;
+
+	// Streaming
+	SPI_StreamCallback_t pStreamCallback;
+	void *pStreamArg;
+	void *pStreamBuffer[2];
+	uint8_t StreamDir;
+}SPI_Handle_t;
+
+// @SPI_DEVICE_MODE
+#define SPI_DEVICE_MODE_SLAVE		0
+#define SPI_DEVICE_MODE_MASTER		1
+
+// @SPI_BUS_CONFIG
+#define SPI_BUS_CONFIG_FD			1	// Full duplex
+#define SPI_BUS_CONFIG_HD			2	// Half duplex, one bidirectional data line
+#define SPI_BUS_CONFIG_SIMPLEX_RXONLY	3
+
+// @SPI_SCLK_SPEED, SCLK = PCLK / divider
+#define SPI_SCLK_SPEED_DIV2			0
+#define SPI_SCLK_SPEED_DIV4			1
+#define SPI_SCLK_SPEED_DIV8			2
+#define SPI_SCLK_SPEED_DIV16		3
+#define SPI_SCLK_SPEED_DIV32		4
+#define SPI_SCLK_SPEED_DIV64		5
+#define SPI_SCLK_SPEED_DIV128		6
+#define SPI_SCLK_SPEED_DIV256		7
+
+// @SPI_DFF
+#define SPI_DFF_8BITS				0
+#define SPI_DFF_16BITS				1
+
+// @SPI_CPOL
+#define SPI_CPOL_LOW				0
+#define SPI_CPOL_HIGH				1
+
+// @SPI_CPHA
+#define SPI_CPHA_LOW				0
+#define SPI_CPHA_HIGH				1
+
+// @SPI_SSM
+#define SPI_SSM_DI					0
+#define SPI_SSM_EN					1	// Software slave management, NSS pin free for other use
+
+// @SPI_XFER_MODE
+#define SPI_XFER_IT					0
+#define SPI_XFER_DMA				1
+
+// @SPI_STATE
+#define SPI_READY					0
+#define SPI_BUSY					1	// Transaction in progress
+#define SPI_STREAMING				2
+
+// @SPI_TXN_FLAGS
+#define SPI_TXN_CS_HOLD				(1U << 0)	// Chip select stays low for the next transaction
+
+// @SPI_TXN_STATUS
+#define SPI_TXN_IDLE				0
+#define SPI_TXN_QUEUED				1
+#define SPI_TXN_ACTIVE				2
+#define SPI_TXN_DONE				3
+#define SPI_TXN_ERROR				4	// Overrun or mode fault
+
+// @SPI_STREAM_DIR
+#define SPI_STREAM_TX				0	// Buffers are sent, received data is dropped (displays, DACs)
+#define SPI_STREAM_RX				1	// Buffers are filled, 0xFF is sent (ADC front-ends)
+
+// Status codes
+#define SPI_OK						0
+#define SPI_ERR_BUSY				1	// Streaming, or no DMA streams (SPI_Init)
+#define SPI_ERR_PARAM				2
+
+// Bit position definitions of SPI peripheral (ch. 28.5)
+#define SPI_CR1_CPHA				0
+#define SPI_CR1_CPOL				1
+#define SPI_CR1_MSTR				2
+#define SPI_CR1_BR					3
+#define SPI_CR1_SPE					6
+#define SPI_CR1_LSBFIRST			7
+#define SPI_CR1_SSI					8
+#define SPI_CR1_SSM					9
+#define SPI_CR1_RXONLY				10
+#define SPI_CR1_DFF					11
+#define SPI_CR1_BIDIOE				14
+#define SPI_CR1_BIDIMODE			15
+
+#define SPI_CR2_RXDMAEN				0
+#define SPI_CR2_TXDMAEN				1
+#define SPI_CR2_SSOE				2
+#define SPI_CR2_ERRIE				5
+#define SPI_CR2_RXNEIE				6
+#define SPI_CR2_TXEIE				7
+
+#define SPI_SR_RXNE					0
+#define SPI_SR_TXE					1
+#define SPI_SR_MODF					5
+#define SPI_SR_OVR					6
+#define SPI_SR_BSY					7
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+// Peripheral clock setup
+void SPI_PeriClockControl(SPI_RegDef_t *pSPIx, uint8_t EnorDi);
+
+// Init and De-init
+uint8_t SPI_Init(SPI_Handle_t *pSPIHandle);
+void SPI_DeInit(SPI_RegDef_t *pSPIx);
+void SPI_PeripheralControl(SPI_RegDef_t *pSPIx, uint8_t EnorDi);
+
+// Blocking data send and receive
+void SPI_TransferBlocking(SPI_RegDef_t *pSPIx, const void *pTxBuffer, void *pRxBuffer, uint32_t Len);
+void SPI_SendData(SPI_RegDef_t *pSPIx, const uint8_t *pTxBuffer, uint32_t Len);
+void SPI_ReceiveData(SPI_RegDef_t *pSPIx, uint8_t *pRxBuffer, uint32_t Len);
+
+// Transaction queue (interrupt or DMA)
+uint8_t SPI_Submit(SPI_Handle_t *pSPIHandle, SPI_Transaction_t *pTxn);
+uint8_t SPI_IsIdle(SPI_Handle_t *pSPIHandle);
+
+// Double buffered streaming (DMA)
+uint8_t SPI_StreamStart(SPI_Handle_t *pSPIHandle, uint8_t Direction, void *pBuffer0, void *pBuffer1, uint16_t Len,
+		SPI_StreamCallback_t pCallback, void *pArg);
+void SPI_StreamStop(SPI_Handle_t *pSPIHandle);
+
+// IRQ configuration and ISR handling
+void SPI_IRQHandling(SPI_Handle_t *pSPIHandle);
+void SPI1_IRQHandler(void);
+void SPI2_IRQHandler(void);
+void SPI3_IRQHandler(void);
+
+#endif /* INC_STM32F407XX_SPI_DRIVER_H_ */
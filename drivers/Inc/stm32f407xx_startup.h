@@ -0,0 +1,73 @@
+/*
+ * stm32f407xx_startup.h
+ *
+ *  Created on: Mar 5, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_STARTUP_H_
+#define INC_STM32F407XX_STARTUP_H_
+
+#include "stm32f407xx.h"
+
+// Startup of the project: vector table, reset handler and boot time milestones.
+//
+// The linker script is STM32F407VGTX_FLASH.ld in the top directory, the startup file that the
+// IDE generates (startup_stm32f407vgtx.s) must be left out of the build. The reset handler:
+//	1. starts the DWT cycle counter from 0 (a system reset does not clear it)
+//	2. turns the FPU on
+//	3. calls BOOT_EarlyInit, weak and empty. The application can raise the clock here
+//	   (FLASH_EnableART, RCC_ClockConfig), so the section copies run at full speed. It runs
+//	   before .data and .bss exist, so it may only use locals, constants and registers.
+//	4. sets up the RAM sections with MEM_InitSections (stm32f407xx_mem.h)
+//	5. runs the C++/constructor init arrays and calls main
+//
+// Each step is a milestone, timestamped in cycles since reset. The application adds its own
+// with BOOT_Milestone, BOOT_MILESTONE_READY when it is fully up (the time that counts after a
+// watchdog reset). The cycles are core clock cycles, with a clock change in BOOT_EarlyInit they
+// are not a time, so compare them between builds with the same clock setup.
+//
+// Subsystems that are not needed at once are initialized lazily with BOOT_Lazy_t, either on
+// first use (BOOT_LazyEnsure) or one at a time when the main loop is idle (BOOT_LazyRunNext).
+
+#define BOOT_MAX_MILESTONES			8
+#define BOOT_NOT_REACHED			0xFFFFFFFFU		// BOOT_GetCycles of a milestone not reached yet
+
+// @BOOT_MILESTONE
+#define BOOT_MILESTONE_RESET		0	// Reset handler entered, always 0 cycles
+#define BOOT_MILESTONE_CLOCK		1	// BOOT_EarlyInit returned
+#define BOOT_MILESTONE_SECTIONS		2	// .data, .bss, .ccmram and .ccmbss ready
+#define BOOT_MILESTONE_MAIN			3	// main called
+#define BOOT_MILESTONE_READY		4	// Set by the application
+#define BOOT_MILESTONE_USER			5	// The application uses BOOT_MILESTONE_USER and up
+
+// Lazy initialization of a subsystem
+typedef struct BOOT_Lazy
+{
+	void (*pInit)(void);
+	struct BOOT_Lazy *pNext;			// Queue of BOOT_LazyRunNext
+	__vo uint8_t State;					// 0: not done, 1: queued, 2: done
+}BOOT_Lazy_t;
+
+#define BOOT_LAZY_DEFINE(Name, InitFn)	static BOOT_Lazy_t Name = { (InitFn), NULL, 0 }
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+// Milestones
+void BOOT_Milestone(uint8_t Id);
+uint32_t BOOT_GetCycles(uint8_t Id);			// Cycles since reset, BOOT_NOT_REACHED if not reached
+
+// Lazy initialization, from thread context (not from interrupts)
+void BOOT_LazyRegister(BOOT_Lazy_t *pLazy);		// Queue for BOOT_LazyRunNext
+void BOOT_LazyEnsure(BOOT_Lazy_t *pLazy);		// Runs the init now if it was not done yet
+uint8_t BOOT_LazyRunNext(void);					// Runs the next queued init, 1 if one was run
+
+// Startup hooks and handlers
+void BOOT_EarlyInit(void);						// Weak, before the RAM sections are set up
+void Reset_Handler(void);
+void Default_Handler(void);
+
+#endif /* INC_STM32F407XX_STARTUP_H_ */
@@ -0,0 +1,76 @@
+/*
+ * stm32f407xx_tim_driver.h
+ *
+ *  Created on: Nov 27, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_TIM_DRIVER_H_
+#define INC_STM32F407XX_TIM_DRIVER_H_
+
+#include "stm32f407xx.h"
+
+// Basic time base of the general purpose and advanced timers, used as a DMA request source.
+// TIM2 and TIM5 have 32-bit counters, this driver uses all timers as 16-bit.
+// The interrupts of TIM2 - TIM5 (update and compare) are passed to a registered callback.
+
+// Callback from the timer interrupt, Flags are the SR bits that were set and enabled (already cleared)
+typedef void (*TIM_Callback_t)(void *pArg, uint32_t Flags);
+
+// TIMx control register 1 bits (ch. 17.4.1)
+#define TIM_CR1_CEN				(1U << 0)	// Counter enable
+#define TIM_CR1_URS				(1U << 2)	// Only counter overflow generates an update interrupt/DMA
+#define TIM_CR1_ARPE			(1U << 7)	// ARR is buffered
+
+// TIMx control register 2, master mode selection: the event sent on TRGO (ch. 17.4.2)
+#define TIM_CR2_MMS_POS			4
+#define TIM_CR2_MMS_MASK		(7U << TIM_CR2_MMS_POS)
+
+// @TIM_MMS
+#define TIM_MMS_RESET			0	// UG bit
+#define TIM_MMS_ENABLE			1	// Counter enable
+#define TIM_MMS_UPDATE			2	// Update event, a trigger at the update rate (ADC, other timers)
+
+// TIMx DMA/interrupt enable register bits
+#define TIM_DIER_UIE			(1U << 0)	// Update interrupt
+#define TIM_DIER_CC1IE			(1U << 1)	// Capture/compare 1 interrupt
+#define TIM_DIER_UDE			(1U << 8)	// Update DMA request
+
+// TIMx status register bits, rc_w0 (written 0 to clear, 1 leaves them)
+#define TIM_SR_UIF				(1U << 0)
+#define TIM_SR_CC1IF			(1U << 1)
+#define TIM_EGR_UG				(1U << 0)
+
+#define TIM_PSC_MAX				0xFFFFU
+#define TIM_ARR_MAX				0xFFFFU
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+// Peripheral clock setup
+void TIM_PeriClockControl(TIM_RegDef_t *pTIMx, uint8_t EnorDi);
+void TIM_SleepClockControl(TIM_RegDef_t *pTIMx, uint8_t EnorDi);		// While the timer runs
+
+// Time base
+uint32_t TIM_SetUpdateRate(TIM_RegDef_t *pTIMx, uint32_t TimerClockHz, uint32_t RateHz);
+void TIM_UpdateDMAControl(TIM_RegDef_t *pTIMx, uint8_t EnorDi);
+uint8_t TIM_GetUpdateDMARequest(TIM_RegDef_t *pTIMx, uint8_t *pStream, uint8_t *pChannel);	// DMA2 stream/channel of TIMx_UP
+void TIM_SetMasterMode(TIM_RegDef_t *pTIMx, uint8_t Mode);	// Mode: @TIM_MMS
+void TIM_Start(TIM_RegDef_t *pTIMx);
+void TIM_Stop(TIM_RegDef_t *pTIMx);
+
+// IRQ configuration and ISR handling, TIM2 - TIM5
+uint8_t TIM_GetIRQNumber(TIM_RegDef_t *pTIMx);
+void TIM_RegisterCallback(TIM_RegDef_t *pTIMx, TIM_Callback_t pCallback, void *pArg);
+TIM_Callback_t TIM_GetCallback(TIM_RegDef_t *pTIMx);
+void TIM_IRQHandling(TIM_RegDef_t *pTIMx);
+
+// Timer interrupt handlers (weak, call TIM_IRQHandling)
+void TIM2_IRQHandler(void);
+void TIM3_IRQHandler(void);
+void TIM4_IRQHandler(void);
+void TIM5_IRQHandler(void);
+
+#endif /* INC_STM32F407XX_TIM_DRIVER_H_ */
@@ -0,0 +1,70 @@
+/*
+ * stm32f407xx_timebase.h
+ *
+ *  Created on: Nov 13, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_TIMEBASE_H_
+#define INC_STM32F407XX_TIMEBASE_H_
+
+#include "stm32f407xx.h"
+
+// Monotonic timebase on the Cortex-M4 SysTick timer.
+//
+// SysTick runs from the core clock and interrupts every 1 ms. The interrupt only counts
+// milliseconds, everything else is done outside of it:
+//	- TIMEBASE_GetMs/TIMEBASE_GetUs read the time, the us part comes from the SysTick counter
+//	- TIMEBASE_DelayUs/TIMEBASE_DelayMs busy-wait on the SysTick counter, calibrated to the
+//	  core clock given to TIMEBASE_Init, so they do not depend on compiler flags
+//	- software timers (one-shot and periodic) are kept in a timer wheel and their callbacks
+//	  are run from TIMEBASE_Process, called from the main loop, never from the interrupt
+
+// Number of slots of the timer wheel, must be a power of 2. A timer is kept in the slot of
+// the tick it expires on, so each tick only looks at the timers of one slot.
+#define TIMEBASE_WHEEL_SIZE			64
+
+// Software timer callback, pArg is the argument given to TIMEBASE_TimerStart
+typedef void (*TIMEBASE_Callback_t)(void *pArg);
+
+// Software timer. Owned by the caller (usually static), the timebase never allocates memory.
+// The fields are private to the timebase.
+typedef struct TIMEBASE_Timer
+{
+	struct TIMEBASE_Timer *pNext;		// Timers in the same wheel slot
+	struct TIMEBASE_Timer *pPrev;
+	uint32_t Expiry;					// Tick the timer fires on
+	uint32_t PeriodMs;					// 0 for a one-shot timer
+	TIMEBASE_Callback_t pCallback;
+	void *pArg;
+	uint8_t Active;
+}TIMEBASE_Timer_t;
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+// Init
+void TIMEBASE_Init(uint32_t CoreClockHz);
+
+// Time
+uint32_t TIMEBASE_GetMs(void);		// Milliseconds since TIMEBASE_Init, wraps after 49.7 days
+uint64_t TIMEBASE_GetUs(void);		// Microseconds since TIMEBASE_Init
+#define TIMEBASE_Elapsed(DeadlineMs)	( (int32_t)(TIMEBASE_GetMs() - (uint32_t)(DeadlineMs)) >= 0 )	// Wrap safe
+
+// Blocking delays
+void TIMEBASE_DelayUs(uint32_t Us);
+void TIMEBASE_DelayMs(uint32_t Ms);
+
+// Software timers, used from the main loop only (not from interrupts)
+void TIMEBASE_TimerStart(TIMEBASE_Timer_t *pTimer, uint32_t DelayMs, uint32_t PeriodMs, TIMEBASE_Callback_t pCallback, void *pArg);
+void TIMEBASE_TimerStop(TIMEBASE_Timer_t *pTimer);
+uint32_t TIMEBASE_Process(void);	// Runs the callbacks of expired timers, returns how many ran
+uint8_t TIMEBASE_Pending(void);		// 1 if a tick came in that TIMEBASE_Process has not handled yet
+
+// ISR handling
+void TIMEBASE_TickHandler(void);	// Called every 1 ms by SysTick_Handler
+void SysTick_Handler(void);			// Weak, calls TIMEBASE_TickHandler
+
+#endif /* INC_STM32F407XX_TIMEBASE_H_ */
@@ -0,0 +1,204 @@
+/*
+ * stm32f407xx_usart_driver.h
+ *
+ *  Created on: Jan 15, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef INC_STM32F407XX_USART_DRIVER_H_
+#define INC_STM32F407XX_USART_DRIVER_H_
+
+#include "stm32f407xx.h"
+
+// USART driver (ch. 30) for USART1-3, UART4-5 and USART6.
+//
+// Receive: a circular DMA writes into a ring buffer given to USART_RxStart. The data is handed
+// to the callback in place, no byte is copied by the driver:
+//	- at the DMA half and full transfer interrupts (long frames are handed over in pieces
+//	  before the DMA comes back around)
+//	- at the IDLE line interrupt, with USART_RX_FRAME_END, so a frame is whatever came in
+//	  since the line was last idle
+// A piece that wraps around the end of the ring is handed over in two calls. The data stays
+// valid until the DMA writes over it again, half a ring later at the earliest.
+//
+// Transmit: USART_Submit queues caller owned USART_TxBuffer_t, each one is sent by DMA straight
+// from the caller's buffer.
+//
+// The ring logic (USART_RxRingUpdate) does not touch any register, it only needs the DMA write
+// position, so it can be run on its own.
+
+struct USART_TxBuffer;
+
+// Received data callback, runs in interrupt context. Len can be 0 with USART_RX_FRAME_END when
+// the whole frame was handed over before the line went idle.
+typedef void (*USART_RxCallback_t)(const uint8_t *pData, uint16_t Len, uint8_t Flags, void *pArg);
+
+// Transmit done callback, runs in interrupt context
+typedef void (*USART_TxCallback_t)(struct USART_TxBuffer *pTx, void *pArg);
+
+// Configuration structure for USARTx peripheral
+typedef struct
+{
+	uint8_t USART_Mode;				// Possible values from @USART_MODE
+	uint32_t USART_Baud;			// Bits per second
+	uint8_t USART_NoOfStopBits;		// Possible values from @USART_STOPBITS
+	uint8_t USART_WordLength;		// Possible values from @USART_WORDLEN
+	uint8_t USART_ParityControl;	// Possible values from @USART_PARITY
+	uint8_t USART_HWFlowControl;	// Possible values from @USART_HW_FLOW
+	uint8_t USART_Oversampling;		// Possible values from @USART_OVERSAMPLING
+}USART_Config_t;
+
+// Receive ring, the part of the receiver that does not depend on the hardware
+typedef struct
+{
+	uint8_t *pBuffer;
+	uint16_t Size;					// In bytes
+	uint16_t Tail;					// First byte not handed to the callback yet
+	USART_RxCallback_t pCallback;
+	void *pArg;
+}USART_RxRing_t;
+
+// One buffer of the transmit queue. Owned by the caller and must stay valid until its Status is
+// USART_TX_DONE or USART_TX_ERROR.
+typedef struct USART_TxBuffer
+{
+	struct USART_TxBuffer *pNext;	// Private to the driver
+	const uint8_t *pData;
+	uint16_t Len;
+	__vo uint8_t Status;			// Possible values from @USART_TX_STATUS
+	USART_TxCallback_t pCallback;	// Optional
+	void *pArg;
+}USART_TxBuffer_t;
+
+// Handle structure for USARTx peripheral
+typedef struct
+{
+	USART_RegDef_t *pUSARTx;		// Base address of USART1-3, UART4-5 or USART6
+	USART_Config_t USARTConfig;
+	uint8_t IRQPriority;			// Priority of the USART and DMA interrupts
+
+	// Set by USART_Init
+	DMA_RegDef_t *pDMAx;			// NULL when a DMA stream is used by another driver
+	uint8_t RxStream;
+	uint8_t TxStream;
+	uint8_t DMAChannel;
+
+	// Receiver
+	USART_RxRing_t RxRing;
+	uint32_t RxErrors;				// Overrun, noise, framing and parity errors seen at IDLE
+
+	// Transmit queue
+	USART_TxBuffer_t *pTxHead;		// Buffer being sent
+	USART_TxBuffer_t *pTxTail;
+}USART_Handle_t;
+
+// @USART_MODE
+#define USART_MODE_ONLY_TX			0
+#define USART_MODE_ONLY_RX			1
+#define USART_MODE_TXRX				2
+
+// @USART_STOPBITS
+#define USART_STOPBITS_1			0
+#define USART_STOPBITS_0_5			1
+#define USART_STOPBITS_2			2
+#define USART_STOPBITS_1_5			3
+
+// @USART_WORDLEN
+#define USART_WORDLEN_8BITS			0
+#define USART_WORDLEN_9BITS			1
+
+// @USART_PARITY
+#define USART_PARITY_DISABLE		0
+#define USART_PARITY_EN_EVEN		1
+#define USART_PARITY_EN_ODD			2
+
+// @USART_HW_FLOW
+#define USART_HW_FLOW_CTRL_NONE		0
+#define USART_HW_FLOW_CTRL_CTS		1
+#define USART_HW_FLOW_CTRL_RTS		2
+#define USART_HW_FLOW_CTRL_CTS_RTS	3
+
+// @USART_OVERSAMPLING
+#define USART_OVERSAMPLING_16		0
+#define USART_OVERSAMPLING_8		1	// Up to PCLK / 8 baud, less tolerant to clock deviation
+
+// @USART_RX_FLAGS
+#define USART_RX_FRAME_END			(1U << 0)	// The line went idle after this data
+
+// @USART_TX_STATUS
+#define USART_TX_IDLE				0
+#define USART_TX_QUEUED				1
+#define USART_TX_ACTIVE				2
+#define USART_TX_DONE				3
+#define USART_TX_ERROR				4	// DMA transfer error
+
+// Status codes
+#define USART_OK					0
+#define USART_ERR_PARAM				1
+#define USART_ERR_BUSY				2	// DMA stream used by another driver (USART_Init)
+
+// Bit position definitions of USART peripheral (ch. 30.6)
+#define USART_SR_PE					0
+#define USART_SR_FE					1
+#define USART_SR_NF					2
+#define USART_SR_ORE				3
+#define USART_SR_IDLE				4
+#define USART_SR_RXNE				5
+#define USART_SR_TC					6
+#define USART_SR_TXE				7
+
+#define USART_CR1_RE				2
+#define USART_CR1_TE				3
+#define USART_CR1_IDLEIE			4
+#define USART_CR1_RXNEIE			5
+#define USART_CR1_TCIE				6
+#define USART_CR1_TXEIE				7
+#define USART_CR1_PS				9
+#define USART_CR1_PCE				10
+#define USART_CR1_M					12
+#define USART_CR1_UE				13
+#define USART_CR1_OVER8				15
+
+#define USART_CR2_STOP				12
+
+#define USART_CR3_EIE				0
+#define USART_CR3_DMAR				6
+#define USART_CR3_DMAT				7
+#define USART_CR3_RTSE				8
+#define USART_CR3_CTSE				9
+
+// **********************************************************************
+// *               APIs supported by this driver                        *
+// * For more information about the APIs check the function definitions *
+// **********************************************************************
+
+// Peripheral clock setup
+void USART_PeriClockControl(USART_RegDef_t *pUSARTx, uint8_t EnorDi);
+
+// Init and De-init
+uint8_t USART_Init(USART_Handle_t *pUSARTHandle);
+void USART_DeInit(USART_RegDef_t *pUSARTx);
+void USART_SetBaudRate(USART_RegDef_t *pUSARTx, uint32_t Baud, uint8_t Oversampling);
+
+// Blocking send (startup messages, fault reports)
+void USART_SendData(USART_RegDef_t *pUSARTx, const uint8_t *pTxBuffer, uint32_t Len);
+
+// DMA receive into a ring
+uint8_t USART_RxStart(USART_Handle_t *pUSARTHandle, uint8_t *pBuffer, uint16_t Size, USART_RxCallback_t pCallback, void *pArg);
+void USART_RxStop(USART_Handle_t *pUSARTHandle);
+void USART_RxRingUpdate(USART_RxRing_t *pRing, uint16_t Head, uint8_t Flags);	// Head: DMA write position
+
+// DMA transmit queue
+uint8_t USART_Submit(USART_Handle_t *pUSARTHandle, USART_TxBuffer_t *pTx);
+uint8_t USART_IsTxIdle(USART_Handle_t *pUSARTHandle);
+
+// IRQ configuration and ISR handling
+void USART_IRQHandling(USART_Handle_t *pUSARTHandle);
+void USART1_IRQHandler(void);
+void USART2_IRQHandler(void);
+void USART3_IRQHandler(void);
+void UART4_IRQHandler(void);
+void UART5_IRQHandler(void);
+void USART6_IRQHandler(void);
+
+#endif /* INC_STM32F407XX_USART_DRIVER_H_ */
@@ -0,0 +1,817 @@
+/*
+ * stm32f407xx_adc_driver.c
+ *
+ *  Created on: Mar 12, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <string.h>
+#include "stm32f407xx_adc_driver.h"
+
+#define ADC_DMA					DMA2
+#define ADC_HEADROOM			ADC_FIR_MAX_TAPS	// Samples in front of a channel block for the filter history
+
+// Two int16_t in a word, lo in the bottom half (the lower address in memory)
+#define ADC_PACK(Lo, Hi)		( ((uint32_t)(uint16_t)(Lo)) | ((uint32_t)(uint16_t)(Hi) << 16) )
+
+// DMA2 stream and channel of each ADC (ch. 10.3.3, table 43)
+static const uint8_t DMAStreams[3] = { 4, 2, 0 };
+static const uint8_t DMAChannels[3] = { 0, 1, 2 };
+
+// Sample times of @ADC_SAMPLE_TIME in ADC clock cycles
+static const uint16_t SampleCycles[8] = { 3, 15, 28, 56, 84, 112, 144, 480 };
+
+// Pin of each external channel, port code in the high nibble and pin in the low (datasheet
+// pinout). ADC3 has most of its inputs on port F.
+static const uint8_t PinsADC12[16] =
+{
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,		// PA0 - PA7
+	0x10, 0x11,											// PB0 - PB1
+	0x20, 0x21, 0x22, 0x23, 0x24, 0x25					// PC0 - PC5
+};
+static const uint8_t PinsADC3[16] =
+{
+	0x00, 0x01, 0x02, 0x03,								// PA0 - PA3
+	0x56, 0x57, 0x58, 0x59, 0x5A, 0x53,					// PF6 - PF10, PF3
+	0x20, 0x21, 0x22, 0x23,								// PC0 - PC3
+	0x54, 0x55											// PF4 - PF5
+};
+
+static inline int16_t ADC_Sat16(int32_t Value)
+{
+	return (int16_t)( (Value > 32767) ? 32767 : (Value < -32768) ? -32768 : Value );
+}
+
+// Two neighbouring samples in one load, any half-word alignment
+static inline uint32_t ADC_Load2(const void *pData)
+{
+	uint32_t word;
+
+	memcpy(&word, pData, sizeof(word));
+	return word;
+}
+
+static int8_t ADC_GetIndex(const ADC_RegDef_t *pADCx)
+{
+	if(pADCx == ADC1)
+	{
+		return 0;
+	}
+	if(pADCx == ADC2)
+	{
+		return 1;
+	}
+	if(pADCx == ADC3)
+	{
+		return 2;
+	}
+
+	return -1;
+}
+
+static uint8_t ADC_GetTrigger(const TIM_RegDef_t *pTIMx, uint8_t *pExtSel)
+{
+	if(pTIMx == TIM2)
+	{
+		*pExtSel = ADC_EXTSEL_TIM2_TRGO;
+		return 1;
+	}
+	if(pTIMx == TIM3)
+	{
+		*pExtSel = ADC_EXTSEL_TIM3_TRGO;
+		return 1;
+	}
+	if(pTIMx == TIM8)
+	{
+		*pExtSel = ADC_EXTSEL_TIM8_TRGO;
+		return 1;
+	}
+
+	return 0;
+}
+
+// Checks the filter set by the caller and fills in the fields of the driver
+static uint8_t ADC_InitFilter(ADC_Filter_t *pFilter)
+{
+	switch(pFilter->Type)
+	{
+	case ADC_FILTER_NONE:
+		pFilter->Delay = 0;
+		break;
+
+	case ADC_FILTER_MOVAVG:
+		if(pFilter->Length > ADC_MOVAVG_MAX_SHIFT)
+		{
+			return ADC_ERR_CONFIG;
+		}
+		pFilter->Delay = (uint8_t)(1U << pFilter->Length);
+		break;
+
+	case ADC_FILTER_FIR:
+	{
+		uint8_t taps = pFilter->Length;
+		int16_t reversed[ADC_FIR_MAX_TAPS] = { 0 };
+		uint8_t pad;
+
+		if( (taps == 0) || (taps > ADC_FIR_MAX_TAPS) )
+		{
+			return ADC_ERR_CONFIG;
+		}
+
+		// Oldest sample first, so a pair of taps lines up with a pair of samples in memory
+		pad = taps & 1U;
+		for(uint8_t k = 0; k < taps; k++)
+		{
+			reversed[pad + k] = pFilter->Coeffs[taps - 1 - k];
+		}
+		pFilter->Pairs = (uint8_t)((taps + pad) / 2);
+		for(uint8_t i = 0; i < pFilter->Pairs; i++)
+		{
+			pFilter->Packed[i] = ADC_PACK(reversed[2 * i], reversed[(2 * i) + 1]);
+		}
+		pFilter->Delay = (uint8_t)(taps - 1);
+		break;
+	}
+
+	case ADC_FILTER_BIQUAD:
+		// -a1 is a tap of SMLAD, it has to fit in 16 bits
+		if(pFilter->Coeffs[3] == INT16_MIN)
+		{
+			return ADC_ERR_CONFIG;
+		}
+		pFilter->Delay = 0;
+		break;
+
+	default:
+		return ADC_ERR_CONFIG;
+	}
+
+	return ADC_OK;
+}
+
+// Channel blocks from the interleaved frame, Offset added with saturation
+static void ADC_DeinterleaveScalar(ADC_Handle_t *pHandle, const uint16_t *pFrame)
+{
+	uint32_t channels = pHandle->Config.ChannelCount;
+	uint32_t scans = pHandle->Config.FrameScans;
+
+	for(uint32_t c = 0; c < channels; c++)
+	{
+		int16_t *pOut = &pHandle->Work[c][ADC_HEADROOM];
+		const uint16_t *pIn = &pFrame[c];
+		int32_t offset = pHandle->Config.Offset[c];
+
+		for(uint32_t s = 0; s < scans; s++, pIn += channels)
+		{
+			pOut[s] = ADC_Sat16((int16_t)*pIn + offset);
+		}
+	}
+}
+
+// Two channels per load and QADD16, the last one alone for an odd count
+static void ADC_DeinterleaveSimd(ADC_Handle_t *pHandle, const uint16_t *pFrame)
+{
+	uint32_t channels = pHandle->Config.ChannelCount;
+	uint32_t scans = pHandle->Config.FrameScans;
+	uint32_t c;
+
+	for(c = 0; (c + 1) < channels; c += 2)
+	{
+		int16_t *pOutA = &pHandle->Work[c][ADC_HEADROOM];
+		int16_t *pOutB = &pHandle->Work[c + 1][ADC_HEADROOM];
+		const uint16_t *pIn = &pFrame[c];
+		uint32_t offsets = ADC_PACK(pHandle->Config.Offset[c], pHandle->Config.Offset[c + 1]);
+
+		for(uint32_t s = 0; s < scans; s++, pIn += channels)
+		{
+			uint32_t pair = __QADD16(ADC_Load2(pIn), offsets);
+
+			pOutA[s] = (int16_t)pair;
+			pOutB[s] = (int16_t)(pair >> 16);
+		}
+	}
+
+	if(c < channels)
+	{
+		int16_t *pOut = &pHandle->Work[c][ADC_HEADROOM];
+		const uint16_t *pIn = &pFrame[c];
+		uint32_t offset = ADC_PACK(pHandle->Config.Offset[c], 0);
+
+		for(uint32_t s = 0; s < scans; s++, pIn += channels)
+		{
+			pOut[s] = (int16_t)__QADD16(*pIn, offset);
+		}
+	}
+}
+
+// Moving average, a running sum of the window. y[n] is written over x[n - L], which is
+// not needed after it.
+static void ADC_MovingAverage(ADC_Filter_t *pFilter, int16_t *pData, uint32_t Count)
+{
+	uint32_t window = pFilter->Delay;
+	uint32_t shift = pFilter->Length;
+	int32_t sum = pFilter->Sum;
+
+	for(uint32_t n = 0; n < Count; n++)
+	{
+		sum += pData[n] - pData[(int32_t)n - (int32_t)window];
+		pData[(int32_t)n - (int32_t)window] = (int16_t)(sum >> shift);
+	}
+
+	pFilter->Sum = sum;
+}
+
+// FIR, y[n] = sum of h[k] * x[n - k]. y[n] is written over x[n - T + 1], the oldest sample
+// it uses. The sum is made in a uint32_t, it wraps like SMLAD.
+static void ADC_FIRScalar(const ADC_Filter_t *pFilter, int16_t *pData, uint32_t Count)
+{
+	const int16_t *pTaps = pFilter->Coeffs;
+	int32_t taps = pFilter->Length;
+
+	for(int32_t n = 0; n < (int32_t)Count; n++)
+	{
+		uint32_t acc = 0;
+
+		for(int32_t k = 0; k < taps; k++)
+		{
+			acc += (uint32_t)((int32_t)pTaps[k] * pData[n - k]);
+		}
+		pData[n - (taps - 1)] = ADC_Sat16((int32_t)acc >> 15);
+	}
+}
+
+// The same with two taps per SMLAD. With an odd tap count the first packed tap is 0, its
+// sample is one further back (the output of the sample before, multiplied by 0).
+static void ADC_FIRSimd(const ADC_Filter_t *pFilter, int16_t *pData, uint32_t Count)
+{
+	const uint32_t *pTaps = pFilter->Packed;
+	int32_t pairs = pFilter->Pairs;
+	int32_t delay = pFilter->Delay;
+
+	for(int32_t n = 0; n < (int32_t)Count; n++)
+	{
+		const int16_t *pX = &pData[n + 1 - (2 * pairs)];
+		uint32_t acc = 0;
+		int32_t i = 0;
+
+		for(; (i + 1) < pairs; i += 2)
+		{
+			acc = __SMLAD(ADC_Load2(&pX[2 * i]), pTaps[i], acc);
+			acc = __SMLAD(ADC_Load2(&pX[(2 * i) + 2]), pTaps[i + 1], acc);
+		}
+		if(i < pairs)
+		{
+			acc = __SMLAD(ADC_Load2(&pX[2 * i]), pTaps[i], acc);
+		}
+		pData[n - delay] = ADC_Sat16((int32_t)acc >> 15);
+	}
+}
+
+// Biquad, direct form I in place:
+// y[n] = (b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]) >> 14
+static void ADC_BiquadScalar(ADC_Filter_t *pFilter, int16_t *pData, uint32_t Count)
+{
+	int32_t b0 = pFilter->Coeffs[0];
+	int32_t b1 = pFilter->Coeffs[1];
+	int32_t b2 = pFilter->Coeffs[2];
+	int32_t a1 = pFilter->Coeffs[3];
+	int32_t a2 = pFilter->Coeffs[4];
+	int32_t x1 = pFilter->State[0];
+	int32_t x2 = pFilter->State[1];
+	int32_t y1 = pFilter->State[2];
+	int32_t y2 = pFilter->State[3];
+
+	for(uint32_t n = 0; n < Count; n++)
+	{
+		int32_t x0 = pData[n];
+		uint32_t acc = (uint32_t)(b0 * x0) + (uint32_t)(b1 * x1) + (uint32_t)(b2 * x2) +
+				(uint32_t)(-a1 * y1) - (uint32_t)(a2 * y2);
+		int32_t y0 = ADC_Sat16((int32_t)acc >> 14);
+
+		pData[n] = (int16_t)y0;
+		x2 = x1;
+		x1 = x0;
+		y2 = y1;
+		y1 = y0;
+	}
+
+	pFilter->State[0] = (int16_t)x1;
+	pFilter->State[1] = (int16_t)x2;
+	pFilter->State[2] = (int16_t)y1;
+	pFilter->State[3] = (int16_t)y2;
+}
+
+// Four of the five products with two SMLAD, the samples are packed in registers (PKHBT)
+// because the output overwrites the input
+static void ADC_BiquadSimd(ADC_Filter_t *pFilter, int16_t *pData, uint32_t Count)
+{
+	uint32_t b0b1 = ADC_PACK(pFilter->Coeffs[0], pFilter->Coeffs[1]);
+	uint32_t b2a1 = ADC_PACK(pFilter->Coeffs[2], -pFilter->Coeffs[3]);
+	int32_t a2 = pFilter->Coeffs[4];
+	int32_t x1 = pFilter->State[0];
+	int32_t x2 = pFilter->State[1];
+	int32_t y1 = pFilter->State[2];
+	int32_t y2 = pFilter->State[3];
+
+	for(uint32_t n = 0; n < Count; n++)
+	{
+		int32_t x0 = pData[n];
+		uint32_t acc = (uint32_t)(-(a2 * y2));
+		int32_t y0;
+
+		acc = __SMLAD(ADC_PACK(x0, x1), b0b1, acc);
+		acc = __SMLAD(ADC_PACK(x2, y1), b2a1, acc);
+		y0 = ADC_Sat16((int32_t)acc >> 14);
+
+		pData[n] = (int16_t)y0;
+		x2 = x1;
+		x1 = x0;
+		y2 = y1;
+		y1 = y0;
+	}
+
+	pFilter->State[0] = (int16_t)x1;
+	pFilter->State[1] = (int16_t)x2;
+	pFilter->State[2] = (int16_t)y1;
+	pFilter->State[3] = (int16_t)y2;
+}
+
+// Filters the block of one channel, pData is the first new sample. The history of the
+// previous frame goes in front of it and the end of this one is kept for the next.
+static void ADC_FilterChannel(ADC_Filter_t *pFilter, int16_t *pData, uint32_t Count, uint8_t Path)
+{
+	uint32_t delay = pFilter->Delay;
+
+	memcpy(pData - delay, pFilter->History, delay * sizeof(int16_t));
+	memcpy(pFilter->History, pData - delay + Count, delay * sizeof(int16_t));
+
+	switch(pFilter->Type)
+	{
+	case ADC_FILTER_MOVAVG:
+		ADC_MovingAverage(pFilter, pData, Count);
+		break;
+
+	case ADC_FILTER_FIR:
+		if(Path == ADC_PATH_SIMD)
+		{
+			ADC_FIRSimd(pFilter, pData, Count);
+		}
+		else
+		{
+			ADC_FIRScalar(pFilter, pData, Count);
+		}
+		break;
+
+	case ADC_FILTER_BIQUAD:
+		if(Path == ADC_PATH_SIMD)
+		{
+			ADC_BiquadSimd(pFilter, pData, Count);
+		}
+		else
+		{
+			ADC_BiquadScalar(pFilter, pData, Count);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+// Transfer complete of the DMA stream, runs in the DMA interrupt. The DMA has switched to
+// the other memory, the one it left holds the new frame.
+static void ADC_DMAHandler(void *pArg, uint8_t Flags)
+{
+	ADC_Handle_t *pHandle = (ADC_Handle_t*)pArg;
+	uint32_t frameLength = (uint32_t)pHandle->Config.FrameScans * pHandle->Config.ChannelCount;
+	uint8_t target;
+	uint8_t done;
+
+	if(!(Flags & DMA_FLAG_TC))
+	{
+		return;
+	}
+
+	target = DMA_GetCurrentTarget(ADC_DMA, pHandle->Stream);
+	done = target ^ 1U;
+
+	// Same memory as last time: the DMA switched twice since, a frame was lost
+	if(done == pHandle->LastBuffer)
+	{
+		pHandle->Overruns++;
+	}
+	pHandle->LastBuffer = done;
+
+	ADC_ProcessFrame(pHandle, &pHandle->Config.pBuffer[done * frameLength]);
+
+	// Switched again while processing: the DMA is writing over the frame just processed
+	if(DMA_GetCurrentTarget(ADC_DMA, pHandle->Stream) != target)
+	{
+		pHandle->Overruns++;
+	}
+}
+
+// Clocks of the trigger timer, the ADC, the DMA and the ports of the channel pins: on from
+// ADC_Init to ADC_DeInit
+static void ADC_ClockControl(const ADC_Config_t *pConfig, int8_t Index, uint8_t EnorDi)
+{
+	const uint8_t *pPins = (Index == 2) ? PinsADC3 : PinsADC12;
+	uint16_t ports = 0;
+
+	TIM_PeriClockControl(pConfig->pTIMx, EnorDi);
+	DMA_PeriClockControl(ADC_DMA, EnorDi);
+	if(EnorDi == ENABLE)
+	{
+		RCC_PeriphClockEnable((uint8_t)(RCC_CLK_ADC1 + Index), RCC_CLK_RUN_ONLY);
+	}
+	else
+	{
+		RCC_PeriphClockDisable((uint8_t)(RCC_CLK_ADC1 + Index), RCC_CLK_RUN_ONLY);
+	}
+
+	// One user per port, not per pin
+	for(uint8_t i = 0; i < pConfig->ChannelCount; i++)
+	{
+		if(pConfig->pChannels[i] < 16)
+		{
+			ports |= (uint16_t)(1U << (pPins[pConfig->pChannels[i]] >> 4));
+		}
+	}
+	for(uint8_t port = 0; port < GPIO_PORT_COUNT; port++)
+	{
+		if(ports & (1U << port))
+		{
+			GPIO_PeriClockControl((GPIO_RegDef_t*)(uintptr_t)(AHB1PERIPH_BASEADDR + ((uint32_t)port << 10)), EnorDi);
+		}
+	}
+}
+
+// Timer, ADC and DMA in Sleep mode, while scanning: sampling goes on while the core sleeps
+static void ADC_SleepClockControl(const ADC_Config_t *pConfig, int8_t Index, uint8_t EnorDi)
+{
+	TIM_SleepClockControl(pConfig->pTIMx, EnorDi);
+	DMA_SleepClockControl(ADC_DMA, EnorDi);
+	RCC_PeriphSleepControl((uint8_t)(RCC_CLK_ADC1 + Index), EnorDi);
+}
+
+// *************************************************************
+// * @fn			- ADC_Init				                   *
+// * 						                                   *
+// * @brief			- Sets up the pins, the ADC, the trigger   *
+// * 				  timer, the DMA stream and the filters	   *
+// * 						                                   *
+// * @param[in]		- Handle with the configuration and the	   *
+// * 				  filters of the channels filled in		   *
+// * 						                                   *
+// * @return		- ADC_OK or an error code                  *
+// *														   *
+// * @note			- ADCCLK is PCLK2 / 2, 4, 6 or 8, the	   *
+// * 				  fastest up to 36 MHz, common to all the  *
+// * 				  ADCs. The scan must fit in a period of   *
+// * 				  the timer. Init again (not while		   *
+// * 				  running) takes no more clock references, *
+// * 				  ADC_DeInit gives them back.			   *
+// *************************************************************
+uint8_t ADC_Init(ADC_Handle_t *pHandle)
+{
+	ADC_Config_t *pConfig = &pHandle->Config;
+	ADC_RegDef_t *pADCx = pConfig->pADCx;
+	int8_t index = ADC_GetIndex(pADCx);
+	const uint8_t *pPins = (index == 2) ? PinsADC3 : PinsADC12;
+	uint16_t portPins[GPIO_PORT_COUNT] = { 0 };
+	uint32_t common = 0;
+	uint32_t sqr2 = 0;
+	uint32_t sqr3 = 0;
+	uint32_t smpr1 = 0;
+	uint32_t smpr2 = 0;
+	uint32_t pclk2;
+	uint32_t prescaler;
+	uint32_t conversions;
+	uint8_t extSel, again;
+	DMA_StreamConfig_t dma = { 0 };
+
+	if( (index < 0) || (pConfig->pChannels == NULL) || (pConfig->ChannelCount == 0) ||
+		(pConfig->ChannelCount > ADC_MAX_CHANNELS) || (pConfig->SampleTime > ADC_SMP_480) ||
+		(pConfig->Path > ADC_PATH_SCALAR) || !ADC_GetTrigger(pConfig->pTIMx, &extSel) ||
+		(pConfig->pBuffer == NULL) || (pConfig->FrameScans == 0) || (pConfig->FrameScans > ADC_MAX_FRAME_SCANS) )
+	{
+		return ADC_ERR_CONFIG;
+	}
+
+	for(uint8_t i = 0; i < pConfig->ChannelCount; i++)
+	{
+		uint8_t channel = pConfig->pChannels[i];
+
+		if( (channel > 18) || ((channel > 15) && (index != 0)) ||
+			(ADC_InitFilter(&pHandle->Filter[i]) != ADC_OK) )
+		{
+			return ADC_ERR_CONFIG;
+		}
+
+		if(channel < 16)
+		{
+			portPins[pPins[channel] >> 4] |= GPIO_PIN_MASK(pPins[channel] & 0x0FU);
+		}
+		else if(channel == 18)
+		{
+			common |= ADC_CCR_VBATE;
+		}
+		else
+		{
+			common |= ADC_CCR_TSVREFE;
+		}
+
+		if(i < 6)
+		{
+			sqr3 |= (uint32_t)channel << (5 * i);
+		}
+		else
+		{
+			sqr2 |= (uint32_t)channel << (5 * (i - 6));
+		}
+		if(channel < 10)
+		{
+			smpr2 |= (uint32_t)pConfig->SampleTime << (3 * channel);
+		}
+		else
+		{
+			smpr1 |= (uint32_t)pConfig->SampleTime << (3 * (channel - 10));
+		}
+	}
+
+	pHandle->Stream = DMAStreams[index];
+	pHandle->DMAChannel = DMAChannels[index];
+	// The stream is ours already after an earlier Init, its clocks are on
+	again = (DMA_GetCallback(ADC_DMA, pHandle->Stream) == ADC_DMAHandler);
+	if(DMA_RegisterCallback(ADC_DMA, pHandle->Stream, ADC_DMAHandler, pHandle) != DMA_OK)
+	{
+		return ADC_ERR_CONFIG;
+	}
+	if(!again)
+	{
+		ADC_ClockControl(pConfig, index, ENABLE);
+	}
+
+	// Trigger timer, the scan has to be done before the next update
+	TIM_Stop(pConfig->pTIMx);
+	pHandle->ScanRateHz = TIM_SetUpdateRate(pConfig->pTIMx, pConfig->TimerClockHz, pConfig->ScanRateHz);
+	pclk2 = RCC_GetPCLK2Freq();
+	prescaler = 2;
+	while( (prescaler < 8) && ((pclk2 / prescaler) > ADC_CLOCK_MAX_HZ) )
+	{
+		prescaler += 2;
+	}
+	conversions = pHandle->ScanRateHz * pConfig->ChannelCount;
+	if( (pHandle->ScanRateHz == 0) ||
+		((uint64_t)conversions * (SampleCycles[pConfig->SampleTime] + 12U) > (pclk2 / prescaler)) )
+	{
+		(void)DMA_RegisterCallback(ADC_DMA, pHandle->Stream, NULL, NULL);
+		ADC_ClockControl(pConfig, index, DISABLE);
+		return ADC_ERR_RATE;
+	}
+	TIM_SetMasterMode(pConfig->pTIMx, TIM_MMS_UPDATE);
+
+	// Channel pins in analog mode
+	for(uint8_t port = 0; port < GPIO_PORT_COUNT; port++)
+	{
+		if(portPins[port] != 0)
+		{
+			GPIO_RegDef_t *pGPIOx = (GPIO_RegDef_t*)(uintptr_t)(AHB1PERIPH_BASEADDR + ((uint32_t)port << 10));
+
+			GPIO_SetPinModes(pGPIOx, portPins[port], GPIO_MODE_ANALOG);
+		}
+	}
+
+	// ADC off while it is set up, 12 bit right aligned, one scan per trigger
+	REG_MODIFY(ADC_COMMON->CCR, 3U << ADC_CCR_ADCPRE_POS, (((prescaler / 2) - 1) << ADC_CCR_ADCPRE_POS) | common);
+	REG_WRITE(pADCx->CR2, 0);
+	REG_WRITE(pADCx->CR1, ADC_CR1_SCAN);
+	REG_WRITE(pADCx->SMPR1, smpr1);
+	REG_WRITE(pADCx->SMPR2, smpr2);
+	REG_WRITE(pADCx->SQR1, (uint32_t)(pConfig->ChannelCount - 1) << 20);
+	REG_WRITE(pADCx->SQR2, sqr2);
+	REG_WRITE(pADCx->SQR3, sqr3);
+	REG_WRITE(pADCx->CR2, ADC_CR2_EXTEN_RISING | ((uint32_t)extSel << ADC_CR2_EXTSEL_POS) | ADC_CR2_DDS);
+
+	// DMA into the two frame buffers
+	dma.Channel = pHandle->DMAChannel;
+	dma.Direction = DMA_DIR_P2M;
+	dma.PeriphSize = DMA_SIZE_HALFWORD;
+	dma.MemSize = DMA_SIZE_HALFWORD;
+	dma.PeriphInc = DISABLE;
+	dma.MemInc = ENABLE;
+	dma.DoubleBuffer = ENABLE;
+	dma.Priority = DMA_PRIORITY_HIGH;
+	dma.Interrupts = DMA_FLAG_TC;
+
+	DMA_StreamInit(ADC_DMA, pHandle->Stream, &dma);
+	GPIO_IRQConfig(DMA_GetIRQNumber(ADC_DMA, pHandle->Stream), pConfig->IRQPriority, ENABLE);
+
+	for(uint8_t i = 0; i < pConfig->ChannelCount; i++)
+	{
+		pHandle->pOut[i] = &pHandle->Work[i][ADC_HEADROOM - pHandle->Filter[i].Delay];
+	}
+	ADC_ResetFilters(pHandle);
+	ADC_ResetStats(pHandle);
+	pHandle->Running = 0;
+
+	return ADC_OK;
+}
+
+// *************************************************************
+// * @fn			- ADC_DeInit			                   *
+// * 						                                   *
+// * @brief			- Stops the scans and gives back the DMA   *
+// * 				  stream and the clocks of ADC_Init		   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- The pins stay in analog mode. Does	   *
+// * 				  nothing if the stream is not used by an  *
+// * 				  ADC.									   *
+// *************************************************************
+void ADC_DeInit(ADC_Handle_t *pHandle)
+{
+	if(DMA_GetCallback(ADC_DMA, pHandle->Stream) != ADC_DMAHandler)
+	{
+		return;
+	}
+
+	ADC_Stop(pHandle);
+	GPIO_IRQConfig(DMA_GetIRQNumber(ADC_DMA, pHandle->Stream), 0, DISABLE);
+	(void)DMA_RegisterCallback(ADC_DMA, pHandle->Stream, NULL, NULL);
+	ADC_ClockControl(&pHandle->Config, ADC_GetIndex(pHandle->Config.pADCx), DISABLE);
+}
+
+// *************************************************************
+// * @fn			- ADC_Start				                   *
+// * 						                                   *
+// * @brief			- Starts the timer, the scans and the DMA  *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- The filters go on from their state		   *
+// * 				  before the start (ADC_ResetFilters)	   *
+// *************************************************************
+void ADC_Start(ADC_Handle_t *pHandle)
+{
+	ADC_Config_t *pConfig = &pHandle->Config;
+	uint32_t frameLength = (uint32_t)pConfig->FrameScans * pConfig->ChannelCount;
+
+	if(!pHandle->Running)
+	{
+		ADC_SleepClockControl(pConfig, ADC_GetIndex(pConfig->pADCx), ENABLE);
+	}
+
+	pHandle->LastBuffer = 1;
+	DMA_StreamSetAddress(ADC_DMA, pHandle->Stream, &pConfig->pADCx->DR, pConfig->pBuffer,
+			&pConfig->pBuffer[frameLength], (uint16_t)frameLength);
+	DMA_ClearFlags(ADC_DMA, pHandle->Stream, DMA_FLAG_ALL);
+	// Memory 0 first, as LastBuffer says (CT keeps the memory the stream stopped in), and the
+	// transfer complete interrupt ADC_Stop masked
+	REG_MODIFY(ADC_DMA->S[pHandle->Stream].CR, DMA_SxCR_CT, DMA_SxCR_TCIE);
+	GPIO_IRQConfig(DMA_GetIRQNumber(ADC_DMA, pHandle->Stream), pConfig->IRQPriority, ENABLE);
+	DMA_StreamEnable(ADC_DMA, pHandle->Stream);
+
+	// The DMA bit is set again after an overrun, so the requests start over
+	REG_WRITE(pConfig->pADCx->SR, 0);
+	REG_SET_BITS(pConfig->pADCx->CR2, ADC_CR2_DMA | ADC_CR2_ADON);
+
+	// The ADC needs 3 us after ADON (tSTAB), the first trigger is a whole period later
+	REG_WRITE(pConfig->pTIMx->CNT, 0);
+	TIM_Start(pConfig->pTIMx);
+
+	pHandle->Running = 1;
+}
+
+// *************************************************************
+// * @fn			- ADC_Stop				                   *
+// * 						                                   *
+// * @brief			- Stops the timer, the ADC and the DMA	   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- The frame the DMA was filling is dropped *
+// *************************************************************
+void ADC_Stop(ADC_Handle_t *pHandle)
+{
+	ADC_Config_t *pConfig = &pHandle->Config;
+
+	if(!pHandle->Running)
+	{
+		return;
+	}
+	pHandle->Running = 0;
+
+	// The interrupt is masked before the stream stops: disabling a running stream sets TCIF,
+	// and the handler would process the last frame again and count an overrun
+	GPIO_IRQConfig(DMA_GetIRQNumber(ADC_DMA, pHandle->Stream), 0, DISABLE);
+	REG_CLR_BITS(ADC_DMA->S[pHandle->Stream].CR, DMA_SxCR_TCIE);
+
+	TIM_Stop(pConfig->pTIMx);
+	REG_CLR_BITS(pConfig->pADCx->CR2, ADC_CR2_DMA | ADC_CR2_ADON);
+	DMA_StreamDisable(ADC_DMA, pHandle->Stream);
+	DMA_ClearFlags(ADC_DMA, pHandle->Stream, DMA_FLAG_ALL);
+	ADC_SleepClockControl(pConfig, ADC_GetIndex(pConfig->pADCx), DISABLE);
+}
+
+void ADC_ResetFilters(ADC_Handle_t *pHandle)
+{
+	for(uint8_t i = 0; i < ADC_MAX_CHANNELS; i++)
+	{
+		ADC_Filter_t *pFilter = &pHandle->Filter[i];
+
+		memset(pFilter->History, 0, sizeof(pFilter->History));
+		memset(pFilter->State, 0, sizeof(pFilter->State));
+		pFilter->Sum = 0;
+	}
+}
+
+// *************************************************************
+// * @fn			- ADC_ProcessFrame		                   *
+// * 						                                   *
+// * @brief			- De-interleaves and filters a frame and   *
+// * 				  passes it to the callback				   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * @param[in]		- FrameScans x ChannelCount samples, in	   *
+// * 				  scan order							   *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Called by the DMA interrupt. The filtered *
+// * 				  samples are valid until the next call	   *
+// * 				  (pHandle->pOut)						   *
+// *************************************************************
+void ADC_ProcessFrame(ADC_Handle_t *pHandle, const uint16_t *pFrame)
+{
+	ADC_Config_t *pConfig = &pHandle->Config;
+	uint32_t start = PROFILER_Now();
+
+	if(pConfig->Path == ADC_PATH_SIMD)
+	{
+		ADC_DeinterleaveSimd(pHandle, pFrame);
+	}
+	else
+	{
+		ADC_DeinterleaveScalar(pHandle, pFrame);
+	}
+
+	for(uint8_t i = 0; i < pConfig->ChannelCount; i++)
+	{
+		ADC_FilterChannel(&pHandle->Filter[i], &pHandle->Work[i][ADC_HEADROOM], pConfig->FrameScans, pConfig->Path);
+	}
+
+	pHandle->ProcessCycles += PROFILER_Now() - start;
+	pHandle->ProcessedSamples += (uint32_t)pConfig->FrameScans * pConfig->ChannelCount;
+	pHandle->Frames++;
+
+	if(pConfig->pCallback != NULL)
+	{
+		pConfig->pCallback(pConfig->pArg, pHandle->pOut, pConfig->FrameScans);
+	}
+}
+
+uint32_t ADC_GetSampleRate(const ADC_Handle_t *pHandle)
+{
+	return pHandle->ScanRateHz;
+}
+
+// *************************************************************
+// * @fn			- ADC_GetCyclesPerKSample                  *
+// * 						                                   *
+// * @brief			- Processing time of the frames since the  *
+// * 				  last reset							   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- DWT cycles per 1000 samples, 0 before a  *
+// * 				  frame									   *
+// *														   *
+// * @note			- One sample is one channel of one scan.   *
+// * 				  The CPU load is this x ChannelCount x	   *
+// * 				  ScanRateHz / 1000 / core clock.		   *
+// *************************************************************
+uint32_t ADC_GetCyclesPerKSample(const ADC_Handle_t *pHandle)
+{
+	if(pHandle->ProcessedSamples == 0)
+	{
+		return 0;
+	}
+
+	return (uint32_t)((pHandle->ProcessCycles * 1000U) / pHandle->ProcessedSamples);
+}
+
+void ADC_ResetStats(ADC_Handle_t *pHandle)
+{
+	pHandle->Frames = 0;
+	pHandle->Overruns = 0;
+	pHandle->ProcessedSamples = 0;
+	pHandle->ProcessCycles = 0;
+}
@@ -0,0 +1,400 @@
+/*
+ * stm32f407xx_capture.c
+ *
+ *  Created on: Dec 4, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_capture.h"
+
+#define CAPTURE_DMA				DMA2
+
+// Half transfer / transfer complete of the DMA stream, runs in the DMA interrupt
+static void CAPTURE_DMAHandler(void *pArg, uint8_t Flags)
+{
+	CAPTURE_Handle_t *pHandle = (CAPTURE_Handle_t*)pArg;
+
+	// Both are set if the interrupt was late, then both halves are full
+	if(Flags & DMA_FLAG_HT)	{ pHandle->FilledHalves++; }
+	if(Flags & DMA_FLAG_TC)	{ pHandle->FilledHalves++; }
+}
+
+// Puts a run in the record ring, split in records of at most CAPTURE_RUN_MAX samples
+static void CAPTURE_Emit(CAPTURE_Handle_t *pHandle, uint16_t Value, uint32_t Run)
+{
+	while(Run != 0)
+	{
+		uint16_t n = (Run > CAPTURE_RUN_MAX) ? CAPTURE_RUN_MAX : (uint16_t)Run;
+
+		if(pHandle->Head - pHandle->Tail >= pHandle->Config.RecordCount)
+		{
+			pHandle->RecordsDropped++;
+		}
+		else
+		{
+			CAPTURE_Record_t *pRecord = &pHandle->Config.pRecords[pHandle->Head % pHandle->Config.RecordCount];
+
+			pRecord->Value = Value;
+			pRecord->Run = n;
+			pHandle->Head++;
+		}
+		Run -= n;
+	}
+}
+
+// Clocks of the timer, the DMA and the port: on from CAPTURE_Init to CAPTURE_DeInit
+static void CAPTURE_ClockControl(const CAPTURE_Config_t *pConfig, uint8_t EnorDi)
+{
+	TIM_PeriClockControl(pConfig->pTIMx, EnorDi);
+	DMA_PeriClockControl(CAPTURE_DMA, EnorDi);
+	GPIO_PeriClockControl(pConfig->pGPIOx, EnorDi);
+}
+
+// The same clocks in Sleep mode, while sampling: IDR is sampled while the core sleeps
+static void CAPTURE_SleepClockControl(const CAPTURE_Config_t *pConfig, uint8_t EnorDi)
+{
+	TIM_SleepClockControl(pConfig->pTIMx, EnorDi);
+	DMA_SleepClockControl(CAPTURE_DMA, EnorDi);
+	RCC_PeriphSleepControl(RCC_CLK_GPIO(pConfig->pGPIOx), EnorDi);
+}
+
+// *************************************************************
+// * @fn			- CAPTURE_Init			                   *
+// * 						                                   *
+// * @brief			- Sets up the timer and the DMA stream of  *
+// * 				  a capture								   *
+// * 						                                   *
+// * @param[in]		- Handle with the configuration filled in  *
+// * 						                                   *
+// * @return		- CAPTURE_OK or an error code              *
+// *														   *
+// * @note			- The sampled pins must be configured as   *
+// * 				  inputs by the caller (GPIO_InitPort).	   *
+// * 				  Init again (not while running) takes no  *
+// * 				  more clock references, CAPTURE_DeInit	   *
+// * 				  gives them back.						   *
+// *************************************************************
+uint8_t CAPTURE_Init(CAPTURE_Handle_t *pHandle)
+{
+	CAPTURE_Config_t *pConfig = &pHandle->Config;
+	DMA_StreamConfig_t dma = { 0 };
+	uint8_t irq, again;
+
+	if( !TIM_GetUpdateDMARequest(pConfig->pTIMx, &pHandle->Stream, &pHandle->Channel) ||
+		(pConfig->pSamples == NULL) || (pConfig->HalfLength == 0) || (pConfig->HalfLength > 0x7FFFU) ||
+		(pConfig->pRecords == NULL) || (pConfig->RecordCount == 0) )
+	{
+		return CAPTURE_ERR_CONFIG;
+	}
+	// The stream is ours already after an earlier Init, its clocks are on
+	again = (DMA_GetCallback(CAPTURE_DMA, pHandle->Stream) == CAPTURE_DMAHandler);
+	if(DMA_RegisterCallback(CAPTURE_DMA, pHandle->Stream, CAPTURE_DMAHandler, pHandle) != DMA_OK)
+	{
+		return CAPTURE_ERR_CONFIG;
+	}
+	if(!again)
+	{
+		CAPTURE_ClockControl(pConfig, ENABLE);
+	}
+
+	TIM_Stop(pConfig->pTIMx);
+	if(TIM_SetUpdateRate(pConfig->pTIMx, pConfig->TimerClockHz, pConfig->SampleRateHz) == 0)
+	{
+		(void)DMA_RegisterCallback(CAPTURE_DMA, pHandle->Stream, NULL, NULL);
+		CAPTURE_ClockControl(pConfig, DISABLE);
+		return CAPTURE_ERR_RATE;
+	}
+
+	dma.Channel = pHandle->Channel;
+	dma.Direction = DMA_DIR_P2M;
+	dma.PeriphSize = DMA_SIZE_HALFWORD;		// IDR bits 0 - 15
+	dma.MemSize = DMA_SIZE_HALFWORD;
+	dma.PeriphInc = DISABLE;
+	dma.MemInc = ENABLE;
+	dma.Circular = ENABLE;
+	dma.Priority = DMA_PRIORITY_VERY_HIGH;
+	dma.Interrupts = DMA_FLAG_HT | DMA_FLAG_TC;
+
+	DMA_StreamInit(CAPTURE_DMA, pHandle->Stream, &dma);
+
+	irq = DMA_GetIRQNumber(CAPTURE_DMA, pHandle->Stream);
+	GPIO_IRQConfig(irq, pConfig->IRQPriority, ENABLE);		// Plain NVIC setup, not GPIO specific
+
+	pHandle->Running = 0;
+	CAPTURE_Reset(pHandle);
+
+	return CAPTURE_OK;
+}
+
+// *************************************************************
+// * @fn			- CAPTURE_DeInit		                   *
+// * 						                                   *
+// * @brief			- Stops sampling and gives back the DMA	   *
+// * 				  stream and the clocks of CAPTURE_Init	   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Does nothing if the stream is not used   *
+// * 				  by a capture							   *
+// *************************************************************
+void CAPTURE_DeInit(CAPTURE_Handle_t *pHandle)
+{
+	if(DMA_GetCallback(CAPTURE_DMA, pHandle->Stream) != CAPTURE_DMAHandler)
+	{
+		return;
+	}
+
+	CAPTURE_Stop(pHandle);
+	(void)DMA_RegisterCallback(CAPTURE_DMA, pHandle->Stream, NULL, NULL);
+	CAPTURE_ClockControl(&pHandle->Config, DISABLE);
+}
+
+// *************************************************************
+// * @fn			- CAPTURE_Start			                   *
+// * 						                                   *
+// * @brief			- Starts sampling, the records of the last *
+// * 				  capture are cleared					   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- None									   *
+// *************************************************************
+void CAPTURE_Start(CAPTURE_Handle_t *pHandle)
+{
+	CAPTURE_Config_t *pConfig = &pHandle->Config;
+
+	if(pHandle->Running)
+	{
+		CAPTURE_Stop(pHandle);
+	}
+	CAPTURE_SleepClockControl(pConfig, ENABLE);
+
+	CAPTURE_Reset(pHandle);
+	pHandle->FilledHalves = 0;
+	pHandle->ProcessedHalves = 0;
+
+	DMA_StreamSetAddress(CAPTURE_DMA, pHandle->Stream, &pConfig->pGPIOx->IDR, pConfig->pSamples, NULL,
+			(uint16_t)(2 * pConfig->HalfLength));
+	DMA_ClearFlags(CAPTURE_DMA, pHandle->Stream, DMA_FLAG_ALL);
+	REG_SET_BITS(CAPTURE_DMA->S[pHandle->Stream].CR, DMA_SxCR_HTIE | DMA_SxCR_TCIE);	// Masked by CAPTURE_Stop
+	GPIO_IRQConfig(DMA_GetIRQNumber(CAPTURE_DMA, pHandle->Stream), pConfig->IRQPriority, ENABLE);
+	DMA_StreamEnable(CAPTURE_DMA, pHandle->Stream);
+
+	REG_WRITE(pConfig->pTIMx->CNT, 0);
+	TIM_UpdateDMAControl(pConfig->pTIMx, ENABLE);
+	TIM_Start(pConfig->pTIMx);
+	pHandle->Running = 1;
+}
+
+// *************************************************************
+// * @fn			- CAPTURE_Stop			                   *
+// * 						                                   *
+// * @brief			- Stops sampling and compresses what is	   *
+// * 				  left									   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- The open run is written as a record, so  *
+// * 				  all samples can be read after the stop.  *
+// * 				  The DMA interrupt of the stream is left  *
+// * 				  masked until the next CAPTURE_Start.	   *
+// *************************************************************
+void CAPTURE_Stop(CAPTURE_Handle_t *pHandle)
+{
+	CAPTURE_Config_t *pConfig = &pHandle->Config;
+	uint32_t written, half;
+
+	if(!pHandle->Running)
+	{
+		return;
+	}
+
+	// The interrupt is masked before the stream stops: disabling a running stream sets TCIF,
+	// which would count the half that is being written as full
+	GPIO_IRQConfig(DMA_GetIRQNumber(CAPTURE_DMA, pHandle->Stream), 0, DISABLE);
+	REG_CLR_BITS(CAPTURE_DMA->S[pHandle->Stream].CR, DMA_SxCR_HTIE | DMA_SxCR_TCIE);
+
+	TIM_Stop(pConfig->pTIMx);
+	TIM_UpdateDMAControl(pConfig->pTIMx, DISABLE);
+	DMA_StreamDisable(CAPTURE_DMA, pHandle->Stream);
+	DMA_ClearFlags(CAPTURE_DMA, pHandle->Stream, DMA_FLAG_ALL);
+	CAPTURE_SleepClockControl(pConfig, DISABLE);
+	pHandle->Running = 0;
+
+	// Where the DMA stopped comes from NDTR alone. If it is in the other half than the
+	// interrupt has counted up to, the last half was filled but its interrupt did not run.
+	written = (2U * pConfig->HalfLength) - DMA_GetRemaining(CAPTURE_DMA, pHandle->Stream);
+	if(written >= 2U * pConfig->HalfLength)
+	{
+		written = 0;				// NDTR reloaded at the end of the buffer
+	}
+	half = written / pConfig->HalfLength;
+	if(half != (pHandle->FilledHalves % 2))
+	{
+		pHandle->FilledHalves++;
+	}
+
+	// Full halves first, then the part of the half the DMA was writing
+	CAPTURE_Process(pHandle);
+	if(written > half * pConfig->HalfLength)
+	{
+		CAPTURE_Compress(pHandle, &pConfig->pSamples[half * pConfig->HalfLength], written - (half * pConfig->HalfLength));
+	}
+
+	CAPTURE_Flush(pHandle);
+}
+
+// *************************************************************
+// * @fn			- CAPTURE_Process		                   *
+// * 						                                   *
+// * @brief			- Compresses the halves of the sample	   *
+// * 				  buffer that the DMA has filled		   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Call from the main loop at least once	   *
+// * 				  per half buffer time (HalfLength /	   *
+// * 				  SampleRateHz)							   *
+// *************************************************************
+void CAPTURE_Process(CAPTURE_Handle_t *pHandle)
+{
+	uint32_t filled = pHandle->FilledHalves;
+
+	// With two or more halves behind, the DMA is already writing the oldest one again
+	if(filled - pHandle->ProcessedHalves >= 2)
+	{
+		pHandle->Overruns += filled - pHandle->ProcessedHalves - 1;
+		pHandle->ProcessedHalves = filled - 1;
+	}
+
+	while(pHandle->ProcessedHalves != filled)
+	{
+		uint32_t half = pHandle->ProcessedHalves % 2;
+
+		CAPTURE_Compress(pHandle, &pHandle->Config.pSamples[half * pHandle->Config.HalfLength],
+				pHandle->Config.HalfLength);
+		pHandle->ProcessedHalves++;
+	}
+}
+
+// *************************************************************
+// * @fn			- CAPTURE_ReadRecords	                   *
+// * 						                                   *
+// * @brief			- Takes records out of the record ring	   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * @param[out]	- Records, oldest first					   *
+// * @param[in]		- Size of pOut in records                  *
+// * 						                                   *
+// * @return		- Number of records copied                 *
+// *														   *
+// * @note			- Call while the capture runs to stream	   *
+// * 				  the records out (UART, USB ...)		   *
+// *************************************************************
+uint32_t CAPTURE_ReadRecords(CAPTURE_Handle_t *pHandle, CAPTURE_Record_t *pOut, uint32_t MaxRecords)
+{
+	uint32_t n = 0;
+
+	while( (n < MaxRecords) && (pHandle->Tail != pHandle->Head) )
+	{
+		pOut[n++] = pHandle->Config.pRecords[pHandle->Tail % pHandle->Config.RecordCount];
+		pHandle->Tail++;
+	}
+
+	return n;
+}
+
+void CAPTURE_Reset(CAPTURE_Handle_t *pHandle)
+{
+	pHandle->Triggered = 0;
+	pHandle->RunValue = 0;
+	pHandle->RunLength = 0;
+	pHandle->SampleCount = 0;
+	pHandle->TriggerSample = 0;
+	pHandle->Head = 0;
+	pHandle->Tail = 0;
+	pHandle->Overruns = 0;
+	pHandle->RecordsDropped = 0;
+}
+
+// *************************************************************
+// * @fn			- CAPTURE_Compress		                   *
+// * 						                                   *
+// * @brief			- Runs the trigger and the run-length	   *
+// * 				  compression on a block of samples		   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * @param[in]		- Samples								   *
+// * @param[in]		- Number of samples                        *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- A run goes on over the end of the block, *
+// * 				  it is only written when the level		   *
+// * 				  changes or by CAPTURE_Flush			   *
+// *************************************************************
+void CAPTURE_Compress(CAPTURE_Handle_t *pHandle, const uint16_t *pSamples, uint32_t Count)
+{
+	const uint16_t *p = pSamples;
+	const uint16_t *pEnd = pSamples + Count;
+	uint16_t value = pHandle->RunValue;
+	uint32_t run = pHandle->RunLength;
+
+	if(!pHandle->Triggered)
+	{
+		uint16_t mask = pHandle->Config.TriggerMask;
+		uint16_t pattern = pHandle->Config.TriggerPattern & mask;
+
+		while( (p < pEnd) && ((*p & mask) != pattern) )
+		{
+			p++;
+		}
+		pHandle->SampleCount += (uint32_t)(p - pSamples);
+		if(p == pEnd)
+		{
+			return;
+		}
+
+		pHandle->Triggered = 1;
+		pHandle->TriggerSample = pHandle->SampleCount;
+		value = *p;
+		run = 0;
+	}
+
+	pHandle->SampleCount += (uint32_t)(pEnd - p);
+
+	while(p < pEnd)
+	{
+		const uint16_t *pRunStart = p;
+
+		while( (p < pEnd) && (*p == value) )
+		{
+			p++;
+		}
+		run += (uint32_t)(p - pRunStart);
+
+		if(p != pEnd)
+		{
+			CAPTURE_Emit(pHandle, value, run);
+			value = *p;
+			run = 0;
+		}
+	}
+
+	pHandle->RunValue = value;
+	pHandle->RunLength = run;
+}
+
+void CAPTURE_Flush(CAPTURE_Handle_t *pHandle)
+{
+	CAPTURE_Emit(pHandle, pHandle->RunValue, pHandle->RunLength);
+	pHandle->RunLength = 0;
+}
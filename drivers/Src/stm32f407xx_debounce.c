@@ -0,0 +1,109 @@
+/*
+ * stm32f407xx_debounce.c
+ *
+ *  Created on: Dec 11, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_debounce.h"
+
+// *************************************************************
+// * @fn			- DEBOUNCE_Init			                   *
+// * 						                                   *
+// * @brief			- Starts the debounce of a port with the   *
+// * 				  current pin levels as debounced state	   *
+// * 						                                   *
+// * @param[in]		- Handle with the configuration filled in  *
+// * 						                                   *
+// * @return		- DEBOUNCE_OK or DEBOUNCE_ERR_CONFIG	   *
+// *														   *
+// * @note			- No pressed/released events are reported  *
+// * 				  for the levels found at init			   *
+// *************************************************************
+uint8_t DEBOUNCE_Init(DEBOUNCE_Handle_t *pHandle)
+{
+	uint8_t stable = pHandle->Config.StableCount;
+
+	if( (stable == 0) || (stable > DEBOUNCE_STABLE_MAX) )
+	{
+		return DEBOUNCE_ERR_CONFIG;
+	}
+
+	// Only the counter bits up to the highest bit of StableCount are used
+	pHandle->Bits = (uint8_t)(32 - __CLZ(stable));
+	for(uint8_t i = 0; i < DEBOUNCE_COUNTER_BITS; i++)
+	{
+		pHandle->Count[i] = 0;
+	}
+
+	pHandle->State = (GPIO_ReadFromInputPort(pHandle->Config.pGPIOx) ^ pHandle->Config.ActiveLow) & pHandle->Config.PinMask;
+	pHandle->Pressed = 0;
+	pHandle->Released = 0;
+	pHandle->Changed = 0;
+
+	return DEBOUNCE_OK;
+}
+
+// *************************************************************
+// * @fn			- DEBOUNCE_Tick			                   *
+// * 						                                   *
+// * @brief			- Reads the port once and debounces it	   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- Pins that changed state in this tick     *
+// *														   *
+// * @note			- One IDR read per tick for all pins	   *
+// *************************************************************
+uint16_t DEBOUNCE_Tick(DEBOUNCE_Handle_t *pHandle)
+{
+	return DEBOUNCE_Update(pHandle, GPIO_ReadFromInputPort(pHandle->Config.pGPIOx));
+}
+
+// *************************************************************
+// * @fn			- DEBOUNCE_Update		                   *
+// * 						                                   *
+// * @brief			- Debounces one sample of a port		   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * @param[in]		- Port levels (IDR)                        *
+// * 						                                   *
+// * @return		- Pins that changed state in this tick     *
+// *														   *
+// * @note			- Pressed, Released and Changed of the	   *
+// * 				  handle are set for this tick			   *
+// *************************************************************
+uint16_t DEBOUNCE_Update(DEBOUNCE_Handle_t *pHandle, uint16_t Sample)
+{
+	uint16_t sample = (Sample ^ pHandle->Config.ActiveLow) & pHandle->Config.PinMask;
+	uint16_t delta = sample ^ pHandle->State;		// Pins that differ from their debounced state
+	uint16_t carry = delta;
+	uint16_t match = delta;
+	uint8_t stable = pHandle->Config.StableCount;
+
+	for(uint8_t i = 0; i < pHandle->Bits; i++)
+	{
+		// Counter to 0 where the pin equals its state, + 1 where it differs (ripple carry)
+		uint16_t count = pHandle->Count[i] & delta;
+		uint16_t next = count ^ carry;
+
+		carry &= count;
+		pHandle->Count[i] = next;
+
+		// Pins whose counter has reached StableCount
+		match &= (stable & (1U << i)) ? next : (uint16_t)~next;
+	}
+
+	// New state taken, the counters of those pins start again from 0
+	for(uint8_t i = 0; i < pHandle->Bits; i++)
+	{
+		pHandle->Count[i] &= ~match;
+	}
+	pHandle->State ^= match;
+
+	pHandle->Pressed = match & pHandle->State;
+	pHandle->Released = match & ~pHandle->State;
+	pHandle->Changed = match;
+
+	return match;
+}
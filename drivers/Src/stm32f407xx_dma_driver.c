@@ -0,0 +1,293 @@
+/*
+ * stm32f407xx_dma_driver.c
+ *
+ *  Created on: Nov 27, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_dma_driver.h"
+
+// Bit position of the flags of each stream inside LISR/LIFCR (streams 0-3) and HISR/HIFCR (4-7)
+static const uint8_t FlagShift[4] = { 0, 6, 16, 22 };
+
+// Callback of each stream, index [DMA1/DMA2][stream]
+static DMA_Callback_t Callbacks[2][8];
+static void *CallbackArgs[2][8];
+
+#define DMA_INDEX(pDMAx)		( ((pDMAx) == DMA1) ? 0 : 1 )
+
+#define DMA_CLK_ID(pDMAx)		( ((pDMAx) == DMA1) ? RCC_CLK_DMA1 : RCC_CLK_DMA2 )
+
+// *************************************************************
+// * @fn			- DMA_PeriClockControl	                   *
+// * 						                                   *
+// * @brief			- Enables or disables the clock of a DMA   *
+// * 				  controller							   *
+// * 						                                   *
+// * @param[in]		- DMA1 or DMA2							   *
+// * @param[in]		- ENABLE or DISABLE macros	               *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Counted per user. Gated in Sleep mode,   *
+// * 				  see DMA_SleepClockControl.			   *
+// *************************************************************
+void DMA_PeriClockControl(DMA_RegDef_t *pDMAx, uint8_t EnorDi)
+{
+	if(EnorDi == ENABLE)
+	{
+		RCC_PeriphClockEnable(DMA_CLK_ID(pDMAx), RCC_CLK_RUN_ONLY);
+	}
+	else
+	{
+		RCC_PeriphClockDisable(DMA_CLK_ID(pDMAx), RCC_CLK_RUN_ONLY);
+	}
+}
+
+// *************************************************************
+// * @fn			- DMA_SleepClockControl	                   *
+// * 						                                   *
+// * @brief			- Keeps the clock of a DMA controller on   *
+// * 				  in Sleep mode, or gives that up		   *
+// * 						                                   *
+// * @param[in]		- DMA1 or DMA2							   *
+// * @param[in]		- ENABLE or DISABLE macros	               *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Counted per user: ENABLE when a stream   *
+// * 				  is started, DISABLE when it is stopped.  *
+// * 				  May be called from interrupts.		   *
+// *************************************************************
+void DMA_SleepClockControl(DMA_RegDef_t *pDMAx, uint8_t EnorDi)
+{
+	RCC_PeriphSleepControl(DMA_CLK_ID(pDMAx), EnorDi);
+}
+
+// *************************************************************
+// * @fn			- DMA_StreamInit		                   *
+// * 						                                   *
+// * @brief			- Configures a stream, the stream is left  *
+// * 				  disabled								   *
+// * 						                                   *
+// * @param[in]		- DMA1 or DMA2							   *
+// * @param[in]		- Stream 0 - 7			               *
+// * @param[in]		- Stream configuration	               *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- The stream is stopped first, because CR  *
+// * 				  can only be changed while EN = 0. Direct *
+// * 				  mode (no FIFO) is used.				   *
+// *************************************************************
+void DMA_StreamInit(DMA_RegDef_t *pDMAx, uint8_t Stream, const DMA_StreamConfig_t *pConfig)
+{
+	uint32_t cr = 0;
+
+	DMA_StreamDisable(pDMAx, Stream);
+	DMA_ClearFlags(pDMAx, Stream, DMA_FLAG_ALL);
+
+	cr |= ( (uint32_t)(pConfig->Channel & 0x7) << DMA_SxCR_CHSEL_POS );
+	cr |= ( (uint32_t)(pConfig->Direction & 0x3) << DMA_SxCR_DIR_POS );
+	cr |= ( (uint32_t)(pConfig->PeriphSize & 0x3) << DMA_SxCR_PSIZE_POS );
+	cr |= ( (uint32_t)(pConfig->MemSize & 0x3) << DMA_SxCR_MSIZE_POS );
+	cr |= ( (uint32_t)(pConfig->Priority & 0x3) << DMA_SxCR_PL_POS );
+	if(pConfig->PeriphInc == ENABLE)	{ cr |= DMA_SxCR_PINC; }
+	if(pConfig->MemInc == ENABLE)		{ cr |= DMA_SxCR_MINC; }
+	if(pConfig->Circular == ENABLE)		{ cr |= DMA_SxCR_CIRC; }
+	if(pConfig->DoubleBuffer == ENABLE)	{ cr |= DMA_SxCR_DBM | DMA_SxCR_CIRC; }
+
+	// Interrupt enables, FIFO error interrupt is not used in direct mode
+	if(pConfig->Interrupts & DMA_FLAG_DME)	{ cr |= DMA_SxCR_DMEIE; }
+	if(pConfig->Interrupts & DMA_FLAG_TE)	{ cr |= DMA_SxCR_TEIE; }
+	if(pConfig->Interrupts & DMA_FLAG_HT)	{ cr |= DMA_SxCR_HTIE; }
+	if(pConfig->Interrupts & DMA_FLAG_TC)	{ cr |= DMA_SxCR_TCIE; }
+
+	REG_WRITE(pDMAx->S[Stream].CR, cr);
+	REG_WRITE(pDMAx->S[Stream].FCR, 0);		// Direct mode
+}
+
+// *************************************************************
+// * @fn			- DMA_StreamSetAddress	                   *
+// * 						                                   *
+// * @brief			- Sets the addresses and the number of	   *
+// * 				  items of a stream						   *
+// * 						                                   *
+// * @param[in]		- DMA1 or DMA2							   *
+// * @param[in]		- Stream 0 - 7			               *
+// * @param[in]		- Peripheral register (or source memory    *
+// * 				  in memory-to-memory mode)				   *
+// * @param[in]		- Memory buffer 0		               *
+// * @param[in]		- Memory buffer 1, double buffer mode only *
+// * @param[in]		- Number of items (of PeriphSize) per	   *
+// * 				  buffer, 1 - 65535						   *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Only while the stream is disabled. In	   *
+// * 				  double buffer mode the memory address	   *
+// * 				  that is not the current target may also  *
+// * 				  be changed while the stream runs.		   *
+// *************************************************************
+void DMA_StreamSetAddress(DMA_RegDef_t *pDMAx, uint8_t Stream, __vo void *pPeriph, void *pMem0, void *pMem1, uint16_t Count)
+{
+	REG_WRITE(pDMAx->S[Stream].PAR, (uint32_t)(uintptr_t)pPeriph);
+	REG_WRITE(pDMAx->S[Stream].M0AR, (uint32_t)(uintptr_t)pMem0);
+	REG_WRITE(pDMAx->S[Stream].M1AR, (uint32_t)(uintptr_t)pMem1);
+	REG_WRITE(pDMAx->S[Stream].NDTR, Count);
+}
+
+void DMA_StreamEnable(DMA_RegDef_t *pDMAx, uint8_t Stream)
+{
+	REG_SET_BITS(pDMAx->S[Stream].CR, DMA_SxCR_EN);
+}
+
+void DMA_StreamDisable(DMA_RegDef_t *pDMAx, uint8_t Stream)
+{
+	REG_CLR_BITS(pDMAx->S[Stream].CR, DMA_SxCR_EN);
+
+	// The current transfer is finished before EN reads back as 0
+	while(REG_READ(pDMAx->S[Stream].CR) & DMA_SxCR_EN);
+}
+
+uint16_t DMA_GetRemaining(DMA_RegDef_t *pDMAx, uint8_t Stream)
+{
+	return (uint16_t)REG_READ(pDMAx->S[Stream].NDTR);
+}
+
+uint8_t DMA_GetCurrentTarget(DMA_RegDef_t *pDMAx, uint8_t Stream)
+{
+	return (REG_READ(pDMAx->S[Stream].CR) & DMA_SxCR_CT) ? 1 : 0;
+}
+
+// *************************************************************
+// * @fn			- DMA_GetFlags			                   *
+// * 						                                   *
+// * @brief			- Returns the interrupt flags of a stream  *
+// * 						                                   *
+// * @param[in]		- DMA1 or DMA2							   *
+// * @param[in]		- Stream 0 - 7			               *
+// * 						                                   *
+// * @return		- @DMA_FLAGS                               *
+// *														   *
+// * @note			- The flags are moved to the stream 0	   *
+// * 				  position, so they are the same for all   *
+// * 				  streams								   *
+// *************************************************************
+uint8_t DMA_GetFlags(DMA_RegDef_t *pDMAx, uint8_t Stream)
+{
+	uint32_t isr = (Stream < 4) ? REG_READ(pDMAx->LISR) : REG_READ(pDMAx->HISR);
+
+	return (uint8_t)( (isr >> FlagShift[Stream % 4]) & DMA_FLAG_ALL );
+}
+
+void DMA_ClearFlags(DMA_RegDef_t *pDMAx, uint8_t Stream, uint8_t Flags)
+{
+	uint32_t value = (uint32_t)(Flags & DMA_FLAG_ALL) << FlagShift[Stream % 4];
+
+	// Write 1 to clear, no read needed
+	if(Stream < 4)	{ REG_WRITE(pDMAx->LIFCR, value); }
+	else			{ REG_WRITE(pDMAx->HIFCR, value); }
+}
+
+uint8_t DMA_GetIRQNumber(DMA_RegDef_t *pDMAx, uint8_t Stream)
+{
+	if(pDMAx == DMA1)
+	{
+		return (Stream < 7) ? (IRQ_NO_DMA1_STREAM0 + Stream) : IRQ_NO_DMA1_STREAM7;
+	}
+
+	return (Stream < 5) ? (IRQ_NO_DMA2_STREAM0 + Stream) : (IRQ_NO_DMA2_STREAM5 + Stream - 5);
+}
+
+// *************************************************************
+// * @fn			- DMA_RegisterCallback	                   *
+// * 						                                   *
+// * @brief			- Sets the function called from the stream *
+// * 				  interrupt								   *
+// * 						                                   *
+// * @param[in]		- DMA1 or DMA2							   *
+// * @param[in]		- Stream 0 - 7			               *
+// * @param[in]		- Callback, NULL to remove it              *
+// * @param[in]		- Argument given to the callback           *
+// * 						                                   *
+// * @return		- DMA_OK, or DMA_ERR_BUSY if the stream	   *
+// * 				  has another callback					   *
+// *														   *
+// * @note			- The callback runs in interrupt context.  *
+// * 				  It also marks the stream as used by its  *
+// * 				  driver: a driver can register again (new *
+// * 				  handle), another one gets DMA_ERR_BUSY   *
+// * 				  until the callback is removed.		   *
+// *************************************************************
+uint8_t DMA_RegisterCallback(DMA_RegDef_t *pDMAx, uint8_t Stream, DMA_Callback_t pCallback, void *pArg)
+{
+	uint8_t dma = DMA_INDEX(pDMAx);
+	DMA_Callback_t owner = Callbacks[dma][Stream & 0x7];
+
+	if( (pCallback != NULL) && (owner != NULL) && (owner != pCallback) )
+	{
+		return DMA_ERR_BUSY;
+	}
+
+	// Removed first, so a stream interrupt in between never calls the new argument with the old callback
+	Callbacks[dma][Stream & 0x7] = NULL;
+	CallbackArgs[dma][Stream & 0x7] = pArg;
+	Callbacks[dma][Stream & 0x7] = pCallback;
+
+	return DMA_OK;
+}
+
+// Callback of a stream, NULL if the stream is free
+DMA_Callback_t DMA_GetCallback(DMA_RegDef_t *pDMAx, uint8_t Stream)
+{
+	return Callbacks[DMA_INDEX(pDMAx)][Stream & 0x7];
+}
+
+// *************************************************************
+// * @fn			- DMA_IRQHandling		                   *
+// * 						                                   *
+// * @brief			- Clears the flags of a stream and calls   *
+// * 				  its callback							   *
+// * 						                                   *
+// * @param[in]		- DMA1 or DMA2							   *
+// * @param[in]		- Stream 0 - 7			               *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Called from the DMAx_StreamY_IRQHandler  *
+// *************************************************************
+void DMA_IRQHandling(DMA_RegDef_t *pDMAx, uint8_t Stream)
+{
+	uint8_t dma = DMA_INDEX(pDMAx);
+	uint8_t flags = DMA_GetFlags(pDMAx, Stream);
+
+	if(flags == 0)
+	{
+		return;
+	}
+	DMA_ClearFlags(pDMAx, Stream, flags);
+
+	if(Callbacks[dma][Stream] != NULL)
+	{
+		Callbacks[dma][Stream](CallbackArgs[dma][Stream], flags);
+	}
+}
+
+// DMA stream interrupt handlers. Weak, so the application can write its own.
+__weak void DMA1_Stream0_IRQHandler(void)	{ DMA_IRQHandling(DMA1, 0); }
+__weak void DMA1_Stream1_IRQHandler(void)	{ DMA_IRQHandling(DMA1, 1); }
+__weak void DMA1_Stream2_IRQHandler(void)	{ DMA_IRQHandling(DMA1, 2); }
+__weak void DMA1_Stream3_IRQHandler(void)	{ DMA_IRQHandling(DMA1, 3); }
+__weak void DMA1_Stream4_IRQHandler(void)	{ DMA_IRQHandling(DMA1, 4); }
+__weak void DMA1_Stream5_IRQHandler(void)	{ DMA_IRQHandling(DMA1, 5); }
+__weak void DMA1_Stream6_IRQHandler(void)	{ DMA_IRQHandling(DMA1, 6); }
+__weak void DMA1_Stream7_IRQHandler(void)	{ DMA_IRQHandling(DMA1, 7); }
+__weak void DMA2_Stream0_IRQHandler(void)	{ DMA_IRQHandling(DMA2, 0); }
+__weak void DMA2_Stream1_IRQHandler(void)	{ DMA_IRQHandling(DMA2, 1); }
+__weak void DMA2_Stream2_IRQHandler(void)	{ DMA_IRQHandling(DMA2, 2); }
+__weak void DMA2_Stream3_IRQHandler(void)	{ DMA_IRQHandling(DMA2, 3); }
+__weak void DMA2_Stream4_IRQHandler(void)	{ DMA_IRQHandling(DMA2, 4); }
+__weak void DMA2_Stream5_IRQHandler(void)	{ DMA_IRQHandling(DMA2, 5); }
+__weak void DMA2_Stream6_IRQHandler(void)	{ DMA_IRQHandling(DMA2, 6); }
+__weak void DMA2_Stream7_IRQHandler(void)	{ DMA_IRQHandling(DMA2, 7); }
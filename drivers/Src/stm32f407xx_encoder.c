@@ -0,0 +1,469 @@
+/*
+ * stm32f407xx_encoder.c
+ *
+ *  Created on: Feb 12, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_encoder.h"
+
+#define ENCODER_DMA				DMA2
+
+// Step of a transition, index is (old A, old B, new A, new B). Counting up is
+// 00 -> 10 -> 11 -> 01 -> 00 (A leads B).
+static const int8_t StepTable[16] =
+{
+	 0, -1, +1,  0,		// From 00
+	+1,  0,  0, -1,		// From 01
+	-1,  0,  0, +1,		// From 10
+	 0, +1, -1,  0		// From 11
+};
+
+// Indexes where A and B both changed: 00->11, 01->10, 10->01, 11->00
+#define ENCODER_ILLEGAL_MASK	0x1248U
+
+// EXTI mode: the encoder that owns each EXTI line
+static ENCODER_Handle_t *LineHandles[16];
+static uint8_t LineChannels[16];
+
+// A/B levels of a channel in a port sample, A in bit 1 and B in bit 0
+static inline uint32_t ENCODER_Levels(const ENCODER_Channel_t *pChannel, uint32_t Sample)
+{
+	return (((Sample >> pChannel->PinA) & 1U) << 1) | ((Sample >> pChannel->PinB) & 1U);
+}
+
+static inline void ENCODER_Step(ENCODER_Channel_t *pChannel, uint32_t Sample)
+{
+	uint32_t levels = ENCODER_Levels(pChannel, Sample);
+	uint32_t index = ((uint32_t)pChannel->State << 2) | levels;
+
+	pChannel->Position += StepTable[index];
+	pChannel->Errors += (ENCODER_ILLEGAL_MASK >> index) & 1U;
+	pChannel->State = (uint8_t)levels;
+}
+
+// EXTI callback of an A or B pin, runs in the EXTI interrupt
+static void ENCODER_EXTIHandler(uint8_t PinNumber)
+{
+	ENCODER_Handle_t *pHandle = LineHandles[PinNumber];
+
+	if(pHandle != NULL)
+	{
+		ENCODER_Step(&pHandle->Channel[LineChannels[PinNumber]], GPIO_ReadFromInputPort(pHandle->Config.pGPIOx));
+	}
+}
+
+// Half transfer / transfer complete of the sampling DMA stream, runs in the DMA interrupt
+static void ENCODER_DMAHandler(void *pArg, uint8_t Flags)
+{
+	ENCODER_Handle_t *pHandle = (ENCODER_Handle_t*)pArg;
+	uint16_t half = pHandle->Config.HalfLength;
+
+	// Both set: the interrupt was late and the DMA is already writing the first half again
+	if( (Flags & (DMA_FLAG_HT | DMA_FLAG_TC)) == (DMA_FLAG_HT | DMA_FLAG_TC) )
+	{
+		pHandle->Overruns++;
+	}
+
+	if(Flags & DMA_FLAG_HT)
+	{
+		ENCODER_UpdateBatch(pHandle, pHandle->Config.pSamples, half);
+		pHandle->NextSample = half;
+	}
+	if(Flags & DMA_FLAG_TC)
+	{
+		ENCODER_UpdateBatch(pHandle, &pHandle->Config.pSamples[half], half);
+		pHandle->NextSample = 0;
+	}
+}
+
+// Poll mode: clocks of the timer, the DMA and the port, on from ENCODER_Init to ENCODER_DeInit
+static void ENCODER_ClockControl(const ENCODER_Config_t *pConfig, uint8_t EnorDi)
+{
+	TIM_PeriClockControl(pConfig->pTIMx, EnorDi);
+	DMA_PeriClockControl(ENCODER_DMA, EnorDi);
+	GPIO_PeriClockControl(pConfig->pGPIOx, EnorDi);
+}
+
+// The same clocks in Sleep mode, while counting: the port is sampled while the core sleeps
+static void ENCODER_SleepClockControl(const ENCODER_Config_t *pConfig, uint8_t EnorDi)
+{
+	TIM_SleepClockControl(pConfig->pTIMx, EnorDi);
+	DMA_SleepClockControl(ENCODER_DMA, EnorDi);
+	RCC_PeriphSleepControl(RCC_CLK_GPIO(pConfig->pGPIOx), EnorDi);
+}
+
+// Sets up the timer and the DMA stream that sample the port
+static uint8_t ENCODER_InitPoll(ENCODER_Handle_t *pHandle)
+{
+	ENCODER_Config_t *pConfig = &pHandle->Config;
+	DMA_StreamConfig_t dma = { 0 };
+	uint8_t again;
+
+	if( !TIM_GetUpdateDMARequest(pConfig->pTIMx, &pHandle->Stream, &pHandle->DMAChannel) ||
+		(pConfig->pSamples == NULL) || (pConfig->HalfLength == 0) || (pConfig->HalfLength > 0x7FFFU) )
+	{
+		return ENCODER_ERR_CONFIG;
+	}
+	// The stream is ours already after an earlier Init, its clocks are on
+	again = (DMA_GetCallback(ENCODER_DMA, pHandle->Stream) == ENCODER_DMAHandler);
+	if(DMA_RegisterCallback(ENCODER_DMA, pHandle->Stream, ENCODER_DMAHandler, pHandle) != DMA_OK)
+	{
+		return ENCODER_ERR_CONFIG;
+	}
+	if(!again)
+	{
+		ENCODER_ClockControl(pConfig, ENABLE);
+	}
+
+	TIM_Stop(pConfig->pTIMx);
+	if(TIM_SetUpdateRate(pConfig->pTIMx, pConfig->TimerClockHz, pConfig->SampleRateHz) == 0)
+	{
+		(void)DMA_RegisterCallback(ENCODER_DMA, pHandle->Stream, NULL, NULL);
+		ENCODER_ClockControl(pConfig, DISABLE);
+		return ENCODER_ERR_RATE;
+	}
+
+	dma.Channel = pHandle->DMAChannel;
+	dma.Direction = DMA_DIR_P2M;
+	dma.PeriphSize = DMA_SIZE_HALFWORD;
+	dma.MemSize = DMA_SIZE_HALFWORD;
+	dma.PeriphInc = DISABLE;
+	dma.MemInc = ENABLE;
+	dma.Circular = ENABLE;
+	dma.Priority = DMA_PRIORITY_VERY_HIGH;
+	dma.Interrupts = DMA_FLAG_HT | DMA_FLAG_TC;
+
+	DMA_StreamInit(ENCODER_DMA, pHandle->Stream, &dma);
+	GPIO_IRQConfig(DMA_GetIRQNumber(ENCODER_DMA, pHandle->Stream), pConfig->IRQPriority, ENABLE);
+
+	return ENCODER_OK;
+}
+
+// *************************************************************
+// * @fn			- ENCODER_Init			                   *
+// * 						                                   *
+// * @brief			- Checks the pins of the encoders and sets *
+// * 				  up the EXTI lines or the sampling		   *
+// * 						                                   *
+// * @param[in]		- Handle with the configuration and the	   *
+// * 				  pins of the channels filled in		   *
+// * 						                                   *
+// * @return		- ENCODER_OK or an error code              *
+// *														   *
+// * @note			- The pins must be configured by the	   *
+// * 				  caller (GPIO_InitPort), GPIO_MODE_IT_RFT *
+// * 				  in EXTI mode and GPIO_MODE_IN in poll	   *
+// * 				  mode. Positions start at 0. Init again   *
+// * 				  (not while running) takes no more clock  *
+// * 				  references, ENCODER_DeInit gives them	   *
+// * 				  back. The EXTI lines are taken by		   *
+// * 				  ENCODER_Start, Init fails if a running   *
+// * 				  encoder has one of them.				   *
+// *************************************************************
+uint8_t ENCODER_Init(ENCODER_Handle_t *pHandle)
+{
+	ENCODER_Config_t *pConfig = &pHandle->Config;
+	uint16_t pins = 0;
+
+	if( (pConfig->ChannelCount == 0) || (pConfig->ChannelCount > ENCODER_MAX_CHANNELS) ||
+		(pConfig->Mode > ENCODER_MODE_POLL) )
+	{
+		return ENCODER_ERR_CONFIG;
+	}
+
+	for(uint8_t i = 0; i < pConfig->ChannelCount; i++)
+	{
+		ENCODER_Channel_t *pChannel = &pHandle->Channel[i];
+		uint16_t pair;
+
+		if( (pChannel->PinA > 15) || (pChannel->PinB > 15) || (pChannel->PinA == pChannel->PinB) )
+		{
+			return ENCODER_ERR_CONFIG;
+		}
+
+		// Each pin used once
+		pair = GPIO_PIN_MASK(pChannel->PinA) | GPIO_PIN_MASK(pChannel->PinB);
+		if(pins & pair)
+		{
+			return ENCODER_ERR_CONFIG;
+		}
+		if( (pConfig->Mode == ENCODER_MODE_EXTI) &&
+			( ((LineHandles[pChannel->PinA] != NULL) && (LineHandles[pChannel->PinA] != pHandle)) ||
+			  ((LineHandles[pChannel->PinB] != NULL) && (LineHandles[pChannel->PinB] != pHandle)) ) )
+		{
+			return ENCODER_ERR_CONFIG;
+		}
+		pins |= pair;
+
+		pChannel->State = 0;
+		pChannel->Position = 0;
+		pChannel->Errors = 0;
+	}
+
+	pHandle->PinMask = pins;
+	pHandle->Running = 0;
+	pHandle->Overruns = 0;
+
+	if(pConfig->Mode == ENCODER_MODE_POLL)
+	{
+		return ENCODER_InitPoll(pHandle);
+	}
+
+	return ENCODER_OK;
+}
+
+// *************************************************************
+// * @fn			- ENCODER_DeInit		                   *
+// * 						                                   *
+// * @brief			- Stops counting and gives back the EXTI   *
+// * 				  lines, or the DMA stream and the clocks  *
+// * 				  of ENCODER_Init						   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Positions are kept. The EXTI lines are   *
+// * 				  given back by ENCODER_Stop already.	   *
+// *************************************************************
+void ENCODER_DeInit(ENCODER_Handle_t *pHandle)
+{
+	ENCODER_Stop(pHandle);
+
+	if( (pHandle->Config.Mode == ENCODER_MODE_POLL) &&
+		(DMA_GetCallback(ENCODER_DMA, pHandle->Stream) == ENCODER_DMAHandler) )
+	{
+		GPIO_IRQConfig(DMA_GetIRQNumber(ENCODER_DMA, pHandle->Stream), 0, DISABLE);
+		(void)DMA_RegisterCallback(ENCODER_DMA, pHandle->Stream, NULL, NULL);
+		ENCODER_ClockControl(&pHandle->Config, DISABLE);
+	}
+}
+
+// *************************************************************
+// * @fn			- ENCODER_Start			                   *
+// * 						                                   *
+// * @brief			- Takes the present pin levels as start	   *
+// * 				  state and starts counting				   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Positions are kept from before the start *
+// *************************************************************
+void ENCODER_Start(ENCODER_Handle_t *pHandle)
+{
+	ENCODER_Config_t *pConfig = &pHandle->Config;
+	uint16_t sample;
+
+	ENCODER_Stop(pHandle);
+	sample = GPIO_ReadFromInputPort(pConfig->pGPIOx);
+	for(uint8_t i = 0; i < pConfig->ChannelCount; i++)
+	{
+		pHandle->Channel[i].State = (uint8_t)ENCODER_Levels(&pHandle->Channel[i], sample);
+	}
+
+	if(pConfig->Mode == ENCODER_MODE_POLL)
+	{
+		ENCODER_SleepClockControl(pConfig, ENABLE);
+		pHandle->NextSample = 0;
+		DMA_StreamSetAddress(ENCODER_DMA, pHandle->Stream, &pConfig->pGPIOx->IDR, pConfig->pSamples, NULL,
+				(uint16_t)(2 * pConfig->HalfLength));
+		DMA_ClearFlags(ENCODER_DMA, pHandle->Stream, DMA_FLAG_ALL);
+		REG_SET_BITS(ENCODER_DMA->S[pHandle->Stream].CR, DMA_SxCR_HTIE | DMA_SxCR_TCIE);	// Masked by ENCODER_Stop
+		GPIO_IRQConfig(DMA_GetIRQNumber(ENCODER_DMA, pHandle->Stream), pConfig->IRQPriority, ENABLE);
+		DMA_StreamEnable(ENCODER_DMA, pHandle->Stream);
+
+		REG_WRITE(pConfig->pTIMx->CNT, 0);
+		TIM_UpdateDMAControl(pConfig->pTIMx, ENABLE);
+		TIM_Start(pConfig->pTIMx);
+	}
+	else
+	{
+		// The lines are taken before their callbacks can run
+		for(uint8_t i = 0; i < pConfig->ChannelCount; i++)
+		{
+			LineHandles[pHandle->Channel[i].PinA] = pHandle;
+			LineChannels[pHandle->Channel[i].PinA] = i;
+			LineHandles[pHandle->Channel[i].PinB] = pHandle;
+			LineChannels[pHandle->Channel[i].PinB] = i;
+		}
+
+		// Edges from before the start are already in the state read above
+		REG_WRITE(EXTI->PR, pHandle->PinMask);
+		for(uint8_t pin = 0; pin < 16; pin++)
+		{
+			if(pHandle->PinMask & GPIO_PIN_MASK(pin))
+			{
+				GPIO_RegisterEXTICallback(pin, ENCODER_EXTIHandler);
+				GPIO_IRQConfig(GPIO_PinToIRQNumber(pin), pConfig->IRQPriority, ENABLE);
+			}
+		}
+	}
+
+	pHandle->Running = 1;
+}
+
+// *************************************************************
+// * @fn			- ENCODER_Stop			                   *
+// * 						                                   *
+// * @brief			- Stops counting						   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Poll mode decodes the samples taken	   *
+// * 				  before the stop, the DMA interrupt of	   *
+// * 				  the stream is left masked until the next *
+// * 				  ENCODER_Start. EXTI mode gives the lines *
+// * 				  back, the EXTI IRQs stay enabled, they   *
+// * 				  may serve other lines.				   *
+// *************************************************************
+void ENCODER_Stop(ENCODER_Handle_t *pHandle)
+{
+	ENCODER_Config_t *pConfig = &pHandle->Config;
+
+	if(!pHandle->Running)
+	{
+		return;
+	}
+	pHandle->Running = 0;
+
+	if(pConfig->Mode == ENCODER_MODE_POLL)
+	{
+		uint32_t length = 2U * pConfig->HalfLength;
+		uint32_t written;
+
+		// The interrupt is masked before the stream stops: disabling a running stream sets TCIF,
+		// and the handler would decode the half that is being written as if it were full
+		GPIO_IRQConfig(DMA_GetIRQNumber(ENCODER_DMA, pHandle->Stream), 0, DISABLE);
+		REG_CLR_BITS(ENCODER_DMA->S[pHandle->Stream].CR, DMA_SxCR_HTIE | DMA_SxCR_TCIE);
+
+		TIM_Stop(pConfig->pTIMx);
+		TIM_UpdateDMAControl(pConfig->pTIMx, DISABLE);
+		DMA_StreamDisable(ENCODER_DMA, pHandle->Stream);
+		DMA_ClearFlags(ENCODER_DMA, pHandle->Stream, DMA_FLAG_ALL);
+		ENCODER_SleepClockControl(pConfig, DISABLE);
+
+		// Where the DMA stopped comes from NDTR alone. Everything from the first sample not
+		// decoded up to there is decoded once, also a half whose interrupt did not run.
+		written = length - DMA_GetRemaining(ENCODER_DMA, pHandle->Stream);
+		if(written >= length)
+		{
+			written = 0;				// NDTR reloaded at the end of the buffer
+		}
+		if(written < pHandle->NextSample)
+		{
+			ENCODER_UpdateBatch(pHandle, &pConfig->pSamples[pHandle->NextSample], length - pHandle->NextSample);
+			pHandle->NextSample = 0;
+		}
+		ENCODER_UpdateBatch(pHandle, &pConfig->pSamples[pHandle->NextSample], written - pHandle->NextSample);
+		pHandle->NextSample = (uint16_t)written;
+	}
+	else
+	{
+		for(uint8_t pin = 0; pin < 16; pin++)
+		{
+			if(pHandle->PinMask & GPIO_PIN_MASK(pin))
+			{
+				GPIO_RegisterEXTICallback(pin, NULL);
+				LineHandles[pin] = NULL;
+			}
+		}
+	}
+}
+
+// *************************************************************
+// * @fn			- ENCODER_SetPosition	                   *
+// * 						                                   *
+// * @brief			- Sets the position of one encoder		   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * @param[in]		- Channel, 0 - ChannelCount - 1			   *
+// * @param[in]		- New position							   *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- With interrupts masked, so a step of the *
+// * 				  interrupt is not lost in between		   *
+// *************************************************************
+void ENCODER_SetPosition(ENCODER_Handle_t *pHandle, uint8_t Channel, int32_t Position)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	pHandle->Channel[Channel].Position = Position;
+	__set_PRIMASK(primask);
+}
+
+// *************************************************************
+// * @fn			- ENCODER_Poll			                   *
+// * 						                                   *
+// * @brief			- Reads the port once and steps all the	   *
+// * 				  encoders								   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- For polling from a timer interrupt	   *
+// * 				  without the DMA						   *
+// *************************************************************
+void ENCODER_Poll(ENCODER_Handle_t *pHandle)
+{
+	ENCODER_Update(pHandle, GPIO_ReadFromInputPort(pHandle->Config.pGPIOx));
+}
+
+void ENCODER_Update(ENCODER_Handle_t *pHandle, uint16_t Sample)
+{
+	for(uint8_t i = 0; i < pHandle->Config.ChannelCount; i++)
+	{
+		ENCODER_Step(&pHandle->Channel[i], Sample);
+	}
+}
+
+// *************************************************************
+// * @fn			- ENCODER_UpdateBatch	                   *
+// * 						                                   *
+// * @brief			- Steps all the encoders through a block   *
+// * 				  of port samples						   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * @param[in]		- Port samples (IDR), oldest first		   *
+// * @param[in]		- Number of samples                        *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- One channel at a time with its state,	   *
+// * 				  position and errors in registers, they   *
+// * 				  are written back once per block		   *
+// *************************************************************
+void ENCODER_UpdateBatch(ENCODER_Handle_t *pHandle, const uint16_t *pSamples, uint32_t Count)
+{
+	for(uint8_t i = 0; i < pHandle->Config.ChannelCount; i++)
+	{
+		ENCODER_Channel_t *pChannel = &pHandle->Channel[i];
+		uint32_t shiftA = pChannel->PinA;
+		uint32_t shiftB = pChannel->PinB;
+		uint32_t state = pChannel->State;
+		int32_t position = 0;
+		uint32_t errors = 0;
+
+		for(uint32_t n = 0; n < Count; n++)
+		{
+			uint32_t sample = pSamples[n];
+			uint32_t levels = (((sample >> shiftA) & 1U) << 1) | ((sample >> shiftB) & 1U);
+			uint32_t index = (state << 2) | levels;
+
+			position += StepTable[index];
+			errors += (ENCODER_ILLEGAL_MASK >> index) & 1U;
+			state = levels;
+		}
+
+		pChannel->State = (uint8_t)state;
+		pChannel->Position += position;
+		pChannel->Errors += errors;
+	}
+}
@@ -0,0 +1,101 @@
+/*
+ * stm32f407xx_flash_driver.c
+ *
+ *  Created on: Dec 18, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_flash_driver.h"
+
+// *************************************************************
+// * @fn			- FLASH_SetLatency		                   *
+// * 						                                   *
+// * @brief			- Sets the number of flash wait states	   *
+// * 						                                   *
+// * @param[in]		- Wait states 0 - 7		                   *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Returns when the new value is in effect  *
+// * 				  (read back, ch. 3.5.1). Raise it before  *
+// * 				  raising HCLK, lower it after lowering.   *
+// *************************************************************
+void FLASH_SetLatency(uint8_t WaitStates)
+{
+	WaitStates &= FLASH_LATENCY_MAX;
+
+	REG_MODIFY(FLASH->ACR, FLASH_ACR_LATENCY_MASK, WaitStates);
+	while( (REG_READ(FLASH->ACR) & FLASH_ACR_LATENCY_MASK) != WaitStates );
+}
+
+uint8_t FLASH_GetLatency(void)
+{
+	return (uint8_t)(REG_READ(FLASH->ACR) & FLASH_ACR_LATENCY_MASK);
+}
+
+void FLASH_PrefetchControl(uint8_t EnorDi)
+{
+	if(EnorDi == ENABLE)
+	{
+		REG_SET_BITS(FLASH->ACR, FLASH_ACR_PRFTEN);
+	}
+	else
+	{
+		REG_CLR_BITS(FLASH->ACR, FLASH_ACR_PRFTEN);
+	}
+}
+
+// Disables a cache, resets it and enables it again if asked to
+static void FLASH_CacheControl(uint32_t EnableBit, uint32_t ResetBit, uint8_t EnorDi)
+{
+	REG_CLR_BITS(FLASH->ACR, EnableBit);
+
+	if(EnorDi == ENABLE)
+	{
+		// Invalidate the old lines, the reset bit only works while the cache is disabled
+		REG_SET_BITS(FLASH->ACR, ResetBit);
+		REG_CLR_BITS(FLASH->ACR, ResetBit);
+		REG_SET_BITS(FLASH->ACR, EnableBit);
+	}
+}
+
+// *************************************************************
+// * @fn			- FLASH_ICacheControl	                   *
+// * 						                                   *
+// * @brief			- Enables or disables the instruction	   *
+// * 				  cache									   *
+// * 						                                   *
+// * @param[in]		- ENABLE or DISABLE macros	               *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- The cache is reset before it is enabled, *
+// * 				  so no old lines are used after the flash *
+// * 				  has been programmed					   *
+// *************************************************************
+void FLASH_ICacheControl(uint8_t EnorDi)
+{
+	FLASH_CacheControl(FLASH_ACR_ICEN, FLASH_ACR_ICRST, EnorDi);
+}
+
+void FLASH_DCacheControl(uint8_t EnorDi)
+{
+	FLASH_CacheControl(FLASH_ACR_DCEN, FLASH_ACR_DCRST, EnorDi);
+}
+
+// *************************************************************
+// * @fn			- FLASH_EnableART		                   *
+// * 						                                   *
+// * @brief			- Turns the whole ART accelerator on	   *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Call once at startup, before or after	   *
+// * 				  RCC_ClockConfig						   *
+// *************************************************************
+void FLASH_EnableART(void)
+{
+	FLASH_ICacheControl(ENABLE);
+	FLASH_DCacheControl(ENABLE);
+	FLASH_PrefetchControl(ENABLE);
+}
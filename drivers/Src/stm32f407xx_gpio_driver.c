@@ -6,6 +6,94 @@
  */
 
 #include "stm32f407xx_gpio_driver.h"
+#include "stm32f407xx_profiler.h"
+
+#ifdef STM32F407XX_SIM
+#include <stdatomic.h>
+#endif
+
+// Shadow of the configuration registers of each port (see GPIO_PortState_t)
+static GPIO_PortState_t Shadow[GPIO_PORT_COUNT];
+static uint16_t ShadowValid;		// Bit n: Shadow[n] holds the registers of port n
+
+// EXTI lines the driver has routed to each port, so they can be released again when their
+// pin leaves the interrupt modes. Changed with the shadow lock held.
+static uint16_t EXTILinesOf[GPIO_PORT_COUNT];
+
+// Reset values of the configuration registers (ch. 8.4), ports A and B have the debug pins
+static const GPIO_PortState_t ResetStateA = { .MODER = 0xA8000000U, .OSPEEDR = 0x0C000000U, .PUPDR = 0x64000000U };
+static const GPIO_PortState_t ResetStateB = { .MODER = 0x00000280U, .OSPEEDR = 0x000000C0U, .PUPDR = 0x00000100U };
+static const GPIO_PortState_t ResetStateOther = { 0 };
+
+// The shadow update and the store to the port must not be split, or a context that preempts
+// between them stores its value and is then overwritten with the older one. LDREX/STREX would
+// make the shadow update atomic but not the store after it, so interrupts are masked instead,
+// for a few cycles per register. On the host the contexts are threads and a spin lock takes
+// the place of PRIMASK.
+#ifndef STM32F407XX_SIM
+static inline uint32_t GPIO_ShadowLock(void)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	return primask;
+}
+
+static inline void GPIO_ShadowUnlock(uint32_t PriMask)
+{
+	__set_PRIMASK(PriMask);
+}
+#else
+static atomic_flag ShadowLockFlag = ATOMIC_FLAG_INIT;
+
+static inline uint32_t GPIO_ShadowLock(void)
+{
+	while(atomic_flag_test_and_set_explicit(&ShadowLockFlag, memory_order_acquire))
+	{
+	}
+
+	return 0;
+}
+
+static inline void GPIO_ShadowUnlock(uint32_t PriMask)
+{
+	(void)PriMask;
+	atomic_flag_clear_explicit(&ShadowLockFlag, memory_order_release);
+}
+#endif
+
+// Shadow of a port, loaded from the registers if it is not valid. Called with the lock held.
+static GPIO_PortState_t *GPIO_GetShadow(GPIO_RegDef_t *pGPIOx, uint32_t PortCode)
+{
+	GPIO_PortState_t *pShadow = &Shadow[PortCode];
+
+	if( !(ShadowValid & (1U << PortCode)) )
+	{
+		pShadow->MODER   = REG_READ(pGPIOx->MODER);
+		pShadow->OTYPER  = REG_READ(pGPIOx->OTYPER);
+		pShadow->OSPEEDR = REG_READ(pGPIOx->OSPEEDR);
+		pShadow->PUPDR   = REG_READ(pGPIOx->PUPDR);
+		pShadow->AFR[0]  = REG_READ(pGPIOx->AFR[0]);
+		pShadow->AFR[1]  = REG_READ(pGPIOx->AFR[1]);
+		ShadowValid |= (uint16_t)(1U << PortCode);
+	}
+
+	return pShadow;
+}
+
+// Spreads a pin mask to the 2 bit fields of MODER, OSPEEDR and PUPDR: bit n to bit 2n
+static uint32_t GPIO_SpreadPinMask(uint16_t PinMask)
+{
+	uint32_t x = PinMask;
+
+	x = (x | (x << 8)) & 0x00FF00FFU;
+	x = (x | (x << 4)) & 0x0F0F0F0FU;
+	x = (x | (x << 2)) & 0x33333333U;
+	x = (x | (x << 1)) & 0x55555555U;
+
+	return x;
+}
 
 
 // Peripheral clock setup
@@ -13,8 +101,8 @@
 // *************************************************************
 // * @fn			- GPIO_PeriClockControl                    *    Function name
 // * 						                                   *
-// * @brief			- This function disables peripheral clock  *    Brief description
-// * 				  for the given GPIO port				   *
+// * @brief			- This function enables or disables		   *    Brief description
+// * 				  peripheral clock for the given GPIO port *
 // * 						                                   *
 // * @param[in]		- Base address of the GPIO peripheral      *	Parameter description
 // * @param[in]		- ENABLE or DISABLE macros	               *
@@ -22,33 +110,31 @@
 // * 						                                   *
 // * @return		- None	                                   *	Return type
 // *														   *
-// * @note			- None									   *	Any special note for using this API
+// * @note			- The enable bit is found from the port	   *	Any special note for using this API
+// * 				  address, see GPIO_BASEADDR_TO_CODE. With *
+// * 				  a constant port GPIO_PeriClockEnable/	   *
+// * 				  GPIO_PeriClockDisable are cheaper.	   *
+// * 				  Counted by RCC_PeriphClockEnable, the	   *
+// * 				  port clock goes off with its last user.  *
+// * 				  Gated in Sleep mode, the outputs keep	   *
+// * 				  their level and EXTI needs no clock.	   *
 // *************************************************************
 void GPIO_PeriClockControl(GPIO_RegDef_t *pGPIOx, uint8_t EnorDi)
 {
+	uint32_t portCode = GPIO_BASEADDR_TO_CODE(pGPIOx);
+
+	if(portCode >= GPIO_PORT_COUNT)
+	{
+		return; // Not a GPIO port
+	}
+
 	if(EnorDi == ENABLE)
 	{
-		if(pGPIOx == GPIOA)		{ GPIOA_PCLK_EN(); }
-		else if(pGPIOx == GPIOB){ GPIOB_PCLK_EN(); }
-		else if(pGPIOx == GPIOC){ GPIOC_PCLK_EN(); }
-		else if(pGPIOx == GPIOD){ GPIOD_PCLK_EN(); }
-		else if(pGPIOx == GPIOE){ GPIOE_PCLK_EN(); }
-		else if(pGPIOx == GPIOF){ GPIOF_PCLK_EN(); }
-		else if(pGPIOx == GPIOG){ GPIOG_PCLK_EN(); }
-		else if(pGPIOx == GPIOH){ GPIOH_PCLK_EN(); }
-		else if(pGPIOx == GPIOI){ GPIOI_PCLK_EN(); }
+		RCC_PeriphClockEnable(RCC_CLK_ID(RCC_BUS_AHB1, portCode), RCC_CLK_RUN_ONLY);
 	}
 	else
 	{
-		if(pGPIOx == GPIOA)		{ GPIOA_PCLK_DI(); }
-		else if(pGPIOx == GPIOB){ GPIOB_PCLK_DI(); }
-		else if(pGPIOx == GPIOC){ GPIOC_PCLK_DI(); }
-		else if(pGPIOx == GPIOD){ GPIOD_PCLK_DI(); }
-		else if(pGPIOx == GPIOE){ GPIOE_PCLK_DI(); }
-		else if(pGPIOx == GPIOF){ GPIOF_PCLK_DI(); }
-		else if(pGPIOx == GPIOG){ GPIOG_PCLK_DI(); }
-		else if(pGPIOx == GPIOH){ GPIOH_PCLK_DI(); }
-		else if(pGPIOx == GPIOI){ GPIOI_PCLK_DI(); }
+		RCC_PeriphClockDisable(RCC_CLK_ID(RCC_BUS_AHB1, portCode), RCC_CLK_RUN_ONLY);
 	}
 }
 
@@ -57,85 +143,446 @@ void GPIO_PeriClockControl(GPIO_RegDef_t *pGPIOx, uint8_t EnorDi)
 // *************************************************************
 // * @fn			- GPIO_init			                       *    Function name
 // * 						                                   *
-// * @brief			- This function disables peripheral clock  *    Brief description
-// * 				  for the given GPIO port				   *
+// * @brief			- This function configures one GPIO pin    *    Brief description
+// * 				  from the handle						   *
 // * 						                                   *
-// * @param[in]		- Base address of the GPIO peripheral      *	Parameter description
+// * @param[in]		- Handle with port and pin configuration   *	Parameter description
 // * @param[in]		- 							               *
 // * @param[in]		- 		                                   *
 // * 						                                   *
 // * @return		- None	                                   *	Return type
 // *														   *
-// * @note			- None									   *	Any special note for using this API
+// * @note			- Same as GPIO_InitPort with one pin. Use  *	Any special note for using this API
+// *				  GPIO_InitPort when several pins of a	   *
+// *				  port are configured at once. For the	   *
+// *				  interrupt modes the NVIC is configured   *
+// *				  with GPIO_IRQConfig.					   *
 // *************************************************************
 void GPIO_init(GPIO_Handle_t *pGPIOHandle)
 {
-	uint32_t temp;	//Temporary register
+	(void)GPIO_InitPort(pGPIOHandle->pGPIOx, &pGPIOHandle->GPIO_PinConfig, 1);
+}
 
-	// 1. Configure the mode of gpio pin
-	if(pGPIOHandle->GPIO_PinConfig.GPIO_PinMode <= GPIO_MODE_ANALOG)
+// *************************************************************
+// * @fn			- GPIO_BuildPortConfig	                   *
+// * 						                                   *
+// * @brief			- Merges the configuration of several pins *
+// * 				  of one port into one clear mask and one  *
+// * 				  value per configuration register		   *
+// * 						                                   *
+// * @param[in]		- Array of pin configurations		       *
+// * @param[in]		- Number of entries in the array           *
+// * @param[out]	- Merged port configuration	               *
+// * 						                                   *
+// * @return		- @GPIO_STATUS                             *
+// *														   *
+// * @note			- No register is accessed. pPortConfig is  *
+// * 				  only valid when GPIO_OK is returned.	   *
+// *************************************************************
+uint8_t GPIO_BuildPortConfig(const GPIO_PinConfig_t *pPinConfigs, uint8_t Len, GPIO_PortConfig_t *pPortConfig)
+{
+	uint16_t usedPins = 0;
+	GPIO_PortConfig_t cfg = { 0 };
+
+	for(uint8_t i = 0; i < Len; i++)
 	{
-		// The non-interrupt mode
-		// Each pin takes 2 bit fields
-		temp = ( pGPIOHandle->GPIO_PinConfig.GPIO_PinMode << (2 * pGPIOHandle->GPIO_PinConfig.GPIO_PinNumber) );
-		pGPIOHandle->pGPIOx->MODER &= ~( 0x3 << pGPIOHandle->GPIO_PinConfig.GPIO_PinNumber ); // Need to clear the bitfield before, just in case if it's not cleared.
-		pGPIOHandle->pGPIOx->MODER |= temp; // Setting - Use bitwise or her, not only equal sign. We don't want to
-											// affect other bits of this register.
+		const GPIO_PinConfig_t *pPin = &pPinConfigs[i];
+		uint8_t pin = pPin->GPIO_PinNumber;
+
+		if(pin > GPIO_PIN_NO_15)
+		{
+			return GPIO_ERR_INVALID_PIN;
+		}
+		if(usedPins & GPIO_PIN_MASK(pin))
+		{
+			return GPIO_ERR_PIN_OVERLAP;
+		}
+		if( (pPin->GPIO_PinMode > GPIO_MODE_IT_RFT) || (pPin->GPIO_PinSpeed > GPIO_MODE_HIGH) ||
+			(pPin->GPIO_PinPuPdControl > GPIO_PIN_PD) || (pPin->GPIO_PinOPType > GPIO_MODE_OD) ||
+			((pPin->GPIO_PinMode == GPIO_MODE_ALTFN) && (pPin->GPIO_PinAltFunMode > GPIO_ALTFN_MAX)) )
+		{
+			return GPIO_ERR_INVALID_CONFIG;
+		}
+		usedPins |= GPIO_PIN_MASK(pin);
+
+		// 1. Mode, each pin takes 2 bit fields. The interrupt modes are inputs as seen from MODER.
+		uint32_t mode = (pPin->GPIO_PinMode <= GPIO_MODE_ANALOG) ? pPin->GPIO_PinMode : GPIO_MODE_IN;
+		cfg.MODERMask  |= ( 0x3U << (2 * pin) );
+		cfg.MODERValue |= ( mode << (2 * pin) );
+
+		// 2. Speed
+		cfg.OSPEEDRMask  |= ( 0x3U << (2 * pin) );
+		cfg.OSPEEDRValue |= ( (uint32_t)pPin->GPIO_PinSpeed << (2 * pin) );
+
+		// 3. Pull-up, pull-down
+		cfg.PUPDRMask  |= ( 0x3U << (2 * pin) );
+		cfg.PUPDRValue |= ( (uint32_t)pPin->GPIO_PinPuPdControl << (2 * pin) );
+
+		// 4. Output type, each pin takes 1 bit field
+		cfg.OTYPERMask  |= ( 0x1U << pin );
+		cfg.OTYPERValue |= ( (uint32_t)pPin->GPIO_PinOPType << pin );
+
+		// 5. Alternate function, 4 bit fields. Pins 0-7 are in AFR[0], 8-15 in AFR[1]
+		if(pPin->GPIO_PinMode == GPIO_MODE_ALTFN)
+		{
+			cfg.AFRMask[pin / 8]  |= ( 0xFU << (4 * (pin % 8)) );
+			cfg.AFRValue[pin / 8] |= ( (uint32_t)pPin->GPIO_PinAltFunMode << (4 * (pin % 8)) );
+		}
+
+		// 6. Interrupt modes, the pin is routed to EXTI line "pin" with the selected edges
+		if(pPin->GPIO_PinMode >= GPIO_MODE_IT_FT)
+		{
+			cfg.EXTILines |= GPIO_PIN_MASK(pin);
+			if(pPin->GPIO_PinMode != GPIO_MODE_IT_RT)
+			{
+				cfg.EXTIFalling |= GPIO_PIN_MASK(pin);
+			}
+			if(pPin->GPIO_PinMode != GPIO_MODE_IT_FT)
+			{
+				cfg.EXTIRising |= GPIO_PIN_MASK(pin);
+			}
+		}
 	}
-	else
+
+	cfg.Pins = usedPins;
+	*pPortConfig = cfg;
+
+	return GPIO_OK;
+}
+
+// Changes the bits in Mask of one configuration register through its shadow. The register
+// is stored once and never read, an unused register is not touched at all.
+static void GPIO_WriteConfigReg(__vo uint32_t *pReg, uint32_t *pShadow, uint32_t Mask, uint32_t Value)
+{
+	if(Mask != 0)
 	{
-		// This part will be coded later (interrupt mode)
+		*pShadow = (*pShadow & ~Mask) | Value;
+		REG_WRITE(*pReg, *pShadow);
 	}
+}
 
-	temp = 0;
-	// 2. Configure the speed
-	temp = ( pGPIOHandle->GPIO_PinConfig.GPIO_PinSpeed << (2* pGPIOHandle->GPIO_PinConfig.GPIO_PinNumber) );
-	pGPIOHandle->pGPIOx->OSPEEDR &= ~( 0x3 << pGPIOHandle->GPIO_PinConfig.GPIO_PinNumber ); // Need to clear the bitfield before, just in case if it's not cleared.
-	pGPIOHandle->pGPIOx->OSPEEDR |= temp;
+// Routes the interrupt pins of a port to their EXTI lines and sets the edge triggers
+static void GPIO_ApplyEXTIConfig(GPIO_RegDef_t *pGPIOx, const GPIO_PortConfig_t *pPortConfig)
+{
+	uint32_t portCode = GPIO_BASEADDR_TO_CODE(pGPIOx);
+	uint32_t lines = pPortConfig->EXTILines;
 
-	// 3. Configure the pupd settings (Pull-Up, Pull-Down)
-	temp = ( pGPIOHandle->GPIO_PinConfig.GPIO_PinPuPdControl << (2* pGPIOHandle->GPIO_PinConfig.GPIO_PinNumber) );
-	pGPIOHandle->pGPIOx->PUPDR &= ~( 0x3 << pGPIOHandle->GPIO_PinConfig.GPIO_PinNumber ); // Need to clear the bitfield before, just in case if it's not cleared.
-	pGPIOHandle->pGPIOx->PUPDR |= temp;
+	// 1. Select the port of each line in SYSCFG_EXTICR, 4 lines per register and 4 bits per line (ch. 9.2.3)
+	for(uint8_t i = 0; i < 4; i++)
+	{
+		uint32_t clearMask = 0, value = 0;
+
+		for(uint8_t j = 0; j < 4; j++)
+		{
+			if(lines & (1U << (4 * i + j)))
+			{
+				clearMask |= ( 0xFU << (4 * j) );
+				value     |= ( portCode << (4 * j) );
+			}
+		}
+		if(clearMask != 0)
+		{
+			REG_MODIFY(SYSCFG->EXTICR[i], clearMask, value);
+		}
+	}
 
-	// 4. Configure the optype (output type)
-	// Each pin takes 1 bit field, so multiplying by 2 is not required
-	temp = ( pGPIOHandle->GPIO_PinConfig.GPIO_PinOPType << (pGPIOHandle->GPIO_PinConfig.GPIO_PinNumber) );
-	pGPIOHandle->pGPIOx->OTYPER &= ~( 0x1 << pGPIOHandle->GPIO_PinConfig.GPIO_PinNumber ); // Need to clear the bitfield before, just in case if it's not cleared.
-	pGPIOHandle->pGPIOx->OTYPER |= temp;
+	// 2. Edge triggers (ch. 12.3.3 and 12.3.4)
+	REG_MODIFY(EXTI->RTSR, lines, pPortConfig->EXTIRising);
+	REG_MODIFY(EXTI->FTSR, lines, pPortConfig->EXTIFalling);
 
-	temp = 0;
+	// 3. Unmask the interrupt lines, done last so no interrupt fires with a half done configuration
+	REG_SET_BITS(EXTI->IMR, lines);
 
-	// 5. Configure the alt (alternate) functionality
-	if(pGPIOHandle->GPIO_PinConfig.GPIO_PinMode == GPIO_MODE_ALTFN)
+	// A line belongs to one port at a time
+	for(uint32_t i = 0; i < GPIO_PORT_COUNT; i++)
 	{
-		// Configure the alt function registers
-		uint32_t temp1, temp2;
+		EXTILinesOf[i] &= (uint16_t)~lines;
+	}
+	EXTILinesOf[portCode] |= (uint16_t)lines;
+}
 
-		// The divition is integer, so it results in whole numbers
-		// The mod of 8 will give the rest of the divition.
-		temp1 = pGPIOHandle->GPIO_PinConfig.GPIO_PinNumber / 8;
-		temp2 = pGPIOHandle->GPIO_PinConfig.GPIO_PinNumber % 8;
+// Masks the EXTI lines of pins that left the interrupt modes and removes their edge triggers
+// and pending flags. Lines routed to another port since are not touched.
+static void GPIO_ReleaseEXTILines(uint32_t PortCode, uint16_t Pins)
+{
+	uint32_t lines = Pins & EXTILinesOf[PortCode];
 
+	if(lines != 0)
+	{
+		REG_CLR_BITS(EXTI->IMR, lines);		// Masked first, no interrupt from the old trigger
+		REG_CLR_BITS(EXTI->RTSR, lines);
+		REG_CLR_BITS(EXTI->FTSR, lines);
+		REG_WRITE(EXTI->PR, lines);			// Write 1 to clear
+		EXTILinesOf[PortCode] &= (uint16_t)~lines;
+	}
+}
 
-		pGPIOHandle->pGPIOx->AFR[temp1] &= ~( 0xF << ( 4*temp2 ) ); //Clearing
-		pGPIOHandle->pGPIOx->AFR[temp1] |= ( pGPIOHandle->GPIO_PinConfig.GPIO_PinAltFunMode << ( 4*temp2 ) );
+// *************************************************************
+// * @fn			- GPIO_ApplyPortConfig	                   *
+// * 						                                   *
+// * @brief			- Writes a merged port configuration to    *
+// * 				  the port, each register is written once  *
+// * 						                                   *
+// * @param[in]		- GPIOx Peripheral 						   *
+// *                  (Base Address of the GPIO Port)		   *
+// * @param[in]		- Configuration from GPIO_BuildPortConfig  *
+// * 						                                   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Pins not in the configuration keep their *
+// * 				  settings. The registers are written	   *
+// * 				  from the shadow, MODER last so a pin	   *
+// * 				  gets its new mode with the rest of its   *
+// * 				  configuration already in place. Safe	   *
+// * 				  against an ISR reconfiguring other pins  *
+// * 				  of the port or other EXTI lines. Pins	   *
+// * 				  moved out of the interrupt modes get	   *
+// * 				  their EXTI line masked and its triggers  *
+// * 				  cleared.								   *
+// *************************************************************
+void GPIO_ApplyPortConfig(GPIO_RegDef_t *pGPIOx, const GPIO_PortConfig_t *pPortConfig)
+{
+	uint32_t portCode = GPIO_BASEADDR_TO_CODE(pGPIOx);
+	GPIO_PortState_t *pShadow;
+	uint32_t primask;
 
+	if(portCode >= GPIO_PORT_COUNT)
+	{
+		return; // Not a GPIO port
+	}
+
+	if(pPortConfig->EXTILines != 0)
+	{
+		RCC_PeriphClockEnable(RCC_CLK_SYSCFG, RCC_CLK_RUN_ONLY);	// Only for the EXTICR writes, given back below
+	}
+
+	primask = GPIO_ShadowLock();
+
+	pShadow = GPIO_GetShadow(pGPIOx, portCode);
+	GPIO_WriteConfigReg(&pGPIOx->OSPEEDR, &pShadow->OSPEEDR, pPortConfig->OSPEEDRMask, pPortConfig->OSPEEDRValue);
+	GPIO_WriteConfigReg(&pGPIOx->PUPDR,   &pShadow->PUPDR,   pPortConfig->PUPDRMask,   pPortConfig->PUPDRValue);
+	GPIO_WriteConfigReg(&pGPIOx->OTYPER,  &pShadow->OTYPER,  pPortConfig->OTYPERMask,  pPortConfig->OTYPERValue);
+	GPIO_WriteConfigReg(&pGPIOx->AFR[0],  &pShadow->AFR[0],  pPortConfig->AFRMask[0],  pPortConfig->AFRValue[0]);
+	GPIO_WriteConfigReg(&pGPIOx->AFR[1],  &pShadow->AFR[1],  pPortConfig->AFRMask[1],  pPortConfig->AFRValue[1]);
+	GPIO_WriteConfigReg(&pGPIOx->MODER,   &pShadow->MODER,   pPortConfig->MODERMask,   pPortConfig->MODERValue);
+
+	// The EXTI and SYSCFG registers are shared by all ports and have no shadow, their
+	// read-modify-writes are in the same critical section
+	GPIO_ReleaseEXTILines(portCode, pPortConfig->Pins & (uint16_t)~pPortConfig->EXTILines);
+	if(pPortConfig->EXTILines != 0)
+	{
+		GPIO_ApplyEXTIConfig(pGPIOx, pPortConfig);
+	}
+
+	GPIO_ShadowUnlock(primask);
+
+	// EXTICR keeps its value with the clock off, the EXTI lines do not need SYSCFG
+	if(pPortConfig->EXTILines != 0)
+	{
+		RCC_PeriphClockDisable(RCC_CLK_SYSCFG, RCC_CLK_RUN_ONLY);
+	}
+}
+
+// *************************************************************
+// * @fn			- GPIO_InitPort		                       *
+// * 						                                   *
+// * @brief			- Configures several pins of one port	   *
+// * 				  with one access per register			   *
+// * 						                                   *
+// * @param[in]		- GPIOx Peripheral 						   *
+// *                  (Base Address of the GPIO Port)		   *
+// * @param[in]		- Array of pin configurations		       *
+// * @param[in]		- Number of entries in the array           *
+// * 						                                   *
+// * @return		- @GPIO_STATUS                             *
+// *														   *
+// * @note			- The whole array is checked before any	   *
+// * 				  register is written, so on error the	   *
+// * 				  port is left unchanged.				   *
+// *************************************************************
+uint8_t GPIO_InitPort(GPIO_RegDef_t *pGPIOx, const GPIO_PinConfig_t *pPinConfigs, uint8_t Len)
+{
+	GPIO_PortConfig_t cfg;
+	uint8_t status;
+
+	PROFILER_BEGIN(PROFILER_ID_GPIO_INIT);
+
+	status = GPIO_BuildPortConfig(pPinConfigs, Len, &cfg);
+	if(status == GPIO_OK)
+	{
+		GPIO_ApplyPortConfig(pGPIOx, &cfg);
 	}
 
+	PROFILER_END(PROFILER_ID_GPIO_INIT);
+
+	return status;
 }
 
 void GPIO_DeInit(GPIO_RegDef_t *pGPIOx) // Put reset bit to 1 will reset the whole port that is inputted
 {
-	if(pGPIOx == GPIOA)		{ GPIOA_REG_RESET(); }
-	else if(pGPIOx == GPIOB){ GPIOB_REG_RESET(); }
-	else if(pGPIOx == GPIOC){ GPIOC_REG_RESET(); }
-	else if(pGPIOx == GPIOD){ GPIOD_REG_RESET(); }
-	else if(pGPIOx == GPIOE){ GPIOE_REG_RESET(); }
-	else if(pGPIOx == GPIOF){ GPIOF_REG_RESET(); }
-	else if(pGPIOx == GPIOG){ GPIOG_REG_RESET(); }
-	else if(pGPIOx == GPIOH){ GPIOH_REG_RESET(); }
-	else if(pGPIOx == GPIOI){ GPIOI_REG_RESET(); }
+	uint32_t portCode = GPIO_BASEADDR_TO_CODE(pGPIOx);
+
+	if(portCode >= GPIO_PORT_COUNT)
+	{
+		return; // Not a GPIO port
+	}
+
+	uint32_t primask = GPIO_ShadowLock();
+
+	// Pulse the reset bit of the port, same as GPIOx_REG_RESET()
+	REG_BB_SET(RCC->AHB1RSTR, portCode);
+	REG_BB_CLR(RCC->AHB1RSTR, portCode);
+
+	// The registers are at their reset values now, so is the shadow
+	Shadow[portCode] = (portCode == 0) ? ResetStateA : (portCode == 1) ? ResetStateB : ResetStateOther;
+	ShadowValid |= (uint16_t)(1U << portCode);
+
+	// All pins are inputs again, the port keeps no EXTI line
+	GPIO_ReleaseEXTILines(portCode, GPIO_PIN_ALL);
+
+	GPIO_ShadowUnlock(primask);
+}
+
+// *************************************************************
+// * @fn			- GPIO_SetPinModes	                       *
+// * 						                                   *
+// * @brief			- Sets the mode of several pins of a port  *
+// * 				  with one store to MODER				   *
+// * 						                                   *
+// * @param[in]		- GPIOx Peripheral 						   *
+// *                  (Base Address of the GPIO Port)		   *
+// * @param[in]		- Pins to change, see @GPIO_PIN_MASKS      *
+// * @param[in]		- GPIO_MODE_IN, _OUT, _ALTFN or _ANALOG    *
+// * 						                                   *
+// * @return		- @GPIO_STATUS                             *
+// *														   *
+// * @note			- For switching the direction of pins that *
+// * 				  are already configured, e.g. a bus from  *
+// * 				  an ISR. MODER is not read, the other	   *
+// * 				  pins keep their mode.					   *
+// *************************************************************
+uint8_t GPIO_SetPinModes(GPIO_RegDef_t *pGPIOx, uint16_t PinMask, uint8_t Mode)
+{
+	uint32_t portCode = GPIO_BASEADDR_TO_CODE(pGPIOx);
+	uint32_t fields = GPIO_SpreadPinMask(PinMask);
+	uint32_t primask;
+
+	if( (portCode >= GPIO_PORT_COUNT) || (Mode > GPIO_MODE_ANALOG) )
+	{
+		return GPIO_ERR_INVALID_CONFIG;
+	}
+
+	primask = GPIO_ShadowLock();
+	GPIO_WriteConfigReg(&pGPIOx->MODER, &GPIO_GetShadow(pGPIOx, portCode)->MODER, fields * 0x3U, fields * Mode);
+	GPIO_ShadowUnlock(primask);
+
+	return GPIO_OK;
+}
+
+// *************************************************************
+// * @fn			- GPIO_SaveState	                       *
+// * 						                                   *
+// * @brief			- Copies the configuration of a whole port *
+// * 						                                   *
+// * @param[in]		- GPIOx Peripheral 						   *
+// *                  (Base Address of the GPIO Port)		   *
+// * @param[out]	- Configuration registers of the port      *
+// * 						                                   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Copied from the shadow, the port is only *
+// * 				  read if the driver has not used it yet.  *
+// * 				  Output levels (ODR) and EXTI routing are *
+// * 				  not part of the state.				   *
+// *************************************************************
+void GPIO_SaveState(GPIO_RegDef_t *pGPIOx, GPIO_PortState_t *pState)
+{
+	uint32_t portCode = GPIO_BASEADDR_TO_CODE(pGPIOx);
+	uint32_t primask;
+
+	if(portCode >= GPIO_PORT_COUNT)
+	{
+		return; // Not a GPIO port
+	}
+
+	primask = GPIO_ShadowLock();
+	*pState = *GPIO_GetShadow(pGPIOx, portCode);
+	GPIO_ShadowUnlock(primask);
+}
+
+// *************************************************************
+// * @fn			- GPIO_RestoreState	                       *
+// * 						                                   *
+// * @brief			- Writes a configuration saved with		   *
+// * 				  GPIO_SaveState to a whole port		   *
+// * 						                                   *
+// * @param[in]		- GPIOx Peripheral 						   *
+// *                  (Base Address of the GPIO Port)		   *
+// * @param[in]		- Configuration registers of the port      *
+// * 						                                   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Six stores and no reads, for switching   *
+// * 				  between prepared pin setups (e.g. low	   *
+// * 				  power and run) and after a wake-up. Any  *
+// * 				  port can be restored from any state, the *
+// * 				  port clock must be on.				   *
+// *************************************************************
+void GPIO_RestoreState(GPIO_RegDef_t *pGPIOx, const GPIO_PortState_t *pState)
+{
+	uint32_t portCode = GPIO_BASEADDR_TO_CODE(pGPIOx);
+	GPIO_PortState_t *pShadow;
+	uint32_t primask;
+
+	if(portCode >= GPIO_PORT_COUNT)
+	{
+		return; // Not a GPIO port
+	}
+
+	primask = GPIO_ShadowLock();
+
+	pShadow = &Shadow[portCode];
+	*pShadow = *pState;
+	ShadowValid |= (uint16_t)(1U << portCode);
+
+	REG_WRITE(pGPIOx->OSPEEDR, pShadow->OSPEEDR);
+	REG_WRITE(pGPIOx->PUPDR,   pShadow->PUPDR);
+	REG_WRITE(pGPIOx->OTYPER,  pShadow->OTYPER);
+	REG_WRITE(pGPIOx->AFR[0],  pShadow->AFR[0]);
+	REG_WRITE(pGPIOx->AFR[1],  pShadow->AFR[1]);
+	REG_WRITE(pGPIOx->MODER,   pShadow->MODER);
+
+	GPIO_ShadowUnlock(primask);
+}
+
+// *************************************************************
+// * @fn			- GPIO_ResyncState	                       *
+// * 						                                   *
+// * @brief			- Drops the shadow of a port, it is read   *
+// * 				  from the port again on its next use	   *
+// * 						                                   *
+// * @param[in]		- GPIOx Peripheral 						   *
+// *                  (Base Address of the GPIO Port)		   *
+// * 						                                   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Needed only after the configuration	   *
+// * 				  registers were written outside the	   *
+// * 				  driver								   *
+// *************************************************************
+void GPIO_ResyncState(GPIO_RegDef_t *pGPIOx)
+{
+	uint32_t portCode = GPIO_BASEADDR_TO_CODE(pGPIOx);
+	uint32_t primask;
+
+	if(portCode >= GPIO_PORT_COUNT)
+	{
+		return; // Not a GPIO port
+	}
+
+	primask = GPIO_ShadowLock();
+	ShadowValid &= (uint16_t)~(1U << portCode);
+	GPIO_ShadowUnlock(primask);
 }
 
 // Data read and write
@@ -158,7 +605,7 @@ uint8_t GPIO_ReadFromInputPin(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber)
 {
 	uint8_t value;
 
-	value = (uint8_t)( (pGPIOx->IDR >> PinNumber) & 0x00000001 ); // Right shift in the amount of pinnumbers.
+	value = (uint8_t)( (REG_READ(pGPIOx->IDR) >> PinNumber) & 0x00000001 ); // Right shift in the amount of pinnumbers.
 																  // We only care about the least-significant bit
 																  // That's why 0x00000001 is chosen.
 																  // IDR: Input Data Register
@@ -185,7 +632,7 @@ uint16_t GPIO_ReadFromInputPort(GPIO_RegDef_t *pGPIOx) // 16 pins, so we need ui
 {
 	uint16_t value;
 
-	value = (uint16_t)pGPIOx->IDR; // IDR: Input Data Register
+	value = (uint16_t)REG_READ(pGPIOx->IDR); // IDR: Input Data Register
 
 	return value;
 }
@@ -204,20 +651,25 @@ uint16_t GPIO_ReadFromInputPort(GPIO_RegDef_t *pGPIOx) // 16 pins, so we need ui
 // *														   *
 // * @return		- none                                     *	Return type
 // *														   *
-// * @note			- None									   *	Any special note for using this API
+// * @note			- Uses BSRR, so it is a single store and  *	Any special note for using this API
+// *				  safe to call from an ISR				   *
 // *************************************************************
 void GPIO_WriteToOutputPin(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber, uint8_t Value) // Value = 0 or 1, set/reset
 {
+	PROFILER_BEGIN(PROFILER_ID_GPIO_WRITE);
+
 	if(Value == GPIO_PIN_SET)
 	{
-		//Write 1 to the output data register at the corresponding pinnumber
-		pGPIOx->ODR |= (1 << PinNumber); // Output data register
+		// Write 1 to the BSx bit of the pin, ODR bit is set by hardware
+		REG_WRITE(pGPIOx->BSRR, GPIO_BSRR_SET(GPIO_PIN_MASK(PinNumber)));
 	}
 	else
 	{
-		// Else write 0
-		pGPIOx->ODR &= ~(1 << PinNumber); // Clear position of the pin
+		// Write 1 to the BRx bit of the pin, ODR bit is cleared by hardware
+		REG_WRITE(pGPIOx->BSRR, GPIO_BSRR_RESET(GPIO_PIN_MASK(PinNumber)));
 	}
+
+	PROFILER_END(PROFILER_ID_GPIO_WRITE);
 }
 
 // *************************************************************
@@ -237,7 +689,7 @@ void GPIO_WriteToOutputPin(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber, uint8_t Val
 // *************************************************************
 void GPIO_WriteToOutputPort(GPIO_RegDef_t *pGPIOx, uint16_t Value)
 {
-	pGPIOx->ODR = Value; // We simply need to write the value to the Output Data Register
+	REG_WRITE(pGPIOx->ODR, Value); // We simply need to write the value to the Output Data Register
 }
 
 
@@ -254,21 +706,249 @@ void GPIO_WriteToOutputPort(GPIO_RegDef_t *pGPIOx, uint16_t Value)
 // *														   *
 // * @return		- None                                     *	Return type
 // *														   *
-// * @note			- None									   *	Any special note for using this API
+// * @note			- See GPIO_TogglePins					   *	Any special note for using this API
 // *************************************************************
 void GPIO_ToggleOutputPin(GPIO_RegDef_t *pGPIOx, uint8_t PinNumber)
 {
-	//pGPIOx->ODR = pGPIOx->ODR ^ (1 << PinNumber); // ^ is a bitwise or opperation
-	pGPIOx->ODR ^= (1 << PinNumber); // ^ is a bitwise X-OR opperation
+	GPIO_TogglePins(pGPIOx, GPIO_PIN_MASK(PinNumber));
+}
+
+// *************************************************************
+// * @fn			- GPIO_SetPins		                       *
+// * 						                                   *
+// * @brief			- Drives all pins in "PinMask" high		   *
+// * 						                                   *
+// * @param[in]		- GPIOx Peripheral 						   *
+// *                  (Base Address of the GPIO Port)		   *
+// * @param[in]		- Pins to set, see @GPIO_PIN_MASKS         *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Single store to BSRR, ISR safe		   *
+// *************************************************************
+void GPIO_SetPins(GPIO_RegDef_t *pGPIOx, uint16_t PinMask)
+{
+	REG_WRITE(pGPIOx->BSRR, GPIO_BSRR_SET(PinMask));
+}
+
+// *************************************************************
+// * @fn			- GPIO_ResetPins	                       *
+// * 						                                   *
+// * @brief			- Drives all pins in "PinMask" low		   *
+// * 						                                   *
+// * @param[in]		- GPIOx Peripheral 						   *
+// *                  (Base Address of the GPIO Port)		   *
+// * @param[in]		- Pins to reset, see @GPIO_PIN_MASKS       *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Single store to BSRR, ISR safe		   *
+// *************************************************************
+void GPIO_ResetPins(GPIO_RegDef_t *pGPIOx, uint16_t PinMask)
+{
+	REG_WRITE(pGPIOx->BSRR, GPIO_BSRR_RESET(PinMask));
+}
+
+// *************************************************************
+// * @fn			- GPIO_WriteMasked	                       *
+// * 						                                   *
+// * @brief			- Writes "Value" to the pins in "PinMask", *
+// * 				  other pins of the port are not touched   *
+// * 						                                   *
+// * @param[in]		- GPIOx Peripheral 						   *
+// *                  (Base Address of the GPIO Port)		   *
+// * @param[in]		- Pins to write, see @GPIO_PIN_MASKS       *
+// * @param[in]		- Pin levels, one bit per pin			   *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Single store to BSRR, ISR safe		   *
+// *************************************************************
+void GPIO_WriteMasked(GPIO_RegDef_t *pGPIOx, uint16_t PinMask, uint16_t Value)
+{
+	REG_WRITE(pGPIOx->BSRR, GPIO_BSRR_WORD(PinMask, Value));
+}
+
+// *************************************************************
+// * @fn			- GPIO_TogglePins	                       *
+// * 						                                   *
+// * @brief			- Inverts the output level of the pins in  *
+// * 				  "PinMask"								   *
+// * 						                                   *
+// * @param[in]		- GPIOx Peripheral 						   *
+// *                  (Base Address of the GPIO Port)		   *
+// * @param[in]		- Pins to toggle, see @GPIO_PIN_MASKS      *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- One read of ODR and one store to BSRR.   *
+// * 				  Only the pins in PinMask are written, so *
+// *				  an ISR changing other pins of the port   *
+// *				  can not be overwritten.				   *
+// *************************************************************
+void GPIO_TogglePins(GPIO_RegDef_t *pGPIOx, uint16_t PinMask)
+{
+	PROFILER_BEGIN(PROFILER_ID_GPIO_TOGGLE);
+
+	uint32_t odr = REG_READ(pGPIOx->ODR);
+
+	// Pins that are high now go to the reset half, pins that are low go to the set half
+	REG_WRITE(pGPIOx->BSRR, GPIO_BSRR_RESET(odr & PinMask) | GPIO_BSRR_SET(~odr & PinMask));
+
+	PROFILER_END(PROFILER_ID_GPIO_TOGGLE);
 }
 
 // IRQ Configuration and ISR handling
+
+// Callback of each EXTI line, set with GPIO_RegisterEXTICallback
+static GPIO_EXTICallback_t EXTICallbacks[16];
+
+// *************************************************************
+// * @fn			- GPIO_IRQConfig	                       *
+// * 						                                   *
+// * @brief			- Sets the priority of an IRQ and enables  *
+// * 				  or disables it in the NVIC			   *
+// * 						                                   *
+// * @param[in]		- IRQ number, e.g. IRQ_NO_EXTI0		       *
+// * @param[in]		- Priority 0 (highest) - 15 (lowest)       *
+// * @param[in]		- ENABLE or DISABLE macros				   *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- ISER/ICER are write-1-to-set/clear, so   *
+// * 				  enabling and disabling is a single store *
+// * 				  Only the low 4 bits of the priority are  *
+// * 				  used, the fields of the other IRQs in	   *
+// * 				  the IPR register are never changed.	   *
+// *************************************************************
 void GPIO_IRQConfig(uint8_t IRQNumber, uint8_t IRQPriority, uint8_t EnorDi)	//Used to configure the IRQ number of the GPIO pin, like enable, set priority and more...
 {
+	uint8_t iprx = IRQNumber / 4;		// 4 priority fields per IPR register
+	uint8_t section = IRQNumber % 4;
+	uint8_t shift = (8 * section) + (8 - NO_PR_BITS_IMPLEMENTED);	// Only the upper bits of each field exist
+	uint32_t priority = IRQPriority & ((1U << NO_PR_BITS_IMPLEMENTED) - 1);	// Not into the next field
 
+	if(EnorDi == ENABLE)
+	{
+		// Priority first, so the interrupt never runs with the old priority
+		REG_MODIFY(NVIC_IPR[iprx], (0xFFU << (8 * section)), (priority << shift));
+		REG_WRITE(NVIC_ISER[IRQNumber / 32], (1U << (IRQNumber % 32)));
+	}
+	else
+	{
+		REG_WRITE(NVIC_ICER[IRQNumber / 32], (1U << (IRQNumber % 32)));
+	}
 }
 
+// *************************************************************
+// * @fn			- GPIO_IRQHandling	                       *
+// * 						                                   *
+// * @brief			- Clears the pending EXTI line of a pin	   *
+// * 				  and calls its callback				   *
+// * 						                                   *
+// * @param[in]		- Number of the pin (EXTI line)		       *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Nothing is done if the line is not	   *
+// * 				  pending								   *
+// *************************************************************
 void GPIO_IRQHandling(uint8_t PinNumber)
 {
+	GPIO_EXTIDispatch(GPIO_PIN_MASK(PinNumber));
+}
 
+// *************************************************************
+// * @fn			- GPIO_PinToIRQNumber	                   *
+// * 						                                   *
+// * @brief			- Returns the IRQ number that serves the   *
+// * 				  EXTI line of a pin					   *
+// * 						                                   *
+// * @param[in]		- Number of the pin (EXTI line)		       *
+// *														   *
+// * @return		- IRQ_NO_EXTIx                             *
+// *														   *
+// * @note			- Lines 5-9 and 10-15 share one IRQ		   *
+// *************************************************************
+uint8_t GPIO_PinToIRQNumber(uint8_t PinNumber)
+{
+	static const uint8_t irqNumbers[16] =
+	{
+		IRQ_NO_EXTI0, IRQ_NO_EXTI1, IRQ_NO_EXTI2, IRQ_NO_EXTI3, IRQ_NO_EXTI4,
+		IRQ_NO_EXTI9_5, IRQ_NO_EXTI9_5, IRQ_NO_EXTI9_5, IRQ_NO_EXTI9_5, IRQ_NO_EXTI9_5,
+		IRQ_NO_EXTI15_10, IRQ_NO_EXTI15_10, IRQ_NO_EXTI15_10, IRQ_NO_EXTI15_10, IRQ_NO_EXTI15_10, IRQ_NO_EXTI15_10
+	};
+
+	return irqNumbers[PinNumber & 0xF];
 }
+
+// *************************************************************
+// * @fn			- GPIO_RegisterEXTICallback                *
+// * 						                                   *
+// * @brief			- Sets the function called when the EXTI   *
+// * 				  line of a pin fires					   *
+// * 						                                   *
+// * @param[in]		- Number of the pin (EXTI line)		       *
+// * @param[in]		- Callback, NULL to remove it		       *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- The callback runs in interrupt context   *
+// *************************************************************
+void GPIO_RegisterEXTICallback(uint8_t PinNumber, GPIO_EXTICallback_t pCallback)
+{
+	EXTICallbacks[PinNumber & 0xF] = pCallback;
+}
+
+// *************************************************************
+// * @fn			- GPIO_EXTIDispatch		                   *
+// * 						                                   *
+// * @brief			- Clears all pending EXTI lines in		   *
+// * 				  LineMask and calls their callbacks	   *
+// * 						                                   *
+// * @param[in]		- EXTI lines served by the calling IRQ     *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- One read and one write of EXTI_PR, then  *
+// * 				  the pending lines are found with CLZ, so *
+// * 				  the cost depends on the number of lines  *
+// * 				  that fired, not on the lines scanned.	   *
+// * 				  Higher lines are served first.		   *
+// *************************************************************
+void GPIO_EXTIDispatch(uint32_t LineMask)
+{
+	PROFILER_BEGIN(PROFILER_ID_EXTI_DISPATCH);
+
+	uint32_t pending = REG_READ(EXTI->PR) & LineMask;
+
+	// Clear all served lines with one store (write 1 to clear), an edge that comes
+	// while the callbacks run sets the line again and re-enters the handler
+	if(pending != 0)
+	{
+		REG_WRITE(EXTI->PR, pending);
+	}
+
+	while(pending != 0)
+	{
+		uint8_t line = 31 - __CLZ(pending);
+
+		pending &= ~(1U << line);
+		if(EXTICallbacks[line] != NULL)
+		{
+			EXTICallbacks[line](line);
+		}
+	}
+
+	PROFILER_END(PROFILER_ID_EXTI_DISPATCH);
+}
+
+// EXTI interrupt handlers. Weak, so the application can still write its own handler
+// and call GPIO_IRQHandling from it.
+__weak void EXTI0_IRQHandler(void)		{ GPIO_EXTIDispatch(GPIO_PIN_0); }
+__weak void EXTI1_IRQHandler(void)		{ GPIO_EXTIDispatch(GPIO_PIN_1); }
+__weak void EXTI2_IRQHandler(void)		{ GPIO_EXTIDispatch(GPIO_PIN_2); }
+__weak void EXTI3_IRQHandler(void)		{ GPIO_EXTIDispatch(GPIO_PIN_3); }
+__weak void EXTI4_IRQHandler(void)		{ GPIO_EXTIDispatch(GPIO_PIN_4); }
+__weak void EXTI9_5_IRQHandler(void)	{ GPIO_EXTIDispatch(GPIO_PIN_5 | GPIO_PIN_6 | GPIO_PIN_7 | GPIO_PIN_8 | GPIO_PIN_9); }
+__weak void EXTI15_10_IRQHandler(void)	{ GPIO_EXTIDispatch(GPIO_PIN_10 | GPIO_PIN_11 | GPIO_PIN_12 | GPIO_PIN_13 | GPIO_PIN_14 | GPIO_PIN_15); }
@@ -0,0 +1,610 @@
+/*
+ * stm32f407xx_i2c_driver.c
+ *
+ *  Created on: Jan 22, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_i2c_driver.h"
+
+#define I2C_COUNT				3
+
+// Per I2C data: DMA RX request (ch. 10.3.3, table 42), IRQ numbers and RCC bit (APB1).
+// I2C2 RX uses stream 3 so stream 2 is left to I2C3 RX, which has no other. The streams that
+// are still shared, only one of the drivers can use them (I2C_Init returns I2C_ERR_BUSY to
+// the second one):
+//	- I2C1 RX, DMA1 stream 0: SPI3 RX, UART5 RX (stream 5, the other one, is USART2 RX)
+//	- I2C2 RX, DMA1 stream 3: SPI2 RX, USART3 TX
+//	- I2C3 RX, DMA1 stream 2: UART4 RX
+typedef struct
+{
+	I2C_RegDef_t *pI2Cx;
+	uint8_t RxStream;			// On DMA1
+	uint8_t Channel;
+	uint8_t IRQNumberEV;
+	uint8_t IRQNumberER;
+	uint8_t RCCBit;
+}I2C_Info_t;
+
+static const I2C_Info_t Info[I2C_COUNT] =
+{
+	{ I2C1, 0, 1, IRQ_NO_I2C1_EV, IRQ_NO_I2C1_ER, 21 },
+	{ I2C2, 3, 7, IRQ_NO_I2C2_EV, IRQ_NO_I2C2_ER, 22 },
+	{ I2C3, 2, 3, IRQ_NO_I2C3_EV, IRQ_NO_I2C3_ER, 23 },
+};
+
+// Handles given to I2C_Init, used by the IRQ handlers
+static I2C_Handle_t *Handles[I2C_COUNT];
+
+static void I2C_DMARxHandler(void *pArg, uint8_t Flags);
+
+static uint8_t I2C_Index(I2C_RegDef_t *pI2Cx)
+{
+	if(pI2Cx == I2C1)		{ return 0; }
+	else if(pI2Cx == I2C2)	{ return 1; }
+	else					{ return 2; }
+}
+
+static uint8_t I2C_ClockId(I2C_RegDef_t *pI2Cx)
+{
+	if(pI2Cx == I2C1)		{ return RCC_CLK_I2C1; }
+	else if(pI2Cx == I2C2)	{ return RCC_CLK_I2C2; }
+	else					{ return RCC_CLK_I2C3; }
+}
+
+// *************************************************************
+// * @fn			- I2C_PeriClockControl	                   *
+// * 						                                   *
+// * @brief			- Enables or disables peripheral clock for *
+// * 				  the given I2C							   *
+// * 						                                   *
+// * @param[in]		- I2C1, I2C2 or I2C3					   *
+// * @param[in]		- ENABLE or DISABLE macros	               *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Counted per user. Gated in Sleep mode	   *
+// * 				  unless a transaction is queued.		   *
+// *************************************************************
+void I2C_PeriClockControl(I2C_RegDef_t *pI2Cx, uint8_t EnorDi)
+{
+	if( (pI2Cx != I2C1) && (pI2Cx != I2C2) && (pI2Cx != I2C3) )
+	{
+		return;
+	}
+
+	if(EnorDi == ENABLE)
+	{
+		RCC_PeriphClockEnable(I2C_ClockId(pI2Cx), RCC_CLK_RUN_ONLY);
+	}
+	else
+	{
+		RCC_PeriphClockDisable(I2C_ClockId(pI2Cx), RCC_CLK_RUN_ONLY);
+	}
+}
+
+// The I2C, and the DMA controller if the I2C has its stream, keep their clocks in Sleep mode
+// while transactions are queued
+static void I2C_SleepClockControl(I2C_Handle_t *pI2CHandle, uint8_t EnorDi)
+{
+	RCC_PeriphSleepControl(I2C_ClockId(pI2CHandle->pI2Cx), EnorDi);
+	if(pI2CHandle->pDMAx != NULL)
+	{
+		DMA_SleepClockControl(pI2CHandle->pDMAx, EnorDi);
+	}
+}
+
+// *************************************************************
+// * @fn			- I2C_Init				                   *
+// * 						                                   *
+// * @brief			- Sets the SCL timing from the APB1 clock, *
+// * 				  enables the I2C and its interrupts	   *
+// * 						                                   *
+// * @param[in]		- Handle with pI2Cx, I2CConfig,			   *
+// * 				  IRQPriority and DMAMinLen filled in	   *
+// * 						                                   *
+// * @return		- I2C_OK, or I2C_ERR_BUSY if DMAMinLen is  *
+// * 				  set and the DMA stream is used by		   *
+// * 				  another driver						   *
+// *														   *
+// * @note			- ch. 27.6.8 and 27.6.9. CCR is rounded up,*
+// * 				  so SCL is never faster than asked for.   *
+// * 				  PCLK1 must be 2 MHz or more (4 MHz for   *
+// * 				  Fast mode). Call again after a clock	   *
+// * 				  change, it starts with I2C_DeInit.	   *
+// * 				  Without the DMA stream all reads are	   *
+// * 				  done by interrupt.					   *
+// *************************************************************
+uint8_t I2C_Init(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+	const I2C_Info_t *pInfo = &Info[I2C_Index(pI2Cx)];
+	uint32_t pclk1 = RCC_GetPCLK1Freq();
+	uint32_t speed = pI2CHandle->I2CConfig.I2C_SCLSpeed;
+	uint32_t freq = pclk1 / 1000000U;
+	uint32_t ccr, div, trise;
+
+	// Init again: the clocks and the stream of the first Init are given back first
+	if(Handles[I2C_Index(pI2Cx)] != NULL)
+	{
+		I2C_DeInit(pI2Cx);
+	}
+	I2C_PeriClockControl(pI2Cx, ENABLE);
+
+	// Timing can only be changed with the peripheral disabled
+	REG_CLR_BITS(pI2Cx->CR1, (1U << I2C_CR1_PE));
+	REG_WRITE(pI2Cx->CR2, (freq & 0x3F) << I2C_CR2_FREQ);
+
+	if(speed <= I2C_SCL_SPEED_SM)
+	{
+		// T_high = T_low = CCR * T_pclk1
+		div = 2 * speed;
+		ccr = (pclk1 + div - 1) / div;
+		if(ccr < 4)
+		{
+			ccr = 4;
+		}
+		trise = freq + 1;					// 1000 ns maximum rise time
+	}
+	else
+	{
+		// T_low/T_high = 2 (CCR * 3 periods) or 16/9 (CCR * 25 periods)
+		div = (pI2CHandle->I2CConfig.I2C_FMDutyCycle == I2C_FM_DUTY_16_9) ? 25 * speed : 3 * speed;
+		ccr = (pclk1 + div - 1) / div;
+		if(ccr < 1)
+		{
+			ccr = 1;
+		}
+		ccr |= (1U << I2C_CCR_FS) | ((uint32_t)pI2CHandle->I2CConfig.I2C_FMDutyCycle << I2C_CCR_DUTY);
+		trise = (freq * 300) / 1000 + 1;	// 300 ns maximum rise time
+	}
+
+	REG_WRITE(pI2Cx->CCR, ccr);
+	REG_WRITE(pI2Cx->TRISE, trise & 0x3F);
+
+	pI2CHandle->RxStream = pInfo->RxStream;
+	pI2CHandle->DMAChannel = pInfo->Channel;
+	pI2CHandle->pHead = NULL;
+	pI2CHandle->pTail = NULL;
+	Handles[I2C_Index(pI2Cx)] = pI2CHandle;
+
+	GPIO_IRQConfig(pInfo->IRQNumberEV, pI2CHandle->IRQPriority, ENABLE);
+	GPIO_IRQConfig(pInfo->IRQNumberER, pI2CHandle->IRQPriority, ENABLE);
+	REG_SET_BITS(pI2Cx->CR1, (1U << I2C_CR1_PE));
+
+	// pDMAx stays NULL without the stream, the reads are then done by interrupt
+	pI2CHandle->pDMAx = NULL;
+	if(pI2CHandle->DMAMinLen == 0)
+	{
+		return I2C_OK;
+	}
+	if(DMA_RegisterCallback(DMA1, pInfo->RxStream, I2C_DMARxHandler, pI2CHandle) != DMA_OK)
+	{
+		return I2C_ERR_BUSY;
+	}
+	pI2CHandle->pDMAx = DMA1;
+
+	DMA_PeriClockControl(DMA1, ENABLE);
+	GPIO_IRQConfig(DMA_GetIRQNumber(DMA1, pInfo->RxStream), pI2CHandle->IRQPriority, ENABLE);
+
+	return I2C_OK;
+}
+
+// *************************************************************
+// * @fn			- I2C_DeInit			                   *
+// * 						                                   *
+// * @brief			- Resets all registers of the I2C		   *
+// * 						                                   *
+// * @param[in]		- I2C1, I2C2 or I2C3					   *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Through RCC APB1RSTR (ch. 7.3.7). The	   *
+// * 				  DMA stream and the clocks taken by	   *
+// * 				  I2C_Init are given back. Queued		   *
+// * 				  transactions are dropped.				   *
+// *************************************************************
+void I2C_DeInit(I2C_RegDef_t *pI2Cx)
+{
+	I2C_Handle_t *pI2CHandle = Handles[I2C_Index(pI2Cx)];
+	uint32_t bit = Info[I2C_Index(pI2Cx)].RCCBit;
+
+	if( (pI2CHandle != NULL) && (pI2CHandle->pHead != NULL) )
+	{
+		if(pI2CHandle->pDMAx != NULL)
+		{
+			DMA_StreamDisable(pI2CHandle->pDMAx, pI2CHandle->RxStream);
+		}
+		pI2CHandle->pHead = NULL;
+		pI2CHandle->pTail = NULL;
+		I2C_SleepClockControl(pI2CHandle, DISABLE);
+	}
+	if( (pI2CHandle != NULL) && (pI2CHandle->pDMAx != NULL) )
+	{
+		(void)DMA_RegisterCallback(pI2CHandle->pDMAx, pI2CHandle->RxStream, NULL, NULL);
+		DMA_PeriClockControl(pI2CHandle->pDMAx, DISABLE);
+		pI2CHandle->pDMAx = NULL;
+	}
+
+	REG_BB_SET(RCC->APB1RSTR, bit);
+	REG_BB_CLR(RCC->APB1RSTR, bit);
+
+	if(pI2CHandle != NULL)
+	{
+		I2C_PeriClockControl(pI2Cx, DISABLE);
+		Handles[I2C_Index(pI2Cx)] = NULL;
+	}
+}
+
+// Starts the transaction at the head of the queue with a start condition
+static void I2C_StartTxn(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+	I2C_Transaction_t *pTxn = pI2CHandle->pHead;
+
+	pTxn->Status = I2C_TXN_ACTIVE;
+	pI2CHandle->pTxBuffer = pTxn->pTxBuffer;
+	pI2CHandle->TxLen = pTxn->TxLen;
+	pI2CHandle->pRxBuffer = pTxn->pRxBuffer;
+	pI2CHandle->RxLen = pTxn->RxLen;
+	pI2CHandle->Phase = (pTxn->TxLen != 0) ? I2C_PHASE_WRITE : I2C_PHASE_READ;
+
+	// CR1 must not be written while the STOP of the last transaction is pending (ch. 27.6.1).
+	// It is sent within one SCL period.
+	while(REG_READ(pI2Cx->CR1) & (1U << I2C_CR1_STOP));
+
+	REG_SET_BITS(pI2Cx->CR2, (1U << I2C_CR2_ITEVTEN) | (1U << I2C_CR2_ITERREN) | (1U << I2C_CR2_ITBUFEN));
+	REG_SET_BITS(pI2Cx->CR1, (1U << I2C_CR1_ACK) | (1U << I2C_CR1_START));
+}
+
+// Ends the transaction at the head of the queue and starts the next one. Interrupt context.
+static void I2C_CompleteTxn(I2C_Handle_t *pI2CHandle, uint8_t Status)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+	I2C_Transaction_t *pTxn = pI2CHandle->pHead;
+	I2C_Transaction_t *pNext = pTxn->pNext;
+
+	REG_CLR_BITS(pI2Cx->CR2, (1U << I2C_CR2_ITEVTEN) | (1U << I2C_CR2_ITERREN) | (1U << I2C_CR2_ITBUFEN) |
+			(1U << I2C_CR2_DMAEN) | (1U << I2C_CR2_LAST));
+	REG_CLR_BITS(pI2Cx->CR1, (1U << I2C_CR1_POS));
+
+	// The queue is updated before the callback, so the callback may submit again
+	pI2CHandle->pHead = pNext;
+	if(pNext == NULL)
+	{
+		pI2CHandle->pTail = NULL;
+		I2C_SleepClockControl(pI2CHandle, DISABLE);
+	}
+
+	pTxn->Status = Status;
+	if(pTxn->pCallback != NULL)
+	{
+		pTxn->pCallback(pTxn, pTxn->pArg);
+	}
+
+	if(pNext != NULL)
+	{
+		I2C_StartTxn(pI2CHandle);
+	}
+}
+
+static inline void I2C_ReadByte(I2C_Handle_t *pI2CHandle)
+{
+	*pI2CHandle->pRxBuffer++ = (uint8_t)REG_READ(pI2CHandle->pI2Cx->DR);
+	pI2CHandle->RxLen--;
+}
+
+// Receive of a read by DMA, the I2C NACKs the last byte by itself (LAST)
+static void I2C_StartDMARx(I2C_Handle_t *pI2CHandle)
+{
+	DMA_StreamConfig_t dma = { 0 };
+
+	dma.Channel = pI2CHandle->DMAChannel;
+	dma.Direction = DMA_DIR_P2M;
+	dma.PeriphSize = DMA_SIZE_BYTE;
+	dma.MemSize = DMA_SIZE_BYTE;
+	dma.MemInc = ENABLE;
+	dma.Priority = DMA_PRIORITY_MEDIUM;
+	dma.Interrupts = DMA_FLAG_TC | DMA_FLAG_TE;
+	DMA_StreamInit(pI2CHandle->pDMAx, pI2CHandle->RxStream, &dma);
+	DMA_StreamSetAddress(pI2CHandle->pDMAx, pI2CHandle->RxStream, &pI2CHandle->pI2Cx->DR,
+			pI2CHandle->pRxBuffer, NULL, pI2CHandle->RxLen);
+	DMA_StreamEnable(pI2CHandle->pDMAx, pI2CHandle->RxStream);
+
+	REG_MODIFY(pI2CHandle->pI2Cx->CR2, (1U << I2C_CR2_ITBUFEN), (1U << I2C_CR2_DMAEN) | (1U << I2C_CR2_LAST));
+}
+
+// Address sent and acknowledged. The ACK/POS/STOP settings for short reads must be in place
+// before ADDR is cleared (ch. 27.3.3, "Master receiver").
+static void I2C_HandleADDR(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+	uint16_t len = pI2CHandle->RxLen;
+
+	if(pI2CHandle->Phase == I2C_PHASE_WRITE)
+	{
+		(void)REG_READ(pI2Cx->SR2);
+	}
+	else if( (pI2CHandle->pDMAx != NULL) && (len >= pI2CHandle->DMAMinLen) && (len >= 2) )
+	{
+		I2C_StartDMARx(pI2CHandle);
+		(void)REG_READ(pI2Cx->SR2);
+	}
+	else if(len == 1)
+	{
+		REG_CLR_BITS(pI2Cx->CR1, (1U << I2C_CR1_ACK));
+		(void)REG_READ(pI2Cx->SR2);
+		REG_SET_BITS(pI2Cx->CR1, (1U << I2C_CR1_STOP));
+	}
+	else if(len == 2)
+	{
+		// NACK goes with the second byte, both are read at BTF
+		REG_MODIFY(pI2Cx->CR1, (1U << I2C_CR1_ACK), (1U << I2C_CR1_POS));
+		(void)REG_READ(pI2Cx->SR2);
+		REG_CLR_BITS(pI2Cx->CR2, (1U << I2C_CR2_ITBUFEN));
+	}
+	else
+	{
+		(void)REG_READ(pI2Cx->SR2);
+	}
+}
+
+// Byte transfer finished with the data register empty (write) or full (read)
+static void I2C_HandleBTF(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+
+	if(pI2CHandle->Phase == I2C_PHASE_WRITE)
+	{
+		if(pI2CHandle->TxLen != 0)
+		{
+			REG_WRITE(pI2Cx->DR, *pI2CHandle->pTxBuffer++);
+			pI2CHandle->TxLen--;
+		}
+		else if(pI2CHandle->RxLen != 0)
+		{
+			// Write then read: repeated start, the read address follows at SB
+			pI2CHandle->Phase = I2C_PHASE_READ;
+			REG_SET_BITS(pI2Cx->CR2, (1U << I2C_CR2_ITBUFEN));
+			REG_SET_BITS(pI2Cx->CR1, (1U << I2C_CR1_START));
+		}
+		else
+		{
+			REG_SET_BITS(pI2Cx->CR1, (1U << I2C_CR1_STOP));
+			I2C_CompleteTxn(pI2CHandle, I2C_TXN_DONE);
+		}
+	}
+	else if(pI2CHandle->RxLen > 3)
+	{
+		I2C_ReadByte(pI2CHandle);
+	}
+	else if(pI2CHandle->RxLen == 3)
+	{
+		// Byte N-2 in DR, N-1 in the shift register: NACK byte N
+		REG_CLR_BITS(pI2Cx->CR1, (1U << I2C_CR1_ACK));
+		I2C_ReadByte(pI2CHandle);
+	}
+	else if(pI2CHandle->RxLen == 2)
+	{
+		REG_SET_BITS(pI2Cx->CR1, (1U << I2C_CR1_STOP));
+		I2C_ReadByte(pI2CHandle);
+		I2C_ReadByte(pI2CHandle);
+		I2C_CompleteTxn(pI2CHandle, I2C_TXN_DONE);
+	}
+}
+
+// *************************************************************
+// * @fn			- I2C_EV_IRQHandling	                   *
+// * 						                                   *
+// * @brief			- Event interrupt, runs the state machine  *
+// * 				  of the transaction in progress		   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- SB and ADDR are cleared by the SR1 read  *
+// * 				  here followed by a DR write or SR2 read  *
+// *************************************************************
+void I2C_EV_IRQHandling(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+	uint32_t sr1 = REG_READ(pI2Cx->SR1);
+
+	if(pI2CHandle->pHead == NULL)
+	{
+		return;
+	}
+
+	if(sr1 & (1U << I2C_SR1_SB))
+	{
+		REG_WRITE(pI2Cx->DR, ((uint32_t)pI2CHandle->pHead->Address << 1) | pI2CHandle->Phase);
+	}
+	else if(sr1 & (1U << I2C_SR1_ADDR))
+	{
+		I2C_HandleADDR(pI2CHandle);
+	}
+	else if(sr1 & (1U << I2C_SR1_BTF))
+	{
+		I2C_HandleBTF(pI2CHandle);
+	}
+	else if( (sr1 & (1U << I2C_SR1_RXNE)) && (pI2CHandle->Phase == I2C_PHASE_READ) )
+	{
+		if(pI2CHandle->RxLen > 3)
+		{
+			I2C_ReadByte(pI2CHandle);
+		}
+		else if(pI2CHandle->RxLen == 1)
+		{
+			// Single byte read, STOP was set at ADDR
+			I2C_ReadByte(pI2CHandle);
+			I2C_CompleteTxn(pI2CHandle, I2C_TXN_DONE);
+		}
+		else
+		{
+			// Last three bytes are read at BTF
+			REG_CLR_BITS(pI2Cx->CR2, (1U << I2C_CR2_ITBUFEN));
+		}
+	}
+	else if( (sr1 & (1U << I2C_SR1_TXE)) && (pI2CHandle->Phase == I2C_PHASE_WRITE) )
+	{
+		if(pI2CHandle->TxLen != 0)
+		{
+			REG_WRITE(pI2Cx->DR, *pI2CHandle->pTxBuffer++);
+			pI2CHandle->TxLen--;
+		}
+		else
+		{
+			// All bytes written, the end is at BTF
+			REG_CLR_BITS(pI2Cx->CR2, (1U << I2C_CR2_ITBUFEN));
+		}
+	}
+}
+
+// *************************************************************
+// * @fn			- I2C_ER_IRQHandling	                   *
+// * 						                                   *
+// * @brief			- Error interrupt, ends the transaction	   *
+// * 				  in progress with an error				   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- A NACK is answered with a STOP. After	   *
+// * 				  arbitration lost the bus belongs to the  *
+// * 				  other master, so no STOP is sent.		   *
+// *************************************************************
+void I2C_ER_IRQHandling(I2C_Handle_t *pI2CHandle)
+{
+	I2C_RegDef_t *pI2Cx = pI2CHandle->pI2Cx;
+	uint32_t sr1 = REG_READ(pI2Cx->SR1);
+	uint32_t errors = sr1 & ((1U << I2C_SR1_BERR) | (1U << I2C_SR1_ARLO) | (1U << I2C_SR1_AF) |
+			(1U << I2C_SR1_OVR) | (1U << I2C_SR1_TIMEOUT));
+
+	if(errors == 0)
+	{
+		return;
+	}
+
+	// The error flags are cleared by writing 0 to them
+	REG_WRITE(pI2Cx->SR1, sr1 & ~errors);
+
+	if(pI2CHandle->pHead == NULL)
+	{
+		return;
+	}
+
+	if( !(errors & (1U << I2C_SR1_ARLO)) )
+	{
+		REG_SET_BITS(pI2Cx->CR1, (1U << I2C_CR1_STOP));
+	}
+	if(REG_READ(pI2Cx->CR2) & (1U << I2C_CR2_DMAEN))
+	{
+		DMA_StreamDisable(pI2CHandle->pDMAx, pI2CHandle->RxStream);
+	}
+
+	I2C_CompleteTxn(pI2CHandle, (errors & (1U << I2C_SR1_AF)) ? I2C_TXN_ERROR_NACK : I2C_TXN_ERROR_BUS);
+}
+
+// DMA RX stream interrupt: all bytes of a DMA read are in the buffer
+static void I2C_DMARxHandler(void *pArg, uint8_t Flags)
+{
+	I2C_Handle_t *pI2CHandle = (I2C_Handle_t*)pArg;
+
+	if( (pI2CHandle->pHead == NULL) || !(Flags & (DMA_FLAG_TC | DMA_FLAG_TE)) )
+	{
+		return;
+	}
+
+	REG_SET_BITS(pI2CHandle->pI2Cx->CR1, (1U << I2C_CR1_STOP));
+	pI2CHandle->RxLen = 0;
+	I2C_CompleteTxn(pI2CHandle, (Flags & DMA_FLAG_TE) ? I2C_TXN_ERROR_BUS : I2C_TXN_DONE);
+}
+
+// *************************************************************
+// * @fn			- I2C_Submit			                   *
+// * 						                                   *
+// * @brief			- Queues a transaction					   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * @param[in]		- Transaction, owned by the caller         *
+// * 						                                   *
+// * @return		- I2C_OK or I2C_ERR_PARAM                  *
+// *														   *
+// * @note			- Returns at once. May be called from a	   *
+// * 				  transaction callback.					   *
+// *************************************************************
+uint8_t I2C_Submit(I2C_Handle_t *pI2CHandle, I2C_Transaction_t *pTxn)
+{
+	uint32_t primask;
+	uint8_t start;
+
+	if( ((pTxn->TxLen == 0) && (pTxn->RxLen == 0)) || (pTxn->Address > 0x7F) )
+	{
+		return I2C_ERR_PARAM;
+	}
+
+	pTxn->pNext = NULL;
+	pTxn->Status = I2C_TXN_QUEUED;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	start = (pI2CHandle->pHead == NULL);
+	if(start)
+	{
+		pI2CHandle->pHead = pTxn;
+	}
+	else
+	{
+		pI2CHandle->pTail->pNext = pTxn;
+	}
+	pI2CHandle->pTail = pTxn;
+
+	__set_PRIMASK(primask);
+
+	if(start)
+	{
+		I2C_SleepClockControl(pI2CHandle, ENABLE);
+		I2C_StartTxn(pI2CHandle);
+	}
+
+	return I2C_OK;
+}
+
+uint8_t I2C_IsIdle(I2C_Handle_t *pI2CHandle)
+{
+	return (pI2CHandle->pHead == NULL);
+}
+
+// I2C interrupt handlers. Weak, so the application can write its own.
+__weak void I2C1_EV_IRQHandler(void)
+{
+	if(Handles[0] != NULL) { I2C_EV_IRQHandling(Handles[0]); }
+}
+
+__weak void I2C1_ER_IRQHandler(void)
+{
+	if(Handles[0] != NULL) { I2C_ER_IRQHandling(Handles[0]); }
+}
+
+__weak void I2C2_EV_IRQHandler(void)
+{
+	if(Handles[1] != NULL) { I2C_EV_IRQHandling(Handles[1]); }
+}
+
+__weak void I2C2_ER_IRQHandler(void)
+{
+	if(Handles[1] != NULL) { I2C_ER_IRQHandling(Handles[1]); }
+}
+
+__weak void I2C3_EV_IRQHandler(void)
+{
+	if(Handles[2] != NULL) { I2C_EV_IRQHandling(Handles[2]); }
+}
+
+__weak void I2C3_ER_IRQHandler(void)
+{
+	if(Handles[2] != NULL) { I2C_ER_IRQHandling(Handles[2]); }
+}
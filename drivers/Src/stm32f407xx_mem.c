@@ -0,0 +1,135 @@
+/*
+ * stm32f407xx_mem.c
+ *
+ *  Created on: Dec 18, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_mem.h"
+
+// Word copy and fill, used before .data and .bss exist, so they may only use locals.
+// Eight words per pass, one LDM/STM of eight registers each (9 cycles for 8 words) and the
+// loop overhead is small for the large sections.
+void MEM_CopyWords(uint32_t *pDst, const uint32_t *pSrc, uint32_t Words)
+{
+	while(Words >= 8)
+	{
+		uint32_t w0 = pSrc[0], w1 = pSrc[1], w2 = pSrc[2], w3 = pSrc[3];
+		uint32_t w4 = pSrc[4], w5 = pSrc[5], w6 = pSrc[6], w7 = pSrc[7];
+
+		pDst[0] = w0; pDst[1] = w1; pDst[2] = w2; pDst[3] = w3;
+		pDst[4] = w4; pDst[5] = w5; pDst[6] = w6; pDst[7] = w7;
+		pDst += 8;
+		pSrc += 8;
+		Words -= 8;
+	}
+	while(Words-- != 0)
+	{
+		*pDst++ = *pSrc++;
+	}
+}
+
+void MEM_ZeroWords(uint32_t *pDst, uint32_t Words)
+{
+	while(Words >= 8)
+	{
+		pDst[0] = 0; pDst[1] = 0; pDst[2] = 0; pDst[3] = 0;
+		pDst[4] = 0; pDst[5] = 0; pDst[6] = 0; pDst[7] = 0;
+		pDst += 8;
+		Words -= 8;
+	}
+	while(Words-- != 0)
+	{
+		*pDst++ = 0;
+	}
+}
+
+#ifndef STM32F407XX_SIM
+
+// Section limits from the linker script
+extern uint32_t _sidata, _sdata, _edata;
+extern uint32_t _sbss, _ebss;
+extern uint32_t _siccmram, _sccmram, _eccmram;
+extern uint32_t _sccmbss, _eccmbss;
+
+// .data copy by DMA2 stream 0, memory-to-memory (the flash is the "peripheral" side). Only
+// registers are used, the DMA driver keeps its state in .bss. The RCC_PeriphClockEnable
+// counts are in .bss too, so the clock bit is set and cleared directly.
+#define MEM_DMA_STREAM			0
+
+static void MEM_DMAStart(uint32_t *pDst, const uint32_t *pSrc, uint32_t Words)
+{
+	DMA_Stream_RegDef_t *pStream = &DMA2->S[MEM_DMA_STREAM];
+
+	REG_BB_SET(RCC->AHB1ENR, RCC_CLK_BIT(RCC_CLK_DMA2));
+
+	REG_WRITE(DMA2->LIFCR, DMA_FLAG_ALL);
+	REG_WRITE(pStream->PAR, (uint32_t)(uintptr_t)pSrc);
+	REG_WRITE(pStream->M0AR, (uint32_t)(uintptr_t)pDst);
+	REG_WRITE(pStream->NDTR, Words);
+	REG_WRITE(pStream->FCR, (1U << 2) | 0x3U);		// FIFO (needed for memory-to-memory), full threshold
+	REG_WRITE(pStream->CR, ((uint32_t)DMA_DIR_M2M << DMA_SxCR_DIR_POS) | DMA_SxCR_PINC | DMA_SxCR_MINC |
+						   ((uint32_t)DMA_SIZE_WORD << DMA_SxCR_PSIZE_POS) | ((uint32_t)DMA_SIZE_WORD << DMA_SxCR_MSIZE_POS) |
+						   ((uint32_t)DMA_PRIORITY_VERY_HIGH << DMA_SxCR_PL_POS) | DMA_SxCR_EN);
+}
+
+// Waits for the copy, on a transfer error the CPU copies it again
+static void MEM_DMAWait(uint32_t *pDst, const uint32_t *pSrc, uint32_t Words)
+{
+	uint32_t flags;
+
+	do
+	{
+		flags = REG_READ(DMA2->LISR);
+	}while( !(flags & (DMA_FLAG_TC | DMA_FLAG_TE)) );
+
+	REG_WRITE(DMA2->S[MEM_DMA_STREAM].CR, 0);
+	REG_WRITE(DMA2->LIFCR, DMA_FLAG_ALL);
+	REG_BB_CLR(RCC->AHB1ENR, RCC_CLK_BIT(RCC_CLK_DMA2));
+
+	if(flags & DMA_FLAG_TE)
+	{
+		MEM_CopyWords(pDst, pSrc, Words);
+	}
+}
+
+// *************************************************************
+// * @fn			- MEM_InitSections		                   *
+// * 						                                   *
+// * @brief			- Copies the initialized sections from	   *
+// * 				  flash and zeroes the bss sections		   *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- SRAM: .data (with the __RAMFUNC code)	   *
+// * 				  and .bss, CCM RAM: .ccmram and .ccmbss.  *
+// * 				  A .data of MEM_DMA_MIN_WORDS or more is  *
+// * 				  copied by DMA2 while the CPU does the	   *
+// * 				  other sections. The CCM RAM is on the	   *
+// * 				  D-bus, so those run with no bus sharing. *
+// *************************************************************
+void MEM_InitSections(void)
+{
+	uint32_t dataWords = (uint32_t)(&_edata - &_sdata);
+	uint8_t dmaCopy = (MEM_DMA_MIN_WORDS != 0) && (dataWords >= MEM_DMA_MIN_WORDS) && (dataWords <= 0xFFFFU);
+
+	if(dmaCopy)
+	{
+		MEM_DMAStart(&_sdata, &_sidata, dataWords);
+	}
+	else
+	{
+		MEM_CopyWords(&_sdata, &_sidata, dataWords);
+	}
+
+	MEM_CopyWords(&_sccmram, &_siccmram, (uint32_t)(&_eccmram - &_sccmram));
+	MEM_ZeroWords(&_sccmbss, (uint32_t)(&_eccmbss - &_sccmbss));
+	MEM_ZeroWords(&_sbss, (uint32_t)(&_ebss - &_sbss));
+
+	if(dmaCopy)
+	{
+		MEM_DMAWait(&_sdata, &_sidata, dataWords);
+	}
+}
+
+#endif /* STM32F407XX_SIM */
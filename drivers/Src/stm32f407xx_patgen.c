@@ -0,0 +1,290 @@
+/*
+ * stm32f407xx_patgen.c
+ *
+ *  Created on: Nov 27, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_patgen.h"
+
+#define PATGEN_DMA				DMA2
+
+// Transfer complete of the DMA stream, runs in the DMA interrupt
+static void PATGEN_DMAHandler(void *pArg, uint8_t Flags)
+{
+	PATGEN_Handle_t *pHandle = (PATGEN_Handle_t*)pArg;
+	uint8_t playing, done;
+
+	if( !(Flags & DMA_FLAG_TC) )
+	{
+		return;
+	}
+
+	// The DMA has already switched CT to the other buffer, the one that is not the target is done
+	playing = DMA_GetCurrentTarget(PATGEN_DMA, pHandle->Stream);
+	done = playing ^ 1;
+
+	pHandle->Played++;
+	if(!pHandle->Ready[playing])
+	{
+		pHandle->Underruns++;			// Old data is played again
+	}
+	pHandle->Ready[playing] = 0;		// Being played, no longer new
+	pHandle->Ready[done] = 0;
+
+	if(pHandle->Config.pRefill != NULL)
+	{
+		pHandle->Config.pRefill(pHandle->Config.pBuffer[done], pHandle->Config.Length, pHandle->Config.pArg);
+		pHandle->Ready[done] = 1;
+	}
+}
+
+// Clocks of the timer, the DMA and the port: on from PATGEN_Init to PATGEN_DeInit
+static void PATGEN_ClockControl(const PATGEN_Config_t *pConfig, uint8_t EnorDi)
+{
+	TIM_PeriClockControl(pConfig->pTIMx, EnorDi);
+	DMA_PeriClockControl(PATGEN_DMA, EnorDi);
+	GPIO_PeriClockControl(pConfig->pGPIOx, EnorDi);
+}
+
+// The same clocks in Sleep mode, while the output runs: the DMA writes BSRR while the core sleeps
+static void PATGEN_SleepClockControl(const PATGEN_Config_t *pConfig, uint8_t EnorDi)
+{
+	TIM_SleepClockControl(pConfig->pTIMx, EnorDi);
+	DMA_SleepClockControl(PATGEN_DMA, EnorDi);
+	RCC_PeriphSleepControl(RCC_CLK_GPIO(pConfig->pGPIOx), EnorDi);
+}
+
+// *************************************************************
+// * @fn			- PATGEN_Init			                   *
+// * 						                                   *
+// * @brief			- Sets up the timer and the DMA stream of  *
+// * 				  a pattern generator					   *
+// * 						                                   *
+// * @param[in]		- Handle with the configuration filled in  *
+// * 						                                   *
+// * @return		- PATGEN_OK or an error code               *
+// *														   *
+// * @note			- The output pins must be configured as	   *
+// * 				  outputs by the caller (GPIO_InitPort).   *
+// * 				  Init again (not while running) takes no  *
+// * 				  more clock references, PATGEN_DeInit	   *
+// * 				  gives them back.						   *
+// *************************************************************
+uint8_t PATGEN_Init(PATGEN_Handle_t *pHandle)
+{
+	PATGEN_Config_t *pConfig = &pHandle->Config;
+	DMA_StreamConfig_t dma = { 0 };
+	uint8_t irq, again;
+
+	if(!TIM_GetUpdateDMARequest(pConfig->pTIMx, &pHandle->Stream, &pHandle->Channel))
+	{
+		return PATGEN_ERR_CONFIG;
+	}
+
+	if( (pConfig->Length == 0) || (pConfig->pBuffer[0] == NULL) ||
+		((pConfig->Mode == PATGEN_MODE_DOUBLE) && (pConfig->pBuffer[1] == NULL)) )
+	{
+		return PATGEN_ERR_CONFIG;
+	}
+	// The stream is ours already after an earlier Init, its clocks are on
+	again = (DMA_GetCallback(PATGEN_DMA, pHandle->Stream) == PATGEN_DMAHandler);
+	if(DMA_RegisterCallback(PATGEN_DMA, pHandle->Stream, PATGEN_DMAHandler, pHandle) != DMA_OK)
+	{
+		return PATGEN_ERR_CONFIG;
+	}
+	if(!again)
+	{
+		PATGEN_ClockControl(pConfig, ENABLE);
+	}
+	pHandle->Running = 0;
+
+	TIM_Stop(pConfig->pTIMx);
+	if(TIM_SetUpdateRate(pConfig->pTIMx, pConfig->TimerClockHz, pConfig->SampleRateHz) == 0)
+	{
+		(void)DMA_RegisterCallback(PATGEN_DMA, pHandle->Stream, NULL, NULL);
+		PATGEN_ClockControl(pConfig, DISABLE);
+		return PATGEN_ERR_RATE;
+	}
+
+	dma.Channel = pHandle->Channel;
+	dma.Direction = DMA_DIR_M2P;
+	dma.PeriphSize = DMA_SIZE_WORD;
+	dma.MemSize = DMA_SIZE_WORD;
+	dma.PeriphInc = DISABLE;
+	dma.MemInc = ENABLE;
+	dma.Circular = ENABLE;
+	dma.Priority = DMA_PRIORITY_VERY_HIGH;
+	if(pConfig->Mode == PATGEN_MODE_DOUBLE)
+	{
+		dma.DoubleBuffer = ENABLE;
+		dma.Interrupts = DMA_FLAG_TC;
+	}
+
+	DMA_StreamInit(PATGEN_DMA, pHandle->Stream, &dma);
+	DMA_StreamSetAddress(PATGEN_DMA, pHandle->Stream, &pConfig->pGPIOx->BSRR,
+			pConfig->pBuffer[0], pConfig->pBuffer[1], pConfig->Length);
+
+	irq = DMA_GetIRQNumber(PATGEN_DMA, pHandle->Stream);
+	if(pConfig->Mode == PATGEN_MODE_DOUBLE)
+	{
+		GPIO_IRQConfig(irq, pConfig->IRQPriority, ENABLE);		// Plain NVIC setup, not GPIO specific
+	}
+	else
+	{
+		GPIO_IRQConfig(irq, 0, DISABLE);						// No interrupt, the callback only marks the stream used
+	}
+
+	return PATGEN_OK;
+}
+
+// *************************************************************
+// * @fn			- PATGEN_DeInit			                   *
+// * 						                                   *
+// * @brief			- Stops the output and gives back the DMA  *
+// * 				  stream and the clocks of PATGEN_Init	   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Does nothing if the stream is not used   *
+// * 				  by a pattern generator				   *
+// *************************************************************
+void PATGEN_DeInit(PATGEN_Handle_t *pHandle)
+{
+	if(DMA_GetCallback(PATGEN_DMA, pHandle->Stream) != PATGEN_DMAHandler)
+	{
+		return;
+	}
+
+	PATGEN_Stop(pHandle);
+	GPIO_IRQConfig(DMA_GetIRQNumber(PATGEN_DMA, pHandle->Stream), 0, DISABLE);
+	(void)DMA_RegisterCallback(PATGEN_DMA, pHandle->Stream, NULL, NULL);
+	PATGEN_ClockControl(&pHandle->Config, DISABLE);
+}
+
+// *************************************************************
+// * @fn			- PATGEN_Start			                   *
+// * 						                                   *
+// * @brief			- Starts the output from the first word of *
+// * 				  buffer 0								   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Both buffers must be filled before the   *
+// * 				  start in double buffer mode			   *
+// *************************************************************
+void PATGEN_Start(PATGEN_Handle_t *pHandle)
+{
+	if(!pHandle->Running)
+	{
+		PATGEN_SleepClockControl(&pHandle->Config, ENABLE);
+		pHandle->Running = 1;
+	}
+
+	pHandle->Ready[0] = 1;
+	pHandle->Ready[1] = (pHandle->Config.Mode == PATGEN_MODE_DOUBLE) ? 1 : 0;
+	pHandle->Played = 0;
+	pHandle->Underruns = 0;
+
+	DMA_ClearFlags(PATGEN_DMA, pHandle->Stream, DMA_FLAG_ALL);
+	DMA_StreamEnable(PATGEN_DMA, pHandle->Stream);
+
+	// The DMA request is enabled last, the first update event then transfers the first word
+	REG_WRITE(pHandle->Config.pTIMx->CNT, 0);
+	TIM_UpdateDMAControl(pHandle->Config.pTIMx, ENABLE);
+	TIM_Start(pHandle->Config.pTIMx);
+}
+
+// *************************************************************
+// * @fn			- PATGEN_Stop			                   *
+// * 						                                   *
+// * @brief			- Stops the output, the pins keep the last *
+// * 				  level written							   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- The next PATGEN_Start begins again with  *
+// * 				  buffer 0								   *
+// *************************************************************
+void PATGEN_Stop(PATGEN_Handle_t *pHandle)
+{
+	PATGEN_Config_t *pConfig = &pHandle->Config;
+
+	TIM_Stop(pConfig->pTIMx);
+	TIM_UpdateDMAControl(pConfig->pTIMx, DISABLE);
+	DMA_StreamDisable(PATGEN_DMA, pHandle->Stream);
+
+	// Rewind, NDTR/M0AR/CT are only reloaded while the stream is disabled
+	REG_CLR_BITS(PATGEN_DMA->S[pHandle->Stream].CR, DMA_SxCR_CT);
+	DMA_StreamSetAddress(PATGEN_DMA, pHandle->Stream, &pConfig->pGPIOx->BSRR,
+			pConfig->pBuffer[0], pConfig->pBuffer[1], pConfig->Length);
+	DMA_ClearFlags(PATGEN_DMA, pHandle->Stream, DMA_FLAG_ALL);
+
+	if(pHandle->Running)
+	{
+		PATGEN_SleepClockControl(pConfig, DISABLE);
+		pHandle->Running = 0;
+	}
+}
+
+// *************************************************************
+// * @fn			- PATGEN_GetFreeBuffer	                   *
+// * 						                                   *
+// * @brief			- Returns the buffer that can be refilled  *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- Buffer, NULL if there is none to refill  *
+// *														   *
+// * @note			- Double buffer mode without a refill	   *
+// * 				  callback. The buffer is free until it is *
+// * 				  given back with PATGEN_SubmitBuffer.	   *
+// *************************************************************
+uint32_t *PATGEN_GetFreeBuffer(PATGEN_Handle_t *pHandle)
+{
+	// The buffer the DMA is not reading from
+	uint8_t free = DMA_GetCurrentTarget(PATGEN_DMA, pHandle->Stream) ^ 1;
+
+	if( (pHandle->Config.Mode != PATGEN_MODE_DOUBLE) || pHandle->Ready[free] )
+	{
+		return NULL;
+	}
+
+	return pHandle->Config.pBuffer[free];
+}
+
+void PATGEN_SubmitBuffer(PATGEN_Handle_t *pHandle, uint32_t *pBuffer)
+{
+	uint8_t index = (pBuffer == pHandle->Config.pBuffer[1]) ? 1 : 0;
+
+	pHandle->Ready[index] = 1;
+}
+
+// *************************************************************
+// * @fn			- PATGEN_Encode			                   *
+// * 						                                   *
+// * @brief			- Converts port levels to BSRR words	   *
+// * 						                                   *
+// * @param[out]	- BSRR words							   *
+// * @param[in]		- Port levels, one bit per pin             *
+// * @param[in]		- Number of samples                        *
+// * @param[in]		- Pins driven by the pattern, the other	   *
+// * 				  pins of the port are not touched		   *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- pOut and pLevels may not overlap		   *
+// *************************************************************
+void PATGEN_Encode(uint32_t *pOut, const uint16_t *pLevels, uint16_t Length, uint16_t PinMask)
+{
+	for(uint16_t i = 0; i < Length; i++)
+	{
+		pOut[i] = GPIO_BSRR_WORD(PinMask, pLevels[i]);
+	}
+}
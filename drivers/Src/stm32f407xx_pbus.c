@@ -0,0 +1,465 @@
+/*
+ * stm32f407xx_pbus.c
+ *
+ *  Created on: Feb 26, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_pbus.h"
+
+// BSRR words of a control pin, not used when the pin has no port
+static void PBUS_SetSignal(PBUS_Signal_t *pSignal, const PBUS_Pin_t *pPin, uint8_t ActiveHigh)
+{
+	uint32_t set = GPIO_BSRR_SET(GPIO_PIN_MASK(pPin->Pin));
+	uint32_t reset = GPIO_BSRR_RESET(GPIO_PIN_MASK(pPin->Pin));
+
+	pSignal->pGPIOx = pPin->pGPIOx;
+	pSignal->On = ActiveHigh ? set : reset;
+	pSignal->Off = ActiveHigh ? reset : set;
+}
+
+static inline void PBUS_Drive(const PBUS_Signal_t *pSignal, uint32_t Word)
+{
+	if(pSignal->pGPIOx != NULL)
+	{
+		REG_WRITE(pSignal->pGPIOx->BSRR, Word);
+	}
+}
+
+// Extra stores so a strobe phase lasts at least PulseNs
+static uint8_t PBUS_HoldStores(uint32_t CoreClockHz, uint16_t PulseNs)
+{
+	uint64_t cycles = ((uint64_t)PulseNs * CoreClockHz + 999999999U) / 1000000000U;
+	uint64_t stores = (cycles + PBUS_CYCLES_PER_STORE - 1) / PBUS_CYCLES_PER_STORE;
+
+	if(stores <= 1)
+	{
+		return 0;
+	}
+	return (stores > 256) ? 255 : (uint8_t)(stores - 1);
+}
+
+// One word: data (with the strobe active when it is in the table), then the strobe inactive
+static inline void PBUS_WriteWord(const PBUS_Handle_t *pHandle, uint32_t Value)
+{
+	const PBUS_Signal_t *pStrobe = &pHandle->Write;
+	uint32_t low = Value & 0xFFU;
+	uint32_t high = (Value >> 8) & 0xFFU;
+
+	REG_WRITE(pHandle->pPorts[0]->BSRR, pHandle->Lut[0][0][low] | pHandle->Lut[0][1][high]);
+	if(pHandle->PortCount > 1)
+	{
+		REG_WRITE(pHandle->pPorts[1]->BSRR, pHandle->Lut[1][0][low] | pHandle->Lut[1][1][high]);
+	}
+	if(!pHandle->StrobeInLut)
+	{
+		REG_WRITE(pStrobe->pGPIOx->BSRR, pStrobe->On);
+	}
+	for(uint8_t i = 0; i < pHandle->WriteHold; i++)
+	{
+		REG_WRITE(pStrobe->pGPIOx->BSRR, pStrobe->On);
+	}
+
+	REG_WRITE(pStrobe->pGPIOx->BSRR, pStrobe->Off);
+	for(uint8_t i = 0; i < pHandle->WriteHold; i++)
+	{
+		REG_WRITE(pStrobe->pGPIOx->BSRR, pStrobe->Off);
+	}
+}
+
+// Data pins to inputs for a read (6800: R/W to read after that)
+static void PBUS_DataInput(const PBUS_Handle_t *pHandle)
+{
+	for(uint8_t p = 0; p < pHandle->PortCount; p++)
+	{
+		(void)GPIO_SetPinModes(pHandle->pPorts[p], pHandle->PortPins[p], GPIO_MODE_IN);
+	}
+	PBUS_Drive(&pHandle->RW, pHandle->RW.On);
+}
+
+static void PBUS_DataOutput(const PBUS_Handle_t *pHandle)
+{
+	PBUS_Drive(&pHandle->RW, pHandle->RW.Off);
+	for(uint8_t p = 0; p < pHandle->PortCount; p++)
+	{
+		(void)GPIO_SetPinModes(pHandle->pPorts[p], pHandle->PortPins[p], GPIO_MODE_OUT);
+	}
+}
+
+// One word, the data pins are inputs
+static uint16_t PBUS_ReadWord(const PBUS_Handle_t *pHandle)
+{
+	const PBUS_Config_t *pConfig = &pHandle->Config;
+	const PBUS_Signal_t *pStrobe = &pHandle->Read;
+	uint32_t idr[PBUS_MAX_PORTS] = { 0 };
+	uint32_t value = 0;
+
+	REG_WRITE(pStrobe->pGPIOx->BSRR, pStrobe->On);
+	for(uint8_t i = 0; i < pHandle->ReadHold; i++)
+	{
+		REG_WRITE(pStrobe->pGPIOx->BSRR, pStrobe->On);
+	}
+	idr[0] = REG_READ(pHandle->pPorts[0]->IDR);
+	if(pHandle->PortCount > 1)
+	{
+		idr[1] = REG_READ(pHandle->pPorts[1]->IDR);
+	}
+	REG_WRITE(pStrobe->pGPIOx->BSRR, pStrobe->Off);
+	for(uint8_t i = 0; i < pHandle->WriteHold; i++)
+	{
+		REG_WRITE(pStrobe->pGPIOx->BSRR, pStrobe->Off);
+	}
+
+	// Lines in order on one port are a shift, the others are gathered bit by bit
+	if(pHandle->ReadShift != 0xFFU)
+	{
+		return (uint16_t)( (idr[0] >> pHandle->ReadShift) & ((1U << pConfig->Width) - 1U) );
+	}
+	for(uint8_t i = 0; i < pConfig->Width; i++)
+	{
+		uint8_t p = (pConfig->Data[i].pGPIOx == pHandle->pPorts[0]) ? 0 : 1;
+
+		value |= ((idr[p] >> pConfig->Data[i].Pin) & 1U) << i;
+	}
+
+	return (uint16_t)value;
+}
+
+// *************************************************************
+// * @fn			- PBUS_Init				                   *
+// * 						                                   *
+// * @brief			- Builds the BSRR tables of the data lines *
+// * 				  and sets the control lines inactive	   *
+// * 						                                   *
+// * @param[in]		- Handle with the configuration filled in  *
+// * 						                                   *
+// * @return		- PBUS_OK or PBUS_ERR_CONFIG               *
+// *														   *
+// * @note			- The pins must be configured as outputs   *
+// * 				  by the caller. Starts the DWT cycle	   *
+// * 				  counter for the throughput statistics.   *
+// *************************************************************
+uint8_t PBUS_Init(PBUS_Handle_t *pHandle)
+{
+	PBUS_Config_t *pConfig = &pHandle->Config;
+	uint8_t is6800 = (pConfig->Mode == PBUS_MODE_6800);
+	const PBUS_Pin_t *pStrobePin = is6800 ? &pConfig->RD : &pConfig->WR;
+
+	if( (pConfig->Mode > PBUS_MODE_6800) || ((pConfig->Width != 8) && (pConfig->Width != 16)) ||
+		(pConfig->WR.pGPIOx == NULL) || (pConfig->WR.Pin > 15) || (pConfig->RD.Pin > 15) ||
+		(pConfig->CS.Pin > 15) || (pConfig->DC.Pin > 15) || (is6800 && (pConfig->RD.pGPIOx == NULL)) )
+	{
+		return PBUS_ERR_CONFIG;
+	}
+
+	// Ports of the data lines
+	pHandle->PortCount = 0;
+	for(uint8_t i = 0; i < pConfig->Width; i++)
+	{
+		const PBUS_Pin_t *pPin = &pConfig->Data[i];
+		uint8_t p = 0;
+
+		while( (p < pHandle->PortCount) && (pHandle->pPorts[p] != pPin->pGPIOx) )
+		{
+			p++;
+		}
+		if( (pPin->pGPIOx == NULL) || (pPin->Pin > 15) || (p == PBUS_MAX_PORTS) )
+		{
+			return PBUS_ERR_CONFIG;
+		}
+		if(p == pHandle->PortCount)
+		{
+			pHandle->pPorts[p] = pPin->pGPIOx;
+			pHandle->PortPins[p] = 0;
+			pHandle->PortCount++;
+		}
+		pHandle->PortPins[p] |= GPIO_PIN_MASK(pPin->Pin);
+	}
+
+	// Control lines
+	PBUS_SetSignal(&pHandle->Write, pStrobePin, is6800);
+	PBUS_SetSignal(&pHandle->Read, &pConfig->RD, is6800);
+	PBUS_SetSignal(&pHandle->RW, &pConfig->WR, 1);
+	PBUS_SetSignal(&pHandle->CS, &pConfig->CS, 0);
+	PBUS_SetSignal(&pHandle->DC, &pConfig->DC, 0);
+	if(!is6800)
+	{
+		pHandle->RW.pGPIOx = NULL;
+	}
+
+	// The strobe can not be a data line
+	for(uint8_t p = 0; p < pHandle->PortCount; p++)
+	{
+		if( (pHandle->pPorts[p] == pStrobePin->pGPIOx) && (pHandle->PortPins[p] & GPIO_PIN_MASK(pStrobePin->Pin)) )
+		{
+			return PBUS_ERR_CONFIG;
+		}
+	}
+	pHandle->StrobeInLut = (pStrobePin->pGPIOx == pHandle->pPorts[0]);
+
+	// Tables: entry v of byte b of port p drives the lines 8b - 8b+7 of that port to v
+	for(uint8_t p = 0; p < pHandle->PortCount; p++)
+	{
+		for(uint8_t b = 0; b < 2; b++)
+		{
+			for(uint32_t v = 0; v < 256; v++)
+			{
+				uint32_t word = 0;
+
+				for(uint8_t bit = 0; bit < 8; bit++)
+				{
+					const PBUS_Pin_t *pPin = &pConfig->Data[(8 * b) + bit];
+
+					if( ((8 * b) + bit < pConfig->Width) && (pPin->pGPIOx == pHandle->pPorts[p]) )
+					{
+						word |= (v & (1U << bit)) ? GPIO_BSRR_SET(GPIO_PIN_MASK(pPin->Pin))
+												  : GPIO_BSRR_RESET(GPIO_PIN_MASK(pPin->Pin));
+					}
+				}
+				if( (p == 0) && (b == 0) && pHandle->StrobeInLut )
+				{
+					word |= pHandle->Write.On;
+				}
+				pHandle->Lut[p][b][v] = word;
+			}
+		}
+	}
+
+	// Lines 0 - Width-1 on consecutive pins of one port are read with a shift
+	pHandle->ReadShift = (pHandle->PortCount == 1) ? pConfig->Data[0].Pin : 0xFFU;
+	for(uint8_t i = 1; i < pConfig->Width; i++)
+	{
+		if(pConfig->Data[i].Pin != pConfig->Data[0].Pin + i)
+		{
+			pHandle->ReadShift = 0xFFU;
+		}
+	}
+
+	pHandle->WriteHold = PBUS_HoldStores(pConfig->CoreClockHz, pConfig->WritePulseNs);
+	pHandle->ReadHold = PBUS_HoldStores(pConfig->CoreClockHz, pConfig->ReadPulseNs);
+
+	// Idle: not selected, data, strobes inactive, 6800 R/W on write
+	PBUS_Drive(&pHandle->CS, pHandle->CS.Off);
+	PBUS_Drive(&pHandle->DC, pHandle->DC.Off);
+	PBUS_Drive(&pHandle->Write, pHandle->Write.Off);
+	PBUS_Drive(&pHandle->Read, pHandle->Read.Off);
+	PBUS_Drive(&pHandle->RW, pHandle->RW.Off);
+
+	REG_SET_BITS(DEMCR, DEMCR_TRCENA);
+	REG_SET_BITS(DWT->CTRL, DWT_CTRL_CYCCNTENA);
+	PBUS_ResetStats(pHandle);
+
+	return PBUS_OK;
+}
+
+void PBUS_Select(PBUS_Handle_t *pHandle)
+{
+	PBUS_Drive(&pHandle->CS, pHandle->CS.On);
+}
+
+void PBUS_Deselect(PBUS_Handle_t *pHandle)
+{
+	PBUS_Drive(&pHandle->CS, pHandle->CS.Off);
+}
+
+// *************************************************************
+// * @fn			- PBUS_WriteCommand		                   *
+// * 						                                   *
+// * @brief			- Writes one word with DC low			   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * @param[in]		- Command								   *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- DC is back high (data) on return		   *
+// *************************************************************
+void PBUS_WriteCommand(PBUS_Handle_t *pHandle, uint16_t Command)
+{
+	PBUS_Drive(&pHandle->DC, pHandle->DC.On);
+	PBUS_WriteWord(pHandle, Command);
+	PBUS_Drive(&pHandle->DC, pHandle->DC.Off);
+}
+
+void PBUS_Write(PBUS_Handle_t *pHandle, uint16_t Value)
+{
+	PBUS_WriteWord(pHandle, Value);
+}
+
+// *************************************************************
+// * @fn			- PBUS_WriteBuffer		                   *
+// * 						                                   *
+// * @brief			- Writes a block of data words			   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * @param[in]		- Bytes (8 bit bus) or half-words (16 bit) *
+// * @param[in]		- Number of words                          *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Per word one table load and one store    *
+// * 				  per port, plus the strobe store(s)	   *
+// *************************************************************
+void PBUS_WriteBuffer(PBUS_Handle_t *pHandle, const void *pData, uint32_t Count)
+{
+	uint32_t start = PROFILER_Now();
+
+	if(pHandle->Config.Width == 8)
+	{
+		const uint8_t *p = (const uint8_t*)pData;
+
+		for(uint32_t n = 0; n < Count; n++)
+		{
+			PBUS_WriteWord(pHandle, p[n]);
+		}
+	}
+	else
+	{
+		const uint16_t *p = (const uint16_t*)pData;
+
+		for(uint32_t n = 0; n < Count; n++)
+		{
+			PBUS_WriteWord(pHandle, p[n]);
+		}
+	}
+
+	pHandle->BurstWords += Count;
+	pHandle->BurstCycles += PROFILER_Now() - start;
+}
+
+// *************************************************************
+// * @fn			- PBUS_Fill				                   *
+// * 						                                   *
+// * @brief			- Writes the same word Count times		   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * @param[in]		- Word									   *
+// * @param[in]		- Number of writes                         *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- The data lines are driven once, the	   *
+// * 				  other writes only pulse the strobe (e.g. *
+// * 				  clearing a TFT to one color)			   *
+// *************************************************************
+void PBUS_Fill(PBUS_Handle_t *pHandle, uint16_t Value, uint32_t Count)
+{
+	const PBUS_Signal_t *pStrobe = &pHandle->Write;
+	uint32_t start = PROFILER_Now();
+
+	if(Count == 0)
+	{
+		return;
+	}
+
+	PBUS_WriteWord(pHandle, Value);
+	for(uint32_t n = 1; n < Count; n++)
+	{
+		REG_WRITE(pStrobe->pGPIOx->BSRR, pStrobe->On);
+		for(uint8_t i = 0; i < pHandle->WriteHold; i++)
+		{
+			REG_WRITE(pStrobe->pGPIOx->BSRR, pStrobe->On);
+		}
+		REG_WRITE(pStrobe->pGPIOx->BSRR, pStrobe->Off);
+		for(uint8_t i = 0; i < pHandle->WriteHold; i++)
+		{
+			REG_WRITE(pStrobe->pGPIOx->BSRR, pStrobe->Off);
+		}
+	}
+
+	pHandle->BurstWords += Count;
+	pHandle->BurstCycles += PROFILER_Now() - start;
+}
+
+// *************************************************************
+// * @fn			- PBUS_Read				                   *
+// * 						                                   *
+// * @brief			- Reads one word from the bus			   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- The word                                 *
+// *														   *
+// * @note			- The data pins are inputs during the read *
+// * 				  and outputs again after it. 0 without a  *
+// * 				  RD pin.								   *
+// *************************************************************
+uint16_t PBUS_Read(PBUS_Handle_t *pHandle)
+{
+	uint16_t value;
+
+	if(pHandle->Read.pGPIOx == NULL)
+	{
+		return 0;
+	}
+
+	PBUS_DataInput(pHandle);
+	value = PBUS_ReadWord(pHandle);
+	PBUS_DataOutput(pHandle);
+
+	return value;
+}
+
+void PBUS_ReadBuffer(PBUS_Handle_t *pHandle, void *pData, uint32_t Count)
+{
+	uint32_t start = PROFILER_Now();
+
+	if(pHandle->Read.pGPIOx == NULL)
+	{
+		return;
+	}
+
+	PBUS_DataInput(pHandle);
+	if(pHandle->Config.Width == 8)
+	{
+		uint8_t *p = (uint8_t*)pData;
+
+		for(uint32_t n = 0; n < Count; n++)
+		{
+			p[n] = (uint8_t)PBUS_ReadWord(pHandle);
+		}
+	}
+	else
+	{
+		uint16_t *p = (uint16_t*)pData;
+
+		for(uint32_t n = 0; n < Count; n++)
+		{
+			p[n] = PBUS_ReadWord(pHandle);
+		}
+	}
+	PBUS_DataOutput(pHandle);
+
+	pHandle->BurstWords += Count;
+	pHandle->BurstCycles += PROFILER_Now() - start;
+}
+
+// *************************************************************
+// * @fn			- PBUS_GetBytesPerSecond                   *
+// * 						                                   *
+// * @brief			- Throughput of the burst transfers		   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- Bytes per second, 0 before a burst       *
+// *														   *
+// * @note			- From the DWT cycles spent in			   *
+// * 				  PBUS_WriteBuffer, PBUS_Fill and		   *
+// * 				  PBUS_ReadBuffer and CoreClockHz		   *
+// *************************************************************
+uint32_t PBUS_GetBytesPerSecond(const PBUS_Handle_t *pHandle)
+{
+	if(pHandle->BurstCycles == 0)
+	{
+		return 0;
+	}
+
+	return (uint32_t)( ((uint64_t)pHandle->BurstWords * (pHandle->Config.Width / 8) * pHandle->Config.CoreClockHz)
+			/ pHandle->BurstCycles );
+}
+
+void PBUS_ResetStats(PBUS_Handle_t *pHandle)
+{
+	pHandle->BurstWords = 0;
+	pHandle->BurstCycles = 0;
+}
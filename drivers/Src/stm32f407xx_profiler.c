@@ -0,0 +1,328 @@
+/*
+ * stm32f407xx_profiler.c
+ *
+ *  Created on: Nov 20, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_profiler.h"
+
+// Binary export format, all fields little endian:
+//	header:	'P' 'R' version region_count
+//	region:	id bin_bitmap(4) count(4) min(4) max(4) total(8) followed by a count(4) for every
+//			bin set in bin_bitmap
+#define PROFILER_BIN_VERSION		1
+
+static PROFILER_Stats_t Stats[PROFILER_MAX_REGIONS];
+static uint32_t Overhead;		// Cycles of an empty BEGIN/END pair, subtracted from every sample
+
+// *************************************************************
+// * @fn			- PROFILER_Init			                   *
+// * 						                                   *
+// * @brief			- Starts the DWT cycle counter and clears  *
+// * 				  the statistics						   *
+// * 						                                   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- The cost of reading the counter is	   *
+// * 				  measured here and removed from samples.  *
+// * 				  The counter is not cleared, it counts	   *
+// * 				  from reset for the boot milestones.	   *
+// *************************************************************
+void PROFILER_Init(void)
+{
+	uint32_t min = 0xFFFFFFFFU;
+
+	REG_SET_BITS(DEMCR, DEMCR_TRCENA);
+	REG_SET_BITS(DWT->CTRL, DWT_CTRL_CYCCNTENA);
+
+	for(uint8_t i = 0; i < 4; i++)
+	{
+		uint32_t start = PROFILER_Now();
+		uint32_t cycles = PROFILER_Now() - start;
+
+		if(cycles < min)
+		{
+			min = cycles;
+		}
+	}
+	Overhead = min;
+
+	PROFILER_Reset();
+}
+
+void PROFILER_Reset(void)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	for(uint8_t i = 0; i < PROFILER_MAX_REGIONS; i++)
+	{
+		Stats[i] = (PROFILER_Stats_t){ 0 };
+	}
+	__set_PRIMASK(primask);
+}
+
+// *************************************************************
+// * @fn			- PROFILER_Record		                   *
+// * 						                                   *
+// * @brief			- Adds one sample to a region			   *
+// * 						                                   *
+// * @param[in]		- Region id, see @PROFILER_IDS             *
+// * @param[in]		- Cycles measured						   *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Interrupts are masked while the table is *
+// * 				  updated, so regions in ISRs and in the   *
+// * 				  main loop can share an id				   *
+// *************************************************************
+void PROFILER_Record(uint8_t Id, uint32_t Cycles)
+{
+	uint32_t primask;
+	uint8_t bin;
+
+	if(Id >= PROFILER_MAX_REGIONS)
+	{
+		return;
+	}
+
+	Cycles = (Cycles > Overhead) ? (Cycles - Overhead) : 0;
+	bin = (Cycles == 0) ? 0 : (uint8_t)(32 - __CLZ(Cycles));
+	if(bin >= PROFILER_HIST_BINS)
+	{
+		bin = PROFILER_HIST_BINS - 1;
+	}
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	PROFILER_Stats_t *pStats = &Stats[Id];
+
+	if(pStats->Count == 0)
+	{
+		pStats->Min = Cycles;
+		pStats->Max = Cycles;
+	}
+	else
+	{
+		if(Cycles < pStats->Min) { pStats->Min = Cycles; }
+		if(Cycles > pStats->Max) { pStats->Max = Cycles; }
+	}
+	pStats->Count++;
+	pStats->Total += Cycles;
+	pStats->Hist[bin]++;
+
+	__set_PRIMASK(primask);
+}
+
+const PROFILER_Stats_t *PROFILER_GetStats(uint8_t Id)
+{
+	return (Id < PROFILER_MAX_REGIONS) ? &Stats[Id] : NULL;
+}
+
+// Copy of the statistics of a region, taken with interrupts masked so a sample recorded by
+// an ISR meanwhile is either all in or all out
+static void PROFILER_Snapshot(uint8_t Id, PROFILER_Stats_t *pStats)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	*pStats = Stats[Id];
+	__set_PRIMASK(primask);
+}
+
+// Writes "Value" in decimal followed by "Sep". Returns the number of characters, 0 if it does not fit.
+static uint32_t PROFILER_PutDec(char *pBuffer, uint32_t Len, uint64_t Value, char Sep)
+{
+	char digits[20];
+	uint32_t n = 0, i;
+
+	do
+	{
+		digits[n++] = (char)('0' + (Value % 10));
+		Value /= 10;
+	}while(Value != 0);
+
+	if(n + 1 > Len)
+	{
+		return 0;
+	}
+	for(i = 0; i < n; i++)
+	{
+		pBuffer[i] = digits[n - 1 - i];
+	}
+	pBuffer[n] = Sep;
+
+	return n + 1;
+}
+
+// *************************************************************
+// * @fn			- PROFILER_ExportCSV	                   *
+// * 						                                   *
+// * @brief			- Writes the statistics as CSV text, one   *
+// * 				  line per region with samples			   *
+// * 						                                   *
+// * @param[out]	- Output buffer							   *
+// * @param[in]		- Size of the buffer                       *
+// *														   *
+// * @return		- Number of characters written             *
+// *														   *
+// * @note			- Columns: id,count,min,max,mean,h0..h31,  *
+// * 				  all named in the header line. A line	   *
+// * 				  that does not fit is left out, the text  *
+// * 				  is not 0 terminated. Each region is	   *
+// * 				  copied with interrupts masked, so a	   *
+// * 				  line never mixes in half a sample.	   *
+// *************************************************************
+uint32_t PROFILER_ExportCSV(char *pBuffer, uint32_t Len)
+{
+	static const char header[] = "id,count,min,max,mean,";
+	uint32_t pos = sizeof(header) - 1, n;
+
+	// Header, then one column h0 ... h31 per histogram bin
+	if(Len < pos)
+	{
+		return 0;
+	}
+	for(uint32_t i = 0; i < pos; i++)
+	{
+		pBuffer[i] = header[i];
+	}
+	for(uint8_t b = 0; b < PROFILER_HIST_BINS; b++)
+	{
+		char sep = (b == PROFILER_HIST_BINS - 1) ? '\n' : ',';
+
+		if(pos >= Len)
+		{
+			return 0;
+		}
+		pBuffer[pos++] = 'h';
+		n = PROFILER_PutDec(&pBuffer[pos], Len - pos, b, sep);
+		if(n == 0)
+		{
+			return 0;
+		}
+		pos += n;
+	}
+
+	for(uint8_t id = 0; id < PROFILER_MAX_REGIONS; id++)
+	{
+		PROFILER_Stats_t s;
+		uint32_t lineStart = pos;
+		uint64_t fields[5];
+
+		PROFILER_Snapshot(id, &s);
+		if(s.Count == 0)
+		{
+			continue;
+		}
+
+		fields[0] = id;
+		fields[1] = s.Count;
+		fields[2] = s.Min;
+		fields[3] = s.Max;
+		fields[4] = s.Total / s.Count;
+
+		for(uint8_t f = 0; f < 5 + PROFILER_HIST_BINS; f++)
+		{
+			uint64_t value = (f < 5) ? fields[f] : s.Hist[f - 5];
+			char sep = (f == 5 + PROFILER_HIST_BINS - 1) ? '\n' : ',';
+
+			n = PROFILER_PutDec(&pBuffer[pos], Len - pos, value, sep);
+			if(n == 0)
+			{
+				return lineStart;
+			}
+			pos += n;
+		}
+	}
+
+	return pos;
+}
+
+// Little endian store helper
+static void PROFILER_PutLE(uint8_t *pBuffer, uint64_t Value, uint8_t Bytes)
+{
+	for(uint8_t i = 0; i < Bytes; i++)
+	{
+		pBuffer[i] = (uint8_t)(Value >> (8 * i));
+	}
+}
+
+// *************************************************************
+// * @fn			- PROFILER_ExportBinary	                   *
+// * 						                                   *
+// * @brief			- Writes the statistics in the compact	   *
+// * 				  binary format (see top of this file)	   *
+// * 						                                   *
+// * @param[out]	- Output buffer							   *
+// * @param[in]		- Size of the buffer                       *
+// *														   *
+// * @return		- Number of bytes written                  *
+// *														   *
+// * @note			- Only histogram bins with samples are	   *
+// * 				  written. A region that does not fit is   *
+// * 				  left out. Each region is copied with	   *
+// * 				  interrupts masked, as for the CSV.	   *
+// *************************************************************
+uint32_t PROFILER_ExportBinary(uint8_t *pBuffer, uint32_t Len)
+{
+	uint32_t pos = 4;
+	uint8_t regions = 0;
+
+	if(Len < 4)
+	{
+		return 0;
+	}
+
+	for(uint8_t id = 0; id < PROFILER_MAX_REGIONS; id++)
+	{
+		PROFILER_Stats_t s;
+		uint32_t bitmap = 0, size = 25;
+
+		PROFILER_Snapshot(id, &s);
+		if(s.Count == 0)
+		{
+			continue;
+		}
+
+		for(uint8_t b = 0; b < PROFILER_HIST_BINS; b++)
+		{
+			if(s.Hist[b] != 0)
+			{
+				bitmap |= (1U << b);
+				size += 4;
+			}
+		}
+		if(pos + size > Len)
+		{
+			break;
+		}
+
+		pBuffer[pos] = id;
+		PROFILER_PutLE(&pBuffer[pos + 1], bitmap, 4);
+		PROFILER_PutLE(&pBuffer[pos + 5], s.Count, 4);
+		PROFILER_PutLE(&pBuffer[pos + 9], s.Min, 4);
+		PROFILER_PutLE(&pBuffer[pos + 13], s.Max, 4);
+		PROFILER_PutLE(&pBuffer[pos + 17], s.Total, 8);
+		pos += 25;
+
+		for(uint8_t b = 0; b < PROFILER_HIST_BINS; b++)
+		{
+			if(bitmap & (1U << b))
+			{
+				PROFILER_PutLE(&pBuffer[pos], s.Hist[b], 4);
+				pos += 4;
+			}
+		}
+		regions++;
+	}
+
+	pBuffer[0] = 'P';
+	pBuffer[1] = 'R';
+	pBuffer[2] = PROFILER_BIN_VERSION;
+	pBuffer[3] = regions;
+
+	return pos;
+}
@@ -0,0 +1,555 @@
+/*
+ * stm32f407xx_rcc_driver.c
+ *
+ *  Created on: Dec 18, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_rcc_driver.h"
+
+// Polls of a ready flag before giving up, the HSE crystal needs up to 2 ms to start
+#define RCC_READY_TIMEOUT		100000U
+
+// Divider of each HPRE and PPRE value, index is the register field
+static const uint16_t AHBPrescaler[16] = { 1, 1, 1, 1, 1, 1, 1, 1, 2, 4, 8, 16, 64, 128, 256, 512 };
+static const uint8_t APBPrescaler[8] = { 1, 1, 1, 1, 2, 4, 8, 16 };
+
+// Offset of the xxxENR register of each bus in RCC, xxxLPENR is 0x20 above it (ch. 7.3.25)
+static const uint8_t EnableRegOffset[RCC_BUS_COUNT] = { 0x30, 0x34, 0x38, 0x40, 0x44 };
+#define RCC_LPENR_DISTANCE		0x20U
+
+// Users of each peripheral clock, all of them and the ones that need it in Sleep mode
+static uint8_t ClockUsers[RCC_CLK_COUNT];
+static uint8_t SleepUsers[RCC_CLK_COUNT];
+static uint8_t SleepClocks;						// Peripherals with SleepUsers != 0
+
+// Waits until (Reg & Mask) == Value. Returns 0 on timeout.
+static uint8_t RCC_WaitFlag(__vo uint32_t *pReg, uint32_t Mask, uint32_t Value)
+{
+	for(uint32_t i = 0; i < RCC_READY_TIMEOUT; i++)
+	{
+		if( (REG_READ(*pReg) & Mask) == Value )
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// HPRE field value of an AHB divider, 0xFF if the divider does not exist
+static uint8_t RCC_AHBCode(uint16_t Div)
+{
+	if(Div == 1)
+	{
+		return 0;
+	}
+	for(uint8_t code = 8; code < 16; code++)
+	{
+		if(AHBPrescaler[code] == Div)
+		{
+			return code;
+		}
+	}
+
+	return 0xFF;
+}
+
+// Smallest APB prescaler that keeps the bus clock <= MaxHz
+static uint8_t RCC_APBCode(uint32_t HclkHz, uint32_t MaxHz)
+{
+	for(uint8_t code = 3; code < 8; code++)
+	{
+		if(HclkHz / APBPrescaler[code] <= MaxHz)
+		{
+			return code;
+		}
+	}
+
+	return 7;
+}
+
+// *************************************************************
+// * @fn			- RCC_PLLCheck			                   *
+// * 						                                   *
+// * @brief			- Checks a PLL setting against the limits  *
+// * 				  of the reference manual				   *
+// * 						                                   *
+// * @param[in]		- PLL input clock in Hz                    *
+// * @param[in]		- PLL setting			                   *
+// * 						                                   *
+// * @return		- RCC_OK or RCC_ERR_CONFIG                 *
+// *														   *
+// * @note			- The USB clock is only checked to be	   *
+// * 				  <= 48 MHz, not to be exactly 48 MHz	   *
+// *************************************************************
+uint8_t RCC_PLLCheck(uint32_t InHz, const RCC_PLLConfig_t *pPLL)
+{
+	uint64_t vco;
+
+	if( (pPLL->M < 2) || (pPLL->M > 63) || (pPLL->N < 50) || (pPLL->N > 432) ||
+		(pPLL->P < 2) || (pPLL->P > 8) || (pPLL->P & 1) || (pPLL->Q < 2) || (pPLL->Q > 15) )
+	{
+		return RCC_ERR_CONFIG;
+	}
+	if( (InHz / pPLL->M < RCC_PLL_IN_MIN) || ((InHz + pPLL->M - 1) / pPLL->M > RCC_PLL_IN_MAX) )
+	{
+		return RCC_ERR_CONFIG;
+	}
+
+	vco = (uint64_t)InHz * pPLL->N / pPLL->M;
+	if( (vco < RCC_PLL_VCO_MIN) || (vco > RCC_PLL_VCO_MAX) ||
+		(vco / pPLL->P > RCC_SYSCLK_MAX) || (vco / pPLL->Q > RCC_USB_HZ) )
+	{
+		return RCC_ERR_CONFIG;
+	}
+
+	return RCC_OK;
+}
+
+// *************************************************************
+// * @fn			- RCC_PLLSolve			                   *
+// * 						                                   *
+// * @brief			- Finds M/N/P/Q for a SYSCLK frequency	   *
+// * 						                                   *
+// * @param[in]		- PLL input clock in Hz (HSI or HSE)       *
+// * @param[in]		- SYSCLK frequency in Hz                   *
+// * @param[out]	- PLL setting			                   *
+// * 						                                   *
+// * @return		- RCC_OK or RCC_ERR_CONFIG if SYSCLK can   *
+// * 				  not be made exactly					   *
+// *														   *
+// * @note			- The highest PLL input (smallest M) is	   *
+// * 				  tried first. A setting with an exact 48  *
+// * 				  MHz USB clock is taken over one without. *
+// *************************************************************
+uint8_t RCC_PLLSolve(uint32_t InHz, uint32_t SysclkHz, RCC_PLLConfig_t *pPLL)
+{
+	uint8_t found = 0;
+
+	if( (SysclkHz == 0) || (SysclkHz > RCC_SYSCLK_MAX) )
+	{
+		return RCC_ERR_CONFIG;
+	}
+
+	for(uint8_t m = 2; m <= 63; m++)
+	{
+		for(uint8_t p = 2; p <= 8; p += 2)
+		{
+			uint64_t vcoTimesM = (uint64_t)SysclkHz * p * m;	// VCO * M = InHz * N
+			RCC_PLLConfig_t pll;
+
+			if(vcoTimesM % InHz != 0)
+			{
+				continue;
+			}
+
+			pll.M = m;
+			pll.N = (uint16_t)((vcoTimesM / InHz > 0xFFFF) ? 0xFFFF : vcoTimesM / InHz);
+			pll.P = p;
+			pll.Q = (uint8_t)( ((uint64_t)SysclkHz * p + RCC_USB_HZ - 1) / RCC_USB_HZ );
+
+			if(RCC_PLLCheck(InHz, &pll) != RCC_OK)
+			{
+				continue;
+			}
+			if( ((uint64_t)SysclkHz * p) % RCC_USB_HZ == 0 )
+			{
+				*pPLL = pll;
+				return RCC_OK;
+			}
+			if(!found)
+			{
+				*pPLL = pll;
+				found = 1;
+			}
+		}
+	}
+
+	return found ? RCC_OK : RCC_ERR_CONFIG;
+}
+
+// *************************************************************
+// * @fn			- RCC_ClockConfig		                   *
+// * 						                                   *
+// * @brief			- Switches the system clock				   *
+// * 						                                   *
+// * @param[in]		- Clock configuration	                   *
+// * 						                                   *
+// * @return		- RCC_OK or an error code, on an error the *
+// * 				  clock is left on HSI					   *
+// *														   *
+// * @note			- Order: source oscillator, PLL, flash	   *
+// * 				  wait states before the frequency goes up,*
+// * 				  bus prescalers, switch, then the wait	   *
+// * 				  states are lowered if the frequency went *
+// * 				  down. Call TIMEBASE_Init again after it. *
+// *************************************************************
+uint8_t RCC_ClockConfig(const RCC_ClockConfig_t *pConfig)
+{
+	RCC_PLLConfig_t pll = pConfig->PLL;
+	uint32_t inHz = (pConfig->PLLSource == RCC_PLLSRC_HSE) ? HSE_VALUE : HSI_VALUE;
+	uint32_t sysHz, hclkHz, latency, cfgr;
+	uint8_t hpre = RCC_AHBCode(pConfig->AHBDiv ? pConfig->AHBDiv : 1);
+	uint8_t useHSE = (pConfig->Source == RCC_SYSCLK_HSE) ||
+					 ((pConfig->Source == RCC_SYSCLK_PLL) && (pConfig->PLLSource == RCC_PLLSRC_HSE));
+
+	// Frequencies first, so nothing is changed when the configuration is wrong
+	if(pConfig->Source == RCC_SYSCLK_PLL)
+	{
+		if( (pll.M == 0) && (RCC_PLLSolve(inHz, pConfig->SysclkHz, &pll) != RCC_OK) )
+		{
+			return RCC_ERR_CONFIG;
+		}
+		if(RCC_PLLCheck(inHz, &pll) != RCC_OK)
+		{
+			return RCC_ERR_CONFIG;
+		}
+		sysHz = (uint32_t)((uint64_t)inHz * pll.N / pll.M / pll.P);
+	}
+	else
+	{
+		sysHz = (pConfig->Source == RCC_SYSCLK_HSE) ? HSE_VALUE : HSI_VALUE;
+	}
+	if(hpre == 0xFF)
+	{
+		return RCC_ERR_CONFIG;
+	}
+	hclkHz = sysHz / AHBPrescaler[hpre];
+	latency = (hclkHz - 1) / RCC_FLASH_WS_HZ;
+
+	// Run from HSI while the PLL and the oscillators are changed
+	REG_SET_BITS(RCC->CR, RCC_CR_HSION);
+	(void)RCC_WaitFlag(&RCC->CR, RCC_CR_HSIRDY, RCC_CR_HSIRDY);
+	REG_CLR_BITS(RCC->CFGR, RCC_CFGR_SW_MASK);
+	(void)RCC_WaitFlag(&RCC->CFGR, RCC_CFGR_SWS_MASK, 0);
+
+	if(useHSE)
+	{
+		if(pConfig->HSEBypass == ENABLE)	{ REG_SET_BITS(RCC->CR, RCC_CR_HSEBYP); }
+		else								{ REG_CLR_BITS(RCC->CR, RCC_CR_HSEBYP); }
+		REG_SET_BITS(RCC->CR, RCC_CR_HSEON);
+		if(!RCC_WaitFlag(&RCC->CR, RCC_CR_HSERDY, RCC_CR_HSERDY))
+		{
+			REG_CLR_BITS(RCC->CR, RCC_CR_HSEON);
+			return RCC_ERR_HSE_TIMEOUT;
+		}
+	}
+
+	// The PLL can only be configured while it is off
+	REG_CLR_BITS(RCC->CR, RCC_CR_PLLON);
+	(void)RCC_WaitFlag(&RCC->CR, RCC_CR_PLLRDY, 0);
+	if(pConfig->Source == RCC_SYSCLK_PLL)
+	{
+		REG_WRITE(RCC->PLLCFGR, ((uint32_t)pll.M << RCC_PLLCFGR_M_POS) |
+								((uint32_t)pll.N << RCC_PLLCFGR_N_POS) |
+								((uint32_t)((pll.P / 2) - 1) << RCC_PLLCFGR_P_POS) |
+								((pConfig->PLLSource == RCC_PLLSRC_HSE) ? RCC_PLLCFGR_SRC_HSE : 0) |
+								((uint32_t)pll.Q << RCC_PLLCFGR_Q_POS));
+		REG_SET_BITS(RCC->CR, RCC_CR_PLLON);
+		if(!RCC_WaitFlag(&RCC->CR, RCC_CR_PLLRDY, RCC_CR_PLLRDY))
+		{
+			REG_CLR_BITS(RCC->CR, RCC_CR_PLLON);
+			return RCC_ERR_PLL_TIMEOUT;
+		}
+	}
+
+	// More wait states before the clock goes up, read back to be sure they are in effect
+	if(latency > FLASH_GetLatency())
+	{
+		FLASH_SetLatency((uint8_t)latency);
+	}
+
+	// Prescalers and the switch in one write, the APB buses never run above their limit
+	cfgr = REG_READ(RCC->CFGR);
+	cfgr &= ~( RCC_CFGR_SW_MASK | (0xFU << RCC_CFGR_HPRE_POS) | (0x7U << RCC_CFGR_PPRE1_POS) | (0x7U << RCC_CFGR_PPRE2_POS) );
+	cfgr |= ((uint32_t)hpre << RCC_CFGR_HPRE_POS);
+	cfgr |= ((uint32_t)RCC_APBCode(hclkHz, RCC_PCLK1_MAX) << RCC_CFGR_PPRE1_POS);
+	cfgr |= ((uint32_t)RCC_APBCode(hclkHz, RCC_PCLK2_MAX) << RCC_CFGR_PPRE2_POS);
+	cfgr |= pConfig->Source;
+	REG_WRITE(RCC->CFGR, cfgr);
+	(void)RCC_WaitFlag(&RCC->CFGR, RCC_CFGR_SWS_MASK, (uint32_t)pConfig->Source << RCC_CFGR_SWS_POS);
+
+	// Fewer wait states only when the clock is already down
+	FLASH_SetLatency((uint8_t)latency);
+
+	if(!useHSE)
+	{
+		REG_CLR_BITS(RCC->CR, RCC_CR_HSEON);
+	}
+
+	return RCC_OK;
+}
+
+// *************************************************************
+// * @fn			- RCC_GetSysclkFreq		                   *
+// * 						                                   *
+// * @brief			- Returns the SYSCLK frequency			   *
+// * 						                                   *
+// * @return		- Frequency in Hz                          *
+// *														   *
+// * @note			- Read from RCC CFGR and PLLCFGR, assumes  *
+// * 				  the HSE runs at HSE_VALUE				   *
+// *************************************************************
+uint32_t RCC_GetSysclkFreq(void)
+{
+	uint32_t sws = (REG_READ(RCC->CFGR) & RCC_CFGR_SWS_MASK) >> RCC_CFGR_SWS_POS;
+	uint32_t pllcfgr, inHz, m, n, p;
+
+	if(sws == RCC_SYSCLK_HSI)
+	{
+		return HSI_VALUE;
+	}
+	if(sws == RCC_SYSCLK_HSE)
+	{
+		return HSE_VALUE;
+	}
+
+	pllcfgr = REG_READ(RCC->PLLCFGR);
+	inHz = (pllcfgr & RCC_PLLCFGR_SRC_HSE) ? HSE_VALUE : HSI_VALUE;
+	m = (pllcfgr >> RCC_PLLCFGR_M_POS) & 0x3FU;
+	n = (pllcfgr >> RCC_PLLCFGR_N_POS) & 0x1FFU;
+	p = (((pllcfgr >> RCC_PLLCFGR_P_POS) & 0x3U) + 1) * 2;
+
+	return (m == 0) ? 0 : (uint32_t)((uint64_t)inHz * n / m / p);
+}
+
+uint32_t RCC_GetHCLKFreq(void)
+{
+	return RCC_GetSysclkFreq() / AHBPrescaler[(REG_READ(RCC->CFGR) >> RCC_CFGR_HPRE_POS) & 0xFU];
+}
+
+uint32_t RCC_GetPCLK1Freq(void)
+{
+	return RCC_GetHCLKFreq() / APBPrescaler[(REG_READ(RCC->CFGR) >> RCC_CFGR_PPRE1_POS) & 0x7U];
+}
+
+uint32_t RCC_GetPCLK2Freq(void)
+{
+	return RCC_GetHCLKFreq() / APBPrescaler[(REG_READ(RCC->CFGR) >> RCC_CFGR_PPRE2_POS) & 0x7U];
+}
+
+// *************************************************************
+// * @fn			- RCC_GetTimerClockFreq	                   *
+// * 						                                   *
+// * @brief			- Returns the input clock of a timer	   *
+// * 						                                   *
+// * @param[in]		- TIM1 - TIM8							   *
+// * 						                                   *
+// * @return		- Frequency in Hz                          *
+// *														   *
+// * @note			- 2 x PCLKx when the APBx prescaler is not *
+// * 				  1 (ch. 6.2)							   *
+// *************************************************************
+uint32_t RCC_GetTimerClockFreq(TIM_RegDef_t *pTIMx)
+{
+	uint8_t apb2 = (pTIMx == TIM1) || (pTIMx == TIM8);
+	uint32_t ppre = (REG_READ(RCC->CFGR) >> (apb2 ? RCC_CFGR_PPRE2_POS : RCC_CFGR_PPRE1_POS)) & 0x7U;
+	uint32_t pclk = apb2 ? RCC_GetPCLK2Freq() : RCC_GetPCLK1Freq();
+
+	return (APBPrescaler[ppre] == 1) ? pclk : (2 * pclk);
+}
+
+// xxxENR of the bus of a clock id, or xxxLPENR
+static __vo uint32_t *RCC_ClockReg(uint8_t ClkId, uint8_t LowPower)
+{
+	uint32_t offset = EnableRegOffset[RCC_CLK_BUS(ClkId)] + (LowPower ? RCC_LPENR_DISTANCE : 0);
+
+	return (__vo uint32_t*)((uintptr_t)RCC + offset);
+}
+
+// Writes the ENR and LPENR bits of a clock from its user counts
+static void RCC_ClockUpdate(uint8_t ClkId)
+{
+	uint8_t bit = RCC_CLK_BIT(ClkId);
+
+	REG_BB_WRITE(*RCC_ClockReg(ClkId, 0), bit, (ClockUsers[ClkId] != 0));
+	REG_BB_WRITE(*RCC_ClockReg(ClkId, 1), bit, (SleepUsers[ClkId] != 0));
+}
+
+// *************************************************************
+// * @fn			- RCC_PeriphClockEnable	                   *
+// * 						                                   *
+// * @brief			- Adds a user to a peripheral clock, the   *
+// * 				  clock is turned on by the first one	   *
+// * 						                                   *
+// * @param[in]		- Clock id, @RCC_CLK_IDS				   *
+// * @param[in]		- RCC_CLK_IN_SLEEP if the peripheral must  *
+// * 				  run in Sleep mode, else RCC_CLK_RUN_ONLY *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Counts saturate at 255, the clock then   *
+// * 				  stays on.								   *
+// *************************************************************
+void RCC_PeriphClockEnable(uint8_t ClkId, uint8_t Sleep)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	if(ClockUsers[ClkId] != 0xFF)
+	{
+		ClockUsers[ClkId]++;
+	}
+	if( (Sleep == RCC_CLK_IN_SLEEP) && (SleepUsers[ClkId] != 0xFF) )
+	{
+		if(SleepUsers[ClkId]++ == 0)
+		{
+			SleepClocks++;
+		}
+	}
+	RCC_ClockUpdate(ClkId);
+
+	__set_PRIMASK(primask);
+}
+
+// *************************************************************
+// * @fn			- RCC_PeriphClockDisable                   *
+// * 						                                   *
+// * @brief			- Removes a user from a peripheral clock,  *
+// * 				  the clock goes off with the last one	   *
+// * 						                                   *
+// * @param[in]		- Clock id, @RCC_CLK_IDS				   *
+// * @param[in]		- Same as given to RCC_PeriphClockEnable   *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Without users the clock is turned off,   *
+// * 				  also when it was turned on by the		   *
+// * 				  xxx_PCLK_EN macros.					   *
+// *************************************************************
+void RCC_PeriphClockDisable(uint8_t ClkId, uint8_t Sleep)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	if( (ClockUsers[ClkId] != 0) && (ClockUsers[ClkId] != 0xFF) )
+	{
+		ClockUsers[ClkId]--;
+	}
+	if( (Sleep == RCC_CLK_IN_SLEEP) && (SleepUsers[ClkId] != 0) && (SleepUsers[ClkId] != 0xFF) )
+	{
+		if(--SleepUsers[ClkId] == 0)
+		{
+			SleepClocks--;
+		}
+	}
+	RCC_ClockUpdate(ClkId);
+
+	__set_PRIMASK(primask);
+}
+
+// *************************************************************
+// * @fn			- RCC_PeriphSleepControl                   *
+// * 						                                   *
+// * @brief			- Adds or removes a Sleep mode user of a   *
+// * 				  peripheral clock						   *
+// * 						                                   *
+// * @param[in]		- Clock id, @RCC_CLK_IDS				   *
+// * @param[in]		- ENABLE or DISABLE macros	               *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- For a driver that has its clock already  *
+// * 				  and keeps it in Sleep mode only while an *
+// * 				  interrupt or DMA transfer runs. The run  *
+// * 				  count is not changed. May be called from *
+// * 				  interrupts.							   *
+// *************************************************************
+void RCC_PeriphSleepControl(uint8_t ClkId, uint8_t EnorDi)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	if(EnorDi == ENABLE)
+	{
+		if( (SleepUsers[ClkId] != 0xFF) && (SleepUsers[ClkId]++ == 0) )
+		{
+			SleepClocks++;
+		}
+	}
+	else if( (SleepUsers[ClkId] != 0) && (SleepUsers[ClkId] != 0xFF) )
+	{
+		if(--SleepUsers[ClkId] == 0)
+		{
+			SleepClocks--;
+		}
+	}
+	REG_BB_WRITE(*RCC_ClockReg(ClkId, 1), RCC_CLK_BIT(ClkId), (SleepUsers[ClkId] != 0));
+
+	__set_PRIMASK(primask);
+}
+
+uint8_t RCC_PeriphClockUsers(uint8_t ClkId)
+{
+	return ClockUsers[ClkId];
+}
+
+uint8_t RCC_PeriphSleepUsers(uint8_t ClkId)
+{
+	return SleepUsers[ClkId];
+}
+
+// *************************************************************
+// * @fn			- RCC_StopAllowed		                   *
+// * 						                                   *
+// * @brief			- Tells if Stop mode would stop a		   *
+// * 				  peripheral that is in use				   *
+// * 						                                   *
+// * @return		- 1 if no peripheral clock has a Sleep	   *
+// * 				  mode user, else 0						   *
+// *														   *
+// * @note			- SysTick stops in Stop mode as well, the  *
+// * 				  caller checks its own timers.			   *
+// *************************************************************
+uint8_t RCC_StopAllowed(void)
+{
+	return (SleepClocks == 0);
+}
+
+// *************************************************************
+// * @fn			- RCC_Sleep				                   *
+// * 						                                   *
+// * @brief			- Sleep mode until the next interrupt	   *
+// * 						                                   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Only the peripherals with a Sleep mode   *
+// * 				  user keep their clock. Wakes up within a *
+// * 				  few cycles, nothing has to be restored.  *
+// *************************************************************
+void RCC_Sleep(void)
+{
+	REG_CLR_BITS(SCB_SCR, SCB_SCR_SLEEPDEEP);
+	__WFI();
+}
+
+// *************************************************************
+// * @fn			- RCC_Stop				                   *
+// * 						                                   *
+// * @brief			- Stop mode until an EXTI line wakes the   *
+// * 				  core, then the clock is set up again	   *
+// * 						                                   *
+// * @param[in]		- Clock configuration to restore		   *
+// *														   *
+// * @return		- Result of RCC_ClockConfig                *
+// *														   *
+// * @note			- The regulator goes to low-power mode.    *
+// * 				  The flash stays powered (FPDS = 0), it   *
+// * 				  would add its start-up time to every	   *
+// * 				  wakeup. The core wakes on HSI, the	   *
+// * 				  restore waits for HSE and the PLL.	   *
+// *************************************************************
+uint8_t RCC_Stop(const RCC_ClockConfig_t *pConfig)
+{
+	// PWR keeps its registers with the clock off
+	RCC_PeriphClockEnable(RCC_CLK_PWR, RCC_CLK_RUN_ONLY);
+	REG_MODIFY(PWR->CR, PWR_CR_PDDS | PWR_CR_FPDS, PWR_CR_LPDS | PWR_CR_CWUF);
+	RCC_PeriphClockDisable(RCC_CLK_PWR, RCC_CLK_RUN_ONLY);
+
+	REG_SET_BITS(SCB_SCR, SCB_SCR_SLEEPDEEP);
+	__WFI();
+	REG_CLR_BITS(SCB_SCR, SCB_SCR_SLEEPDEEP);
+
+	return RCC_ClockConfig(pConfig);
+}
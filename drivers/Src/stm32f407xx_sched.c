@@ -0,0 +1,317 @@
+/*
+ * stm32f407xx_sched.c
+ *
+ *  Created on: Feb 5, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_sched.h"
+
+// Priority p is bit 31 - p, so CLZ of the ready word is the highest ready priority
+#define SCHED_PRIO_BIT(Prio)		(31U - (Prio))
+
+static RING_Index_t Ready;						// Priorities with events waiting, in SRAM for the bit-band
+static SCHED_Task_t *Tasks[SCHED_MAX_PRIO];
+static uint32_t IdleCount;
+
+static void SCHED_WorkHandler(SCHED_Task_t *pTask, const SCHED_Event_t *pEvent);
+
+SCHED_TASK_DEFINE(WorkTask, SCHED_WorkHandler, NULL, SCHED_WORK_QUEUE_LEN);
+
+static void SCHED_WorkHandler(SCHED_Task_t *pTask, const SCHED_Event_t *pEvent)
+{
+	SCHED_Work_t *pWork = (SCHED_Work_t*)pEvent->Param;
+
+	(void)pTask;
+	pWork->pFunc(pWork->pArg);
+}
+
+static void SCHED_PeriodicCallback(void *pArg)
+{
+	SCHED_Periodic_t *pPeriodic = (SCHED_Periodic_t*)pArg;
+
+	SCHED_Post(pPeriodic->pTask, pPeriodic->Signal, TIMEBASE_GetMs());
+}
+
+// *************************************************************
+// * @fn			- SCHED_Init			                   *
+// * 						                                   *
+// * @brief			- Clears the scheduler and starts the work *
+// * 				  task									   *
+// * 						                                   *
+// * @param[in]		- Priority of the deferred work, 0 - 31    *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Starts the DWT cycle counter for the run *
+// * 				  time statistics. Call before the tasks   *
+// * 				  are started.							   *
+// *************************************************************
+void SCHED_Init(uint8_t WorkPriority)
+{
+	for(uint8_t i = 0; i < SCHED_MAX_PRIO; i++)
+	{
+		Tasks[i] = NULL;
+	}
+	RING_STORE_RELEASE(&Ready, 0);
+	IdleCount = 0;
+
+	REG_SET_BITS(DEMCR, DEMCR_TRCENA);
+	REG_SET_BITS(DWT->CTRL, DWT_CTRL_CYCCNTENA);
+
+	SCHED_TaskStart(&WorkTask, WorkPriority);
+}
+
+// *************************************************************
+// * @fn			- SCHED_TaskStart		                   *
+// * 						                                   *
+// * @brief			- Gives a task its priority and empties	   *
+// * 				  its queue								   *
+// * 						                                   *
+// * @param[in]		- Task from SCHED_TASK_DEFINE			   *
+// * @param[in]		- 0 (highest) - 31, not used by another	   *
+// * 				  task									   *
+// *														   *
+// * @return		- SCHED_OK or SCHED_ERR_PARAM              *
+// *														   *
+// * @note			- Start a task before the interrupts that  *
+// * 				  post to it are enabled.				   *
+// *************************************************************
+uint8_t SCHED_TaskStart(SCHED_Task_t *pTask, uint8_t Priority)
+{
+	if( (Priority >= SCHED_MAX_PRIO) || (Tasks[Priority] != NULL) )
+	{
+		return SCHED_ERR_PARAM;
+	}
+
+	RING_MPSC_Init(pTask->pQueue);
+	pTask->Priority = Priority;
+	pTask->ReadyBit = SCHED_PRIO_BIT(Priority);
+	SCHED_ResetStats(pTask);
+	Tasks[Priority] = pTask;
+
+	return SCHED_OK;
+}
+
+// *************************************************************
+// * @fn			- SCHED_Post			                   *
+// * 						                                   *
+// * @brief			- Queues an event for a task			   *
+// * 						                                   *
+// * @param[in]		- Task                                     *
+// * @param[in]		- Signal, SCHED_SIG_USER and up			   *
+// * @param[in]		- Parameter of the event				   *
+// *														   *
+// * @return		- SCHED_OK or SCHED_ERR_FULL               *
+// *														   *
+// * @note			- O(1), from interrupts and tasks. The	   *
+// * 				  priority is marked ready after the event *
+// * 				  is in the queue, so the dispatcher never *
+// * 				  sees a ready task without its event.	   *
+// *************************************************************
+uint8_t SCHED_Post(SCHED_Task_t *pTask, uint32_t Signal, uintptr_t Param)
+{
+	SCHED_Event_t event = { Signal, Param };
+
+	if(!RING_MPSC_Push(pTask->pQueue, &event))
+	{
+		uint32_t dropped = RING_LOAD(&pTask->Dropped);
+
+		while(!RING_CompareExchange(&pTask->Dropped, &dropped, dropped + 1));
+		return SCHED_ERR_FULL;
+	}
+
+	SRAM_BB_SET(Ready, pTask->ReadyBit);		// One store, an interrupt in between can not undo it
+	return SCHED_OK;
+}
+
+// *************************************************************
+// * @fn			- SCHED_Defer			                   *
+// * 						                                   *
+// * @brief			- Runs a function later from the work task *
+// * 						                                   *
+// * @param[in]		- Work item with the function and argument *
+// *														   *
+// * @return		- SCHED_OK or SCHED_ERR_FULL               *
+// *														   *
+// * @note			- From interrupts and tasks. The item is   *
+// * 				  not copied, it may be queued again once  *
+// * 				  its function has started.				   *
+// *************************************************************
+uint8_t SCHED_Defer(SCHED_Work_t *pWork)
+{
+	return SCHED_Post(&WorkTask, SCHED_SIG_WORK, (uintptr_t)pWork);
+}
+
+// *************************************************************
+// * @fn			- SCHED_PeriodicStart	                   *
+// * 						                                   *
+// * @brief			- Posts an event to a task every PeriodMs  *
+// * 						                                   *
+// * @param[in]		- Periodic event, owned by the caller	   *
+// * @param[in]		- Task                                     *
+// * @param[in]		- Signal posted							   *
+// * @param[in]		- Period in ms, the first event comes one  *
+// * 				  period from now						   *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- The event is posted from				   *
+// * 				  TIMEBASE_Process, which SCHED_Run calls. *
+// *************************************************************
+void SCHED_PeriodicStart(SCHED_Periodic_t *pPeriodic, SCHED_Task_t *pTask, uint32_t Signal, uint32_t PeriodMs)
+{
+	pPeriodic->pTask = pTask;
+	pPeriodic->Signal = Signal;
+	TIMEBASE_TimerStart(&pPeriodic->Timer, PeriodMs, PeriodMs, SCHED_PeriodicCallback, pPeriodic);
+}
+
+void SCHED_PeriodicStop(SCHED_Periodic_t *pPeriodic)
+{
+	TIMEBASE_TimerStop(&pPeriodic->Timer);
+}
+
+// *************************************************************
+// * @fn			- SCHED_RunOnce			                   *
+// * 						                                   *
+// * @brief			- Handles one event of the highest ready   *
+// * 				  priority								   *
+// * 						                                   *
+// * @return		- 1 if a priority was ready, else 0        *
+// *														   *
+// * @note			- Only one event per call, so an event	   *
+// * 				  posted to a higher priority meanwhile is *
+// * 				  next, it waits for one handler at most.  *
+// *************************************************************
+uint8_t SCHED_RunOnce(void)
+{
+	uint32_t ready = RING_LOAD_ACQUIRE(&Ready);
+	SCHED_Task_t *pTask;
+	RING_MPSC_t *pQueue;
+	SCHED_Event_t event;
+
+	if(ready == 0)
+	{
+		return 0;
+	}
+
+	pTask = Tasks[__CLZ(ready)];
+	pQueue = pTask->pQueue;
+
+	// The queue only shrinks here, so its longest length is seen just before a pop
+	uint32_t waiting = RING_LOAD(&pQueue->Head) - pQueue->Tail;
+	if(waiting > pTask->QueueHighWater)
+	{
+		pTask->QueueHighWater = waiting;
+	}
+
+	if(RING_MPSC_Pop(pQueue, &event))
+	{
+		uint32_t start = PROFILER_Now();
+
+		pTask->pHandler(pTask, &event);
+
+		uint32_t cycles = PROFILER_Now() - start;
+		pTask->RunCount++;
+		pTask->RunCycles += cycles;
+		if(cycles > pTask->MaxCycles)
+		{
+			pTask->MaxCycles = cycles;
+		}
+	}
+
+	// Clear the bit when the queue is empty. An event posted between the check and the clear
+	// would lose its bit, so look again after the clear.
+	if(RING_MPSC_Empty(pQueue))
+	{
+		SRAM_BB_CLR(Ready, pTask->ReadyBit);
+		if(!RING_MPSC_Empty(pQueue))
+		{
+			SRAM_BB_SET(Ready, pTask->ReadyBit);
+		}
+	}
+
+	return 1;
+}
+
+// *************************************************************
+// * @fn			- SCHED_Run				                   *
+// * 						                                   *
+// * @brief			- Main loop: timers, events and sleep	   *
+// * 						                                   *
+// * @return		- Never returns                            *
+// *														   *
+// * @note			- Sleeps with interrupts masked, so an	   *
+// * 				  interrupt after the last check still	   *
+// * 				  wakes the core (WFI wakes on a pending   *
+// * 				  interrupt even when it is masked) and	   *
+// * 				  runs once PRIMASK is restored.		   *
+// *************************************************************
+void SCHED_Run(void)
+{
+	while(1)
+	{
+		TIMEBASE_Process();
+
+		if(SCHED_RunOnce())
+		{
+			continue;
+		}
+
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		if( (RING_LOAD(&Ready) == 0) && !TIMEBASE_Pending() )
+		{
+			IdleCount++;
+			SCHED_IdleHook();
+		}
+		__set_PRIMASK(primask);
+	}
+}
+
+// *************************************************************
+// * @fn			- SCHED_ResetStats		                   *
+// * 						                                   *
+// * @brief			- Clears the statistics of a task		   *
+// * 						                                   *
+// * @param[in]		- Task                                     *
+// *														   *
+// * @return		- None                                     *
+// *************************************************************
+void SCHED_ResetStats(SCHED_Task_t *pTask)
+{
+	pTask->RunCount = 0;
+	pTask->RunCycles = 0;
+	pTask->MaxCycles = 0;
+	pTask->QueueHighWater = 0;
+	RING_STORE_RELEASE(&pTask->Dropped, 0);
+}
+
+// *************************************************************
+// * @fn			- SCHED_IdleHook		                   *
+// * 						                                   *
+// * @brief			- Sleeps until the next interrupt		   *
+// * 						                                   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Weak. Called with interrupts masked when *
+// * 				  nothing is ready. Sleep mode keeps		   *
+// * 				  SysTick and the timers running. An	   *
+// * 				  application that can wake up from an	   *
+// * 				  EXTI line may use RCC_Stop instead when  *
+// * 				  RCC_StopAllowed says so.				   *
+// *************************************************************
+__weak void SCHED_IdleHook(void)
+{
+	RCC_Sleep();
+}
+
+uint32_t SCHED_GetIdleCount(void)
+{
+	return IdleCount;
+}
+
+SCHED_Task_t *SCHED_GetWorkTask(void)
+{
+	return &WorkTask;
+}
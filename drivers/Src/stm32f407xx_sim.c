@@ -0,0 +1,917 @@
+/*
+ * stm32f407xx_sim.c
+ *
+ *  Created on: Nov 6, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_sim.h"
+#include "stm32f407xx_gpio_driver.h"
+
+#ifdef STM32F407XX_SIM
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
+
+// Bus memory, the base address macros in stm32f407xx.h point here
+uint32_t SIM_APB1Mem[SIM_APB1_SIZE / 4];
+uint32_t SIM_APB2Mem[SIM_APB2_SIZE / 4];
+uint32_t SIM_AHB1Mem[SIM_AHB1_SIZE / 4];
+uint32_t SIM_AHB2Mem[SIM_AHB2_SIZE / 4];
+uint32_t SIM_PPBMem[SIM_PPB_SIZE / 4];
+
+// Read and write counters, one per register word of each bus
+static uint32_t APB1Reads[SIM_APB1_SIZE / 4], APB1Writes[SIM_APB1_SIZE / 4];
+static uint32_t APB2Reads[SIM_APB2_SIZE / 4], APB2Writes[SIM_APB2_SIZE / 4];
+static uint32_t AHB1Reads[SIM_AHB1_SIZE / 4], AHB1Writes[SIM_AHB1_SIZE / 4];
+static uint32_t AHB2Reads[SIM_AHB2_SIZE / 4], AHB2Writes[SIM_AHB2_SIZE / 4];
+static uint32_t PPBReads[SIM_PPB_SIZE / 4], PPBWrites[SIM_PPB_SIZE / 4];
+
+typedef struct
+{
+	uint32_t *pMem;
+	uint32_t *pReads;
+	uint32_t *pWrites;
+	uint32_t Size;		// In bytes
+}SIM_Region_t;
+
+static const SIM_Region_t Regions[] =
+{
+	{ SIM_APB1Mem, APB1Reads, APB1Writes, SIM_APB1_SIZE },
+	{ SIM_APB2Mem, APB2Reads, APB2Writes, SIM_APB2_SIZE },
+	{ SIM_AHB1Mem, AHB1Reads, AHB1Writes, SIM_AHB1_SIZE },
+	{ SIM_AHB2Mem, AHB2Reads, AHB2Writes, SIM_AHB2_SIZE },
+	{ SIM_PPBMem,  PPBReads,  PPBWrites,  SIM_PPB_SIZE  },
+};
+
+#define SIM_NUM_REGIONS			( sizeof(Regions) / sizeof(Regions[0]) )
+
+#define SIM_GPIO_PORTS			9			// GPIOA ... GPIOI
+#define SIM_GPIO_PORT_SIZE		0x400U		// Address space of one port on AHB1
+#define SIM_RCC_OFFSET			(RCC_BASEADDR - AHB1PERIPH_BASEADDR)
+#define SIM_DMA1_OFFSET			(DMA1_BASEADDR - AHB1PERIPH_BASEADDR)
+#define SIM_DMA2_OFFSET			(DMA2_BASEADDR - AHB1PERIPH_BASEADDR)
+#define SIM_EXTI_OFFSET			(EXTI_BASE - APB2PERIPH_BASEADDR)
+#define SIM_TIM_SIZE			0x400U		// Address space of one timer, TIM2 - TIM7 on APB1, TIM1/TIM8 on APB2
+#define SIM_NVIC_ISER_OFFSET	(NVIC_ISER_BASEADDR - PPB_BASEADDR)
+#define SIM_NVIC_ICER_OFFSET	(NVIC_ICER_BASEADDR - PPB_BASEADDR)
+#define SIM_SYSTICK_OFFSET		(SYSTICK_BASEADDR - PPB_BASEADDR)
+
+// Core cycles that pass between two reads of SysTick VAL, the cost of one pass of a polling
+// loop. Without it a busy-wait on SysTick would never end on the host.
+#define SIM_SYSTICK_CYCLES_PER_READ		8
+
+// Level driven on the pins by the outside world, see SIM_SetInputPort
+static uint16_t InputLevel[SIM_GPIO_PORTS];
+
+// Core cycles each peripheral clock ran, index is the RCC clock id (bus * 32 + bit)
+static uint64_t ClockOnCycles[RCC_CLK_COUNT];
+
+// NDTR of each DMA stream when it was enabled, reloaded at the end of a circular buffer
+static uint16_t DMAReload[2][8];
+
+// One simulated bus access at a time. Test threads that stand in for interrupts can then use
+// the drivers together: every SIM_Read/SIM_Write is atomic with its side effects and its
+// counter, as an access on the real bus is. Only the SIM_xxx entry points take the lock, the
+// functions below them work on the bus memory directly.
+static atomic_flag BusLock = ATOMIC_FLAG_INIT;
+
+static inline void SIM_Lock(void)
+{
+	while(atomic_flag_test_and_set_explicit(&BusLock, memory_order_acquire))
+	{
+	}
+}
+
+static inline void SIM_Unlock(void)
+{
+	atomic_flag_clear_explicit(&BusLock, memory_order_release);
+}
+
+// Register offset inside a peripheral
+#define REG_OFFSET(TYPE, REG)	( (uint32_t)offsetof(TYPE, REG) )
+
+// Finds the bus of a register. Returns NULL for memory that is not simulated.
+static const SIM_Region_t *SIM_FindRegion(__vo uint32_t *pReg, uint32_t *pOffset)
+{
+	uintptr_t addr = (uintptr_t)pReg;
+
+	for(uint32_t i = 0; i < SIM_NUM_REGIONS; i++)
+	{
+		uintptr_t base = (uintptr_t)Regions[i].pMem;
+
+		if( (addr >= base) && (addr < base + Regions[i].Size) )
+		{
+			*pOffset = (uint32_t)(addr - base);
+			return &Regions[i];
+		}
+	}
+
+	return NULL;
+}
+
+static GPIO_RegDef_t *SIM_GPIOPort(uint8_t PortIndex)
+{
+	return (GPIO_RegDef_t*)( GPIOA_BASEADDR + PortIndex * SIM_GPIO_PORT_SIZE );
+}
+
+// Sets the EXTI pending bits for the edges seen on the pins of a port. Only lines that are
+// routed to the port in SYSCFG_EXTICR, unmasked in EXTI_IMR and have the edge enabled fire.
+static void SIM_DetectEdges(uint8_t PortIndex, uint32_t OldIDR, uint32_t NewIDR)
+{
+	uint32_t rising = NewIDR & ~OldIDR;
+	uint32_t falling = OldIDR & ~NewIDR;
+	uint32_t lines = ( (rising & EXTI->RTSR) | (falling & EXTI->FTSR) ) & EXTI->IMR;
+
+	for(uint8_t line = 0; line < 16; line++)
+	{
+		if( (lines & (1U << line)) &&
+			(((SYSCFG->EXTICR[line / 4] >> (4 * (line % 4))) & 0xFU) == PortIndex) )
+		{
+			EXTI->PR |= (1U << line);
+		}
+	}
+}
+
+// IDR follows ODR on output pins (MODER = 01) and the external level on all other pins
+static void SIM_UpdateIDR(uint8_t PortIndex)
+{
+	GPIO_RegDef_t *pPort = SIM_GPIOPort(PortIndex);
+	uint32_t oldIDR = pPort->IDR;
+	uint32_t outPins = 0;
+
+	for(uint8_t pin = 0; pin < 16; pin++)
+	{
+		if( ((pPort->MODER >> (2 * pin)) & 0x3U) == GPIO_MODE_OUT )
+		{
+			outPins |= (1U << pin);
+		}
+	}
+
+	pPort->IDR = (pPort->ODR & outPins) | (InputLevel[PortIndex] & ~outPins);
+
+	SIM_DetectEdges(PortIndex, oldIDR, pPort->IDR);
+}
+
+// Reset values of the GPIO registers (ch. 8.4), port A and B have the debug pins configured
+static void SIM_ResetGPIOPort(uint8_t PortIndex)
+{
+	GPIO_RegDef_t *pPort = SIM_GPIOPort(PortIndex);
+
+	memset((void*)pPort, 0, sizeof(GPIO_RegDef_t));
+
+	if(PortIndex == 0)
+	{
+		pPort->MODER   = 0xA8000000U;
+		pPort->OSPEEDR = 0x0C000000U;
+		pPort->PUPDR   = 0x64000000U;
+	}
+	else if(PortIndex == 1)
+	{
+		pPort->MODER   = 0x00000280U;
+		pPort->OSPEEDR = 0x000000C0U;
+		pPort->PUPDR   = 0x00000100U;
+	}
+
+	SIM_UpdateIDR(PortIndex);
+}
+
+// Reset values of the RCC registers (ch. 7.3)
+static void SIM_ResetRCC(void)
+{
+	memset((void*)RCC, 0, sizeof(RCC_RegDef_t));
+
+	RCC->CR        = 0x00000083U;
+	RCC->PLLCFGR   = 0x24003010U;
+	RCC->AHB1ENR   = 0x00100000U;
+	RCC->AHB1LPENR = 0x7E6791FFU;
+	RCC->AHB2LPENR = 0x000000F1U;
+	RCC->AHB3LPENR = 0x00000001U;
+	RCC->APB1LPENR = 0x36FEC9FFU;
+	RCC->APB2LPENR = 0x00075F33U;
+	RCC->CSR       = 0x0E000000U;
+	RCC->PLLI2SCFGR = 0x20003000U;
+}
+
+// Write to a GPIO port register. Returns 1 if the write was handled here.
+static uint8_t SIM_WriteGPIO(uint32_t Offset, uint32_t Value)
+{
+	uint8_t port = (uint8_t)(Offset / SIM_GPIO_PORT_SIZE);
+	uint32_t reg = Offset % SIM_GPIO_PORT_SIZE;
+	GPIO_RegDef_t *pPort = SIM_GPIOPort(port);
+
+	if( !(RCC->AHB1ENR & (1U << port)) )
+	{
+		// No clock, the port ignores the write
+		return 1;
+	}
+
+	if(reg == REG_OFFSET(GPIO_RegDef_t, BSRR))
+	{
+		// Set has priority over reset, BSRR itself always reads as 0
+		pPort->ODR = (pPort->ODR & ~(Value >> 16)) | (Value & 0xFFFFU);
+	}
+	else if(reg == REG_OFFSET(GPIO_RegDef_t, IDR))
+	{
+		// Read only
+	}
+	else if(reg == REG_OFFSET(GPIO_RegDef_t, ODR))
+	{
+		pPort->ODR = Value & 0xFFFFU;
+	}
+	else
+	{
+		*(__vo uint32_t*)((uintptr_t)pPort + reg) = Value;
+	}
+
+	SIM_UpdateIDR(port);
+
+	return 1;
+}
+
+// Write to an RCC register. Returns 1 if the write was handled here.
+static uint8_t SIM_WriteRCC(uint32_t Offset, uint32_t Value)
+{
+	if(Offset == REG_OFFSET(RCC_RegDef_t, AHB1RSTR))
+	{
+		uint32_t asserted = Value & ~RCC->AHB1RSTR;
+
+		for(uint8_t port = 0; port < SIM_GPIO_PORTS; port++)
+		{
+			if(asserted & (1U << port))
+			{
+				SIM_ResetGPIOPort(port);
+			}
+		}
+		RCC->AHB1RSTR = Value;
+
+		return 1;
+	}
+	if(Offset == REG_OFFSET(RCC_RegDef_t, CR))
+	{
+		// The oscillators and the PLL are ready at once, the ready bits are read only
+		uint32_t ready = RCC_CR_HSIRDY | RCC_CR_HSERDY | RCC_CR_PLLRDY;
+
+		Value &= ~ready;
+		if(Value & RCC_CR_HSION)	{ Value |= RCC_CR_HSIRDY; }
+		if(Value & RCC_CR_HSEON)	{ Value |= RCC_CR_HSERDY; }
+		if(Value & RCC_CR_PLLON)	{ Value |= RCC_CR_PLLRDY; }
+		RCC->CR = Value;
+
+		return 1;
+	}
+	if(Offset == REG_OFFSET(RCC_RegDef_t, CFGR))
+	{
+		// The switch status follows the switch at once
+		RCC->CFGR = (Value & ~RCC_CFGR_SWS_MASK) | ((Value & RCC_CFGR_SW_MASK) << RCC_CFGR_SWS_POS);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+// SPI the register belongs to, NULL if it is not an SPI register
+static SPI_RegDef_t *SIM_SPIPort(__vo uint32_t *pReg)
+{
+	SPI_RegDef_t *ports[3] = { SPI1, SPI2, SPI3 };
+
+	for(uint8_t i = 0; i < 3; i++)
+	{
+		if( (pReg >= &ports[i]->CR1) && (pReg <= &ports[i]->I2SPR) )
+		{
+			return ports[i];
+		}
+	}
+	return NULL;
+}
+
+// Write to an SPI register. MOSI is looped back to MISO: a frame written to DR of an enabled
+// SPI is received at once. Returns 1 if the write was handled here.
+static uint8_t SIM_WriteSPI(SPI_RegDef_t *pSPIx, __vo uint32_t *pReg, uint32_t Value)
+{
+	if( (pReg != &pSPIx->DR) || !(pSPIx->CR1 & (1U << SPI_CR1_SPE)) )
+	{
+		return 0;
+	}
+
+	if(pSPIx->SR & (1U << SPI_SR_RXNE))
+	{
+		pSPIx->SR |= (1U << SPI_SR_OVR);		// The last frame was not read
+	}
+	pSPIx->DR = Value & ((pSPIx->CR1 & (1U << SPI_CR1_DFF)) ? 0xFFFFU : 0xFFU);
+	pSPIx->SR |= (1U << SPI_SR_RXNE);
+
+	return 1;
+}
+
+// I2C the register belongs to, NULL if it is not an I2C register
+static I2C_RegDef_t *SIM_I2CPort(__vo uint32_t *pReg)
+{
+	I2C_RegDef_t *ports[3] = { I2C1, I2C2, I2C3 };
+
+	for(uint8_t i = 0; i < 3; i++)
+	{
+		if( (pReg >= &ports[i]->CR1) && (pReg <= &ports[i]->FLTR) )
+		{
+			return ports[i];
+		}
+	}
+	return NULL;
+}
+
+// Byte waiting in the shift register of each I2C behind a full DR, see SIM_I2CReceive
+static uint8_t I2CShift[3];
+static uint8_t I2CShiftFull[3];
+
+static uint8_t SIM_I2CIndex(I2C_RegDef_t *pI2Cx)
+{
+	return (pI2Cx == I2C1) ? 0 : ((pI2Cx == I2C2) ? 1 : 2);
+}
+
+// Write to an I2C register. START and STOP conditions are put on the bus at once, the slave
+// side (ADDR, TXE, RXNE, BTF, AF) is left to the test code. Returns 1 if the write was handled here.
+static uint8_t SIM_WriteI2C(I2C_RegDef_t *pI2Cx, __vo uint32_t *pReg, uint32_t Value)
+{
+	if(pReg == &pI2Cx->CR1)
+	{
+		if(Value & (1U << I2C_CR1_STOP))
+		{
+			pI2Cx->SR2 &= ~((1U << I2C_SR2_MSL) | (1U << I2C_SR2_BUSY));
+		}
+		if(Value & (1U << I2C_CR1_START))
+		{
+			pI2Cx->SR1 &= ~((1U << I2C_SR1_BTF) | (1U << I2C_SR1_TXE));
+			pI2Cx->SR1 |= (1U << I2C_SR1_SB);
+			pI2Cx->SR2 |= (1U << I2C_SR2_MSL) | (1U << I2C_SR2_BUSY);
+		}
+		pI2Cx->CR1 = Value & ~((1U << I2C_CR1_START) | (1U << I2C_CR1_STOP));
+		return 1;
+	}
+	if(pReg == &pI2Cx->DR)
+	{
+		pI2Cx->SR1 &= ~((1U << I2C_SR1_SB) | (1U << I2C_SR1_BTF));		// SR1 read then DR write
+	}
+	return 0;
+}
+
+// Read of I2C DR: the byte in the shift register moves up, or RXNE is cleared
+static void SIM_ReadI2CDR(I2C_RegDef_t *pI2Cx)
+{
+	uint8_t i = SIM_I2CIndex(pI2Cx);
+
+	pI2Cx->SR1 &= ~(1U << I2C_SR1_BTF);
+	if(I2CShiftFull[i])
+	{
+		pI2Cx->DR = I2CShift[i];
+		I2CShiftFull[i] = 0;
+	}
+	else
+	{
+		pI2Cx->SR1 &= ~(1U << I2C_SR1_RXNE);
+	}
+}
+
+uint8_t SIM_I2CReceive(I2C_RegDef_t *pI2Cx, uint8_t Value)
+{
+	uint8_t i = SIM_I2CIndex(pI2Cx);
+	uint8_t taken = 1;
+
+	SIM_Lock();
+	if( !(pI2Cx->SR1 & (1U << I2C_SR1_RXNE)) )
+	{
+		pI2Cx->DR = Value;
+		pI2Cx->SR1 |= (1U << I2C_SR1_RXNE);
+	}
+	else if(!I2CShiftFull[i])
+	{
+		I2CShift[i] = Value;
+		I2CShiftFull[i] = 1;
+		pI2Cx->SR1 |= (1U << I2C_SR1_BTF);
+	}
+	else
+	{
+		taken = 0;
+	}
+	SIM_Unlock();
+
+	return taken;
+}
+
+// Sets interrupt flags (DMA_FLAG_xx) of a stream in LISR/HISR, at the positions the DMA driver uses
+static void SIM_DMASetFlags(DMA_RegDef_t *pDMAx, uint8_t Stream, uint32_t Flags)
+{
+	static const uint8_t shift[4] = { 0, 6, 16, 22 };
+
+	if(Stream < 4)	{ pDMAx->LISR |= (Flags << shift[Stream]); }
+	else			{ pDMAx->HISR |= (Flags << shift[Stream - 4]); }
+}
+
+// Write to a DMA controller register. Returns 1 if the write was handled here.
+static uint8_t SIM_WriteDMA(DMA_RegDef_t *pDMAx, uint32_t Offset, uint32_t Value)
+{
+	uint32_t streamOffset = Offset - REG_OFFSET(DMA_RegDef_t, S);
+
+	// Stream CR: a stream disabled while it runs ends its transfer with TCIF set (ch. 10.3.17)
+	if( (Offset >= REG_OFFSET(DMA_RegDef_t, S)) && ((streamOffset % sizeof(DMA_Stream_RegDef_t)) == 0) )
+	{
+		uint8_t stream = (uint8_t)(streamOffset / sizeof(DMA_Stream_RegDef_t));
+		uint32_t old = pDMAx->S[stream].CR;
+
+		pDMAx->S[stream].CR = Value;
+		if( !(old & DMA_SxCR_EN) && (Value & DMA_SxCR_EN) )
+		{
+			DMAReload[(pDMAx == DMA1) ? 0 : 1][stream] = (uint16_t)pDMAx->S[stream].NDTR;
+		}
+		else if( (old & DMA_SxCR_EN) && !(Value & DMA_SxCR_EN) )
+		{
+			SIM_DMASetFlags(pDMAx, stream, DMA_FLAG_TC);
+		}
+		return 1;
+	}
+
+	// Interrupt flag clear registers, write 1 to clear the flag in LISR/HISR
+	if(Offset == REG_OFFSET(DMA_RegDef_t, LIFCR))
+	{
+		pDMAx->LISR &= ~Value;
+		return 1;
+	}
+	if(Offset == REG_OFFSET(DMA_RegDef_t, HIFCR))
+	{
+		pDMAx->HISR &= ~Value;
+		return 1;
+	}
+
+	return 0;
+}
+
+// Write to a timer register, Offset inside the timer. Returns 1 if the write was handled here.
+static uint8_t SIM_WriteTIM(__vo uint32_t *pReg, uint32_t Offset, uint32_t Value)
+{
+	if(Offset == REG_OFFSET(TIM_RegDef_t, SR))
+	{
+		// rc_w0, writing 0 clears a flag, 1 leaves it
+		*pReg &= Value;
+		return 1;
+	}
+
+	return 0;
+}
+
+// Write to an EXTI register. Returns 1 if the write was handled here.
+static uint8_t SIM_WriteEXTI(uint32_t Offset, uint32_t Value)
+{
+	if(Offset == REG_OFFSET(EXTI_RegDef_t, PR))
+	{
+		// Write 1 to clear
+		EXTI->PR &= ~Value;
+		return 1;
+	}
+	if(Offset == REG_OFFSET(EXTI_RegDef_t, SWIER))
+	{
+		// Software interrupt, sets the pending bit of unmasked lines
+		EXTI->PR |= (Value & EXTI->IMR);
+		EXTI->SWIER = Value;
+		return 1;
+	}
+
+	return 0;
+}
+
+// Write to a register of the private peripheral bus. Returns 1 if the write was handled here.
+static uint8_t SIM_WritePPB(uint32_t Offset, uint32_t Value)
+{
+	if(Offset == SIM_SYSTICK_OFFSET + REG_OFFSET(SysTick_RegDef_t, VAL))
+	{
+		// Any write clears the counter and COUNTFLAG
+		SYSTICK->VAL = 0;
+		SYSTICK->CTRL &= ~SYSTICK_CTRL_COUNTFLAG;
+		return 1;
+	}
+
+	// ISER and ICER both read back the enable state, writing 0 has no effect
+	if( (Offset >= SIM_NVIC_ISER_OFFSET) && (Offset < SIM_NVIC_ISER_OFFSET + 32) )
+	{
+		uint32_t n = (Offset - SIM_NVIC_ISER_OFFSET) / 4;
+		NVIC_ISER[n] |= Value;
+		NVIC_ICER[n] = NVIC_ISER[n];
+		return 1;
+	}
+	if( (Offset >= SIM_NVIC_ICER_OFFSET) && (Offset < SIM_NVIC_ICER_OFFSET + 32) )
+	{
+		uint32_t n = (Offset - SIM_NVIC_ICER_OFFSET) / 4;
+		NVIC_ISER[n] &= ~Value;
+		NVIC_ICER[n] = NVIC_ISER[n];
+		return 1;
+	}
+
+	return 0;
+}
+
+// Counts SysTick down, returns the number of SysTick interrupts that are due
+static uint32_t SIM_AdvanceSysTick(uint32_t Cycles)
+{
+	uint32_t period = (SYSTICK->LOAD & SYSTICK_LOAD_MAX) + 1;
+	uint64_t position;
+	uint32_t reloads;
+
+	if( !(SYSTICK->CTRL & SYSTICK_CTRL_ENABLE) )
+	{
+		return 0;
+	}
+
+	// Counts down from LOAD to 0, then reloads
+	position = (uint64_t)(period - 1 - SYSTICK->VAL) + Cycles;
+	reloads = (uint32_t)(position / period);
+	SYSTICK->VAL = period - 1 - (uint32_t)(position % period);
+
+	if(reloads != 0)
+	{
+		SYSTICK->CTRL |= SYSTICK_CTRL_COUNTFLAG;
+	}
+
+	return (SYSTICK->CTRL & SYSTICK_CTRL_TICKINT) ? reloads : 0;
+}
+
+// Adds the cycles to the clocks that run: xxxENR, and xxxLPENR as well when the core sleeps
+static void SIM_CountClocks(uint32_t Cycles, uint8_t Sleeping)
+{
+	static const uint32_t enr[RCC_BUS_COUNT] =
+	{
+		REG_OFFSET(RCC_RegDef_t, AHB1ENR), REG_OFFSET(RCC_RegDef_t, AHB2ENR), REG_OFFSET(RCC_RegDef_t, AHB3ENR),
+		REG_OFFSET(RCC_RegDef_t, APB1ENR), REG_OFFSET(RCC_RegDef_t, APB2ENR)
+	};
+	const uint32_t lpDistance = REG_OFFSET(RCC_RegDef_t, AHB1LPENR) - REG_OFFSET(RCC_RegDef_t, AHB1ENR);
+
+	for(uint8_t bus = 0; bus < RCC_BUS_COUNT; bus++)
+	{
+		uint32_t on = *(uint32_t*)((uintptr_t)RCC + enr[bus]);
+
+		if(Sleeping)
+		{
+			on &= *(uint32_t*)((uintptr_t)RCC + enr[bus] + lpDistance);
+		}
+		while(on != 0)
+		{
+			ClockOnCycles[RCC_CLK_ID(bus, __builtin_ctz(on))] += Cycles;
+			on &= on - 1;
+		}
+	}
+}
+
+static uint32_t SIM_Advance(uint32_t Cycles, uint8_t Sleeping)
+{
+	if( (DEMCR & DEMCR_TRCENA) && (DWT->CTRL & DWT_CTRL_CYCCNTENA) )
+	{
+		DWT->CYCCNT += Cycles;
+	}
+	SIM_CountClocks(Cycles, Sleeping);
+
+	return SIM_AdvanceSysTick(Cycles);
+}
+
+uint32_t SIM_AdvanceCycles(uint32_t Cycles)
+{
+	uint32_t ticks;
+
+	SIM_Lock();
+	ticks = SIM_Advance(Cycles, 0);
+	SIM_Unlock();
+
+	return ticks;
+}
+
+uint32_t SIM_SleepCycles(uint32_t Cycles)
+{
+	uint32_t ticks;
+
+	SIM_Lock();
+	ticks = SIM_Advance(Cycles, 1);
+	SIM_Unlock();
+
+	return ticks;
+}
+
+uint64_t SIM_GetClockOnCycles(uint8_t ClkId)
+{
+	uint64_t cycles;
+
+	SIM_Lock();
+	cycles = ClockOnCycles[ClkId];
+	SIM_Unlock();
+
+	return cycles;
+}
+
+uint32_t SIM_Read(__vo uint32_t *pReg)
+{
+	uint32_t offset;
+	uint32_t value;
+	const SIM_Region_t *pRegion = SIM_FindRegion(pReg, &offset);
+
+	if(pRegion == NULL)
+	{
+		return *pReg;
+	}
+
+	SIM_Lock();
+	pRegion->pReads[offset / 4]++;
+
+	if( (pRegion->pMem == SIM_PPBMem) && (pReg == &SYSTICK->VAL) )
+	{
+		(void)SIM_Advance(SIM_SYSTICK_CYCLES_PER_READ, 0);
+	}
+
+	value = *pReg;
+
+	if( (pRegion->pMem == SIM_PPBMem) && (pReg == &SYSTICK->CTRL) )
+	{
+		SYSTICK->CTRL &= ~SYSTICK_CTRL_COUNTFLAG;		// Cleared by reading
+	}
+	else if(pRegion->pMem != SIM_PPBMem)
+	{
+		SPI_RegDef_t *pSPIx = SIM_SPIPort(pReg);
+
+		if( (pSPIx != NULL) && (pReg == &pSPIx->DR) )
+		{
+			pSPIx->SR &= ~(1U << SPI_SR_RXNE);
+		}
+		else if( (pSPIx != NULL) && (pReg == &pSPIx->SR) && !(value & (1U << SPI_SR_RXNE)) )
+		{
+			pSPIx->SR &= ~(1U << SPI_SR_OVR);	// DR was read before this SR read
+		}
+		else if( (SIM_I2CPort(pReg) != NULL) && (pReg == &SIM_I2CPort(pReg)->SR2) )
+		{
+			SIM_I2CPort(pReg)->SR1 &= ~(1U << I2C_SR1_ADDR);	// SR1 read then SR2 read
+		}
+		else if( (SIM_I2CPort(pReg) != NULL) && (pReg == &SIM_I2CPort(pReg)->DR) )
+		{
+			SIM_ReadI2CDR(SIM_I2CPort(pReg));
+		}
+	}
+	SIM_Unlock();
+
+	return value;
+}
+
+void SIM_Write(__vo uint32_t *pReg, uint32_t Value)
+{
+	uint32_t offset;
+	uint8_t handled = 0;
+	const SIM_Region_t *pRegion = SIM_FindRegion(pReg, &offset);
+
+	if(pRegion == NULL)
+	{
+		*pReg = Value;
+		return;
+	}
+
+	SIM_Lock();
+	pRegion->pWrites[offset / 4]++;
+
+	if(pRegion->pMem == SIM_AHB1Mem)
+	{
+		if(offset < SIM_GPIO_PORTS * SIM_GPIO_PORT_SIZE)
+		{
+			handled = SIM_WriteGPIO(offset, Value);
+		}
+		else if( (offset >= SIM_RCC_OFFSET) && (offset < SIM_RCC_OFFSET + sizeof(RCC_RegDef_t)) )
+		{
+			handled = SIM_WriteRCC(offset - SIM_RCC_OFFSET, Value);
+		}
+		else if( (offset >= SIM_DMA1_OFFSET) && (offset < SIM_DMA1_OFFSET + sizeof(DMA_RegDef_t)) )
+		{
+			handled = SIM_WriteDMA(DMA1, offset - SIM_DMA1_OFFSET, Value);
+		}
+		else if( (offset >= SIM_DMA2_OFFSET) && (offset < SIM_DMA2_OFFSET + sizeof(DMA_RegDef_t)) )
+		{
+			handled = SIM_WriteDMA(DMA2, offset - SIM_DMA2_OFFSET, Value);
+		}
+	}
+	else if(pRegion->pMem == SIM_APB2Mem)
+	{
+		if( (offset >= SIM_EXTI_OFFSET) && (offset < SIM_EXTI_OFFSET + sizeof(EXTI_RegDef_t)) )
+		{
+			handled = SIM_WriteEXTI(offset - SIM_EXTI_OFFSET, Value);
+		}
+		else if(SIM_SPIPort(pReg) != NULL)
+		{
+			handled = SIM_WriteSPI(SIM_SPIPort(pReg), pReg, Value);
+		}
+		else if(offset < 2 * SIM_TIM_SIZE)
+		{
+			handled = SIM_WriteTIM(pReg, offset % SIM_TIM_SIZE, Value);
+		}
+	}
+	else if( (pRegion->pMem == SIM_APB1Mem) && (offset < 6 * SIM_TIM_SIZE) )
+	{
+		handled = SIM_WriteTIM(pReg, offset % SIM_TIM_SIZE, Value);
+	}
+	else if( (pRegion->pMem == SIM_APB1Mem) && (SIM_SPIPort(pReg) != NULL) )
+	{
+		handled = SIM_WriteSPI(SIM_SPIPort(pReg), pReg, Value);
+	}
+	else if( (pRegion->pMem == SIM_APB1Mem) && (SIM_I2CPort(pReg) != NULL) )
+	{
+		handled = SIM_WriteI2C(SIM_I2CPort(pReg), pReg, Value);
+	}
+	else if(pRegion->pMem == SIM_PPBMem)
+	{
+		handled = SIM_WritePPB(offset, Value);
+	}
+
+	if(!handled)
+	{
+		*pReg = Value;
+	}
+	SIM_Unlock();
+}
+
+static void SIM_ClearCounters(void)
+{
+	for(uint32_t i = 0; i < SIM_NUM_REGIONS; i++)
+	{
+		memset(Regions[i].pReads, 0, Regions[i].Size);
+		memset(Regions[i].pWrites, 0, Regions[i].Size);
+	}
+	memset(ClockOnCycles, 0, sizeof(ClockOnCycles));
+}
+
+void SIM_ResetCounters(void)
+{
+	SIM_Lock();
+	SIM_ClearCounters();
+	SIM_Unlock();
+}
+
+void SIM_Reset(void)
+{
+	SIM_Lock();
+	for(uint32_t i = 0; i < SIM_NUM_REGIONS; i++)
+	{
+		memset(Regions[i].pMem, 0, Regions[i].Size);
+	}
+	memset(InputLevel, 0, sizeof(InputLevel));
+	memset(DMAReload, 0, sizeof(DMAReload));
+	memset(I2CShiftFull, 0, sizeof(I2CShiftFull));
+
+	SIM_ResetRCC();
+	for(uint8_t port = 0; port < SIM_GPIO_PORTS; port++)
+	{
+		SIM_ResetGPIOPort(port);
+	}
+	SPI1->SR = (1U << SPI_SR_TXE);		// TXE stays set, frames are sent at once
+	SPI2->SR = (1U << SPI_SR_TXE);
+	SPI3->SR = (1U << SPI_SR_TXE);
+
+	SIM_ClearCounters();
+	SIM_Unlock();
+
+	// The shadows are RAM, a reset clears them too. Outside the bus lock: the GPIO driver
+	// takes its shadow lock first and then the bus.
+	for(uint8_t port = 0; port < SIM_GPIO_PORTS; port++)
+	{
+		GPIO_ResyncState(SIM_GPIOPort(port));
+	}
+}
+
+uint32_t SIM_GetReadCount(__vo uint32_t *pReg)
+{
+	uint32_t offset;
+	uint32_t count = 0;
+	const SIM_Region_t *pRegion = SIM_FindRegion(pReg, &offset);
+
+	if(pRegion != NULL)
+	{
+		SIM_Lock();
+		count = pRegion->pReads[offset / 4];
+		SIM_Unlock();
+	}
+
+	return count;
+}
+
+uint32_t SIM_GetWriteCount(__vo uint32_t *pReg)
+{
+	uint32_t offset;
+	uint32_t count = 0;
+	const SIM_Region_t *pRegion = SIM_FindRegion(pReg, &offset);
+
+	if(pRegion != NULL)
+	{
+		SIM_Lock();
+		count = pRegion->pWrites[offset / 4];
+		SIM_Unlock();
+	}
+
+	return count;
+}
+
+static uint32_t SIM_Sum(const uint32_t *pCounters, uint32_t Size)
+{
+	uint32_t sum = 0;
+
+	for(uint32_t i = 0; i < Size / 4; i++)
+	{
+		sum += pCounters[i];
+	}
+
+	return sum;
+}
+
+uint32_t SIM_GetTotalReads(void)
+{
+	uint32_t sum = 0;
+
+	SIM_Lock();
+	for(uint32_t i = 0; i < SIM_NUM_REGIONS; i++)
+	{
+		sum += SIM_Sum(Regions[i].pReads, Regions[i].Size);
+	}
+	SIM_Unlock();
+
+	return sum;
+}
+
+uint32_t SIM_GetTotalWrites(void)
+{
+	uint32_t sum = 0;
+
+	SIM_Lock();
+	for(uint32_t i = 0; i < SIM_NUM_REGIONS; i++)
+	{
+		sum += SIM_Sum(Regions[i].pWrites, Regions[i].Size);
+	}
+	SIM_Unlock();
+
+	return sum;
+}
+
+// End of the buffer of an enabled stream, called with the bus lock held
+static void SIM_DMAEnd(DMA_RegDef_t *pDMAx, uint8_t Stream)
+{
+	DMA_Stream_RegDef_t *pStream = &pDMAx->S[Stream];
+	uint32_t cr = pStream->CR;
+
+	if(cr & DMA_SxCR_DBM)
+	{
+		pStream->CR = cr ^ DMA_SxCR_CT;			// Goes on with the other memory
+		pStream->NDTR = DMAReload[(pDMAx == DMA1) ? 0 : 1][Stream];
+	}
+	else if(cr & DMA_SxCR_CIRC)
+	{
+		pStream->NDTR = DMAReload[(pDMAx == DMA1) ? 0 : 1][Stream];
+	}
+	else
+	{
+		pStream->CR = cr & ~DMA_SxCR_EN;		// Normal mode, the stream stops
+		pStream->NDTR = 0;
+	}
+
+	SIM_DMASetFlags(pDMAx, Stream, DMA_FLAG_TC);
+}
+
+void SIM_DMAComplete(DMA_RegDef_t *pDMAx, uint8_t Stream)
+{
+	SIM_Lock();
+	if(pDMAx->S[Stream].CR & DMA_SxCR_EN)
+	{
+		SIM_DMAEnd(pDMAx, Stream);
+	}
+	SIM_Unlock();
+}
+
+void SIM_DMAAdvance(DMA_RegDef_t *pDMAx, uint8_t Stream, uint32_t Items)
+{
+	DMA_Stream_RegDef_t *pStream = &pDMAx->S[Stream];
+	uint16_t reload;
+
+	SIM_Lock();
+	reload = DMAReload[(pDMAx == DMA1) ? 0 : 1][Stream];
+	while( (Items-- != 0) && (pStream->CR & DMA_SxCR_EN) && (pStream->NDTR != 0) )
+	{
+		pStream->NDTR--;
+		if(pStream->NDTR == (uint32_t)(reload - (reload / 2)))
+		{
+			SIM_DMASetFlags(pDMAx, Stream, DMA_FLAG_HT);	// Half of the buffer done
+		}
+		if(pStream->NDTR == 0)
+		{
+			SIM_DMAEnd(pDMAx, Stream);
+		}
+	}
+	SIM_Unlock();
+}
+
+void SIM_SetInputPort(GPIO_RegDef_t *pGPIOx, uint16_t Value)
+{
+	uint8_t port = (uint8_t)( ((uintptr_t)pGPIOx - GPIOA_BASEADDR) / SIM_GPIO_PORT_SIZE );
+
+	SIM_Lock();
+	InputLevel[port] = Value;
+	SIM_UpdateIDR(port);
+	SIM_Unlock();
+}
+
+#endif /* STM32F407XX_SIM */
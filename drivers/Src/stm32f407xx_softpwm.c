@@ -0,0 +1,389 @@
+/*
+ * stm32f407xx_softpwm.c
+ *
+ *  Created on: Feb 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_softpwm.h"
+
+// One store per port that changes
+static void SOFTPWM_WriteEvent(const SOFTPWM_Handle_t *pHandle, const SOFTPWM_Event_t *pEvent)
+{
+	for(uint8_t p = 0; p < pHandle->PortCount; p++)
+	{
+		if(pEvent->BSRR[p] != 0)
+		{
+			REG_WRITE(pHandle->pPorts[p]->BSRR, pEvent->BSRR[p]);
+		}
+	}
+}
+
+// First event of a period, switches to a committed list before it
+static void SOFTPWM_PeriodStart(SOFTPWM_Handle_t *pHandle)
+{
+	if(RING_LOAD_ACQUIRE(&pHandle->Pending))
+	{
+		pHandle->Active ^= 1;
+		RING_STORE_RELEASE(&pHandle->Pending, 0);
+	}
+
+	SOFTPWM_WriteEvent(pHandle, &pHandle->List[pHandle->Active].Event[0]);
+	pHandle->Next = 1;
+	pHandle->Periods++;
+}
+
+// Does the events that are due and sets the compare to the next one
+static void SOFTPWM_RunEvents(SOFTPWM_Handle_t *pHandle)
+{
+	const SOFTPWM_List_t *pList = &pHandle->List[pHandle->Active];
+	TIM_RegDef_t *pTIMx = pHandle->Config.pTIMx;
+
+	while(pHandle->Next < pList->Count)
+	{
+		const SOFTPWM_Event_t *pEvent = &pList->Event[pHandle->Next];
+
+		// Compare first, then the counter: an event that is not due yet now surely
+		// gets its interrupt, one that is due (or passed while we got here) is done now
+		REG_WRITE(pTIMx->CCR[0], pEvent->Time);
+		if(REG_READ(pTIMx->CNT) < pEvent->Time)
+		{
+			return;
+		}
+
+		SOFTPWM_WriteEvent(pHandle, pEvent);
+		pHandle->Next++;
+	}
+
+	// Nothing left in this period, the counter never reaches PeriodTicks
+	REG_WRITE(pTIMx->CCR[0], pHandle->Config.PeriodTicks);
+}
+
+// Update and compare 1 interrupt of the timer
+static void SOFTPWM_TimerHandler(void *pArg, uint32_t Flags)
+{
+	SOFTPWM_Handle_t *pHandle = (SOFTPWM_Handle_t*)pArg;
+
+	pHandle->Interrupts++;
+
+	if(Flags & TIM_SR_UIF)
+	{
+		if(pHandle->Next < pHandle->List[pHandle->Active].Count)
+		{
+			pHandle->Overruns++;
+		}
+		SOFTPWM_PeriodStart(pHandle);
+	}
+
+	SOFTPWM_RunEvents(pHandle);
+}
+
+// *************************************************************
+// * @fn			- SOFTPWM_Init			                   *
+// * 						                                   *
+// * @brief			- Checks the channels, sets up the timer   *
+// * 				  and its interrupt						   *
+// * 						                                   *
+// * @param[in]		- Handle with the configuration filled in  *
+// * 						                                   *
+// * @return		- SOFTPWM_OK or an error code              *
+// *														   *
+// * @note			- All duties start at 0. The timer is not  *
+// * 				  started, see SOFTPWM_Start. Init again   *
+// * 				  (not while running) takes no more clock  *
+// * 				  references, SOFTPWM_DeInit gives them	   *
+// * 				  back.									   *
+// *************************************************************
+uint8_t SOFTPWM_Init(SOFTPWM_Handle_t *pHandle)
+{
+	SOFTPWM_Config_t *pConfig = &pHandle->Config;
+	TIM_RegDef_t *pTIMx = pConfig->pTIMx;
+	uint32_t psc;
+
+	if( (pConfig->pPins == NULL) || (pConfig->ChannelCount == 0) || (pConfig->ChannelCount > SOFTPWM_MAX_CHANNELS) ||
+		((pTIMx != TIM2) && (pTIMx != TIM3) && (pTIMx != TIM4) && (pTIMx != TIM5)) )
+	{
+		return SOFTPWM_ERR_CONFIG;
+	}
+	if( (pConfig->TickHz == 0) || (pConfig->TimerClockHz % pConfig->TickHz != 0) || (pConfig->PeriodTicks < 2) )
+	{
+		return SOFTPWM_ERR_RATE;
+	}
+	psc = (pConfig->TimerClockHz / pConfig->TickHz) - 1;
+	if(psc > TIM_PSC_MAX)
+	{
+		return SOFTPWM_ERR_RATE;
+	}
+
+	// Ports of the channels
+	pHandle->PortCount = 0;
+	for(uint8_t i = 0; i < pConfig->ChannelCount; i++)
+	{
+		const SOFTPWM_Pin_t *pPin = &pConfig->pPins[i];
+		uint8_t p = 0;
+
+		while( (p < pHandle->PortCount) && (pHandle->pPorts[p] != pPin->pGPIOx) )
+		{
+			p++;
+		}
+		if( (pPin->Pin > 15) || (p == SOFTPWM_MAX_PORTS) )
+		{
+			return SOFTPWM_ERR_CONFIG;
+		}
+		if(p == pHandle->PortCount)
+		{
+			pHandle->pPorts[p] = pPin->pGPIOx;
+			pHandle->PortPins[p] = 0;
+			pHandle->PortCount++;
+		}
+
+		pHandle->PortOf[i] = p;
+		pHandle->PortPins[p] |= GPIO_PIN_MASK(pPin->Pin);
+		pHandle->Duty[i] = 0;
+	}
+
+	pHandle->Active = 0;
+	pHandle->Running = 0;
+	RING_STORE_RELEASE(&pHandle->Pending, 0);
+	SOFTPWM_BuildList(pHandle, &pHandle->List[0]);
+	pHandle->Next = pHandle->List[0].Count;
+	pHandle->Periods = 0;
+	pHandle->Interrupts = 0;
+	pHandle->Overruns = 0;
+
+	// Counter from 0 to PeriodTicks - 1 at TickHz, compare 1 in frozen mode only sets CC1IF.
+	// The timer has its clock already after an earlier Init.
+	if(TIM_GetCallback(pTIMx) != SOFTPWM_TimerHandler)
+	{
+		TIM_PeriClockControl(pTIMx, ENABLE);
+	}
+	TIM_Stop(pTIMx);
+	REG_WRITE(pTIMx->DIER, 0);
+	REG_SET_BITS(pTIMx->CR1, TIM_CR1_URS | TIM_CR1_ARPE);
+	REG_WRITE(pTIMx->PSC, psc);
+	REG_WRITE(pTIMx->ARR, pConfig->PeriodTicks - 1U);
+	REG_WRITE(pTIMx->CCR[0], pConfig->PeriodTicks);
+	REG_WRITE(pTIMx->EGR, TIM_EGR_UG);
+
+	TIM_RegisterCallback(pTIMx, SOFTPWM_TimerHandler, pHandle);
+	GPIO_IRQConfig(TIM_GetIRQNumber(pTIMx), pConfig->IRQPriority, ENABLE);		// Plain NVIC setup, not GPIO specific
+
+	return SOFTPWM_OK;
+}
+
+// *************************************************************
+// * @fn			- SOFTPWM_DeInit		                   *
+// * 						                                   *
+// * @brief			- Stops the outputs and gives back the	   *
+// * 				  timer and its clock					   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Does nothing if the timer is not used by *
+// * 				  a software PWM						   *
+// *************************************************************
+void SOFTPWM_DeInit(SOFTPWM_Handle_t *pHandle)
+{
+	TIM_RegDef_t *pTIMx = pHandle->Config.pTIMx;
+
+	if(TIM_GetCallback(pTIMx) != SOFTPWM_TimerHandler)
+	{
+		return;
+	}
+
+	SOFTPWM_Stop(pHandle);
+	GPIO_IRQConfig(TIM_GetIRQNumber(pTIMx), 0, DISABLE);
+	TIM_RegisterCallback(pTIMx, NULL, NULL);
+	TIM_PeriClockControl(pTIMx, DISABLE);
+}
+
+// *************************************************************
+// * @fn			- SOFTPWM_Start			                   *
+// * 						                                   *
+// * @brief			- Starts the first period				   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Duties committed before the start are	   *
+// * 				  used from the first period on			   *
+// *************************************************************
+void SOFTPWM_Start(SOFTPWM_Handle_t *pHandle)
+{
+	TIM_RegDef_t *pTIMx = pHandle->Config.pTIMx;
+
+	// The timer interrupt wakes the core from Sleep mode, the timer keeps its clock there
+	if(!pHandle->Running)
+	{
+		TIM_SleepClockControl(pTIMx, ENABLE);
+		pHandle->Running = 1;
+	}
+
+	REG_WRITE(pTIMx->CNT, 0);
+	REG_WRITE(pTIMx->SR, 0);
+	SOFTPWM_PeriodStart(pHandle);
+	SOFTPWM_RunEvents(pHandle);
+
+	REG_SET_BITS(pTIMx->DIER, TIM_DIER_UIE | TIM_DIER_CC1IE);
+	TIM_Start(pTIMx);
+}
+
+// *************************************************************
+// * @fn			- SOFTPWM_Stop			                   *
+// * 						                                   *
+// * @brief			- Stops the timer and sets all outputs low *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- One BSRR store per port				   *
+// *************************************************************
+void SOFTPWM_Stop(SOFTPWM_Handle_t *pHandle)
+{
+	TIM_RegDef_t *pTIMx = pHandle->Config.pTIMx;
+
+	TIM_Stop(pTIMx);
+	REG_CLR_BITS(pTIMx->DIER, TIM_DIER_UIE | TIM_DIER_CC1IE);
+	REG_WRITE(pTIMx->SR, 0);
+
+	for(uint8_t p = 0; p < pHandle->PortCount; p++)
+	{
+		REG_WRITE(pHandle->pPorts[p]->BSRR, (uint32_t)pHandle->PortPins[p] << 16);
+	}
+
+	if(pHandle->Running)
+	{
+		TIM_SleepClockControl(pTIMx, DISABLE);
+		pHandle->Running = 0;
+	}
+}
+
+// *************************************************************
+// * @fn			- SOFTPWM_SetDuty		                   *
+// * 						                                   *
+// * @brief			- Stores the duty of a channel			   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * @param[in]		- Channel, 0 - ChannelCount - 1			   *
+// * @param[in]		- Duty in ticks, 0 - PeriodTicks		   *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Used after the next SOFTPWM_Commit, so   *
+// * 				  several channels change in one period	   *
+// *************************************************************
+void SOFTPWM_SetDuty(SOFTPWM_Handle_t *pHandle, uint8_t Channel, uint16_t Duty)
+{
+	if(Channel < pHandle->Config.ChannelCount)
+	{
+		pHandle->Duty[Channel] = (Duty > pHandle->Config.PeriodTicks) ? pHandle->Config.PeriodTicks : Duty;
+	}
+}
+
+// *************************************************************
+// * @fn			- SOFTPWM_Commit		                   *
+// * 						                                   *
+// * @brief			- Builds the event list of the duties and  *
+// * 				  hands it to the timer interrupt		   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Not from the timer interrupt. A commit   *
+// * 				  that was not used yet is replaced.	   *
+// *************************************************************
+void SOFTPWM_Commit(SOFTPWM_Handle_t *pHandle)
+{
+	// The interrupt only switches lists while Pending is 1, so from here on Active
+	// does not change and the other list is not read by it
+	RING_STORE_RELEASE(&pHandle->Pending, 0);
+	SOFTPWM_BuildList(pHandle, &pHandle->List[pHandle->Active ^ 1]);
+	RING_STORE_RELEASE(&pHandle->Pending, 1);
+}
+
+// *************************************************************
+// * @fn			- SOFTPWM_BuildList		                   *
+// * 						                                   *
+// * @brief			- Turns the duties into a time sorted	   *
+// * 				  event list							   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * @param[out]	- List									   *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Channels with the same duty share an	   *
+// * 				  event, and a port word in it			   *
+// *************************************************************
+void SOFTPWM_BuildList(const SOFTPWM_Handle_t *pHandle, SOFTPWM_List_t *pList)
+{
+	const SOFTPWM_Config_t *pConfig = &pHandle->Config;
+	SOFTPWM_Event_t *pEvent = &pList->Event[0];
+	uint32_t keys[SOFTPWM_MAX_CHANNELS];		// Duty << 8 | channel, of the pins reset in the period
+	uint8_t n = 0;
+	uint8_t count = 1;
+
+	// Period start: pins with a duty high, the others low
+	pEvent->Time = 0;
+	for(uint8_t p = 0; p < SOFTPWM_MAX_PORTS; p++)
+	{
+		pEvent->BSRR[p] = 0;
+	}
+	for(uint8_t i = 0; i < pConfig->ChannelCount; i++)
+	{
+		uint16_t duty = pHandle->Duty[i];
+		uint32_t bit = GPIO_PIN_MASK(pConfig->pPins[i].Pin);
+
+		if(duty == 0)
+		{
+			pEvent->BSRR[pHandle->PortOf[i]] |= bit << 16;
+		}
+		else
+		{
+			pEvent->BSRR[pHandle->PortOf[i]] |= bit;
+			if(duty < pConfig->PeriodTicks)
+			{
+				keys[n++] = ((uint32_t)duty << 8) | i;
+			}
+		}
+	}
+
+	// Insertion sort, few keys and usually close to the order of the last list
+	for(uint8_t i = 1; i < n; i++)
+	{
+		uint32_t key = keys[i];
+		uint8_t j = i;
+
+		while( (j > 0) && (keys[j - 1] > key) )
+		{
+			keys[j] = keys[j - 1];
+			j--;
+		}
+		keys[j] = key;
+	}
+
+	// One event per distinct duty. All times are above 0, so the first key starts a new event.
+	for(uint8_t i = 0; i < n; i++)
+	{
+		uint32_t time = keys[i] >> 8;
+		uint8_t ch = (uint8_t)(keys[i] & 0xFFU);
+
+		if(pEvent->Time != time)
+		{
+			pEvent = &pList->Event[count++];
+			pEvent->Time = time;
+			for(uint8_t p = 0; p < SOFTPWM_MAX_PORTS; p++)
+			{
+				pEvent->BSRR[p] = 0;
+			}
+		}
+		pEvent->BSRR[pHandle->PortOf[ch]] |= (uint32_t)GPIO_PIN_MASK(pConfig->pPins[ch].Pin) << 16;
+	}
+
+	pList->Count = count;
+}
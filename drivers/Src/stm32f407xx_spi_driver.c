@@ -0,0 +1,769 @@
+/*
+ * stm32f407xx_spi_driver.c
+ *
+ *  Created on: Jan 8, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_spi_driver.h"
+
+#define SPI_COUNT				3
+
+// DMA requests of each SPI (ch. 10.3.3, tables 42 and 43). Where a request has two streams
+// the one the other drivers do not use is taken:
+//	- SPI1 TX on DMA2 stream 3, stream 5 is TIM1_UP (pattern generator, capture, encoder)
+//	- SPI3 TX on DMA1 stream 7, stream 5 is USART2 RX (USART2 and SPI3 go together on the
+//	  STM32F4DISCOVERY). Stream 7 is also UART5 TX.
+// The streams that are still shared, only one of the drivers can use them (SPI_Init returns
+// SPI_ERR_BUSY to the second one):
+//	- SPI1 RX, DMA2 stream 0: ADC3
+//	- SPI2 RX, DMA1 stream 3: USART3 TX, I2C2 RX
+//	- SPI2 TX, DMA1 stream 4: UART4 TX
+//	- SPI3 RX, DMA1 stream 0: UART5 RX, I2C1 RX
+typedef struct
+{
+	DMA_RegDef_t *pDMAx;
+	uint8_t RxStream;
+	uint8_t TxStream;
+	uint8_t Channel;
+}SPI_DMAMap_t;
+
+static const uint8_t IRQNumbers[SPI_COUNT] = { IRQ_NO_SPI1, IRQ_NO_SPI2, IRQ_NO_SPI3 };
+
+// Handles given to SPI_Init, used by the IRQ handlers
+static SPI_Handle_t *Handles[SPI_COUNT];
+
+// Source of the 0xFF sent when there is no TX buffer and sink of the dropped RX data. Static,
+// not on the stack: DummyTx is const and read by the DMA from flash (.rodata), DummyRx is in
+// SRAM. Neither may be moved to the CCM RAM, the DMA can not reach it.
+static const uint16_t DummyTx = 0xFFFF;
+static uint16_t DummyRx;
+
+static void SPI_DMARxHandler(void *pArg, uint8_t Flags);
+static void SPI_DMATxHandler(void *pArg, uint8_t Flags);
+
+static uint8_t SPI_Index(SPI_RegDef_t *pSPIx)
+{
+	if(pSPIx == SPI1)		{ return 0; }
+	else if(pSPIx == SPI2)	{ return 1; }
+	else					{ return 2; }
+}
+
+static SPI_DMAMap_t SPI_GetDMAMap(SPI_RegDef_t *pSPIx)
+{
+	SPI_DMAMap_t map;
+
+	if(pSPIx == SPI1)		{ map = (SPI_DMAMap_t){ DMA2, 0, 3, 3 }; }
+	else if(pSPIx == SPI2)	{ map = (SPI_DMAMap_t){ DMA1, 3, 4, 0 }; }
+	else					{ map = (SPI_DMAMap_t){ DMA1, 0, 7, 0 }; }
+
+	return map;
+}
+
+static uint8_t SPI_ClockId(SPI_RegDef_t *pSPIx)
+{
+	if(pSPIx == SPI1)		{ return RCC_CLK_SPI1; }
+	else if(pSPIx == SPI2)	{ return RCC_CLK_SPI2; }
+	else					{ return RCC_CLK_SPI3; }
+}
+
+// *************************************************************
+// * @fn			- SPI_PeriClockControl	                   *
+// * 						                                   *
+// * @brief			- Enables or disables peripheral clock for *
+// * 				  the given SPI							   *
+// * 						                                   *
+// * @param[in]		- SPI1, SPI2 or SPI3					   *
+// * @param[in]		- ENABLE or DISABLE macros	               *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Counted per user. Gated in Sleep mode	   *
+// * 				  unless a transaction or a stream runs.   *
+// *************************************************************
+void SPI_PeriClockControl(SPI_RegDef_t *pSPIx, uint8_t EnorDi)
+{
+	if( (pSPIx != SPI1) && (pSPIx != SPI2) && (pSPIx != SPI3) )
+	{
+		return;
+	}
+
+	if(EnorDi == ENABLE)
+	{
+		RCC_PeriphClockEnable(SPI_ClockId(pSPIx), RCC_CLK_RUN_ONLY);
+	}
+	else
+	{
+		RCC_PeriphClockDisable(SPI_ClockId(pSPIx), RCC_CLK_RUN_ONLY);
+	}
+}
+
+// The SPI, and the DMA controller when it moves the data, keep their clocks in Sleep mode
+// from the start of a transaction queue or a stream until the SPI is ready again
+static void SPI_SleepClockControl(SPI_Handle_t *pSPIHandle, uint8_t UseDMA, uint8_t EnorDi)
+{
+	RCC_PeriphSleepControl(SPI_ClockId(pSPIHandle->pSPIx), EnorDi);
+	if(UseDMA)
+	{
+		DMA_SleepClockControl(pSPIHandle->pDMAx, EnorDi);
+	}
+}
+
+// *************************************************************
+// * @fn			- SPI_Init				                   *
+// * 						                                   *
+// * @brief			- Configures the SPI and sets up its	   *
+// * 				  interrupts and DMA streams			   *
+// * 						                                   *
+// * @param[in]		- Handle with pSPIx, SPIConfig, XferMode   *
+// * 				  and IRQPriority filled in				   *
+// * 						                                   *
+// * @return		- SPI_OK, or SPI_ERR_BUSY if a DMA stream  *
+// * 				  of the SPI is used by another driver	   *
+// *														   *
+// * @note			- The SPI pins must be set to their		   *
+// * 				  alternate function by the caller. The	   *
+// * 				  SPI is enabled by the first transfer.	   *
+// * 				  Without its DMA streams the SPI works in *
+// * 				  blocking and interrupt mode, DMA		   *
+// * 				  transfers return SPI_ERR_BUSY. Init	   *
+// * 				  again starts with SPI_DeInit.			   *
+// *************************************************************
+uint8_t SPI_Init(SPI_Handle_t *pSPIHandle)
+{
+	SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+	SPI_Config_t *pConfig = &pSPIHandle->SPIConfig;
+	SPI_DMAMap_t map = SPI_GetDMAMap(pSPIx);
+	uint32_t cr1 = 0;
+
+	// Init again: the clocks and streams of the first Init are given back first
+	if(Handles[SPI_Index(pSPIx)] != NULL)
+	{
+		SPI_DeInit(pSPIx);
+	}
+	SPI_PeriClockControl(pSPIx, ENABLE);
+
+	cr1 |= ((uint32_t)pConfig->SPI_DeviceMode << SPI_CR1_MSTR);
+
+	if(pConfig->SPI_BusConfig == SPI_BUS_CONFIG_HD)
+	{
+		cr1 |= (1U << SPI_CR1_BIDIMODE);
+	}
+	else if(pConfig->SPI_BusConfig == SPI_BUS_CONFIG_SIMPLEX_RXONLY)
+	{
+		cr1 |= (1U << SPI_CR1_RXONLY);
+	}
+
+	cr1 |= ((uint32_t)(pConfig->SPI_SclkSpeed & 0x7) << SPI_CR1_BR);
+	cr1 |= ((uint32_t)pConfig->SPI_DFF << SPI_CR1_DFF);
+	cr1 |= ((uint32_t)pConfig->SPI_CPOL << SPI_CR1_CPOL);
+	cr1 |= ((uint32_t)pConfig->SPI_CPHA << SPI_CR1_CPHA);
+	if(pConfig->SPI_SSM == SPI_SSM_EN)
+	{
+		// NSS is internal, held high for a master so it does not see a mode fault
+		cr1 |= (1U << SPI_CR1_SSM);
+		if(pConfig->SPI_DeviceMode == SPI_DEVICE_MODE_MASTER)
+		{
+			cr1 |= (1U << SPI_CR1_SSI);
+		}
+	}
+
+	REG_WRITE(pSPIx->CR1, cr1);
+	REG_WRITE(pSPIx->CR2, 0);
+
+	pSPIHandle->RxStream = map.RxStream;
+	pSPIHandle->TxStream = map.TxStream;
+	pSPIHandle->DMAChannel = map.Channel;
+	pSPIHandle->State = SPI_READY;
+	pSPIHandle->pHead = NULL;
+	pSPIHandle->pTail = NULL;
+	Handles[SPI_Index(pSPIx)] = pSPIHandle;
+
+	GPIO_IRQConfig(IRQNumbers[SPI_Index(pSPIx)], pSPIHandle->IRQPriority, ENABLE);
+
+	// Both streams or none, pDMAx stays NULL without them
+	pSPIHandle->pDMAx = NULL;
+	if(DMA_RegisterCallback(map.pDMAx, map.RxStream, SPI_DMARxHandler, pSPIHandle) != DMA_OK)
+	{
+		return SPI_ERR_BUSY;
+	}
+	if(DMA_RegisterCallback(map.pDMAx, map.TxStream, SPI_DMATxHandler, pSPIHandle) != DMA_OK)
+	{
+		(void)DMA_RegisterCallback(map.pDMAx, map.RxStream, NULL, NULL);
+		return SPI_ERR_BUSY;
+	}
+	pSPIHandle->pDMAx = map.pDMAx;
+
+	DMA_PeriClockControl(map.pDMAx, ENABLE);
+	GPIO_IRQConfig(DMA_GetIRQNumber(map.pDMAx, map.RxStream), pSPIHandle->IRQPriority, ENABLE);
+	GPIO_IRQConfig(DMA_GetIRQNumber(map.pDMAx, map.TxStream), pSPIHandle->IRQPriority, ENABLE);
+
+	return SPI_OK;
+}
+
+// *************************************************************
+// * @fn			- SPI_DeInit			                   *
+// * 						                                   *
+// * @brief			- Resets all registers of the SPI		   *
+// * 						                                   *
+// * @param[in]		- SPI1, SPI2 or SPI3					   *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Through RCC APBxRSTR (ch. 7.3.7 -	   *
+// * 				  7.3.8). The DMA streams and the clocks   *
+// * 				  taken by SPI_Init are given back. A	   *
+// * 				  running transfer is dropped.			   *
+// *************************************************************
+void SPI_DeInit(SPI_RegDef_t *pSPIx)
+{
+	SPI_Handle_t *pSPIHandle = Handles[SPI_Index(pSPIx)];
+
+	if( (pSPIHandle != NULL) && (pSPIHandle->State != SPI_READY) )
+	{
+		uint8_t dma = (pSPIHandle->State == SPI_STREAMING) || (pSPIHandle->XferMode == SPI_XFER_DMA);
+
+		if(pSPIHandle->pDMAx != NULL)
+		{
+			DMA_StreamDisable(pSPIHandle->pDMAx, pSPIHandle->RxStream);
+			DMA_StreamDisable(pSPIHandle->pDMAx, pSPIHandle->TxStream);
+		}
+		pSPIHandle->State = SPI_READY;
+		pSPIHandle->pHead = NULL;
+		pSPIHandle->pTail = NULL;
+		SPI_SleepClockControl(pSPIHandle, dma, DISABLE);
+	}
+	if( (pSPIHandle != NULL) && (pSPIHandle->pDMAx != NULL) )
+	{
+		(void)DMA_RegisterCallback(pSPIHandle->pDMAx, pSPIHandle->RxStream, NULL, NULL);
+		(void)DMA_RegisterCallback(pSPIHandle->pDMAx, pSPIHandle->TxStream, NULL, NULL);
+		DMA_PeriClockControl(pSPIHandle->pDMAx, DISABLE);
+		pSPIHandle->pDMAx = NULL;
+	}
+
+	if(pSPIx == SPI1)
+	{
+		REG_BB_SET(RCC->APB2RSTR, 12);
+		REG_BB_CLR(RCC->APB2RSTR, 12);
+	}
+	else
+	{
+		uint32_t bit = (pSPIx == SPI2) ? 14 : 15;
+
+		REG_BB_SET(RCC->APB1RSTR, bit);
+		REG_BB_CLR(RCC->APB1RSTR, bit);
+	}
+
+	if(pSPIHandle != NULL)
+	{
+		SPI_PeriClockControl(pSPIx, DISABLE);
+		Handles[SPI_Index(pSPIx)] = NULL;
+	}
+}
+
+void SPI_PeripheralControl(SPI_RegDef_t *pSPIx, uint8_t EnorDi)
+{
+	if(EnorDi == ENABLE)
+	{
+		REG_SET_BITS(pSPIx->CR1, (1U << SPI_CR1_SPE));
+	}
+	else
+	{
+		REG_CLR_BITS(pSPIx->CR1, (1U << SPI_CR1_SPE));
+	}
+}
+
+// Item "Index" of a buffer of 8 or 16 bit items, 0xFFFF without a buffer
+static inline uint32_t SPI_GetItem(const void *pBuffer, uint32_t Index, uint8_t Size)
+{
+	if(pBuffer == NULL)
+	{
+		return 0xFFFFU;
+	}
+	return (Size == 2) ? ((const uint16_t*)pBuffer)[Index] : ((const uint8_t*)pBuffer)[Index];
+}
+
+static inline void SPI_PutItem(void *pBuffer, uint32_t Index, uint8_t Size, uint32_t Value)
+{
+	if(pBuffer == NULL)
+	{
+		return;
+	}
+	if(Size == 2)	{ ((uint16_t*)pBuffer)[Index] = (uint16_t)Value; }
+	else			{ ((uint8_t*)pBuffer)[Index] = (uint8_t)Value; }
+}
+
+// *************************************************************
+// * @fn			- SPI_TransferBlocking	                   *
+// * 						                                   *
+// * @brief			- Sends and receives "Len" bytes		   *
+// * 						                                   *
+// * @param[in]		- SPI1, SPI2 or SPI3					   *
+// * @param[in]		- Data to send, NULL sends 0xFF            *
+// * @param[out]	- Received data, NULL drops it             *
+// * @param[in]		- Length in bytes		                   *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Blocking call. Two frames are kept in	   *
+// * 				  flight (shift register and TX buffer), so*
+// * 				  SCLK runs without gaps and RX can not	   *
+// * 				  overrun.								   *
+// *************************************************************
+void SPI_TransferBlocking(SPI_RegDef_t *pSPIx, const void *pTxBuffer, void *pRxBuffer, uint32_t Len)
+{
+	uint32_t cr1 = REG_READ(pSPIx->CR1);
+	uint8_t size = (cr1 & (1U << SPI_CR1_DFF)) ? 2 : 1;
+	uint32_t items = Len / size;
+	uint32_t tx = 0, rx = 0;
+
+	if( !(cr1 & (1U << SPI_CR1_SPE)) )
+	{
+		REG_WRITE(pSPIx->CR1, cr1 | (1U << SPI_CR1_SPE));
+	}
+
+	while(rx < items)
+	{
+		uint32_t sr = REG_READ(pSPIx->SR);
+
+		// Receive first, so the next frame is never sent into a full RX buffer
+		if(sr & (1U << SPI_SR_RXNE))
+		{
+			SPI_PutItem(pRxBuffer, rx++, size, REG_READ(pSPIx->DR));
+		}
+		if( (tx < items) && (tx - rx < 2) && (sr & (1U << SPI_SR_TXE)) )
+		{
+			REG_WRITE(pSPIx->DR, SPI_GetItem(pTxBuffer, tx++, size));
+		}
+	}
+}
+
+void SPI_SendData(SPI_RegDef_t *pSPIx, const uint8_t *pTxBuffer, uint32_t Len)
+{
+	SPI_TransferBlocking(pSPIx, pTxBuffer, NULL, Len);
+}
+
+void SPI_ReceiveData(SPI_RegDef_t *pSPIx, uint8_t *pRxBuffer, uint32_t Len)
+{
+	SPI_TransferBlocking(pSPIx, NULL, pRxBuffer, Len);
+}
+
+// Interrupt mode: one frame in flight, the next one is sent when the last one is received
+static void SPI_StartIT(SPI_Handle_t *pSPIHandle, const void *pTxBuffer, void *pRxBuffer, uint16_t Len)
+{
+	SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+	uint8_t size = pSPIHandle->SPIConfig.SPI_DFF ? 2 : 1;
+
+	pSPIHandle->pTxBuffer = pTxBuffer;
+	pSPIHandle->pRxBuffer = pRxBuffer;
+	pSPIHandle->TxLen = Len - size;
+	pSPIHandle->RxLen = Len;
+
+	SPI_PeripheralControl(pSPIx, ENABLE);
+	REG_SET_BITS(pSPIx->CR2, (1U << SPI_CR2_RXNEIE) | (1U << SPI_CR2_ERRIE));
+	REG_WRITE(pSPIx->DR, SPI_GetItem(pTxBuffer, 0, size));
+}
+
+// DMA mode, order of ch. 28.3.9: RXDMAEN, streams, TXDMAEN
+static void SPI_StartDMA(SPI_Handle_t *pSPIHandle, const void *pTxBuffer, void *pRxBuffer, uint16_t Len)
+{
+	SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+	uint8_t size = pSPIHandle->SPIConfig.SPI_DFF ? DMA_SIZE_HALFWORD : DMA_SIZE_BYTE;
+	uint16_t items = (uint16_t)(Len >> size);
+	DMA_StreamConfig_t dma = { 0 };
+
+	dma.Channel = pSPIHandle->DMAChannel;
+	dma.PeriphSize = size;
+	dma.MemSize = size;
+	dma.Priority = DMA_PRIORITY_HIGH;
+
+	// RX: its transfer complete is the end of the transaction
+	dma.Direction = DMA_DIR_P2M;
+	dma.MemInc = (pRxBuffer != NULL) ? ENABLE : DISABLE;
+	dma.Interrupts = DMA_FLAG_TC | DMA_FLAG_TE;
+	DMA_StreamInit(pSPIHandle->pDMAx, pSPIHandle->RxStream, &dma);
+	DMA_StreamSetAddress(pSPIHandle->pDMAx, pSPIHandle->RxStream, &pSPIx->DR,
+			(pRxBuffer != NULL) ? pRxBuffer : &DummyRx, NULL, items);
+
+	dma.Direction = DMA_DIR_M2P;
+	dma.MemInc = (pTxBuffer != NULL) ? ENABLE : DISABLE;
+	dma.Interrupts = DMA_FLAG_TE;
+	DMA_StreamInit(pSPIHandle->pDMAx, pSPIHandle->TxStream, &dma);
+	DMA_StreamSetAddress(pSPIHandle->pDMAx, pSPIHandle->TxStream, &pSPIx->DR,
+			(pTxBuffer != NULL) ? (void*)pTxBuffer : (void*)&DummyTx, NULL, items);
+
+	SPI_PeripheralControl(pSPIx, ENABLE);
+	REG_SET_BITS(pSPIx->CR2, (1U << SPI_CR2_RXDMAEN));
+	DMA_StreamEnable(pSPIHandle->pDMAx, pSPIHandle->RxStream);
+	DMA_StreamEnable(pSPIHandle->pDMAx, pSPIHandle->TxStream);
+	REG_SET_BITS(pSPIx->CR2, (1U << SPI_CR2_TXDMAEN));
+}
+
+// Starts the transaction at the head of the queue
+static void SPI_StartTxn(SPI_Handle_t *pSPIHandle)
+{
+	SPI_Transaction_t *pTxn = pSPIHandle->pHead;
+
+	pTxn->Status = SPI_TXN_ACTIVE;
+	if(pTxn->pCSPort != NULL)
+	{
+		GPIO_ResetPins(pTxn->pCSPort, pTxn->CSPin);
+	}
+
+	if(pSPIHandle->XferMode == SPI_XFER_DMA)
+	{
+		SPI_StartDMA(pSPIHandle, pTxn->pTxBuffer, pTxn->pRxBuffer, pTxn->Len);
+	}
+	else
+	{
+		SPI_StartIT(pSPIHandle, pTxn->pTxBuffer, pTxn->pRxBuffer, pTxn->Len);
+	}
+}
+
+// Ends the transaction at the head of the queue and starts the next one. Interrupt context.
+static void SPI_CompleteTxn(SPI_Handle_t *pSPIHandle, uint8_t Status)
+{
+	SPI_Transaction_t *pTxn = pSPIHandle->pHead;
+	SPI_Transaction_t *pNext = pTxn->pNext;
+
+	if( (pTxn->pCSPort != NULL) && !(pTxn->Flags & SPI_TXN_CS_HOLD) )
+	{
+		GPIO_SetPins(pTxn->pCSPort, pTxn->CSPin);
+	}
+
+	// The queue is updated before the callback, so the callback may submit again
+	pSPIHandle->pHead = pNext;
+	if(pNext == NULL)
+	{
+		pSPIHandle->pTail = NULL;
+		pSPIHandle->State = SPI_READY;
+		SPI_SleepClockControl(pSPIHandle, (pSPIHandle->XferMode == SPI_XFER_DMA), DISABLE);
+	}
+
+	pTxn->Status = Status;
+	if(pTxn->pCallback != NULL)
+	{
+		pTxn->pCallback(pTxn, pTxn->pArg);
+	}
+
+	if(pNext != NULL)
+	{
+		SPI_StartTxn(pSPIHandle);
+	}
+}
+
+// *************************************************************
+// * @fn			- SPI_Submit			                   *
+// * 						                                   *
+// * @brief			- Queues a transaction					   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * @param[in]		- Transaction, owned by the caller         *
+// * 						                                   *
+// * @return		- SPI_OK, SPI_ERR_BUSY while streaming or  *
+// * 				  in DMA mode without the DMA streams, or  *
+// * 				  SPI_ERR_PARAM for a bad length		   *
+// *														   *
+// * @note			- Returns at once, the transaction starts  *
+// * 				  when the ones before it are done. May be *
+// * 				  called from a transaction callback.	   *
+// *************************************************************
+uint8_t SPI_Submit(SPI_Handle_t *pSPIHandle, SPI_Transaction_t *pTxn)
+{
+	uint32_t primask;
+	uint8_t start;
+
+	if( (pTxn->Len == 0) || (pSPIHandle->SPIConfig.SPI_DFF && (pTxn->Len & 1)) )
+	{
+		return SPI_ERR_PARAM;
+	}
+	if( (pSPIHandle->XferMode == SPI_XFER_DMA) && (pSPIHandle->pDMAx == NULL) )
+	{
+		return SPI_ERR_BUSY;
+	}
+
+	pTxn->pNext = NULL;
+	pTxn->Status = SPI_TXN_QUEUED;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	if(pSPIHandle->State == SPI_STREAMING)
+	{
+		__set_PRIMASK(primask);
+		pTxn->Status = SPI_TXN_IDLE;
+		return SPI_ERR_BUSY;
+	}
+
+	if(pSPIHandle->pTail != NULL)
+	{
+		pSPIHandle->pTail->pNext = pTxn;
+	}
+	else
+	{
+		pSPIHandle->pHead = pTxn;
+	}
+	pSPIHandle->pTail = pTxn;
+
+	start = (pSPIHandle->State == SPI_READY);
+	if(start)
+	{
+		pSPIHandle->State = SPI_BUSY;
+	}
+
+	__set_PRIMASK(primask);
+
+	if(start)
+	{
+		SPI_SleepClockControl(pSPIHandle, (pSPIHandle->XferMode == SPI_XFER_DMA), ENABLE);
+		SPI_StartTxn(pSPIHandle);
+	}
+
+	return SPI_OK;
+}
+
+uint8_t SPI_IsIdle(SPI_Handle_t *pSPIHandle)
+{
+	return (pSPIHandle->State == SPI_READY);
+}
+
+// *************************************************************
+// * @fn			- SPI_StreamStart		                   *
+// * 						                                   *
+// * @brief			- Starts a continuous transfer of two	   *
+// * 				  buffers in turn						   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * @param[in]		- Possible values from @SPI_STREAM_DIR     *
+// * @param[in]		- Buffer 0, transferred first              *
+// * @param[in]		- Buffer 1		                           *
+// * @param[in]		- Length of each buffer in bytes           *
+// * @param[in]		- Called with each buffer that is done     *
+// * @param[in]		- Argument given to the callback           *
+// * 						                                   *
+// * @return		- SPI_OK, SPI_ERR_BUSY or SPI_ERR_PARAM    *
+// *														   *
+// * @note			- The callback has one buffer time to	   *
+// * 				  refill (or read) the buffer. No chip	   *
+// * 				  select is driven, the caller does it.	   *
+// *************************************************************
+uint8_t SPI_StreamStart(SPI_Handle_t *pSPIHandle, uint8_t Direction, void *pBuffer0, void *pBuffer1, uint16_t Len,
+		SPI_StreamCallback_t pCallback, void *pArg)
+{
+	SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+	uint8_t size = pSPIHandle->SPIConfig.SPI_DFF ? DMA_SIZE_HALFWORD : DMA_SIZE_BYTE;
+	uint16_t items = (uint16_t)(Len >> size);
+	uint8_t mainStream = (Direction == SPI_STREAM_TX) ? pSPIHandle->TxStream : pSPIHandle->RxStream;
+	DMA_StreamConfig_t dma = { 0 };
+
+	if( (items == 0) || (pBuffer0 == NULL) || (pBuffer1 == NULL) )
+	{
+		return SPI_ERR_PARAM;
+	}
+	if( (pSPIHandle->State != SPI_READY) || (pSPIHandle->pDMAx == NULL) )
+	{
+		return SPI_ERR_BUSY;
+	}
+
+	pSPIHandle->State = SPI_STREAMING;
+	SPI_SleepClockControl(pSPIHandle, 1, ENABLE);
+	pSPIHandle->pStreamCallback = pCallback;
+	pSPIHandle->pStreamArg = pArg;
+	pSPIHandle->pStreamBuffer[0] = pBuffer0;
+	pSPIHandle->pStreamBuffer[1] = pBuffer1;
+	pSPIHandle->StreamDir = Direction;
+
+	dma.Channel = pSPIHandle->DMAChannel;
+	dma.PeriphSize = size;
+	dma.MemSize = size;
+	dma.Priority = DMA_PRIORITY_HIGH;
+
+	// The buffers, in double buffer mode
+	dma.Direction = (Direction == SPI_STREAM_TX) ? DMA_DIR_M2P : DMA_DIR_P2M;
+	dma.MemInc = ENABLE;
+	dma.DoubleBuffer = ENABLE;
+	dma.Interrupts = DMA_FLAG_TC | DMA_FLAG_TE;
+	DMA_StreamInit(pSPIHandle->pDMAx, mainStream, &dma);
+	DMA_StreamSetAddress(pSPIHandle->pDMAx, mainStream, &pSPIx->DR, pBuffer0, pBuffer1, items);
+
+	SPI_PeripheralControl(pSPIx, ENABLE);
+	if(Direction == SPI_STREAM_RX)
+	{
+		// The clock comes from 0xFF frames sent by a circular TX stream
+		dma.Direction = DMA_DIR_M2P;
+		dma.MemInc = DISABLE;
+		dma.DoubleBuffer = DISABLE;
+		dma.Circular = ENABLE;
+		dma.Interrupts = 0;
+		DMA_StreamInit(pSPIHandle->pDMAx, pSPIHandle->TxStream, &dma);
+		DMA_StreamSetAddress(pSPIHandle->pDMAx, pSPIHandle->TxStream, &pSPIx->DR, (void*)&DummyTx, NULL, items);
+
+		REG_SET_BITS(pSPIx->CR2, (1U << SPI_CR2_RXDMAEN));
+		DMA_StreamEnable(pSPIHandle->pDMAx, pSPIHandle->RxStream);
+	}
+	DMA_StreamEnable(pSPIHandle->pDMAx, pSPIHandle->TxStream);
+	REG_SET_BITS(pSPIx->CR2, (1U << SPI_CR2_TXDMAEN));
+
+	return SPI_OK;
+}
+
+// *************************************************************
+// * @fn			- SPI_StreamStop		                   *
+// * 						                                   *
+// * @brief			- Stops a stream						   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Waits for the last frame to be sent	   *
+// * 				  (ch. 28.3.8)							   *
+// *************************************************************
+void SPI_StreamStop(SPI_Handle_t *pSPIHandle)
+{
+	SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+
+	if(pSPIHandle->State != SPI_STREAMING)
+	{
+		return;
+	}
+
+	DMA_StreamDisable(pSPIHandle->pDMAx, pSPIHandle->TxStream);
+	DMA_StreamDisable(pSPIHandle->pDMAx, pSPIHandle->RxStream);
+	REG_CLR_BITS(pSPIx->CR2, (1U << SPI_CR2_TXDMAEN) | (1U << SPI_CR2_RXDMAEN));
+
+	while( !(REG_READ(pSPIx->SR) & (1U << SPI_SR_TXE)) );
+	while(REG_READ(pSPIx->SR) & (1U << SPI_SR_BSY));
+
+	// A TX stream leaves data (and an overrun) in the RX side, cleared by reading DR then SR
+	(void)REG_READ(pSPIx->DR);
+	(void)REG_READ(pSPIx->SR);
+
+	pSPIHandle->State = SPI_READY;
+	SPI_SleepClockControl(pSPIHandle, 1, DISABLE);
+}
+
+// DMA RX stream interrupt: end of a DMA transaction or of an RX stream buffer
+static void SPI_DMARxHandler(void *pArg, uint8_t Flags)
+{
+	SPI_Handle_t *pSPIHandle = (SPI_Handle_t*)pArg;
+
+	if(pSPIHandle->State == SPI_STREAMING)
+	{
+		if( (Flags & DMA_FLAG_TC) && (pSPIHandle->pStreamCallback != NULL) )
+		{
+			// The DMA goes on with the current target, the other buffer is full
+			uint8_t done = DMA_GetCurrentTarget(pSPIHandle->pDMAx, pSPIHandle->RxStream) ^ 1;
+
+			pSPIHandle->pStreamCallback(pSPIHandle->pStreamBuffer[done], pSPIHandle->pStreamArg);
+		}
+		return;
+	}
+
+	if( (pSPIHandle->State == SPI_BUSY) && (Flags & (DMA_FLAG_TC | DMA_FLAG_TE)) )
+	{
+		REG_CLR_BITS(pSPIHandle->pSPIx->CR2, (1U << SPI_CR2_TXDMAEN) | (1U << SPI_CR2_RXDMAEN));
+		SPI_CompleteTxn(pSPIHandle, (Flags & DMA_FLAG_TE) ? SPI_TXN_ERROR : SPI_TXN_DONE);
+	}
+}
+
+// DMA TX stream interrupt: end of a TX stream buffer, or a transfer error
+static void SPI_DMATxHandler(void *pArg, uint8_t Flags)
+{
+	SPI_Handle_t *pSPIHandle = (SPI_Handle_t*)pArg;
+
+	if( (pSPIHandle->State == SPI_STREAMING) && (pSPIHandle->StreamDir == SPI_STREAM_TX) &&
+		(Flags & DMA_FLAG_TC) && (pSPIHandle->pStreamCallback != NULL) )
+	{
+		uint8_t done = DMA_GetCurrentTarget(pSPIHandle->pDMAx, pSPIHandle->TxStream) ^ 1;
+
+		pSPIHandle->pStreamCallback(pSPIHandle->pStreamBuffer[done], pSPIHandle->pStreamArg);
+	}
+	else if( (pSPIHandle->State == SPI_BUSY) && (Flags & DMA_FLAG_TE) )
+	{
+		DMA_StreamDisable(pSPIHandle->pDMAx, pSPIHandle->RxStream);
+		REG_CLR_BITS(pSPIHandle->pSPIx->CR2, (1U << SPI_CR2_TXDMAEN) | (1U << SPI_CR2_RXDMAEN));
+		SPI_CompleteTxn(pSPIHandle, SPI_TXN_ERROR);
+	}
+}
+
+// *************************************************************
+// * @fn			- SPI_IRQHandling		                   *
+// * 						                                   *
+// * @brief			- Serves the SPI interrupt of a			   *
+// * 				  transaction in interrupt mode			   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- An overrun or mode fault ends the		   *
+// * 				  transaction with SPI_TXN_ERROR		   *
+// *************************************************************
+void SPI_IRQHandling(SPI_Handle_t *pSPIHandle)
+{
+	SPI_RegDef_t *pSPIx = pSPIHandle->pSPIx;
+	uint32_t sr = REG_READ(pSPIx->SR);
+	uint32_t cr2 = REG_READ(pSPIx->CR2);
+	uint8_t size = pSPIHandle->SPIConfig.SPI_DFF ? 2 : 1;
+
+	if( !(cr2 & (1U << SPI_CR2_RXNEIE)) )
+	{
+		return;
+	}
+
+	if(sr & ((1U << SPI_SR_OVR) | (1U << SPI_SR_MODF)))
+	{
+		// OVR is cleared by reading DR then SR, MODF by reading SR then writing CR1
+		(void)REG_READ(pSPIx->DR);
+		(void)REG_READ(pSPIx->SR);
+		REG_WRITE(pSPIx->CR1, REG_READ(pSPIx->CR1));
+
+		REG_CLR_BITS(pSPIx->CR2, (1U << SPI_CR2_RXNEIE) | (1U << SPI_CR2_ERRIE));
+		SPI_CompleteTxn(pSPIHandle, SPI_TXN_ERROR);
+		return;
+	}
+
+	if(sr & (1U << SPI_SR_RXNE))
+	{
+		uint32_t data = REG_READ(pSPIx->DR);
+
+		if(pSPIHandle->pRxBuffer != NULL)
+		{
+			SPI_PutItem(pSPIHandle->pRxBuffer, 0, size, data);
+			pSPIHandle->pRxBuffer += size;
+		}
+		pSPIHandle->RxLen -= size;
+
+		if(pSPIHandle->TxLen != 0)
+		{
+			if(pSPIHandle->pTxBuffer != NULL)
+			{
+				pSPIHandle->pTxBuffer += size;
+			}
+			pSPIHandle->TxLen -= size;
+			REG_WRITE(pSPIx->DR, SPI_GetItem(pSPIHandle->pTxBuffer, 0, size));
+		}
+		else if(pSPIHandle->RxLen == 0)
+		{
+			REG_CLR_BITS(pSPIx->CR2, (1U << SPI_CR2_RXNEIE) | (1U << SPI_CR2_ERRIE));
+			SPI_CompleteTxn(pSPIHandle, SPI_TXN_DONE);
+		}
+	}
+}
+
+// SPI interrupt handlers. Weak, so the application can write its own.
+__weak void SPI1_IRQHandler(void)
+{
+	if(Handles[0] != NULL) { SPI_IRQHandling(Handles[0]); }
+}
+
+__weak void SPI2_IRQHandler(void)
+{
+	if(Handles[1] != NULL) { SPI_IRQHandling(Handles[1]); }
+}
+
+__weak void SPI3_IRQHandler(void)
+{
+	if(Handles[2] != NULL) { SPI_IRQHandling(Handles[2]); }
+}
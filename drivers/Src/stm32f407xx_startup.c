@@ -0,0 +1,408 @@
+/*
+ * stm32f407xx_startup.c
+ *
+ *  Created on: Mar 5, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_startup.h"
+
+// Milestone timestamps, cycles since reset
+static uint32_t MilestoneCycles[BOOT_MAX_MILESTONES];
+static uint32_t MilestonesReached;			// Bit n: milestone n has a timestamp
+
+// Queue of lazy inits for BOOT_LazyRunNext
+static BOOT_Lazy_t *pLazyHead;
+static BOOT_Lazy_t *pLazyTail;
+
+// Milestones
+
+// *************************************************************
+// * @fn			- BOOT_Milestone		                   *
+// * 						                                   *
+// * @brief			- Timestamps a milestone of the boot	   *
+// * 						                                   *
+// * @param[in]		- @BOOT_MILESTONE						   *
+// * 						                                   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Only the first call of a milestone	   *
+// * 				  counts. The time is the DWT cycle		   *
+// * 				  counter, which the reset handler starts  *
+// * 				  at 0.									   *
+// *************************************************************
+void BOOT_Milestone(uint8_t Id)
+{
+	if( (Id >= BOOT_MAX_MILESTONES) || (MilestonesReached & (1U << Id)) )
+	{
+		return;
+	}
+
+	MilestoneCycles[Id] = PROFILER_Now();
+	MilestonesReached |= (1U << Id);
+}
+
+// *************************************************************
+// * @fn			- BOOT_GetCycles		                   *
+// * 						                                   *
+// * @brief			- Returns the timestamp of a milestone	   *
+// * 						                                   *
+// * @param[in]		- @BOOT_MILESTONE						   *
+// * 						                                   *
+// * @return		- Cycles since reset, BOOT_NOT_REACHED	   *
+// *														   *
+// * @note			- Reset to main is						   *
+// * 				  BOOT_GetCycles(BOOT_MILESTONE_MAIN)	   *
+// *************************************************************
+uint32_t BOOT_GetCycles(uint8_t Id)
+{
+	if( (Id >= BOOT_MAX_MILESTONES) || !(MilestonesReached & (1U << Id)) )
+	{
+		return BOOT_NOT_REACHED;
+	}
+
+	return MilestoneCycles[Id];
+}
+
+// Lazy initialization
+
+// *************************************************************
+// * @fn			- BOOT_LazyRegister		                   *
+// * 						                                   *
+// * @brief			- Queues a lazy init for BOOT_LazyRunNext  *
+// * 						                                   *
+// * @param[in]		- Lazy init, see BOOT_LAZY_DEFINE		   *
+// * 						                                   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Nothing is done if it is already queued  *
+// * 				  or done								   *
+// *************************************************************
+void BOOT_LazyRegister(BOOT_Lazy_t *pLazy)
+{
+	if(pLazy->State != 0)
+	{
+		return;
+	}
+
+	pLazy->pNext = NULL;
+	if(pLazyTail == NULL)
+	{
+		pLazyHead = pLazy;
+	}
+	else
+	{
+		pLazyTail->pNext = pLazy;
+	}
+	pLazyTail = pLazy;
+	pLazy->State = 1;
+}
+
+// *************************************************************
+// * @fn			- BOOT_LazyEnsure		                   *
+// * 						                                   *
+// * @brief			- Runs a lazy init if it was not done yet  *
+// * 						                                   *
+// * @param[in]		- Lazy init, see BOOT_LAZY_DEFINE		   *
+// * 						                                   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Call at the start of each function of	   *
+// * 				  the subsystem. After the first call it   *
+// * 				  is one load and one compare.			   *
+// *************************************************************
+void BOOT_LazyEnsure(BOOT_Lazy_t *pLazy)
+{
+	if(pLazy->State == 2)
+	{
+		return;
+	}
+
+	pLazy->State = 2;		// Before the call, so an init that uses its own subsystem does not recurse
+	pLazy->pInit();
+}
+
+// *************************************************************
+// * @fn			- BOOT_LazyRunNext		                   *
+// * 						                                   *
+// * @brief			- Runs the next queued lazy init		   *
+// * 						                                   *
+// * @return		- 1 if an init was run, 0 if none is left  *
+// *														   *
+// * @note			- For the idle time of the main loop, e.g. *
+// * 				  SCHED_IdleHook. Inits already done by	   *
+// * 				  BOOT_LazyEnsure are skipped.			   *
+// *************************************************************
+uint8_t BOOT_LazyRunNext(void)
+{
+	while(pLazyHead != NULL)
+	{
+		BOOT_Lazy_t *pLazy = pLazyHead;
+
+		pLazyHead = pLazy->pNext;
+		if(pLazyHead == NULL)
+		{
+			pLazyTail = NULL;
+		}
+		if(pLazy->State == 1)
+		{
+			BOOT_LazyEnsure(pLazy);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// Startup hooks
+
+// *************************************************************
+// * @fn			- BOOT_EarlyInit		                   *
+// * 						                                   *
+// * @brief			- Called by the reset handler before the   *
+// * 				  RAM sections are set up				   *
+// * 						                                   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Empty, the application may replace it,   *
+// * 				  e.g. with FLASH_EnableART and			   *
+// * 				  RCC_ClockConfig. Globals are not set up  *
+// * 				  yet and are overwritten after it.		   *
+// *************************************************************
+__weak void BOOT_EarlyInit(void)
+{
+}
+
+#ifndef STM32F407XX_SIM
+
+// From the linker script and the C library
+extern uint32_t _estack;
+extern void __libc_init_array(void);
+extern int main(void);
+
+// *************************************************************
+// * @fn			- Reset_Handler			                   *
+// * 						                                   *
+// * @brief			- First code after a reset, sets up the	   *
+// * 				  core and the RAM and calls main		   *
+// * 						                                   *
+// * @return		- Does not return                          *
+// *														   *
+// * @note			- Until MEM_InitSections returns only	   *
+// * 				  locals may be used, the milestones of	   *
+// * 				  that part are stored afterwards.		   *
+// *************************************************************
+void Reset_Handler(void)
+{
+	uint32_t clockCycles, sectionCycles;
+
+	// 1. Cycle counter from 0, it keeps running through a system reset
+	REG_SET_BITS(DEMCR, DEMCR_TRCENA);
+	REG_WRITE(DWT->CYCCNT, 0);
+	REG_SET_BITS(DWT->CTRL, DWT_CTRL_CYCCNTENA);
+
+	// 2. FPU on, before any code compiled for it runs
+	REG_SET_BITS(SCB_CPACR, SCB_CPACR_FPU_FULL);
+	__asm volatile ("dsb\n\tisb" : : : "memory");
+
+	// 3. Clock, before the copies so they run at the new speed
+	BOOT_EarlyInit();
+	clockCycles = PROFILER_Now();
+
+	// 4. RAM sections
+	MEM_InitSections();
+	sectionCycles = PROFILER_Now();
+
+	MilestoneCycles[BOOT_MILESTONE_RESET] = 0;
+	MilestoneCycles[BOOT_MILESTONE_CLOCK] = clockCycles;
+	MilestoneCycles[BOOT_MILESTONE_SECTIONS] = sectionCycles;
+	MilestonesReached = (1U << BOOT_MILESTONE_RESET) | (1U << BOOT_MILESTONE_CLOCK) | (1U << BOOT_MILESTONE_SECTIONS);
+
+	// 5. Constructors, then the application
+	__libc_init_array();
+	BOOT_Milestone(BOOT_MILESTONE_MAIN);
+	(void)main();
+
+	while(1)
+	{
+	}
+}
+
+// *************************************************************
+// * @fn			- Default_Handler		                   *
+// * 						                                   *
+// * @brief			- Handler of all exceptions and interrupts *
+// * 				  that have no handler of their own		   *
+// * 						                                   *
+// * @return		- Does not return                          *
+// *														   *
+// * @note			- Stops here so a debugger shows the	   *
+// * 				  exception (IPSR) that was not expected   *
+// *************************************************************
+void Default_Handler(void)
+{
+	while(1)
+	{
+	}
+}
+
+// Handlers that no driver defines. The drivers define theirs weak (EXTI, DMA, TIM2 - TIM5, SPI,
+// I2C, USART, SysTick), a second weak alias of the same name here would make the choice depend
+// on the link order.
+#define BOOT_DEFAULT_HANDLER(Name)	void Name(void) __attribute__((weak, alias("Default_Handler")))
+
+BOOT_DEFAULT_HANDLER(NMI_Handler);
+BOOT_DEFAULT_HANDLER(HardFault_Handler);
+BOOT_DEFAULT_HANDLER(MemManage_Handler);
+BOOT_DEFAULT_HANDLER(BusFault_Handler);
+BOOT_DEFAULT_HANDLER(UsageFault_Handler);
+BOOT_DEFAULT_HANDLER(SVC_Handler);
+BOOT_DEFAULT_HANDLER(DebugMon_Handler);
+BOOT_DEFAULT_HANDLER(PendSV_Handler);
+BOOT_DEFAULT_HANDLER(WWDG_IRQHandler);
+BOOT_DEFAULT_HANDLER(PVD_IRQHandler);
+BOOT_DEFAULT_HANDLER(TAMP_STAMP_IRQHandler);
+BOOT_DEFAULT_HANDLER(RTC_WKUP_IRQHandler);
+BOOT_DEFAULT_HANDLER(FLASH_IRQHandler);
+BOOT_DEFAULT_HANDLER(RCC_IRQHandler);
+BOOT_DEFAULT_HANDLER(ADC_IRQHandler);
+BOOT_DEFAULT_HANDLER(CAN1_TX_IRQHandler);
+BOOT_DEFAULT_HANDLER(CAN1_RX0_IRQHandler);
+BOOT_DEFAULT_HANDLER(CAN1_RX1_IRQHandler);
+BOOT_DEFAULT_HANDLER(CAN1_SCE_IRQHandler);
+BOOT_DEFAULT_HANDLER(TIM1_BRK_TIM9_IRQHandler);
+BOOT_DEFAULT_HANDLER(TIM1_UP_TIM10_IRQHandler);
+BOOT_DEFAULT_HANDLER(TIM1_TRG_COM_TIM11_IRQHandler);
+BOOT_DEFAULT_HANDLER(TIM1_CC_IRQHandler);
+BOOT_DEFAULT_HANDLER(RTC_Alarm_IRQHandler);
+BOOT_DEFAULT_HANDLER(OTG_FS_WKUP_IRQHandler);
+BOOT_DEFAULT_HANDLER(TIM8_BRK_TIM12_IRQHandler);
+BOOT_DEFAULT_HANDLER(TIM8_UP_TIM13_IRQHandler);
+BOOT_DEFAULT_HANDLER(TIM8_TRG_COM_TIM14_IRQHandler);
+BOOT_DEFAULT_HANDLER(TIM8_CC_IRQHandler);
+BOOT_DEFAULT_HANDLER(FSMC_IRQHandler);
+BOOT_DEFAULT_HANDLER(SDIO_IRQHandler);
+BOOT_DEFAULT_HANDLER(TIM6_DAC_IRQHandler);
+BOOT_DEFAULT_HANDLER(TIM7_IRQHandler);
+BOOT_DEFAULT_HANDLER(ETH_IRQHandler);
+BOOT_DEFAULT_HANDLER(ETH_WKUP_IRQHandler);
+BOOT_DEFAULT_HANDLER(CAN2_TX_IRQHandler);
+BOOT_DEFAULT_HANDLER(CAN2_RX0_IRQHandler);
+BOOT_DEFAULT_HANDLER(CAN2_RX1_IRQHandler);
+BOOT_DEFAULT_HANDLER(CAN2_SCE_IRQHandler);
+BOOT_DEFAULT_HANDLER(OTG_FS_IRQHandler);
+BOOT_DEFAULT_HANDLER(OTG_HS_EP1_OUT_IRQHandler);
+BOOT_DEFAULT_HANDLER(OTG_HS_EP1_IN_IRQHandler);
+BOOT_DEFAULT_HANDLER(OTG_HS_WKUP_IRQHandler);
+BOOT_DEFAULT_HANDLER(OTG_HS_IRQHandler);
+BOOT_DEFAULT_HANDLER(DCMI_IRQHandler);
+BOOT_DEFAULT_HANDLER(CRYP_IRQHandler);
+BOOT_DEFAULT_HANDLER(HASH_RNG_IRQHandler);
+BOOT_DEFAULT_HANDLER(FPU_IRQHandler);
+
+// Vector table (PM0214 ch. 2.3.4 and RM0090 table 61), placed at the start of the flash by
+// the linker script. Entry 0 is the initial stack pointer, entry 16 + n is IRQ n.
+typedef void (*BOOT_Vector_t)(void);
+
+__attribute__((section(".isr_vector"), used))
+static const BOOT_Vector_t VectorTable[16 + 82] =
+{
+	(BOOT_Vector_t)&_estack,
+	Reset_Handler,
+	NMI_Handler,
+	HardFault_Handler,
+	MemManage_Handler,
+	BusFault_Handler,
+	UsageFault_Handler,
+	0, 0, 0, 0,
+	SVC_Handler,
+	DebugMon_Handler,
+	0,
+	PendSV_Handler,
+	SysTick_Handler,
+
+	WWDG_IRQHandler,					// 0
+	PVD_IRQHandler,
+	TAMP_STAMP_IRQHandler,
+	RTC_WKUP_IRQHandler,
+	FLASH_IRQHandler,
+	RCC_IRQHandler,
+	EXTI0_IRQHandler,
+	EXTI1_IRQHandler,
+	EXTI2_IRQHandler,
+	EXTI3_IRQHandler,
+	EXTI4_IRQHandler,					// 10
+	DMA1_Stream0_IRQHandler,
+	DMA1_Stream1_IRQHandler,
+	DMA1_Stream2_IRQHandler,
+	DMA1_Stream3_IRQHandler,
+	DMA1_Stream4_IRQHandler,
+	DMA1_Stream5_IRQHandler,
+	DMA1_Stream6_IRQHandler,
+	ADC_IRQHandler,
+	CAN1_TX_IRQHandler,
+	CAN1_RX0_IRQHandler,				// 20
+	CAN1_RX1_IRQHandler,
+	CAN1_SCE_IRQHandler,
+	EXTI9_5_IRQHandler,
+	TIM1_BRK_TIM9_IRQHandler,
+	TIM1_UP_TIM10_IRQHandler,
+	TIM1_TRG_COM_TIM11_IRQHandler,
+	TIM1_CC_IRQHandler,
+	TIM2_IRQHandler,
+	TIM3_IRQHandler,
+	TIM4_IRQHandler,					// 30
+	I2C1_EV_IRQHandler,
+	I2C1_ER_IRQHandler,
+	I2C2_EV_IRQHandler,
+	I2C2_ER_IRQHandler,
+	SPI1_IRQHandler,
+	SPI2_IRQHandler,
+	USART1_IRQHandler,
+	USART2_IRQHandler,
+	USART3_IRQHandler,
+	EXTI15_10_IRQHandler,				// 40
+	RTC_Alarm_IRQHandler,
+	OTG_FS_WKUP_IRQHandler,
+	TIM8_BRK_TIM12_IRQHandler,
+	TIM8_UP_TIM13_IRQHandler,
+	TIM8_TRG_COM_TIM14_IRQHandler,
+	TIM8_CC_IRQHandler,
+	DMA1_Stream7_IRQHandler,
+	FSMC_IRQHandler,
+	SDIO_IRQHandler,
+	TIM5_IRQHandler,					// 50
+	SPI3_IRQHandler,
+	UART4_IRQHandler,
+	UART5_IRQHandler,
+	TIM6_DAC_IRQHandler,
+	TIM7_IRQHandler,
+	DMA2_Stream0_IRQHandler,
+	DMA2_Stream1_IRQHandler,
+	DMA2_Stream2_IRQHandler,
+	DMA2_Stream3_IRQHandler,
+	DMA2_Stream4_IRQHandler,			// 60
+	ETH_IRQHandler,
+	ETH_WKUP_IRQHandler,
+	CAN2_TX_IRQHandler,
+	CAN2_RX0_IRQHandler,
+	CAN2_RX1_IRQHandler,
+	CAN2_SCE_IRQHandler,
+	OTG_FS_IRQHandler,
+	DMA2_Stream5_IRQHandler,
+	DMA2_Stream6_IRQHandler,
+	DMA2_Stream7_IRQHandler,			// 70
+	USART6_IRQHandler,
+	I2C3_EV_IRQHandler,
+	I2C3_ER_IRQHandler,
+	OTG_HS_EP1_OUT_IRQHandler,
+	OTG_HS_EP1_IN_IRQHandler,
+	OTG_HS_WKUP_IRQHandler,
+	OTG_HS_IRQHandler,
+	DCMI_IRQHandler,
+	CRYP_IRQHandler,
+	HASH_RNG_IRQHandler,				// 80
+	FPU_IRQHandler,
+};
+
+#endif /* STM32F407XX_SIM */
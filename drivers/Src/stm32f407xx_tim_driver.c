@@ -0,0 +1,285 @@
+/*
+ * stm32f407xx_tim_driver.c
+ *
+ *  Created on: Nov 27, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_tim_driver.h"
+
+// TIM2 - TIM5 are 0x400 apart
+#define TIM_GP_INDEX(pTIMx)		( (uint8_t)((((uintptr_t)(pTIMx) - TIM2_BASEADDR) >> 10) & 0x3U) )
+
+// Callback of the interrupt of TIM2 - TIM5, set with TIM_RegisterCallback
+static TIM_Callback_t Callbacks[4];
+static void *CallbackArgs[4];
+
+// Clock id of a timer. TIM1 and TIM8 are on APB2 (bits 0 and 1 of APB2ENR), TIM2 - TIM7 on
+// APB1 (bits 0 - 5 of APB1ENR) (ch. 7.3.13 - 7.3.14).
+static uint8_t TIM_ClockId(TIM_RegDef_t *pTIMx)
+{
+	if(pTIMx == TIM1)		{ return RCC_CLK_TIM1; }
+	else if(pTIMx == TIM8)	{ return RCC_CLK_TIM8; }
+
+	// TIM2 - TIM7 are 0x400 apart from TIM2, in the same order as their enable bits
+	return RCC_CLK_ID(RCC_BUS_APB1, ((uintptr_t)pTIMx - TIM2_BASEADDR) >> 10);
+}
+
+// *************************************************************
+// * @fn			- TIM_PeriClockControl	                   *
+// * 						                                   *
+// * @brief			- Enables or disables the clock of a timer *
+// * 						                                   *
+// * @param[in]		- TIM1 - TIM8							   *
+// * @param[in]		- ENABLE or DISABLE macros	               *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Counted per user. Gated in Sleep mode,   *
+// * 				  see TIM_SleepClockControl.			   *
+// *************************************************************
+void TIM_PeriClockControl(TIM_RegDef_t *pTIMx, uint8_t EnorDi)
+{
+	if(EnorDi == ENABLE)
+	{
+		RCC_PeriphClockEnable(TIM_ClockId(pTIMx), RCC_CLK_RUN_ONLY);
+	}
+	else
+	{
+		RCC_PeriphClockDisable(TIM_ClockId(pTIMx), RCC_CLK_RUN_ONLY);
+	}
+}
+
+// *************************************************************
+// * @fn			- TIM_SleepClockControl	                   *
+// * 						                                   *
+// * @brief			- Keeps the clock of a timer on in Sleep   *
+// * 				  mode, or gives that up				   *
+// * 						                                   *
+// * @param[in]		- TIM1 - TIM8							   *
+// * @param[in]		- ENABLE or DISABLE macros	               *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Counted per user: ENABLE when the timer  *
+// * 				  is started, DISABLE when it is stopped.  *
+// *************************************************************
+void TIM_SleepClockControl(TIM_RegDef_t *pTIMx, uint8_t EnorDi)
+{
+	RCC_PeriphSleepControl(TIM_ClockId(pTIMx), EnorDi);
+}
+
+// *************************************************************
+// * @fn			- TIM_SetUpdateRate		                   *
+// * 						                                   *
+// * @brief			- Sets prescaler and auto-reload so the	   *
+// * 				  timer overflows "RateHz" times a second  *
+// * 						                                   *
+// * @param[in]		- Timer										*
+// * @param[in]		- Timer input clock in Hz (APBx timer	   *
+// * 				  clock)								   *
+// * @param[in]		- Update event rate in Hz				   *
+// * 						                                   *
+// * @return		- The rate actually set in Hz, 0 if it is  *
+// * 				  out of range							   *
+// *														   *
+// * @note			- The smallest prescaler is used, so the   *
+// * 				  rate is as exact as possible. The new	   *
+// * 				  values are loaded with an update event   *
+// * 				  (UG), which does not set UIF (URS = 1).  *
+// *************************************************************
+uint32_t TIM_SetUpdateRate(TIM_RegDef_t *pTIMx, uint32_t TimerClockHz, uint32_t RateHz)
+{
+	uint32_t ticks, psc, arr;
+
+	if(RateHz == 0 || RateHz > TimerClockHz / 2)
+	{
+		return 0;
+	}
+
+	ticks = TimerClockHz / RateHz;
+	psc = (ticks - 1) / (TIM_ARR_MAX + 1);
+	if(psc > TIM_PSC_MAX)
+	{
+		return 0;
+	}
+	arr = (ticks / (psc + 1)) - 1;
+
+	REG_SET_BITS(pTIMx->CR1, TIM_CR1_URS | TIM_CR1_ARPE);
+	REG_WRITE(pTIMx->PSC, psc);
+	REG_WRITE(pTIMx->ARR, arr);
+	REG_WRITE(pTIMx->EGR, TIM_EGR_UG);
+
+	return TimerClockHz / ((psc + 1) * (arr + 1));
+}
+
+// *************************************************************
+// * @fn			- TIM_UpdateDMAControl	                   *
+// * 						                                   *
+// * @brief			- Enables or disables the DMA request on   *
+// * 				  the update event						   *
+// * 						                                   *
+// * @param[in]		- Timer										*
+// * @param[in]		- ENABLE or DISABLE macros	               *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- TIMx_UP is the request of the DMA stream *
+// * 				  channel listed in ch. 10.3.3			   *
+// *************************************************************
+void TIM_UpdateDMAControl(TIM_RegDef_t *pTIMx, uint8_t EnorDi)
+{
+	if(EnorDi == ENABLE)
+	{
+		REG_SET_BITS(pTIMx->DIER, TIM_DIER_UDE);
+	}
+	else
+	{
+		REG_CLR_BITS(pTIMx->DIER, TIM_DIER_UDE);
+	}
+}
+
+// *************************************************************
+// * @fn			- TIM_GetUpdateDMARequest                  *
+// * 						                                   *
+// * @brief			- Returns the DMA2 stream and channel of   *
+// * 				  the update request of a timer			   *
+// * 						                                   *
+// * @param[in]		- Timer										*
+// * @param[out]	- Stream 0 - 7			               *
+// * @param[out]	- Channel 0 - 7			               *
+// * 						                                   *
+// * @return		- 1 if found, 0 if the timer has no update *
+// * 				  request on DMA2						   *
+// *														   *
+// * @note			- Only the DMA2 requests are listed, DMA1  *
+// * 				  can not reach the GPIO ports (table 43)  *
+// *************************************************************
+uint8_t TIM_GetUpdateDMARequest(TIM_RegDef_t *pTIMx, uint8_t *pStream, uint8_t *pChannel)
+{
+	if(pTIMx == TIM1)
+	{
+		*pStream = 5;
+		*pChannel = 6;
+		return 1;
+	}
+	if(pTIMx == TIM8)
+	{
+		*pStream = 1;
+		*pChannel = 7;
+		return 1;
+	}
+
+	return 0;
+}
+
+// *************************************************************
+// * @fn			- TIM_SetMasterMode		                   *
+// * 						                                   *
+// * @brief			- Selects the event the timer sends on its *
+// * 				  trigger output (TRGO)					   *
+// * 						                                   *
+// * @param[in]		- Timer										*
+// * @param[in]		- @TIM_MMS				               *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- TRGO of TIM2, TIM3 and TIM8 can start	   *
+// * 				  the ADC conversions (ch. 13.6)		   *
+// *************************************************************
+void TIM_SetMasterMode(TIM_RegDef_t *pTIMx, uint8_t Mode)
+{
+	REG_MODIFY(pTIMx->CR2, TIM_CR2_MMS_MASK, ((uint32_t)Mode << TIM_CR2_MMS_POS) & TIM_CR2_MMS_MASK);
+}
+
+void TIM_Start(TIM_RegDef_t *pTIMx)
+{
+	REG_SET_BITS(pTIMx->CR1, TIM_CR1_CEN);
+}
+
+void TIM_Stop(TIM_RegDef_t *pTIMx)
+{
+	REG_CLR_BITS(pTIMx->CR1, TIM_CR1_CEN);
+}
+
+// *************************************************************
+// * @fn			- TIM_GetIRQNumber		                   *
+// * 						                                   *
+// * @brief			- Returns the IRQ number of a timer		   *
+// * 						                                   *
+// * @param[in]		- TIM2 - TIM5							   *
+// *														   *
+// * @return		- IRQ_NO_TIMx                              *
+// *************************************************************
+uint8_t TIM_GetIRQNumber(TIM_RegDef_t *pTIMx)
+{
+	return (pTIMx == TIM5) ? IRQ_NO_TIM5 : (uint8_t)(IRQ_NO_TIM2 + TIM_GP_INDEX(pTIMx));
+}
+
+// *************************************************************
+// * @fn			- TIM_RegisterCallback	                   *
+// * 						                                   *
+// * @brief			- Sets the function called from the timer  *
+// * 				  interrupt								   *
+// * 						                                   *
+// * @param[in]		- TIM2 - TIM5							   *
+// * @param[in]		- Callback, NULL to remove it              *
+// * @param[in]		- Argument given to the callback           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- The callback runs in interrupt context.  *
+// * 				  The interrupts are enabled in DIER by	   *
+// * 				  the caller.							   *
+// *************************************************************
+void TIM_RegisterCallback(TIM_RegDef_t *pTIMx, TIM_Callback_t pCallback, void *pArg)
+{
+	uint8_t tim = TIM_GP_INDEX(pTIMx);
+
+	Callbacks[tim] = NULL;
+	CallbackArgs[tim] = pArg;
+	Callbacks[tim] = pCallback;
+}
+
+// Callback of a timer, NULL if there is none
+TIM_Callback_t TIM_GetCallback(TIM_RegDef_t *pTIMx)
+{
+	return Callbacks[TIM_GP_INDEX(pTIMx)];
+}
+
+// *************************************************************
+// * @fn			- TIM_IRQHandling		                   *
+// * 						                                   *
+// * @brief			- Clears the enabled flags of a timer and  *
+// * 				  calls its callback					   *
+// * 						                                   *
+// * @param[in]		- TIM2 - TIM5							   *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- SR is rc_w0, writing the complement	   *
+// * 				  clears only the flags read, a flag set   *
+// * 				  in between is kept for the next entry	   *
+// *************************************************************
+void TIM_IRQHandling(TIM_RegDef_t *pTIMx)
+{
+	uint8_t tim = TIM_GP_INDEX(pTIMx);
+	uint32_t flags = REG_READ(pTIMx->SR) & REG_READ(pTIMx->DIER) & 0xFFU;	// Interrupt flags only, no DMA
+
+	if(flags == 0)
+	{
+		return;
+	}
+	REG_WRITE(pTIMx->SR, ~flags);
+
+	if(Callbacks[tim] != NULL)
+	{
+		Callbacks[tim](CallbackArgs[tim], flags);
+	}
+}
+
+// Timer interrupt handlers. Weak, so the application can write its own.
+__weak void TIM2_IRQHandler(void)	{ TIM_IRQHandling(TIM2); }
+__weak void TIM3_IRQHandler(void)	{ TIM_IRQHandling(TIM3); }
+__weak void TIM4_IRQHandler(void)	{ TIM_IRQHandling(TIM4); }
+__weak void TIM5_IRQHandler(void)	{ TIM_IRQHandling(TIM5); }
@@ -0,0 +1,313 @@
+/*
+ * stm32f407xx_timebase.c
+ *
+ *  Created on: Nov 13, 2022
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_timebase.h"
+
+#define TIMEBASE_WHEEL_MASK		(TIMEBASE_WHEEL_SIZE - 1)
+
+static __vo uint32_t TickMs;		// Incremented by the SysTick interrupt
+static uint32_t TicksPerMs;			// SysTick counts per millisecond, LOAD + 1
+static uint32_t ProcessedMs;		// Last tick handled by TIMEBASE_Process
+
+static TIMEBASE_Timer_t *Wheel[TIMEBASE_WHEEL_SIZE];
+
+// *************************************************************
+// * @fn			- TIMEBASE_Init		                       *
+// * 						                                   *
+// * @brief			- Starts SysTick with a 1 ms interrupt	   *
+// * 						                                   *
+// * @param[in]		- Core clock (HCLK) in Hz, e.g. HSI_VALUE  *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Call again after the core clock has been *
+// * 				  changed. Running timers are kept.		   *
+// *************************************************************
+void TIMEBASE_Init(uint32_t CoreClockHz)
+{
+	TicksPerMs = CoreClockHz / 1000U;
+
+	REG_WRITE(SYSTICK->CTRL, 0);				// Stop while it is configured
+	REG_WRITE(SYSTICK->LOAD, (TicksPerMs - 1) & SYSTICK_LOAD_MAX);
+	REG_WRITE(SYSTICK->VAL, 0);					// Any write clears the counter and COUNTFLAG
+	REG_WRITE(SYSTICK->CTRL, SYSTICK_CTRL_CLKSOURCE | SYSTICK_CTRL_TICKINT | SYSTICK_CTRL_ENABLE);
+}
+
+// *************************************************************
+// * @fn			- TIMEBASE_GetMs		                   *
+// * 						                                   *
+// * @brief			- Returns milliseconds since TIMEBASE_Init *
+// * 						                                   *
+// * @return		- uint32_t, wraps after 2^32 ms            *
+// *														   *
+// * @note			- Compare times with TIMEBASE_Elapsed or   *
+// * 				  by subtraction, so the wrap is harmless  *
+// *************************************************************
+uint32_t TIMEBASE_GetMs(void)
+{
+	return TickMs;
+}
+
+// *************************************************************
+// * @fn			- TIMEBASE_GetUs		                   *
+// * 						                                   *
+// * @brief			- Returns microseconds since TIMEBASE_Init *
+// * 						                                   *
+// * @return		- uint64_t                                 *
+// *														   *
+// * @note			- The ms count is read again if the tick   *
+// * 				  interrupt ran while SysTick was read. 	   *
+// * 				  With interrupts disabled for more than   *
+// * 				  1 ms the result can be 1 ms behind. The  *
+// * 				  us part is scaled by ticks per ms, so	   *
+// * 				  core clocks below 1 MHz work too.		   *
+// *************************************************************
+uint64_t TIMEBASE_GetUs(void)
+{
+	uint32_t ms, val;
+
+	do
+	{
+		ms = TickMs;
+		val = REG_READ(SYSTICK->VAL);
+	}while(ms != TickMs);
+
+	// SysTick counts down from LOAD to 0
+	return ((uint64_t)ms * 1000U) + (((TicksPerMs - 1 - val) * 1000U) / TicksPerMs);
+}
+
+// *************************************************************
+// * @fn			- TIMEBASE_DelayUs		                   *
+// * 						                                   *
+// * @brief			- Busy-waits "Us" microseconds			   *
+// * 						                                   *
+// * @param[in]		- Delay in microseconds                    *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Counts SysTick ticks, so it works with   *
+// * 				  interrupts disabled and is accurate to   *
+// * 				  one loop pass at any core clock. The	   *
+// * 				  tick count is 64 bit, any Us is waited   *
+// * 				  (2^32 us at 168 MHz are 7.2 * 10^11	   *
+// * 				  ticks).								   *
+// *************************************************************
+void TIMEBASE_DelayUs(uint32_t Us)
+{
+	uint64_t remaining = ((uint64_t)Us * TicksPerMs) / 1000U;
+	uint32_t last = REG_READ(SYSTICK->VAL);
+
+	while(remaining != 0)
+	{
+		uint32_t now = REG_READ(SYSTICK->VAL);
+		// Down counter, add LOAD + 1 when it has been reloaded since the last read
+		uint32_t elapsed = (now <= last) ? (last - now) : (last + TicksPerMs - now);
+
+		last = now;
+		remaining = (elapsed >= remaining) ? 0 : (remaining - elapsed);
+	}
+}
+
+// *************************************************************
+// * @fn			- TIMEBASE_DelayMs		                   *
+// * 						                                   *
+// * @brief			- Busy-waits "Ms" milliseconds			   *
+// * 						                                   *
+// * @param[in]		- Delay in milliseconds                    *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Blocks the CPU, prefer a software timer  *
+// * 				  in the main loop						   *
+// *************************************************************
+void TIMEBASE_DelayMs(uint32_t Ms)
+{
+	while(Ms-- != 0)
+	{
+		TIMEBASE_DelayUs(1000U);
+	}
+}
+
+// Links a timer into the wheel slot of its expiry tick
+static void TIMEBASE_WheelInsert(TIMEBASE_Timer_t *pTimer)
+{
+	TIMEBASE_Timer_t **ppSlot = &Wheel[pTimer->Expiry & TIMEBASE_WHEEL_MASK];
+
+	pTimer->pPrev = NULL;
+	pTimer->pNext = *ppSlot;
+	if(*ppSlot != NULL)
+	{
+		(*ppSlot)->pPrev = pTimer;
+	}
+	*ppSlot = pTimer;
+}
+
+static void TIMEBASE_WheelRemove(TIMEBASE_Timer_t *pTimer)
+{
+	if(pTimer->pPrev != NULL)
+	{
+		pTimer->pPrev->pNext = pTimer->pNext;
+	}
+	else
+	{
+		Wheel[pTimer->Expiry & TIMEBASE_WHEEL_MASK] = pTimer->pNext;
+	}
+	if(pTimer->pNext != NULL)
+	{
+		pTimer->pNext->pPrev = pTimer->pPrev;
+	}
+}
+
+// *************************************************************
+// * @fn			- TIMEBASE_TimerStart	                   *
+// * 						                                   *
+// * @brief			- Starts (or restarts) a software timer	   *
+// * 						                                   *
+// * @param[in]		- Timer, owned by the caller               *
+// * @param[in]		- Time to the first expiry in ms (>= 1)    *
+// * @param[in]		- Period in ms, 0 for a one-shot timer     *
+// * @param[in]		- Callback run from TIMEBASE_Process       *
+// * @param[in]		- Argument given to the callback	       *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- O(1). May be called from a callback.	   *
+// *************************************************************
+void TIMEBASE_TimerStart(TIMEBASE_Timer_t *pTimer, uint32_t DelayMs, uint32_t PeriodMs, TIMEBASE_Callback_t pCallback, void *pArg)
+{
+	if(pTimer->Active)
+	{
+		TIMEBASE_WheelRemove(pTimer);
+	}
+
+	pTimer->Expiry = ProcessedMs + ((DelayMs != 0) ? DelayMs : 1);
+	pTimer->PeriodMs = PeriodMs;
+	pTimer->pCallback = pCallback;
+	pTimer->pArg = pArg;
+	pTimer->Active = 1;
+
+	TIMEBASE_WheelInsert(pTimer);
+}
+
+// *************************************************************
+// * @fn			- TIMEBASE_TimerStop	                   *
+// * 						                                   *
+// * @brief			- Stops a software timer				   *
+// * 						                                   *
+// * @param[in]		- Timer                                    *
+// *														   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- O(1). Stopping a stopped timer is fine.  *
+// *************************************************************
+void TIMEBASE_TimerStop(TIMEBASE_Timer_t *pTimer)
+{
+	if(pTimer->Active)
+	{
+		TIMEBASE_WheelRemove(pTimer);
+		pTimer->Active = 0;
+	}
+}
+
+// *************************************************************
+// * @fn			- TIMEBASE_Process		                   *
+// * 						                                   *
+// * @brief			- Runs the callbacks of all timers that	   *
+// * 				  expired since the last call			   *
+// * 						                                   *
+// * @return		- Number of callbacks that ran             *
+// *														   *
+// * @note			- Call from the main loop. Each tick only  *
+// * 				  walks the timers of one wheel slot, so   *
+// * 				  the cost per tick does not grow with the *
+// * 				  number of timers as long as they are	   *
+// * 				  spread over the slots. A callback may	   *
+// * 				  start or stop any timer, itself too.	   *
+// *************************************************************
+uint32_t TIMEBASE_Process(void)
+{
+	uint32_t now = TickMs;
+	uint32_t fired = 0;
+
+	while(ProcessedMs != now)
+	{
+		ProcessedMs++;
+
+		TIMEBASE_Timer_t **ppSlot = &Wheel[ProcessedMs & TIMEBASE_WHEEL_MASK];
+		TIMEBASE_Timer_t *pTimer = *ppSlot;
+
+		while(pTimer != NULL)
+		{
+			// Timers more than one wheel turn away share the slot, they stay until their tick
+			if(pTimer->Expiry != ProcessedMs)
+			{
+				pTimer = pTimer->pNext;
+				continue;
+			}
+
+			TIMEBASE_WheelRemove(pTimer);
+			if(pTimer->PeriodMs != 0)
+			{
+				pTimer->Expiry += pTimer->PeriodMs;
+				TIMEBASE_WheelInsert(pTimer);
+			}
+			else
+			{
+				pTimer->Active = 0;
+			}
+
+			pTimer->pCallback(pTimer->pArg);
+			fired++;
+
+			// The callback may have stopped or restarted any timer of the slot, so the walk
+			// starts again from its head. The timers that ran are not due on this tick any
+			// more, a restarted timer expires 1 ms later at the earliest.
+			pTimer = *ppSlot;
+		}
+	}
+
+	return fired;
+}
+
+// *************************************************************
+// * @fn			- TIMEBASE_Pending		                   *
+// * 						                                   *
+// * @brief			- Tells if TIMEBASE_Process has ticks to   *
+// * 				  handle								   *
+// * 						                                   *
+// * @return		- 1 if a tick is not handled yet, else 0   *
+// *														   *
+// * @note			- Checked with interrupts masked before	   *
+// * 				  going to sleep, so a tick that comes in  *
+// * 				  after TIMEBASE_Process is not left for   *
+// * 				  the next one.							   *
+// *************************************************************
+uint8_t TIMEBASE_Pending(void)
+{
+	return (ProcessedMs != TickMs);
+}
+
+// *************************************************************
+// * @fn			- TIMEBASE_TickHandler	                   *
+// * 						                                   *
+// * @brief			- Counts one millisecond				   *
+// * 						                                   *
+// * @return		- None                                     *
+// *														   *
+// * @note			- Called from SysTick_Handler. An		   *
+// * 				  application with its own SysTick_Handler *
+// * 				  must call it from there.				   *
+// *************************************************************
+void TIMEBASE_TickHandler(void)
+{
+	TickMs++;
+}
+
+__weak void SysTick_Handler(void)
+{
+	TIMEBASE_TickHandler();
+}
@@ -0,0 +1,685 @@
+/*
+ * stm32f407xx_usart_driver.c
+ *
+ *  Created on: Jan 15, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "stm32f407xx_usart_driver.h"
+
+#define USART_COUNT				6
+
+// Per USART data: DMA requests (ch. 10.3.3, tables 42 and 43), IRQ number and RCC bit.
+// USART1 RX uses DMA2 stream 2 so stream 5 stays free for TIM1_UP (pattern generator,
+// capture, encoder). The other requests have no second stream. The streams shared with
+// other drivers, only one of them can use a stream (USART_Init returns USART_ERR_BUSY to the
+// second one):
+//	- USART1 RX, DMA2 stream 2: ADC2
+//	- USART3 TX, DMA1 stream 3: SPI2 RX, I2C2 RX
+//	- UART4 RX, DMA1 stream 2: I2C3 RX
+//	- UART4 TX, DMA1 stream 4: SPI2 TX
+//	- UART5 RX, DMA1 stream 0: SPI3 RX, I2C1 RX
+//	- UART5 TX, DMA1 stream 7: SPI3 TX
+//	- USART6 RX, DMA2 stream 1: TIM8_UP (pattern generator, capture, encoder)
+// A USART set up to only send or only receive leaves the other stream free.
+typedef struct
+{
+	USART_RegDef_t *pUSARTx;
+	DMA_RegDef_t *pDMAx;
+	uint8_t RxStream;
+	uint8_t TxStream;
+	uint8_t Channel;
+	uint8_t IRQNumber;
+	uint8_t RCCBit;				// In APB2ENR/APB2RSTR for USART1 and USART6, else APB1
+}USART_Info_t;
+
+static const USART_Info_t Info[USART_COUNT] =
+{
+	{ USART1, DMA2, 2, 7, 4, IRQ_NO_USART1, 4 },
+	{ USART2, DMA1, 5, 6, 4, IRQ_NO_USART2, 17 },
+	{ USART3, DMA1, 1, 3, 4, IRQ_NO_USART3, 18 },
+	{ UART4,  DMA1, 2, 4, 4, IRQ_NO_UART4,  19 },
+	{ UART5,  DMA1, 0, 7, 4, IRQ_NO_UART5,  20 },
+	{ USART6, DMA2, 1, 6, 5, IRQ_NO_USART6, 5 },
+};
+
+// Handles given to USART_Init, used by the IRQ handlers
+static USART_Handle_t *Handles[USART_COUNT];
+
+static void USART_DMARxHandler(void *pArg, uint8_t Flags);
+static void USART_DMATxHandler(void *pArg, uint8_t Flags);
+
+static uint8_t USART_Index(USART_RegDef_t *pUSARTx)
+{
+	uint8_t i;
+
+	for(i = 0; i < USART_COUNT - 1; i++)
+	{
+		if(Info[i].pUSARTx == pUSARTx)
+		{
+			break;
+		}
+	}
+	return i;
+}
+
+static inline uint8_t USART_IsOnAPB2(USART_RegDef_t *pUSARTx)
+{
+	return (pUSARTx == USART1) || (pUSARTx == USART6);
+}
+
+static uint8_t USART_ClockId(USART_RegDef_t *pUSARTx)
+{
+	uint8_t bus = USART_IsOnAPB2(pUSARTx) ? RCC_BUS_APB2 : RCC_BUS_APB1;
+
+	return RCC_CLK_ID(bus, Info[USART_Index(pUSARTx)].RCCBit);
+}
+
+// *************************************************************
+// * @fn			- USART_PeriClockControl                   *
+// * 						                                   *
+// * @brief			- Enables or disables peripheral clock for *
+// * 				  the given USART						   *
+// * 						                                   *
+// * @param[in]		- USART1-3, UART4-5 or USART6			   *
+// * @param[in]		- ENABLE or DISABLE macros	               *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Counted per user. Gated in Sleep mode	   *
+// * 				  unless the ring receives or the queue	   *
+// * 				  sends.								   *
+// *************************************************************
+void USART_PeriClockControl(USART_RegDef_t *pUSARTx, uint8_t EnorDi)
+{
+	if(EnorDi == ENABLE)
+	{
+		RCC_PeriphClockEnable(USART_ClockId(pUSARTx), RCC_CLK_RUN_ONLY);
+	}
+	else
+	{
+		RCC_PeriphClockDisable(USART_ClockId(pUSARTx), RCC_CLK_RUN_ONLY);
+	}
+}
+
+// The USART and its DMA controller keep their clocks in Sleep mode while the ring receives
+// and while the queue sends, one Sleep mode user each
+static void USART_SleepClockControl(USART_Handle_t *pUSARTHandle, uint8_t EnorDi)
+{
+	RCC_PeriphSleepControl(USART_ClockId(pUSARTHandle->pUSARTx), EnorDi);
+	DMA_SleepClockControl(pUSARTHandle->pDMAx, EnorDi);
+}
+
+// *************************************************************
+// * @fn			- USART_SetBaudRate		                   *
+// * 						                                   *
+// * @brief			- Sets BRR (and OVER8) for a baud rate	   *
+// * 						                                   *
+// * @param[in]		- USART1-3, UART4-5 or USART6			   *
+// * @param[in]		- Bits per second		                   *
+// * @param[in]		- Possible values from @USART_OVERSAMPLING *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Uses the bus clock from the RCC driver,  *
+// * 				  call it again after a clock change.	   *
+// * 				  USARTDIV is rounded to the nearest 1/16  *
+// * 				  (1/8 with OVER8), ch. 30.3.4.			   *
+// *************************************************************
+void USART_SetBaudRate(USART_RegDef_t *pUSARTx, uint32_t Baud, uint8_t Oversampling)
+{
+	uint32_t pclk = USART_IsOnAPB2(pUSARTx) ? RCC_GetPCLK2Freq() : RCC_GetPCLK1Freq();
+	uint32_t brr;
+
+	if(Oversampling == USART_OVERSAMPLING_8)
+	{
+		// USARTDIV * 8 = PCLK / baud, the 3 bit fraction is in BRR bits 2:0 and bit 3 stays clear
+		uint32_t div = (pclk + Baud / 2) / Baud;
+
+		brr = ((div >> 3) << 4) | (div & 0x7U);
+		REG_SET_BITS(pUSARTx->CR1, (1U << USART_CR1_OVER8));
+	}
+	else
+	{
+		// Mantissa and 4 bit fraction together are USARTDIV * 16 = PCLK / baud
+		brr = (pclk + Baud / 2) / Baud;
+		REG_CLR_BITS(pUSARTx->CR1, (1U << USART_CR1_OVER8));
+	}
+
+	REG_WRITE(pUSARTx->BRR, brr);
+}
+
+// *************************************************************
+// * @fn			- USART_Init			                   *
+// * 						                                   *
+// * @brief			- Configures and enables the USART and	   *
+// * 				  sets up its interrupts and DMA streams   *
+// * 						                                   *
+// * @param[in]		- Handle with pUSARTx, USARTConfig and	   *
+// * 				  IRQPriority filled in					   *
+// * 						                                   *
+// * @return		- USART_OK, or USART_ERR_BUSY if a DMA	   *
+// * 				  stream the mode needs is used by another *
+// * 				  driver								   *
+// *														   *
+// * @note			- The pins must be set to their alternate  *
+// * 				  function by the caller. Without its DMA  *
+// * 				  streams only USART_SendData works,	   *
+// * 				  USART_RxStart and USART_Submit return	   *
+// * 				  USART_ERR_BUSY. Init again starts with   *
+// * 				  USART_DeInit.							   *
+// *************************************************************
+uint8_t USART_Init(USART_Handle_t *pUSARTHandle)
+{
+	USART_RegDef_t *pUSARTx = pUSARTHandle->pUSARTx;
+	USART_Config_t *pConfig = &pUSARTHandle->USARTConfig;
+	const USART_Info_t *pInfo = &Info[USART_Index(pUSARTx)];
+	uint8_t rx = (pConfig->USART_Mode != USART_MODE_ONLY_TX);
+	uint8_t tx = (pConfig->USART_Mode != USART_MODE_ONLY_RX);
+	uint32_t cr1 = 0, cr3 = 0;
+
+	// Init again: the clocks and streams of the first Init are given back first
+	if(Handles[USART_Index(pUSARTx)] != NULL)
+	{
+		USART_DeInit(pUSARTx);
+	}
+	USART_PeriClockControl(pUSARTx, ENABLE);
+
+	if(tx)
+	{
+		cr1 |= (1U << USART_CR1_TE);
+		cr3 |= (1U << USART_CR3_DMAT);		// Only the transmit queue writes DR
+	}
+	if(rx)
+	{
+		cr1 |= (1U << USART_CR1_RE);
+	}
+	cr1 |= ((uint32_t)pConfig->USART_WordLength << USART_CR1_M);
+	if(pConfig->USART_ParityControl != USART_PARITY_DISABLE)
+	{
+		cr1 |= (1U << USART_CR1_PCE);
+		if(pConfig->USART_ParityControl == USART_PARITY_EN_ODD)
+		{
+			cr1 |= (1U << USART_CR1_PS);
+		}
+	}
+	if(pConfig->USART_HWFlowControl & USART_HW_FLOW_CTRL_CTS)
+	{
+		cr3 |= (1U << USART_CR3_CTSE);
+	}
+	if(pConfig->USART_HWFlowControl & USART_HW_FLOW_CTRL_RTS)
+	{
+		cr3 |= (1U << USART_CR3_RTSE);
+	}
+
+	REG_WRITE(pUSARTx->CR1, cr1);
+	REG_WRITE(pUSARTx->CR2, ((uint32_t)(pConfig->USART_NoOfStopBits & 0x3) << USART_CR2_STOP));
+	REG_WRITE(pUSARTx->CR3, cr3);
+	USART_SetBaudRate(pUSARTx, pConfig->USART_Baud, pConfig->USART_Oversampling);
+
+	pUSARTHandle->RxStream = pInfo->RxStream;
+	pUSARTHandle->TxStream = pInfo->TxStream;
+	pUSARTHandle->DMAChannel = pInfo->Channel;
+	pUSARTHandle->RxRing.pBuffer = NULL;
+	pUSARTHandle->RxErrors = 0;
+	pUSARTHandle->pTxHead = NULL;
+	pUSARTHandle->pTxTail = NULL;
+	Handles[USART_Index(pUSARTx)] = pUSARTHandle;
+
+	GPIO_IRQConfig(pInfo->IRQNumber, pUSARTHandle->IRQPriority, ENABLE);
+	REG_SET_BITS(pUSARTx->CR1, (1U << USART_CR1_UE));
+
+	// The streams of the mode or none, pDMAx stays NULL without them
+	pUSARTHandle->pDMAx = NULL;
+	if( rx && (DMA_RegisterCallback(pInfo->pDMAx, pInfo->RxStream, USART_DMARxHandler, pUSARTHandle) != DMA_OK) )
+	{
+		return USART_ERR_BUSY;
+	}
+	if( tx && (DMA_RegisterCallback(pInfo->pDMAx, pInfo->TxStream, USART_DMATxHandler, pUSARTHandle) != DMA_OK) )
+	{
+		if(rx)
+		{
+			(void)DMA_RegisterCallback(pInfo->pDMAx, pInfo->RxStream, NULL, NULL);
+		}
+		return USART_ERR_BUSY;
+	}
+	pUSARTHandle->pDMAx = pInfo->pDMAx;
+
+	DMA_PeriClockControl(pInfo->pDMAx, ENABLE);
+	if(rx)
+	{
+		GPIO_IRQConfig(DMA_GetIRQNumber(pInfo->pDMAx, pInfo->RxStream), pUSARTHandle->IRQPriority, ENABLE);
+	}
+	if(tx)
+	{
+		GPIO_IRQConfig(DMA_GetIRQNumber(pInfo->pDMAx, pInfo->TxStream), pUSARTHandle->IRQPriority, ENABLE);
+	}
+
+	return USART_OK;
+}
+
+// *************************************************************
+// * @fn			- USART_DeInit			                   *
+// * 						                                   *
+// * @brief			- Resets all registers of the USART		   *
+// * 						                                   *
+// * @param[in]		- USART1-3, UART4-5 or USART6			   *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Through RCC APBxRSTR (ch. 7.3.7 -	   *
+// * 				  7.3.8). The DMA streams and the clocks   *
+// * 				  taken by USART_Init are given back. A	   *
+// * 				  running receive or send is dropped.	   *
+// *************************************************************
+void USART_DeInit(USART_RegDef_t *pUSARTx)
+{
+	USART_Handle_t *pUSARTHandle = Handles[USART_Index(pUSARTx)];
+	uint32_t bit = Info[USART_Index(pUSARTx)].RCCBit;
+	__vo uint32_t *pRSTR = USART_IsOnAPB2(pUSARTx) ? &RCC->APB2RSTR : &RCC->APB1RSTR;
+
+	if( (pUSARTHandle != NULL) && (pUSARTHandle->pDMAx != NULL) )
+	{
+		if(pUSARTHandle->RxRing.pBuffer != NULL)
+		{
+			DMA_StreamDisable(pUSARTHandle->pDMAx, pUSARTHandle->RxStream);
+			pUSARTHandle->RxRing.pBuffer = NULL;
+			USART_SleepClockControl(pUSARTHandle, DISABLE);
+		}
+		if(pUSARTHandle->pTxHead != NULL)
+		{
+			DMA_StreamDisable(pUSARTHandle->pDMAx, pUSARTHandle->TxStream);
+			pUSARTHandle->pTxHead = NULL;
+			pUSARTHandle->pTxTail = NULL;
+			USART_SleepClockControl(pUSARTHandle, DISABLE);
+		}
+		if(pUSARTHandle->USARTConfig.USART_Mode != USART_MODE_ONLY_TX)
+		{
+			(void)DMA_RegisterCallback(pUSARTHandle->pDMAx, pUSARTHandle->RxStream, NULL, NULL);
+		}
+		if(pUSARTHandle->USARTConfig.USART_Mode != USART_MODE_ONLY_RX)
+		{
+			(void)DMA_RegisterCallback(pUSARTHandle->pDMAx, pUSARTHandle->TxStream, NULL, NULL);
+		}
+		DMA_PeriClockControl(pUSARTHandle->pDMAx, DISABLE);
+		pUSARTHandle->pDMAx = NULL;
+	}
+
+	REG_BB_SET(*pRSTR, bit);
+	REG_BB_CLR(*pRSTR, bit);
+
+	if(pUSARTHandle != NULL)
+	{
+		USART_PeriClockControl(pUSARTx, DISABLE);
+		Handles[USART_Index(pUSARTx)] = NULL;
+	}
+}
+
+// *************************************************************
+// * @fn			- USART_SendData		                   *
+// * 						                                   *
+// * @brief			- Sends "Len" bytes and waits until the	   *
+// * 				  last one has left the shift register	   *
+// * 						                                   *
+// * @param[in]		- USART1-3, UART4-5 or USART6			   *
+// * @param[in]		- Data to send			                   *
+// * @param[in]		- Length in bytes		                   *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Blocking call, do not mix with a busy	   *
+// * 				  transmit queue						   *
+// *************************************************************
+void USART_SendData(USART_RegDef_t *pUSARTx, const uint8_t *pTxBuffer, uint32_t Len)
+{
+	for(uint32_t i = 0; i < Len; i++)
+	{
+		while( !(REG_READ(pUSARTx->SR) & (1U << USART_SR_TXE)) );
+		REG_WRITE(pUSARTx->DR, pTxBuffer[i]);
+	}
+	while( !(REG_READ(pUSARTx->SR) & (1U << USART_SR_TC)) );
+}
+
+// *************************************************************
+// * @fn			- USART_RxRingUpdate	                   *
+// * 						                                   *
+// * @brief			- Hands the data between the tail and the  *
+// * 				  DMA write position to the callback	   *
+// * 						                                   *
+// * @param[in]		- Ring			                           *
+// * @param[in]		- DMA write position, 0 to Size			   *
+// * @param[in]		- Possible values from @USART_RX_FLAGS     *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Constant work per call, however long the *
+// * 				  data is. Data that wraps around the end  *
+// * 				  of the ring is handed over in two calls, *
+// * 				  only the last one gets the flags.		   *
+// *************************************************************
+void USART_RxRingUpdate(USART_RxRing_t *pRing, uint16_t Head, uint8_t Flags)
+{
+	uint16_t tail = pRing->Tail;
+
+	// NDTR reads 0 for a moment before the circular reload
+	if(Head >= pRing->Size)
+	{
+		Head = 0;
+	}
+
+	if(Head == tail)
+	{
+		if(Flags & USART_RX_FRAME_END)
+		{
+			pRing->pCallback(&pRing->pBuffer[tail], 0, Flags, pRing->pArg);
+		}
+		return;
+	}
+
+	if(Head > tail)
+	{
+		pRing->pCallback(&pRing->pBuffer[tail], Head - tail, Flags, pRing->pArg);
+	}
+	else if(Head == 0)
+	{
+		pRing->pCallback(&pRing->pBuffer[tail], pRing->Size - tail, Flags, pRing->pArg);
+	}
+	else
+	{
+		pRing->pCallback(&pRing->pBuffer[tail], pRing->Size - tail, 0, pRing->pArg);
+		pRing->pCallback(&pRing->pBuffer[0], Head, Flags, pRing->pArg);
+	}
+
+	pRing->Tail = Head;
+}
+
+// DMA write position in the ring
+static inline uint16_t USART_RxHead(USART_Handle_t *pUSARTHandle)
+{
+	return pUSARTHandle->RxRing.Size - DMA_GetRemaining(pUSARTHandle->pDMAx, pUSARTHandle->RxStream);
+}
+
+// *************************************************************
+// * @fn			- USART_RxStart			                   *
+// * 						                                   *
+// * @brief			- Starts receiving into a ring with a	   *
+// * 				  circular DMA							   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * @param[in]		- Ring buffer, in SRAM1/SRAM2 (not CCM)    *
+// * @param[in]		- Size of the ring in bytes                *
+// * @param[in]		- Called with the received data            *
+// * @param[in]		- Argument given to the callback           *
+// * 						                                   *
+// * @return		- USART_OK, USART_ERR_PARAM, or			   *
+// * 				  USART_ERR_BUSY without the RX stream	   *
+// *														   *
+// * @note			- The ring should hold at least two of the *
+// * 				  longest frames, so a frame is not written*
+// * 				  over while the callback still uses it	   *
+// *************************************************************
+uint8_t USART_RxStart(USART_Handle_t *pUSARTHandle, uint8_t *pBuffer, uint16_t Size, USART_RxCallback_t pCallback, void *pArg)
+{
+	USART_RegDef_t *pUSARTx = pUSARTHandle->pUSARTx;
+	DMA_StreamConfig_t dma = { 0 };
+
+	if( (pBuffer == NULL) || (Size < 2) || (pCallback == NULL) )
+	{
+		return USART_ERR_PARAM;
+	}
+	if( (pUSARTHandle->pDMAx == NULL) || (pUSARTHandle->USARTConfig.USART_Mode == USART_MODE_ONLY_TX) )
+	{
+		return USART_ERR_BUSY;
+	}
+
+	USART_RxStop(pUSARTHandle);
+	USART_SleepClockControl(pUSARTHandle, ENABLE);
+
+	pUSARTHandle->RxRing.pBuffer = pBuffer;
+	pUSARTHandle->RxRing.Size = Size;
+	pUSARTHandle->RxRing.Tail = 0;
+	pUSARTHandle->RxRing.pCallback = pCallback;
+	pUSARTHandle->RxRing.pArg = pArg;
+
+	dma.Channel = pUSARTHandle->DMAChannel;
+	dma.Direction = DMA_DIR_P2M;
+	dma.PeriphSize = DMA_SIZE_BYTE;
+	dma.MemSize = DMA_SIZE_BYTE;
+	dma.MemInc = ENABLE;
+	dma.Circular = ENABLE;
+	dma.Priority = DMA_PRIORITY_VERY_HIGH;		// An overrun loses data, a late TX does not
+	dma.Interrupts = DMA_FLAG_HT | DMA_FLAG_TC | DMA_FLAG_TE;
+	DMA_StreamInit(pUSARTHandle->pDMAx, pUSARTHandle->RxStream, &dma);
+	DMA_StreamSetAddress(pUSARTHandle->pDMAx, pUSARTHandle->RxStream, &pUSARTx->DR, pBuffer, NULL, Size);
+	DMA_StreamEnable(pUSARTHandle->pDMAx, pUSARTHandle->RxStream);
+
+	// IDLE is cleared by reading SR then DR, so an old idle line does not end the first frame
+	(void)REG_READ(pUSARTx->SR);
+	(void)REG_READ(pUSARTx->DR);
+	REG_SET_BITS(pUSARTx->CR3, (1U << USART_CR3_DMAR));
+	REG_SET_BITS(pUSARTx->CR1, (1U << USART_CR1_IDLEIE));
+
+	return USART_OK;
+}
+
+// *************************************************************
+// * @fn			- USART_RxStop			                   *
+// * 						                                   *
+// * @brief			- Stops receiving						   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Data received so far is handed to the	   *
+// * 				  callback before it returns			   *
+// *************************************************************
+void USART_RxStop(USART_Handle_t *pUSARTHandle)
+{
+	USART_RegDef_t *pUSARTx = pUSARTHandle->pUSARTx;
+
+	if(pUSARTHandle->RxRing.pBuffer == NULL)
+	{
+		return;
+	}
+
+	REG_CLR_BITS(pUSARTx->CR1, (1U << USART_CR1_IDLEIE));
+	REG_CLR_BITS(pUSARTx->CR3, (1U << USART_CR3_DMAR));
+	DMA_StreamDisable(pUSARTHandle->pDMAx, pUSARTHandle->RxStream);
+
+	USART_RxRingUpdate(&pUSARTHandle->RxRing, USART_RxHead(pUSARTHandle), 0);
+	pUSARTHandle->RxRing.pBuffer = NULL;
+	USART_SleepClockControl(pUSARTHandle, DISABLE);
+}
+
+// DMA RX stream interrupt: half or whole ring written
+static void USART_DMARxHandler(void *pArg, uint8_t Flags)
+{
+	USART_Handle_t *pUSARTHandle = (USART_Handle_t*)pArg;
+
+	if(Flags & DMA_FLAG_TE)
+	{
+		pUSARTHandle->RxErrors++;
+	}
+	if( (Flags & (DMA_FLAG_HT | DMA_FLAG_TC)) && (pUSARTHandle->RxRing.pBuffer != NULL) )
+	{
+		USART_RxRingUpdate(&pUSARTHandle->RxRing, USART_RxHead(pUSARTHandle), 0);
+	}
+}
+
+// Starts sending the buffer at the head of the queue
+static void USART_StartTx(USART_Handle_t *pUSARTHandle)
+{
+	USART_TxBuffer_t *pTx = pUSARTHandle->pTxHead;
+	DMA_StreamConfig_t dma = { 0 };
+
+	pTx->Status = USART_TX_ACTIVE;
+
+	dma.Channel = pUSARTHandle->DMAChannel;
+	dma.Direction = DMA_DIR_M2P;
+	dma.PeriphSize = DMA_SIZE_BYTE;
+	dma.MemSize = DMA_SIZE_BYTE;
+	dma.MemInc = ENABLE;
+	dma.Priority = DMA_PRIORITY_HIGH;
+	dma.Interrupts = DMA_FLAG_TC | DMA_FLAG_TE;
+	DMA_StreamInit(pUSARTHandle->pDMAx, pUSARTHandle->TxStream, &dma);
+	DMA_StreamSetAddress(pUSARTHandle->pDMAx, pUSARTHandle->TxStream, &pUSARTHandle->pUSARTx->DR,
+			(void*)pTx->pData, NULL, pTx->Len);
+	DMA_StreamEnable(pUSARTHandle->pDMAx, pUSARTHandle->TxStream);
+}
+
+// DMA TX stream interrupt: the buffer has been handed to the USART and can be reused
+static void USART_DMATxHandler(void *pArg, uint8_t Flags)
+{
+	USART_Handle_t *pUSARTHandle = (USART_Handle_t*)pArg;
+	USART_TxBuffer_t *pTx = pUSARTHandle->pTxHead;
+	USART_TxBuffer_t *pNext;
+
+	if( (pTx == NULL) || !(Flags & (DMA_FLAG_TC | DMA_FLAG_TE)) )
+	{
+		return;
+	}
+
+	// The queue is updated before the callback, so the callback may submit again
+	pNext = pTx->pNext;
+	pUSARTHandle->pTxHead = pNext;
+	if(pNext == NULL)
+	{
+		pUSARTHandle->pTxTail = NULL;
+		USART_SleepClockControl(pUSARTHandle, DISABLE);
+	}
+
+	pTx->Status = (Flags & DMA_FLAG_TE) ? USART_TX_ERROR : USART_TX_DONE;
+	if(pTx->pCallback != NULL)
+	{
+		pTx->pCallback(pTx, pTx->pArg);
+	}
+
+	if(pNext != NULL)
+	{
+		USART_StartTx(pUSARTHandle);
+	}
+}
+
+// *************************************************************
+// * @fn			- USART_Submit			                   *
+// * 						                                   *
+// * @brief			- Queues a buffer to send				   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * @param[in]		- Buffer, owned by the caller              *
+// * 						                                   *
+// * @return		- USART_OK, USART_ERR_PARAM, or			   *
+// * 				  USART_ERR_BUSY without the TX stream	   *
+// *														   *
+// * @note			- Returns at once. May be called from a	   *
+// * 				  transmit callback.					   *
+// *************************************************************
+uint8_t USART_Submit(USART_Handle_t *pUSARTHandle, USART_TxBuffer_t *pTx)
+{
+	uint32_t primask;
+	uint8_t start;
+
+	if( (pTx->Len == 0) || (pTx->pData == NULL) )
+	{
+		return USART_ERR_PARAM;
+	}
+	if( (pUSARTHandle->pDMAx == NULL) || (pUSARTHandle->USARTConfig.USART_Mode == USART_MODE_ONLY_RX) )
+	{
+		return USART_ERR_BUSY;
+	}
+
+	pTx->pNext = NULL;
+	pTx->Status = USART_TX_QUEUED;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	start = (pUSARTHandle->pTxHead == NULL);
+	if(start)
+	{
+		pUSARTHandle->pTxHead = pTx;
+	}
+	else
+	{
+		pUSARTHandle->pTxTail->pNext = pTx;
+	}
+	pUSARTHandle->pTxTail = pTx;
+
+	__set_PRIMASK(primask);
+
+	if(start)
+	{
+		USART_SleepClockControl(pUSARTHandle, ENABLE);
+		USART_StartTx(pUSARTHandle);
+	}
+
+	return USART_OK;
+}
+
+uint8_t USART_IsTxIdle(USART_Handle_t *pUSARTHandle)
+{
+	return (pUSARTHandle->pTxHead == NULL);
+}
+
+// *************************************************************
+// * @fn			- USART_IRQHandling		                   *
+// * 						                                   *
+// * @brief			- Serves the IDLE line interrupt		   *
+// * 						                                   *
+// * @param[in]		- Handle		                           *
+// * 						                                   *
+// * @return		- None	                                   *
+// *														   *
+// * @note			- Ends the current frame. Reading SR then  *
+// * 				  DR clears IDLE and the error flags.	   *
+// *************************************************************
+void USART_IRQHandling(USART_Handle_t *pUSARTHandle)
+{
+	USART_RegDef_t *pUSARTx = pUSARTHandle->pUSARTx;
+	uint32_t sr = REG_READ(pUSARTx->SR);
+
+	if( !(sr & (1U << USART_SR_IDLE)) || (pUSARTHandle->RxRing.pBuffer == NULL) )
+	{
+		return;
+	}
+
+	(void)REG_READ(pUSARTx->DR);
+	if(sr & ((1U << USART_SR_PE) | (1U << USART_SR_FE) | (1U << USART_SR_NF) | (1U << USART_SR_ORE)))
+	{
+		pUSARTHandle->RxErrors++;
+	}
+
+	USART_RxRingUpdate(&pUSARTHandle->RxRing, USART_RxHead(pUSARTHandle), USART_RX_FRAME_END);
+}
+
+// USART interrupt handlers. Weak, so the application can write its own.
+__weak void USART1_IRQHandler(void)
+{
+	if(Handles[0] != NULL) { USART_IRQHandling(Handles[0]); }
+}
+
+__weak void USART2_IRQHandler(void)
+{
+	if(Handles[1] != NULL) { USART_IRQHandling(Handles[1]); }
+}
+
+__weak void USART3_IRQHandler(void)
+{
+	if(Handles[2] != NULL) { USART_IRQHandling(Handles[2]); }
+}
+
+__weak void UART4_IRQHandler(void)
+{
+	if(Handles[3] != NULL) { USART_IRQHandling(Handles[3]); }
+}
+
+__weak void UART5_IRQHandler(void)
+{
+	if(Handles[4] != NULL) { USART_IRQHandling(Handles[4]); }
+}
+
+__weak void USART6_IRQHandler(void)
+{
+	if(Handles[5] != NULL) { USART_IRQHandling(Handles[5]); }
+}
@@ -0,0 +1,113 @@
+/*
+ * bench_adc.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <stdlib.h>
+#include "test.h"
+
+// ADC_ProcessFrame on the SIMD and the scalar path: frames of 128 scans of 1, 4 and 8
+// channels, all with the same filter, for each filter type and a FIR of 8 and of 32 taps.
+// Host times: the SIMD path runs the C versions of the DSP instructions here, so the ratio
+// is not the one of the target (ADC_GetCyclesPerKSample measures that on the chip).
+
+#define SCANS		ADC_MAX_FRAME_SCANS
+#define ROUNDS		2000
+
+static const uint8_t Channels[ADC_MAX_CHANNELS] = { 0, 1, 2, 3, 10, 11, 8, 9 };
+
+static ADC_Handle_t Handle;
+static uint16_t Buffer[2 * SCANS * ADC_MAX_CHANNELS];
+static uint16_t Frame[SCANS * ADC_MAX_CHANNELS];
+
+typedef struct
+{
+	const char *pName;
+	uint8_t Type;
+	uint8_t Length;
+}Filter_t;
+
+static const Filter_t Filters[] =
+{
+	{ "none",          ADC_FILTER_NONE,   0 },
+	{ "average of 16", ADC_FILTER_MOVAVG,  4 },
+	{ "FIR  8 taps",   ADC_FILTER_FIR,    8 },
+	{ "FIR 32 taps",   ADC_FILTER_FIR,    ADC_FIR_MAX_TAPS },
+	{ "biquad",        ADC_FILTER_BIQUAD, 0 },
+};
+
+static double NsPerSample(const Filter_t *pFilter, uint8_t ChannelCount, uint8_t Path)
+{
+	static const int16_t biquad[5] = { 4000, 8000, 4000, -20000, 7000 };
+	uint64_t start;
+
+	Handle = (ADC_Handle_t){ 0 };
+	Handle.Config.pADCx = ADC1;
+	Handle.Config.pChannels = Channels;
+	Handle.Config.ChannelCount = ChannelCount;
+	Handle.Config.SampleTime = ADC_SMP_15;
+	Handle.Config.Path = Path;
+	Handle.Config.pTIMx = TIM2;
+	Handle.Config.TimerClockHz = 84000000U;
+	Handle.Config.ScanRateHz = 10000U;
+	Handle.Config.pBuffer = Buffer;
+	Handle.Config.FrameScans = SCANS;
+	for(uint8_t c = 0; c < ChannelCount; c++)
+	{
+		Handle.Config.Offset[c] = -2048;
+		Handle.Filter[c].Type = pFilter->Type;
+		Handle.Filter[c].Length = pFilter->Length;
+		for(uint8_t k = 0; k < ADC_FIR_MAX_TAPS; k++)
+		{
+			Handle.Filter[c].Coeffs[k] = (pFilter->Type == ADC_FILTER_BIQUAD) ? ((k < 5) ? biquad[k] : 0) :
+					(int16_t)(1000 - 50 * k);
+		}
+	}
+	if(ADC_Init(&Handle) != ADC_OK)
+	{
+		return 0;
+	}
+
+	start = TEST_NowNs();
+	for(uint32_t r = 0; r < ROUNDS; r++)
+	{
+		ADC_ProcessFrame(&Handle, Frame);
+	}
+
+	return (double)(TEST_NowNs() - start) / ((double)ROUNDS * SCANS * ChannelCount);
+}
+
+static void Run(const Filter_t *pFilter)
+{
+	static const uint8_t counts[3] = { 1, 4, ADC_MAX_CHANNELS };
+
+	printf("  %-14s", pFilter->pName);
+	for(uint8_t i = 0; i < 3; i++)
+	{
+		double simd = NsPerSample(pFilter, counts[i], ADC_PATH_SIMD);
+		double scalar = NsPerSample(pFilter, counts[i], ADC_PATH_SCALAR);
+
+		printf("  %u ch %6.2f / %6.2f", (unsigned)counts[i], simd, scalar);
+	}
+	printf("  ns per sample, SIMD / scalar\n");
+	ADC_DeInit(&Handle);
+}
+
+int main(void)
+{
+	SIM_Reset();
+	srand(25);
+	for(uint32_t i = 0; i < SCANS * ADC_MAX_CHANNELS; i++)
+	{
+		Frame[i] = (uint16_t)(rand() & 0xFFF);
+	}
+
+	for(uint32_t i = 0; i < sizeof(Filters) / sizeof(Filters[0]); i++)
+	{
+		Run(&Filters[i]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,129 @@
+/*
+ * bench_debounce.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <stdlib.h>
+#include "test.h"
+
+// Debounce of a port with vertical counters (DEBOUNCE_Update) against a counter per pin,
+// for 1, 4 and 16 pins and the shortest and longest StableCount. The samples are made up
+// beforehand, so only the debounce is timed.
+
+#define SAMPLES		4096
+#define ROUNDS		200
+
+static uint16_t Samples[SAMPLES];
+static volatile uint16_t Sink;
+
+typedef struct
+{
+	uint16_t PinMask;
+	uint8_t StableCount;
+	uint16_t State;
+	uint8_t Count[16];
+}Naive_t;
+
+static uint16_t NaiveUpdate(Naive_t *pNaive, uint16_t Sample)
+{
+	uint16_t changed = 0;
+
+	for(uint8_t pin = 0; pin < 16; pin++)
+	{
+		uint16_t bit = (uint16_t)(1U << pin);
+
+		if( !(pNaive->PinMask & bit) )
+		{
+			continue;
+		}
+		if((Sample ^ pNaive->State) & bit)
+		{
+			if(++pNaive->Count[pin] == pNaive->StableCount)
+			{
+				changed |= bit;
+				pNaive->Count[pin] = 0;
+			}
+		}
+		else
+		{
+			pNaive->Count[pin] = 0;
+		}
+	}
+	pNaive->State ^= changed;
+
+	return changed;
+}
+
+static double TimeNaive(uint16_t PinMask, uint8_t StableCount)
+{
+	Naive_t naive = { .PinMask = PinMask, .StableCount = StableCount };
+	uint16_t changed = 0;
+	uint64_t start = TEST_NowNs();
+
+	for(uint32_t r = 0; r < ROUNDS; r++)
+	{
+		for(uint32_t i = 0; i < SAMPLES; i++)
+		{
+			changed |= NaiveUpdate(&naive, Samples[i]);
+		}
+	}
+	Sink = changed;
+
+	return (double)(TEST_NowNs() - start) / ((double)ROUNDS * SAMPLES);
+}
+
+static double TimeVertical(uint16_t PinMask, uint8_t StableCount)
+{
+	DEBOUNCE_Handle_t handle = { 0 };
+	uint16_t changed = 0;
+	uint64_t start;
+
+	handle.Config.pGPIOx = GPIOA;
+	handle.Config.PinMask = PinMask;
+	handle.Config.StableCount = StableCount;
+	(void)DEBOUNCE_Init(&handle);
+
+	start = TEST_NowNs();
+	for(uint32_t r = 0; r < ROUNDS; r++)
+	{
+		for(uint32_t i = 0; i < SAMPLES; i++)
+		{
+			changed |= DEBOUNCE_Update(&handle, Samples[i]);
+		}
+	}
+	Sink = changed;
+
+	return (double)(TEST_NowNs() - start) / ((double)ROUNDS * SAMPLES);
+}
+
+int main(void)
+{
+	static const uint16_t masks[] = { 0x0001, 0x000F, 0xFFFF };
+	static const uint8_t stables[] = { 1, DEBOUNCE_STABLE_MAX };
+	uint16_t level = 0;
+
+	SIM_Reset();
+	srand(1);
+	for(uint32_t i = 0; i < SAMPLES; i++)
+	{
+		if(rand() % 32 == 0)
+		{
+			level ^= (uint16_t)(1U << (rand() % 16));
+		}
+		Samples[i] = level ^ (uint16_t)((rand() % 4 == 0) ? (rand() & rand()) : 0);
+	}
+
+	for(uint32_t s = 0; s < sizeof(stables) / sizeof(stables[0]); s++)
+	{
+		for(uint32_t m = 0; m < sizeof(masks) / sizeof(masks[0]); m++)
+		{
+			printf("  stable %2u, %2u pins: counter per pin %6.2f ns, vertical %6.2f ns per tick\n",
+					(unsigned)stables[s], (unsigned)__builtin_popcount(masks[m]),
+					TimeNaive(masks[m], stables[s]), TimeVertical(masks[m], stables[s]));
+		}
+	}
+
+	return 0;
+}
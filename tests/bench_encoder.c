@@ -0,0 +1,136 @@
+/*
+ * bench_encoder.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <stdlib.h>
+#include "test.h"
+
+// Quadrature decoding of a block of port samples (ENCODER_UpdateBatch, as the poll mode DMA
+// interrupt does it) against a call of ENCODER_Update per sample, for 1, 4 and 8 encoders.
+// Encoder c is on pins 2c and 2c + 1 and steps every 4 + c samples, forward then back.
+// Noisy: a pin bounces (is flipped for one sample) with probability 1/BOUNCE, which decodes
+// as a step and its undo, and with 1/GLITCH both pins of an encoder flip for one sample, an
+// illegal transition counted as an error (so is a bounce of one pin right at a step of the
+// other). The samples are made up beforehand, so only the decoding is timed. Errors and drift
+// (how far the noisy positions end from the clean ones, all encoders together) are per pass
+// over the samples.
+
+#define SAMPLES		4096
+#define ROUNDS		400
+#define BOUNCE		16
+#define GLITCH		512
+
+static uint16_t Clean[SAMPLES];
+static uint16_t Noisy[SAMPLES];
+
+static uint16_t Quad(uint32_t Step, uint8_t Channel)
+{
+	static const uint8_t levels[4] = { 0x0, 0x2, 0x3, 0x1 };
+	uint8_t ab = levels[Step % 4];
+
+	return (uint16_t)((((ab >> 1) & 1U) << (2 * Channel)) | ((ab & 1U) << (2 * Channel + 1)));
+}
+
+static void MakeSamples(void)
+{
+	srand(3);
+	for(uint32_t n = 0; n < SAMPLES; n++)
+	{
+		uint16_t sample = 0, noise = 0;
+
+		for(uint8_t c = 0; c < ENCODER_MAX_CHANNELS; c++)
+		{
+			uint32_t step = n / (4U + c);
+			uint32_t half = (SAMPLES / 2) / (4U + c);
+
+			sample |= Quad((step < half) ? step : 2 * half - step, c);
+			if(rand() % GLITCH == 0)
+			{
+				noise |= (uint16_t)(3U << (2 * c));
+			}
+			else if(rand() % BOUNCE == 0)
+			{
+				noise |= (uint16_t)(1U << (2 * c + (rand() & 1)));
+			}
+		}
+		Clean[n] = sample;
+		Noisy[n] = sample ^ noise;
+	}
+}
+
+static void Setup(ENCODER_Handle_t *pHandle, uint8_t Channels)
+{
+	*pHandle = (ENCODER_Handle_t){ 0 };
+	pHandle->Config.ChannelCount = Channels;
+	for(uint8_t c = 0; c < Channels; c++)
+	{
+		pHandle->Channel[c].PinA = (uint8_t)(2 * c);
+		pHandle->Channel[c].PinB = (uint8_t)(2 * c + 1);
+	}
+}
+
+static double Time(ENCODER_Handle_t *pHandle, const uint16_t *pSamples, uint8_t Batch)
+{
+	uint64_t start = TEST_NowNs();
+
+	for(uint32_t r = 0; r < ROUNDS; r++)
+	{
+		if(Batch)
+		{
+			ENCODER_UpdateBatch(pHandle, pSamples, SAMPLES);
+		}
+		else
+		{
+			for(uint32_t n = 0; n < SAMPLES; n++)
+			{
+				ENCODER_Update(pHandle, pSamples[n]);
+			}
+		}
+	}
+
+	return (double)(TEST_NowNs() - start) / ((double)ROUNDS * SAMPLES);
+}
+
+static void Run(uint8_t Channels)
+{
+	ENCODER_Handle_t clean, noisy, single;
+	double tClean, tNoisy, tSingle;
+	uint32_t drift = 0, errors = 0;
+
+	Setup(&clean, Channels);
+	Setup(&noisy, Channels);
+	Setup(&single, Channels);
+	tClean = Time(&clean, Clean, 1);
+	tNoisy = Time(&noisy, Noisy, 1);
+	tSingle = Time(&single, Noisy, 0);
+
+	for(uint8_t c = 0; c < Channels; c++)
+	{
+		int32_t d = ENCODER_GetPosition(&noisy, c) - ENCODER_GetPosition(&clean, c);
+
+		drift += (uint32_t)((d < 0) ? -d : d);
+		errors += ENCODER_GetErrors(&noisy, c);
+		if( (ENCODER_GetPosition(&single, c) != ENCODER_GetPosition(&noisy, c)) || (ENCODER_GetErrors(&clean, c) != 0) )
+		{
+			printf("  %u encoders: channel %u decoded differently\n", (unsigned)Channels, (unsigned)c);
+		}
+	}
+
+	printf("  %u encoder%s batch clean %5.2f ns, noisy %5.2f ns, per sample noisy %5.2f ns per sample;"
+			" %4.0f errors, drift %4.1f steps\n", (unsigned)Channels, (Channels == 1) ? ": " : "s:",
+			tClean, tNoisy, tSingle, (double)errors / ROUNDS, (double)drift / ROUNDS);
+}
+
+int main(void)
+{
+	MakeSamples();
+
+	Run(1);
+	Run(4);
+	Run(ENCODER_MAX_CHANNELS);
+
+	return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * bench_gpio_init.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "test.h"
+
+// Configuration of a whole port: batched (GPIO_InitPort, GPIO_ApplyPortConfig) against one
+// pin at a time (GPIO_init, and the read-modify-write per register and pin the driver used
+// to do). Bus accesses are counted by the simulator, they are the same on the target.
+
+#define ROUNDS		20000
+
+static GPIO_PinConfig_t Pins[16];
+
+// One pin with a read-modify-write of each register, as before GPIO_InitPort
+static void NaiveInitPin(GPIO_RegDef_t *pGPIOx, const GPIO_PinConfig_t *pPin)
+{
+	uint8_t pin = pPin->GPIO_PinNumber;
+
+	REG_MODIFY(pGPIOx->MODER, 0x3U << (2 * pin), (uint32_t)pPin->GPIO_PinMode << (2 * pin));
+	REG_MODIFY(pGPIOx->OSPEEDR, 0x3U << (2 * pin), (uint32_t)pPin->GPIO_PinSpeed << (2 * pin));
+	REG_MODIFY(pGPIOx->PUPDR, 0x3U << (2 * pin), (uint32_t)pPin->GPIO_PinPuPdControl << (2 * pin));
+	REG_MODIFY(pGPIOx->OTYPER, 0x1U << pin, (uint32_t)pPin->GPIO_PinOPType << pin);
+	if(pPin->GPIO_PinMode == GPIO_MODE_ALTFN)
+	{
+		REG_MODIFY(pGPIOx->AFR[pin / 8], 0xFU << (4 * (pin % 8)),
+				(uint32_t)pPin->GPIO_PinAltFunMode << (4 * (pin % 8)));
+	}
+}
+
+static void NaiveInit(uint32_t Len)
+{
+	for(uint32_t i = 0; i < Len; i++)
+	{
+		NaiveInitPin(GPIOD, &Pins[i]);
+	}
+}
+
+static void PerPinInit(uint32_t Len)
+{
+	GPIO_Handle_t handle = { .pGPIOx = GPIOD };
+
+	for(uint32_t i = 0; i < Len; i++)
+	{
+		handle.GPIO_PinConfig = Pins[i];
+		GPIO_init(&handle);
+	}
+}
+
+static void BatchedInit(uint32_t Len)
+{
+	(void)GPIO_InitPort(GPIOD, Pins, (uint8_t)Len);
+}
+
+static GPIO_PortConfig_t Prebuilt;
+
+static void PrebuiltApply(uint32_t Len)
+{
+	(void)Len;
+	GPIO_ApplyPortConfig(GPIOD, &Prebuilt);
+}
+
+static void Run(const char *pName, void (*pInit)(uint32_t Len), uint32_t Len)
+{
+	uint64_t start;
+	uint32_t reads, writes;
+
+	SIM_Reset();
+	GPIO_PeriClockEnable(GPIOD);
+	(void)GPIO_BuildPortConfig(Pins, (uint8_t)Len, &Prebuilt);
+
+	pInit(Len);			// Loads the shadow of the port, it is read once after reset
+
+	SIM_ResetCounters();
+	pInit(Len);
+	reads = SIM_GetTotalReads();
+	writes = SIM_GetTotalWrites();
+
+	start = TEST_NowNs();
+	for(uint32_t i = 0; i < ROUNDS; i++)
+	{
+		pInit(Len);
+	}
+
+	printf("  %-22s %2u pins: %3u reads %3u writes, %7.1f ns per port\n", pName, (unsigned)Len,
+			(unsigned)reads, (unsigned)writes, (double)(TEST_NowNs() - start) / ROUNDS);
+
+	GPIO_PeriClockDisable(GPIOD);
+}
+
+int main(void)
+{
+	static const uint32_t lengths[] = { 1, 4, 16 };
+
+	// Mixed port: outputs, alternate functions and pulled-up inputs
+	for(uint8_t i = 0; i < 16; i++)
+	{
+		Pins[i].GPIO_PinNumber = i;
+		Pins[i].GPIO_PinMode = (i % 3 == 0) ? GPIO_MODE_OUT : (i % 3 == 1) ? GPIO_MODE_ALTFN : GPIO_MODE_IN;
+		Pins[i].GPIO_PinSpeed = GPIO_MODE_FAST;
+		Pins[i].GPIO_PinPuPdControl = (i % 3 == 2) ? GPIO_PIN_PU : GPIO_NO_PUPD;
+		Pins[i].GPIO_PinOPType = GPIO_MODE_PP;
+		Pins[i].GPIO_PinAltFunMode = (i % 3 == 1) ? 7 : 0;
+	}
+
+	for(uint32_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+	{
+		Run("read-modify-write/pin", NaiveInit, lengths[i]);
+		Run("GPIO_init/pin", PerPinInit, lengths[i]);
+		Run("GPIO_InitPort", BatchedInit, lengths[i]);
+		Run("GPIO_ApplyPortConfig", PrebuiltApply, lengths[i]);
+	}
+
+	return 0;
+}
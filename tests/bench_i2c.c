@@ -0,0 +1,90 @@
+/*
+ * bench_i2c.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <string.h>
+#include "test.h"
+
+// One read of 2, 4, 16 and 64 bytes through the transaction queue, by interrupt and by DMA
+// (DMAMinLen 2). The slave is played as in test_i2c.c. The CPU bus accesses and interrupts
+// from I2C_Submit to the end are counted by the simulator, they are the same on the target;
+// the time per read is host time and includes the slave model.
+
+#define ROUNDS		2000
+
+static uint8_t Rx[64];
+static I2C_Handle_t Handle;
+static uint32_t Irqs;
+
+static void Read(uint16_t Len)
+{
+	I2C_Transaction_t txn = { .Address = 0x50, .pRxBuffer = Rx, .RxLen = Len };
+	uint16_t sent = 0;
+
+	(void)I2C_Submit(&Handle, &txn);
+	I2C1_EV_IRQHandler();
+	I2C1->SR1 |= (1U << I2C_SR1_ADDR);
+	I2C1_EV_IRQHandler();
+	Irqs = 2;
+
+	if(Handle.pDMAx != NULL)
+	{
+		SIM_DMAComplete(DMA1, Handle.RxStream);
+		DMA1_Stream0_IRQHandler();
+		Irqs++;
+	}
+	while(!I2C_IsIdle(&Handle))
+	{
+		if( (sent < Len) && SIM_I2CReceive(I2C1, (uint8_t)sent) )
+		{
+			sent++;
+		}
+		I2C1_EV_IRQHandler();
+		Irqs++;
+	}
+}
+
+static void Run(const char *pName, uint16_t DMAMinLen, uint16_t Len)
+{
+	uint64_t start;
+	uint32_t accesses;
+
+	SIM_Reset();
+	memset(&Handle, 0, sizeof(Handle));
+	Handle.pI2Cx = I2C1;
+	Handle.I2CConfig.I2C_SCLSpeed = I2C_SCL_SPEED_FM;
+	Handle.DMAMinLen = DMAMinLen;
+	(void)I2C_Init(&Handle);
+
+	SIM_ResetCounters();
+	Read(Len);
+	accesses = SIM_GetTotalAccesses();
+
+	start = TEST_NowNs();
+	for(uint32_t i = 0; i < ROUNDS; i++)
+	{
+		Read(Len);
+	}
+
+	printf("  %-10s %2u bytes: %2u interrupts, %4u accesses (%5.2f per byte), %8.1f ns per read\n", pName,
+			(unsigned)Len, (unsigned)Irqs, (unsigned)accesses, (double)accesses / Len,
+			(double)(TEST_NowNs() - start) / ROUNDS);
+
+	I2C_DeInit(I2C1);
+}
+
+int main(void)
+{
+	static const uint16_t lengths[] = { 2, 4, 16, 64 };
+
+	for(uint32_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+	{
+		Run("interrupt", 0, lengths[i]);
+		Run("DMA", 2, lengths[i]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * bench_mem.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <string.h>
+#include "test.h"
+
+// MEM_CopyWords and MEM_ZeroWords, the eight word blocks the startup code uses for the RAM
+// sections, against a loop of one word per pass and the C library memcpy / memset, on short
+// and long sections. Host times only: the library functions use the host's vector units, on
+// the target the block loops are what LDM/STM of eight registers gives (see stm32f407xx_mem.c).
+
+#define MAX_WORDS		4096
+#define TOTAL_WORDS		(64U * 1024U * 1024U)	// Words per measurement, the rounds follow from it
+
+static uint32_t Src[MAX_WORDS];
+static uint32_t Dst[MAX_WORDS];
+
+// Plain word loops, kept out of line and not turned into memcpy / memset calls by the compiler
+__attribute__((noinline, optimize("no-tree-loop-distribute-patterns")))
+static void CopyLoop(uint32_t *pDst, const uint32_t *pSrc, uint32_t Words)
+{
+	while(Words-- != 0)
+	{
+		*pDst++ = *pSrc++;
+	}
+}
+
+__attribute__((noinline, optimize("no-tree-loop-distribute-patterns")))
+static void ZeroLoop(uint32_t *pDst, uint32_t Words)
+{
+	while(Words-- != 0)
+	{
+		*pDst++ = 0;
+	}
+}
+
+static void LibCopy(uint32_t *pDst, const uint32_t *pSrc, uint32_t Words)
+{
+	memcpy(pDst, pSrc, Words * sizeof(uint32_t));
+}
+
+static void LibZero(uint32_t *pDst, uint32_t Words)
+{
+	memset(pDst, 0, Words * sizeof(uint32_t));
+}
+
+static double CopyNs(void (*pCopy)(uint32_t*, const uint32_t*, uint32_t), uint32_t Words)
+{
+	uint32_t rounds = TOTAL_WORDS / Words;
+	uint64_t start = TEST_NowNs();
+
+	for(uint32_t r = 0; r < rounds; r++)
+	{
+		pCopy(Dst, Src, Words);
+		__asm__ volatile("" ::: "memory");
+	}
+
+	return (double)(TEST_NowNs() - start) / ((double)rounds * Words);
+}
+
+static double ZeroNs(void (*pZero)(uint32_t*, uint32_t), uint32_t Words)
+{
+	uint32_t rounds = TOTAL_WORDS / Words;
+	uint64_t start = TEST_NowNs();
+
+	for(uint32_t r = 0; r < rounds; r++)
+	{
+		pZero(Dst, Words);
+		__asm__ volatile("" ::: "memory");
+	}
+
+	return (double)(TEST_NowNs() - start) / ((double)rounds * Words);
+}
+
+static void Run(uint32_t Words)
+{
+	double copy = CopyNs(MEM_CopyWords, Words);
+	double copyLoop = CopyNs(CopyLoop, Words);
+	double copyLib = CopyNs(LibCopy, Words);
+	double zero = ZeroNs(MEM_ZeroWords, Words);
+	double zeroLoop = ZeroNs(ZeroLoop, Words);
+	double zeroLib = ZeroNs(LibZero, Words);
+
+	printf("  %4u words: copy %5.3f ns per word, loop %5.3f, memcpy %5.3f; zero %5.3f ns per word, loop %5.3f, memset %5.3f\n",
+			(unsigned)Words, copy, copyLoop, copyLib, zero, zeroLoop, zeroLib);
+}
+
+int main(void)
+{
+	for(uint32_t i = 0; i < MAX_WORDS; i++)
+	{
+		Src[i] = i;
+	}
+
+	Run(7);
+	Run(64);
+	Run(1000);
+	Run(MAX_WORDS);
+
+	return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * bench_pbus.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "test.h"
+
+// Parallel bus bursts of WORDS words: PBUS_WriteBuffer, PBUS_Fill and PBUS_ReadBuffer on
+// 8 and 16 bit buses, the data on one port in order, with the write strobe on the same port
+// (in the tables) or another one, split over two ports, in 6800 mode, and with a strobe pulse
+// that needs hold stores. The port accesses per word are counted by the simulator, they are
+// the same on the target; the target rate is from the accesses alone at PBUS_CYCLES_PER_STORE
+// each and 168 MHz, a bound the loop overhead lowers. The time per word is host time.
+
+#define WORDS		256
+#define ROUNDS		2000
+#define CORE_HZ		168000000U
+
+static uint16_t Data[WORDS];
+static uint16_t In[WORDS];
+
+typedef struct
+{
+	const char *pName;
+	uint8_t Mode;
+	uint8_t Width;
+	GPIO_RegDef_t *pLow;				// Port of data lines 0 - 7, from pin LowPin on
+	uint8_t LowPin;
+	GPIO_RegDef_t *pHigh;				// Port of data lines 8 - 15, from pin HighPin on
+	uint8_t HighPin;
+	PBUS_Pin_t WR;
+	uint16_t WritePulseNs;
+}Bus_t;
+
+static const Bus_t Buses[] =
+{
+	{ "8080  8 bit, WR in table",   PBUS_MODE_8080,  8, GPIOD, 0, NULL,  0, { GPIOD, 8 }, 0 },
+	{ "8080  8 bit, WR apart",      PBUS_MODE_8080,  8, GPIOD, 0, NULL,  0, { GPIOB, 0 }, 0 },
+	{ "8080 16 bit, one port",      PBUS_MODE_8080, 16, GPIOE, 0, GPIOE, 8, { GPIOD, 8 }, 0 },
+	{ "8080 16 bit, two ports",     PBUS_MODE_8080, 16, GPIOD, 0, GPIOE, 8, { GPIOD, 8 }, 0 },
+	{ "6800  8 bit",                PBUS_MODE_6800,  8, GPIOD, 0, NULL,  0, { GPIOD, 8 }, 0 },
+	{ "8080  8 bit, 30 ns strobe",  PBUS_MODE_8080,  8, GPIOD, 0, NULL,  0, { GPIOD, 8 }, 30 },
+};
+
+static void Setup(PBUS_Handle_t *pHandle, const Bus_t *pBus)
+{
+	*pHandle = (PBUS_Handle_t){ 0 };
+	pHandle->Config.Mode = pBus->Mode;
+	pHandle->Config.Width = pBus->Width;
+	for(uint8_t i = 0; i < pBus->Width; i++)
+	{
+		pHandle->Config.Data[i].pGPIOx = (i < 8) ? pBus->pLow : pBus->pHigh;
+		pHandle->Config.Data[i].Pin = (uint8_t)((i < 8) ? pBus->LowPin + i : pBus->HighPin + i - 8);
+	}
+	pHandle->Config.WR = pBus->WR;
+	pHandle->Config.RD = (PBUS_Pin_t){ GPIOB, 1 };
+	pHandle->Config.CS = (PBUS_Pin_t){ GPIOB, 2 };
+	pHandle->Config.DC = (PBUS_Pin_t){ GPIOB, 3 };
+	pHandle->Config.CoreClockHz = CORE_HZ;
+	pHandle->Config.WritePulseNs = pBus->WritePulseNs;
+}
+
+// Accesses per word of one burst
+static double Accesses(PBUS_Handle_t *pHandle, uint8_t Op)
+{
+	SIM_ResetCounters();
+	switch(Op)
+	{
+		case 0:		PBUS_WriteBuffer(pHandle, Data, WORDS);		break;
+		case 1:		PBUS_Fill(pHandle, 0xA55A, WORDS);			break;
+		default:	PBUS_ReadBuffer(pHandle, In, WORDS);		break;
+	}
+
+	return (double)SIM_GetTotalAccesses() / WORDS;
+}
+
+static double NsPerWord(PBUS_Handle_t *pHandle, uint8_t Op)
+{
+	uint64_t start = TEST_NowNs();
+
+	for(uint32_t r = 0; r < ROUNDS; r++)
+	{
+		switch(Op)
+		{
+			case 0:		PBUS_WriteBuffer(pHandle, Data, WORDS);		break;
+			case 1:		PBUS_Fill(pHandle, 0xA55A, WORDS);			break;
+			default:	PBUS_ReadBuffer(pHandle, In, WORDS);		break;
+		}
+	}
+
+	return (double)(TEST_NowNs() - start) / ((double)ROUNDS * WORDS);
+}
+
+static void Run(const Bus_t *pBus)
+{
+	static const char *ops[3] = { "write", "fill ", "read " };
+	PBUS_Handle_t handle;
+
+	Setup(&handle, pBus);
+	if(PBUS_Init(&handle) != PBUS_OK)
+	{
+		printf("  %-26s PBUS_Init failed\n", pBus->pName);
+		return;
+	}
+
+	for(uint8_t op = 0; op < 3; op++)
+	{
+		double accesses = Accesses(&handle, op);
+		double mbs = (double)CORE_HZ / (accesses * PBUS_CYCLES_PER_STORE) * (pBus->Width / 8) / 1e6;
+
+		printf("  %-26s %s %5.2f accesses per word, <= %5.1f MB/s on the target, %6.2f ns per word\n",
+				(op == 0) ? pBus->pName : "", ops[op], accesses, mbs, NsPerWord(&handle, op));
+	}
+}
+
+int main(void)
+{
+	SIM_Reset();
+	GPIO_PeriClockEnable(GPIOB);
+	GPIO_PeriClockEnable(GPIOD);
+	GPIO_PeriClockEnable(GPIOE);
+	for(uint32_t i = 0; i < WORDS; i++)
+	{
+		Data[i] = (uint16_t)(i * 0x0101U + 0x1234U);
+	}
+
+	for(uint32_t i = 0; i < sizeof(Buses) / sizeof(Buses[0]); i++)
+	{
+		Run(&Buses[i]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,273 @@
+/*
+ * bench_ring.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include "test.h"
+#include "stm32f407xx_ring.h"
+
+// Ring throughput in host time. On one thread: a push and a pop per element, and spans of 32
+// filled and read in place. Between threads: one producer for the SPSC ring, 1, 2 and 4 for
+// the MPSC ring, against a ring with a mutex (what masking the interrupts would be on the
+// target). A thread that finds the ring full or empty yields.
+
+#define ITEMS			2000000U
+#define SPAN			32
+#define MAX_PRODUCERS	4
+
+RING_SPSC_DEFINE(Spsc, uint32_t, 256);
+RING_MPSC_DEFINE(Mpsc, uint32_t, 256);
+
+// Ring with a lock, for comparison
+typedef struct
+{
+	pthread_mutex_t Lock;
+	uint32_t Head;
+	uint32_t Tail;
+	uint32_t Slots[256];
+}Locked_t;
+
+static Locked_t Locked = { .Lock = PTHREAD_MUTEX_INITIALIZER };
+static uint32_t PerProducer;
+static volatile uint32_t Sink;
+
+static uint8_t LockedPush(uint32_t Value)
+{
+	uint8_t ok = 0;
+
+	pthread_mutex_lock(&Locked.Lock);
+	if(Locked.Head - Locked.Tail < 256)
+	{
+		Locked.Slots[Locked.Head++ & 255] = Value;
+		ok = 1;
+	}
+	pthread_mutex_unlock(&Locked.Lock);
+
+	return ok;
+}
+
+static uint8_t LockedPop(uint32_t *pValue)
+{
+	uint8_t ok = 0;
+
+	pthread_mutex_lock(&Locked.Lock);
+	if(Locked.Head != Locked.Tail)
+	{
+		*pValue = Locked.Slots[Locked.Tail++ & 255];
+		ok = 1;
+	}
+	pthread_mutex_unlock(&Locked.Lock);
+
+	return ok;
+}
+
+static double NsPerItem(uint64_t Start, uint32_t Items)
+{
+	return (double)(TEST_NowNs() - Start) / Items;
+}
+
+static void SingleThread(void)
+{
+	uint32_t value = 0, sum = 0;
+	uint64_t start;
+
+	start = TEST_NowNs();
+	for(uint32_t i = 0; i < ITEMS; i++)
+	{
+		(void)RING_SPSC_Push(&Spsc, &i);
+		(void)RING_SPSC_Pop(&Spsc, &value);
+		sum += value;
+	}
+	printf("  1 thread,  SPSC push/pop       %6.2f ns per item\n", NsPerItem(start, ITEMS));
+
+	start = TEST_NowNs();
+	for(uint32_t i = 0; i < ITEMS; i += SPAN)
+	{
+		void *pSpan;
+		uint32_t n = RING_SPSC_WriteSpan(&Spsc, &pSpan);
+
+		n = (n < SPAN) ? n : SPAN;
+		for(uint32_t j = 0; j < n; j++)
+		{
+			((uint32_t*)pSpan)[j] = i + j;
+		}
+		RING_SPSC_Commit(&Spsc, n);
+		n = RING_SPSC_ReadSpan(&Spsc, &pSpan);
+		for(uint32_t j = 0; j < n; j++)
+		{
+			sum += ((uint32_t*)pSpan)[j];
+		}
+		RING_SPSC_Release(&Spsc, n);
+	}
+	printf("  1 thread,  SPSC spans of %2u    %6.2f ns per item\n", SPAN, NsPerItem(start, ITEMS));
+
+	RING_MPSC_Init(&Mpsc);
+	start = TEST_NowNs();
+	for(uint32_t i = 0; i < ITEMS; i++)
+	{
+		(void)RING_MPSC_Push(&Mpsc, &i);
+		(void)RING_MPSC_Pop(&Mpsc, &value);
+		sum += value;
+	}
+	printf("  1 thread,  MPSC push/pop       %6.2f ns per item\n", NsPerItem(start, ITEMS));
+
+	start = TEST_NowNs();
+	for(uint32_t i = 0; i < ITEMS; i++)
+	{
+		(void)LockedPush(i);
+		(void)LockedPop(&value);
+		sum += value;
+	}
+	printf("  1 thread,  mutex push/pop      %6.2f ns per item\n", NsPerItem(start, ITEMS));
+
+	Sink = sum;
+}
+
+static void *SPSCProducer(void *pArg)
+{
+	(void)pArg;
+	for(uint32_t i = 0; i < ITEMS; )
+	{
+		if(RING_SPSC_Push(&Spsc, &i))
+		{
+			i++;
+		}
+		else
+		{
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+static void *MPSCProducer(void *pArg)
+{
+	(void)pArg;
+	for(uint32_t i = 0; i < PerProducer; )
+	{
+		if(RING_MPSC_Push(&Mpsc, &i))
+		{
+			i++;
+		}
+		else
+		{
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+static void *LockedProducer(void *pArg)
+{
+	(void)pArg;
+	for(uint32_t i = 0; i < PerProducer; )
+	{
+		if(LockedPush(i))
+		{
+			i++;
+		}
+		else
+		{
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+static void Threads(void)
+{
+	static const uint32_t counts[] = { 1, 2, MAX_PRODUCERS };
+	pthread_t threads[MAX_PRODUCERS];
+	uint32_t value, sum = 0;
+	uint64_t start;
+
+	start = TEST_NowNs();
+	pthread_create(&threads[0], NULL, SPSCProducer, NULL);
+	for(uint32_t received = 0; received < ITEMS; )
+	{
+		void *pSpan;
+		uint32_t n = RING_SPSC_ReadSpan(&Spsc, &pSpan);
+
+		if(n == 0)
+		{
+			sched_yield();
+			continue;
+		}
+		sum += ((uint32_t*)pSpan)[n - 1];
+		RING_SPSC_Release(&Spsc, n);
+		received += n;
+	}
+	pthread_join(threads[0], NULL);
+	printf("  1 producer,  SPSC              %6.2f ns per item\n", NsPerItem(start, ITEMS));
+
+	for(uint32_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+	{
+		uint32_t producers = counts[c];
+
+		PerProducer = ITEMS / producers;
+		RING_MPSC_Init(&Mpsc);
+		start = TEST_NowNs();
+		for(uint32_t i = 0; i < producers; i++)
+		{
+			pthread_create(&threads[i], NULL, MPSCProducer, NULL);
+		}
+		for(uint32_t received = 0; received < PerProducer * producers; )
+		{
+			void *pSpan;
+			uint32_t n = RING_MPSC_ReadSpan(&Mpsc, &pSpan);
+
+			if(n == 0)
+			{
+				sched_yield();
+				continue;
+			}
+			sum += ((uint32_t*)pSpan)[n - 1];
+			RING_MPSC_Release(&Mpsc, n);
+			received += n;
+		}
+		for(uint32_t i = 0; i < producers; i++)
+		{
+			pthread_join(threads[i], NULL);
+		}
+		printf("  %u producer%s MPSC              %6.2f ns per item\n", (unsigned)producers,
+				(producers == 1) ? ", " : "s,", NsPerItem(start, PerProducer * producers));
+
+		start = TEST_NowNs();
+		for(uint32_t i = 0; i < producers; i++)
+		{
+			pthread_create(&threads[i], NULL, LockedProducer, NULL);
+		}
+		for(uint32_t received = 0; received < PerProducer * producers; )
+		{
+			if(LockedPop(&value))
+			{
+				sum += value;
+				received++;
+			}
+			else
+			{
+				sched_yield();
+			}
+		}
+		for(uint32_t i = 0; i < producers; i++)
+		{
+			pthread_join(threads[i], NULL);
+		}
+		printf("  %u producer%s mutex             %6.2f ns per item\n", (unsigned)producers,
+				(producers == 1) ? ", " : "s,", NsPerItem(start, PerProducer * producers));
+	}
+
+	Sink = sum;
+}
+
+int main(void)
+{
+	SingleThread();
+	Threads();
+
+	return 0;
+}
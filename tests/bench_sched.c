@@ -0,0 +1,170 @@
+/*
+ * bench_sched.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <stdlib.h>
+#include "test.h"
+#include "stm32f407xx_sched.h"
+
+// Scheduler throughput and latency in host time.
+//
+// Throughput: events posted in bursts and dispatched with SCHED_RunOnce, to one task and
+// spread over 8 tasks of different priorities.
+//
+// Latency: a simulated interrupt source fires every PERIOD_NS (with jitter) and posts to the
+// highest priority task, the event carries the time the interrupt fired. The source is looked
+// at between two handlers, as an interrupt during a handler only posts and its event waits for
+// the handler to end. Measured from the interrupt to the start of its handler: on an idle
+// system, and with lower priority tasks that always have work, each run taking BUSY_NS.
+
+#define BURST			64
+#define BURSTS			20000
+#define EVENTS			20000
+#define PERIOD_NS		10000U
+#define BUSY_NS			1000U
+#define LOW_TASKS		4
+
+static uint64_t NextFire;
+static uint32_t Fired;
+static uint64_t Latency[EVENTS];
+static uint32_t Handled;
+static volatile uint32_t Sink;
+
+static void Count(SCHED_Task_t *pTask, const SCHED_Event_t *pEvent)
+{
+	(void)pTask;
+	Sink += (uint32_t)pEvent->Param;
+}
+
+static void Measure(SCHED_Task_t *pTask, const SCHED_Event_t *pEvent)
+{
+	(void)pTask;
+	if(Handled < EVENTS)
+	{
+		Latency[Handled++] = TEST_NowNs() - (uint64_t)pEvent->Param;
+	}
+}
+
+// Lower priority work: takes BUSY_NS and posts itself again
+static void Busy(SCHED_Task_t *pTask, const SCHED_Event_t *pEvent)
+{
+	uint64_t end = TEST_NowNs() + BUSY_NS;
+
+	(void)pEvent;
+	while(TEST_NowNs() < end);
+	(void)SCHED_Post(pTask, SCHED_SIG_USER, 0);
+}
+
+SCHED_TASK_DEFINE(CountTask0, Count, NULL, BURST);
+SCHED_TASK_DEFINE(CountTask1, Count, NULL, BURST);
+SCHED_TASK_DEFINE(CountTask2, Count, NULL, BURST);
+SCHED_TASK_DEFINE(CountTask3, Count, NULL, BURST);
+SCHED_TASK_DEFINE(CountTask4, Count, NULL, BURST);
+SCHED_TASK_DEFINE(CountTask5, Count, NULL, BURST);
+SCHED_TASK_DEFINE(CountTask6, Count, NULL, BURST);
+SCHED_TASK_DEFINE(CountTask7, Count, NULL, BURST);
+SCHED_TASK_DEFINE(IrqTask, Measure, NULL, 8);
+SCHED_TASK_DEFINE(BusyTask0, Busy, NULL, 2);
+SCHED_TASK_DEFINE(BusyTask1, Busy, NULL, 2);
+SCHED_TASK_DEFINE(BusyTask2, Busy, NULL, 2);
+SCHED_TASK_DEFINE(BusyTask3, Busy, NULL, 2);
+
+static SCHED_Task_t *CountTasks[] = { &CountTask0, &CountTask1, &CountTask2, &CountTask3,
+		&CountTask4, &CountTask5, &CountTask6, &CountTask7 };
+static SCHED_Task_t *BusyTasks[LOW_TASKS] = { &BusyTask0, &BusyTask1, &BusyTask2, &BusyTask3 };
+
+static void Throughput(uint32_t Tasks)
+{
+	uint64_t start;
+
+	SCHED_Init(31);
+	for(uint32_t i = 0; i < Tasks; i++)
+	{
+		(void)SCHED_TaskStart(CountTasks[i], (uint8_t)(2 * i + 1));
+	}
+
+	start = TEST_NowNs();
+	for(uint32_t b = 0; b < BURSTS; b++)
+	{
+		for(uint32_t i = 0; i < BURST; i++)
+		{
+			(void)SCHED_Post(CountTasks[i % Tasks], SCHED_SIG_USER, i);
+		}
+		while(SCHED_RunOnce());
+	}
+
+	printf("  throughput, %u task%s  %6.1f ns per event (post and dispatch)\n", (unsigned)Tasks,
+			(Tasks == 1) ? ": " : "s:", (double)(TEST_NowNs() - start) / ((double)BURSTS * BURST));
+}
+
+// The interrupt source, called between handlers and while idle
+static void PollSource(void)
+{
+	uint64_t now = TEST_NowNs();
+
+	if( (Fired < EVENTS) && (now >= NextFire) )
+	{
+		(void)SCHED_Post(&IrqTask, SCHED_SIG_USER, (uintptr_t)NextFire);
+		Fired++;
+
+		// After a host stall the next one is a period from now, not a burst of late ones
+		NextFire = ((NextFire + PERIOD_NS > now) ? NextFire : now) + PERIOD_NS / 2 + (uint64_t)(rand() % PERIOD_NS);
+	}
+}
+
+static int CompareU64(const void *pA, const void *pB)
+{
+	uint64_t a = *(const uint64_t*)pA, b = *(const uint64_t*)pB;
+
+	return (a > b) - (a < b);
+}
+
+static void LatencyRun(uint32_t LowTasks)
+{
+	uint64_t total = 0;
+
+	SCHED_Init(31);
+	(void)SCHED_TaskStart(&IrqTask, 0);
+	for(uint32_t i = 0; i < LowTasks; i++)
+	{
+		(void)SCHED_TaskStart(BusyTasks[i], (uint8_t)(10 + i));
+		(void)SCHED_Post(BusyTasks[i], SCHED_SIG_USER, 0);
+	}
+
+	srand(5);
+	Fired = 0;
+	Handled = 0;
+	NextFire = TEST_NowNs() + PERIOD_NS;
+	while(Handled < EVENTS)
+	{
+		PollSource();
+		(void)SCHED_RunOnce();
+	}
+
+	for(uint32_t i = 0; i < EVENTS; i++)
+	{
+		total += Latency[i];
+	}
+	qsort(Latency, EVENTS, sizeof(Latency[0]), CompareU64);
+	printf("  latency, %u busy task%s mean %7.1f ns, median %6u ns, 99%% %6u ns, max %7u ns,"
+			" queue high water %u\n", (unsigned)LowTasks, (LowTasks == 1) ? ": " : "s:",
+			(double)total / EVENTS, (unsigned)Latency[EVENTS / 2], (unsigned)Latency[EVENTS * 99 / 100],
+			(unsigned)Latency[EVENTS - 1], (unsigned)IrqTask.QueueHighWater);
+}
+
+int main(void)
+{
+	SIM_Reset();
+
+	Throughput(1);
+	Throughput(8);
+
+	LatencyRun(0);
+	LatencyRun(1);
+	LatencyRun(LOW_TASKS);
+
+	return 0;
+}
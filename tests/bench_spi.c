@@ -0,0 +1,98 @@
+/*
+ * bench_spi.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <string.h>
+#include "test.h"
+
+// One transfer of 1, 16 and 256 bytes, blocking (SPI_TransferBlocking), queued in
+// interrupt mode (one SPI1_IRQHandler per frame) and queued in DMA mode (start, then the
+// end of the RX stream). The bus accesses of the CPU are counted by the simulator, they are
+// the same on the target; in DMA mode they do not grow with the length. The time per
+// transfer is host time.
+
+#define ROUNDS		2000
+
+static uint8_t Tx[256], Rx[256];
+static SPI_Handle_t Handle;
+
+static void Blocking(uint32_t Len)
+{
+	SPI_TransferBlocking(SPI1, Tx, Rx, Len);
+}
+
+static void QueueIT(uint32_t Len)
+{
+	SPI_Transaction_t txn = { .pTxBuffer = Tx, .pRxBuffer = Rx, .Len = Len };
+
+	(void)SPI_Submit(&Handle, &txn);
+	while(!SPI_IsIdle(&Handle))
+	{
+		SPI1_IRQHandler();
+	}
+}
+
+// The DMA moves the data, the CPU only starts and ends the transaction
+static void QueueDMA(uint32_t Len)
+{
+	SPI_Transaction_t txn = { .pTxBuffer = Tx, .pRxBuffer = Rx, .Len = Len };
+
+	(void)SPI_Submit(&Handle, &txn);
+	SIM_DMAComplete(DMA2, Handle.TxStream);
+	SIM_DMAComplete(DMA2, Handle.RxStream);
+	DMA2_Stream0_IRQHandler();
+}
+
+static void Run(const char *pName, void (*pXfer)(uint32_t Len), uint8_t XferMode, uint32_t Len)
+{
+	uint64_t start;
+	uint32_t accesses;
+
+	SIM_Reset();
+	memset(&Handle, 0, sizeof(Handle));
+	Handle.pSPIx = SPI1;
+	Handle.SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+	Handle.SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+	Handle.SPIConfig.SPI_SclkSpeed = SPI_SCLK_SPEED_DIV4;
+	Handle.SPIConfig.SPI_SSM = SPI_SSM_EN;
+	Handle.XferMode = XferMode;
+	(void)SPI_Init(&Handle);
+
+	SIM_ResetCounters();
+	pXfer(Len);
+	accesses = SIM_GetTotalAccesses();
+
+	start = TEST_NowNs();
+	for(uint32_t i = 0; i < ROUNDS; i++)
+	{
+		pXfer(Len);
+	}
+
+	printf("  %-22s %3u bytes: %5u accesses (%6.2f per byte), %9.1f ns per transfer\n", pName,
+			(unsigned)Len, (unsigned)accesses, (double)accesses / Len,
+			(double)(TEST_NowNs() - start) / ROUNDS);
+
+	SPI_DeInit(SPI1);
+}
+
+int main(void)
+{
+	static const uint32_t lengths[] = { 1, 16, 256 };
+
+	for(uint32_t i = 0; i < sizeof(Tx); i++)
+	{
+		Tx[i] = (uint8_t)(i * 13);
+	}
+
+	for(uint32_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+	{
+		Run("SPI_TransferBlocking", Blocking, SPI_XFER_IT, lengths[i]);
+		Run("SPI_Submit, interrupt", QueueIT, SPI_XFER_IT, lengths[i]);
+		Run("SPI_Submit, DMA", QueueDMA, SPI_XFER_DMA, lengths[i]);
+	}
+
+	return 0;
+}
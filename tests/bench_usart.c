@@ -0,0 +1,132 @@
+/*
+ * bench_usart.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <string.h>
+#include "test.h"
+
+// Receive of frames of 1, 16 and 256 bytes: the DMA ring handing the data over in place
+// (USART_RxRingUpdate at the IDLE interrupt) against one interrupt per byte copying DR into a
+// software FIFO, as with RXNEIE. The bus accesses of the CPU per frame are counted by the
+// simulator through the interrupt handlers, the time is host time for the ring logic and the
+// per byte FIFO alone.
+
+#define RING_SIZE		512
+#define ROUNDS			2000
+
+static uint8_t Ring[RING_SIZE];
+static uint8_t Fifo[RING_SIZE];
+static uint32_t FifoHead;
+static volatile uint32_t Sink;
+
+static void Consume(const uint8_t *pData, uint16_t Len, uint8_t Flags, void *pArg)
+{
+	(void)Flags;
+	(void)pArg;
+	Sink += (Len != 0) ? pData[Len - 1] : 0;
+}
+
+// RXNE interrupt of a byte by byte receiver
+static void ByteIRQ(USART_RegDef_t *pUSARTx)
+{
+	if(REG_READ(pUSARTx->SR) & (1U << USART_SR_RXNE))
+	{
+		Fifo[FifoHead] = (uint8_t)REG_READ(pUSARTx->DR);
+		FifoHead = (FifoHead + 1) % RING_SIZE;
+	}
+}
+
+// CPU bus accesses of one frame through the driver: the IDLE interrupt and the DMA interrupts
+static uint32_t RingAccesses(uint32_t Len)
+{
+	USART_Handle_t handle = { .pUSARTx = USART2, .USARTConfig.USART_Mode = USART_MODE_ONLY_RX,
+			.USARTConfig.USART_Baud = 115200 };
+	uint32_t accesses;
+	uint8_t flags;
+
+	SIM_Reset();
+	(void)USART_Init(&handle);
+	(void)USART_RxStart(&handle, Ring, RING_SIZE, Consume, NULL);
+
+	// The DMA writes the frame, the half transfer interrupt runs if the frame got to it
+	SIM_DMAAdvance(DMA1, 5, Len);
+	flags = DMA_GetFlags(DMA1, 5);
+	REG_SET_BITS(USART2->SR, (1U << USART_SR_IDLE));
+	SIM_ResetCounters();
+	if(flags != 0)
+	{
+		DMA1_Stream5_IRQHandler();
+	}
+	USART2_IRQHandler();
+	accesses = SIM_GetTotalAccesses();
+
+	USART_RxStop(&handle);
+	USART_DeInit(USART2);
+
+	return accesses;
+}
+
+static uint32_t ByteAccesses(uint32_t Len)
+{
+	SIM_Reset();
+	REG_SET_BITS(USART2->SR, (1U << USART_SR_RXNE));
+	SIM_ResetCounters();
+	for(uint32_t i = 0; i < Len; i++)
+	{
+		ByteIRQ(USART2);
+	}
+
+	return SIM_GetTotalAccesses();
+}
+
+static double RingTime(uint32_t Len)
+{
+	USART_RxRing_t ring = { .pBuffer = Ring, .Size = RING_SIZE, .pCallback = Consume };
+	uint32_t head = 0;
+	uint64_t start = TEST_NowNs();
+
+	for(uint32_t r = 0; r < ROUNDS; r++)
+	{
+		head = (head + Len) % RING_SIZE;
+		USART_RxRingUpdate(&ring, (uint16_t)head, USART_RX_FRAME_END);
+	}
+
+	return (double)(TEST_NowNs() - start) / ROUNDS;
+}
+
+static double ByteTime(uint32_t Len)
+{
+	uint64_t start;
+
+	SIM_Reset();
+	REG_SET_BITS(USART2->SR, (1U << USART_SR_RXNE));
+	start = TEST_NowNs();
+	for(uint32_t r = 0; r < ROUNDS; r++)
+	{
+		for(uint32_t i = 0; i < Len; i++)
+		{
+			ByteIRQ(USART2);
+		}
+	}
+
+	return (double)(TEST_NowNs() - start) / ROUNDS;
+}
+
+int main(void)
+{
+	static const uint32_t lengths[] = { 1, 16, 256 };
+
+	for(uint32_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+	{
+		uint32_t len = lengths[i];
+
+		printf("  %3u byte frame: interrupt per byte %5u accesses %9.1f ns, DMA ring %3u accesses %6.1f ns\n",
+				(unsigned)len, (unsigned)ByteAccesses(len), ByteTime(len),
+				(unsigned)RingAccesses(len), RingTime(len));
+	}
+
+	return 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * test.h
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#ifndef TESTS_TEST_H_
+#define TESTS_TEST_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "stm32f407xx.h"
+#include "stm32f407xx_sim.h"
+
+// Checks of the host tests. A failed check prints where it is and the test goes on, the
+// program exits with 1 at TEST_EXIT when any check failed.
+
+static unsigned TestChecks __attribute__((unused));
+static unsigned TestFailures __attribute__((unused));
+
+#define TEST_CHECK(Cond)															\
+	do {																			\
+		TestChecks++;																\
+		if(!(Cond))																	\
+		{																			\
+			TestFailures++;															\
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #Cond);			\
+		}																			\
+	} while(0)
+
+#define TEST_CHECK_EQ(Actual, Expected)												\
+	do {																			\
+		long long actual_ = (long long)(Actual);									\
+		long long expected_ = (long long)(Expected);								\
+		TestChecks++;																\
+		if(actual_ != expected_)													\
+		{																			\
+			TestFailures++;															\
+			printf("%s:%d: %s is %lld (0x%llx), expected %lld (0x%llx)\n", __FILE__,	\
+					__LINE__, #Actual, actual_, (unsigned long long)actual_,		\
+					expected_, (unsigned long long)expected_);						\
+		}																			\
+	} while(0)
+
+// Runs one test case on a freshly reset simulator
+#define TEST_RUN(Fn)																\
+	do {																			\
+		printf("  %s\n", #Fn);														\
+		SIM_Reset();																\
+		Fn();																		\
+	} while(0)
+
+#define TEST_EXIT()																	\
+	do {																			\
+		printf("%u checks, %u failed\n", TestChecks, TestFailures);					\
+		return (TestFailures != 0) ? 1 : 0;											\
+	} while(0)
+
+// Host wall clock for the benchmarks, in ns
+static inline uint64_t TEST_NowNs(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((uint64_t)now.tv_sec * 1000000000U) + (uint64_t)now.tv_nsec;
+}
+
+#endif /* TESTS_TEST_H_ */
@@ -0,0 +1,287 @@
+/*
+ * test_adc.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+
+// ADC_ProcessFrame on both paths: the SIMD path (on the host with the C versions of the DSP
+// instructions) has to give the scalar one bit for bit, and the scalar one a model written
+// straight from the filter definitions. 1 to 8 channels of every filter type, with offsets
+// that saturate, the longest FIR and biquad coefficients at the ends of their range, frames
+// of 1, 5 and 128 scans, and inputs outside the 12 bits now and then. Then the frames of a
+// running scan in the DMA double buffer of the simulator, and ADC_Stop, which may not leave
+// the transfer complete of the stopped stream to the handler.
+
+#define MAX_SAMPLES		4096
+#define MODEL_HISTORY	ADC_FIR_MAX_TAPS
+
+typedef struct
+{
+	uint8_t ChannelCount;
+	uint32_t Count;
+	int16_t Out[ADC_MAX_CHANNELS][MAX_SAMPLES];
+}Record_t;
+
+static const uint8_t Channels[ADC_MAX_CHANNELS] = { 0, 1, 2, 3, 10, 11, 8, 16 };
+
+static ADC_Handle_t Simd, Scalar;
+static Record_t SimdOut, ScalarOut;
+static uint16_t SimdBuffer[2 * ADC_MAX_FRAME_SCANS * ADC_MAX_CHANNELS];
+static uint16_t ScalarBuffer[2 * ADC_MAX_FRAME_SCANS * ADC_MAX_CHANNELS];
+static uint16_t Frame[ADC_MAX_FRAME_SCANS * ADC_MAX_CHANNELS];
+static uint16_t In[ADC_MAX_CHANNELS][MAX_SAMPLES];
+static int32_t X[MODEL_HISTORY + MAX_SAMPLES];
+static int16_t Model[MAX_SAMPLES];
+
+static void Received(void *pArg, const int16_t * const *ppChannels, uint32_t Count)
+{
+	Record_t *pRecord = (Record_t*)pArg;
+
+	for(uint8_t c = 0; c < pRecord->ChannelCount; c++)
+	{
+		memcpy(&pRecord->Out[c][pRecord->Count], ppChannels[c], Count * sizeof(int16_t));
+	}
+	pRecord->Count += Count;
+}
+
+static int32_t Sat16(int32_t Value)
+{
+	return (Value > 32767) ? 32767 : (Value < -32768) ? -32768 : Value;
+}
+
+// Channel c gets filter type c % 4, channel 4 a 31 tap FIR and channel 6 one of 32 taps,
+// channel 7 a biquad with coefficients at the ends of the Q14 range
+static void Setup(ADC_Handle_t *pHandle, Record_t *pRecord, uint8_t Path, uint8_t ChannelCount, uint16_t FrameScans, uint32_t Seed)
+{
+	*pHandle = (ADC_Handle_t){ 0 };
+	pHandle->Config.pADCx = ADC1;
+	pHandle->Config.pChannels = Channels;
+	pHandle->Config.ChannelCount = ChannelCount;
+	pHandle->Config.SampleTime = ADC_SMP_15;
+	pHandle->Config.Path = Path;
+	pHandle->Config.IRQPriority = 5;
+	pHandle->Config.pTIMx = TIM2;
+	pHandle->Config.TimerClockHz = 16000000U;
+	pHandle->Config.ScanRateHz = 1000U;
+	pHandle->Config.pBuffer = (Path == ADC_PATH_SIMD) ? SimdBuffer : ScalarBuffer;
+	pHandle->Config.FrameScans = FrameScans;
+	pHandle->Config.pCallback = Received;
+	pHandle->Config.pArg = pRecord;
+	*pRecord = (Record_t){ .ChannelCount = ChannelCount };
+
+	srand(Seed);
+	for(uint8_t c = 0; c < ChannelCount; c++)
+	{
+		ADC_Filter_t *pFilter = &pHandle->Filter[c];
+
+		pHandle->Config.Offset[c] = (c & 1U) ? -2048 : (c == 2) ? 32000 : 0;
+		pFilter->Type = (c == 4) ? ADC_FILTER_FIR : (c % 4);
+		if(pFilter->Type == ADC_FILTER_MOVAVG)
+		{
+			pFilter->Length = (c == 5) ? 0 : 3 + (c & 1U);
+		}
+		else if(pFilter->Type == ADC_FILTER_FIR)
+		{
+			pFilter->Length = (c == 4) ? 31 : (c == 6) ? ADC_FIR_MAX_TAPS : 7;
+			for(uint8_t k = 0; k < pFilter->Length; k++)
+			{
+				pFilter->Coeffs[k] = (int16_t)((rand() % 4001) - 2000);
+			}
+		}
+		else if(pFilter->Type == ADC_FILTER_BIQUAD)
+		{
+			static const int16_t lowPass[5] = { 4000, 8000, 4000, -20000, 7000 };
+			static const int16_t extremes[5] = { 30000, -32768, 32767, 32767, -32768 };
+
+			memcpy(pFilter->Coeffs, (c == 7) ? extremes : lowPass, sizeof(lowPass));
+		}
+	}
+}
+
+// Output of the filter of channel c of the scalar handle on the Total inputs in In[c]
+static void RunModel(uint8_t c, uint32_t Total)
+{
+	const ADC_Filter_t *pFilter = &Scalar.Filter[c];
+	int32_t y1 = 0, y2 = 0;
+
+	memset(X, 0, sizeof(X));
+	for(uint32_t n = 0; n < Total; n++)
+	{
+		X[MODEL_HISTORY + n] = Sat16((int16_t)In[c][n] + Scalar.Config.Offset[c]);
+	}
+
+	for(uint32_t n = 0; n < Total; n++)
+	{
+		const int32_t *pX = &X[MODEL_HISTORY + n];
+		uint32_t acc = 0;
+		int32_t y;
+
+		switch(pFilter->Type)
+		{
+		case ADC_FILTER_NONE:
+			y = pX[0];
+			break;
+		case ADC_FILTER_MOVAVG:
+			for(int32_t k = 0; k < (1 << pFilter->Length); k++)
+			{
+				acc += (uint32_t)pX[-k];
+			}
+			y = (int32_t)acc >> pFilter->Length;
+			break;
+		case ADC_FILTER_FIR:
+			for(int32_t k = 0; k < pFilter->Length; k++)
+			{
+				acc += (uint32_t)(pFilter->Coeffs[k] * pX[-k]);
+			}
+			y = Sat16((int32_t)acc >> 15);
+			break;
+		default:
+			acc = (uint32_t)(pFilter->Coeffs[0] * pX[0]) + (uint32_t)(pFilter->Coeffs[1] * pX[-1]) +
+				  (uint32_t)(pFilter->Coeffs[2] * pX[-2]) - (uint32_t)(pFilter->Coeffs[3] * y1) -
+				  (uint32_t)(pFilter->Coeffs[4] * y2);
+			y = Sat16((int32_t)acc >> 14);
+			y2 = y1;
+			y1 = y;
+			break;
+		}
+		Model[n] = (int16_t)y;
+	}
+}
+
+static void test_SimdMatchesScalar(void)
+{
+	static const uint16_t frameScans[3] = { 1, 5, ADC_MAX_FRAME_SCANS };
+	static const uint32_t frames[3] = { 200, 60, 20 };
+	uint32_t failures = 0, modelFailures = 0;
+
+	for(uint8_t channels = 1; channels <= ADC_MAX_CHANNELS; channels++)
+	{
+		for(uint8_t f = 0; f < 3; f++)
+		{
+			uint16_t scans = frameScans[f];
+			uint32_t total = 0;
+
+			Setup(&Simd, &SimdOut, ADC_PATH_SIMD, channels, scans, 10U * channels + f);
+			Setup(&Scalar, &ScalarOut, ADC_PATH_SCALAR, channels, scans, 10U * channels + f);
+			TEST_CHECK_EQ(ADC_Init(&Simd), ADC_OK);
+			TEST_CHECK_EQ(ADC_Init(&Scalar), ADC_OK);
+
+			srand(99U + channels);
+			for(uint32_t n = 0; n < frames[f]; n++)
+			{
+				for(uint32_t s = 0; s < scans; s++)
+				{
+					for(uint8_t c = 0; c < channels; c++)
+					{
+						uint16_t sample = (uint16_t)((n % 7 == 3) ? (rand() & 0xFFFF) : (rand() & 0xFFF));
+
+						Frame[s * channels + c] = sample;
+						In[c][total + s] = sample;
+					}
+				}
+				total += scans;
+				ADC_ProcessFrame(&Simd, Frame);
+				ADC_ProcessFrame(&Scalar, Frame);
+			}
+			TEST_CHECK_EQ(SimdOut.Count, total);
+			TEST_CHECK_EQ(ScalarOut.Count, total);
+
+			for(uint8_t c = 0; c < channels; c++)
+			{
+				if(memcmp(SimdOut.Out[c], ScalarOut.Out[c], total * sizeof(int16_t)) != 0)
+				{
+					printf("  %u channels, %u scans: channel %u (filter %u) differs\n", (unsigned)channels,
+							(unsigned)scans, (unsigned)c, (unsigned)Scalar.Filter[c].Type);
+					failures++;
+				}
+				RunModel(c, total);
+				modelFailures += (memcmp(Model, ScalarOut.Out[c], total * sizeof(int16_t)) != 0);
+			}
+			ADC_DeInit(&Simd);
+			ADC_DeInit(&Scalar);
+		}
+	}
+	TEST_CHECK_EQ(failures, 0);
+	TEST_CHECK_EQ(modelFailures, 0);
+}
+
+// Frames of a running scan, the DMA interrupt served after each buffer or not
+static void test_Frames(void)
+{
+	uint8_t stream;
+
+	Setup(&Simd, &SimdOut, ADC_PATH_SIMD, 4, 16, 1);
+	TEST_CHECK_EQ(ADC_Init(&Simd), ADC_OK);
+	stream = Simd.Stream;
+	ADC_Start(&Simd);
+	TEST_CHECK(DMA2->S[stream].CR & DMA_SxCR_TCIE);
+
+	for(uint32_t n = 0; n < 6; n++)
+	{
+		SIM_DMAComplete(DMA2, stream);
+		DMA_IRQHandling(DMA2, stream);
+	}
+	TEST_CHECK_EQ(Simd.Frames, 6);
+	TEST_CHECK_EQ(Simd.Overruns, 0);
+	TEST_CHECK_EQ(SimdOut.Count, 6 * 16);
+
+	// Two buffers with one interrupt: one frame lost
+	SIM_DMAComplete(DMA2, stream);
+	SIM_DMAComplete(DMA2, stream);
+	DMA_IRQHandling(DMA2, stream);
+	TEST_CHECK_EQ(Simd.Frames, 7);
+	TEST_CHECK_EQ(Simd.Overruns, 1);
+
+	ADC_DeInit(&Simd);
+}
+
+// The stopped stream sets its transfer complete flag, the interrupt of it must not process
+// the last frame again or count an overrun
+static void test_Stop(void)
+{
+	uint8_t stream, irq;
+
+	Setup(&Simd, &SimdOut, ADC_PATH_SIMD, 2, 8, 2);
+	TEST_CHECK_EQ(ADC_Init(&Simd), ADC_OK);
+	stream = Simd.Stream;
+	irq = DMA_GetIRQNumber(DMA2, stream);
+	ADC_Start(&Simd);
+	for(uint32_t n = 0; n < 3; n++)
+	{
+		SIM_DMAComplete(DMA2, stream);
+		DMA_IRQHandling(DMA2, stream);
+	}
+
+	ADC_Stop(&Simd);
+	TEST_CHECK_EQ(DMA2->S[stream].CR & (DMA_SxCR_TCIE | DMA_SxCR_EN), 0);
+	TEST_CHECK_EQ((NVIC_ISER[irq / 32] >> (irq % 32)) & 1U, 0);
+	TEST_CHECK_EQ(DMA_GetFlags(DMA2, stream), 0);
+	DMA_IRQHandling(DMA2, stream);
+	TEST_CHECK_EQ(Simd.Frames, 3);
+	TEST_CHECK_EQ(Simd.Overruns, 0);
+
+	// A start unmasks it again and the frames go on from memory 0
+	ADC_Start(&Simd);
+	TEST_CHECK(DMA2->S[stream].CR & DMA_SxCR_TCIE);
+	TEST_CHECK_EQ((NVIC_ISER[irq / 32] >> (irq % 32)) & 1U, 1);
+	SIM_DMAComplete(DMA2, stream);
+	DMA_IRQHandling(DMA2, stream);
+	TEST_CHECK_EQ(Simd.Frames, 4);
+	TEST_CHECK_EQ(Simd.Overruns, 0);
+
+	ADC_DeInit(&Simd);
+}
+
+int main(void)
+{
+	TEST_RUN(test_SimdMatchesScalar);
+	TEST_RUN(test_Frames);
+	TEST_RUN(test_Stop);
+
+	TEST_EXIT();
+}
@@ -0,0 +1,98 @@
+/*
+ * test_bitband.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "test.h"
+
+// Bit-band alias addresses against the formula of PM0214 ch. 2.2.5, at both ends of the two
+// 1 MB regions and for bits 0 and 31, and the simulator versions of the bit macros: a set or
+// a clear changes the one bit and nothing else, of an RCC register and of a word in RAM like
+// the ready word of the scheduler.
+
+static uint32_t Alias(uint32_t AliasBase, uint32_t RegionBase, uint32_t Addr, uint32_t Bit)
+{
+	return AliasBase + (Addr - RegionBase) * 32U + Bit * 4U;
+}
+
+static void test_AliasAddresses(void)
+{
+	static const uint32_t offsets[4] = { 0, 1, 0x000FFFFCU, 0x000FFFFFU };
+	static const uint32_t bits[2] = { 0, 31 };
+
+	for(uint32_t i = 0; i < 4; i++)
+	{
+		for(uint32_t b = 0; b < 2; b++)
+		{
+			uint32_t sram = BITBAND_SRAM_BASE + offsets[i];
+			uint32_t periph = BITBAND_PERIPH_BASE + offsets[i];
+
+			TEST_CHECK_EQ(BITBAND_SRAM_ADDR(sram, bits[b]), Alias(0x22000000U, 0x20000000U, sram, bits[b]));
+			TEST_CHECK_EQ(BITBAND_PERIPH_ADDR(periph, bits[b]), Alias(0x42000000U, 0x40000000U, periph, bits[b]));
+		}
+	}
+
+	// Region ends: first bit of the first byte and last bit of the last word
+	TEST_CHECK_EQ(BITBAND_SRAM_ADDR(0x20000000U, 0), 0x22000000U);
+	TEST_CHECK_EQ(BITBAND_SRAM_ADDR(0x200FFFFCU, 31), 0x23FFFFFCU);
+	TEST_CHECK_EQ(BITBAND_PERIPH_ADDR(0x40000000U, 0), 0x42000000U);
+	TEST_CHECK_EQ(BITBAND_PERIPH_ADDR(0x400FFFFCU, 31), 0x43FFFFFCU);
+
+	// Bit 8 of a byte is bit 0 of the next one
+	TEST_CHECK_EQ(BITBAND_PERIPH_ADDR(0x40023830U, 8), BITBAND_PERIPH_ADDR(0x40023831U, 0));
+}
+
+static void test_RegisterBits(void)
+{
+	REG_WRITE(RCC->APB1ENR, 0xA5A5A5A5U);
+	REG_BB_SET(RCC->APB1ENR, 1);
+	TEST_CHECK_EQ(RCC->APB1ENR, 0xA5A5A5A7U);
+	REG_BB_CLR(RCC->APB1ENR, 31);
+	TEST_CHECK_EQ(RCC->APB1ENR, 0x25A5A5A7U);
+	REG_BB_CLR(RCC->APB1ENR, 0);
+	TEST_CHECK_EQ(RCC->APB1ENR, 0x25A5A5A6U);
+	REG_BB_SET(RCC->APB1ENR, 31);
+	TEST_CHECK_EQ(RCC->APB1ENR, 0xA5A5A5A6U);
+
+	// Setting a set bit and clearing a clear one change nothing
+	REG_BB_SET(RCC->APB1ENR, 2);
+	REG_BB_CLR(RCC->APB1ENR, 3);
+	TEST_CHECK_EQ(RCC->APB1ENR, 0xA5A5A5A6U);
+	TEST_CHECK_EQ(REG_BB_READ(RCC->APB1ENR, 31), 1);
+	TEST_CHECK_EQ(REG_BB_READ(RCC->APB1ENR, 0), 0);
+}
+
+static void test_SRAMBits(void)
+{
+	static __vo uint32_t ready;
+
+	for(uint32_t bit = 0; bit < 32; bit++)
+	{
+		ready = 0x5A5A5A5AU;
+		SRAM_BB_SET(ready, bit);
+		TEST_CHECK_EQ(ready, 0x5A5A5A5AU | (1U << bit));
+		ready = 0x5A5A5A5AU;
+		SRAM_BB_CLR(ready, bit);
+		TEST_CHECK_EQ(ready, 0x5A5A5A5AU & ~(1U << bit));
+	}
+
+	ready = 0;
+	SRAM_BB_SET(ready, 31);
+	SRAM_BB_SET(ready, 0);
+	TEST_CHECK_EQ(ready, 0x80000001U);
+	TEST_CHECK_EQ(SRAM_BB_READ(ready, 31), 1);
+	TEST_CHECK_EQ(SRAM_BB_READ(ready, 30), 0);
+	SRAM_BB_CLR(ready, 31);
+	TEST_CHECK_EQ(ready, 1);
+}
+
+int main(void)
+{
+	TEST_RUN(test_AliasAddresses);
+	TEST_RUN(test_RegisterBits);
+	TEST_RUN(test_SRAMBits);
+
+	TEST_EXIT();
+}
@@ -0,0 +1,309 @@
+/*
+ * test_capture.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <string.h>
+#include "test.h"
+
+// Capture on a host model of its DMA stream: each sample is stored where NDTR says the DMA
+// would write it and the stream is advanced by one item (SIM_DMAAdvance), the stream
+// interrupt is served or left pending as the test needs. The records read out are expanded
+// again and must give back exactly the samples after the trigger.
+
+#define HALF			16
+#define RECORDS			256
+#define MAX_SAMPLES		1024
+
+static uint16_t Samples[2 * HALF];
+static CAPTURE_Record_t Records[RECORDS];
+static uint16_t Input[MAX_SAMPLES];
+static uint16_t Decoded[MAX_SAMPLES];
+
+static void Setup(CAPTURE_Handle_t *pHandle)
+{
+	*pHandle = (CAPTURE_Handle_t){ 0 };
+	pHandle->Config.pGPIOx = GPIOE;
+	pHandle->Config.pTIMx = TIM8;
+	pHandle->Config.TimerClockHz = 168000000U;
+	pHandle->Config.SampleRateHz = 1000000U;
+	pHandle->Config.pSamples = Samples;
+	pHandle->Config.HalfLength = HALF;
+	pHandle->Config.pRecords = Records;
+	pHandle->Config.RecordCount = RECORDS;
+	pHandle->Config.IRQPriority = 4;
+}
+
+// A bus with runs of different lengths
+static void MakeInput(uint32_t Count)
+{
+	uint16_t value = 0x0100;
+
+	for(uint32_t i = 0; i < Count; i++)
+	{
+		if( (i % 7 == 0) || (i % 11 == 0) )
+		{
+			value = (uint16_t)(value * 5 + 3);
+		}
+		Input[i] = value;
+	}
+}
+
+static uint32_t IRQEnabled(uint8_t IRQNumber)
+{
+	return (NVIC_ISER[IRQNumber / 32] >> (IRQNumber % 32)) & 1U;
+}
+
+// Feeds samples through the DMA model, the interrupt runs for each flag if ServeIRQ is set
+static void Feed(CAPTURE_Handle_t *pHandle, const uint16_t *pIn, uint32_t Count, uint8_t ServeIRQ)
+{
+	for(uint32_t i = 0; i < Count; i++)
+	{
+		uint32_t pos = (2U * HALF) - DMA_GetRemaining(DMA2, pHandle->Stream);
+
+		Samples[pos] = pIn[i];
+		SIM_DMAAdvance(DMA2, pHandle->Stream, 1);
+		if(ServeIRQ)
+		{
+			DMA2_Stream1_IRQHandler();
+		}
+	}
+}
+
+// Reads all records and expands them, returns the number of samples
+static uint32_t Decode(CAPTURE_Handle_t *pHandle)
+{
+	CAPTURE_Record_t record;
+	uint32_t n = 0;
+
+	while(CAPTURE_ReadRecords(pHandle, &record, 1) == 1)
+	{
+		TEST_CHECK(record.Run >= 1);
+		for(uint32_t i = 0; (i < record.Run) && (n < MAX_SAMPLES); i++)
+		{
+			Decoded[n++] = record.Value;
+		}
+	}
+
+	return n;
+}
+
+static void CheckDecoded(CAPTURE_Handle_t *pHandle, const uint16_t *pExpected, uint32_t Count)
+{
+	uint32_t n = Decode(pHandle);
+
+	TEST_CHECK_EQ(n, Count);
+	TEST_CHECK(memcmp(Decoded, pExpected, Count * sizeof(uint16_t)) == 0);
+}
+
+static void test_Compress(void)
+{
+	CAPTURE_Handle_t handle;
+	static const uint16_t block[] = { 1, 1, 1, 2, 2, 3, 3, 3, 3 };
+
+	Setup(&handle);
+	CAPTURE_Reset(&handle);
+
+	// Runs go on over the end of a block
+	CAPTURE_Compress(&handle, block, 5);
+	CAPTURE_Compress(&handle, &block[5], 4);
+	CAPTURE_Flush(&handle);
+	TEST_CHECK_EQ(handle.Head, 3);
+	TEST_CHECK_EQ(Records[0].Value, 1);
+	TEST_CHECK_EQ(Records[0].Run, 3);
+	TEST_CHECK_EQ(Records[1].Run, 2);
+	TEST_CHECK_EQ(Records[2].Value, 3);
+	TEST_CHECK_EQ(Records[2].Run, 4);
+	TEST_CHECK_EQ(handle.SampleCount, 9);
+	CheckDecoded(&handle, block, 9);
+}
+
+static void test_LongRunIsSplit(void)
+{
+	CAPTURE_Handle_t handle;
+	static uint16_t idle[0x9000];
+
+	Setup(&handle);
+	CAPTURE_Reset(&handle);
+	memset(idle, 0, sizeof(idle));
+
+	// 5 x 0x9000 samples of one level: 0x2D000 = 2 x 0xFFFF + 0xD002
+	for(uint32_t i = 0; i < 5; i++)
+	{
+		CAPTURE_Compress(&handle, idle, 0x9000);
+	}
+	CAPTURE_Flush(&handle);
+	TEST_CHECK_EQ(handle.Head, 3);
+	TEST_CHECK_EQ(Records[0].Run, CAPTURE_RUN_MAX);
+	TEST_CHECK_EQ(Records[1].Run, CAPTURE_RUN_MAX);
+	TEST_CHECK_EQ(Records[2].Run, 0xD002);
+}
+
+static void test_Trigger(void)
+{
+	CAPTURE_Handle_t handle;
+	static const uint16_t block[] = { 0x00, 0x01, 0x10, 0x11, 0x13, 0x13, 0x02 };
+
+	Setup(&handle);
+	handle.Config.TriggerMask = 0x11;
+	handle.Config.TriggerPattern = 0x11;
+	CAPTURE_Reset(&handle);
+
+	CAPTURE_Compress(&handle, block, 2);		// No match, all dropped
+	TEST_CHECK_EQ(handle.Triggered, 0);
+	CAPTURE_Compress(&handle, &block[2], 5);
+	CAPTURE_Flush(&handle);
+	TEST_CHECK_EQ(handle.Triggered, 1);
+	TEST_CHECK_EQ(handle.TriggerSample, 3);
+	CheckDecoded(&handle, &block[3], 4);
+}
+
+static void test_RingFull(void)
+{
+	CAPTURE_Handle_t handle;
+
+	Setup(&handle);
+	handle.Config.RecordCount = 4;
+	CAPTURE_Reset(&handle);
+
+	MakeInput(200);
+	CAPTURE_Compress(&handle, Input, 200);
+	CAPTURE_Flush(&handle);
+	TEST_CHECK_EQ(handle.Head, 4);
+	TEST_CHECK(handle.RecordsDropped > 0);
+}
+
+static void test_StreamWithInterrupts(void)
+{
+	CAPTURE_Handle_t handle;
+
+	Setup(&handle);
+	TEST_CHECK_EQ(CAPTURE_Init(&handle), CAPTURE_OK);
+	TEST_CHECK_EQ(handle.Stream, 1);
+	CAPTURE_Start(&handle);
+	TEST_CHECK(DMA2->S[1].CR & DMA_SxCR_HTIE);
+	TEST_CHECK(DMA2->S[1].CR & DMA_SxCR_TCIE);
+
+	// 5.5 halves, processed from the main loop after every half
+	MakeInput(5 * HALF + HALF / 2);
+	for(uint32_t i = 0; i < 5 * HALF + HALF / 2; i += HALF / 2)
+	{
+		Feed(&handle, &Input[i], HALF / 2, 1);
+		CAPTURE_Process(&handle);
+	}
+	TEST_CHECK_EQ(handle.FilledHalves, 5);
+
+	CAPTURE_Stop(&handle);
+	TEST_CHECK_EQ(handle.Overruns, 0);
+	CheckDecoded(&handle, Input, 5 * HALF + HALF / 2);
+}
+
+// The main loop is two halves late: the oldest full half is being written again and skipped
+static void test_Overrun(void)
+{
+	CAPTURE_Handle_t handle;
+
+	Setup(&handle);
+	TEST_CHECK_EQ(CAPTURE_Init(&handle), CAPTURE_OK);
+	CAPTURE_Start(&handle);
+
+	MakeInput(3 * HALF);
+	Feed(&handle, Input, 3 * HALF, 1);
+	CAPTURE_Process(&handle);
+	TEST_CHECK_EQ(handle.Overruns, 2);
+	TEST_CHECK_EQ(handle.ProcessedHalves, 3);
+
+	// Only the newest half is kept
+	CAPTURE_Stop(&handle);
+	CheckDecoded(&handle, &Input[2 * HALF], HALF);
+}
+
+// The last half is full but its interrupt did not run before the stop
+static void test_StopWithPendingHalf(void)
+{
+	CAPTURE_Handle_t handle;
+
+	Setup(&handle);
+	TEST_CHECK_EQ(CAPTURE_Init(&handle), CAPTURE_OK);
+	CAPTURE_Start(&handle);
+
+	MakeInput(3 * HALF + 3);
+	Feed(&handle, Input, HALF, 1);
+	CAPTURE_Process(&handle);
+	Feed(&handle, &Input[HALF], HALF, 1);
+	CAPTURE_Process(&handle);
+	Feed(&handle, &Input[2 * HALF], HALF + 3, 0);	// HTIF pending, 3 samples into the next half
+	TEST_CHECK(DMA_GetFlags(DMA2, 1) & DMA_FLAG_HT);
+
+	CAPTURE_Stop(&handle);
+	TEST_CHECK_EQ(handle.Overruns, 0);
+	CheckDecoded(&handle, Input, 3 * HALF + 3);
+
+	// Stopped stream: flags gone, interrupt masked, a late handler call counts nothing
+	TEST_CHECK_EQ(DMA_GetFlags(DMA2, 1), 0);
+	TEST_CHECK_EQ(DMA2->S[1].CR & (DMA_SxCR_HTIE | DMA_SxCR_TCIE | DMA_SxCR_EN), 0);
+	TEST_CHECK_EQ(IRQEnabled(IRQ_NO_DMA2_STREAM0 + 1), 0);
+	DMA2_Stream1_IRQHandler();
+	TEST_CHECK_EQ(handle.FilledHalves, 3);
+}
+
+// Stopped exactly at the end of the buffer, NDTR is reloaded and TCIF pending
+static void test_StopAtWrap(void)
+{
+	CAPTURE_Handle_t handle;
+
+	Setup(&handle);
+	TEST_CHECK_EQ(CAPTURE_Init(&handle), CAPTURE_OK);
+	CAPTURE_Start(&handle);
+
+	MakeInput(2 * HALF);
+	Feed(&handle, Input, HALF, 1);
+	CAPTURE_Process(&handle);
+	Feed(&handle, &Input[HALF], HALF, 0);
+	TEST_CHECK_EQ(DMA_GetRemaining(DMA2, 1), 2 * HALF);
+
+	CAPTURE_Stop(&handle);
+	TEST_CHECK_EQ(handle.Overruns, 0);
+	CheckDecoded(&handle, Input, 2 * HALF);
+}
+
+// Stopped in the middle of a half, everything served: the partial half is compressed once
+static void test_StopMidHalf(void)
+{
+	CAPTURE_Handle_t handle;
+
+	Setup(&handle);
+	TEST_CHECK_EQ(CAPTURE_Init(&handle), CAPTURE_OK);
+	CAPTURE_Start(&handle);
+
+	MakeInput(HALF + 5);
+	Feed(&handle, Input, HALF + 5, 1);
+	CAPTURE_Stop(&handle);
+	CheckDecoded(&handle, Input, HALF + 5);
+
+	// A new capture after the stop starts clean, with the interrupts on again
+	CAPTURE_Start(&handle);
+	TEST_CHECK(DMA2->S[1].CR & DMA_SxCR_TCIE);
+	TEST_CHECK(IRQEnabled(IRQ_NO_DMA2_STREAM0 + 1));
+	MakeInput(HALF / 2);
+	Feed(&handle, Input, HALF / 2, 1);
+	CAPTURE_Stop(&handle);
+	CheckDecoded(&handle, Input, HALF / 2);
+}
+
+int main(void)
+{
+	TEST_RUN(test_Compress);
+	TEST_RUN(test_LongRunIsSplit);
+	TEST_RUN(test_Trigger);
+	TEST_RUN(test_RingFull);
+	TEST_RUN(test_StreamWithInterrupts);
+	TEST_RUN(test_Overrun);
+	TEST_RUN(test_StopWithPendingHalf);
+	TEST_RUN(test_StopAtWrap);
+	TEST_RUN(test_StopMidHalf);
+
+	TEST_EXIT();
+}
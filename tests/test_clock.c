@@ -0,0 +1,405 @@
+/*
+ * test_clock.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <string.h>
+#include "test.h"
+
+// Clock users of the drivers. Init, Init again, Start, Stop and DeInit, and the error paths,
+// must leave RCC_PeriphClockUsers and RCC_PeriphSleepUsers as they found them. A driver takes
+// its clocks in Sleep mode only while a transfer, a stream or a sampling runs. Last, the time
+// each clock was on over a profile of run and sleep phases (SIM_GetClockOnCycles).
+
+#define PHASE		1000U
+
+typedef struct
+{
+	const char *pName;
+	uint8_t ClkId;
+}Clock_t;
+
+static const Clock_t Clocks[] =
+{
+	{ "GPIOA",  RCC_CLK_GPIOA },
+	{ "GPIOD",  RCC_CLK_GPIO(GPIOD) },
+	{ "GPIOE",  RCC_CLK_GPIO(GPIOE) },
+	{ "DMA1",   RCC_CLK_DMA1 },
+	{ "DMA2",   RCC_CLK_DMA2 },
+	{ "TIM1",   RCC_CLK_TIM1 },
+	{ "TIM2",   RCC_CLK_TIM2 },
+	{ "TIM8",   RCC_CLK_TIM8 },
+	{ "SPI1",   RCC_CLK_SPI1 },
+	{ "USART2", RCC_CLK_USART2 },
+	{ "I2C1",   RCC_CLK_I2C1 },
+	{ "ADC1",   RCC_CLK_ADC1 },
+	{ "SYSCFG", RCC_CLK_SYSCFG },
+};
+
+#define CLOCKS		(sizeof(Clocks) / sizeof(Clocks[0]))
+
+static uint8_t Users[CLOCKS];
+static uint8_t SleepUsers[CLOCKS];
+static uint32_t PatBuffer[2][8];
+static uint16_t CapSamples[32];
+static CAPTURE_Record_t CapRecords[16];
+static uint16_t EncSamples[32];
+static uint16_t AdcBuffer[2 * 4 * 2];
+static uint8_t Tx[8], Rx[8];
+
+static void Foreign(void *pArg, uint8_t Flags)
+{
+	(void)pArg;
+	(void)Flags;
+}
+
+static void Received(const uint8_t *pData, uint16_t Len, uint8_t Flags, void *pArg)
+{
+	(void)pData;
+	(void)Len;
+	(void)Flags;
+	(void)pArg;
+}
+
+static void Snapshot(void)
+{
+	for(uint32_t i = 0; i < CLOCKS; i++)
+	{
+		Users[i] = RCC_PeriphClockUsers(Clocks[i].ClkId);
+		SleepUsers[i] = RCC_PeriphSleepUsers(Clocks[i].ClkId);
+	}
+}
+
+// All the counts back to the snapshot, the failed clock is printed
+static void CheckBalanced(const char *pWhere)
+{
+	for(uint32_t i = 0; i < CLOCKS; i++)
+	{
+		if( (RCC_PeriphClockUsers(Clocks[i].ClkId) != Users[i]) ||
+			(RCC_PeriphSleepUsers(Clocks[i].ClkId) != SleepUsers[i]) )
+		{
+			printf("  %s: %s has %u users, %u in Sleep mode (was %u, %u)\n", pWhere, Clocks[i].pName,
+					(unsigned)RCC_PeriphClockUsers(Clocks[i].ClkId), (unsigned)RCC_PeriphSleepUsers(Clocks[i].ClkId),
+					(unsigned)Users[i], (unsigned)SleepUsers[i]);
+		}
+		TEST_CHECK_EQ(RCC_PeriphClockUsers(Clocks[i].ClkId), Users[i]);
+		TEST_CHECK_EQ(RCC_PeriphSleepUsers(Clocks[i].ClkId), SleepUsers[i]);
+	}
+}
+
+static void SetupSPI(SPI_Handle_t *pHandle)
+{
+	memset(pHandle, 0, sizeof(*pHandle));
+	pHandle->pSPIx = SPI1;
+	pHandle->SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+	pHandle->SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+	pHandle->SPIConfig.SPI_SclkSpeed = SPI_SCLK_SPEED_DIV4;
+	pHandle->SPIConfig.SPI_SSM = SPI_SSM_EN;
+	pHandle->XferMode = SPI_XFER_DMA;
+	pHandle->IRQPriority = 6;
+}
+
+static void SetupI2C(I2C_Handle_t *pHandle)
+{
+	memset(pHandle, 0, sizeof(*pHandle));
+	pHandle->pI2Cx = I2C1;
+	pHandle->I2CConfig.I2C_SCLSpeed = I2C_SCL_SPEED_FM;
+	pHandle->IRQPriority = 7;
+	pHandle->DMAMinLen = 4;
+}
+
+static void SetupPatgen(PATGEN_Handle_t *pHandle)
+{
+	*pHandle = (PATGEN_Handle_t){ 0 };
+	pHandle->Config.pGPIOx = GPIOD;
+	pHandle->Config.pTIMx = TIM1;
+	pHandle->Config.TimerClockHz = 168000000U;
+	pHandle->Config.SampleRateHz = 4000000U;
+	pHandle->Config.pBuffer[0] = PatBuffer[0];
+	pHandle->Config.pBuffer[1] = PatBuffer[1];
+	pHandle->Config.Length = 8;
+	pHandle->Config.Mode = PATGEN_MODE_CIRCULAR;
+	pHandle->Config.IRQPriority = 5;
+}
+
+static void test_SPI(void)
+{
+	SPI_Transaction_t txn = { .pTxBuffer = Tx, .pRxBuffer = Rx, .Len = sizeof(Tx) };
+	SPI_Handle_t handle;
+
+	Snapshot();
+	SetupSPI(&handle);
+	TEST_CHECK_EQ(SPI_Init(&handle), SPI_OK);
+	TEST_CHECK_EQ(SPI_Init(&handle), SPI_OK);		// Again: still one user
+	TEST_CHECK_EQ(RCC_PeriphClockUsers(RCC_CLK_SPI1), 1);
+	TEST_CHECK_EQ(RCC_PeriphSleepUsers(RCC_CLK_SPI1), 0);
+
+	// Sleep mode users from the start of the queue to its end
+	TEST_CHECK_EQ(SPI_Submit(&handle, &txn), SPI_OK);
+	TEST_CHECK_EQ(RCC_PeriphSleepUsers(RCC_CLK_SPI1), 1);
+	TEST_CHECK_EQ(RCC_PeriphSleepUsers(RCC_CLK_DMA2), SleepUsers[4] + 1);
+	SIM_DMAComplete(DMA2, handle.TxStream);
+	SIM_DMAComplete(DMA2, handle.RxStream);
+	DMA2_Stream0_IRQHandler();
+	TEST_CHECK(SPI_IsIdle(&handle));
+	TEST_CHECK_EQ(RCC_PeriphSleepUsers(RCC_CLK_SPI1), 0);
+
+	// And of a stream
+	TEST_CHECK_EQ(SPI_StreamStart(&handle, SPI_STREAM_TX, Tx, Rx, sizeof(Tx), NULL, NULL), SPI_OK);
+	TEST_CHECK_EQ(RCC_PeriphSleepUsers(RCC_CLK_SPI1), 1);
+	SPI_StreamStop(&handle);
+	TEST_CHECK_EQ(RCC_PeriphSleepUsers(RCC_CLK_SPI1), 0);
+
+	// DeInit with a transaction running
+	TEST_CHECK_EQ(SPI_Submit(&handle, &txn), SPI_OK);
+	SPI_DeInit(SPI1);
+	CheckBalanced("SPI");
+
+	// Error path: the RX stream is taken
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA2, 0, Foreign, NULL), DMA_OK);
+	SetupSPI(&handle);
+	TEST_CHECK_EQ(SPI_Init(&handle), SPI_ERR_BUSY);
+	SPI_DeInit(SPI1);
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA2, 0, NULL, NULL), DMA_OK);
+	CheckBalanced("SPI busy");
+}
+
+static void test_USART(void)
+{
+	static uint8_t ring[32];
+	USART_TxBuffer_t tx = { .pData = Tx, .Len = sizeof(Tx) };
+	USART_Handle_t handle;
+
+	Snapshot();
+	memset(&handle, 0, sizeof(handle));
+	handle.pUSARTx = USART2;
+	handle.USARTConfig.USART_Mode = USART_MODE_TXRX;
+	handle.USARTConfig.USART_Baud = 115200;
+	handle.IRQPriority = 5;
+	TEST_CHECK_EQ(USART_Init(&handle), USART_OK);
+	TEST_CHECK_EQ(USART_Init(&handle), USART_OK);
+	TEST_CHECK_EQ(RCC_PeriphClockUsers(RCC_CLK_USART2), 1);
+
+	// Receive ring and transmit queue each hold a Sleep mode user, a restart keeps one
+	TEST_CHECK_EQ(USART_RxStart(&handle, ring, sizeof(ring), Received, NULL), USART_OK);
+	TEST_CHECK_EQ(USART_RxStart(&handle, ring, sizeof(ring), Received, NULL), USART_OK);
+	TEST_CHECK_EQ(RCC_PeriphSleepUsers(RCC_CLK_USART2), 1);
+	TEST_CHECK_EQ(USART_Submit(&handle, &tx), USART_OK);
+	TEST_CHECK_EQ(RCC_PeriphSleepUsers(RCC_CLK_USART2), 2);
+	USART_RxStop(&handle);
+	TEST_CHECK_EQ(RCC_PeriphSleepUsers(RCC_CLK_USART2), 1);
+
+	// DeInit with the transmit queue running
+	USART_DeInit(USART2);
+	CheckBalanced("USART");
+}
+
+static void test_I2C(void)
+{
+	I2C_Transaction_t txn = { .Address = 0x50, .pRxBuffer = Rx, .RxLen = sizeof(Rx) };
+	I2C_Handle_t handle;
+
+	Snapshot();
+	SetupI2C(&handle);
+	TEST_CHECK_EQ(I2C_Init(&handle), I2C_OK);
+	TEST_CHECK_EQ(I2C_Init(&handle), I2C_OK);		// After a clock change
+	TEST_CHECK_EQ(RCC_PeriphClockUsers(RCC_CLK_I2C1), 1);
+
+	TEST_CHECK_EQ(I2C_Submit(&handle, &txn), I2C_OK);
+	TEST_CHECK_EQ(RCC_PeriphSleepUsers(RCC_CLK_I2C1), 1);
+	TEST_CHECK_EQ(RCC_PeriphSleepUsers(RCC_CLK_DMA1), SleepUsers[3] + 1);
+	I2C_DeInit(I2C1);
+	CheckBalanced("I2C");
+}
+
+static void test_Modules(void)
+{
+	static const uint8_t channels[2] = { 0, 1 };
+	PATGEN_Handle_t patgen;
+	CAPTURE_Handle_t capture = { 0 };
+	ENCODER_Handle_t encoder = { 0 };
+	ADC_Handle_t adc = { 0 };
+
+	Snapshot();
+	SetupPatgen(&patgen);
+	TEST_CHECK_EQ(PATGEN_Init(&patgen), PATGEN_OK);
+	TEST_CHECK_EQ(PATGEN_Init(&patgen), PATGEN_OK);
+	PATGEN_Start(&patgen);
+	PATGEN_Start(&patgen);
+	TEST_CHECK_EQ(RCC_PeriphSleepUsers(RCC_CLK_TIM1), 1);
+	PATGEN_Stop(&patgen);
+	PATGEN_Stop(&patgen);
+	TEST_CHECK_EQ(RCC_PeriphSleepUsers(RCC_CLK_TIM1), 0);
+	PATGEN_Start(&patgen);
+	PATGEN_DeInit(&patgen);
+	CheckBalanced("PATGEN");
+
+	// Sample rate out of range: nothing kept
+	SetupPatgen(&patgen);
+	patgen.Config.SampleRateHz = 0;
+	TEST_CHECK(PATGEN_Init(&patgen) != PATGEN_OK);
+	CheckBalanced("PATGEN rate");
+
+	capture.Config.pGPIOx = GPIOE;
+	capture.Config.pTIMx = TIM8;
+	capture.Config.TimerClockHz = 168000000U;
+	capture.Config.SampleRateHz = 1000000U;
+	capture.Config.pSamples = CapSamples;
+	capture.Config.HalfLength = 16;
+	capture.Config.pRecords = CapRecords;
+	capture.Config.RecordCount = 16;
+	capture.Config.IRQPriority = 4;
+	TEST_CHECK_EQ(CAPTURE_Init(&capture), CAPTURE_OK);
+	TEST_CHECK_EQ(CAPTURE_Init(&capture), CAPTURE_OK);
+	CAPTURE_Start(&capture);
+	CAPTURE_Start(&capture);
+	TEST_CHECK_EQ(RCC_PeriphSleepUsers(RCC_CLK_TIM8), 1);
+	CAPTURE_Stop(&capture);
+	CAPTURE_Start(&capture);
+	CAPTURE_DeInit(&capture);
+	CheckBalanced("CAPTURE");
+
+	encoder.Config.pGPIOx = GPIOE;
+	encoder.Config.Mode = ENCODER_MODE_POLL;
+	encoder.Config.ChannelCount = 1;
+	encoder.Config.IRQPriority = 4;
+	encoder.Config.pTIMx = TIM8;
+	encoder.Config.TimerClockHz = 168000000U;
+	encoder.Config.SampleRateHz = 1000000U;
+	encoder.Config.pSamples = EncSamples;
+	encoder.Config.HalfLength = 16;
+	encoder.Channel[0].PinA = 2;
+	encoder.Channel[0].PinB = 3;
+	TEST_CHECK_EQ(ENCODER_Init(&encoder), ENCODER_OK);
+	TEST_CHECK_EQ(ENCODER_Init(&encoder), ENCODER_OK);
+	ENCODER_Start(&encoder);
+	ENCODER_Start(&encoder);
+	TEST_CHECK_EQ(RCC_PeriphSleepUsers(RCC_CLK_TIM8), 1);
+	ENCODER_Stop(&encoder);
+	TEST_CHECK_EQ(RCC_PeriphSleepUsers(RCC_CLK_TIM8), 0);
+	ENCODER_Start(&encoder);
+	ENCODER_DeInit(&encoder);
+	CheckBalanced("ENCODER");
+
+	adc.Config.pADCx = ADC1;
+	adc.Config.pChannels = channels;
+	adc.Config.ChannelCount = 2;
+	adc.Config.SampleTime = ADC_SMP_15;
+	adc.Config.IRQPriority = 3;
+	adc.Config.pTIMx = TIM2;
+	adc.Config.TimerClockHz = 84000000U;
+	adc.Config.ScanRateHz = 10000U;
+	adc.Config.pBuffer = AdcBuffer;
+	adc.Config.FrameScans = 4;
+	TEST_CHECK_EQ(ADC_Init(&adc), ADC_OK);
+	TEST_CHECK_EQ(ADC_Init(&adc), ADC_OK);
+	TEST_CHECK_EQ(RCC_PeriphClockUsers(RCC_CLK_ADC1), 1);
+	TEST_CHECK_EQ(RCC_PeriphClockUsers(RCC_CLK_GPIOA), Users[0] + 1);	// PA0 and PA1
+	ADC_Start(&adc);
+	ADC_Start(&adc);
+	TEST_CHECK_EQ(RCC_PeriphSleepUsers(RCC_CLK_ADC1), 1);
+	ADC_Stop(&adc);
+	ADC_Start(&adc);
+	ADC_DeInit(&adc);
+	CheckBalanced("ADC");
+}
+
+static void test_SoftPWM(void)
+{
+	static const SOFTPWM_Pin_t pins[2] = { { GPIOD, 12 }, { GPIOD, 13 } };
+	SOFTPWM_Handle_t pwm = { 0 };
+
+	Snapshot();
+	pwm.Config.pPins = pins;
+	pwm.Config.ChannelCount = 2;
+	pwm.Config.pTIMx = TIM2;
+	pwm.Config.TimerClockHz = 84000000U;
+	pwm.Config.TickHz = 1000000U;
+	pwm.Config.PeriodTicks = 1000;
+	pwm.Config.IRQPriority = 6;
+	TEST_CHECK_EQ(SOFTPWM_Init(&pwm), SOFTPWM_OK);
+	TEST_CHECK_EQ(SOFTPWM_Init(&pwm), SOFTPWM_OK);
+	TEST_CHECK_EQ(RCC_PeriphClockUsers(RCC_CLK_TIM2), Users[6] + 1);
+	SOFTPWM_Start(&pwm);
+	SOFTPWM_Start(&pwm);
+	TEST_CHECK_EQ(RCC_PeriphSleepUsers(RCC_CLK_TIM2), SleepUsers[6] + 1);
+	SOFTPWM_Stop(&pwm);
+	SOFTPWM_Start(&pwm);
+	SOFTPWM_DeInit(&pwm);
+	CheckBalanced("SOFTPWM");
+}
+
+// The SYSCFG clock is on only for the EXTICR writes
+static void test_SYSCFG(void)
+{
+	static const GPIO_PinConfig_t pins[2] =
+	{
+		{ .GPIO_PinNumber = 3, .GPIO_PinMode = GPIO_MODE_IT_FT, .GPIO_PinPuPdControl = GPIO_PIN_PU },
+		{ .GPIO_PinNumber = 4, .GPIO_PinMode = GPIO_MODE_IT_RFT, .GPIO_PinPuPdControl = GPIO_PIN_PU },
+	};
+
+	GPIO_PeriClockEnable(GPIOB);
+	TEST_CHECK_EQ(GPIO_InitPort(GPIOB, pins, 2), GPIO_OK);
+	TEST_CHECK_EQ(GPIO_InitPort(GPIOB, pins, 2), GPIO_OK);
+	TEST_CHECK_EQ((SYSCFG->EXTICR[0] >> 12) & 0xFU, 1);
+	TEST_CHECK_EQ(RCC_PeriphClockUsers(RCC_CLK_SYSCFG), 0);
+	TEST_CHECK_EQ(RCC->APB2ENR & (1U << RCC_CLK_BIT(RCC_CLK_SYSCFG)), 0);
+	GPIO_PeriClockDisable(GPIOB);
+}
+
+// Run and sleep phases with an SPI transfer queued in one of them: the clock-on time of each
+// peripheral, and after DeInit none of them runs
+static void test_ClockOnTime(void)
+{
+	static const uint32_t expected[CLOCKS] =
+	{
+		[3] = 2 * PHASE,					// DMA1: I2C1 in the run phases
+		[4] = 3 * PHASE,					// DMA2: SPI1 in the run phases and the transfer
+		[8] = 3 * PHASE,					// SPI1
+		[10] = 2 * PHASE,					// I2C1
+	};
+	SPI_Transaction_t txn = { .pTxBuffer = Tx, .pRxBuffer = Rx, .Len = sizeof(Tx) };
+	SPI_Handle_t spi;
+	I2C_Handle_t i2c;
+
+	SetupSPI(&spi);
+	SetupI2C(&i2c);
+	TEST_CHECK_EQ(SPI_Init(&spi), SPI_OK);
+	TEST_CHECK_EQ(I2C_Init(&i2c), I2C_OK);
+	SIM_ResetCounters();
+
+	(void)SIM_AdvanceCycles(PHASE);
+	(void)SIM_SleepCycles(PHASE);					// Idle: all gated
+	TEST_CHECK_EQ(SPI_Submit(&spi, &txn), SPI_OK);
+	(void)SIM_SleepCycles(PHASE);					// SPI1 and DMA2 run
+	SIM_DMAComplete(DMA2, spi.TxStream);
+	SIM_DMAComplete(DMA2, spi.RxStream);
+	DMA2_Stream0_IRQHandler();
+	(void)SIM_AdvanceCycles(PHASE);
+	SPI_DeInit(SPI1);
+	I2C_DeInit(I2C1);
+	(void)SIM_AdvanceCycles(PHASE);
+
+	for(uint32_t i = 0; i < CLOCKS; i++)
+	{
+		uint64_t on = SIM_GetClockOnCycles(Clocks[i].ClkId);
+
+		printf("  %-7s %5u of %5u cycles on\n", Clocks[i].pName, (unsigned)on, 5 * PHASE);
+		TEST_CHECK_EQ(on, expected[i]);
+	}
+}
+
+int main(void)
+{
+	TEST_RUN(test_SPI);
+	TEST_RUN(test_USART);
+	TEST_RUN(test_I2C);
+	TEST_RUN(test_Modules);
+	TEST_RUN(test_SoftPWM);
+	TEST_RUN(test_SYSCFG);
+	TEST_RUN(test_ClockOnTime);
+
+	TEST_EXIT();
+}
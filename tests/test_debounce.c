@@ -0,0 +1,187 @@
+/*
+ * test_debounce.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <stdlib.h>
+#include "test.h"
+
+// Pressed, Released and Changed masks of the vertical counters, at the shortest and the
+// longest StableCount, and against a per-pin counter model on random bouncing input.
+
+#define RANDOM_TICKS		20000
+
+typedef struct
+{
+	uint16_t State;
+	uint8_t Count[16];
+}Model_t;
+
+// One counter per pin: + 1 while the pin differs from its state, 0 when it agrees
+static uint16_t ModelUpdate(Model_t *pModel, uint16_t Sample, uint8_t StableCount)
+{
+	uint16_t changed = 0;
+
+	for(uint8_t pin = 0; pin < 16; pin++)
+	{
+		if( ((Sample ^ pModel->State) >> pin) & 1U )
+		{
+			if(++pModel->Count[pin] == StableCount)
+			{
+				changed |= (uint16_t)(1U << pin);
+				pModel->Count[pin] = 0;
+			}
+		}
+		else
+		{
+			pModel->Count[pin] = 0;
+		}
+	}
+	pModel->State ^= changed;
+
+	return changed;
+}
+
+static void Setup(DEBOUNCE_Handle_t *pHandle, uint16_t PinMask, uint16_t ActiveLow, uint8_t StableCount)
+{
+	*pHandle = (DEBOUNCE_Handle_t){ 0 };
+	pHandle->Config.pGPIOx = GPIOA;
+	pHandle->Config.PinMask = PinMask;
+	pHandle->Config.ActiveLow = ActiveLow;
+	pHandle->Config.StableCount = StableCount;
+}
+
+static void CheckTick(DEBOUNCE_Handle_t *pHandle, uint16_t Sample, uint16_t Pressed, uint16_t Released)
+{
+	uint16_t changed = DEBOUNCE_Update(pHandle, Sample);
+
+	TEST_CHECK_EQ(pHandle->Pressed, Pressed);
+	TEST_CHECK_EQ(pHandle->Released, Released);
+	TEST_CHECK_EQ(pHandle->Changed, Pressed | Released);
+	TEST_CHECK_EQ(changed, Pressed | Released);
+}
+
+static void test_Config(void)
+{
+	DEBOUNCE_Handle_t handle;
+
+	Setup(&handle, 0xFFFF, 0, 0);
+	TEST_CHECK_EQ(DEBOUNCE_Init(&handle), DEBOUNCE_ERR_CONFIG);
+	Setup(&handle, 0xFFFF, 0, DEBOUNCE_STABLE_MAX + 1);
+	TEST_CHECK_EQ(DEBOUNCE_Init(&handle), DEBOUNCE_ERR_CONFIG);
+
+	// The levels at init are the state, without events
+	SIM_SetInputPort(GPIOA, 0x00F0);
+	Setup(&handle, 0x0FFF, 0x0F00, 1);
+	TEST_CHECK_EQ(DEBOUNCE_Init(&handle), DEBOUNCE_OK);
+	TEST_CHECK_EQ(handle.Bits, 1);
+	TEST_CHECK_EQ(DEBOUNCE_GetState(&handle), 0x0FF0);
+	TEST_CHECK_EQ(handle.Changed, 0);
+
+	Setup(&handle, 0xFFFF, 0, DEBOUNCE_STABLE_MAX);
+	TEST_CHECK_EQ(DEBOUNCE_Init(&handle), DEBOUNCE_OK);
+	TEST_CHECK_EQ(handle.Bits, DEBOUNCE_COUNTER_BITS);
+}
+
+// StableCount 1: every change is taken on the tick it is seen
+static void test_StableCountOne(void)
+{
+	DEBOUNCE_Handle_t handle;
+
+	SIM_SetInputPort(GPIOA, 0x0000);
+	Setup(&handle, 0x00FF, 0x0080, 1);		// Pin 7 is active low, pins 8 - 15 not debounced
+	TEST_CHECK_EQ(DEBOUNCE_Init(&handle), DEBOUNCE_OK);
+	TEST_CHECK_EQ(DEBOUNCE_GetState(&handle), 0x0080);
+
+	CheckTick(&handle, 0x0003, 0x0003, 0);
+	CheckTick(&handle, 0x0003, 0, 0);
+	CheckTick(&handle, 0x0082, 0, 0x0081);		// Pin 0 released, pin 7 high: released
+	CheckTick(&handle, 0xFF00, 0x0080, 0x0002);	// Pins outside the mask never change
+	CheckTick(&handle, 0x0001, 0x0001, 0);
+	CheckTick(&handle, 0x0080, 0, 0x0081);
+	TEST_CHECK_EQ(DEBOUNCE_GetState(&handle), 0);
+
+	// DEBOUNCE_Tick reads the port
+	SIM_SetInputPort(GPIOA, 0x0010);
+	TEST_CHECK_EQ(DEBOUNCE_Tick(&handle), 0x0090);
+	TEST_CHECK_EQ(handle.Pressed, 0x0090);
+}
+
+// StableCount 15: 14 equal samples are not enough, one bounce starts the count again
+static void test_StableCountMax(void)
+{
+	DEBOUNCE_Handle_t handle;
+
+	SIM_SetInputPort(GPIOA, 0x0000);
+	Setup(&handle, 0xFFFF, 0, DEBOUNCE_STABLE_MAX);
+	TEST_CHECK_EQ(DEBOUNCE_Init(&handle), DEBOUNCE_OK);
+
+	for(uint32_t i = 0; i < DEBOUNCE_STABLE_MAX - 1; i++)
+	{
+		CheckTick(&handle, 0x8001, 0, 0);
+	}
+	CheckTick(&handle, 0x0001, 0x0001, 0);		// Pin 0 stable for 15 ticks, pin 15 bounces back
+	CheckTick(&handle, 0x8001, 0, 0);
+	for(uint32_t i = 0; i < DEBOUNCE_STABLE_MAX - 2; i++)
+	{
+		CheckTick(&handle, 0x8001, 0, 0);
+	}
+	CheckTick(&handle, 0x8001, 0x8000, 0);
+	TEST_CHECK_EQ(DEBOUNCE_GetState(&handle), 0x8001);
+
+	// Release of both, the counters were cleared when the state was taken
+	for(uint32_t i = 0; i < DEBOUNCE_STABLE_MAX - 1; i++)
+	{
+		CheckTick(&handle, 0x0000, 0, 0);
+	}
+	CheckTick(&handle, 0x0000, 0, 0x8001);
+	CheckTick(&handle, 0x0000, 0, 0);
+}
+
+// Same events as a counter per pin, for every StableCount, on bouncing random input
+static void test_AgainstPerPinModel(void)
+{
+	srand(7);
+
+	for(uint8_t stable = 1; stable <= DEBOUNCE_STABLE_MAX; stable++)
+	{
+		DEBOUNCE_Handle_t handle;
+		Model_t model = { 0 };
+		uint16_t level = 0, mismatches = 0;
+
+		SIM_SetInputPort(GPIOA, 0x0000);
+		Setup(&handle, 0xFFFF, 0, stable);
+		TEST_CHECK_EQ(DEBOUNCE_Init(&handle), DEBOUNCE_OK);
+
+		for(uint32_t t = 0; t < RANDOM_TICKS; t++)
+		{
+			uint16_t sample;
+
+			// Levels change rarely, each sample bounces some pins
+			if(rand() % 32 == 0)
+			{
+				level ^= (uint16_t)(1U << (rand() % 16));
+			}
+			sample = level ^ (uint16_t)((rand() % 4 == 0) ? (rand() & rand()) : 0);
+
+			if( (DEBOUNCE_Update(&handle, sample) != ModelUpdate(&model, sample, stable)) ||
+				(DEBOUNCE_GetState(&handle) != model.State) )
+			{
+				mismatches++;
+			}
+		}
+		TEST_CHECK_EQ(mismatches, 0);
+	}
+}
+
+int main(void)
+{
+	TEST_RUN(test_Config);
+	TEST_RUN(test_StableCountOne);
+	TEST_RUN(test_StableCountMax);
+	TEST_RUN(test_AgainstPerPinModel);
+
+	TEST_EXIT();
+}
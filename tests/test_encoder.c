@@ -0,0 +1,218 @@
+/*
+ * test_encoder.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "test.h"
+
+// Quadrature decoding, poll mode on a host model of its DMA stream (as in test_capture.c:
+// each sample is stored where NDTR says and the stream is advanced by one item, the interrupt
+// is served or left pending), and the EXTI lines of EXTI mode. Each sample of the input is one
+// step forward, so the position after a stop is the number of samples taken. The sample buffer
+// starts with values that would count as steps and errors if they were decoded.
+
+#define HALF			16
+#define PIN_A			2
+#define PIN_B			3
+
+static uint16_t Samples[2 * HALF];
+
+// Port levels after Step steps forward: A B = 00, 10, 11, 01
+static uint16_t Quad(uint32_t Step)
+{
+	static const uint8_t levels[4] = { 0x0, 0x2, 0x3, 0x1 };
+	uint8_t ab = levels[Step % 4];
+
+	return (uint16_t)((((ab >> 1) & 1U) << PIN_A) | ((ab & 1U) << PIN_B));
+}
+
+static void Setup(ENCODER_Handle_t *pHandle, uint8_t Mode)
+{
+	*pHandle = (ENCODER_Handle_t){ 0 };
+	pHandle->Config.pGPIOx = GPIOE;
+	pHandle->Config.Mode = Mode;
+	pHandle->Config.ChannelCount = 1;
+	pHandle->Config.IRQPriority = 4;
+	pHandle->Config.pTIMx = TIM8;
+	pHandle->Config.TimerClockHz = 168000000U;
+	pHandle->Config.SampleRateHz = 1000000U;
+	pHandle->Config.pSamples = Samples;
+	pHandle->Config.HalfLength = HALF;
+	pHandle->Channel[0].PinA = PIN_A;
+	pHandle->Channel[0].PinB = PIN_B;
+}
+
+// Samples First + 1 ... First + Count through the DMA model, the interrupt runs for each
+// flag while Served is not 0, one flag less each time
+static void Feed(ENCODER_Handle_t *pHandle, uint32_t First, uint32_t Count, uint32_t Served)
+{
+	for(uint32_t i = 0; i < Count; i++)
+	{
+		uint32_t pos = (2U * HALF) - DMA_GetRemaining(DMA2, pHandle->Stream);
+
+		Samples[pos] = Quad(First + i + 1);
+		SIM_DMAAdvance(DMA2, pHandle->Stream, 1);
+		if( (Served != 0) && (DMA_GetFlags(DMA2, pHandle->Stream) & (DMA_FLAG_HT | DMA_FLAG_TC)) )
+		{
+			DMA_IRQHandling(DMA2, pHandle->Stream);
+			Served--;
+		}
+	}
+}
+
+static void Poison(void)
+{
+	for(uint32_t i = 0; i < 2 * HALF; i++)
+	{
+		Samples[i] = (i % 2) ? Quad(2) : Quad(0);	// A and B change together
+	}
+}
+
+static void test_UpdateBatch(void)
+{
+	ENCODER_Handle_t handle;
+	uint16_t trace[40];
+
+	Setup(&handle, ENCODER_MODE_POLL);
+	for(uint32_t i = 0; i < 40; i++)
+	{
+		trace[i] = (i < 30) ? Quad(i + 1) : Quad(30 - (i - 29));	// 30 forward, 10 back
+	}
+	ENCODER_UpdateBatch(&handle, trace, 40);
+	TEST_CHECK_EQ(ENCODER_GetPosition(&handle, 0), 20);
+	TEST_CHECK_EQ(ENCODER_GetErrors(&handle, 0), 0);
+
+	// Same result one sample at a time
+	handle.Channel[0] = (ENCODER_Channel_t){ .PinA = PIN_A, .PinB = PIN_B };
+	for(uint32_t i = 0; i < 40; i++)
+	{
+		ENCODER_Update(&handle, trace[i]);
+	}
+	TEST_CHECK_EQ(ENCODER_GetPosition(&handle, 0), 20);
+
+	// Both pins at once: an error, no step
+	trace[0] = Quad(2);
+	ENCODER_UpdateBatch(&handle, trace, 1);
+	TEST_CHECK_EQ(ENCODER_GetPosition(&handle, 0), 20);
+	TEST_CHECK_EQ(ENCODER_GetErrors(&handle, 0), 1);
+}
+
+// Stop in the middle of a half, with the half transfer interrupt served
+static void test_StopMidHalf(void)
+{
+	ENCODER_Handle_t handle;
+
+	Setup(&handle, ENCODER_MODE_POLL);
+	TEST_CHECK_EQ(ENCODER_Init(&handle), ENCODER_OK);
+	SIM_SetInputPort(GPIOE, Quad(0));
+	Poison();
+	ENCODER_Start(&handle);
+
+	Feed(&handle, 0, HALF + 5, ~0U);
+	TEST_CHECK_EQ(ENCODER_GetPosition(&handle, 0), HALF);
+	ENCODER_Stop(&handle);
+	TEST_CHECK_EQ(ENCODER_GetPosition(&handle, 0), HALF + 5);
+	TEST_CHECK_EQ(ENCODER_GetErrors(&handle, 0), 0);
+	TEST_CHECK_EQ(DMA2->S[handle.Stream].CR & (DMA_SxCR_HTIE | DMA_SxCR_TCIE), 0);
+
+	// The pending flags are gone, a late interrupt decodes nothing
+	DMA_IRQHandling(DMA2, handle.Stream);
+	TEST_CHECK_EQ(ENCODER_GetPosition(&handle, 0), HALF + 5);
+
+	ENCODER_DeInit(&handle);
+}
+
+// Transfer complete not served: the second half and the start of the first are decoded once
+static void test_StopWithPendingHalf(void)
+{
+	ENCODER_Handle_t handle;
+
+	Setup(&handle, ENCODER_MODE_POLL);
+	TEST_CHECK_EQ(ENCODER_Init(&handle), ENCODER_OK);
+	SIM_SetInputPort(GPIOE, Quad(0));
+	Poison();
+	ENCODER_Start(&handle);
+
+	Feed(&handle, 0, 2 * HALF + 3, 1);
+	TEST_CHECK_EQ(ENCODER_GetPosition(&handle, 0), HALF);
+	ENCODER_Stop(&handle);
+	TEST_CHECK_EQ(ENCODER_GetPosition(&handle, 0), 2 * HALF + 3);
+	TEST_CHECK_EQ(ENCODER_GetErrors(&handle, 0), 0);
+
+	// Restart: stopped right at the end of the buffer, NDTR reloaded
+	SIM_SetInputPort(GPIOE, Quad(2 * HALF + 3));
+	ENCODER_SetPosition(&handle, 0, 0);
+	Poison();
+	ENCODER_Start(&handle);
+	TEST_CHECK(DMA2->S[handle.Stream].CR & DMA_SxCR_TCIE);
+	Feed(&handle, 2 * HALF + 3, 2 * HALF, 1);
+	ENCODER_Stop(&handle);
+	TEST_CHECK_EQ(ENCODER_GetPosition(&handle, 0), 2 * HALF);
+	TEST_CHECK_EQ(ENCODER_GetErrors(&handle, 0), 0);
+
+	ENCODER_DeInit(&handle);
+}
+
+// Steps the inputs to Quad(Step) and serves the EXTI lines of the pins
+static void Move(uint32_t Step)
+{
+	SIM_SetInputPort(GPIOE, Quad(Step));
+	EXTI2_IRQHandler();
+	EXTI3_IRQHandler();
+}
+
+// The lines belong to the running encoder only, a stop gives them back
+static void test_EXTILines(void)
+{
+	static const GPIO_PinConfig_t pins[2] =
+	{
+		{ .GPIO_PinNumber = PIN_A, .GPIO_PinMode = GPIO_MODE_IT_RFT },
+		{ .GPIO_PinNumber = PIN_B, .GPIO_PinMode = GPIO_MODE_IT_RFT },
+	};
+	ENCODER_Handle_t first, second;
+
+	GPIO_PeriClockEnable(GPIOE);
+	TEST_CHECK_EQ(GPIO_InitPort(GPIOE, pins, 2), GPIO_OK);
+	SIM_SetInputPort(GPIOE, Quad(0));
+
+	Setup(&first, ENCODER_MODE_EXTI);
+	Setup(&second, ENCODER_MODE_EXTI);
+	TEST_CHECK_EQ(ENCODER_Init(&first), ENCODER_OK);
+	ENCODER_Start(&first);
+	TEST_CHECK_EQ(ENCODER_Init(&second), ENCODER_ERR_CONFIG);
+	Move(1);
+	Move(2);
+	TEST_CHECK_EQ(ENCODER_GetPosition(&first, 0), 2);
+	ENCODER_Stop(&first);
+	Move(3);
+	TEST_CHECK_EQ(ENCODER_GetPosition(&first, 0), 2);
+
+	// The second one takes the lines
+	TEST_CHECK_EQ(ENCODER_Init(&second), ENCODER_OK);
+	ENCODER_Start(&second);
+	Move(4);
+	TEST_CHECK_EQ(ENCODER_GetPosition(&second, 0), 1);
+	ENCODER_DeInit(&second);
+
+	// And gives them back to the first one
+	ENCODER_Start(&first);
+	Move(5);
+	Move(4);
+	Move(5);
+	TEST_CHECK_EQ(ENCODER_GetPosition(&first, 0), 3);
+	TEST_CHECK_EQ(ENCODER_GetPosition(&second, 0), 1);
+	ENCODER_DeInit(&first);
+	GPIO_PeriClockDisable(GPIOE);
+}
+
+int main(void)
+{
+	TEST_RUN(test_UpdateBatch);
+	TEST_RUN(test_StopMidHalf);
+	TEST_RUN(test_StopWithPendingHalf);
+	TEST_RUN(test_EXTILines);
+
+	TEST_EXIT();
+}
@@ -0,0 +1,224 @@
+/*
+ * test_gpio_exti.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "test.h"
+
+// EXTI configuration, NVIC setup and dispatch: priorities stay in their field, lines are
+// released when their pin leaves the interrupt modes, and the dispatch costs one read and
+// one write of EXTI_PR however many lines its IRQ serves.
+
+#define DISPATCH_ROUNDS		200000
+
+static uint8_t Calls[16];
+static uint8_t Order[16];
+static uint8_t OrderLen;
+
+static void OnEdge(uint8_t PinNumber)
+{
+	Calls[PinNumber]++;
+	if(OrderLen < sizeof(Order))
+	{
+		Order[OrderLen++] = PinNumber;
+	}
+}
+
+static void ClearCalls(void)
+{
+	for(uint8_t i = 0; i < 16; i++)
+	{
+		Calls[i] = 0;
+		GPIO_RegisterEXTICallback(i, OnEdge);
+	}
+	OrderLen = 0;
+}
+
+static GPIO_PinConfig_t Pin(uint8_t PinNumber, uint8_t Mode)
+{
+	GPIO_PinConfig_t pin = { .GPIO_PinNumber = PinNumber, .GPIO_PinMode = Mode };
+
+	return pin;
+}
+
+static void test_PriorityStaysInItsField(void)
+{
+	// EXTI0 (IRQ 6) is field 2 of IPR1, its neighbours are IRQ 5 and 7
+	REG_WRITE(NVIC_IPR[1], 0xA0B0C0D0U);
+
+	GPIO_IRQConfig(IRQ_NO_EXTI0, 0x1F, ENABLE);
+	TEST_CHECK_EQ(NVIC_IPR[1], 0xA0F0C0D0U);		// 0x1F & 0xF = 15, upper 4 bits of the field
+	TEST_CHECK_EQ(NVIC_ISER[0] & (1U << IRQ_NO_EXTI0), 1U << IRQ_NO_EXTI0);
+
+	GPIO_IRQConfig(IRQ_NO_EXTI0, 0xFF, ENABLE);
+	TEST_CHECK_EQ(NVIC_IPR[1], 0xA0F0C0D0U);
+
+	GPIO_IRQConfig(IRQ_NO_EXTI0, 3, ENABLE);
+	TEST_CHECK_EQ(NVIC_IPR[1], 0xA030C0D0U);
+
+	GPIO_IRQConfig(IRQ_NO_EXTI0, 3, DISABLE);
+	TEST_CHECK_EQ(NVIC_ISER[0] & (1U << IRQ_NO_EXTI0), 0);
+	TEST_CHECK_EQ(NVIC_IPR[1], 0xA030C0D0U);		// Disable leaves the priority
+
+	// IRQ 43 is the last field of IPR10: nothing spills into IPR11
+	REG_WRITE(NVIC_IPR[10], 0);
+	REG_WRITE(NVIC_IPR[11], 0);
+	GPIO_IRQConfig(43, 0xFF, ENABLE);
+	TEST_CHECK_EQ(NVIC_IPR[10], 0xF0000000U);
+	TEST_CHECK_EQ(NVIC_IPR[11], 0);
+	GPIO_IRQConfig(43, 0, DISABLE);
+}
+
+static void test_InputModeReleasesLine(void)
+{
+	GPIO_PinConfig_t pins[2] = { Pin(3, GPIO_MODE_IT_RFT), Pin(4, GPIO_MODE_IT_FT) };
+
+	GPIO_PeriClockEnable(GPIOB);
+	TEST_CHECK_EQ(GPIO_InitPort(GPIOB, pins, 2), GPIO_OK);
+	TEST_CHECK_EQ(EXTI->IMR & 0x18U, 0x18U);
+	TEST_CHECK_EQ(EXTI->RTSR & 0x18U, 0x08U);
+	TEST_CHECK_EQ(EXTI->FTSR & 0x18U, 0x18U);
+	TEST_CHECK_EQ((SYSCFG->EXTICR[0] >> 12) & 0xFU, 1);	// Line 3 on port B
+
+	// Pin 3 becomes an output, pin 4 stays in interrupt mode
+	pins[0] = Pin(3, GPIO_MODE_OUT);
+	TEST_CHECK_EQ(GPIO_InitPort(GPIOB, pins, 1), GPIO_OK);
+	TEST_CHECK_EQ(EXTI->IMR & 0x18U, 0x10U);
+	TEST_CHECK_EQ(EXTI->RTSR & 0x18U, 0);
+	TEST_CHECK_EQ(EXTI->FTSR & 0x18U, 0x10U);
+
+	// No interrupt from pin 3 any more
+	ClearCalls();
+	SIM_SetInputPort(GPIOB, 0x0008);
+	SIM_SetInputPort(GPIOB, 0x0000);
+	EXTI3_IRQHandler();
+	TEST_CHECK_EQ(Calls[3], 0);
+
+	// Pin 4 still fires
+	SIM_SetInputPort(GPIOB, 0x0010);
+	SIM_SetInputPort(GPIOB, 0x0000);
+	EXTI4_IRQHandler();
+	TEST_CHECK_EQ(Calls[4], 1);
+
+	// A port reset releases the rest
+	GPIO_DeInit(GPIOB);
+	TEST_CHECK_EQ(EXTI->IMR & 0x18U, 0);
+	TEST_CHECK_EQ(EXTI->FTSR & 0x18U, 0);
+
+	GPIO_PeriClockDisable(GPIOB);
+}
+
+static void test_LineOfOtherPortIsKept(void)
+{
+	GPIO_PinConfig_t pin = Pin(5, GPIO_MODE_IT_RT);
+
+	GPIO_PeriClockEnable(GPIOC);
+	GPIO_PeriClockEnable(GPIOD);
+
+	// Line 5 first on port C, then taken over by port D
+	TEST_CHECK_EQ(GPIO_InitPort(GPIOC, &pin, 1), GPIO_OK);
+	TEST_CHECK_EQ(GPIO_InitPort(GPIOD, &pin, 1), GPIO_OK);
+	TEST_CHECK_EQ((SYSCFG->EXTICR[1] >> 4) & 0xFU, 3);
+
+	// PC5 back to input must not disable the line of PD5
+	pin = Pin(5, GPIO_MODE_IN);
+	TEST_CHECK_EQ(GPIO_InitPort(GPIOC, &pin, 1), GPIO_OK);
+	TEST_CHECK_EQ(EXTI->IMR & (1U << 5), 1U << 5);
+	TEST_CHECK_EQ(EXTI->RTSR & (1U << 5), 1U << 5);
+
+	pin = Pin(5, GPIO_MODE_IN);
+	TEST_CHECK_EQ(GPIO_InitPort(GPIOD, &pin, 1), GPIO_OK);
+	TEST_CHECK_EQ(EXTI->IMR & (1U << 5), 0);
+
+	GPIO_PeriClockDisable(GPIOC);
+	GPIO_PeriClockDisable(GPIOD);
+}
+
+static void test_DispatchOrderAndCost(void)
+{
+	GPIO_PinConfig_t pins[3] = { Pin(10, GPIO_MODE_IT_RT), Pin(12, GPIO_MODE_IT_RT), Pin(15, GPIO_MODE_IT_RT) };
+
+	GPIO_PeriClockEnable(GPIOE);
+	TEST_CHECK_EQ(GPIO_InitPort(GPIOE, pins, 3), GPIO_OK);
+	TEST_CHECK_EQ(GPIO_PinToIRQNumber(12), IRQ_NO_EXTI15_10);
+
+	ClearCalls();
+	SIM_SetInputPort(GPIOE, 0x9400);
+
+	SIM_ResetCounters();
+	EXTI15_10_IRQHandler();
+	TEST_CHECK_EQ(SIM_GetReadCount(&EXTI->PR), 1);
+	TEST_CHECK_EQ(SIM_GetWriteCount(&EXTI->PR), 1);
+	TEST_CHECK_EQ(SIM_GetTotalAccesses(), 2);
+
+	// Higher lines first, each line once, nothing left pending
+	TEST_CHECK_EQ(OrderLen, 3);
+	TEST_CHECK_EQ(Order[0], 15);
+	TEST_CHECK_EQ(Order[1], 12);
+	TEST_CHECK_EQ(Order[2], 10);
+	TEST_CHECK_EQ(EXTI->PR & 0x9400U, 0);
+
+	// Nothing pending: one read, no write, no callback
+	SIM_ResetCounters();
+	EXTI15_10_IRQHandler();
+	TEST_CHECK_EQ(SIM_GetTotalAccesses(), 1);
+	TEST_CHECK_EQ(OrderLen, 3);
+
+	// Lines of another IRQ are not served
+	SIM_SetInputPort(GPIOE, 0x0000);
+	SIM_SetInputPort(GPIOE, 0x0400);
+	EXTI9_5_IRQHandler();
+	TEST_CHECK_EQ(Calls[10], 1);
+	TEST_CHECK_EQ(EXTI->PR & 0x0400U, 0x0400U);
+	EXTI15_10_IRQHandler();
+	TEST_CHECK_EQ(Calls[10], 2);
+
+	GPIO_DeInit(GPIOE);
+	GPIO_PeriClockDisable(GPIOE);
+}
+
+static void test_DispatchLatency(void)
+{
+	GPIO_PinConfig_t pin = Pin(12, GPIO_MODE_IT_RT);
+	uint64_t start, oneLine, noLine;
+
+	GPIO_PeriClockEnable(GPIOE);
+	TEST_CHECK_EQ(GPIO_InitPort(GPIOE, &pin, 1), GPIO_OK);
+	ClearCalls();
+
+	// Host time from a pending line to its callback, through the handler of 6 lines
+	start = TEST_NowNs();
+	for(uint32_t i = 0; i < DISPATCH_ROUNDS; i++)
+	{
+		REG_SET_BITS(EXTI->SWIER, 1U << 12);
+		EXTI15_10_IRQHandler();
+	}
+	oneLine = TEST_NowNs() - start;
+
+	start = TEST_NowNs();
+	for(uint32_t i = 0; i < DISPATCH_ROUNDS; i++)
+	{
+		EXTI15_10_IRQHandler();
+	}
+	noLine = TEST_NowNs() - start;
+
+	TEST_CHECK_EQ(EXTI->PR & (1U << 12), 0);
+	printf("    dispatch of a pending line %.1f ns (with the SWIER write), empty %.1f ns\n",
+			(double)oneLine / DISPATCH_ROUNDS, (double)noLine / DISPATCH_ROUNDS);
+
+	GPIO_DeInit(GPIOE);
+	GPIO_PeriClockDisable(GPIOE);
+}
+
+int main(void)
+{
+	TEST_RUN(test_PriorityStaysInItsField);
+	TEST_RUN(test_InputModeReleasesLine);
+	TEST_RUN(test_LineOfOtherPortIsKept);
+	TEST_RUN(test_DispatchOrderAndCost);
+	TEST_RUN(test_DispatchLatency);
+
+	TEST_EXIT();
+}
@@ -0,0 +1,186 @@
+/*
+ * test_gpio_port.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "test.h"
+
+// Clock control and reset of all nine GPIO ports, through the driver and the per-port macros.
+// The port bit is computed from the base address, so every port costs the same: the access
+// counts of port I must be those of port A, and with a constant port the clock id is folded
+// by the compiler.
+
+static GPIO_RegDef_t * const Ports[GPIO_PORT_COUNT] =
+{
+	GPIOA, GPIOB, GPIOC, GPIOD, GPIOE, GPIOF, GPIOG, GPIOH, GPIOI
+};
+
+// MODER after reset (ch. 8.4.1), port A and B have their debug pins in alternate function mode
+static uint32_t ResetMODER(uint32_t Port)
+{
+	return (Port == 0) ? 0xA8000000U : (Port == 1) ? 0x00000280U : 0;
+}
+
+static void MacroEnable(uint32_t Port)
+{
+	switch(Port)
+	{
+	case 0: GPIOA_PCLK_EN(); break;
+	case 1: GPIOB_PCLK_EN(); break;
+	case 2: GPIOC_PCLK_EN(); break;
+	case 3: GPIOD_PCLK_EN(); break;
+	case 4: GPIOE_PCLK_EN(); break;
+	case 5: GPIOF_PCLK_EN(); break;
+	case 6: GPIOG_PCLK_EN(); break;
+	case 7: GPIOH_PCLK_EN(); break;
+	case 8: GPIOI_PCLK_EN(); break;
+	}
+}
+
+static void MacroDisable(uint32_t Port)
+{
+	switch(Port)
+	{
+	case 0: GPIOA_PCLK_DI(); break;
+	case 1: GPIOB_PCLK_DI(); break;
+	case 2: GPIOC_PCLK_DI(); break;
+	case 3: GPIOD_PCLK_DI(); break;
+	case 4: GPIOE_PCLK_DI(); break;
+	case 5: GPIOF_PCLK_DI(); break;
+	case 6: GPIOG_PCLK_DI(); break;
+	case 7: GPIOH_PCLK_DI(); break;
+	case 8: GPIOI_PCLK_DI(); break;
+	}
+}
+
+static void MacroReset(uint32_t Port)
+{
+	switch(Port)
+	{
+	case 0: GPIOA_REG_RESET(); break;
+	case 1: GPIOB_REG_RESET(); break;
+	case 2: GPIOC_REG_RESET(); break;
+	case 3: GPIOD_REG_RESET(); break;
+	case 4: GPIOE_REG_RESET(); break;
+	case 5: GPIOF_REG_RESET(); break;
+	case 6: GPIOG_REG_RESET(); break;
+	case 7: GPIOH_REG_RESET(); break;
+	case 8: GPIOI_REG_RESET(); break;
+	}
+}
+
+static void test_PortCodes(void)
+{
+	for(uint32_t i = 0; i < GPIO_PORT_COUNT; i++)
+	{
+		TEST_CHECK_EQ(GPIO_BASEADDR_TO_CODE(Ports[i]), i);
+		TEST_CHECK_EQ(RCC_CLK_GPIO(Ports[i]), RCC_CLK_GPIOA + i);
+	}
+
+	// No code is left at run time for a constant port
+	TEST_CHECK(__builtin_constant_p(GPIO_BASEADDR_TO_CODE(GPIOI)));
+	TEST_CHECK(__builtin_constant_p(RCC_CLK_GPIO(GPIOI)));
+}
+
+static void test_PeriClockControlAllPorts(void)
+{
+	uint32_t enableAccesses = 0, disableAccesses = 0;
+
+	for(uint32_t i = 0; i < GPIO_PORT_COUNT; i++)
+	{
+		uint8_t users = RCC_PeriphClockUsers(RCC_CLK_GPIO(Ports[i]));
+
+		SIM_ResetCounters();
+		GPIO_PeriClockControl(Ports[i], ENABLE);
+		TEST_CHECK_EQ(RCC->AHB1ENR & 0x1FFU, 1U << i);		// Its own bit and no other
+		TEST_CHECK_EQ(RCC_PeriphClockUsers(RCC_CLK_GPIO(Ports[i])), users + 1);
+		if(i == 0)
+		{
+			enableAccesses = SIM_GetTotalAccesses();
+		}
+		TEST_CHECK_EQ(SIM_GetTotalAccesses(), enableAccesses);
+
+		SIM_ResetCounters();
+		GPIO_PeriClockControl(Ports[i], DISABLE);
+		TEST_CHECK_EQ(RCC->AHB1ENR & 0x1FFU, 0);
+		TEST_CHECK_EQ(RCC_PeriphClockUsers(RCC_CLK_GPIO(Ports[i])), users);
+		if(i == 0)
+		{
+			disableAccesses = SIM_GetTotalAccesses();
+		}
+		TEST_CHECK_EQ(SIM_GetTotalAccesses(), disableAccesses);
+	}
+
+	// Not a port: nothing happens
+	SIM_ResetCounters();
+	GPIO_PeriClockControl((GPIO_RegDef_t*)RCC, ENABLE);
+	TEST_CHECK_EQ(SIM_GetTotalAccesses(), 0);
+}
+
+static void test_DeInitAllPorts(void)
+{
+	uint32_t resetAccesses = 0;
+
+	for(uint32_t i = 0; i < GPIO_PORT_COUNT; i++)
+	{
+		GPIO_RegDef_t *pGPIOx = Ports[i];
+
+		GPIO_PeriClockEnable(pGPIOx);
+		REG_WRITE(pGPIOx->MODER, 0x55555555U);
+		REG_WRITE(pGPIOx->PUPDR, 0x11111111U);
+		REG_WRITE(pGPIOx->ODR, 0xBEEF);
+
+		SIM_ResetCounters();
+		GPIO_DeInit(pGPIOx);
+		TEST_CHECK_EQ(pGPIOx->MODER, ResetMODER(i));
+		TEST_CHECK_EQ(pGPIOx->ODR, 0);
+		TEST_CHECK_EQ(RCC->AHB1RSTR, 0);					// Reset released again
+		if(i == 0)
+		{
+			resetAccesses = SIM_GetTotalAccesses();
+		}
+		TEST_CHECK_EQ(SIM_GetTotalAccesses(), resetAccesses);
+
+		// The other ports are not reset
+		if(i > 0)
+		{
+			TEST_CHECK_EQ(Ports[i - 1]->MODER, ResetMODER(i - 1));
+			GPIO_PeriClockEnable(Ports[i - 1]);
+			REG_WRITE(Ports[i - 1]->ODR, 0x1234);
+			GPIO_DeInit(pGPIOx);
+			TEST_CHECK_EQ(Ports[i - 1]->ODR, 0x1234);
+			GPIO_PeriClockDisable(Ports[i - 1]);
+		}
+
+		GPIO_PeriClockDisable(pGPIOx);
+	}
+}
+
+static void test_MacrosAllPorts(void)
+{
+	for(uint32_t i = 0; i < GPIO_PORT_COUNT; i++)
+	{
+		MacroEnable(i);
+		TEST_CHECK_EQ(RCC->AHB1ENR & 0x1FFU, 1U << i);
+
+		REG_WRITE(Ports[i]->MODER, 0x55555555U);
+		MacroReset(i);
+		TEST_CHECK_EQ(Ports[i]->MODER, ResetMODER(i));
+		TEST_CHECK_EQ(RCC->AHB1RSTR, 0);
+
+		MacroDisable(i);
+		TEST_CHECK_EQ(RCC->AHB1ENR & 0x1FFU, 0);
+	}
+}
+
+int main(void)
+{
+	TEST_RUN(test_PortCodes);
+	TEST_RUN(test_PeriClockControlAllPorts);
+	TEST_RUN(test_DeInitAllPorts);
+	TEST_RUN(test_MacrosAllPorts);
+
+	TEST_EXIT();
+}
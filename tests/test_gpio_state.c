@@ -0,0 +1,180 @@
+/*
+ * test_gpio_state.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include "test.h"
+
+// GPIO_SaveState / GPIO_RestoreState from several threads at once, as main code and
+// interrupts would use them on the chip. On port D one thread cycles the configuration through
+// three states (a restore, a GPIO_SetPinModes on half of the pins, a restore back), a reader
+// saves the state all the time and must only ever see one of the three whole, never a mix, and
+// two threads drive the outputs through BSRR, which the restores must leave alone. On port E
+// two threads change the modes of their own half of the pins, neither may lose the other's
+// change. The threads yield after each call, so they interleave on a single core too.
+
+#define ROUNDS			20000
+#define LOW_PINS		0x00FFU
+#define HIGH_PINS		0xFF00U
+
+// Pins 8 - 15 are outputs in every state, pins 0 - 7 change everything but the output level
+static const GPIO_PortState_t Base =
+{
+	.MODER = 0x55550000U, .OTYPER = 0, .OSPEEDR = 0, .PUPDR = 0x00005555U, .AFR = { 0, 0 }
+};
+static const GPIO_PortState_t Alt =
+{
+	.MODER = 0x5555AAAAU, .OTYPER = 0x00FFU, .OSPEEDR = 0x0000FFFFU, .PUPDR = 0x0000AAAAU, .AFR = { 0x77777777U, 0 }
+};
+static const GPIO_PortState_t Mid =
+{
+	.MODER = 0x55555555U, .OTYPER = 0x00FFU, .OSPEEDR = 0x0000FFFFU, .PUPDR = 0x0000AAAAU, .AFR = { 0x77777777U, 0 }
+};
+
+static volatile uint8_t Running;
+static uint32_t Errors[6];
+
+static uint8_t Same(const GPIO_PortState_t *pA, const GPIO_PortState_t *pB)
+{
+	return memcmp(pA, pB, sizeof(GPIO_PortState_t)) == 0;
+}
+
+// The only thread that changes the configuration of port D, every step is checked right away
+static void *Cycler(void *pArg)
+{
+	GPIO_PortState_t state;
+
+	(void)pArg;
+	for(uint32_t i = 0; i < ROUNDS; i++)
+	{
+		GPIO_RestoreState(GPIOD, &Alt);
+		GPIO_SaveState(GPIOD, &state);
+		Errors[0] += !Same(&state, &Alt);
+		sched_yield();
+
+		GPIO_SetPinModes(GPIOD, LOW_PINS, GPIO_MODE_OUT);
+		GPIO_SaveState(GPIOD, &state);
+		Errors[0] += !Same(&state, &Mid);
+		sched_yield();
+
+		GPIO_RestoreState(GPIOD, &Base);
+		GPIO_SaveState(GPIOD, &state);
+		Errors[0] += !Same(&state, &Base);
+		sched_yield();
+	}
+	Running = 0;
+
+	return NULL;
+}
+
+static void *Reader(void *pArg)
+{
+	GPIO_PortState_t state;
+
+	(void)pArg;
+	while(Running)
+	{
+		GPIO_SaveState(GPIOD, &state);
+		Errors[1] += !Same(&state, &Base) && !Same(&state, &Alt) && !Same(&state, &Mid);
+		sched_yield();
+	}
+
+	return NULL;
+}
+
+// Drives four output pins of port D, each write must read back whatever the others do
+static void *Driver(void *pArg)
+{
+	uintptr_t n = (uintptr_t)pArg;
+	uint16_t mask = (uint16_t)(0xFU << (8 + 4 * n));
+
+	for(uint32_t i = 0; Running; i++)
+	{
+		uint16_t value = (uint16_t)((i * 0x1111U) ^ (0x5A5AU * n));
+
+		GPIO_WriteMasked(GPIOD, mask, value);
+		Errors[2 + n] += (GPIOD->ODR & mask) != (value & mask);
+		sched_yield();
+	}
+
+	return NULL;
+}
+
+// Changes the modes of its half of port E, the other half must keep what its thread set
+static void *Mover(void *pArg)
+{
+	uintptr_t n = (uintptr_t)pArg;
+	uint16_t pins = n ? HIGH_PINS : LOW_PINS;
+	uint32_t field = n ? 0xFFFF0000U : 0x0000FFFFU;
+	GPIO_PortState_t state;
+
+	for(uint32_t i = 0; Running; i++)
+	{
+		uint8_t mode = (uint8_t)((i + n) % 4);
+
+		GPIO_SetPinModes(GPIOE, pins, mode);
+		GPIO_SaveState(GPIOE, &state);
+		Errors[4 + n] += (state.MODER & field) != ((0x55555555U * mode) & field);
+		sched_yield();
+	}
+	GPIO_SetPinModes(GPIOE, pins, n ? GPIO_MODE_ANALOG : GPIO_MODE_OUT);
+
+	return NULL;
+}
+
+static void test_ConcurrentSaveRestore(void)
+{
+	pthread_t threads[6];
+	GPIO_PortState_t state;
+
+	GPIO_PeriClockEnable(GPIOD);
+	GPIO_PeriClockEnable(GPIOE);
+	GPIO_ResyncState(GPIOD);
+	GPIO_ResyncState(GPIOE);
+	GPIO_RestoreState(GPIOD, &Base);
+	Running = 1;
+
+	pthread_create(&threads[0], NULL, Cycler, NULL);
+	pthread_create(&threads[1], NULL, Reader, NULL);
+	pthread_create(&threads[2], NULL, Driver, (void*)0);
+	pthread_create(&threads[3], NULL, Driver, (void*)1);
+	pthread_create(&threads[4], NULL, Mover, (void*)0);
+	pthread_create(&threads[5], NULL, Mover, (void*)1);
+	for(uint32_t i = 0; i < 6; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	TEST_CHECK_EQ(Errors[0], 0);
+	TEST_CHECK_EQ(Errors[1], 0);
+	TEST_CHECK_EQ(Errors[2] + Errors[3], 0);
+	TEST_CHECK_EQ(Errors[4] + Errors[5], 0);
+
+	// The registers hold the last state, and the shadow agrees with them
+	GPIO_SaveState(GPIOD, &state);
+	TEST_CHECK(Same(&state, &Base));
+	TEST_CHECK_EQ(GPIOD->MODER, Base.MODER);
+	TEST_CHECK_EQ(GPIOD->OTYPER, Base.OTYPER);
+	TEST_CHECK_EQ(GPIOD->OSPEEDR, Base.OSPEEDR);
+	TEST_CHECK_EQ(GPIOD->PUPDR, Base.PUPDR);
+	TEST_CHECK_EQ(GPIOD->AFR[0], Base.AFR[0]);
+	TEST_CHECK_EQ(GPIOE->MODER, 0xFFFF5555U);
+	GPIO_ResyncState(GPIOE);
+	GPIO_SaveState(GPIOE, &state);
+	TEST_CHECK_EQ(state.MODER, 0xFFFF5555U);
+
+	GPIO_PeriClockDisable(GPIOD);
+	GPIO_PeriClockDisable(GPIOE);
+}
+
+int main(void)
+{
+	TEST_RUN(test_ConcurrentSaveRestore);
+
+	TEST_EXIT();
+}
@@ -0,0 +1,396 @@
+/*
+ * test_i2c.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <string.h>
+#include "test.h"
+
+// Reads through the transaction queue with the slave played by the test: ADDR is set in SR1
+// after the address, the bytes come in through SIM_I2CReceive as fast as the master takes
+// them. Short reads by interrupt, long ones by DMA, and the DMA streams of the I2Cs and their
+// ownership. Then writes, register reads (write, repeated start, read), NACKs and bus errors
+// and transactions chained from the callbacks, against a scripted slave (Slave_t).
+
+static uint8_t Data[64];
+static uint8_t Rx[64];
+
+// Slave of the scripted tests. It logs the address bytes and the bytes written, answers reads
+// from Data up to the byte the master NACKs (the length of the read), NACKs the address NackAddress and signals a bus error at the data byte ErrorAt
+// (counted from 1, 0 never).
+typedef struct
+{
+	uint8_t NackAddress;
+	uint8_t ErrorAt;
+	uint8_t Addresses[8];
+	uint8_t AddressCount;
+	uint8_t Written[32];
+	uint8_t WrittenCount;
+	uint8_t Reading;
+	uint8_t Sent;
+	uint16_t ReadLen;
+}Slave_t;
+
+// Transactions in the order they ended, with the bus state the callback saw
+static I2C_Transaction_t *Ended[8];
+static uint8_t EndedBusy[8];
+static uint8_t EndedCount;
+
+static void Foreign(void *pArg, uint8_t Flags)
+{
+	(void)pArg;
+	(void)Flags;
+}
+
+static void Setup(I2C_Handle_t *pHandle, I2C_RegDef_t *pI2Cx, uint16_t DMAMinLen)
+{
+	memset(pHandle, 0, sizeof(*pHandle));
+	pHandle->pI2Cx = pI2Cx;
+	pHandle->I2CConfig.I2C_SCLSpeed = I2C_SCL_SPEED_FM;
+	pHandle->IRQPriority = 7;
+	pHandle->DMAMinLen = DMAMinLen;
+}
+
+// Start, address and ADDR of a read
+static void PlayAddress(I2C_Handle_t *pHandle)
+{
+	I2C_EV_IRQHandling(pHandle);			// SB: the address is written
+	pHandle->pI2Cx->SR1 |= (1U << I2C_SR1_ADDR);
+	I2C_EV_IRQHandling(pHandle);
+}
+
+// The bytes of a read by interrupt, returns the number of interrupts
+static uint32_t PlayRead(I2C_Handle_t *pHandle, uint16_t Len)
+{
+	uint32_t sent = 0, irqs = 0;
+
+	PlayAddress(pHandle);
+	while( !I2C_IsIdle(pHandle) && (irqs < 4U * Len + 8U) )
+	{
+		if( (sent < Len) && SIM_I2CReceive(pHandle->pI2Cx, Data[sent]) )
+		{
+			sent++;
+		}
+		I2C_EV_IRQHandling(pHandle);
+		irqs++;
+	}
+
+	return irqs;
+}
+
+// Runs the event and error interrupts until the queue is empty, with the slave answering each
+// step. A data byte written to DR is taken at once (TXE again) and every second one also goes
+// out of the shift register before the interrupt comes (TXE and BTF together, so the next byte
+// is written at BTF). After the last byte the master waits for BTF.
+static void RunSlave(I2C_Handle_t *pHandle, Slave_t *pSlave)
+{
+	I2C_RegDef_t *pI2Cx = pHandle->pI2Cx;
+
+	for(uint32_t irqs = 0; !I2C_IsIdle(pHandle) && (irqs < 200); irqs++)
+	{
+		uint32_t sr1 = pI2Cx->SR1;
+		uint32_t writes = SIM_GetWriteCount(&pI2Cx->DR);
+
+		if( pSlave->Reading && (pSlave->Sent < pSlave->ReadLen) && SIM_I2CReceive(pI2Cx, Data[pSlave->Sent]) )
+		{
+			pSlave->Sent++;
+		}
+		I2C_EV_IRQHandling(pHandle);
+
+		if(SIM_GetWriteCount(&pI2Cx->DR) != writes)
+		{
+			uint8_t byte = (uint8_t)pI2Cx->DR;
+
+			if(sr1 & (1U << I2C_SR1_SB))
+			{
+				pSlave->Addresses[pSlave->AddressCount++] = byte;
+				if((byte >> 1) == pSlave->NackAddress)
+				{
+					pI2Cx->SR1 |= (1U << I2C_SR1_AF);
+					I2C_ER_IRQHandling(pHandle);
+					continue;
+				}
+				pSlave->Reading = byte & 1U;
+				pSlave->Sent = 0;
+				pSlave->ReadLen = pHandle->pHead->RxLen;
+				pI2Cx->SR1 |= (1U << I2C_SR1_ADDR) | (pSlave->Reading ? 0 : (1U << I2C_SR1_TXE));
+			}
+			else
+			{
+				pSlave->Written[pSlave->WrittenCount++] = byte;
+				if(pSlave->WrittenCount == pSlave->ErrorAt)
+				{
+					pI2Cx->SR1 |= (1U << I2C_SR1_BERR);
+					I2C_ER_IRQHandling(pHandle);
+					continue;
+				}
+				pI2Cx->SR1 |= (1U << I2C_SR1_TXE) | ((pSlave->WrittenCount & 1U) ? (1U << I2C_SR1_BTF) : 0);
+			}
+		}
+		else if( !pSlave->Reading && (pI2Cx->SR1 & (1U << I2C_SR1_TXE)) && !(pI2Cx->CR2 & (1U << I2C_CR2_ITBUFEN)) )
+		{
+			pI2Cx->SR1 |= (1U << I2C_SR1_BTF);
+		}
+	}
+}
+
+static void Ends(I2C_Transaction_t *pTxn, void *pArg)
+{
+	I2C_Handle_t *pHandle = (I2C_Handle_t*)pArg;
+
+	Ended[EndedCount] = pTxn;
+	EndedBusy[EndedCount] = (pHandle->pI2Cx->SR2 & (1U << I2C_SR2_BUSY)) != 0;
+	EndedCount++;
+}
+
+static void test_ReadByInterrupt(void)
+{
+	static const uint16_t lengths[] = { 1, 2, 3, 4, 5, 17 };
+	I2C_Handle_t handle;
+
+	Setup(&handle, I2C1, 0);
+	TEST_CHECK_EQ(I2C_Init(&handle), I2C_OK);
+	TEST_CHECK(handle.pDMAx == NULL);
+
+	for(uint32_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+	{
+		I2C_Transaction_t txn = { .Address = 0x50, .pRxBuffer = Rx, .RxLen = lengths[i] };
+
+		memset(Rx, 0, sizeof(Rx));
+		TEST_CHECK_EQ(I2C_Submit(&handle, &txn), I2C_OK);
+		TEST_CHECK(I2C1->SR1 & (1U << I2C_SR1_SB));
+		PlayRead(&handle, lengths[i]);
+		TEST_CHECK_EQ(txn.Status, I2C_TXN_DONE);
+		TEST_CHECK(memcmp(Rx, Data, lengths[i]) == 0);
+		TEST_CHECK_EQ(I2C1->SR2 & (1U << I2C_SR2_BUSY), 0);		// STOP sent
+	}
+
+	I2C_DeInit(I2C1);
+}
+
+static void test_ReadByDMA(void)
+{
+	I2C_Transaction_t txn = { .Address = 0x68, .pRxBuffer = Rx, .RxLen = 16 };
+	I2C_Handle_t handle;
+
+	Setup(&handle, I2C1, 8);
+	TEST_CHECK_EQ(I2C_Init(&handle), I2C_OK);
+	TEST_CHECK(handle.pDMAx == DMA1);
+	TEST_CHECK_EQ(handle.RxStream, 0);
+
+	TEST_CHECK_EQ(I2C_Submit(&handle, &txn), I2C_OK);
+	PlayAddress(&handle);
+	TEST_CHECK(I2C1->CR2 & (1U << I2C_CR2_DMAEN));
+	TEST_CHECK(I2C1->CR2 & (1U << I2C_CR2_LAST));
+	TEST_CHECK(DMA1->S[0].CR & DMA_SxCR_EN);
+	TEST_CHECK_EQ(DMA_GetRemaining(DMA1, 0), 16);
+
+	SIM_DMAComplete(DMA1, 0);
+	DMA1_Stream0_IRQHandler();
+	TEST_CHECK_EQ(txn.Status, I2C_TXN_DONE);
+	TEST_CHECK(I2C_IsIdle(&handle));
+	TEST_CHECK_EQ(I2C1->CR2 & (1U << I2C_CR2_DMAEN), 0);
+
+	I2C_DeInit(I2C1);
+}
+
+// I2C2 on stream 3 and I2C3 on stream 2 work together
+static void test_DMAMap(void)
+{
+	I2C_Handle_t handle2, handle3;
+
+	Setup(&handle2, I2C2, 4);
+	Setup(&handle3, I2C3, 4);
+	TEST_CHECK_EQ(I2C_Init(&handle2), I2C_OK);
+	TEST_CHECK_EQ(I2C_Init(&handle3), I2C_OK);
+	TEST_CHECK_EQ(handle2.RxStream, 3);
+	TEST_CHECK_EQ(handle2.DMAChannel, 7);
+	TEST_CHECK_EQ(handle3.RxStream, 2);
+	TEST_CHECK_EQ(handle3.DMAChannel, 3);
+	TEST_CHECK(handle2.pDMAx == DMA1);
+	TEST_CHECK(handle3.pDMAx == DMA1);
+	I2C_DeInit(I2C2);
+	I2C_DeInit(I2C3);
+}
+
+// I2C2 RX shares DMA1 stream 3 with SPI2 RX and USART3 TX: long reads go by interrupt
+static void test_StreamInUse(void)
+{
+	I2C_Transaction_t txn = { .Address = 0x1E, .pRxBuffer = Rx, .RxLen = 12 };
+	I2C_Handle_t handle;
+
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 3, Foreign, NULL), DMA_OK);
+
+	Setup(&handle, I2C2, 4);
+	TEST_CHECK_EQ(I2C_Init(&handle), I2C_ERR_BUSY);
+	TEST_CHECK(handle.pDMAx == NULL);
+
+	memset(Rx, 0, sizeof(Rx));
+	TEST_CHECK_EQ(I2C_Submit(&handle, &txn), I2C_OK);
+	PlayRead(&handle, 12);
+	TEST_CHECK_EQ(txn.Status, I2C_TXN_DONE);
+	TEST_CHECK(memcmp(Rx, Data, 12) == 0);
+	TEST_CHECK_EQ(I2C2->CR2 & (1U << I2C_CR2_DMAEN), 0);
+	I2C_DeInit(I2C2);
+
+	// Stream given back: the I2C takes it and keeps it until I2C_DeInit
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 3, NULL, NULL), DMA_OK);
+	Setup(&handle, I2C2, 4);
+	TEST_CHECK_EQ(I2C_Init(&handle), I2C_OK);
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 3, Foreign, NULL), DMA_ERR_BUSY);
+	I2C_DeInit(I2C2);
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 3, Foreign, NULL), DMA_OK);
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 3, NULL, NULL), DMA_OK);
+}
+
+// Writes of 1 - 5 bytes, the bytes after the first alternately at TXE and at BTF
+static void test_Write(void)
+{
+	static const uint8_t bytes[5] = { 0x10, 0x20, 0x30, 0x40, 0x50 };
+	I2C_Handle_t handle;
+
+	Setup(&handle, I2C1, 0);
+	TEST_CHECK_EQ(I2C_Init(&handle), I2C_OK);
+	for(uint8_t len = 1; len <= 5; len++)
+	{
+		I2C_Transaction_t txn = { .Address = 0x3C, .pTxBuffer = bytes, .TxLen = len, .pCallback = Ends, .pArg = &handle };
+		Slave_t slave = { 0 };
+
+		EndedCount = 0;
+		TEST_CHECK_EQ(I2C_Submit(&handle, &txn), I2C_OK);
+		RunSlave(&handle, &slave);
+		TEST_CHECK_EQ(txn.Status, I2C_TXN_DONE);
+		TEST_CHECK_EQ(slave.AddressCount, 1);
+		TEST_CHECK_EQ(slave.Addresses[0], 0x3C << 1);
+		TEST_CHECK_EQ(slave.WrittenCount, len);
+		TEST_CHECK(memcmp(slave.Written, bytes, len) == 0);
+		TEST_CHECK_EQ(EndedCount, 1);
+		TEST_CHECK_EQ(EndedBusy[0], 0);							// STOP before the callback
+	}
+	I2C_DeInit(I2C1);
+}
+
+// Register reads: the register number, a repeated start and the address with R/W = 1
+static void test_WriteThenRead(void)
+{
+	static const uint8_t reg[2] = { 0x75, 0x01 };
+	static const uint16_t lengths[] = { 1, 2, 3, 6 };
+	I2C_Handle_t handle;
+
+	Setup(&handle, I2C1, 0);
+	TEST_CHECK_EQ(I2C_Init(&handle), I2C_OK);
+	for(uint32_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+	{
+		I2C_Transaction_t txn = { .Address = 0x68, .pTxBuffer = reg, .TxLen = (uint16_t)(1 + (i & 1U)),
+								  .pRxBuffer = Rx, .RxLen = lengths[i] };
+		Slave_t slave = { 0 };
+
+		memset(Rx, 0, sizeof(Rx));
+		TEST_CHECK_EQ(I2C_Submit(&handle, &txn), I2C_OK);
+		RunSlave(&handle, &slave);
+		TEST_CHECK_EQ(txn.Status, I2C_TXN_DONE);
+		TEST_CHECK_EQ(slave.AddressCount, 2);
+		TEST_CHECK_EQ(slave.Addresses[0], 0x68 << 1);
+		TEST_CHECK_EQ(slave.Addresses[1], (0x68 << 1) | 1U);
+		TEST_CHECK_EQ(slave.WrittenCount, 1 + (i & 1U));
+		TEST_CHECK(memcmp(slave.Written, reg, slave.WrittenCount) == 0);
+		TEST_CHECK(memcmp(Rx, Data, lengths[i]) == 0);
+		TEST_CHECK_EQ(handle.Phase, I2C_PHASE_READ);
+		TEST_CHECK_EQ(I2C1->SR2 & (1U << I2C_SR2_BUSY), 0);
+	}
+	I2C_DeInit(I2C1);
+}
+
+// An address NACK and a bus error end their transaction with a STOP, the queue goes on
+static void test_Errors(void)
+{
+	static const uint8_t bytes[4] = { 1, 2, 3, 4 };
+	I2C_Transaction_t absent = { .Address = 0x21, .pTxBuffer = bytes, .TxLen = 1, .pCallback = Ends };
+	I2C_Transaction_t broken = { .Address = 0x22, .pTxBuffer = bytes, .TxLen = 4, .pCallback = Ends };
+	I2C_Transaction_t fine = { .Address = 0x23, .pRxBuffer = Rx, .RxLen = 2, .pCallback = Ends };
+	Slave_t slave = { .NackAddress = 0x21, .ErrorAt = 2 };
+	I2C_Handle_t handle;
+
+	Setup(&handle, I2C1, 0);
+	TEST_CHECK_EQ(I2C_Init(&handle), I2C_OK);
+	absent.pArg = broken.pArg = fine.pArg = &handle;
+	EndedCount = 0;
+	TEST_CHECK_EQ(I2C_Submit(&handle, &absent), I2C_OK);
+	TEST_CHECK_EQ(I2C_Submit(&handle, &broken), I2C_OK);
+	TEST_CHECK_EQ(I2C_Submit(&handle, &fine), I2C_OK);
+	RunSlave(&handle, &slave);
+
+	TEST_CHECK_EQ(absent.Status, I2C_TXN_ERROR_NACK);
+	TEST_CHECK_EQ(broken.Status, I2C_TXN_ERROR_BUS);
+	TEST_CHECK_EQ(fine.Status, I2C_TXN_DONE);
+	TEST_CHECK_EQ(EndedCount, 3);
+	TEST_CHECK_EQ(EndedBusy[0] + EndedBusy[1] + EndedBusy[2], 0);
+	TEST_CHECK_EQ(slave.WrittenCount, 2);						// Nothing after the error
+	TEST_CHECK_EQ(I2C1->SR1 & ((1U << I2C_SR1_AF) | (1U << I2C_SR1_BERR)), 0);
+	TEST_CHECK(I2C_IsIdle(&handle));
+	I2C_DeInit(I2C1);
+}
+
+// Several sensors back to back: the callback of each one submits the next
+static I2C_Transaction_t Sensors[4];
+
+static void NextSensor(I2C_Transaction_t *pTxn, void *pArg)
+{
+	Ends(pTxn, pArg);
+	if(pTxn < &Sensors[3])
+	{
+		TEST_CHECK_EQ(I2C_Submit((I2C_Handle_t*)pArg, pTxn + 1), I2C_OK);
+	}
+}
+
+static void test_ChainFromCallback(void)
+{
+	static const uint8_t reg[1] = { 0x28 };
+	static uint8_t rx[4][6];
+	Slave_t slave = { 0 };
+	I2C_Handle_t handle;
+
+	Setup(&handle, I2C1, 0);
+	TEST_CHECK_EQ(I2C_Init(&handle), I2C_OK);
+	for(uint8_t i = 0; i < 4; i++)
+	{
+		Sensors[i] = (I2C_Transaction_t){ .Address = (uint8_t)(0x40 + i), .pTxBuffer = reg, .TxLen = 1,
+										  .pRxBuffer = rx[i], .RxLen = (uint16_t)(i + 3), .pCallback = NextSensor, .pArg = &handle };
+	}
+	EndedCount = 0;
+	TEST_CHECK_EQ(I2C_Submit(&handle, &Sensors[0]), I2C_OK);
+	RunSlave(&handle, &slave);
+
+	TEST_CHECK_EQ(EndedCount, 4);
+	TEST_CHECK_EQ(slave.AddressCount, 8);
+	for(uint8_t i = 0; i < 4; i++)
+	{
+		TEST_CHECK(Ended[i] == &Sensors[i]);
+		TEST_CHECK_EQ(Sensors[i].Status, I2C_TXN_DONE);
+		TEST_CHECK_EQ(slave.Addresses[2 * i + 1], ((0x40 + i) << 1) | 1U);
+		TEST_CHECK(memcmp(rx[i], Data, i + 3U) == 0);
+	}
+	TEST_CHECK(I2C_IsIdle(&handle));
+	I2C_DeInit(I2C1);
+}
+
+int main(void)
+{
+	for(uint32_t i = 0; i < sizeof(Data); i++)
+	{
+		Data[i] = (uint8_t)(0xA0 + i);
+	}
+
+	TEST_RUN(test_ReadByInterrupt);
+	TEST_RUN(test_ReadByDMA);
+	TEST_RUN(test_DMAMap);
+	TEST_RUN(test_StreamInUse);
+	TEST_RUN(test_Write);
+	TEST_RUN(test_WriteThenRead);
+	TEST_RUN(test_Errors);
+	TEST_RUN(test_ChainFromCallback);
+
+	TEST_EXIT();
+}
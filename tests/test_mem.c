@@ -0,0 +1,111 @@
+/*
+ * test_mem.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "test.h"
+
+// MEM_CopyWords and MEM_ZeroWords on every length from 0 to past a few eight word blocks and
+// on some long ones, from every word offset of an eight word block. The words around the
+// destination are guards: a function that writes one word too many or too few fails them.
+
+#define MAX_WORDS		1024
+#define GUARD			0xDEADBEEFU
+#define GUARD_WORDS		4
+
+static uint32_t Src[MAX_WORDS + 8];
+static uint32_t Dst[GUARD_WORDS + 8 + MAX_WORDS + GUARD_WORDS];
+
+static const uint32_t Lengths[] = { 0, 1, 2, 3, 7, 8, 9, 15, 16, 17, 23, 24, 25, 31, 32, 33, 63, 64, 65, 255, 256, 1000, MAX_WORDS };
+
+static void Fill(void)
+{
+	for(uint32_t i = 0; i < sizeof(Src) / sizeof(Src[0]); i++)
+	{
+		Src[i] = i * 0x9E3779B9U + 1U;				// No zero words
+	}
+	for(uint32_t i = 0; i < sizeof(Dst) / sizeof(Dst[0]); i++)
+	{
+		Dst[i] = GUARD;
+	}
+}
+
+// Words written wrong or not at all, and guards changed, when Words words were written at Dst + Offset
+static uint32_t Check(uint32_t Offset, uint32_t Words, const uint32_t *pExpected)
+{
+	uint32_t failures = 0;
+
+	for(uint32_t i = 0; i < sizeof(Dst) / sizeof(Dst[0]); i++)
+	{
+		uint32_t first = GUARD_WORDS + Offset;
+
+		if( (i >= first) && (i < first + Words) )
+		{
+			failures += Dst[i] != (pExpected ? pExpected[i - first] : 0);
+		}
+		else
+		{
+			failures += Dst[i] != GUARD;
+		}
+	}
+
+	return failures;
+}
+
+static void test_CopyWords(void)
+{
+	uint32_t failures = 0;
+
+	for(uint32_t l = 0; l < sizeof(Lengths) / sizeof(Lengths[0]); l++)
+	{
+		for(uint32_t dst = 0; dst < 8; dst++)
+		{
+			for(uint32_t src = 0; src < 8; src += 3)
+			{
+				Fill();
+				MEM_CopyWords(&Dst[GUARD_WORDS + dst], &Src[src], Lengths[l]);
+				if(Check(dst, Lengths[l], &Src[src]) != 0)
+				{
+					printf("  %u words, destination offset %u, source offset %u\n", (unsigned)Lengths[l], (unsigned)dst, (unsigned)src);
+					failures++;
+				}
+			}
+		}
+	}
+	TEST_CHECK_EQ(failures, 0);
+
+	// The source is only read
+	Fill();
+	MEM_CopyWords(&Dst[GUARD_WORDS], Src, MAX_WORDS);
+	TEST_CHECK_EQ(Src[MAX_WORDS - 1], (MAX_WORDS - 1) * 0x9E3779B9U + 1U);
+}
+
+static void test_ZeroWords(void)
+{
+	uint32_t failures = 0;
+
+	for(uint32_t l = 0; l < sizeof(Lengths) / sizeof(Lengths[0]); l++)
+	{
+		for(uint32_t dst = 0; dst < 8; dst++)
+		{
+			Fill();
+			MEM_ZeroWords(&Dst[GUARD_WORDS + dst], Lengths[l]);
+			if(Check(dst, Lengths[l], NULL) != 0)
+			{
+				printf("  %u words, offset %u\n", (unsigned)Lengths[l], (unsigned)dst);
+				failures++;
+			}
+		}
+	}
+	TEST_CHECK_EQ(failures, 0);
+}
+
+int main(void)
+{
+	TEST_RUN(test_CopyWords);
+	TEST_RUN(test_ZeroWords);
+
+	TEST_EXIT();
+}
@@ -0,0 +1,246 @@
+/*
+ * test_patgen.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "test.h"
+
+// Pattern generator on a host model of its DMA stream: the words of the current target are
+// stored to BSRR one by one, as the timer requests would do, then the end of the buffer is
+// played with SIM_DMAComplete and the stream interrupt is served.
+
+#define LENGTH		8
+#define PINS		0x00FFU
+
+static uint32_t Buffer[2][LENGTH];
+static uint16_t Levels[LENGTH];
+static uint32_t Refills;
+static uint16_t NextLevel;
+
+static void FillLevels(uint32_t *pBuffer, uint16_t Start)
+{
+	for(uint16_t i = 0; i < LENGTH; i++)
+	{
+		Levels[i] = (uint16_t)(Start + i);
+	}
+	PATGEN_Encode(pBuffer, Levels, LENGTH, PINS);
+}
+
+static void Refill(uint32_t *pBuffer, uint16_t Length, void *pArg)
+{
+	(void)pArg;
+	TEST_CHECK_EQ(Length, LENGTH);
+	FillLevels(pBuffer, NextLevel);
+	NextLevel += LENGTH;
+	Refills++;
+}
+
+static void Setup(PATGEN_Handle_t *pHandle, TIM_RegDef_t *pTIMx, uint8_t Mode)
+{
+	*pHandle = (PATGEN_Handle_t){ 0 };
+	pHandle->Config.pGPIOx = GPIOD;
+	pHandle->Config.pTIMx = pTIMx;
+	pHandle->Config.TimerClockHz = 168000000U;
+	pHandle->Config.SampleRateHz = 4000000U;
+	pHandle->Config.pBuffer[0] = Buffer[0];
+	pHandle->Config.pBuffer[1] = Buffer[1];
+	pHandle->Config.Length = LENGTH;
+	pHandle->Config.Mode = Mode;
+	pHandle->Config.IRQPriority = 5;
+}
+
+// Plays the buffer the stream reads from, returns the port levels after each word
+static void PlayBuffer(PATGEN_Handle_t *pHandle, uint16_t *pOut)
+{
+	uint8_t target = DMA_GetCurrentTarget(DMA2, pHandle->Stream);
+
+	for(uint16_t i = 0; i < LENGTH; i++)
+	{
+		REG_WRITE(GPIOD->BSRR, pHandle->Config.pBuffer[target][i]);
+		pOut[i] = (uint16_t)GPIOD->ODR;
+	}
+
+	SIM_DMAComplete(DMA2, pHandle->Stream);
+	if(DMA2->S[pHandle->Stream].CR & DMA_SxCR_TCIE)
+	{
+		DMA_IRQHandling(DMA2, pHandle->Stream);
+	}
+}
+
+static void CheckLevels(const uint16_t *pOut, uint16_t Start)
+{
+	for(uint16_t i = 0; i < LENGTH; i++)
+	{
+		TEST_CHECK_EQ(pOut[i], 0xAB00U | ((Start + i) & PINS));
+	}
+}
+
+static void test_Encode(void)
+{
+	uint16_t levels[3] = { 0x0001, 0x0002, 0xFFFF };
+	uint32_t out[3];
+
+	PATGEN_Encode(out, levels, 3, 0x0003);
+	TEST_CHECK_EQ(out[0], 0x00020001U);
+	TEST_CHECK_EQ(out[1], 0x00010002U);
+	TEST_CHECK_EQ(out[2], 0x00000003U);		// Pins outside the mask are never touched
+}
+
+static void test_InitRegisters(void)
+{
+	PATGEN_Handle_t handle;
+	DMA_Stream_RegDef_t *pStream;
+
+	Setup(&handle, TIM1, PATGEN_MODE_DOUBLE);
+	TEST_CHECK_EQ(PATGEN_Init(&handle), PATGEN_OK);
+	TEST_CHECK_EQ(handle.Stream, 5);
+	TEST_CHECK_EQ(handle.Channel, 6);
+	TEST_CHECK_EQ((TIM1->PSC + 1) * (TIM1->ARR + 1), 168000000U / 4000000U);
+
+	pStream = &DMA2->S[5];
+	TEST_CHECK_EQ((pStream->CR >> DMA_SxCR_CHSEL_POS) & 0x7U, 6);
+	TEST_CHECK_EQ((pStream->CR >> DMA_SxCR_DIR_POS) & 0x3U, DMA_DIR_M2P);
+	TEST_CHECK(pStream->CR & DMA_SxCR_DBM);
+	TEST_CHECK(pStream->CR & DMA_SxCR_CIRC);
+	TEST_CHECK(pStream->CR & DMA_SxCR_MINC);
+	TEST_CHECK(pStream->CR & DMA_SxCR_TCIE);
+	TEST_CHECK_EQ(pStream->PAR, (uint32_t)(uintptr_t)&GPIOD->BSRR);
+	TEST_CHECK_EQ(pStream->NDTR, LENGTH);
+	TEST_CHECK(NVIC_ISER[IRQ_NO_DMA2_STREAM5 / 32] & (1U << (IRQ_NO_DMA2_STREAM5 % 32)));
+
+	Setup(&handle, TIM8, PATGEN_MODE_CIRCULAR);
+	TEST_CHECK_EQ(PATGEN_Init(&handle), PATGEN_OK);
+	TEST_CHECK_EQ(handle.Stream, 1);
+	TEST_CHECK_EQ(handle.Channel, 7);
+	TEST_CHECK_EQ(DMA2->S[1].CR & (DMA_SxCR_DBM | DMA_SxCR_TCIE), 0);
+
+	// Errors
+	Setup(&handle, TIM2, PATGEN_MODE_CIRCULAR);
+	TEST_CHECK_EQ(PATGEN_Init(&handle), PATGEN_ERR_CONFIG);
+	Setup(&handle, TIM1, PATGEN_MODE_DOUBLE);
+	handle.Config.pBuffer[1] = NULL;
+	TEST_CHECK_EQ(PATGEN_Init(&handle), PATGEN_ERR_CONFIG);
+	Setup(&handle, TIM1, PATGEN_MODE_CIRCULAR);
+	handle.Config.SampleRateHz = 200000000U;
+	TEST_CHECK_EQ(PATGEN_Init(&handle), PATGEN_ERR_RATE);
+}
+
+static void test_CircularReplays(void)
+{
+	PATGEN_Handle_t handle;
+	uint16_t out[LENGTH];
+
+	GPIO_PeriClockEnable(GPIOD);
+	REG_WRITE(GPIOD->ODR, 0xAB00);
+
+	Setup(&handle, TIM1, PATGEN_MODE_CIRCULAR);
+	FillLevels(Buffer[0], 0x10);
+	TEST_CHECK_EQ(PATGEN_Init(&handle), PATGEN_OK);
+	PATGEN_Start(&handle);
+	TEST_CHECK(TIM1->DIER & TIM_DIER_UDE);
+
+	for(uint32_t round = 0; round < 3; round++)
+	{
+		PlayBuffer(&handle, out);
+		CheckLevels(out, 0x10);
+	}
+	TEST_CHECK(DMA2->S[5].CR & DMA_SxCR_EN);
+
+	PATGEN_Stop(&handle);
+	TEST_CHECK_EQ(DMA2->S[5].CR & DMA_SxCR_EN, 0);
+	TEST_CHECK_EQ(TIM1->DIER & TIM_DIER_UDE, 0);
+	TEST_CHECK_EQ(GPIOD->ODR, 0xAB00U | 0x17U);		// Last level kept
+
+	GPIO_PeriClockDisable(GPIOD);
+}
+
+static void test_DoubleBufferWithCallback(void)
+{
+	PATGEN_Handle_t handle;
+	uint16_t out[LENGTH];
+
+	GPIO_PeriClockEnable(GPIOD);
+	REG_WRITE(GPIOD->ODR, 0xAB00);
+
+	Setup(&handle, TIM1, PATGEN_MODE_DOUBLE);
+	handle.Config.pRefill = Refill;
+	FillLevels(Buffer[0], 0);
+	FillLevels(Buffer[1], LENGTH);
+	NextLevel = 2 * LENGTH;
+	Refills = 0;
+	TEST_CHECK_EQ(PATGEN_Init(&handle), PATGEN_OK);
+	PATGEN_Start(&handle);
+
+	// A continuous stream: each buffer is refilled while the other one plays
+	for(uint16_t i = 0; i < 10; i++)
+	{
+		PlayBuffer(&handle, out);
+		CheckLevels(out, (uint16_t)(i * LENGTH));
+	}
+	TEST_CHECK_EQ(handle.Played, 10);
+	TEST_CHECK_EQ(handle.Underruns, 0);
+	TEST_CHECK_EQ(Refills, 10);
+
+	PATGEN_Stop(&handle);
+	TEST_CHECK_EQ(DMA2->S[5].CR & DMA_SxCR_CT, 0);		// Starts again from buffer 0
+	TEST_CHECK_EQ(DMA_GetFlags(DMA2, 5), 0);
+
+	GPIO_PeriClockDisable(GPIOD);
+}
+
+static void test_DoubleBufferFromMainLoop(void)
+{
+	PATGEN_Handle_t handle;
+	uint16_t out[LENGTH];
+	uint32_t *pFree;
+
+	GPIO_PeriClockEnable(GPIOD);
+	REG_WRITE(GPIOD->ODR, 0xAB00);
+
+	Setup(&handle, TIM1, PATGEN_MODE_DOUBLE);
+	FillLevels(Buffer[0], 0);
+	FillLevels(Buffer[1], LENGTH);
+	TEST_CHECK_EQ(PATGEN_Init(&handle), PATGEN_OK);
+	PATGEN_Start(&handle);
+	TEST_CHECK(PATGEN_GetFreeBuffer(&handle) == NULL);	// Both waiting to be played
+
+	// Buffer 0 played, it is free while buffer 1 plays
+	PlayBuffer(&handle, out);
+	CheckLevels(out, 0);
+	pFree = PATGEN_GetFreeBuffer(&handle);
+	TEST_CHECK(pFree == Buffer[0]);
+	FillLevels(pFree, 2 * LENGTH);
+	PATGEN_SubmitBuffer(&handle, pFree);
+	TEST_CHECK(PATGEN_GetFreeBuffer(&handle) == NULL);
+
+	PlayBuffer(&handle, out);
+	CheckLevels(out, LENGTH);
+	TEST_CHECK_EQ(handle.Underruns, 0);
+
+	// Buffer 1 is not given back in time: counted when the stream starts it again
+	PlayBuffer(&handle, out);
+	CheckLevels(out, 2 * LENGTH);
+	TEST_CHECK_EQ(handle.Underruns, 1);
+	TEST_CHECK(PATGEN_GetFreeBuffer(&handle) == Buffer[0]);
+
+	// and its old data is played again
+	PlayBuffer(&handle, out);
+	CheckLevels(out, LENGTH);
+	TEST_CHECK_EQ(handle.Played, 4);
+
+	PATGEN_Stop(&handle);
+	GPIO_PeriClockDisable(GPIOD);
+}
+
+int main(void)
+{
+	TEST_RUN(test_Encode);
+	TEST_RUN(test_InitRegisters);
+	TEST_RUN(test_CircularReplays);
+	TEST_RUN(test_DoubleBufferWithCallback);
+	TEST_RUN(test_DoubleBufferFromMainLoop);
+
+	TEST_EXIT();
+}
@@ -0,0 +1,214 @@
+/*
+ * test_profiler.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#define PROFILER_ENABLE		// Markers on in this file, the drivers are built without them
+
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+
+// Aggregation of the profiler (count, min, max, total, log2 histogram) and both exports.
+// In the simulator reading CYCCNT takes no cycles, so the measured overhead is 0 and the
+// samples are recorded as given.
+
+#define REGION_A	PROFILER_ID_USER
+#define REGION_B	(PROFILER_ID_USER + 3)
+
+static uint32_t GetLE(const uint8_t *pBuffer, uint8_t Bytes, uint64_t *pValue)
+{
+	*pValue = 0;
+	for(uint8_t i = 0; i < Bytes; i++)
+	{
+		*pValue |= (uint64_t)pBuffer[i] << (8 * i);
+	}
+
+	return Bytes;
+}
+
+static void RecordSamples(void)
+{
+	static const uint32_t a[] = { 0, 1, 2, 3, 1000, 0xFFFFFFFFU };
+
+	for(uint32_t i = 0; i < sizeof(a) / sizeof(a[0]); i++)
+	{
+		PROFILER_Record(REGION_A, a[i]);
+	}
+	PROFILER_Record(REGION_B, 100);
+	PROFILER_Record(REGION_B, 300);
+}
+
+static void test_Aggregation(void)
+{
+	const PROFILER_Stats_t *pA, *pB;
+
+	PROFILER_Init();
+	RecordSamples();
+
+	pA = PROFILER_GetStats(REGION_A);
+	TEST_CHECK_EQ(pA->Count, 6);
+	TEST_CHECK_EQ(pA->Min, 0);
+	TEST_CHECK_EQ(pA->Max, 0xFFFFFFFFU);
+	TEST_CHECK_EQ(pA->Total, 1006ULL + 0xFFFFFFFFULL);
+
+	// Bin 0 is 0 cycles, bin k is [2^(k-1), 2^k), bin 31 takes everything above
+	TEST_CHECK_EQ(pA->Hist[0], 1);
+	TEST_CHECK_EQ(pA->Hist[1], 1);
+	TEST_CHECK_EQ(pA->Hist[2], 2);
+	TEST_CHECK_EQ(pA->Hist[10], 1);
+	TEST_CHECK_EQ(pA->Hist[31], 1);
+
+	pB = PROFILER_GetStats(REGION_B);
+	TEST_CHECK_EQ(pB->Count, 2);
+	TEST_CHECK_EQ(pB->Min, 100);
+	TEST_CHECK_EQ(pB->Max, 300);
+	TEST_CHECK_EQ(pB->Hist[7], 1);
+	TEST_CHECK_EQ(pB->Hist[9], 1);
+
+	// Unknown ids are ignored
+	PROFILER_Record(PROFILER_MAX_REGIONS, 5);
+	TEST_CHECK(PROFILER_GetStats(PROFILER_MAX_REGIONS) == NULL);
+
+	PROFILER_Reset();
+	TEST_CHECK_EQ(PROFILER_GetStats(REGION_A)->Count, 0);
+	TEST_CHECK_EQ(PROFILER_GetStats(REGION_A)->Hist[31], 0);
+}
+
+static void test_Markers(void)
+{
+	PROFILER_Init();
+
+	for(uint32_t i = 1; i <= 4; i++)
+	{
+		PROFILER_BEGIN(REGION_A);
+		(void)SIM_AdvanceCycles(100 * i);
+		PROFILER_END(REGION_A);
+	}
+
+	TEST_CHECK_EQ(PROFILER_GetStats(REGION_A)->Count, 4);
+	TEST_CHECK_EQ(PROFILER_GetStats(REGION_A)->Min, 100);
+	TEST_CHECK_EQ(PROFILER_GetStats(REGION_A)->Max, 400);
+	TEST_CHECK_EQ(PROFILER_GetStats(REGION_A)->Total, 1000);
+}
+
+static void test_ExportCSV(void)
+{
+	char csv[1024], expected[256], *pLine, *pSave;
+	uint32_t len, pos, headerLen, lines = 0;
+
+	PROFILER_Init();
+	RecordSamples();
+
+	len = PROFILER_ExportCSV(csv, sizeof(csv) - 1);
+	csv[len] = '\0';
+
+	// Every column has a name
+	pos = (uint32_t)snprintf(expected, sizeof(expected), "id,count,min,max,mean");
+	for(uint32_t b = 0; b < PROFILER_HIST_BINS; b++)
+	{
+		pos += (uint32_t)snprintf(&expected[pos], sizeof(expected) - pos, ",h%u", (unsigned)b);
+	}
+	snprintf(&expected[pos], sizeof(expected) - pos, "\n");
+	headerLen = (uint32_t)strlen(expected);
+	TEST_CHECK(strncmp(csv, expected, headerLen) == 0);
+
+	for(pLine = strtok_r(csv, "\n", &pSave); pLine != NULL; pLine = strtok_r(NULL, "\n", &pSave))
+	{
+		unsigned long long fields[5 + PROFILER_HIST_BINS];
+		uint32_t count = 0;
+		char *pEnd = pLine;
+
+		if(lines++ == 0)
+		{
+			continue;		// Header
+		}
+		while( (count < 5 + PROFILER_HIST_BINS) && (*pEnd != '\0') )
+		{
+			fields[count++] = strtoull(pEnd, &pEnd, 10);
+			if(*pEnd == ',')
+			{
+				pEnd++;
+			}
+		}
+		TEST_CHECK_EQ(count, 5 + PROFILER_HIST_BINS);
+
+		const PROFILER_Stats_t *pStats = PROFILER_GetStats((uint8_t)fields[0]);
+		TEST_CHECK_EQ(fields[1], pStats->Count);
+		TEST_CHECK_EQ(fields[2], pStats->Min);
+		TEST_CHECK_EQ(fields[3], pStats->Max);
+		TEST_CHECK_EQ(fields[4], pStats->Total / pStats->Count);
+		for(uint32_t b = 0; b < PROFILER_HIST_BINS; b++)
+		{
+			TEST_CHECK_EQ(fields[5 + b], pStats->Hist[b]);
+		}
+	}
+	TEST_CHECK_EQ(lines, 3);		// Header, region A, region B
+
+	// Only whole lines: a buffer one short of the full text drops the last line
+	TEST_CHECK(PROFILER_ExportCSV(csv, len - 1) < len - 1);
+	TEST_CHECK_EQ(csv[PROFILER_ExportCSV(csv, len - 1) - 1], '\n');
+	TEST_CHECK_EQ(PROFILER_ExportCSV(csv, headerLen), headerLen);
+	TEST_CHECK_EQ(PROFILER_ExportCSV(csv, headerLen - 1), 0);
+}
+
+static void test_ExportBinary(void)
+{
+	uint8_t bin[512];
+	uint32_t len, pos = 4;
+	uint64_t value;
+
+	PROFILER_Init();
+	RecordSamples();
+
+	len = PROFILER_ExportBinary(bin, sizeof(bin));
+	TEST_CHECK_EQ(bin[0], 'P');
+	TEST_CHECK_EQ(bin[1], 'R');
+	TEST_CHECK_EQ(bin[2], 1);
+	TEST_CHECK_EQ(bin[3], 2);
+
+	for(uint8_t r = 0; r < bin[3]; r++)
+	{
+		const PROFILER_Stats_t *pStats = PROFILER_GetStats(bin[pos]);
+		uint64_t bitmap;
+
+		pos++;
+		pos += GetLE(&bin[pos], 4, &bitmap);
+		pos += GetLE(&bin[pos], 4, &value);
+		TEST_CHECK_EQ(value, pStats->Count);
+		pos += GetLE(&bin[pos], 4, &value);
+		TEST_CHECK_EQ(value, pStats->Min);
+		pos += GetLE(&bin[pos], 4, &value);
+		TEST_CHECK_EQ(value, pStats->Max);
+		pos += GetLE(&bin[pos], 8, &value);
+		TEST_CHECK_EQ(value, pStats->Total);
+
+		for(uint32_t b = 0; b < PROFILER_HIST_BINS; b++)
+		{
+			TEST_CHECK_EQ((bitmap >> b) & 1U, pStats->Hist[b] != 0);
+			if(bitmap & (1ULL << b))
+			{
+				pos += GetLE(&bin[pos], 4, &value);
+				TEST_CHECK_EQ(value, pStats->Hist[b]);
+			}
+		}
+	}
+	TEST_CHECK_EQ(pos, len);
+
+	// Region A has 5 bins: 4 + 25 + 20 bytes, region B is left out when it does not fit
+	TEST_CHECK_EQ(PROFILER_ExportBinary(bin, 49), 49);
+	TEST_CHECK_EQ(bin[3], 1);
+	TEST_CHECK_EQ(PROFILER_ExportBinary(bin, 3), 0);
+}
+
+int main(void)
+{
+	TEST_RUN(test_Aggregation);
+	TEST_RUN(test_Markers);
+	TEST_RUN(test_ExportCSV);
+	TEST_RUN(test_ExportBinary);
+
+	TEST_EXIT();
+}
@@ -0,0 +1,158 @@
+/*
+ * test_rcc.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "test.h"
+
+// PLL settings of the run time solver (RCC_PLLSolve) and of the compile time one
+// (RCC_PLL_INIT) must both pass RCC_PLLCheck and give the SYSCLK asked for, for the usual
+// crystals and SYSCLK frequencies and for every whole MHz the PLL can make.
+
+#define MHZ(x)		((x) * 1000000U)
+
+typedef struct
+{
+	uint32_t InHz;
+	uint32_t SysclkHz;
+	RCC_PLLConfig_t PLL;
+}Case_t;
+
+// Made by the compiler, the table is in .rodata
+#define CASE(InHz, SysclkHz)	{ InHz, SysclkHz, RCC_PLL_INIT(InHz, SysclkHz) }
+
+static const Case_t Cases[] =
+{
+	CASE(MHZ(8), MHZ(168)), CASE(MHZ(8), MHZ(144)), CASE(MHZ(8), MHZ(120)), CASE(MHZ(8), MHZ(84)),
+	CASE(MHZ(8), MHZ(48)), CASE(MHZ(8), MHZ(16)),
+	CASE(MHZ(12), MHZ(168)), CASE(MHZ(12), MHZ(120)), CASE(MHZ(12), MHZ(72)),
+	CASE(MHZ(16), MHZ(168)), CASE(MHZ(16), MHZ(100)), CASE(MHZ(16), MHZ(96)),
+	CASE(MHZ(25), MHZ(168)), CASE(MHZ(25), MHZ(150)), CASE(MHZ(25), MHZ(100)),
+	CASE(MHZ(26), MHZ(168)), CASE(MHZ(24), MHZ(168)), CASE(MHZ(4), MHZ(168)),
+};
+
+_Static_assert(RCC_PLL_N(MHZ(8), MHZ(168)) == 168, "8 MHz HSE: VCO 336 MHz at 2 MHz PLL input");
+
+static uint32_t Sysclk(uint32_t InHz, const RCC_PLLConfig_t *pPLL)
+{
+	return (uint32_t)((uint64_t)InHz * pPLL->N / pPLL->M / pPLL->P);
+}
+
+static uint32_t VCO(uint32_t InHz, const RCC_PLLConfig_t *pPLL)
+{
+	return (uint32_t)((uint64_t)InHz * pPLL->N / pPLL->M);
+}
+
+static void test_CommonPairs(void)
+{
+	for(uint32_t i = 0; i < sizeof(Cases) / sizeof(Cases[0]); i++)
+	{
+		const Case_t *pCase = &Cases[i];
+		RCC_PLLConfig_t solved = { 0 };
+
+		TEST_CHECK_EQ(RCC_PLLCheck(pCase->InHz, &pCase->PLL), RCC_OK);
+		TEST_CHECK_EQ(Sysclk(pCase->InHz, &pCase->PLL), pCase->SysclkHz);
+
+		TEST_CHECK_EQ(RCC_PLLSolve(pCase->InHz, pCase->SysclkHz, &solved), RCC_OK);
+		TEST_CHECK_EQ(RCC_PLLCheck(pCase->InHz, &solved), RCC_OK);
+		TEST_CHECK_EQ(Sysclk(pCase->InHz, &solved), pCase->SysclkHz);
+
+		// The solver tries all M, its PLL input is at least as high (less jitter)
+		TEST_CHECK(solved.M <= pCase->PLL.M);
+	}
+
+	// The USB clock is exact at 168 MHz from the usual crystals
+	for(uint32_t i = 0; i < sizeof(Cases) / sizeof(Cases[0]); i++)
+	{
+		if(Cases[i].SysclkHz == MHZ(168))
+		{
+			TEST_CHECK_EQ(VCO(Cases[i].InHz, &Cases[i].PLL) / Cases[i].PLL.Q, RCC_USB_HZ);
+		}
+	}
+}
+
+// Every whole MHz from the lowest the VCO allows (100 MHz / 8) up to the limit
+static void test_WholeRange(void)
+{
+	static const uint32_t inputs[] = { MHZ(4), MHZ(8), MHZ(12), MHZ(16), MHZ(25) };
+	uint32_t failures = 0;
+
+	for(uint32_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
+	{
+		for(uint32_t sys = MHZ(13); sys <= RCC_SYSCLK_MAX; sys += MHZ(1))
+		{
+			RCC_PLLConfig_t solved = { 0 };
+			RCC_PLLConfig_t macro = RCC_PLL_INIT(inputs[i], sys);
+
+			if( (RCC_PLLSolve(inputs[i], sys, &solved) != RCC_OK) ||
+				(RCC_PLLCheck(inputs[i], &solved) != RCC_OK) ||
+				(Sysclk(inputs[i], &solved) != sys) ||
+				(RCC_PLLCheck(inputs[i], &macro) != RCC_OK) ||
+				(Sysclk(inputs[i], &macro) != sys) )
+			{
+				printf("    %u Hz from %u Hz\n", (unsigned)sys, (unsigned)inputs[i]);
+				failures++;
+			}
+		}
+	}
+	TEST_CHECK_EQ(failures, 0);
+}
+
+static void test_OutOfRange(void)
+{
+	RCC_PLLConfig_t pll;
+	RCC_PLLConfig_t bad = RCC_PLL_INIT(MHZ(8), MHZ(168));
+
+	TEST_CHECK_EQ(RCC_PLLSolve(MHZ(8), 0, &pll), RCC_ERR_CONFIG);
+	TEST_CHECK_EQ(RCC_PLLSolve(MHZ(8), RCC_SYSCLK_MAX + 1, &pll), RCC_ERR_CONFIG);
+	TEST_CHECK_EQ(RCC_PLLSolve(MHZ(8), MHZ(12), &pll), RCC_ERR_CONFIG);		// VCO below 100 MHz
+	TEST_CHECK_EQ(RCC_PLLSolve(MHZ(8), 167999999U, &pll), RCC_ERR_CONFIG);	// Not exact
+
+	bad.Q = 6;							// USB clock 56 MHz
+	TEST_CHECK_EQ(RCC_PLLCheck(MHZ(8), &bad), RCC_ERR_CONFIG);
+	bad = (RCC_PLLConfig_t)RCC_PLL_INIT(MHZ(8), MHZ(168));
+	bad.M = 2;							// PLL input 4 MHz
+	TEST_CHECK_EQ(RCC_PLLCheck(MHZ(8), &bad), RCC_ERR_CONFIG);
+	bad = (RCC_PLLConfig_t)RCC_PLL_INIT(MHZ(8), MHZ(168));
+	bad.P = 3;
+	TEST_CHECK_EQ(RCC_PLLCheck(MHZ(8), &bad), RCC_ERR_CONFIG);
+}
+
+// A compile time setting goes through RCC_ClockConfig and reads back the same frequencies
+static void test_ClockConfigWithMacro(void)
+{
+	static const RCC_ClockConfig_t clk =
+	{
+		.Source = RCC_SYSCLK_PLL,
+		.PLLSource = RCC_PLLSRC_HSE,
+		.SysclkHz = MHZ(168),
+		.AHBDiv = 1,
+		.PLL = RCC_PLL_INIT(HSE_VALUE, MHZ(168)),
+	};
+	RCC_ClockConfig_t solved = clk;
+
+	TEST_CHECK_EQ(RCC_ClockConfig(&clk), RCC_OK);
+	TEST_CHECK_EQ(RCC_GetSysclkFreq(), MHZ(168));
+	TEST_CHECK_EQ(RCC_GetPCLK1Freq(), MHZ(42));
+	TEST_CHECK_EQ(RCC_GetPCLK2Freq(), MHZ(84));
+	TEST_CHECK_EQ(FLASH_GetLatency(), 5);
+
+	// M = 0: solved by RCC_ClockConfig at run time
+	solved.PLL.M = 0;
+	solved.SysclkHz = MHZ(120);
+	TEST_CHECK_EQ(RCC_ClockConfig(&solved), RCC_OK);
+	TEST_CHECK_EQ(RCC_GetSysclkFreq(), MHZ(120));
+	TEST_CHECK_EQ(FLASH_GetLatency(), 3);
+}
+
+int main(void)
+{
+	TEST_RUN(test_CommonPairs);
+	TEST_RUN(test_WholeRange);
+	TEST_RUN(test_OutOfRange);
+	TEST_RUN(test_ClockConfigWithMacro);
+
+	TEST_EXIT();
+}
@@ -0,0 +1,278 @@
+/*
+ * test_ring.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include "test.h"
+#include "stm32f407xx_ring.h"
+
+// Spans, full and empty rings on one thread, then the rings between threads: a producer
+// thread against the consumer for the SPSC ring, four producer threads for the MPSC ring.
+// Each producer sends a numbered sequence (single pushes and spans mixed), the consumer checks
+// that every sequence comes in complete and in order. A thread that finds the ring full or
+// empty yields, so the test also runs on a single core.
+
+#define ITEMS			200000U
+#define PRODUCERS		4
+
+RING_SPSC_DEFINE(Small, uint16_t, 8);
+RING_SPSC_DEFINE(Spsc, uint32_t, 64);
+RING_MPSC_DEFINE(SmallM, uint16_t, 8);
+RING_MPSC_DEFINE(Mpsc, uint32_t, 64);
+
+static void test_SPSCSpans(void)
+{
+	uint16_t value = 0, out;
+	void *pSpan;
+	uint16_t *pSlots;
+	uint32_t n;
+
+	TEST_CHECK_EQ(RING_SPSC_Pop(&Small, &out), 0);
+	for(uint16_t i = 0; i < 8; i++)
+	{
+		TEST_CHECK_EQ(RING_SPSC_Push(&Small, &i), 1);
+	}
+	TEST_CHECK_EQ(RING_SPSC_Push(&Small, &value), 0);	// Full
+	TEST_CHECK_EQ(RING_SPSC_Used(&Small), 8);
+
+	// Read 5, the write span is then the 5 slots at the start
+	n = RING_SPSC_ReadSpan(&Small, &pSpan);
+	TEST_CHECK_EQ(n, 8);
+	TEST_CHECK_EQ(((uint16_t*)pSpan)[4], 4);
+	RING_SPSC_Release(&Small, 5);
+	n = RING_SPSC_WriteSpan(&Small, &pSpan);
+	TEST_CHECK_EQ(n, 5);
+	pSlots = pSpan;
+	for(uint16_t i = 0; i < 5; i++)
+	{
+		pSlots[i] = (uint16_t)(100 + i);
+	}
+	RING_SPSC_Commit(&Small, 5);
+
+	// The read span ends at the end of the storage, the rest comes next
+	TEST_CHECK_EQ(RING_SPSC_ReadSpan(&Small, &pSpan), 3);
+	TEST_CHECK_EQ(((uint16_t*)pSpan)[0], 5);
+	RING_SPSC_Release(&Small, 3);
+	TEST_CHECK_EQ(RING_SPSC_ReadSpan(&Small, &pSpan), 5);
+	TEST_CHECK_EQ(((uint16_t*)pSpan)[4], 104);
+	RING_SPSC_Release(&Small, 5);
+	TEST_CHECK_EQ(RING_SPSC_Used(&Small), 0);
+}
+
+static void test_MPSCSpans(void)
+{
+	uint16_t value = 7, out;
+	uint32_t index0, index1;
+	uint16_t *p0, *p1;
+	void *pSpan;
+
+	RING_MPSC_Init(&SmallM);
+	TEST_CHECK_EQ(RING_MPSC_Pop(&SmallM, &out), 0);
+
+	// Two reservations, the second is published first: the consumer waits for the first
+	p0 = RING_MPSC_Reserve(&SmallM, 3, &index0);
+	p1 = RING_MPSC_Reserve(&SmallM, 2, &index1);
+	TEST_CHECK(p0 != NULL);
+	TEST_CHECK(p1 == p0 + 3);
+	TEST_CHECK_EQ(index1, index0 + 3);
+	p1[0] = 10;
+	p1[1] = 11;
+	RING_MPSC_Publish(&SmallM, index1, 2);
+	TEST_CHECK_EQ(RING_MPSC_ReadSpan(&SmallM, &pSpan), 0);
+	p0[0] = 1;
+	p0[1] = 2;
+	p0[2] = 3;
+	RING_MPSC_Publish(&SmallM, index0, 3);
+	TEST_CHECK_EQ(RING_MPSC_ReadSpan(&SmallM, &pSpan), 5);
+	TEST_CHECK_EQ(((uint16_t*)pSpan)[3], 10);
+
+	// 3 slots left before the end of the storage: 4 do not fit, 3 do
+	TEST_CHECK(RING_MPSC_Reserve(&SmallM, 4, &index0) == NULL);
+	TEST_CHECK(RING_MPSC_Reserve(&SmallM, 3, &index0) != NULL);
+	RING_MPSC_Publish(&SmallM, index0, 3);
+	TEST_CHECK_EQ(RING_MPSC_Push(&SmallM, &value), 0);		// Full
+	RING_MPSC_Release(&SmallM, 5);
+	TEST_CHECK_EQ(RING_MPSC_Push(&SmallM, &value), 1);
+	TEST_CHECK_EQ(RING_MPSC_ReadSpan(&SmallM, &pSpan), 3);
+	RING_MPSC_Release(&SmallM, 3);
+	TEST_CHECK_EQ(RING_MPSC_Pop(&SmallM, &out), 1);
+	TEST_CHECK_EQ(out, 7);
+	TEST_CHECK_EQ(RING_MPSC_Pop(&SmallM, &out), 0);
+}
+
+static void *SPSCProducer(void *pArg)
+{
+	uint32_t next = 0;
+
+	(void)pArg;
+	while(next < ITEMS)
+	{
+		// Every other round a span of up to 7, else single pushes
+		if(next % 2 == 0)
+		{
+			void *pSpan;
+			uint32_t n = RING_SPSC_WriteSpan(&Spsc, &pSpan);
+
+			if(n > 7)
+			{
+				n = 7;
+			}
+			if(n > ITEMS - next)
+			{
+				n = ITEMS - next;
+			}
+			for(uint32_t i = 0; i < n; i++)
+			{
+				((uint32_t*)pSpan)[i] = next + i;
+			}
+			RING_SPSC_Commit(&Spsc, n);
+			next += n;
+			if(n == 0)
+			{
+				sched_yield();
+			}
+		}
+		else if(RING_SPSC_Push(&Spsc, &next))
+		{
+			next++;
+		}
+		else
+		{
+			sched_yield();
+		}
+	}
+
+	return NULL;
+}
+
+static void test_SPSCThreads(void)
+{
+	pthread_t producer;
+	uint32_t expected = 0, errors = 0;
+
+	pthread_create(&producer, NULL, SPSCProducer, NULL);
+	while(expected < ITEMS)
+	{
+		void *pSpan;
+		uint32_t n = RING_SPSC_ReadSpan(&Spsc, &pSpan);
+
+		for(uint32_t i = 0; i < n; i++)
+		{
+			if(((uint32_t*)pSpan)[i] != expected)
+			{
+				errors++;
+			}
+			expected++;
+		}
+		RING_SPSC_Release(&Spsc, n);
+		if(n == 0)
+		{
+			sched_yield();
+		}
+	}
+	pthread_join(producer, NULL);
+
+	TEST_CHECK_EQ(errors, 0);
+	TEST_CHECK_EQ(RING_SPSC_Used(&Spsc), 0);
+}
+
+// Item: producer number in the top byte, sequence number below
+static void *MPSCProducer(void *pArg)
+{
+	uint32_t id = (uint32_t)(uintptr_t)pArg;
+	uint32_t next = 0;
+
+	while(next < ITEMS / PRODUCERS)
+	{
+		uint32_t len = 1 + (next + id) % 3;
+		uint32_t index;
+		uint32_t *pSlots;
+
+		if(len > ITEMS / PRODUCERS - next)
+		{
+			len = ITEMS / PRODUCERS - next;
+		}
+		// A span does not go over the end of the storage: one slot at a time there
+		pSlots = RING_MPSC_Reserve(&Mpsc, len, &index);
+		if(pSlots == NULL)
+		{
+			len = 1;
+			pSlots = RING_MPSC_Reserve(&Mpsc, len, &index);
+		}
+		if(pSlots == NULL)
+		{
+			sched_yield();
+			continue;
+		}
+		for(uint32_t i = 0; i < len; i++)
+		{
+			pSlots[i] = (id << 24) | (next + i);
+		}
+		RING_MPSC_Publish(&Mpsc, index, len);
+		next += len;
+	}
+
+	return NULL;
+}
+
+static void test_MPSCThreads(void)
+{
+	pthread_t producers[PRODUCERS];
+	uint32_t expected[PRODUCERS] = { 0 };
+	uint32_t received = 0, errors = 0;
+
+	RING_MPSC_Init(&Mpsc);
+	for(uint32_t i = 0; i < PRODUCERS; i++)
+	{
+		pthread_create(&producers[i], NULL, MPSCProducer, (void*)(uintptr_t)i);
+	}
+
+	while(received < (ITEMS / PRODUCERS) * PRODUCERS)
+	{
+		void *pSpan;
+		uint32_t n = RING_MPSC_ReadSpan(&Mpsc, &pSpan);
+
+		for(uint32_t i = 0; i < n; i++)
+		{
+			uint32_t item = ((uint32_t*)pSpan)[i];
+			uint32_t id = item >> 24;
+
+			if( (id >= PRODUCERS) || ((item & 0xFFFFFFU) != expected[id]) )
+			{
+				errors++;
+			}
+			else
+			{
+				expected[id]++;
+			}
+		}
+		RING_MPSC_Release(&Mpsc, n);
+		received += n;
+		if(n == 0)
+		{
+			sched_yield();
+		}
+	}
+	for(uint32_t i = 0; i < PRODUCERS; i++)
+	{
+		pthread_join(producers[i], NULL);
+		TEST_CHECK_EQ(expected[i], ITEMS / PRODUCERS);
+	}
+
+	TEST_CHECK_EQ(errors, 0);
+	TEST_CHECK_EQ(RING_MPSC_ReadSpan(&Mpsc, &(void*){ NULL }), 0);
+}
+
+int main(void)
+{
+	TEST_RUN(test_SPSCSpans);
+	TEST_RUN(test_MPSCSpans);
+	TEST_RUN(test_SPSCThreads);
+	TEST_RUN(test_MPSCThreads);
+
+	TEST_EXIT();
+}
@@ -0,0 +1,144 @@
+/*
+ * test_sim.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <pthread.h>
+#include "test.h"
+
+// Side effects of the GPIO and RCC models, access counting and the bus lock
+
+#define THREADS				4
+#define WRITES_PER_THREAD	20000
+
+static void test_BSRRUpdatesODR(void)
+{
+	RCC_PeriphClockEnable(RCC_CLK_GPIO(GPIOD), RCC_CLK_RUN_ONLY);
+
+	REG_WRITE(GPIOD->BSRR, GPIO_BSRR_SET(0x00F0));
+	TEST_CHECK_EQ(GPIOD->ODR, 0x00F0);
+	REG_WRITE(GPIOD->BSRR, GPIO_BSRR_RESET(0x0030) | GPIO_BSRR_SET(0x0001));
+	TEST_CHECK_EQ(GPIOD->ODR, 0x00C1);
+
+	// Set wins over reset, BSRR reads as 0
+	REG_WRITE(GPIOD->BSRR, GPIO_BSRR_RESET(0x0100) | GPIO_BSRR_SET(0x0100));
+	TEST_CHECK_EQ(GPIOD->ODR, 0x01C1);
+	TEST_CHECK_EQ(REG_READ(GPIOD->BSRR), 0);
+}
+
+static void test_IDRFollowsOutputsAndInputs(void)
+{
+	RCC_PeriphClockEnable(RCC_CLK_GPIO(GPIOE), RCC_CLK_RUN_ONLY);
+	GPIO_SetPinModes(GPIOE, 0x000F, GPIO_MODE_OUT);
+
+	SIM_SetInputPort(GPIOE, 0xFF00);
+	REG_WRITE(GPIOE->BSRR, GPIO_BSRR_SET(0x0005));
+	TEST_CHECK_EQ(GPIO_ReadFromInputPort(GPIOE), 0xFF05);
+}
+
+static void test_ClockOffIgnoresWrites(void)
+{
+	// Port C has no clock after reset
+	REG_WRITE(GPIOC->MODER, 0x55555555U);
+	REG_WRITE(GPIOC->BSRR, GPIO_BSRR_SET(0xFFFF));
+	TEST_CHECK_EQ(GPIOC->MODER, 0);
+	TEST_CHECK_EQ(GPIOC->ODR, 0);
+
+	RCC_PeriphClockEnable(RCC_CLK_GPIO(GPIOC), RCC_CLK_RUN_ONLY);
+	REG_WRITE(GPIOC->MODER, 0x55555555U);
+	TEST_CHECK_EQ(GPIOC->MODER, 0x55555555U);
+}
+
+static void test_AHB1RSTRResetsPort(void)
+{
+	RCC_PeriphClockEnable(RCC_CLK_GPIO(GPIOA), RCC_CLK_RUN_ONLY);
+	REG_WRITE(GPIOA->MODER, 0x00000055U);
+	REG_WRITE(GPIOA->ODR, 0x1234);
+
+	// A pulse of the reset bit, the registers go back to the port A reset values
+	REG_SET_BITS(RCC->AHB1RSTR, 1U << 0);
+	REG_CLR_BITS(RCC->AHB1RSTR, 1U << 0);
+	TEST_CHECK_EQ(GPIOA->MODER, 0xA8000000U);
+	TEST_CHECK_EQ(GPIOA->ODR, 0);
+}
+
+static void test_AccessCounts(void)
+{
+	RCC_PeriphClockEnable(RCC_CLK_GPIO(GPIOD), RCC_CLK_RUN_ONLY);
+	SIM_ResetCounters();
+
+	// The hot path of a toggle: one ODR read and one BSRR store, nothing else
+	GPIO_ToggleOutputPin(GPIOD, 12);
+	TEST_CHECK_EQ(SIM_GetReadCount(&GPIOD->ODR), 1);
+	TEST_CHECK_EQ(SIM_GetWriteCount(&GPIOD->BSRR), 1);
+	TEST_CHECK_EQ(SIM_GetTotalAccesses(), 2);
+
+	GPIO_SetPins(GPIOD, 0x0003);
+	TEST_CHECK_EQ(SIM_GetWriteCount(&GPIOD->BSRR), 2);
+	TEST_CHECK_EQ(SIM_GetTotalAccesses(), 3);
+
+	SIM_ResetCounters();
+	TEST_CHECK_EQ(SIM_GetTotalAccesses(), 0);
+}
+
+// Each thread sets and resets its own pins through BSRR, as interrupts on the chip would
+static void *BSRRWriter(void *pArg)
+{
+	uint16_t pin = (uint16_t)(1U << (uintptr_t)pArg);
+
+	for(uint32_t i = 0; i < WRITES_PER_THREAD; i++)
+	{
+		REG_WRITE(GPIOD->BSRR, (i & 1U) ? GPIO_BSRR_RESET(pin) : GPIO_BSRR_SET(pin));
+	}
+	REG_WRITE(GPIOD->BSRR, GPIO_BSRR_SET(pin));
+
+	return NULL;
+}
+
+static void test_ThreadedAccessesAreAtomic(void)
+{
+	pthread_t threads[THREADS];
+
+	RCC_PeriphClockEnable(RCC_CLK_GPIO(GPIOD), RCC_CLK_RUN_ONLY);
+	SIM_ResetCounters();
+
+	for(uintptr_t i = 0; i < THREADS; i++)
+	{
+		pthread_create(&threads[i], NULL, BSRRWriter, (void*)i);
+	}
+	for(uint32_t i = 0; i < THREADS; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	// No write and no count lost
+	TEST_CHECK_EQ(SIM_GetWriteCount(&GPIOD->BSRR), THREADS * (WRITES_PER_THREAD + 1));
+	TEST_CHECK_EQ(GPIOD->ODR, (1U << THREADS) - 1);
+}
+
+static void test_ClockOnCycles(void)
+{
+	RCC_PeriphClockEnable(RCC_CLK_GPIO(GPIOD), RCC_CLK_RUN_ONLY);
+	RCC_PeriphClockEnable(RCC_CLK_GPIO(GPIOE), RCC_CLK_IN_SLEEP);
+	SIM_ResetCounters();
+
+	(void)SIM_AdvanceCycles(1000);
+	(void)SIM_SleepCycles(500);
+	TEST_CHECK_EQ(SIM_GetClockOnCycles(RCC_CLK_GPIO(GPIOD)), 1000);
+	TEST_CHECK_EQ(SIM_GetClockOnCycles(RCC_CLK_GPIO(GPIOE)), 1500);
+}
+
+int main(void)
+{
+	TEST_RUN(test_BSRRUpdatesODR);
+	TEST_RUN(test_IDRFollowsOutputsAndInputs);
+	TEST_RUN(test_ClockOffIgnoresWrites);
+	TEST_RUN(test_AHB1RSTRResetsPort);
+	TEST_RUN(test_AccessCounts);
+	TEST_RUN(test_ThreadedAccessesAreAtomic);
+	TEST_RUN(test_ClockOnCycles);
+
+	TEST_EXIT();
+}
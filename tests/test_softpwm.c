@@ -0,0 +1,202 @@
+/*
+ * test_softpwm.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <stdlib.h>
+#include "test.h"
+
+// SOFTPWM_BuildList against a model of the outputs: the events of a list are played tick by
+// tick into port levels, each pin must be high exactly for the first Duty ticks of the period.
+// Also the shape of the list: starts at time 0, times rising, one event per distinct duty
+// between 0 and the period, no pin set and reset in the same word. Fixed duty sets with the
+// edge cases first, then random ones on channels spread over three ports.
+
+#define PERIOD		200
+#define CHANNELS	12
+#define RANDOM_SETS	500
+
+static const SOFTPWM_Pin_t Pins[CHANNELS] =
+{
+	{ GPIOA, 0 }, { GPIOA, 5 }, { GPIOA, 15 }, { GPIOB, 1 }, { GPIOB, 2 }, { GPIOB, 3 },
+	{ GPIOD, 12 }, { GPIOD, 13 }, { GPIOD, 14 }, { GPIOD, 15 }, { GPIOA, 7 }, { GPIOB, 9 },
+};
+
+static SOFTPWM_Handle_t Handle;
+static SOFTPWM_List_t List;
+
+static void Setup(void)
+{
+	Handle = (SOFTPWM_Handle_t){ 0 };
+	Handle.Config.pPins = Pins;
+	Handle.Config.ChannelCount = CHANNELS;
+	Handle.Config.pTIMx = TIM3;
+	Handle.Config.TimerClockHz = 84000000U;
+	Handle.Config.TickHz = 1000000U;
+	Handle.Config.PeriodTicks = PERIOD;
+	Handle.Config.IRQPriority = 6;
+}
+
+// Number of distinct duties strictly between 0 and the period
+static uint32_t DistinctDuties(void)
+{
+	uint32_t count = 0;
+
+	for(uint8_t i = 0; i < CHANNELS; i++)
+	{
+		uint8_t seen = 0;
+
+		for(uint8_t j = 0; j < i; j++)
+		{
+			seen |= (Handle.Duty[j] == Handle.Duty[i]);
+		}
+		if( !seen && (Handle.Duty[i] > 0) && (Handle.Duty[i] < PERIOD) )
+		{
+			count++;
+		}
+	}
+
+	return count;
+}
+
+// Builds the list of the present duties and checks it against the model, returns the failures
+static uint32_t CheckList(void)
+{
+	uint16_t levels[SOFTPWM_MAX_PORTS] = { 0xFFFF, 0x0000, 0x5A5A, 0xA5A5 };	// Anything before the start
+	uint32_t failures = 0;
+	uint8_t next = 0;
+
+	SOFTPWM_BuildList(&Handle, &List);
+	failures += (List.Count != 1 + DistinctDuties());
+	failures += (List.Event[0].Time != 0);
+	for(uint8_t e = 0; e < List.Count; e++)
+	{
+		failures += (e > 0) && (List.Event[e].Time <= List.Event[e - 1].Time);
+		for(uint8_t p = 0; p < SOFTPWM_MAX_PORTS; p++)
+		{
+			failures += ((List.Event[e].BSRR[p] & 0xFFFFU) & (List.Event[e].BSRR[p] >> 16)) != 0;
+		}
+	}
+
+	for(uint32_t t = 0; t < PERIOD; t++)
+	{
+		while( (next < List.Count) && (List.Event[next].Time <= t) )
+		{
+			for(uint8_t p = 0; p < Handle.PortCount; p++)
+			{
+				uint32_t bsrr = List.Event[next].BSRR[p];
+
+				levels[p] = (uint16_t)((levels[p] | (bsrr & 0xFFFFU)) & ~(bsrr >> 16));
+			}
+			next++;
+		}
+		for(uint8_t i = 0; i < CHANNELS; i++)
+		{
+			uint8_t high = (levels[Handle.PortOf[i]] >> Pins[i].Pin) & 1U;
+
+			failures += (high != (t < Handle.Duty[i]));
+		}
+	}
+
+	return failures;
+}
+
+static void test_Ports(void)
+{
+	Setup();
+	TEST_CHECK_EQ(SOFTPWM_Init(&Handle), SOFTPWM_OK);
+	TEST_CHECK_EQ(Handle.PortCount, 3);
+	TEST_CHECK(Handle.pPorts[0] == GPIOA);
+	TEST_CHECK(Handle.pPorts[2] == GPIOD);
+	TEST_CHECK_EQ(Handle.PortPins[0], 0x80A1U);
+	TEST_CHECK_EQ(Handle.PortPins[1], 0x020EU);
+	TEST_CHECK_EQ(Handle.PortOf[11], 1);
+
+	// All duties 0 after Init: one event that resets every pin
+	TEST_CHECK_EQ(Handle.List[0].Count, 1);
+	TEST_CHECK_EQ(Handle.List[0].Event[0].BSRR[2], 0xF000U << 16);
+	SOFTPWM_DeInit(&Handle);
+}
+
+static void test_FixedSets(void)
+{
+	static const uint16_t sets[][CHANNELS] =
+	{
+		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+		{ PERIOD, PERIOD, PERIOD, PERIOD, PERIOD, PERIOD, PERIOD, PERIOD, PERIOD, PERIOD, PERIOD, PERIOD },
+		{ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 },						// One event for all
+		{ PERIOD - 1, 1, PERIOD, 0, 100, 100, 50, 150, 1, PERIOD - 1, 0, PERIOD },
+		{ 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1 },					// Reverse order
+		{ 100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 99 },
+	};
+
+	Setup();
+	TEST_CHECK_EQ(SOFTPWM_Init(&Handle), SOFTPWM_OK);
+	for(uint32_t s = 0; s < sizeof(sets) / sizeof(sets[0]); s++)
+	{
+		for(uint8_t i = 0; i < CHANNELS; i++)
+		{
+			Handle.Duty[i] = sets[s][i];
+		}
+		if(CheckList() != 0)
+		{
+			printf("  duty set %u\n", (unsigned)s);
+		}
+		TEST_CHECK_EQ(CheckList(), 0);
+	}
+	TEST_CHECK_EQ(List.Count, 4);		// 99, 100 and 101
+	SOFTPWM_DeInit(&Handle);
+}
+
+// Random duties, often repeated and often 0 or the full period
+static void test_RandomSets(void)
+{
+	uint32_t failures = 0;
+
+	Setup();
+	TEST_CHECK_EQ(SOFTPWM_Init(&Handle), SOFTPWM_OK);
+	srand(21);
+	for(uint32_t s = 0; s < RANDOM_SETS; s++)
+	{
+		for(uint8_t i = 0; i < CHANNELS; i++)
+		{
+			uint32_t r = (uint32_t)rand();
+
+			Handle.Duty[i] = (r % 8 == 0) ? 0 : (r % 8 == 1) ? PERIOD : (r % 4 == 2) ? Handle.Duty[0] :
+					(uint16_t)((r >> 4) % (PERIOD + 1));
+		}
+		failures += (CheckList() != 0);
+	}
+	TEST_CHECK_EQ(failures, 0);
+	SOFTPWM_DeInit(&Handle);
+}
+
+// SOFTPWM_Commit builds into the list the interrupt does not play
+static void test_Commit(void)
+{
+	Setup();
+	TEST_CHECK_EQ(SOFTPWM_Init(&Handle), SOFTPWM_OK);
+	SOFTPWM_SetDuty(&Handle, 0, 50);
+	SOFTPWM_SetDuty(&Handle, 1, 70);
+	TEST_CHECK_EQ(Handle.List[1].Count, 0);
+	SOFTPWM_Commit(&Handle);
+	TEST_CHECK_EQ(Handle.Active, 0);
+	TEST_CHECK_EQ(Handle.Pending, 1);
+	TEST_CHECK_EQ(Handle.List[0].Count, 1);
+	TEST_CHECK_EQ(Handle.List[1].Count, 3);
+	TEST_CHECK_EQ(Handle.List[1].Event[1].Time, 50);
+	TEST_CHECK_EQ(Handle.List[1].Event[2].BSRR[0], 1U << (5 + 16));
+	SOFTPWM_DeInit(&Handle);
+}
+
+int main(void)
+{
+	TEST_RUN(test_Ports);
+	TEST_RUN(test_FixedSets);
+	TEST_RUN(test_RandomSets);
+	TEST_RUN(test_Commit);
+
+	TEST_EXIT();
+}
@@ -0,0 +1,193 @@
+/*
+ * test_spi.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <string.h>
+#include "test.h"
+
+// DMA streams of the SPIs and their ownership, and the transaction queue in interrupt and
+// DMA mode. The simulated SPI loops MOSI back to MISO, the DMA transfers are played by the
+// test: the TX buffer is copied to the RX buffer and the streams are completed.
+
+static SPI_Handle_t Handle;
+static uint32_t Done;
+
+static void Foreign(void *pArg, uint8_t Flags)
+{
+	(void)pArg;
+	(void)Flags;
+}
+
+static void OnDone(SPI_Transaction_t *pTxn, void *pArg)
+{
+	(void)pTxn;
+	(void)pArg;
+	Done++;
+}
+
+static void Setup(SPI_RegDef_t *pSPIx, uint8_t XferMode)
+{
+	memset(&Handle, 0, sizeof(Handle));
+	Handle.pSPIx = pSPIx;
+	Handle.SPIConfig.SPI_DeviceMode = SPI_DEVICE_MODE_MASTER;
+	Handle.SPIConfig.SPI_BusConfig = SPI_BUS_CONFIG_FD;
+	Handle.SPIConfig.SPI_SclkSpeed = SPI_SCLK_SPEED_DIV4;
+	Handle.SPIConfig.SPI_SSM = SPI_SSM_EN;
+	Handle.XferMode = XferMode;
+	Handle.IRQPriority = 6;
+}
+
+static void test_DMAMap(void)
+{
+	Setup(SPI1, SPI_XFER_DMA);
+	TEST_CHECK_EQ(SPI_Init(&Handle), SPI_OK);
+	TEST_CHECK(Handle.pDMAx == DMA2);
+	TEST_CHECK_EQ(Handle.RxStream, 0);
+	TEST_CHECK_EQ(Handle.TxStream, 3);		// Stream 5 is TIM1_UP
+	TEST_CHECK_EQ(Handle.DMAChannel, 3);
+	SPI_DeInit(SPI1);
+
+	Setup(SPI2, SPI_XFER_DMA);
+	TEST_CHECK_EQ(SPI_Init(&Handle), SPI_OK);
+	TEST_CHECK(Handle.pDMAx == DMA1);
+	TEST_CHECK_EQ(Handle.RxStream, 3);
+	TEST_CHECK_EQ(Handle.TxStream, 4);
+	SPI_DeInit(SPI2);
+
+	// SPI3 TX on stream 7, stream 5 stays free for USART2 RX
+	Setup(SPI3, SPI_XFER_DMA);
+	TEST_CHECK_EQ(SPI_Init(&Handle), SPI_OK);
+	TEST_CHECK(Handle.pDMAx == DMA1);
+	TEST_CHECK_EQ(Handle.RxStream, 0);
+	TEST_CHECK_EQ(Handle.TxStream, 7);
+	TEST_CHECK_EQ(Handle.DMAChannel, 0);
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 5, Foreign, NULL), DMA_OK);
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 5, NULL, NULL), DMA_OK);
+	SPI_DeInit(SPI3);
+}
+
+// SPI3 RX shares DMA1 stream 0 with UART5 RX and I2C1 RX
+static void test_StreamInUse(void)
+{
+	static uint8_t tx[4] = { 1, 2, 3, 4 }, rx[4];
+	SPI_Transaction_t txn = { .pTxBuffer = tx, .pRxBuffer = rx, .Len = sizeof(tx) };
+
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 0, Foreign, NULL), DMA_OK);
+
+	Setup(SPI3, SPI_XFER_DMA);
+	TEST_CHECK_EQ(SPI_Init(&Handle), SPI_ERR_BUSY);
+	TEST_CHECK(Handle.pDMAx == NULL);
+	TEST_CHECK_EQ(SPI_Submit(&Handle, &txn), SPI_ERR_BUSY);
+	TEST_CHECK_EQ(SPI_StreamStart(&Handle, SPI_STREAM_TX, tx, rx, 4, NULL, NULL), SPI_ERR_BUSY);
+
+	// The TX stream was not kept either
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 7, Foreign, NULL), DMA_OK);
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 7, NULL, NULL), DMA_OK);
+
+	// Blocking and interrupt mode work without the streams
+	SPI_TransferBlocking(SPI3, tx, rx, sizeof(tx));
+	TEST_CHECK(memcmp(tx, rx, sizeof(tx)) == 0);
+	Handle.XferMode = SPI_XFER_IT;
+	memset(rx, 0, sizeof(rx));
+	TEST_CHECK_EQ(SPI_Submit(&Handle, &txn), SPI_OK);
+	while(!SPI_IsIdle(&Handle))
+	{
+		SPI3_IRQHandler();
+	}
+	TEST_CHECK_EQ(txn.Status, SPI_TXN_DONE);
+	TEST_CHECK(memcmp(tx, rx, sizeof(tx)) == 0);
+	SPI_DeInit(SPI3);
+
+	// Once the other driver lets the stream go, the SPI gets it and keeps it
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 0, NULL, NULL), DMA_OK);
+	Setup(SPI3, SPI_XFER_DMA);
+	TEST_CHECK_EQ(SPI_Init(&Handle), SPI_OK);
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 0, Foreign, NULL), DMA_ERR_BUSY);
+	TEST_CHECK_EQ(SPI_Init(&Handle), SPI_OK);		// Again by the same driver
+	SPI_DeInit(SPI3);
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 0, Foreign, NULL), DMA_OK);
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 0, NULL, NULL), DMA_OK);
+}
+
+static void test_QueueIT(void)
+{
+	static uint8_t tx0[3] = { 0x9F, 0x00, 0x00 }, rx0[3];
+	static uint8_t tx1[5] = { 0x03, 0x10, 0x20, 0x30, 0x40 }, rx1[5];
+	SPI_Transaction_t txns[2] =
+	{
+		{ .pCSPort = GPIOA, .CSPin = GPIO_PIN_4, .pTxBuffer = tx0, .pRxBuffer = rx0, .Len = 3, .pCallback = OnDone },
+		{ .pCSPort = GPIOA, .CSPin = GPIO_PIN_4, .pTxBuffer = tx1, .pRxBuffer = rx1, .Len = 5, .pCallback = OnDone },
+	};
+
+	GPIO_PeriClockEnable(GPIOA);
+	GPIO_SetPins(GPIOA, GPIO_PIN_4);
+	Setup(SPI1, SPI_XFER_IT);
+	TEST_CHECK_EQ(SPI_Init(&Handle), SPI_OK);
+	Done = 0;
+
+	TEST_CHECK_EQ(SPI_Submit(&Handle, &txns[0]), SPI_OK);
+	TEST_CHECK_EQ(SPI_Submit(&Handle, &txns[1]), SPI_OK);
+	TEST_CHECK_EQ(txns[0].Status, SPI_TXN_ACTIVE);
+	TEST_CHECK_EQ(txns[1].Status, SPI_TXN_QUEUED);
+	TEST_CHECK_EQ(GPIOA->ODR & GPIO_PIN_4, 0);
+
+	// One interrupt per frame: 3 + 5
+	for(uint32_t i = 0; i < 8; i++)
+	{
+		SPI1_IRQHandler();
+	}
+	TEST_CHECK(SPI_IsIdle(&Handle));
+	TEST_CHECK_EQ(Done, 2);
+	TEST_CHECK(memcmp(tx0, rx0, sizeof(tx0)) == 0);
+	TEST_CHECK(memcmp(tx1, rx1, sizeof(tx1)) == 0);
+	TEST_CHECK_EQ(GPIOA->ODR & GPIO_PIN_4, GPIO_PIN_4);
+
+	SPI_DeInit(SPI1);
+	GPIO_PeriClockDisable(GPIOA);
+}
+
+static void test_QueueDMA(void)
+{
+	static uint8_t tx[16], rx[16];
+	SPI_Transaction_t txn = { .pTxBuffer = tx, .pRxBuffer = rx, .Len = sizeof(tx), .pCallback = OnDone };
+
+	Setup(SPI1, SPI_XFER_DMA);
+	TEST_CHECK_EQ(SPI_Init(&Handle), SPI_OK);
+	Done = 0;
+
+	for(uint32_t i = 0; i < sizeof(tx); i++)
+	{
+		tx[i] = (uint8_t)(i * 7);
+	}
+	TEST_CHECK_EQ(SPI_Submit(&Handle, &txn), SPI_OK);
+	TEST_CHECK(DMA2->S[0].CR & DMA_SxCR_EN);
+	TEST_CHECK(DMA2->S[3].CR & DMA_SxCR_EN);
+	TEST_CHECK_EQ(DMA2->S[0].NDTR, sizeof(tx));
+	TEST_CHECK_EQ((DMA2->S[3].CR >> DMA_SxCR_CHSEL_POS) & 0x7U, 3);
+	TEST_CHECK(SPI1->CR2 & (1U << SPI_CR2_TXDMAEN));
+
+	// The transfer: the RX transfer complete ends the transaction
+	memcpy(rx, tx, sizeof(tx));
+	SIM_DMAComplete(DMA2, 3);
+	SIM_DMAComplete(DMA2, 0);
+	DMA2_Stream0_IRQHandler();
+	TEST_CHECK_EQ(txn.Status, SPI_TXN_DONE);
+	TEST_CHECK_EQ(Done, 1);
+	TEST_CHECK(SPI_IsIdle(&Handle));
+	TEST_CHECK_EQ(SPI1->CR2 & ((1U << SPI_CR2_TXDMAEN) | (1U << SPI_CR2_RXDMAEN)), 0);
+
+	SPI_DeInit(SPI1);
+}
+
+int main(void)
+{
+	TEST_RUN(test_DMAMap);
+	TEST_RUN(test_StreamInUse);
+	TEST_RUN(test_QueueIT);
+	TEST_RUN(test_QueueDMA);
+
+	TEST_EXIT();
+}
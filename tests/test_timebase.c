@@ -0,0 +1,262 @@
+/*
+ * test_timebase.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include "test.h"
+#include "stm32f407xx_timebase.h"
+
+// Software timers of the timebase, driven by calling the tick handler: expiry, periods,
+// timers more than a wheel turn away, and callbacks that stop or restart timers of the slot
+// that is being walked. Then the busy-waits and the us time, measured in simulated core
+// cycles, at 168 MHz and at the slowest HCLK (HSI / 512, below 1 tick per us).
+
+typedef struct
+{
+	TIMEBASE_Timer_t Timer;
+	uint32_t Calls;
+	uint32_t LastMs;
+	TIMEBASE_Timer_t *pOther;		// Stopped or restarted by the callback
+}Probe_t;
+
+static void Ticks(uint32_t Ms)
+{
+	for(uint32_t i = 0; i < Ms; i++)
+	{
+		TIMEBASE_TickHandler();
+	}
+}
+
+static void Count(void *pArg)
+{
+	Probe_t *pProbe = pArg;
+
+	pProbe->Calls++;
+	pProbe->LastMs = TIMEBASE_GetMs();
+}
+
+static void StopOther(void *pArg)
+{
+	Probe_t *pProbe = pArg;
+
+	Count(pArg);
+	TIMEBASE_TimerStop(pProbe->pOther);
+}
+
+static void StopSelf(void *pArg)
+{
+	Probe_t *pProbe = pArg;
+
+	Count(pArg);
+	TIMEBASE_TimerStop(&pProbe->Timer);
+}
+
+static void RestartSelf(void *pArg)
+{
+	Probe_t *pProbe = pArg;
+
+	Count(pArg);
+	if(pProbe->Calls < 3)
+	{
+		TIMEBASE_TimerStart(&pProbe->Timer, TIMEBASE_WHEEL_SIZE, 0, RestartSelf, pProbe);
+	}
+}
+
+static void RestartOther(void *pArg)
+{
+	Probe_t *pProbe = pArg;
+
+	Count(pArg);
+	TIMEBASE_TimerStart(pProbe->pOther, 5, 0, Count, pProbe->pOther);
+}
+
+static void test_OneShotAndPeriodic(void)
+{
+	Probe_t once = { 0 }, periodic = { 0 };
+	uint32_t start;
+
+	(void)TIMEBASE_Process();
+	start = TIMEBASE_GetMs();
+
+	TIMEBASE_TimerStart(&once.Timer, 3, 0, Count, &once);
+	TIMEBASE_TimerStart(&periodic.Timer, 2, 5, Count, &periodic);
+
+	Ticks(2);
+	TEST_CHECK_EQ(TIMEBASE_Pending(), 1);
+	TEST_CHECK_EQ(TIMEBASE_Process(), 1);
+	TEST_CHECK_EQ(TIMEBASE_Pending(), 0);
+	TEST_CHECK_EQ(periodic.Calls, 1);
+	TEST_CHECK_EQ(once.Calls, 0);
+
+	Ticks(1);
+	TEST_CHECK_EQ(TIMEBASE_Process(), 1);
+	TEST_CHECK_EQ(once.Calls, 1);
+	TEST_CHECK_EQ(once.LastMs - start, 3);
+
+	// 2, 7, 12, 17: callbacks of ticks missed by the main loop all run on the next call
+	Ticks(15);
+	TEST_CHECK_EQ(TIMEBASE_Process(), 3);
+	TEST_CHECK_EQ(periodic.Calls, 4);
+	TEST_CHECK_EQ(once.Calls, 1);
+
+	TIMEBASE_TimerStop(&periodic.Timer);
+	TIMEBASE_TimerStop(&periodic.Timer);
+	Ticks(20);
+	TEST_CHECK_EQ(TIMEBASE_Process(), 0);
+}
+
+static void test_BeyondOneWheelTurn(void)
+{
+	Probe_t near = { 0 }, far = { 0 };
+	uint32_t start;
+
+	(void)TIMEBASE_Process();
+	start = TIMEBASE_GetMs();
+
+	// Same slot, one wheel turn apart
+	TIMEBASE_TimerStart(&far.Timer, 10 + TIMEBASE_WHEEL_SIZE, 0, Count, &far);
+	TIMEBASE_TimerStart(&near.Timer, 10, 0, Count, &near);
+
+	Ticks(10);
+	TEST_CHECK_EQ(TIMEBASE_Process(), 1);
+	TEST_CHECK_EQ(near.Calls, 1);
+	TEST_CHECK_EQ(far.Calls, 0);
+
+	Ticks(TIMEBASE_WHEEL_SIZE);
+	TEST_CHECK_EQ(TIMEBASE_Process(), 1);
+	TEST_CHECK_EQ(far.Calls, 1);
+	TEST_CHECK_EQ(far.LastMs - start, 10 + TIMEBASE_WHEEL_SIZE);
+}
+
+static void test_StopOtherFromCallback(void)
+{
+	Probe_t first = { 0 }, second = { 0 }, third = { 0 };
+
+	(void)TIMEBASE_Process();
+
+	// All three due on the same tick. Whichever runs first stops the others, the slot
+	// is walked in insertion order reversed, so "first" is started last.
+	TIMEBASE_TimerStart(&third.Timer, 4, 0, Count, &third);
+	TIMEBASE_TimerStart(&second.Timer, 4, 0, StopOther, &second);
+	TIMEBASE_TimerStart(&first.Timer, 4, 0, StopOther, &first);
+	first.pOther = &second.Timer;
+	second.pOther = &third.Timer;
+
+	Ticks(4);
+	TEST_CHECK_EQ(TIMEBASE_Process(), 2);
+	TEST_CHECK_EQ(first.Calls, 1);
+	TEST_CHECK_EQ(second.Calls, 0);		// Stopped by first before it ran
+	TEST_CHECK_EQ(third.Calls, 1);
+	TEST_CHECK_EQ(first.Timer.Active, 0);
+	TEST_CHECK_EQ(second.Timer.Active, 0);
+
+	// Nothing is left linked in the wheel
+	Ticks(2 * TIMEBASE_WHEEL_SIZE);
+	TEST_CHECK_EQ(TIMEBASE_Process(), 0);
+}
+
+static void test_StopPeriodicNeighbourFromCallback(void)
+{
+	Probe_t killer = { 0 }, victim = { 0 }, bystander = { 0 };
+
+	(void)TIMEBASE_Process();
+
+	// The periodic victim would be next in the walk when killer runs
+	TIMEBASE_TimerStart(&bystander.Timer, 6, 6, Count, &bystander);
+	TIMEBASE_TimerStart(&victim.Timer, 6, 6, Count, &victim);
+	TIMEBASE_TimerStart(&killer.Timer, 6, 0, StopOther, &killer);
+	killer.pOther = &victim.Timer;
+
+	Ticks(6);
+	TEST_CHECK_EQ(TIMEBASE_Process(), 2);
+	TEST_CHECK_EQ(victim.Calls, 0);
+	TEST_CHECK_EQ(bystander.Calls, 1);
+
+	Ticks(12);
+	TEST_CHECK_EQ(TIMEBASE_Process(), 2);
+	TEST_CHECK_EQ(victim.Calls, 0);
+	TEST_CHECK_EQ(bystander.Calls, 3);
+	TIMEBASE_TimerStop(&bystander.Timer);
+}
+
+static void test_StopAndRestartSelf(void)
+{
+	Probe_t self = { 0 }, periodic = { 0 }, other = { 0 }, restarter = { 0 };
+
+	(void)TIMEBASE_Process();
+
+	// A periodic timer that stops itself runs once
+	TIMEBASE_TimerStart(&periodic.Timer, 3, 3, StopSelf, &periodic);
+	// A one-shot that restarts itself a wheel turn later, into the same slot
+	TIMEBASE_TimerStart(&self.Timer, 3, 0, RestartSelf, &self);
+	// Restarts a timer of the same slot that has not run yet
+	TIMEBASE_TimerStart(&other.Timer, 3, 0, Count, &other);
+	TIMEBASE_TimerStart(&restarter.Timer, 3, 0, RestartOther, &restarter);
+	restarter.pOther = &other.Timer;
+
+	Ticks(3);
+	TEST_CHECK_EQ(TIMEBASE_Process(), 3);
+	TEST_CHECK_EQ(periodic.Calls, 1);
+	TEST_CHECK_EQ(self.Calls, 1);
+	TEST_CHECK_EQ(restarter.Calls, 1);
+	TEST_CHECK_EQ(other.Calls, 0);		// Moved 5 ms on
+
+	Ticks(5);
+	TEST_CHECK_EQ(TIMEBASE_Process(), 1);
+	TEST_CHECK_EQ(other.Calls, 1);
+
+	Ticks(2 * TIMEBASE_WHEEL_SIZE);
+	TEST_CHECK_EQ(TIMEBASE_Process(), 2);
+	TEST_CHECK_EQ(self.Calls, 3);
+	TEST_CHECK_EQ(periodic.Calls, 1);
+	TEST_CHECK_EQ(self.Timer.Active, 0);
+}
+
+// Core cycles of TIMEBASE_DelayUs(Us)
+static uint32_t DelayCycles(uint32_t Us)
+{
+	uint32_t start = REG_READ(DWT->CYCCNT);
+
+	TIMEBASE_DelayUs(Us);
+
+	return REG_READ(DWT->CYCCNT) - start;
+}
+
+static void test_DelayAndUs(void)
+{
+	uint32_t cycles;
+
+	REG_SET_BITS(DEMCR, DEMCR_TRCENA);
+	REG_SET_BITS(DWT->CTRL, DWT_CTRL_CYCCNTENA);
+
+	// At most one polling pass (8 simulated cycles) late
+	TIMEBASE_Init(168000000U);
+	cycles = DelayCycles(250);
+	TEST_CHECK( (cycles >= 42000U) && (cycles <= 42000U + 16U) );
+	cycles = DelayCycles(1);
+	TEST_CHECK( (cycles >= 168U) && (cycles <= 168U + 16U) );
+	TEST_CHECK(TIMEBASE_GetUs() - (uint64_t)TIMEBASE_GetMs() * 1000U < 1000U);
+
+	// 31.25 kHz: 31 ticks per ms, 640 us are 19 ticks
+	TIMEBASE_Init(16000000U / 512U);
+	TEST_CHECK(TIMEBASE_GetUs() - (uint64_t)TIMEBASE_GetMs() * 1000U < 1000U);
+	cycles = DelayCycles(640);
+	TEST_CHECK( (cycles >= 19U) && (cycles <= 19U + 16U) );
+	TEST_CHECK_EQ(DelayCycles(0), 8);
+
+	REG_WRITE(SYSTICK->CTRL, 0);
+}
+
+int main(void)
+{
+	TEST_RUN(test_OneShotAndPeriodic);
+	TEST_RUN(test_BeyondOneWheelTurn);
+	TEST_RUN(test_StopOtherFromCallback);
+	TEST_RUN(test_StopPeriodicNeighbourFromCallback);
+	TEST_RUN(test_StopAndRestartSelf);
+	TEST_RUN(test_DelayAndUs);
+
+	TEST_EXIT();
+}
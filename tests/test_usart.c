@@ -0,0 +1,284 @@
+/*
+ * test_usart.c
+ *
+ *  Created on: Mar 19, 2023
+ *      Author: Grétar Már Kjartansson
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+
+// The receive ring (USART_RxRingUpdate) on its own and against a byte stream with frames,
+// then through the driver with the DMA played by the test: the bytes are written where NDTR
+// says the DMA would write them, the stream is advanced (SIM_DMAAdvance) and IDLE is set in
+// SR for the end of a frame. Also the DMA stream ownership of USART_Init and the transmit
+// queue.
+
+#define RING_SIZE		64
+#define STREAM_LEN		20000
+#define MAX_CALLS		16
+
+typedef struct
+{
+	uint16_t Offset;
+	uint16_t Len;
+	uint8_t Flags;
+}Call_t;
+
+static uint8_t Ring[RING_SIZE];
+static Call_t Calls[MAX_CALLS];
+static uint32_t CallCount;
+
+// Received data and frame ends, as the application would see them
+static uint8_t Received[STREAM_LEN];
+static uint32_t ReceivedLen;
+static uint32_t FrameEnds[STREAM_LEN];
+static uint32_t FrameCount;
+
+static void Record(const uint8_t *pData, uint16_t Len, uint8_t Flags, void *pArg)
+{
+	(void)pArg;
+	if(CallCount < MAX_CALLS)
+	{
+		Calls[CallCount] = (Call_t){ (uint16_t)(pData - Ring), Len, Flags };
+	}
+	CallCount++;
+}
+
+static void Collect(const uint8_t *pData, uint16_t Len, uint8_t Flags, void *pArg)
+{
+	(void)pArg;
+	memcpy(&Received[ReceivedLen], pData, Len);
+	ReceivedLen += Len;
+	if(Flags & USART_RX_FRAME_END)
+	{
+		FrameEnds[FrameCount++] = ReceivedLen;
+	}
+}
+
+static void Foreign(void *pArg, uint8_t Flags)
+{
+	(void)pArg;
+	(void)Flags;
+}
+
+static void CheckCall(uint32_t i, uint16_t Offset, uint16_t Len, uint8_t Flags)
+{
+	TEST_CHECK_EQ(Calls[i].Offset, Offset);
+	TEST_CHECK_EQ(Calls[i].Len, Len);
+	TEST_CHECK_EQ(Calls[i].Flags, Flags);
+}
+
+static void Setup(USART_Handle_t *pHandle, USART_RegDef_t *pUSARTx, uint8_t Mode)
+{
+	memset(pHandle, 0, sizeof(*pHandle));
+	pHandle->pUSARTx = pUSARTx;
+	pHandle->USARTConfig.USART_Mode = Mode;
+	pHandle->USARTConfig.USART_Baud = 115200;
+	pHandle->IRQPriority = 5;
+}
+
+static void test_RingUpdate(void)
+{
+	USART_RxRing_t ring = { .pBuffer = Ring, .Size = 16, .pCallback = Record };
+
+	CallCount = 0;
+	USART_RxRingUpdate(&ring, 5, 0);
+	USART_RxRingUpdate(&ring, 5, 0);						// Nothing new, no call
+	USART_RxRingUpdate(&ring, 5, USART_RX_FRAME_END);		// Frame end without data
+	USART_RxRingUpdate(&ring, 16, 0);						// NDTR read 0 before the reload
+	USART_RxRingUpdate(&ring, 3, USART_RX_FRAME_END);
+	TEST_CHECK_EQ(CallCount, 4);
+	CheckCall(0, 0, 5, 0);
+	CheckCall(1, 5, 0, USART_RX_FRAME_END);
+	CheckCall(2, 5, 11, 0);
+	CheckCall(3, 0, 3, USART_RX_FRAME_END);
+	TEST_CHECK_EQ(ring.Tail, 3);
+
+	// From the middle around to the start, then over the end: two calls, flags on the last
+	CallCount = 0;
+	USART_RxRingUpdate(&ring, 0, USART_RX_FRAME_END);
+	USART_RxRingUpdate(&ring, 15, 0);
+	USART_RxRingUpdate(&ring, 1, USART_RX_FRAME_END);
+	TEST_CHECK_EQ(CallCount, 4);
+	CheckCall(0, 3, 13, USART_RX_FRAME_END);
+	CheckCall(1, 0, 15, 0);
+	CheckCall(2, 15, 1, 0);
+	CheckCall(3, 0, 1, USART_RX_FRAME_END);
+}
+
+// A random byte stream with frames of random length, handed over at random points as the
+// half/full transfer and IDLE interrupts would. The DMA never gets a whole ring ahead.
+static void test_RingFraming(void)
+{
+	static uint8_t stream[STREAM_LEN];
+	static uint32_t ends[STREAM_LEN];
+	USART_RxRing_t ring = { .pBuffer = Ring, .Size = RING_SIZE, .pCallback = Collect };
+	uint32_t pos = 0, frames = 0, pending = 0;
+
+	srand(3);
+	ReceivedLen = 0;
+	FrameCount = 0;
+
+	while(pos < STREAM_LEN)
+	{
+		uint32_t len = 1 + rand() % (2 * RING_SIZE);
+
+		for(uint32_t i = 0; (i < len) && (pos < STREAM_LEN); i++)
+		{
+			stream[pos] = (uint8_t)rand();
+			Ring[pos % RING_SIZE] = stream[pos];
+			pos++;
+
+			// Half or full transfer interrupt, or a late update from the main loop
+			if( (pos % (RING_SIZE / 2) == 0) || (++pending >= RING_SIZE - 1) || (rand() % 50 == 0) )
+			{
+				USART_RxRingUpdate(&ring, (uint16_t)(pos % RING_SIZE), 0);
+				pending = 0;
+			}
+		}
+		USART_RxRingUpdate(&ring, (uint16_t)(pos % RING_SIZE), USART_RX_FRAME_END);
+		ends[frames++] = pos;
+		pending = 0;
+	}
+
+	TEST_CHECK_EQ(ReceivedLen, STREAM_LEN);
+	TEST_CHECK(memcmp(Received, stream, STREAM_LEN) == 0);
+	TEST_CHECK_EQ(FrameCount, frames);
+	TEST_CHECK(memcmp(FrameEnds, ends, frames * sizeof(ends[0])) == 0);
+}
+
+// Frames through the driver: DMA1 stream 5 for USART2 RX
+static void test_RxFrames(void)
+{
+	static const uint8_t frame0[] = "hello";
+	static uint8_t frame1[100];
+	USART_Handle_t handle;
+
+	Setup(&handle, USART2, USART_MODE_ONLY_RX);
+	TEST_CHECK_EQ(USART_Init(&handle), USART_OK);
+	TEST_CHECK_EQ(USART_RxStart(&handle, Ring, RING_SIZE, Collect, NULL), USART_OK);
+	TEST_CHECK(DMA1->S[5].CR & DMA_SxCR_CIRC);
+	TEST_CHECK(USART2->CR3 & (1U << USART_CR3_DMAR));
+	ReceivedLen = 0;
+	FrameCount = 0;
+
+	for(uint32_t i = 0; i < sizeof(frame1); i++)
+	{
+		frame1[i] = (uint8_t)(i + 1);
+	}
+
+	for(uint32_t f = 0; f < 3; f++)
+	{
+		const uint8_t *pFrame = (f == 1) ? frame1 : frame0;
+		uint32_t len = (f == 1) ? sizeof(frame1) : sizeof(frame0);
+
+		for(uint32_t i = 0; i < len; i++)
+		{
+			Ring[RING_SIZE - DMA_GetRemaining(DMA1, 5)] = pFrame[i];
+			SIM_DMAAdvance(DMA1, 5, 1);
+			DMA1_Stream5_IRQHandler();
+		}
+		REG_SET_BITS(USART2->SR, (1U << USART_SR_IDLE));
+		USART2_IRQHandler();
+		REG_CLR_BITS(USART2->SR, (1U << USART_SR_IDLE));
+	}
+
+	TEST_CHECK_EQ(FrameCount, 3);
+	TEST_CHECK_EQ(FrameEnds[0], sizeof(frame0));
+	TEST_CHECK_EQ(FrameEnds[1], sizeof(frame0) + sizeof(frame1));
+	TEST_CHECK_EQ(FrameEnds[2], 2 * sizeof(frame0) + sizeof(frame1));
+	TEST_CHECK(memcmp(Received, frame0, sizeof(frame0)) == 0);
+	TEST_CHECK(memcmp(&Received[sizeof(frame0)], frame1, sizeof(frame1)) == 0);
+	TEST_CHECK_EQ(handle.RxErrors, 0);
+
+	// A frame cut short by the stop is handed over without a frame end
+	Ring[RING_SIZE - DMA_GetRemaining(DMA1, 5)] = 0x55;
+	SIM_DMAAdvance(DMA1, 5, 1);
+	USART_RxStop(&handle);
+	TEST_CHECK_EQ(ReceivedLen, 2 * sizeof(frame0) + sizeof(frame1) + 1);
+	TEST_CHECK_EQ(Received[ReceivedLen - 1], 0x55);
+	TEST_CHECK_EQ(FrameCount, 3);
+
+	USART_DeInit(USART2);
+}
+
+// UART5 RX shares DMA1 stream 0 with SPI3 RX and I2C1 RX
+static void test_StreamInUse(void)
+{
+	static const uint8_t data[] = { 1, 2, 3 };
+	USART_TxBuffer_t tx = { .pData = data, .Len = sizeof(data) };
+	USART_Handle_t handle;
+
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 0, Foreign, NULL), DMA_OK);
+
+	Setup(&handle, UART5, USART_MODE_TXRX);
+	TEST_CHECK_EQ(USART_Init(&handle), USART_ERR_BUSY);
+	TEST_CHECK(handle.pDMAx == NULL);
+	TEST_CHECK_EQ(USART_RxStart(&handle, Ring, RING_SIZE, Collect, NULL), USART_ERR_BUSY);
+	TEST_CHECK_EQ(USART_Submit(&handle, &tx), USART_ERR_BUSY);
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 7, Foreign, NULL), DMA_OK);	// TX stream not kept
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 7, NULL, NULL), DMA_OK);
+	USART_DeInit(UART5);
+
+	// Only sending: the RX stream is not needed
+	Setup(&handle, UART5, USART_MODE_ONLY_TX);
+	TEST_CHECK_EQ(USART_Init(&handle), USART_OK);
+	TEST_CHECK(handle.pDMAx == DMA1);
+	TEST_CHECK_EQ(USART_RxStart(&handle, Ring, RING_SIZE, Collect, NULL), USART_ERR_BUSY);
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 7, Foreign, NULL), DMA_ERR_BUSY);
+	USART_DeInit(UART5);
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 7, Foreign, NULL), DMA_OK);
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 7, NULL, NULL), DMA_OK);
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 0, NULL, NULL), DMA_OK);
+
+	// Both streams once the other driver let stream 0 go
+	Setup(&handle, UART5, USART_MODE_TXRX);
+	TEST_CHECK_EQ(USART_Init(&handle), USART_OK);
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 0, Foreign, NULL), DMA_ERR_BUSY);
+	USART_DeInit(UART5);
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 0, Foreign, NULL), DMA_OK);
+	TEST_CHECK_EQ(DMA_RegisterCallback(DMA1, 0, NULL, NULL), DMA_OK);
+}
+
+// USART2 TX on DMA1 stream 6: one buffer at a time, the next one starts from the interrupt
+static void test_TxQueue(void)
+{
+	static const uint8_t a[] = { 1, 2, 3 }, b[] = { 4, 5 };
+	USART_TxBuffer_t txA = { .pData = a, .Len = sizeof(a) };
+	USART_TxBuffer_t txB = { .pData = b, .Len = sizeof(b) };
+	USART_Handle_t handle;
+
+	Setup(&handle, USART2, USART_MODE_ONLY_TX);
+	TEST_CHECK_EQ(USART_Init(&handle), USART_OK);
+	TEST_CHECK_EQ(USART_Submit(&handle, &txA), USART_OK);
+	TEST_CHECK_EQ(USART_Submit(&handle, &txB), USART_OK);
+	TEST_CHECK_EQ(txA.Status, USART_TX_ACTIVE);
+	TEST_CHECK_EQ(txB.Status, USART_TX_QUEUED);
+	TEST_CHECK_EQ(DMA_GetRemaining(DMA1, 6), sizeof(a));
+
+	SIM_DMAComplete(DMA1, 6);
+	DMA1_Stream6_IRQHandler();
+	TEST_CHECK_EQ(txA.Status, USART_TX_DONE);
+	TEST_CHECK_EQ(txB.Status, USART_TX_ACTIVE);
+	TEST_CHECK_EQ(DMA_GetRemaining(DMA1, 6), sizeof(b));
+
+	SIM_DMAComplete(DMA1, 6);
+	DMA1_Stream6_IRQHandler();
+	TEST_CHECK_EQ(txB.Status, USART_TX_DONE);
+	TEST_CHECK(USART_IsTxIdle(&handle));
+
+	USART_DeInit(USART2);
+}
+
+int main(void)
+{
+	TEST_RUN(test_RingUpdate);
+	TEST_RUN(test_RingFraming);
+	TEST_RUN(test_RxFrames);
+	TEST_RUN(test_StreamInUse);
+	TEST_RUN(test_TxQueue);
+
+	TEST_EXIT();
+}